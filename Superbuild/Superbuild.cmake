@@ -67,6 +67,7 @@ ENDIF()
 # Configure advanced features:
 #   * large volume (bricked dataset) support
 #   * mosaicing tools
+#   * benchmarks
 ###########################################
 
 OPTION(BUILD_LARGE_VOLUME_TOOLS "Build with large volume (bricked) dataset support." ON)
@@ -76,6 +77,7 @@ IF(WIN32)
   SET(DEFAULT_MOSAIC_SETTING OFF)
 ENDIF()
 OPTION(BUILD_MOSAIC_TOOLS "Build with mosaicing tool support." ${DEFAULT_MOSAIC_SETTING})
+OPTION(BUILD_BENCHMARKS "Build the command line benchmarks of the core libraries." OFF)
 
 INCLUDE( ExternalProject )
 
@@ -291,6 +293,7 @@ SET(SEG3D_CACHE_ARGS
     "-DSEG3D_BINARY_DIR:PATH=${SEG3D_BINARY_DIR}"
     "-DBUILD_LARGE_VOLUME_TOOLS:BOOL=${BUILD_LARGE_VOLUME_TOOLS}"
     "-DBUILD_MOSAIC_TOOLS:BOOL=${BUILD_MOSAIC_TOOLS}"
+    "-DBUILD_BENCHMARKS:BOOL=${BUILD_BENCHMARKS}"
     "-DSEG3D_BITS:STRING=${SEG3D_BITS}"
     "-DBUILD_TESTING:BOOL=${BUILD_TESTING}"
     "-DTEST_INPUT_PATH:PATH=${TEST_INPUT_PATH}"
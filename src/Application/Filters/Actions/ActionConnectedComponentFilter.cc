@@ -26,17 +26,19 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// ITK includes
-#include <itkConnectedComponentImageFilter.h>
+// Boost includes
+#include <boost/bind.hpp>
 
-#include <Core/DataBlock/StdDataBlock.h>
-#include <Core/DataBlock/ITKDataBlock.h>
+// Core includes
+#include <Core/DataBlock/MaskComponents.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Math/MathFunctions.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
+#include <Application/Layer/MaskLayer.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/ITKFilter.h>
+#include <Application/Filters/LayerFilter.h>
 #include <Application/Filters/Actions/ActionConnectedComponentFilter.h>
 
 // REGISTER ACTION:
@@ -97,7 +99,7 @@ bool ActionConnectedComponentFilter::validate( Core::ActionContextHandle& contex
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class ConnectedComponentFilterAlgo : public ITKFilter
+class ConnectedComponentFilterAlgo : public LayerFilter
 {
 
 public:
@@ -109,277 +111,66 @@ public:
   bool invert_mask_;
   
 public:
-  // NOTE: The macro needs a data type to select which version to run. This needs to be
-  // a member variable of the algorithm class.
-  SCI_BEGIN_ITK_RUN()
+  // RUN_FILTER:
+  // Implementation of run of the Runnable base class, this function is called when the thread
+  // is launched.
+  virtual void run_filter()
   {
-    // Define the type of filter that we use.
-    typedef itk::ConnectedComponentImageFilter< 
-      UCHAR_IMAGE_TYPE, USHORT_IMAGE_TYPE > filter_type;
-
-    // Retrieve the image as an itk image from the underlying data structure
-    // NOTE: This only does wrapping and does not regenerate the data.
-    Core::ITKImageDataT<unsigned char>::Handle input_image; 
-    this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image );
-        
-    // Create a new ITK filter instantiation. 
-    filter_type::Pointer filter = filter_type::New();
-
-    // Relay abort and progress information to the layer that is executing the filter.
-    this->forward_abort_to_filter( filter, this->dst_layer_ );
-    this->observe_itk_progress( filter, this->dst_layer_, 0.0, 0.75 );
-    
-    // Setup the filter parameters that we do not want to change.
-    filter->SetInput( input_image->get_image() );
-
-    // Ensure we will have some threads left for doing something else
-    this->limit_number_of_itk_threads( filter );
-
-    // Run the actual ITK filter.
-    // This needs to be in a try/catch statement as certain filters throw exceptions when they
-    // are aborted. In that case we will relay a message to the status bar for information.
-
-    bool need_32bits = false;
-    try 
-    { 
-      filter->Update(); 
-    } 
-    catch ( ... ) 
-    {
-      if ( this->check_abort() )
-      {
-        this->report_error( "Filter was aborted." );
-        return;
-      }
-      if (  filter->GetObjectCount() > static_cast<unsigned long int>(
-        itk::NumericTraits<unsigned short>::max() ) )
-      {
-        need_32bits = true;
-      }
-      else
-      {
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-    }
-
-    // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-    // This one is set when the abort button is pressed and an abort is sent to ITK.
-    if ( this->check_abort() ) return;
-
-    Core::DataBlockHandle output_datablock;
+    Core::MaskDataBlockHandle src_mask = boost::dynamic_pointer_cast<MaskLayer>( 
+      this->src_layer_ )->get_mask_volume()->get_mask_data_block();
 
-    if ( need_32bits )
+    // Label the face connected components of the mask directly on its bit plane
+    Core::MaskComponents components;
+    components.set_abort_function( boost::bind( &LayerFilter::check_abort, this ) );
+    if ( !components.compute( src_mask ) )
     {
-      filter = 0;
-    
-      // Define the type of filter that we use.
-      typedef itk::ConnectedComponentImageFilter< 
-        UCHAR_IMAGE_TYPE, UINT_IMAGE_TYPE > filter32_type;
-
-      // Retrieve the image as an itk image from the underlying data structure
-      // NOTE: This only does wrapping and does not regenerate the data.
-      Core::ITKImageDataT<unsigned char>::Handle input_image; 
-      this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image );
-          
-      // Create a new ITK filter instantiation. 
-      filter32_type::Pointer filter32 = filter32_type::New();
-
-      // Relay abort and progress information to the layer that is executing the filter.
-      this->forward_abort_to_filter( filter32, this->dst_layer_ );
-      this->observe_itk_progress( filter32, this->dst_layer_, 0.0, 0.75 );
-      
-      // Setup the filter parameters that we do not want to change.
-      filter32->SetInput( input_image->get_image() );
-
-      // Ensure we will have some threads left for doing something else
-      this->limit_number_of_itk_threads( filter32 );
-
-      // Run the actual ITK filter.
-      // This needs to be in a try/catch statement as certain filters throw exceptions when they
-      // are aborted. In that case we will relay a message to the status bar for information.     
-      
-      try 
-      { 
-        filter32->Update(); 
-      } 
-      catch ( ... ) 
-      {
-        if ( this->check_abort() )
-        {
-          this->report_error( "Filter was aborted." );
-          return;
-        }
-        this->report_error( "ITK filter failed to complete." );
-        return;
-      }
-    
-      // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-      // This one is set when the abort button is pressed and an abort is sent to ITK.
       if ( this->check_abort() ) return;
+      this->report_error( "Could not allocate enough memory." );
+      return;
+    }
 
-      output_datablock = Core::ITKDataBlock::New( filter32->GetOutput() );
-
-      if ( ! output_datablock )
-      {
-        this->report_error("Could not allocate enough memory.");
-        return;
-      }
-      
-      unsigned int max_label = filter32->GetObjectCount();
-      std::vector<unsigned int> lut( max_label + 1, 0 );
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
-      
-      unsigned int* data = reinterpret_cast<unsigned int*>( output_datablock->get_data() );
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          unsigned int val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 1;
-        }
-      }
-      
-      if ( this->mask_layer_ )
-      {
-        Core::MaskDataBlockHandle mask_handle = 
-          dynamic_cast<MaskLayer*>( this->mask_layer_.get() )->
-          get_mask_volume()->get_mask_data_block();
-          
-        unsigned char mask_value = mask_handle->get_mask_value();
-        size_t size = mask_handle->get_size();
-        unsigned char* mask_data = mask_handle->get_mask_data();
-        
-        Core::DataBlock::shared_lock_type lock( mask_handle->get_mutex() );
-        if ( this->invert_mask_ )
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ! ( mask_data[ j ] & mask_value ) && data[ j ] ) lut[ data[ j ] ] = 1;
-          }     
-        }
-        else
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ( mask_data[ j ] & mask_value ) && data[ j ] ) lut[ data[ j ] ] = 1;
-          }           
-        
-        }
-      }
+    this->dst_layer_->update_progress_signal_( 0.60 );
+    if ( this->check_abort() ) return;
 
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
-      {
-        return;
-      }
+    // Keep the components that contain a seed point
+    std::vector< bool > selected( components.get_num_components(), false );
 
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
-      {
-        data[ j ] = lut[ data[ j ] ];
-      }
-    }
-    else
-    {
-      // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-      // This one is set when the abort button is pressed and an abort is sent to ITK.
-      if ( this->check_abort() ) return;
+    Core::Transform trans = this->src_layer_->get_grid_transform().get_inverse();
+    int nx = static_cast<int>( src_mask->get_nx() ); 
+    int ny = static_cast<int>( src_mask->get_ny() ); 
+    int nz = static_cast<int>( src_mask->get_nz() ); 
 
-      output_datablock = Core::ITKDataBlock::New( filter->GetOutput() );    
-    
-      if ( ! output_datablock )
-      {
-        this->report_error("Could not allocate enough memory.");
-        return;
-      }
-      
-      unsigned int max_label = filter->GetObjectCount();
-      std::vector<unsigned short> lut( max_label + 1, 0 );
-      
-      Core::GridTransform grid = input_image->get_grid_transform();
-      Core::Transform trans = grid.get_inverse();
-      int nx = static_cast<int>( grid.get_nx() ); 
-      int ny = static_cast<int>( grid.get_ny() ); 
-      int nz = static_cast<int>( grid.get_nz() ); 
+    for ( size_t i = 0; i < this->seeds_.size(); ++i )
+    {   
+      Core::Point location = trans * this->seeds_[ i ];
+      int x = static_cast<int>( Core::Round( location.x() ) );
+      int y = static_cast<int>( Core::Round( location.y() ) );
+      int z = static_cast<int>( Core::Round( location.z() ) );
       
-      unsigned short* data = reinterpret_cast<unsigned short*>( output_datablock->get_data() );
-      for ( size_t i = 0; i < this->seeds_.size(); ++i )
-      {   
-        Core::Point location = trans * seeds_[ i ];
-        int x = static_cast<int>( Core::Round( location.x() ) );
-        int y = static_cast<int>( Core::Round( location.y() ) );
-        int z = static_cast<int>( Core::Round( location.z() ) );
-        
-        if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
-        {
-          unsigned short val = data[ output_datablock->to_index( static_cast<size_t>( x ), 
-            static_cast<size_t>( y ), static_cast<size_t>( z ) ) ];
-          if ( val ) lut[ val ] = 1;
-        }
-      }
-      
-      if ( this->mask_layer_ )
-      {
-        Core::MaskDataBlockHandle mask_handle = 
-          dynamic_cast<MaskLayer*>( this->mask_layer_.get() )->
-          get_mask_volume()->get_mask_data_block();
-          
-        unsigned char mask_value = mask_handle->get_mask_value();
-        size_t size = mask_handle->get_size();
-        unsigned char* mask_data = mask_handle->get_mask_data();
-        
-        Core::DataBlock::shared_lock_type lock( mask_handle->get_mutex() );
-        if ( this->invert_mask_ )
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ! ( mask_data[ j ] & mask_value && data[ j ] ) ) lut[ data[ j ] ] = 1;
-          }     
-        }
-        else
-        {
-          for ( size_t j = 0; j < size; j++ )
-          {
-            if ( ( mask_data[ j ] & mask_value && data[ j ] ) ) lut[ data[ j ] ] = 1;
-          }           
-        
-        }
-      }
-
-      this->dst_layer_->update_progress_signal_( 0.80 );
-      if ( this->check_abort() )
-      {
-        return;
-      }
-
-      size_t size = output_datablock->get_size();
-      for ( size_t j = 0; j < size; j++ )
+      if ( x >= 0 && y >= 0 && z >= 0 && x < nx && y < ny && z < nz )
       {
-        data[ j ] = lut[ data[ j ] ];
+        size_t component = components.get_component( src_mask->to_index( 
+          static_cast<size_t>( x ), static_cast<size_t>( y ), static_cast<size_t>( z ) ) );
+        if ( component != Core::MaskComponents::NO_COMPONENT_C ) selected[ component ] = true;
       }
     }
 
-    this->dst_layer_->update_progress_signal_( .90 );
-    if ( this->check_abort() )
+    // And the components that touch the mask layer, or its inverse
+    if ( this->mask_layer_ )
     {
-      return;
+      Core::MaskRegionConstraint region;
+      region.add_mask( boost::dynamic_pointer_cast<MaskLayer>( this->mask_layer_ )->
+        get_mask_volume()->get_mask_data_block(), this->invert_mask_ );
+      components.select_components( region, selected );
     }
-    
+
+    this->dst_layer_->update_progress_signal_( 0.80 );
+    if ( this->check_abort() ) return;
+
     Core::MaskDataBlockHandle mask_datablock;
-    if ( ! ( Core::MaskDataBlockManager::Convert( output_datablock, 
-      this->dst_layer_->get_grid_transform(), mask_datablock ) ) )  
+    if ( !( Core::MaskDataBlockManager::Instance()->create( 
+      this->dst_layer_->get_grid_transform(), mask_datablock ) ) || 
+      !( components.fill_mask( selected, mask_datablock ) ) )
     {
       this->report_error("Could not allocate enough memory.");
       return;
@@ -390,9 +181,7 @@ public:
     this->dispatch_insert_mask_volume_into_layer( this->dst_layer_,
       Core::MaskVolumeHandle( new Core::MaskVolume(
       this->dst_layer_->get_grid_transform(), mask_datablock ) ) );
-      
   }
-  SCI_END_ITK_RUN()
 
   // GET_FITLER_NAME:
   // The name of the filter, this information is used for generating new layer labels.
@@ -26,17 +26,21 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// ITK includes
-#include <itkConnectedComponentImageFilter.h>
+// STL includes
+#include <cmath>
 
+// Boost includes
+#include <boost/bind.hpp>
+
+// Core includes
 #include <Core/DataBlock/StdDataBlock.h>
-#include <Core/DataBlock/ITKDataBlock.h>
-#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskComponents.h>
 
 // Application includes
 #include <Application/Layer/LayerManager.h>
+#include <Application/Layer/MaskLayer.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/ITKFilter.h>
+#include <Application/Filters/LayerFilter.h>
 #include <Application/Filters/Actions/ActionConnectedComponentSizeFilter.h>
 
 // REGISTER ACTION:
@@ -71,7 +75,7 @@ bool ActionConnectedComponentSizeFilter::validate( Core::ActionContextHandle& co
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class ConnectedComponentSizeFilterAlgo : public ITKFilter
+class ConnectedComponentSizeFilterAlgo : public LayerFilter
 {
 
 public:
@@ -81,100 +85,48 @@ public:
   bool log_scale_;
 
 public:
-  // NOTE: The macro needs a data type to select which version to run. This needs to be
-  // a member variable of the algorithm class.
-  SCI_BEGIN_ITK_RUN()
+  // RUN_FILTER:
+  // Implementation of run of the Runnable base class, this function is called when the thread
+  // is launched.
+  virtual void run_filter()
   {
-    // Define the type of filter that we use.
-    typedef itk::ConnectedComponentImageFilter< 
-      UCHAR_IMAGE_TYPE, UINT_IMAGE_TYPE > filter_type;
-
-    // Retrieve the image as an itk image from the underlying data structure
-    // NOTE: This only does wrapping and does not regenerate the data.
-    Core::ITKImageDataT<unsigned char>::Handle input_image; 
-    this->get_itk_image_from_layer<unsigned char>( this->src_layer_, input_image );
-        
-    // Create a new ITK filter instantiation. 
-    filter_type::Pointer filter = filter_type::New();
-
-    // Relay abort and progress information to the layer that is executing the filter.
-    this->forward_abort_to_filter( filter, this->dst_layer_ );
-    this->observe_itk_progress( filter, this->dst_layer_, 0.0, 0.75 );
-    
-    // Setup the filter parameters that we do not want to change.
-    filter->SetInput( input_image->get_image() );
-
-    // Ensure we will have some threads left for doing something else
-    this->limit_number_of_itk_threads( filter );
-    
-    // Run the actual ITK filter.
-    // This needs to be in a try/catch statement as certain filters throw exceptions when they
-    // are aborted. In that case we will relay a message to the status bar for information.
-    try 
-    { 
-      filter->Update(); 
-    } 
-    catch ( ... ) 
+    Core::MaskDataBlockHandle src_mask = boost::dynamic_pointer_cast<MaskLayer>( 
+      this->src_layer_ )->get_mask_volume()->get_mask_data_block();
+
+    // Label the face connected components of the mask directly on its bit plane
+    Core::MaskComponents components;
+    components.set_abort_function( boost::bind( &LayerFilter::check_abort, this ) );
+    if ( !components.compute( src_mask ) )
     {
-      this->report_error( "ITK filter failed to complete." );
+      if ( this->check_abort() ) return;
+      this->report_error( "Could not allocate enough memory." );
       return;
     }
 
-    // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-    // This one is set when the abort button is pressed and an abort is sent to ITK.
+    this->dst_layer_->update_progress_signal_( 0.75 );
     if ( this->check_abort() ) return;
 
-    Core::DataBlockHandle output_datablock = Core::ITKDataBlock::New( filter->GetOutput() );
-    
+    const std::vector< size_t >& sizes = components.get_component_sizes();
+    std::vector< double > values( sizes.size() );
+    for ( size_t j = 0; j < sizes.size(); j++ )
+    {
+      if ( this->log_scale_ ) values[ j ] = logf( static_cast<float>( sizes[ j ] + 1 ) );
+      else values[ j ] = static_cast<double>( sizes[ j ] );
+    }
+
+    Core::DataBlockHandle output_datablock = Core::StdDataBlock::New( 
+      this->src_layer_->get_grid_transform(), 
+      this->log_scale_ ? Core::DataType::FLOAT_E : Core::DataType::UINT_E );
+
     if ( ! output_datablock )
     {
       this->report_error("Could not allocate enough memory.");
       return;
     }   
-    
-    unsigned int max_label = filter->GetObjectCount();
-    
-    std::vector<unsigned int> hist;
-    try
-    {
-      hist.resize( max_label + 1, 0 );
-    }
-    catch( ... )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;   
-    }
-    
-    size_t size = output_datablock->get_size();
-    unsigned int* data = reinterpret_cast<unsigned int*>( output_datablock->get_data() );
-  
-    for ( size_t j = 0; j < size; j++ )
-    {
-      hist[ data[ j ] ]++;
-    }
-  
-    hist[ 0 ] = 0;
-  
-    this->dst_layer_->update_progress_signal_( 0.85 );
-    if ( this->check_abort() ) return;
 
-    if ( log_scale_ )
-    {
-      float* ldata = reinterpret_cast<float*>( output_datablock->get_data() );
-      for ( size_t j = 0; j < size; j++ )
-      {
-        ldata[ j ] = logf( static_cast<float>( hist[ data[ j ] ] + 1) );
-      }
-      output_datablock->update_data_type( Core::DataType::FLOAT_E );
-    }
-    else
-    {
-      for ( size_t j = 0; j < size; j++ )
-      {
-        data[ j ] = hist[ data[ j ] ];
-      }   
-    }
-    
+    // Voxels outside the mask get a size of zero
+    components.fill_data( values, output_datablock );
+
     this->dst_layer_->update_progress_signal_( 0.95 );
     if ( this->check_abort() ) return;
         
@@ -182,7 +134,6 @@ public:
       Core::DataVolumeHandle( new Core::DataVolume(
       this->dst_layer_->get_grid_transform(), output_datablock ) ), true );
   }
-  SCI_END_ITK_RUN()
 
   // GET_FITLER_NAME:
   // The name of the filter, this information is used for generating new layer labels.
@@ -26,13 +26,10 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// Core includes
-#include <Core/DataBlock/MaskDataBlockManager.h>
-
 // Application includes
 #include <Application/Layer/LayerManager.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/LayerFilter.h>
+#include <Application/Filters/MorphologyFilter.h>
 #include <Application/Filters/Actions/ActionIterativeDilateFilter.h>
 
 // REGISTER ACTION:
@@ -101,213 +98,22 @@ bool ActionIterativeDilateFilter::validate( Core::ActionContextHandle& context )
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class IterativeDilateFilterAlgo : public LayerFilter
+class IterativeDilateFilterAlgo : public MorphologyFilter
 {
 
 public:
-  LayerHandle src_layer_;
-  LayerHandle mask_layer_;
-  LayerHandle dst_layer_;
-
   int radius_;
-  bool invert_mask_;
-  
-  bool only2d_;
-  int slice_type_;
 
 public:
   // RUN_FILTER:
-  // Implemtation of run of the Runnable base class, this function is called when the thread
+  // Implementation of run of the Runnable base class, this function is called when the thread
   // is launched.
 
   virtual void run_filter()
   {
-    MaskLayerHandle input_mask = boost::dynamic_pointer_cast<MaskLayer>( this->src_layer_ );
-    Core::MaskVolumeHandle input_volume = input_mask->get_mask_volume();
-    Core::DataBlockHandle input_data_block;
-    
-    if ( ! ( Core::MaskDataBlockManager::Convert( input_volume->get_mask_data_block(), 
-      input_data_block, Core::DataType::UCHAR_E ) ) )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;
-    }       
-    
-    Core::DataBlock::index_type nx = input_data_block->get_nx();
-    Core::DataBlock::index_type ny = input_data_block->get_ny();
-    Core::DataBlock::index_type nz = input_data_block->get_nz();
-    Core::DataBlock::index_type size = input_data_block->get_size();
-
-    unsigned char* data = reinterpret_cast<unsigned char*>( input_data_block->get_data() );
-  
-    Core::SliceType slice_type = static_cast<Core::SliceType::enum_type>( this->slice_type_ );
-    std::vector< std::vector<Core::DataBlock::index_type> > neighbors;
-    try
-    {
-      neighbors.resize( 0x40 );
-      Core::DataBlock::index_type nxy = nx * ny;
-
-      for ( size_t k = 0; k < neighbors.size(); k++ )
-      {
-        if ( !( this->only2d_ ) || ( slice_type != Core::SliceType::SAGITTAL_E ) )
-        {
-          if ( ! ( k & 0x1 ) ) neighbors[ k ].push_back( -1 );
-          if ( ! ( k & 0x2 ) ) neighbors[ k ].push_back( 1 );
-        }
-        
-        if ( !( this->only2d_ ) || ( slice_type != Core::SliceType::CORONAL_E ) )
-        {
-          if ( ! ( k & 0x4 ) ) neighbors[ k ].push_back( -nx );
-          if ( ! ( k & 0x8 ) ) neighbors[ k ].push_back( nx );
-        }
-        
-        if ( !( this->only2d_  ) || ( slice_type != Core::SliceType::AXIAL_E ) )
-        {
-          if ( ! ( k & 0x10 ) ) neighbors[ k ].push_back( -nxy );
-          if ( ! ( k & 0x20 ) ) neighbors[ k ].push_back( nxy );
-        }
-        
-        if ( !( this->only2d_  ) || ( slice_type == Core::SliceType::AXIAL_E ) )
-        {
-          if ( ! ( k & 0x5 ) ) neighbors[ k ].push_back( -1 - nx );
-          if ( ! ( k & 0x6 ) ) neighbors[ k ].push_back( 1 - nx );
-
-          if ( ! ( k & 0x9 ) ) neighbors[ k ].push_back( -1 + nx );
-          if ( ! ( k & 0xA ) ) neighbors[ k ].push_back( 1 + nx );
-        }
-
-        if ( !( this->only2d_  ) || ( slice_type == Core::SliceType::CORONAL_E ) )
-        {
-          if ( ! ( k & 0x11 ) ) neighbors[ k ].push_back( -1 - nxy );
-          if ( ! ( k & 0x12 ) ) neighbors[ k ].push_back( 1 - nxy );
-
-          if ( ! ( k & 0x21 ) ) neighbors[ k ].push_back( -1 + nxy );
-          if ( ! ( k & 0x22 ) ) neighbors[ k ].push_back( 1 + nxy );
-        }
-
-        if ( !( this->only2d_  ) || ( slice_type == Core::SliceType::SAGITTAL_E ) )
-        {
-          if ( ! ( k & 0x14 ) ) neighbors[ k ].push_back( -nx - nxy );
-          if ( ! ( k & 0x18 ) ) neighbors[ k ].push_back( nx - nxy );
-
-          if ( ! ( k & 0x24 ) ) neighbors[ k ].push_back( -nx + nxy );
-          if ( ! ( k & 0x28 ) ) neighbors[ k ].push_back( nx + nxy );
-        }
-      }
-    }
-    catch ( ... )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;   
-    }
-    
-    // Inscribe mask
-    if ( this->mask_layer_ )
-    {
-      MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( this->mask_layer_ );
-      if ( mask_layer )
-      {
-        Core::MaskDataBlockHandle mask_data_block = mask_layer->get_mask_volume()->
-          get_mask_data_block();      
-        Core::MaskDataBlock::shared_lock_type lock( mask_data_block->get_mutex() );
-        
-        unsigned char* mask_data = mask_data_block->get_mask_data();
-        unsigned char mask_value = mask_data_block->get_mask_value();
-        
-        if ( this->invert_mask_ )
-        {
-          for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-          {
-            if ( data[ j ] == 0 && ( mask_data[ j ] & mask_value ) ) data[ j ] = 255;
-          }       
-        }
-        else
-        {
-          for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-          {
-            if ( data[ j ] == 0 && !( mask_data[ j ] & mask_value ) ) data[ j ] = 255;
-          }
-        }
-      }
-    }
-    
-    
-    unsigned char current_label = 2;
-    unsigned char previous_label = 1;
-    float current_progress = 0.0f;
-    float progress_multiplier = 1.0f / static_cast<float>( this->radius_ * nz );
-    
-    for ( int i = 0; i < this->radius_; i++)
-    {
-      int border = 0;
-      Core::DataBlock::index_type k = 0;
-      for ( Core::DataBlock::index_type z = 0; z < nz; z++ )
-      {
-        if ( z == 0 ) border |= 0x10; else border &= ~( 0x10 );
-        if ( z == nz - 1 ) border |= 0x20; else border &= ~( 0x20 );
-        
-        for ( Core::DataBlock::index_type y = 0; y < ny; y++ )
-        {
-          if ( y == 0 ) border |= 0x04; else border &= ~( 0x04 );
-          if ( y == ny - 1 ) border |= 0x08; else border &= ~( 0x08 );
-
-          for ( Core::DataBlock::index_type x = 0; x < nx; x++, k++ )
-          {
-            if ( data[ k ] != previous_label ) continue;
-            
-            int border_x = border;
-            if ( x == 0 ) border_x |= 0x1;
-            if ( x == nx - 1 ) border_x |= 0x2;
-
-            const std::vector<Core::DataBlock::index_type>& neigh = neighbors[ border_x ];
-            for ( size_t m = 0; m < neigh.size(); m++ )
-            {
-              Core::DataBlock::index_type index = k + neigh[ m ];
-              if ( data[ index ] == 0 ) data[ index ] = current_label;
-            }
-          }
-        }
-        
-        float progress = static_cast<float>( i *  nz + z ) * progress_multiplier;
-      
-        if ( current_progress + 0.02f < progress )
-        {
-          current_progress = progress;
-          this->dst_layer_->update_progress( current_progress );
-          if ( this->check_abort() ) return;
-        }
-      }
-      current_label++;
-      previous_label++;
-    }
-
-    if ( this->mask_layer_ )
-    {
-      for ( Core::DataBlock::index_type j = 0; j < size; j++ )
-      {
-        if ( data[ j ] == 255 ) data[ j ] = 0;
-      }
-    }
-    
-    Core::MaskDataBlockHandle output_mask;
-
-    if (!( Core::MaskDataBlockManager::Convert( input_data_block, 
-      this->src_layer_->get_grid_transform(), output_mask ) ) )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return; 
-    }
-
-    Core::MaskVolumeHandle mask_volume( new Core::MaskVolume( 
-      this->src_layer_->get_grid_transform(), output_mask ) );
-      
-    if ( !mask_volume )
-    {
-      this->report_error( "Could not allocate enough memory." );
-      return;     
-    } 
-      
-    this->dispatch_insert_mask_volume_into_layer( this->dst_layer_, mask_volume );
+    Core::MaskMorphology morphology;
+    morphology.add_dilate( Core::MorphologyShapeType::ITERATIVE_E, this->radius_ );
+    this->run_morphology( morphology );
   }
   
   // GET_FITLER_NAME:
@@ -0,0 +1,268 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// Boost includes
+#include <boost/filesystem.hpp>
+
+// Core includes
+#include <Core/LargeVolume/LargeVolumeFilter.h>
+
+// Application includes
+#include <Application/Filters/LayerFilter.h>
+#include <Application/Layer/LayerManager.h>
+#include <Application/Layer/LargeVolumeLayer.h>
+#include <Application/LayerIO/Actions/ActionImportLargeVolumeLayer.h>
+#include <Application/Filters/Actions/ActionLargeVolumeFilter.h>
+
+// REGISTER ACTION:
+// Define a function that registers the action. The action also needs to be
+// registered in the CMake file.
+// NOTE: Registration needs to be done outside of any namespace
+CORE_REGISTER_ACTION( Seg3D, LargeVolumeFilter )
+
+namespace Seg3D
+{
+
+// SETUP_FILTER:
+// Copy the filter and its parameters into the large volume filter
+static bool SetupFilter( Core::LargeVolumeFilter& filter, const std::string& filter_name,
+  double lower_threshold, double upper_threshold, double scale, double offset, double sigma,
+  int radius )
+{
+  Core::LargeVolumeFilterType filter_type = Core::LargeVolumeFilterType::THRESHOLD_E;
+  if ( !Core::ImportFromString( filter_name, filter_type ) ) return false;
+
+  switch ( filter_type )
+  {
+    case Core::LargeVolumeFilterType::THRESHOLD_E:
+      filter.set_threshold( lower_threshold, upper_threshold ); break;
+    case Core::LargeVolumeFilterType::ARITHMETIC_E:
+      filter.set_arithmetic( scale, offset ); break;
+    case Core::LargeVolumeFilterType::GAUSSIAN_E:
+      filter.set_gaussian( sigma ); break;
+    case Core::LargeVolumeFilterType::MEDIAN_E:
+      filter.set_median( radius ); break;
+  }
+  return true;
+}
+
+bool ActionLargeVolumeFilter::validate( Core::ActionContextHandle& context )
+{
+  // Make sure that the sandbox exists
+  if ( !LayerManager::CheckSandboxExistence( this->sandbox_, context ) ) return false;
+
+  // Check for layer existence and type information
+  if ( ! LayerManager::CheckLayerExistenceAndType( this->target_layer_, 
+    Core::VolumeType::LARGE_DATA_E, context, this->sandbox_ ) ) return false;
+  
+  // Check for layer availability 
+  if ( ! LayerManager::CheckLayerAvailability( this->target_layer_, 
+    false, context, this->sandbox_ ) ) return false;
+
+  LayerHandle layer = LayerManager::FindLayer( this->target_layer_, this->sandbox_ );
+  LargeVolumeLayerHandle lv = boost::dynamic_pointer_cast<LargeVolumeLayer>( layer );
+  Core::LargeVolumeSchemaHandle schema = lv->get_schema();
+
+  Core::LargeVolumeFilter filter( schema );
+  if ( !SetupFilter( filter, this->filter_, this->lower_threshold_, this->upper_threshold_,
+    this->scale_, this->offset_, this->sigma_, this->radius_ ) )
+  {
+    context->report_error( "Filter needs to be one of threshold, arithmetic, gaussian or median." );
+    return false;
+  }
+
+  if ( this->filter_ == "gaussian" && this->sigma_ <= 0.0 )
+  {
+    context->report_error( "The sigma needs to be larger than zero." );
+    return false;
+  }
+
+  if ( this->filter_ == "median" && this->radius_ < 1 )
+  {
+    context->report_error( "The radius needs to be larger than or equal to one." );
+    return false;
+  }
+
+  // Samples are only taken from a brick and its direct neighbors
+  if ( filter.get_stencil_radius() > static_cast<int>( schema->get_overlap() ) )
+  {
+    context->report_error( "The filter needs " + Core::ExportToString( filter.get_stencil_radius() ) +
+      " neighboring samples, but the bricks of the large volume only overlap by " + 
+      Core::ExportToString( schema->get_overlap() ) + "." );
+    return false;
+  }
+
+  if ( this->output_dir_.empty() )
+  {
+    context->report_error( "No output directory was given." );
+    return false;
+  }
+
+  boost::filesystem::path output_dir( this->output_dir_ );
+  boost::system::error_code ec;
+  if ( boost::filesystem::equivalent( output_dir, schema->get_dir(), ec ) ||
+    boost::filesystem::exists( output_dir / "volume.txt", ec ) )
+  {
+    context->report_error( "Directory '" + this->output_dir_ + "' already contains a large volume." );
+    return false;
+  }
+  
+  // Validation successful
+  return true;
+}
+
+// ALGORITHM CLASS
+// This class does the actual work and is run on a separate thread.
+// NOTE: The separation of the algorithm into a private class is for the purpose of running the
+// filter on a separate thread.
+
+class LargeVolumeFilterAlgo : public LayerFilter
+{
+
+public:
+  LayerHandle src_layer_;
+
+  Core::LargeVolumeFilterHandle filter_;
+  std::string output_dir_;
+
+public:
+  // GET_FITLER_NAME:
+  // The name of the filter, this information is used for generating new layer labels.
+  virtual std::string get_filter_name() const
+  {
+    return "Large Volume Filter";
+  }
+
+  // GET_LAYER_PREFIX:
+  // This function returns the name of the filter. The latter is prepended to the new layer name, 
+  // when a new layer is generated. 
+  virtual std::string get_layer_prefix() const
+  {
+    return "LargeVolumeFilter";  
+  }
+
+  // HANDLE_ABORT:
+  // Stop filtering once the bricks that are being processed are written
+  virtual void handle_abort()
+  {
+    this->filter_->abort();
+  }
+
+  // RUN_FILTER:
+  // The bricks are filtered on the thread pool, the filtered volume is added as a new layer
+  // once it has been written completely.
+  virtual void run_filter()
+  {
+    this->src_layer_->update_progress( 0.0 );
+    this->filter_->set_progress_function( boost::bind( &Layer::update_progress, 
+      this->src_layer_, _1, 0.0, 1.0 ) );
+
+    std::string error;
+    bool success = this->filter_->run( error );
+    this->filter_->set_progress_function( boost::function< void ( double ) >() );
+
+    if ( this->check_abort() ) return;
+    if ( !success )
+    {
+      this->report_error( error );
+      return;
+    }
+
+    ActionImportLargeVolumeLayer::Dispatch( Core::Interface::GetWidgetActionContext(), 
+      this->output_dir_ );
+  }
+};
+
+bool ActionLargeVolumeFilter::run( Core::ActionContextHandle& context, 
+  Core::ActionResultHandle& result )
+{
+  // Create algorithm
+  boost::shared_ptr<LargeVolumeFilterAlgo> algo( new LargeVolumeFilterAlgo );
+
+  // Find the handle to the layer
+  if ( !( algo->find_layer( this->target_layer_, algo->src_layer_ ) ) )
+  {
+    return false;
+  }
+
+  // Copy the parameters over to the filter that processes the bricks
+  LargeVolumeLayerHandle lv = boost::dynamic_pointer_cast<LargeVolumeLayer>( algo->src_layer_ );
+  algo->set_sandbox( this->sandbox_ );
+  algo->output_dir_ = this->output_dir_;
+  algo->filter_.reset( new Core::LargeVolumeFilter( lv->get_schema() ) );
+  algo->filter_->set_output_dir( this->output_dir_ );
+  algo->filter_->set_preserve_data_format( this->preserve_data_format_ );
+  SetupFilter( *algo->filter_, this->filter_, this->lower_threshold_, this->upper_threshold_,
+    this->scale_, this->offset_, this->sigma_, this->radius_ );
+
+  // Lock the src layer, so it cannot be used else where, and let it abort the filter
+  algo->lock_for_use( algo->src_layer_ );
+  algo->connect_abort( algo->src_layer_ );
+
+  // If the action is run from a script (provenance is a special case of script),
+  // return a notifier that the script engine can wait on.
+  if ( context->source() == Core::ActionSource::SCRIPT_E ||
+    context->source() == Core::ActionSource::PROVENANCE_E )
+  {
+    context->report_need_resource( algo->get_notifier() );
+  }
+
+  // NOTE: The filtered volume is written to disk and imported by a separate action, which
+  // records the undo and provenance information for the new layer.
+
+  // Start the filter.
+  Core::Runnable::Start( algo );
+
+  return true;
+}
+
+void ActionLargeVolumeFilter::Dispatch( Core::ActionContextHandle context, 
+  std::string target_layer, std::string output_dir, std::string filter, double lower_threshold,
+  double upper_threshold, double scale, double offset, double sigma, int radius,
+  bool preserve_data_format )
+{ 
+  // Create a new action
+  ActionLargeVolumeFilter* action = new ActionLargeVolumeFilter;
+
+  // Setup the parameters
+  action->target_layer_ = target_layer;
+  action->output_dir_ = output_dir;
+  action->filter_ = filter;
+  action->lower_threshold_ = lower_threshold;
+  action->upper_threshold_ = upper_threshold;
+  action->scale_ = scale;
+  action->offset_ = offset;
+  action->sigma_ = sigma;
+  action->radius_ = radius;
+  action->preserve_data_format_ = preserve_data_format;
+
+  // Dispatch action to underlying engine
+  Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
+}
+  
+} // end namespace Seg3D
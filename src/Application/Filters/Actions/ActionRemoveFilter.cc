@@ -148,14 +148,16 @@ public:
 
       // NOTE: As a shared lock is not recursive the write lock may have already locked the
       // layers we need for reading hence only lock the underlying data if the write
-      // lock does not cover it
-      if ( mask1_data_block->get_data_block() != output_mask_data_block->get_data_block() )
+      // lock does not cover it. Masks with the same grid share their lock, so the second
+      // mask does not need to be locked if the first one already is.
+      if ( &mask1_data_block->get_mutex() != &output_mask_data_block->get_mutex() )
       {
         Core::MaskDataBlock::shared_lock_type mutex(mask1_data_block->get_mutex());
         slock1.swap(mutex);
       }
     
-      if ( mask2_data_block->get_data_block() != output_mask_data_block->get_data_block() )
+      if ( &mask2_data_block->get_mutex() != &output_mask_data_block->get_mutex() &&
+        &mask2_data_block->get_mutex() != &mask1_data_block->get_mutex() )
       {
         Core::MaskDataBlock::shared_lock_type mutex(mask2_data_block->get_mutex() );
         slock2.swap(mutex);
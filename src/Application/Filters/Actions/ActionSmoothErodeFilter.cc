@@ -26,17 +26,10 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// ITK includes
-#include <itkBinaryBallStructuringElement.h>
-#include <itkBinaryErodeImageFilter.h>
-
-// Core includes
-#include <Core/DataBlock/StdDataBlock.h>
-
 // Application includes
 #include <Application/Layer/LayerManager.h>
 #include <Application/StatusBar/StatusBar.h>
-#include <Application/Filters/ITKFilter.h> // ITKFilter inherits LayerFilter
+#include <Application/Filters/MorphologyFilter.h>
 #include <Application/Filters/Actions/ActionSmoothErodeFilter.h>
 
 // REGISTER ACTION:
@@ -106,89 +99,23 @@ bool ActionSmoothErodeFilter::validate( Core::ActionContextHandle& context )
 // NOTE: The separation of the algorithm into a private class is for the purpose of running the
 // filter on a separate thread.
 
-class SmoothErodeFilterAlgo : public ITKFilter
+class SmoothErodeFilterAlgo : public MorphologyFilter
 {
 
 public:
-  LayerHandle src_layer_;
-  LayerHandle mask_layer_;
-  LayerHandle dst_layer_;
-
   int radius_;
-  bool invert_mask_;
 
-  bool only2d_;
-  int slice_type_;
-  
 public:
   // RUN_FILTER:
-  // Implemtation of run of the Runnable base class, this function is called when the thread
+  // Implementation of run of the Runnable base class, this function is called when the thread
   // is launched.
 
-  // NOTE: The macro needs a data type to select which version to run. This needs to be
-  // a member variable of the algorithm class.
-  SCI_BEGIN_TYPED_ITK_RUN( this->src_layer_->get_data_type() )
+  virtual void run_filter()
   {
-    // Define the type of filter that we use.
-    // OutputImageType same as InputImageType (mask)
-    typedef itk::BinaryBallStructuringElement< float, 3 > structuring_element_type;
-    typedef itk::BinaryErodeImageFilter
-      < TYPED_IMAGE_TYPE, TYPED_IMAGE_TYPE, structuring_element_type > filter_type;
-  
-    // Retrieve the image as an itk image from the underlying data structure
-    // NOTE: This only does wrapping and does not regenerate the data.
-    typename Core::ITKImageDataT<VALUE_TYPE>::Handle input_image; 
-    this->get_itk_image_from_layer<VALUE_TYPE>( this->src_layer_, input_image );
-
-    //
-    // Erode
-    //
-
-    // Create a new ITK filter instantiation. 
-    typename filter_type::Pointer filter = filter_type::New();
-
-    // Relay abort and progress information to the layer that is executing the filter.
-    this->forward_abort_to_filter( filter, this->dst_layer_ );
-    this->observe_itk_progress( filter, this->dst_layer_ );
-
-    // Setup the filter parameters that we do not want to change.
-    filter->SetInput( input_image->get_image() );
-
-    structuring_element_type structuring_element;
-    structuring_element.SetRadius( this->radius_ );
-    structuring_element.CreateStructuringElement();
-    filter->SetKernel( structuring_element );
-
-    filter->SetErodeValue( 1 );
-
-    // Ensure we will have some threads left for doing something else
-    this->limit_number_of_itk_threads( filter );
-
-    // Run the actual ITK filter.
-    // This needs to be in a try/catch statement as certain filters throw exceptions when they
-    // are aborted. In that case we will relay a message to the status bar for information.
-    try 
-    { 
-      filter->Update(); 
-    } 
-    catch ( ... ) 
-    {
-      if ( this->check_abort() )
-      {
-        this->report_error( "Filter was aborted." );
-        return;
-      }
-      this->report_error( "ITK filter failed to complete." );
-      return;
-    }
-
-    // As ITK filters generate an inconsistent abort behavior, we record our own abort flag
-    // This one is set when the abort button is pressed and an abort is sent to ITK.
-    if ( this->check_abort() ) return;
-
-    this->insert_itk_image_into_layer( this->dst_layer_, filter->GetOutput() ); 
+    Core::MaskMorphology morphology;
+    morphology.add_erode( Core::MorphologyShapeType::SMOOTH_BALL_E, this->radius_ );
+    this->run_morphology( morphology );
   }
-  SCI_END_TYPED_ITK_RUN()
   
   // GET_FITLER_NAME:
   // The name of the filter, this information is used for generating new layer labels.
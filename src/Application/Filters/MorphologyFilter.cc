@@ -0,0 +1,90 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// Boost includes
+#include <boost/bind.hpp>
+
+// Application includes
+#include <Application/Layer/MaskLayer.h>
+#include <Application/Filters/MorphologyFilter.h>
+
+namespace Seg3D
+{
+
+MorphologyFilter::MorphologyFilter() :
+  invert_mask_( false ),
+  only2d_( false ),
+  slice_type_( Core::SliceType::AXIAL_E )
+{
+}
+
+MorphologyFilter::~MorphologyFilter()
+{
+}
+
+void MorphologyFilter::run_morphology( Core::MaskMorphology& morphology )
+{
+  MaskLayerHandle input_mask = boost::dynamic_pointer_cast<MaskLayer>( this->src_layer_ );
+  Core::MaskVolumeHandle input_volume = input_mask->get_mask_volume();
+
+  MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( this->mask_layer_ );
+  if ( mask_layer )
+  {
+    morphology.set_constraint( mask_layer->get_mask_volume()->get_mask_data_block(),
+      this->invert_mask_ );
+  }
+
+  morphology.set_only2d( this->only2d_, 
+    static_cast<Core::SliceType::enum_type>( this->slice_type_ ) );
+  morphology.set_progress_function( boost::bind( &Layer::update_progress, 
+    this->dst_layer_.get(), _1, 0.0, 1.0 ) );
+  morphology.set_abort_function( boost::bind( &LayerFilter::check_abort, this ) );
+
+  Core::MaskDataBlockHandle output_mask;
+  if ( !( morphology.run( input_volume->get_mask_data_block(), 
+    this->src_layer_->get_grid_transform(), output_mask ) ) )
+  {
+    // Aborting is not an error, the layer filter cleans up after itself
+    if ( this->check_abort() ) return;
+    this->report_error( "Could not allocate enough memory." );
+    return;
+  }
+
+  Core::MaskVolumeHandle mask_volume( new Core::MaskVolume( 
+    this->src_layer_->get_grid_transform(), output_mask ) );
+    
+  if ( !mask_volume )
+  {
+    this->report_error( "Could not allocate enough memory." );
+    return;
+  }
+          
+  this->dispatch_insert_mask_volume_into_layer( this->dst_layer_, mask_volume );
+}
+
+} // end namespace Seg3D
@@ -0,0 +1,69 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef APPLICATION_FILTERS_MORPHOLOGYFILTER_H
+#define APPLICATION_FILTERS_MORPHOLOGYFILTER_H
+
+// Core includes
+#include <Core/DataBlock/MaskMorphology.h>
+
+// Application includes
+#include <Application/Filters/LayerFilter.h>
+
+namespace Seg3D
+{
+
+// CLASS MORPHOLOGYFILTER:
+/// Base class of the dilate and erode filters. The filters add their operations to a
+/// MaskMorphology object, this class runs it on the mask of the source layer.
+class MorphologyFilter : public LayerFilter
+{
+public:
+  MorphologyFilter();
+  virtual ~MorphologyFilter();
+
+public:
+  LayerHandle src_layer_;
+  LayerHandle mask_layer_;
+  LayerHandle dst_layer_;
+
+  bool invert_mask_;
+  
+  bool only2d_;
+  int slice_type_;
+
+protected:
+  // RUN_MORPHOLOGY:
+  /// Apply the operations of morphology to the source mask, only changing voxels inside the
+  /// mask layer if one is given, and insert the result into the destination layer.
+  void run_morphology( Core::MaskMorphology& morphology );
+};
+
+} // end namespace Seg3D
+
+#endif
@@ -38,12 +38,15 @@
 
 // system includes:
 #include <cmath>
+#include <limits>
 #include <sstream>
 
 // Application includes
 //#include <Application/Layer/LayerManager.h>
 
 #include <Core/Utils/Log.h>
+#include <Core/LargeVolume/LargeVolumeConverter.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
 
 // boost:
 #include <boost/filesystem.hpp>
@@ -54,7 +57,278 @@ CORE_REGISTER_ACTION( Seg3D, AssembleFilter )
 
 namespace Seg3D
 {
-  
+
+//----------------------------------------------------------------
+// copy_mosaic_block
+//
+// Copy an assembled block of the mosaic into a data block of
+// another pixel type, clamping the values to the range of the type.
+//
+template <typename T>
+static void
+copy_mosaic_block(const image_t * image, Core::DataBlockHandle block)
+{
+  const pixel_t * src = image->GetBufferPointer();
+  T * dst = reinterpret_cast<T *>(block->get_data());
+  const double lo = static_cast<double>(std::numeric_limits<T>::min());
+  const double hi = static_cast<double>(std::numeric_limits<T>::max());
+
+  const size_t size = block->get_size();
+  for (size_t i = 0; i < size; i++)
+  {
+    dst[i] = static_cast<T>(std::min(hi, std::max(lo, static_cast<double>(src[i]))));
+  }
+}
+
+//----------------------------------------------------------------
+// MosaicSectionSource
+//
+// Assembles the mosaic block by block for the large volume
+// converter, so that the mosaic is never held in memory as a whole.
+// The converter asks for the mosaic in bands of rows from top to
+// bottom, only the tiles overlapping the current band are loaded.
+//
+class MosaicSectionSource : public Core::LargeVolumeSectionSource
+{
+public:
+  typedef itk::LinearInterpolateImageFunction<image_t, double> img_interpolator_t;
+  typedef itk::NearestNeighborInterpolateImageFunction<mask_t, double> msk_interpolator_t;
+
+  MosaicSectionSource(const std::list<bfs::path> & in,
+                      const std::vector<base_transform_t::Pointer> & transform,
+
+                      // mosaic space tile bounding boxes:
+                      const std::vector<pnt2d_t> & tile_min,
+                      const std::vector<pnt2d_t> & tile_max,
+
+                      // mosaic space origin, spacing and width of the section:
+                      const pnt2d_t & origin,
+                      const image_t::SpacingType & spacing,
+                      const size_t nx,
+
+                      const Core::DataType data_type,
+                      const feathering_t feathering,
+                      const unsigned int shrink_factor,
+                      const double pixel_spacing,
+                      const bool use_standard_mask,
+                      const double clahe_slope):
+    in_(in.begin(), in.end()),
+    transform_(transform),
+    tile_min_(tile_min),
+    tile_max_(tile_max),
+    origin_(origin),
+    spacing_(spacing),
+    nx_(nx),
+    data_type_(data_type),
+    feathering_(feathering),
+    shrink_factor_(shrink_factor),
+    pixel_spacing_(pixel_spacing),
+    use_standard_mask_(use_standard_mask),
+    clahe_slope_(clahe_slope)
+  {
+    const unsigned int num_images = in_.size();
+    tint_.assign(num_images, 1.0);
+    omit_.assign(num_images, false);
+    image_.resize(num_images);
+    mask_.resize(num_images);
+    img_.resize(num_images);
+    msk_.resize(num_images);
+    bbox_min_.resize(num_images);
+    bbox_max_.resize(num_images);
+
+    // index all the tiles, to find the tiles that overlap a band:
+    tile_index_.setup<pnt2d_t>(tile_min_, tile_max_);
+  }
+
+  virtual bool begin_rows(index_type y_start, index_type y_end, std::string & error)
+  {
+    try
+    {
+      // mosaic space bounding box of the band, padded by a pixel:
+      const double pad = std::max(fabs(spacing_[0]), fabs(spacing_[1]));
+      std::vector<unsigned int> tiles;
+      tile_index_.find(origin_[0] - pad,
+                       origin_[1] + y_start * spacing_[1] - pad,
+                       origin_[0] + nx_ * spacing_[0] + pad,
+                       origin_[1] + (y_end - 1) * spacing_[1] + pad,
+                       tiles);
+
+      std::vector<bool> needed(image_.size(), false);
+      for (size_t k = 0; k < tiles.size(); k++)
+      {
+        needed[tiles[k]] = true;
+      }
+
+      // the bands move down the mosaic, tiles above the band
+      // are not needed again:
+      for (unsigned int i = 0; i < image_.size(); i++)
+      {
+        if (needed[i] || image_[i].IsNull()) continue;
+
+        std::cout << "unloading " << in_[i] << std::endl;
+        image_[i] = image_t::Pointer(NULL);
+        mask_[i] = mask_t::Pointer(NULL);
+        img_[i] = img_interpolator_t::Pointer(NULL);
+        msk_[i] = msk_interpolator_t::Pointer(NULL);
+      }
+
+      for (size_t k = 0; k < tiles.size(); k++)
+      {
+        const unsigned int i = tiles[k];
+        if (image_[i].IsNotNull()) continue;
+
+        image_[i] = std_tile<image_t>(in_[i], shrink_factor_, pixel_spacing_, true);
+        if (use_standard_mask_)
+        {
+          mask_[i] = std_mask<image_t>(image_[i]);
+        }
+
+        if (clahe_slope_ > 1.0)
+        {
+          image_[i] = CLAHE<image_t>(image_[i],
+                                     255,
+                                     255,
+                                     clahe_slope_,
+                                     256,
+                                     0.0,
+                                     255.0,
+                                     mask_[i]);
+        }
+
+        img_[i] = img_interpolator_t::New();
+        img_[i]->SetInputImage(image_[i]);
+
+        if (mask_[i].IsNotNull())
+        {
+          msk_[i] = msk_interpolator_t::New();
+          msk_[i]->SetInputImage(mask_[i]);
+        }
+
+        // image space bounding box (for feathering):
+        calc_image_bbox<image_t>(image_[i], bbox_min_[i], bbox_max_[i]);
+      }
+
+      // blocks of this band only visit the tiles in memory:
+      setup_mosaic_tile_index<image_t::ConstPointer, pnt2d_t>(band_index_,
+                                                              image_.size(),
+                                                              omit_,
+                                                              image_,
+                                                              tile_min_,
+                                                              tile_max_);
+      return true;
+    }
+    catch (itk::ExceptionObject & err)
+    {
+      error = err.GetDescription();
+    }
+    catch (std::exception & err)
+    {
+      error = err.what();
+    }
+    return false;
+  }
+
+  virtual bool render_block(Core::DataBlockHandle block,
+                            index_type x,
+                            index_type y,
+                            std::string & error)
+  {
+    try
+    {
+      pnt2d_t block_origin = origin_;
+      block_origin[0] += x * spacing_[0];
+      block_origin[1] += y * spacing_[1];
+
+      image_t::SizeType block_sz;
+      block_sz[0] = block->get_nx();
+      block_sz[1] = block->get_ny();
+
+      image_t::Pointer mosaic = image_t::New();
+      mosaic->SetOrigin(block_origin);
+      mosaic->SetRegions(block_sz);
+      mosaic->SetSpacing(spacing_);
+      mosaic->Allocate();
+
+      image_t::RegionType region = mosaic->GetLargestPossibleRegion();
+      const unsigned int num_blocks = calc_num_mosaic_blocks(region);
+      for (unsigned int i = 0; i < num_blocks; i++)
+      {
+        assemble_mosaic_block<image_t::ConstPointer, base_transform_t::Pointer>
+        (mosaic.GetPointer(),
+         NULL,
+         get_mosaic_block(region, i),
+         band_index_,
+         tint_,
+         transform_,
+         img_,
+         msk_,
+         bbox_min_,
+         bbox_max_,
+         tile_min_,
+         tile_max_,
+         feathering_,
+         0.0);
+      }
+
+      switch (data_type_)
+      {
+        case Core::DataType::USHORT_E:
+          copy_mosaic_block<unsigned short>(mosaic.GetPointer(), block);
+          break;
+        case Core::DataType::SHORT_E:
+          copy_mosaic_block<short>(mosaic.GetPointer(), block);
+          break;
+        default:
+          copy_mosaic_block<native_pixel_t>(mosaic.GetPointer(), block);
+          break;
+      }
+      return true;
+    }
+    catch (itk::ExceptionObject & err)
+    {
+      error = err.GetDescription();
+    }
+    catch (std::exception & err)
+    {
+      error = err.what();
+    }
+    return false;
+  }
+
+private:
+  std::vector<bfs::path> in_;
+  std::vector<base_transform_t::Pointer> transform_;
+  std::vector<pnt2d_t> tile_min_;
+  std::vector<pnt2d_t> tile_max_;
+  pnt2d_t origin_;
+  image_t::SpacingType spacing_;
+  size_t nx_;
+
+  Core::DataType data_type_;
+  feathering_t feathering_;
+  unsigned int shrink_factor_;
+  double pixel_spacing_;
+  bool use_standard_mask_;
+  double clahe_slope_;
+
+  std::vector<double> tint_;
+  std::vector<bool> omit_;
+
+  // index of all tiles, and of the tiles loaded for the current band:
+  mosaic_tile_index_t tile_index_;
+  mosaic_tile_index_t band_index_;
+
+  // tiles of the current band, the other entries are NULL:
+  std::vector<image_t::ConstPointer> image_;
+  std::vector<mask_t::ConstPointer> mask_;
+  std::vector<img_interpolator_t::Pointer> img_;
+  std::vector<msk_interpolator_t::Pointer> msk_;
+
+  // image space bounding boxes of the loaded tiles:
+  std::vector<pnt2d_t> bbox_min_;
+  std::vector<pnt2d_t> bbox_max_;
+};
+
 //class ActionAssembleFilterPrivate
 //{
 //};
@@ -218,7 +492,131 @@ ActionAssembleFilter::run( Core::ActionContextHandle& context, Core::ActionResul
       context->report_error(oss.str());
       return false;
     }
-    
+
+    if (extension == ".s3dvol")
+    {
+      fin.close();
+
+      if (this->save_variance_)
+      {
+        context->report_error("The mosaic variance can not be saved as a large volume.");
+        return false;
+      }
+      if (this->remap_values_)
+      {
+        context->report_warning("remap_values is ignored when assembling a large volume.");
+      }
+      if (! fn_mask.empty())
+      {
+        context->report_warning("The mosaic mask is not saved when assembling a large volume.");
+      }
+
+      // Only the tile bounding boxes are computed up front, the tiles
+      // themselves are loaded band by band while the mosaic is bricked.
+      image_t::PointType mosaic_min;
+      image_t::PointType mosaic_max;
+      std::vector<image_t::PointType> tile_min;
+      std::vector<image_t::PointType> tile_max;
+      calc_mosaic_bbox_load_images<image_t::ConstPointer, base_transform_t::Pointer>
+      (transform,
+       in,
+       mosaic_min,
+       mosaic_max,
+       tile_min,
+       tile_max,
+       this->shrink_factor_,
+       this->pixel_spacing_);
+
+      image_t::SpacingType mosaic_sp;
+      mosaic_sp[0] = this->shrink_factor_ * this->pixel_spacing_;
+      mosaic_sp[1] = mosaic_sp[0];
+
+      Core::DataType data_type = Core::DataType::UCHAR_E;
+      if (this->save_uint16_image_)
+      {
+        data_type = Core::DataType::USHORT_E;
+      }
+      else if (this->save_int16_image_)
+      {
+        data_type = Core::DataType::SHORT_E;
+      }
+
+      Core::LargeVolumeConverterHandle converter(new Core::LargeVolumeConverter);
+      converter->set_output_dir(fn_save);
+      converter->set_num_threads(this->num_threads_);
+      converter->get_schema()->enable_downsample(true, true, false);
+
+      // The first section sets the frame of the volume, later sections
+      // are assembled in the same frame so that they line up.
+      bool append = this->append_section_ && bfs::exists(fn_save);
+      pnt2d_t section_min = mosaic_min;
+      size_t nx = static_cast<size_t>((mosaic_max[0] - mosaic_min[0]) / mosaic_sp[0]);
+      size_t ny = static_cast<size_t>((mosaic_max[1] - mosaic_min[1]) / mosaic_sp[1]);
+      if (append)
+      {
+        Core::LargeVolumeSchemaHandle existing(new Core::LargeVolumeSchema);
+        existing->set_dir(fn_save);
+        std::string error;
+        if (! existing->load(error))
+        {
+          context->report_error(error);
+          return false;
+        }
+
+        if (fabs(existing->get_spacing().x() - mosaic_sp[0]) > 1e-6 * mosaic_sp[0])
+        {
+          context->report_error("The pixel spacing of the mosaic does not match the volume.");
+          return false;
+        }
+
+        section_min[0] = existing->get_origin().x();
+        section_min[1] = existing->get_origin().y();
+        nx = existing->get_nx();
+        ny = existing->get_ny();
+        converter->set_schema_parameters(existing->get_spacing(), existing->get_origin(),
+                                         existing->get_brick_size(), existing->get_overlap());
+      }
+      else
+      {
+        converter->set_schema_parameters(Core::Vector(mosaic_sp[0], mosaic_sp[1], mosaic_sp[0]),
+                                         Core::Point(mosaic_min[0], mosaic_min[1], 0.0),
+                                         Core::IndexVector(this->brick_size_, this->brick_size_,
+                                                           this->brick_size_),
+                                         1);
+      }
+      converter->set_append(append);
+
+      Core::LargeVolumeSectionSourceHandle source(new MosaicSectionSource(in,
+                                                                          transform,
+                                                                          tile_min,
+                                                                          tile_max,
+                                                                          section_min,
+                                                                          mosaic_sp,
+                                                                          nx,
+                                                                          data_type,
+                                                                          feathering_val,
+                                                                          this->shrink_factor_,
+                                                                          this->pixel_spacing_,
+                                                                          this->use_standard_mask_,
+                                                                          this->clahe_slope_));
+      converter->set_section_source(source, nx, ny, data_type);
+
+      std::cout << "assembling mosaic into " << fn_save << ", " << nx << " x " << ny
+                << (append ? ", appended as the next section" : "") << std::endl;
+
+      std::string error;
+      if (! converter->run_phase1(error) ||
+          ! converter->run_phase2(error) ||
+          ! converter->run_phase3(error))
+      {
+        context->report_error(error);
+        return false;
+      }
+
+      CORE_LOG_SUCCESS("ir-assemble done");
+      return true;
+    }
+
     image.resize(num_images);
     mask.resize(num_images);
     
@@ -757,6 +1155,8 @@ ActionAssembleFilter::Dispatch(Core::ActionContextHandle context,
                                bool save_variance,
                                bool remap_values,
                                bool defer_image_loading,
+                               bool append_section,
+                               unsigned int brick_size,
                                std::string input_mosaic,
                                std::string output_image,
                                std::string directory,
@@ -780,6 +1180,8 @@ ActionAssembleFilter::Dispatch(Core::ActionContextHandle context,
   action->save_variance_ = save_variance;
   action->remap_values_ = remap_values;
   action->defer_image_loading_ = defer_image_loading;
+  action->append_section_ = append_section;
+  action->brick_size_ = brick_size;
   action->input_mosaic_ = input_mosaic;
   action->output_image_ = output_image;
   action->directory_ = directory;
@@ -46,7 +46,7 @@ CORE_ACTION(
   CORE_ACTION_TYPE( "AssembleFilter", "ir-assemble" )
   CORE_ACTION_ARGUMENT( "layerid", "The layerid on which this filter needs to be run." )
   CORE_ACTION_ARGUMENT( "input_mosaic", "Input mosaic file." )
-  CORE_ACTION_ARGUMENT( "output_image", "Output image file." )
+  CORE_ACTION_ARGUMENT( "output_image", "Output image file, a .s3dvol large volume is assembled block by block." )
   CORE_ACTION_ARGUMENT( "directory", "Image file directory." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "shrink_factor", "1", "Downsample factor." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "num_threads", "0", "Number of threads used (if 0, the number of cores will be used)." )
@@ -60,6 +60,8 @@ CORE_ACTION(
   CORE_ACTION_OPTIONAL_ARGUMENT( "save_variance", "false", "" )
   CORE_ACTION_OPTIONAL_ARGUMENT( "remap_values", "false", "" )
   CORE_ACTION_OPTIONAL_ARGUMENT( "defer_image_loading", "false", "" )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "append_section", "false", "Append the mosaic as the next section of an existing .s3dvol volume." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "brick_size", "256", "Brick size of a new .s3dvol volume." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "feathering", "none", "Blend edges (none, blend, binary)." ) // none, blend, binary
   CORE_ACTION_OPTIONAL_ARGUMENT( "mask", "<none>", "Apply given mask." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "sandbox", "-1", "The sandbox in which to run the action." )
@@ -90,6 +92,8 @@ public:
     this->add_parameter( this->save_variance_ );
     this->add_parameter( this->defer_image_loading_ );
     this->add_parameter( this->remap_values_ );
+    this->add_parameter( this->append_section_ );
+    this->add_parameter( this->brick_size_ );
     this->add_parameter( this->feathering_ );
     this->add_parameter( this->mask_ );
     this->add_parameter( this->sandbox_ );
@@ -114,6 +118,8 @@ public:
                        bool save_variance,
                        bool remap_values,
                        bool defer_image_loading,
+                       bool append_section,
+                       unsigned int brick_size,
                        std::string input_mosaic,
                        std::string output_image,
                        std::string directory,
@@ -136,6 +142,8 @@ private:
   bool save_variance_;
   bool remap_values_;
   bool defer_image_loading_;
+  bool append_section_;
+  unsigned int brick_size_;
   std::string input_mosaic_;
   std::string output_image_;
   std::string directory_;
@@ -47,6 +47,7 @@
 
 #include <Core/Utils/Exception.h>
 #include <Core/Utils/Log.h>
+#include <Core/Application/Application.h>
 
 #include <exception>
 #include <string>
@@ -94,6 +95,13 @@ ActionFFTFilter::run( Core::ActionContextHandle& context, Core::ActionResultHand
     fftwf_init_threads();
     itk_fft::set_num_fftw_threads(this->num_threads_);
     
+    // reuse the fftw plans measured by earlier runs:
+    bfs::path config_dir;
+    if (Core::Application::Instance()->get_config_directory(config_dir))
+    {
+      itk_fft::set_fftw_wisdom_path((config_dir / "fftw_wisdom").string());
+    }
+    
     // parse the command line arguments:
     std::list<bfs::path> in;
     
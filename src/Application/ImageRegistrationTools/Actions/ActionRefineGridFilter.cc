@@ -40,6 +40,8 @@
 #include <Core/ITKCommon/ThreadUtils/the_boost_thread.hxx>
 #include <Core/ITKCommon/the_dynamic_array.hxx>
 
+#include <Core/Application/Application.h>
+
 // system includes:
 #include <math.h>
 #include <sstream>
@@ -246,6 +248,13 @@ ActionRefineGridFilter::run( Core::ActionContextHandle& context, Core::ActionRes
     fftwf_init_threads();
     itk_fft::set_num_fftw_threads(1);
     
+    // reuse the fftw plans measured by earlier runs:
+    bfs::path config_dir;
+    if (Core::Application::Instance()->get_config_directory(config_dir))
+    {
+      itk_fft::set_fftw_wisdom_path((config_dir / "fftw_wisdom").string());
+    }
+    
     std::list<bfs::path> in;
     std::vector<base_transform_t::Pointer> tbase;
     std::vector<image_t::Pointer> image;
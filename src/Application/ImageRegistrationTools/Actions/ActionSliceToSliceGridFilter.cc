@@ -69,6 +69,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <Core/Utils/Exception.h>
 #include <Core/Utils/Log.h>
+#include <Core/Application/Application.h>
 
 // boost:
 #include <boost/filesystem.hpp>
@@ -168,6 +169,13 @@ ActionSliceToSliceGridFilter::run( Core::ActionContextHandle& context, Core::Act
     fftwf_init_threads();
     itk_fft::set_num_fftw_threads(1);
     
+    // reuse the fftw plans measured by earlier runs:
+    bfs::path config_dir;
+    if (Core::Application::Instance()->get_config_directory(config_dir))
+    {
+      itk_fft::set_fftw_wisdom_path((config_dir / "fftw_wisdom").string());
+    }
+    
     if (this->iterations_ == 0)
     {
       CORE_LOG_ERROR("Missing iterations");
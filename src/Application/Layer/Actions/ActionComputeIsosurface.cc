@@ -61,6 +61,12 @@ bool ActionComputeIsosurface::validate( Core::ActionContextHandle& context )
     return false;
   }
 
+  if ( this->max_error_ < 0.0 )
+  {
+    context->report_error( "The maximum decimation error cannot be negative." );
+    return false;
+  }
+
   return true; // validated
 }
 
@@ -68,7 +74,8 @@ bool ActionComputeIsosurface::run( Core::ActionContextHandle& context,
   Core::ActionResultHandle& result )
 {
   MaskLayerHandle mask_layer = LayerManager::FindMaskLayer( this->layer_id_ );
-  mask_layer->compute_isosurface( this->quality_factor_, this->capping_enabled_ );
+  mask_layer->compute_isosurface( this->quality_factor_, this->capping_enabled_, 
+    this->max_faces_, this->max_error_ );
 
   /*
   Hide the abort message (if aborted).  This is a workaround for the fact that this action is
@@ -100,7 +107,8 @@ bool ActionComputeIsosurface::run( Core::ActionContextHandle& context,
 }
 
 void ActionComputeIsosurface::Dispatch( Core::ActionContextHandle context, 
-  MaskLayerHandle mask_layer, double quality_factor, bool capping_enabled, bool show )
+  MaskLayerHandle mask_layer, double quality_factor, bool capping_enabled, bool show, 
+  size_t max_faces, double max_error )
 {
   ActionComputeIsosurface* action = new ActionComputeIsosurface;
 
@@ -108,6 +116,8 @@ void ActionComputeIsosurface::Dispatch( Core::ActionContextHandle context,
   action->quality_factor_ = quality_factor;
   action->capping_enabled_ = capping_enabled;
   action->show_ = show;
+  action->max_faces_ = max_faces;
+  action->max_error_ = max_error;
 
   Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
 }
@@ -48,6 +48,8 @@ CORE_ACTION(
   CORE_ACTION_OPTIONAL_ARGUMENT( "quality_factor", "1.0", "The quality factor for mask downsampling prior to isosurface computation." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "capping", "false", "Whether isosurfaces will be capped." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "show", "true", "Whether isosurfaces will automatically made visible." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_faces", "0", "Decimate the isosurface to at most this number of faces, 0 means no limit." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "max_error", "0", "Maximum distance by which decimation may move the isosurface, 0 means no limit." )
   CORE_ACTION_CHANGES_PROJECT_DATA()
 )
   
@@ -59,6 +61,8 @@ public:
     this->add_parameter( this->quality_factor_ );
     this->add_parameter( this->capping_enabled_ );
     this->add_parameter( this->show_ );
+    this->add_parameter( this->max_faces_ );
+    this->add_parameter( this->max_error_ );
   }
   
 // -- Functions that describe action --
@@ -78,6 +82,12 @@ private:
 
   /// THis parameter describes whether the isosurface will be shown at the end of the computation
   bool show_;
+
+  /// This parameter describes the number of faces the isosurface is decimated to
+  size_t max_faces_;
+
+  /// This parameter describes the maximum error allowed when decimating the isosurface
+  double max_error_;
   
   // -- Dispatch this action from the interface --
 public:
@@ -85,7 +95,8 @@ public:
   /// DISPATCH
   /// Create and dispatch action that computes the isosurface for the selected layer
   static void Dispatch( Core::ActionContextHandle context, MaskLayerHandle mask_layer, 
-    double quality_factor, bool capping_enabled, bool show = false );
+    double quality_factor, bool capping_enabled, bool show = false, size_t max_faces = 0,
+    double max_error = 0.0 );
 
   /// DISPATCH:
   /// Create and dispatch action that computes the isosurface for the active layer.
@@ -26,20 +26,36 @@
  DEALINGS IN THE SOFTWARE.
  */
 
+// STL includes
+#include <map>
+
 // Core includes
+#include <Core/Application/Application.h>
+#include <Core/DataBlock/DataBlockDelta.h>
 #include <Core/DataBlock/DataSlice.h>
 #include <Core/DataBlock/MaskDataSlice.h>
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/DataBlock/MaskDataBlock.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/Runnable.h>
+#include <Core/Volume/DataVolume.h>
+#include <Core/Volume/MaskVolume.h>
 
 // Application includes
 #include <Application/Provenance/Provenance.h>
 #include <Application/Layer/LayerCheckPoint.h>
 #include <Application/Layer/LayerManager.h>
+#include <Application/Layer/DataLayer.h>
+#include <Application/Layer/MaskLayer.h>
+#include <Application/UndoBuffer/UndoBuffer.h>
 
 // Boost includes
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace Seg3D
 {
@@ -56,14 +72,449 @@ public:
 
   typedef std::vector<Core::MaskDataSliceHandle> mask_slice_vector_type;
   mask_slice_vector_type mask_slices_;
+
+  // Check point consisting of the differences with the data of the layer at the time the
+  // next check point of the layer was made. Until the next check point is made, the full data
+  // is kept, as the data of the layer is still changing.
+  Core::DataBlockDeltaHandle volume_delta_;
+  typedef std::vector<Core::DataBlockDeltaHandle> delta_vector_type;
+  delta_vector_type slice_deltas_;
+  std::vector<Core::DataBlock::index_type> slice_indices_;
+  Core::SliceType slice_type_;
   
   ProvenanceID provenance_id_;
+
+  // The layer the check point was made of
+  LayerWeakHandle layer_;
+
+  // The volume can be moved to disk, this mutex protects volume_ and the information on the
+  // file it was written to, as the file is written and read on separate threads
+  boost::mutex disk_mutex_;
+
+  // The file the volume is written to, empty if the volume is only in memory
+  boost::filesystem::path disk_file_;
+
+  // Size of the file, or of the volume while it is being written
+  size_t disk_size_;
+
+  // Whether the file has been written and the volume has been released
+  bool on_disk_;
+
+  // Whether the file is being read to restore the volume
+  bool loading_;
+
+  // Whether the check point was deleted while the file was being written or read
+  bool discarded_;
+
+  // Whether the volume on disk is a mask volume
+  bool mask_on_disk_;
+
+public:
+  LayerCheckPointPrivate() :
+    slice_type_( Core::SliceType::AXIAL_E ),
+    disk_size_( 0 ),
+    on_disk_( false ),
+    loading_( false ),
+    discarded_( false ),
+    mask_on_disk_( false )
+  {
+  }
+
+  // WRITE_VOLUME:
+  // Write the volume to disk and release it from memory. This function is run on a
+  // separate thread.
+  void write_volume( Core::VolumeHandle volume );
+
+  // READ_VOLUME:
+  // Read the volume back from disk, the progress function is called with the fraction of the
+  // file that has been read.
+  bool read_volume( Core::VolumeHandle& volume, 
+    boost::function< void ( double ) > progress = boost::function< void ( double ) >() );
+
+  // DISCARD:
+  // Remove the file of the check point once it is not used anymore.
+  void discard();
+
+  // REPLACE_PREVIOUS_CHECK_POINT:
+  // Make this the latest check point of the layer, and replace the data of the previous one by
+  // the differences with the current data of the layer.
+  void replace_previous_check_point( LayerHandle layer );
+
+  // UNREGISTER:
+  // Remove this check point from the list of latest check points.
+  void unregister();
+
+  // CREATE_DELTAS:
+  // Replace the data of this check point with the differences with the current data of the
+  // layer, if that uses less memory.
+  void create_deltas( LayerHandle layer );
+
+  // APPLY_DELTAS:
+  // Restore the data of the check point from the current data of the layer.
+  bool apply_deltas( LayerHandle layer ) const;
+
+  // The latest check point of each layer
+  typedef std::map< Layer*, LayerCheckPointPrivate* > check_point_map_type;
+  static check_point_map_type LatestCheckPoints;
+  static boost::mutex LatestCheckPointsMutex;
 };
 
+LayerCheckPointPrivate::check_point_map_type LayerCheckPointPrivate::LatestCheckPoints;
+boost::mutex LayerCheckPointPrivate::LatestCheckPointsMutex;
+
+void LayerCheckPointPrivate::replace_previous_check_point( LayerHandle layer )
+{
+  this->layer_ = layer;
+
+  boost::mutex::scoped_lock lock( LatestCheckPointsMutex );
+  check_point_map_type::iterator it = LatestCheckPoints.find( layer.get() );
+  if ( it != LatestCheckPoints.end() )
+  {
+    // NOTE: As long as this check point is the latest one of the layer, each undo of a later
+    // operation restores the layer to its current data. Hence the differences with the
+    // current data are enough to undo the operation of the previous check point.
+    if ( it->second->layer_.lock() == layer ) it->second->create_deltas( layer );
+  }
+  LatestCheckPoints[ layer.get() ] = this;
+}
+
+void LayerCheckPointPrivate::unregister()
+{
+  boost::mutex::scoped_lock lock( LatestCheckPointsMutex );
+  check_point_map_type::iterator it = LatestCheckPoints.begin();
+  while ( it != LatestCheckPoints.end() )
+  {
+    if ( it->second == this ) LatestCheckPoints.erase( it++ );
+    else ++it;
+  }
+}
+
+void LayerCheckPointPrivate::create_deltas( LayerHandle layer )
+{
+  // NOTE: A volume that was moved to disk is kept as is
+  boost::mutex::scoped_lock lock( this->disk_mutex_ );
+  if ( !this->disk_file_.empty() ) return;
+
+  if ( !layer->has_valid_data() ) return;
+
+  if ( this->volume_ )
+  {
+    Core::DataBlockDeltaHandle delta;
+    if ( layer->get_type() == Core::VolumeType::MASK_E )
+    {
+      Core::MaskVolumeHandle old_volume = 
+        boost::dynamic_pointer_cast<Core::MaskVolume>( this->volume_ );
+      Core::MaskVolumeHandle new_volume = 
+        boost::dynamic_pointer_cast<MaskLayer>( layer )->get_mask_volume();
+      if ( !old_volume || !old_volume->is_valid() || old_volume == new_volume ) return;
+      if ( !Core::DataBlockDelta::Create( old_volume->get_mask_data_block(), 
+        new_volume->get_mask_data_block(), delta ) ) return;
+    }
+    else if ( layer->get_type() == Core::VolumeType::DATA_E )
+    {
+      Core::DataVolumeHandle old_volume = 
+        boost::dynamic_pointer_cast<Core::DataVolume>( this->volume_ );
+      Core::DataVolumeHandle new_volume = 
+        boost::dynamic_pointer_cast<DataLayer>( layer )->get_data_volume();
+      if ( !old_volume || !old_volume->is_valid() || old_volume == new_volume ) return;
+      if ( !Core::DataBlockDelta::Create( old_volume->get_data_block(), 
+        new_volume->get_data_block(), delta ) ) return;
+    }
+
+    if ( delta && delta->get_byte_size() < this->volume_->get_byte_size() )
+    {
+      this->volume_delta_ = delta;
+      this->volume_.reset();
+    }
+    return;
+  }
+
+  delta_vector_type deltas;
+  std::vector<Core::DataBlock::index_type> indices;
+  size_t slice_size = 0;
+  size_t delta_size = 0;
+
+  if ( !this->mask_slices_.empty() )
+  {
+    Core::MaskVolumeHandle volume = boost::dynamic_pointer_cast<MaskLayer>( layer )->
+      get_mask_volume();
+    for ( size_t j = 0; j < this->mask_slices_.size(); j++ )
+    {
+      Core::MaskDataSliceHandle old_slice = this->mask_slices_[ j ];
+      Core::MaskDataSliceHandle new_slice;
+      Core::DataBlockDeltaHandle delta;
+      if ( !volume->extract_slice( old_slice->get_slice_type(), old_slice->get_index(), 
+        new_slice ) ) return;
+      if ( !Core::DataBlockDelta::Create( old_slice->get_mask_data_block(), 
+        new_slice->get_mask_data_block(), delta ) ) return;
+
+      deltas.push_back( delta );
+      indices.push_back( old_slice->get_index() );
+      slice_size += old_slice->get_byte_size();
+      delta_size += delta->get_byte_size();
+      this->slice_type_ = old_slice->get_slice_type();
+    }
+  }
+  else if ( !this->data_slices_.empty() )
+  {
+    Core::DataVolumeHandle volume = boost::dynamic_pointer_cast<DataLayer>( layer )->
+      get_data_volume();
+    for ( size_t j = 0; j < this->data_slices_.size(); j++ )
+    {
+      Core::DataSliceHandle old_slice = this->data_slices_[ j ];
+      Core::DataSliceHandle new_slice;
+      Core::DataBlockDeltaHandle delta;
+      if ( !volume->extract_slice( old_slice->get_slice_type(), old_slice->get_index(), 
+        new_slice ) ) return;
+      if ( !Core::DataBlockDelta::Create( old_slice->get_data_block(), 
+        new_slice->get_data_block(), delta ) ) return;
+
+      deltas.push_back( delta );
+      indices.push_back( old_slice->get_index() );
+      slice_size += old_slice->get_byte_size();
+      delta_size += delta->get_byte_size();
+      this->slice_type_ = old_slice->get_slice_type();
+    }
+  }
+
+  if ( !deltas.empty() && delta_size < slice_size )
+  {
+    this->slice_deltas_.swap( deltas );
+    this->slice_indices_.swap( indices );
+    this->mask_slices_.clear();
+    this->data_slices_.clear();
+  }
+}
+
+bool LayerCheckPointPrivate::apply_deltas( LayerHandle layer ) const
+{
+  if ( this->volume_delta_ )
+  {
+    Core::VolumeHandle volume;
+    if ( layer->get_type() == Core::VolumeType::MASK_E )
+    {
+      Core::MaskVolumeHandle mask_volume;
+      if ( !Core::MaskVolume::DuplicateMask( boost::dynamic_pointer_cast<MaskLayer>( layer )->
+        get_mask_volume(), mask_volume ) ) return false;
+      if ( !this->volume_delta_->apply( mask_volume->get_mask_data_block() ) ) return false;
+      volume = mask_volume;
+    }
+    else
+    {
+      Core::DataVolumeHandle data_volume;
+      if ( !Core::DataVolume::DuplicateVolume( boost::dynamic_pointer_cast<DataLayer>( layer )->
+        get_data_volume(), data_volume ) ) return false;
+      if ( !this->volume_delta_->apply( data_volume->get_data_block() ) ) return false;
+      volume = data_volume;
+    }
+
+    LayerManager::DispatchInsertVolumeIntoLayer( layer, volume, this->provenance_id_ );
+    return true;
+  }
+
+  if ( layer->get_type() == Core::VolumeType::MASK_E )
+  {
+    MaskLayerHandle mask_layer = boost::dynamic_pointer_cast<MaskLayer>( layer );
+    mask_slice_vector_type slices;
+    for ( size_t j = 0; j < this->slice_deltas_.size(); j++ )
+    {
+      Core::MaskDataSliceHandle slice;
+      if ( !mask_layer->get_mask_volume()->extract_slice( this->slice_type_, 
+        this->slice_indices_[ j ], slice ) ) return false;
+      if ( !this->slice_deltas_[ j ]->apply( slice->get_mask_data_block() ) ) return false;
+      slices.push_back( slice );
+    }
+
+    LayerManager::DispatchInsertMaskSlicesIntoLayer( mask_layer, slices, 
+      this->provenance_id_ );
+  }
+  else if ( layer->get_type() == Core::VolumeType::DATA_E )
+  {
+    DataLayerHandle data_layer = boost::dynamic_pointer_cast<DataLayer>( layer );
+    data_slice_vector_type slices;
+    for ( size_t j = 0; j < this->slice_deltas_.size(); j++ )
+    {
+      Core::DataSliceHandle slice;
+      if ( !data_layer->get_data_volume()->extract_slice( this->slice_type_, 
+        this->slice_indices_[ j ], slice ) ) return false;
+      if ( !this->slice_deltas_[ j ]->apply( slice->get_data_block() ) ) return false;
+      slices.push_back( slice );
+    }
+
+    LayerManager::DispatchInsertDataSlicesIntoLayer( data_layer, slices, 
+      this->provenance_id_ );
+  }
+  return true;
+}
+
+// Only one check point is written at a time, so the disk is not saturated by check points
+// when many of them are moved to disk at once
+static boost::mutex WriteMutex;
+
+void LayerCheckPointPrivate::write_volume( Core::VolumeHandle volume )
+{
+  boost::mutex::scoped_lock write_lock( WriteMutex );
+
+  std::string error;
+  bool success = false;
+  if ( this->mask_on_disk_ )
+  {
+    success = Core::MaskVolume::SaveMaskVolume( this->disk_file_, 
+      boost::dynamic_pointer_cast<Core::MaskVolume>( volume ), error, true, 1 );
+  }
+  else
+  {
+    Core::DataVolumeHandle data_volume = boost::dynamic_pointer_cast<Core::DataVolume>( volume );
+    success = Core::DataVolume::SaveDataVolume( this->disk_file_, data_volume, error, true, 1 );
+  }
+
+  boost::mutex::scoped_lock lock( this->disk_mutex_ );
+  if ( !success )
+  {
+    // Keep the volume in memory, the undo buffer will drop the check point if there is not
+    // enough memory for it
+    CORE_LOG_ERROR( "Could not move undo check point to disk: " + error );
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->disk_file_, ec );
+    this->disk_file_ = boost::filesystem::path();
+    this->disk_size_ = 0;
+    return;
+  }
+
+  if ( this->discarded_ )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->disk_file_, ec );
+    return;
+  }
+
+  boost::system::error_code ec;
+  boost::uintmax_t file_size = boost::filesystem::file_size( this->disk_file_, ec );
+  if ( !ec ) this->disk_size_ = static_cast<size_t>( file_size );
+  this->on_disk_ = true;
+  this->volume_.reset();
+}
+
+bool LayerCheckPointPrivate::read_volume( Core::VolumeHandle& volume, 
+  boost::function< void ( double ) > progress )
+{
+  std::string error;
+  bool success = false;
+  if ( this->mask_on_disk_ )
+  {
+    Core::MaskVolumeHandle mask_volume;
+    success = Core::MaskVolume::LoadMaskVolume( this->disk_file_, mask_volume, error, 
+      progress );
+    volume = mask_volume;
+  }
+  else
+  {
+    Core::DataVolumeHandle data_volume;
+    success = Core::DataVolume::LoadDataVolume( this->disk_file_, data_volume, error, 
+      progress );
+    volume = data_volume;
+  }
+
+  if ( !success )
+  {
+    CORE_LOG_ERROR( "Could not read undo check point from disk: " + error );
+  }
+
+  boost::mutex::scoped_lock lock( this->disk_mutex_ );
+  this->loading_ = false;
+  if ( this->discarded_ )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->disk_file_, ec );
+  }
+  return success;
+}
+
+void LayerCheckPointPrivate::discard()
+{
+  boost::mutex::scoped_lock lock( this->disk_mutex_ );
+  this->discarded_ = true;
+
+  // NOTE: If the file is still being written or read, the thread that does so removes it
+  if ( this->on_disk_ && !this->loading_ )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove( this->disk_file_, ec );
+  }
+}
+
+// CLASS LAYERCHECKPOINTWRITER:
+// Writes the volume of a check point to disk in the background.
+class LayerCheckPointWriter : public Core::Runnable
+{
+public:
+  LayerCheckPointWriter( LayerCheckPointPrivateHandle check_point, Core::VolumeHandle volume ) :
+    check_point_( check_point ),
+    volume_( volume )
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    this->check_point_->write_volume( this->volume_ );
+  }
+
+private:
+  LayerCheckPointPrivateHandle check_point_;
+  Core::VolumeHandle volume_;
+};
+
+// CLASS LAYERCHECKPOINTREADER:
+// Reads the volume of a check point from disk in the background and inserts it into the layer,
+// which is locked for processing in the meantime so its progress is shown.
+class LayerCheckPointReader : public Core::Runnable
+{
+public:
+  LayerCheckPointReader( LayerCheckPointPrivateHandle check_point, LayerHandle layer,
+    Layer::filter_key_type key ) :
+    check_point_( check_point ),
+    layer_( layer ),
+    key_( key )
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    this->layer_->update_progress( 0.0 );
+
+    Core::VolumeHandle volume;
+    if ( this->check_point_->read_volume( volume, boost::bind( &Layer::update_progress, 
+      this->layer_, _1, 0.0, 1.0 ) ) )
+    {
+      this->layer_->update_progress( 1.0 );
+      LayerManager::DispatchInsertVolumeIntoLayer( this->layer_, volume, 
+        this->check_point_->provenance_id_, this->key_ );
+    }
+    else
+    {
+      CORE_LOG_ERROR( "Could not restore the data of layer '" + 
+        this->layer_->get_layer_name() + "' from its undo check point." );
+    }
+    LayerManager::DispatchUnlockLayer( this->layer_, this->key_ );
+
+    // NOTE: This is posted after the volume is inserted, so the undo buffer accepts the next
+    // step only once the data is restored
+    Core::Application::PostEvent( boost::bind( &UndoBuffer::end_restore, 
+      UndoBuffer::Instance() ) );
+  }
+
+private:
+  LayerCheckPointPrivateHandle check_point_;
+  LayerHandle layer_;
+  Layer::filter_key_type key_;
+};
 
 LayerCheckPoint::LayerCheckPoint( LayerHandle layer ) :
   private_( new LayerCheckPointPrivate )
 {
+  this->private_->replace_previous_check_point( layer );
   this->create_volume( layer );
 }
 
@@ -71,6 +522,7 @@ LayerCheckPoint::LayerCheckPoint( LayerHandle layer,
   Core::SliceType type, Core::DataBlock::index_type index ) :
   private_( new LayerCheckPointPrivate )
 {
+  this->private_->replace_previous_check_point( layer );
   this->create_slice( layer, type, index );
 }
 
@@ -78,19 +530,62 @@ LayerCheckPoint::LayerCheckPoint( LayerHandle layer, Core::SliceType type,
   Core::DataBlock::index_type start, Core::DataBlock::index_type end  ) :
   private_( new LayerCheckPointPrivate )
 {
+  this->private_->replace_previous_check_point( layer );
   this->create_slice( layer, type, start, end );
 }
 
 LayerCheckPoint::~LayerCheckPoint()
 {
+  this->private_->unregister();
+  this->private_->discard();
 }
   
 bool LayerCheckPoint::apply( LayerHandle layer ) const
 {
+  // If the check point only contains differences, restore it from the current data
+  if ( this->private_->volume_delta_ || !( this->private_->slice_deltas_.empty() ) )
+  {
+    if ( !this->private_->apply_deltas( layer ) )
+    {
+      CORE_LOG_ERROR( "The data of layer '" + layer->get_layer_name() + 
+        "' changed since the check point was made, it cannot be restored." );
+      return false;
+    }
+    // NOTE: As for full check points, only volumes report that they were applied
+    return this->private_->volume_delta_.get() != 0;
+  }
+
+  Core::VolumeHandle volume;
+  bool on_disk = false;
+  {
+    boost::mutex::scoped_lock lock( this->private_->disk_mutex_ );
+    volume = this->private_->volume_;
+    on_disk = this->private_->on_disk_ && !this->private_->loading_;
+    if ( on_disk ) this->private_->loading_ = true;
+  }
+
+  // If the volume was moved to disk read it back in the background, so the interface stays
+  // responsive while the layer shows the progress
+  if ( on_disk )
+  {
+    Layer::filter_key_type key = Layer::GenerateFilterKey();
+    if ( Core::Application::IsApplicationThread() && 
+      LayerManager::LockForProcessing( layer, key ) )
+    {
+      UndoBuffer::Instance()->begin_restore();
+      Core::RunnableHandle reader( new LayerCheckPointReader( this->private_, layer, key ) );
+      Core::Runnable::Start( reader );
+      return true;
+    }
+
+    // If the layer cannot be locked, read the volume right away
+    if ( !this->private_->read_volume( volume ) ) return false;
+  }
+
   // If there is a full volume in the check point insert it into the layer
-  if ( this->private_->volume_ )
+  if ( volume )
   {
-    LayerManager::DispatchInsertVolumeIntoLayer( layer, this->private_->volume_, 
+    LayerManager::DispatchInsertVolumeIntoLayer( layer, volume, 
       this->private_->provenance_id_ );
     return true;
   }
@@ -198,7 +693,19 @@ bool LayerCheckPoint::create_slice( LayerHandle layer, Core::SliceType type,
 size_t LayerCheckPoint::get_byte_size() const
 {
   size_t size = 0;
-  if ( this->private_->volume_ ) size += this->private_->volume_->get_byte_size();
+  {
+    // NOTE: A volume that is being written to disk is counted as released
+    boost::mutex::scoped_lock lock( this->private_->disk_mutex_ );
+    if ( this->private_->volume_ && this->private_->disk_file_.empty() ) 
+    {
+      size += this->private_->volume_->get_byte_size();
+    }
+  }
+  if ( this->private_->volume_delta_ ) size += this->private_->volume_delta_->get_byte_size();
+  for ( size_t j = 0; j < this->private_->slice_deltas_.size(); j++ )
+  {
+    size += this->private_->slice_deltas_[ j ]->get_byte_size();
+  }
 
   {
     LayerCheckPointPrivate::data_slice_vector_type::iterator it = this->private_->data_slices_.begin();
@@ -224,5 +731,32 @@ size_t LayerCheckPoint::get_byte_size() const
   return size;
 }
 
-  
+size_t LayerCheckPoint::get_disk_byte_size() const
+{
+  boost::mutex::scoped_lock lock( this->private_->disk_mutex_ );
+  if ( this->private_->disk_file_.empty() ) return 0;
+  return this->private_->disk_size_;
+}
+
+bool LayerCheckPoint::move_to_disk( const boost::filesystem::path& directory )
+{
+  boost::mutex::scoped_lock lock( this->private_->disk_mutex_ );
+
+  // NOTE: Only full volumes are moved to disk, slices and differences are small enough to
+  // keep in memory
+  if ( !this->private_->volume_ || !this->private_->disk_file_.empty() ) return false;
+
+  this->private_->mask_on_disk_ = 
+    this->private_->volume_->get_type() == Core::VolumeType::MASK_E;
+  this->private_->disk_file_ = directory / 
+    boost::filesystem::unique_path( "%%%%-%%%%-%%%%-%%%%.nrrd" );
+  this->private_->disk_size_ = this->private_->volume_->get_byte_size();
+
+  Core::RunnableHandle writer( new LayerCheckPointWriter( this->private_, 
+    this->private_->volume_ ) );
+  Core::Runnable::Start( writer );
+
+  return true;
+}
+
 } // end namespace Seg3D
@@ -30,6 +30,7 @@
 #define APPLICATION_LAYER_LAYERCHECKPOINT_H 
 
 // Boost includes
+#include <boost/filesystem/path.hpp>
 #include <boost/smart_ptr.hpp> 
 #include <boost/utility.hpp> 
  
@@ -91,8 +92,20 @@ public:
     Core::DataBlock::index_type start, Core::DataBlock::index_type end );
   
   /// GET_BYTE_SIZE:
-  /// Get the size of the check point
+  /// Get the size of the check point in memory
   size_t get_byte_size() const;
+
+  // -- moving check points to disk --
+public:
+  /// MOVE_TO_DISK:
+  /// Write the volume of the check point to a file in the directory and release it from memory
+  /// once it is written. The file is written in the background and read back when the check
+  /// point is applied. Returns false if there is no volume to move.
+  bool move_to_disk( const boost::filesystem::path& directory );
+
+  /// GET_DISK_BYTE_SIZE:
+  /// Get the size of the check point on disk
+  size_t get_disk_byte_size() const;
   
         // -- internals --
 private:
@@ -93,6 +93,15 @@ public:
   // This function keeps track off when layer data is changed.
   void handle_layer_data_changed( LayerWeakHandle layer );
 
+  // HANDLE_MASKS_FRAGMENTED:
+  // This function is connected to the fragmented_signal_ of MaskDataBlockManager, which can be
+  // triggered from any thread, and schedules compaction on the application thread.
+  void handle_masks_fragmented();
+
+  // COMPACT_MASKS:
+  // Compact the masks if none of the layers is being processed.
+  void compact_masks();
+
   // FIND_FREE_COLOR:
   // Find a color that has not yet been used.
   int find_free_color();
@@ -195,6 +204,37 @@ void LayerManagerPrivate::handle_layer_data_changed( LayerWeakHandle layer_weak_
   }
 }
 
+void LayerManagerPrivate::handle_masks_fragmented()
+{
+  // NOTE: Deleting several masks triggers this signal for each of them, a single compaction
+  // afterwards is enough
+  Core::Application::PostCoalescedEvent( this, boost::bind( &LayerManagerPrivate::compact_masks, 
+    this->layer_manager_->private_ ) );
+}
+
+void LayerManagerPrivate::compact_masks()
+{
+  ASSERT_IS_APPLICATION_THREAD();
+
+  if ( !Core::MaskDataBlockManager::Instance()->is_fragmented() ) return;
+
+  // Filters and scripts keep pointers to the mask data while they run, so masks can only be
+  // moved when no layer is in use. Compaction is requested again when the next mask is released.
+  {
+    LayerManager::lock_type lock( this->layer_manager_->get_mutex() );
+    if ( !this->sandboxes_.empty() ) return;
+  }
+
+  std::vector< LayerHandle > layers;
+  this->layer_manager_->get_layers( layers );
+  for ( size_t j = 0; j < layers.size(); j++ )
+  {
+    if ( layers[ j ]->data_state_->get() != Layer::AVAILABLE_C ) return;
+  }
+
+  Core::MaskDataBlockManager::Instance()->compact();
+}
+
 int LayerManagerPrivate::find_free_color()
 {
   std::set< int > used_colors;
@@ -256,6 +296,8 @@ LayerManager::LayerManager() :
     &LayerManagerPrivate::handle_active_layer_state_changed, this->private_, _2 ) ) );
   this->add_connection( Core::Application::Instance()->reset_signal_.connect( boost::bind(
     &LayerManagerPrivate::reset, this->private_ ) ) );
+  this->add_connection( Core::MaskDataBlockManager::Instance()->fragmented_signal_.connect( 
+    boost::bind( &LayerManagerPrivate::handle_masks_fragmented, this->private_ ) ) );
 }
 
 LayerManager::~LayerManager()
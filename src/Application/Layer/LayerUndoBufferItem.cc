@@ -364,6 +364,29 @@ void LayerUndoBufferItem::compute_size()
   this->private_->size_ = size;
 }
 
+size_t LayerUndoBufferItem::get_disk_byte_size() const
+{
+  size_t size = 0;
+  for ( size_t j = 0; j < this->private_->layers_to_restore_.size(); j++ )
+  {
+    size += this->private_->layers_to_restore_[ j ].second->get_disk_byte_size();
+  }
+  return size;
+}
+
+bool LayerUndoBufferItem::move_to_disk( const boost::filesystem::path& directory )
+{
+  bool moved = false;
+  for ( size_t j = 0; j < this->private_->layers_to_restore_.size(); j++ )
+  {
+    if ( this->private_->layers_to_restore_[ j ].second->move_to_disk( directory ) ) 
+    {
+      moved = true;
+    }
+  }
+  return moved;
+}
+
 void LayerUndoBufferItem::add_id_count_to_restore( LayerManager::id_count_type id_count )
 {
     this->private_->id_count_ = id_count;
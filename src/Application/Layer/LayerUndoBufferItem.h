@@ -116,6 +116,14 @@ public:
   /// Compute the size of the item
   virtual void compute_size();
 
+  /// GET_DISK_BYTE_SIZE:
+  /// The size of the check points that were moved to disk ( approximately )
+  virtual size_t get_disk_byte_size() const;
+
+  /// MOVE_TO_DISK:
+  /// Move the check points of the layers to disk
+  virtual bool move_to_disk( const boost::filesystem::path& directory );
+
   // -- internals --
 private:
   LayerUndoBufferItemPrivateHandle private_;
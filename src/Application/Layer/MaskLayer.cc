@@ -52,6 +52,11 @@ class MaskLayerPrivate
 {
   // -- internal functions --
 public:
+  MaskLayerPrivate() :
+    loaded_generation_( -1 )
+  {
+  }
+
   void initialize_states();
   void handle_mask_data_changed();
   void handle_isosurface_update_progress( double progress );
@@ -63,6 +68,10 @@ public:
   // need to be loaded.
   Core::StateIntHandle   bit_state_;
 
+  // The generation of the datablock after the mask was loaded from its own file. As long as
+  // the datablock keeps this generation, the mask does not need to be saved again.
+  Core::DataBlock::generation_type loaded_generation_;
+
   // Information about two components not included in the state manager.
   Core::MaskVolumeHandle mask_volume_;
   Core::IsosurfaceHandle isosurface_;
@@ -285,13 +294,29 @@ bool MaskLayer::set_mask_volume( Core::MaskVolumeHandle volume )
 bool MaskLayer::pre_save_states( Core::StateIO& state_io )
 {
   long long generation_number = this->get_mask_volume()->get_generation();
-  this->generation_state_->set( generation_number );
+  if ( generation_number != this->private_->loaded_generation_ )
+  {
+    this->private_->loaded_generation_ = -1;
+    this->generation_state_->set( generation_number );
+    // The mask may have been moved to a different bitplane when the masks were compacted
+    this->private_->bit_state_->set( static_cast< int >( 
+      this->get_mask_volume()->get_mask_data_block()->get_mask_bit() ) );
+  }
+  else
+  {
+    // The mask has not changed since it was loaded, so it is still in the file it was
+    // loaded from.
+    generation_number = this->generation_state_->get();
+  }
 
   // Add the number to the project so it can be recorded into the session database
   ProjectManager::Instance()->get_current_project()->add_generation_number( generation_number );
   
+  // NOTE: Each mask is saved in its own file with only its bitplane, as saving the whole
+  // datablock writes the same data for every mask that shares it.
   boost::filesystem::path data_file = ProjectManager::Instance()->get_current_project()->
-    get_project_data_path() / ( this->generation_state_->export_to_string() + ".nrrd" );
+    get_project_data_path() / ( this->generation_state_->export_to_string() + "_" + 
+    this->private_->bit_state_->export_to_string() + ".nrrd" );
   if ( boost::filesystem::exists( data_file ) )
   {
     // File has already been saved
@@ -301,13 +326,9 @@ bool MaskLayer::pre_save_states( Core::StateIO& state_io )
   bool compress = PreferencesManager::Instance()->compression_state_->get();
   int level = PreferencesManager::Instance()->compression_level_state_->get();
 
-  Core::DataBlockHandle data_block = this->get_mask_volume()->
-    get_mask_data_block()->get_data_block();
-  Core::NrrdDataHandle nrrd( new Core::NrrdData( data_block, this->get_grid_transform() ) );
-
   std::string error;
-  Core::DataBlock::shared_lock_type slock( data_block->get_mutex() );
-  if ( !Core::NrrdData::SaveNrrd( data_file.string(), nrrd, error, compress, level ) )
+  if ( !Core::MaskVolume::SaveMaskVolume( data_file, this->get_mask_volume(), error, 
+    compress, level ) )
   {
     CORE_LOG_ERROR( error );
     return false;
@@ -322,22 +343,49 @@ bool MaskLayer::post_load_states( const Core::StateIO& state_io )
   unsigned int bit = static_cast< unsigned int >( this->private_->bit_state_->get() );
   Core::MaskDataBlockHandle mask_data_block;
   Core::GridTransform grid_transform;
-  bool success = Core::MaskDataBlockManager::Instance()->
-    create( generation, bit, grid_transform, mask_data_block );
-  if ( !success )
+  boost::filesystem::path data_path = ProjectManager::Instance()->get_current_project()->
+    get_project_data_path();
+  boost::filesystem::path mask_path = data_path / ( this->generation_state_->export_to_string() +
+    "_" + this->private_->bit_state_->export_to_string() + ".nrrd" );
+
+  bool success = false;
+  bool loaded_mask_file = false;
+  if ( boost::filesystem::exists( mask_path ) )
   {
-    Core::DataVolumeHandle data_volume;
-    boost::filesystem::path volume_path = ProjectManager::Instance()->get_current_project()->
-      get_project_data_path() / ( this->generation_state_->export_to_string() + ".nrrd" );
+    Core::MaskVolumeHandle mask_volume;
     std::string error;
-
-    if( Core::DataVolume::LoadDataVolume( volume_path, data_volume, error ) )
+    if ( Core::MaskVolume::LoadMaskVolume( mask_path, mask_volume, error ) )
+    {
+      mask_data_block = mask_volume->get_mask_data_block();
+      grid_transform = mask_volume->get_grid_transform();
+      success = true;
+      loaded_mask_file = true;
+    }
+    else
+    {
+      CORE_LOG_ERROR( error );
+    }
+  }
+  else
+  {
+    // Older projects save the whole datablock that is shared by several masks
+    success = Core::MaskDataBlockManager::Instance()->
+      create( generation, bit, grid_transform, mask_data_block );
+    if ( !success )
     {
-      data_volume->register_data( generation );
-      Core::MaskDataBlockManager::Instance()->register_data_block( 
-        data_volume->get_data_block(), data_volume->get_grid_transform() );
-      success = Core::MaskDataBlockManager::Instance()->
-        create( generation, bit, grid_transform, mask_data_block );
+      Core::DataVolumeHandle data_volume;
+      boost::filesystem::path volume_path = data_path / 
+        ( this->generation_state_->export_to_string() + ".nrrd" );
+      std::string error;
+
+      if( Core::DataVolume::LoadDataVolume( volume_path, data_volume, error ) )
+      {
+        data_volume->register_data( generation );
+        Core::MaskDataBlockManager::Instance()->register_data_block( 
+          data_volume->get_data_block(), data_volume->get_grid_transform() );
+        success = Core::MaskDataBlockManager::Instance()->
+          create( generation, bit, grid_transform, mask_data_block );
+      }
     }
   }
 
@@ -345,6 +393,18 @@ bool MaskLayer::post_load_states( const Core::StateIO& state_io )
   {
     this->private_->mask_volume_ = Core::MaskVolumeHandle( new Core::MaskVolume( 
       grid_transform, mask_data_block ) );
+    if ( loaded_mask_file )
+    {
+      // Loading a mask does not alter the other masks in its datablock, hence a datablock that
+      // has already been registered keeps its generation. Otherwise the mask keeps the
+      // generation it was saved with, as a new one could be a generation that a data layer of
+      // the session registers later on.
+      if ( mask_data_block->get_generation() == -1 )
+      {
+        this->private_->mask_volume_->register_data( generation );
+      }
+      this->private_->loaded_generation_ = this->private_->mask_volume_->get_generation();
+    }
     this->add_connection( this->private_->mask_volume_->get_mask_data_block()->mask_updated_signal_.
       connect( boost::bind( &MaskLayerPrivate::handle_mask_data_changed, this->private_ ) ) );
     this->private_->update_mask_info();
@@ -387,12 +447,13 @@ Core::IsosurfaceHandle MaskLayer::get_isosurface()
   return this->private_->isosurface_;
 }
 
-void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled )
+void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled, 
+  size_t max_faces, double max_error )
 {
   if ( !Core::Application::IsApplicationThread() )
   {
     Core::Application::PostEvent( boost::bind( &MaskLayer::compute_isosurface, 
-      this, quality_factor, capping_enabled ) );
+      this, quality_factor, capping_enabled, max_faces, max_error ) );
     return;
   }
   
@@ -408,7 +469,8 @@ void MaskLayer::compute_isosurface( double quality_factor, bool capping_enabled
   this->data_state_->set( Layer::PROCESSING_C );
 
   this->reset_abort();
-  iso->compute( quality_factor, capping_enabled, boost::bind( &Layer::check_abort, this ) );
+  iso->compute( quality_factor, capping_enabled, boost::bind( &Layer::check_abort, this ),
+    max_faces, max_error );
 
   this->data_state_->set( Layer::AVAILABLE_C );
   this->isosurface_area_state_->set( iso->surface_area() );
@@ -115,38 +115,46 @@ bool ActionExportIsosurface::run( Core::ActionContextHandle& context, Core::Acti
   LayerHandle temp_handle = LayerManager::Instance()->find_layer_by_id( this->layer_ );
   MaskLayer* mask_layer = dynamic_cast< MaskLayer* >( temp_handle.get() );
   
+  bool success;
   if ( (extension == ".fac") || (extension == ".pts") || (extension == ".val") )
   {
     boost::filesystem::path file_path = filename_and_path.parent_path();
     boost::filesystem::path file_prefix = filename_and_path.stem();
-    mask_layer->get_isosurface()->export_legacy_isosurface(file_path, file_prefix.string());
+    success = mask_layer->get_isosurface()->export_legacy_isosurface(file_path, file_prefix.string());
   }
   else if (extension == ".stl")
   {
     if (this->binary_file_export_)
     {
-      mask_layer->get_isosurface()->export_stl_binary_isosurface( filename_and_path, this->name_ );
+      success = mask_layer->get_isosurface()->export_stl_binary_isosurface( filename_and_path, this->name_ );
     }
     else
     {
-      mask_layer->get_isosurface()->export_stl_ascii_isosurface( filename_and_path, this->name_ );
+      success = mask_layer->get_isosurface()->export_stl_ascii_isosurface( filename_and_path, this->name_ );
     }
   }
   else if(extension == ".obj")
   {
-    mask_layer->get_isosurface()->export_obj_isosurface( filename_and_path );
+    success = mask_layer->get_isosurface()->export_obj_isosurface( filename_and_path );
   }
   else
   {
-    mask_layer->get_isosurface()->export_vtk_isosurface( filename_and_path );
+    success = mask_layer->get_isosurface()->export_vtk_isosurface( filename_and_path, 
+      this->binary_file_export_ );
+  }
+  
+  progress->end_progress_reporting();
+
+  if ( !success )
+  {
+    context->report_error( "Could not write isosurface to '" + this->file_path_ + "'." );
+    return false;
   }
   
   ProjectManager::Instance()->current_file_folder_state_->set( filename_and_path.parent_path().string() );
   
   ProjectManager::Instance()->checkpoint_projectmanager();
   
-  progress->end_progress_reporting();
-  
   return true;
 }
 
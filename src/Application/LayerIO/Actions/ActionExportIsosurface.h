@@ -46,7 +46,7 @@ CORE_ACTION(
   CORE_ACTION_ARGUMENT( "layer", "layer to be exported." )
   CORE_ACTION_ARGUMENT( "file_path", "A path, including the name of the file where the layer should be exported to." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "name", "<none>", "Optional dataset name. Currently only used for STL files (defaults to layer ID if name is not set)." )
-  CORE_ACTION_OPTIONAL_ARGUMENT( "binary", "false", "Optionally export binary file. Currently only available for STL files.")
+  CORE_ACTION_OPTIONAL_ARGUMENT( "binary", "false", "Optionally export binary file. Currently only available for STL and VTK files.")
   CORE_ACTION_CHANGES_PROJECT_DATA()
 )
   
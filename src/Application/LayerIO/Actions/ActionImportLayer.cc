@@ -27,6 +27,7 @@
 */
 
 // Boost includes
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 #include <sstream>
@@ -175,16 +176,24 @@ bool ActionImportLayer::run( Core::ActionContextHandle& context, Core::ActionRes
   // Progress reporting is only needed if not running in a sandbox
   if ( this->sandbox_ == -1 )
   {
-    progress.reset( new Core::ActionProgress( message ) );
+    progress.reset( new Core::ActionProgress( message, false, 
+      this->layer_importer_->has_progress_updates() ) );
     // Indicate that we have started the process
     progress->begin_progress_reporting();
+    this->layer_importer_->set_progress_function( 
+      boost::bind( &Core::ActionProgress::set_progress, progress, _1 ) );
   }
   
   // The ImporterFileData is an abstraction of all the data can be extracted from the file
   LayerImporterFileDataHandle data;
   
   // Get the data from the file
-  if ( !( this->layer_importer_->get_file_data( data ) ) )
+  bool success = this->layer_importer_->get_file_data( data );
+
+  // The importer is kept by the action, so it should not keep the progress alive
+  this->layer_importer_->set_progress_function( boost::function< void ( double ) >() );
+
+  if ( !success )
   {
     if ( this->sandbox_ == -1 ) progress->end_progress_reporting();
     std::string importer_error = this->layer_importer_->get_error();
@@ -45,8 +45,12 @@
 #pragma warning( pop )
 #endif
 
+// Boost includes
+#include <boost/bind.hpp>
+
 // Core includes
 #include <Core/DataBlock/StdDataBlock.h>
+#include <Core/Utils/ThreadPool.h>
 
 // Application includes
 #include <Application/LayerIO/GDCMLayerImporter.h>
@@ -90,8 +94,17 @@ public:
   // Read the dicom data into this private class
   bool read_data();
 
+  // READ_IMAGES
+  // Read the slices [ begin, end ) of the series into the data block, this runs on the
+  // thread pool
+  void read_images( const std::vector<std::string>* filenames, std::vector<std::string>* errors,
+    Core::TaskGroup* group, size_t begin, size_t end );
+
   // READ_IMAGE
-  bool read_image( const std::string& filename, char* buffer );
+  // Read one file into buffer. Files that need to be unpacked or rescaled are decoded
+  // into scratch first, which is then unpacked or rescaled straight into buffer.
+  bool read_image( const std::string& filename, char* buffer, std::vector<char>& scratch, 
+    std::string& error );
 
 
 public:
@@ -351,13 +364,23 @@ bool GDCMLayerImporterPrivate::read_data()
 
   this->data_block_ = Core::StdDataBlock::New( this->grid_transform_, this->pixel_type_ );
 
-  char* data = reinterpret_cast< char* >( this->data_block_->get_data() );
   std::vector<std::string> filenames = this->importer_->get_filenames();
 
-  for ( size_t i = 0; i < filenames.size(); i++ )
+  // Slices are decoded on the thread pool straight into their place in the data block,
+  // so at most one read per pool thread is outstanding at any time
+  std::vector<std::string> errors( filenames.size() );
+  {
+    Core::TaskGroup group;
+    group.parallel_for( 0, filenames.size(), 0, boost::bind( 
+      &GDCMLayerImporterPrivate::read_images, this, &filenames, &errors, &group, _1, _2 ) );
+    group.wait();
+  }
+
+  for ( size_t i = 0; i < errors.size(); i++ )
   {
-    if ( !this->read_image( filenames[ i ], data + this->slice_data_size_ * i ) )
+    if ( !errors[ i ].empty() )
     {
+      this->importer_->set_error( errors[ i ] );
       this->data_block_.reset();
       return false;
     }
@@ -374,52 +397,82 @@ bool GDCMLayerImporterPrivate::read_data()
   return true;
 }
 
-bool GDCMLayerImporterPrivate::read_image( const std::string& filename, char* buffer )
+void GDCMLayerImporterPrivate::read_images( const std::vector<std::string>* filenames, 
+  std::vector<std::string>* errors, Core::TaskGroup* group, size_t begin, size_t end )
+{
+  char* data = reinterpret_cast< char* >( this->data_block_->get_data() );
+
+  // The scratch buffer is reused for all the slices of this range
+  std::vector<char> scratch;
+  for ( size_t i = begin; i < end; i++ )
+  {
+    // Once one of the files failed, the remaining ones do not need to be read
+    if ( group->is_canceled() ) return;
+
+    if ( !this->read_image( ( *filenames )[ i ], data + this->slice_data_size_ * i, scratch,
+      ( *errors )[ i ] ) )
+    {
+      group->cancel();
+      return;
+    }
+  }
+}
+
+bool GDCMLayerImporterPrivate::read_image( const std::string& filename, char* buffer, 
+  std::vector<char>& scratch, std::string& error )
 {
   gdcm::ImageReader reader;
   reader.SetFileName( filename.c_str() );
 
   if ( !reader.Read() )
   {
-    this->importer_->set_error( "Failed to read file '" + filename + "'" );
+    error = "Failed to read file '" + filename + "'";
     return false;
   }
 
   gdcm::Image& image = reader.GetImage();
   if ( this->buffer_length_ != image.GetBufferLength() )
   {
-    this->importer_->set_error( "Images in the series have different sizes" );
+    error = "Images in the series have different sizes";
     return false;
   }
 
-  image.GetBuffer( buffer );
   const gdcm::PixelFormat& pixeltype = image.GetPixelFormat();
-  if ( pixeltype == gdcm::PixelFormat::UINT12 )
+  bool unpack = pixeltype == gdcm::PixelFormat::UINT12;
+  bool rescale = this->rescale_slope_ != 1.0 || this->rescale_intercept_ != 0.0;
+
+  if ( unpack && rescale )
   {
-    if ( this->rescale_slope_ != 1.0 || this->rescale_intercept_ != 0.0 )
-    {
-      this->importer_->set_error( "Unsupported data format" );
-      return false;
-    }
+    error = "Unsupported data format";
+    return false;
+  }
 
-    std::vector< char > copy( this->buffer_length_ );
-    memcpy( &copy[ 0 ], buffer, this->buffer_length_ );
-    if ( !gdcm::Unpacker12Bits::Unpack( buffer, &copy[ 0 ], this->buffer_length_ ) )
+  if ( !unpack && !rescale )
+  {
+    image.GetBuffer( buffer );
+    return true;
+  }
+
+  // Unpacking and rescaling may write more data than they read, hence the file is decoded
+  // into the scratch buffer and then unpacked or rescaled into the slice
+  if ( scratch.size() < this->buffer_length_ ) scratch.resize( this->buffer_length_ );
+  image.GetBuffer( &scratch[ 0 ] );
+
+  if ( unpack )
+  {
+    if ( !gdcm::Unpacker12Bits::Unpack( buffer, &scratch[ 0 ], this->buffer_length_ ) )
     {
-      this->importer_->set_error( "Failed to unpack 12bit data" );
+      error = "Failed to unpack 12bit data";
       return false;
     }
   }
-
-  if ( this->rescale_slope_ != 1.0 || this->rescale_intercept_ != 0.0 )
+  else
   {
     gdcm::Rescaler rescaler;
     rescaler.SetIntercept( this->rescale_intercept_ );
     rescaler.SetSlope( this->rescale_slope_ );
     rescaler.SetPixelFormat( pixeltype );
-    std::vector< char > copy( this->buffer_length_ );
-    memcpy( &copy[ 0 ], buffer, this->buffer_length_ );
-    rescaler.Rescale( buffer, &copy[ 0 ], this->buffer_length_ );
+    rescaler.Rescale( buffer, &scratch[ 0 ], this->buffer_length_ );
   }
 
   return true;
@@ -39,6 +39,8 @@ public:
   std::string error_; 
   std::string warning_; 
   
+  boost::function< void ( double ) > progress_;
+
   InputFilesID inputfiles_id_;
 };
 
@@ -73,6 +75,21 @@ std::string LayerImporter::get_warning() const
   return this->private_->warning_;
 }
 
+bool LayerImporter::has_progress_updates() const
+{
+  return false;
+}
+
+void LayerImporter::set_progress_function( boost::function< void ( double ) > progress )
+{
+  this->private_->progress_ = progress;
+}
+
+void LayerImporter::update_progress( double progress )
+{
+  if ( this->private_->progress_ ) this->private_->progress_( progress );
+}
+
 void LayerImporter::set_dicom_swap_xyspacing_hint( bool )
 {
 }
@@ -39,6 +39,7 @@
 
 // Boost includes
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 
@@ -117,6 +118,20 @@ public:
   /// Set the warning message
   void set_warning( const std::string& warning );
 
+  // -- Progress reporting --
+public:
+  /// HAS_PROGRESS_UPDATES
+  /// Whether the importer reports the progress of get_file_data through update_progress
+  virtual bool has_progress_updates() const;
+
+  /// SET_PROGRESS_FUNCTION
+  /// Set the function that receives the fraction of the data that has been imported
+  void set_progress_function( boost::function< void ( double ) > progress );
+
+  /// UPDATE_PROGRESS
+  /// Report the fraction of the data that has been imported
+  void update_progress( double progress );
+
   // -- file_importer_id handling --
 public:
   /// GET_INPUTFILES_ID:
@@ -26,17 +26,11 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// Specific includes for reading large datafiles
-// NOTE: We needed to special case Windows as VS 2008 has an improper 64bit seek function in its
-// STL implementation.
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <fstream>
-#endif
-#include <iostream>
+// Boost includes
+#include <boost/bind.hpp>
 
 // Core includes
+#include <Core/DataBlock/RawVolumeReader.h>
 #include <Core/DataBlock/StdDataBlock.h>
 
 // Application includes
@@ -321,104 +315,20 @@ namespace Seg3D
       return false;
     }
 
-    // Now we read in the file
-    // NOTE: We had to split this out due to a bug in Visual Studio's implementation for filestreams
-    // These are unfortunately not 64bit compatible and hence use 32bit integers to denote offsets
-    // into a file. Hence this breaks large data support. Hence in the next piece of code we deal
-    // with windows separately.
-    
-#ifdef _WIN32
-    HANDLE file_desc = CreateFileA( this->importer_->get_filename().c_str(), GENERIC_READ,
-                                   FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
-    if ( file_desc == INVALID_HANDLE_VALUE ) 
-    {
-      this->importer_->set_error( "Could not open file." );
-      return false;
-    }
-#else
-    std::ifstream data_file( this->importer_->get_filename().c_str(),
-                             std::ios::in | std::ios::binary );
-    if( !data_file )
-    {
-      this->importer_->set_error( "Could not open file." );
-      return false;
-    }
-#endif
-    
-    // We start by getting the length of the entire file
-#ifdef _WIN32
-    LARGE_INTEGER offset; offset.QuadPart = 0;
-    SetFilePointerEx( file_desc, offset, NULL, FILE_END);
-#else
-    data_file.seekg( 0, std::ios::end );
-#endif
-    
-    // Next we compute the length of the data by subtracting the size of the header
-    size_t file_size = 0;
-    
-#ifdef _WIN32
-    offset.QuadPart = 0;
-    LARGE_INTEGER cur_pos;
-    SetFilePointerEx( file_desc, offset, &cur_pos, FILE_CURRENT );
-    file_size = cur_pos.QuadPart; 
-#else
-    file_size = static_cast<size_t>( data_file.tellg() );
-#endif
-    
-    // Ensure that the MRC file is of the right length
-    size_t length = this->data_block_->get_size() * Core::GetSizeDataType( this->data_type_ );
-    if ( file_size - MRC_HEADER_LENGTH < length )
-    {
-      this->importer_->set_error( "Incorrect length of file." );
-      return false;
-    }
-    
-    // We move the reader's position back to the front of the file and then to the start of the data
-    //char* data = reinterpret_cast<char *>( this->data_block_->get_data() );
-    char* data = new char[length];
-    
-#ifdef _WIN32
-    offset.QuadPart = MRC_HEADER_LENGTH;
-    SetFilePointerEx( file_desc, offset, NULL, FILE_BEGIN );
-#else
-    data_file.seekg( MRC_HEADER_LENGTH, std::ios::beg );
-#endif
-    
-    // Finally, we do the actual reading and then save the data to the data block.
-#ifdef _WIN32
-    // NOTE: For windows we need to divide the read in chunks due to limitations in the
-    // sizes we can store in the ReadFile function.
-    char* data_ptr = data;
-    DWORD dwReadBytes;
-    size_t read_length = length;
-    size_t chunk = 1UL<<30;
-    
-    while ( read_length > chunk )
-    {
-      ReadFile( file_desc, data_ptr, DWORD(chunk), &dwReadBytes, NULL );
-      read_length -= static_cast<size_t>( dwReadBytes );
-      data_ptr += static_cast<size_t>( dwReadBytes );
-    }
-    ReadFile( file_desc, data_ptr, DWORD( read_length ), &dwReadBytes, NULL );
-    
-#else
-    data_file.read( data, length );
-#endif
+    // Read the data straight into the data block, the reader checks the length of the file.
+    // MRC data is stored in the byte order given in the header, hence we need to swap if it
+    // does not match this system.
+    Core::RawVolumeReader reader;
+    reader.set_swap_endian( this->mrcutil_.swap_endian() );
+    reader.set_progress_function( boost::bind( &LayerImporter::update_progress, 
+      this->importer_, _1 ) );
 
-    // Close the file
-#ifdef _WIN32
-    CloseHandle( file_desc );
-#else
-    data_file.close();
-#endif
-
-    this->data_block_->set_data(data);
-
-    // MRC data is always stored as big endian data
-    // Hence we need to swap if we are on a little endian system.
-    if ( this->mrcutil_.swap_endian() )
+    std::string error;
+    if ( !reader.read( this->importer_->get_filename(), MRC_HEADER_LENGTH, 
+      this->data_block_, error ) )
     {
-      this->data_block_->swap_endian();
+      this->importer_->set_error( error );
+      return false;
     }
 
     // Mark that we have read the data.
@@ -493,5 +403,10 @@ namespace Seg3D
     
     return true;
   }
+
+  bool MRCLayerImporter::has_progress_updates() const
+  {
+    return true;
+  }
   
 } // end namespace seg3D
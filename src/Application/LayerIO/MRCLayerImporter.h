@@ -75,6 +75,10 @@ namespace Seg3D
     /// Get the file data from the file/ file series
     /// NOTE: The information is generated again, so that hints can be processed
     virtual bool get_file_data( LayerImporterFileDataHandle& data );
+
+    /// HAS_PROGRESS_UPDATES
+    /// The data is read in slabs, which report their progress
+    virtual bool has_progress_updates() const;
     
     // --internals --
   public:
@@ -26,16 +26,14 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// Specific includes for reading large datafiles
-// NOTE: We needed to special case Windows as VS 2008 has an improper 64bit seek function in its
-// STL implementation.
-#ifdef _WIN32
-#include <windows.h>
-#else
+// STL includes
 #include <fstream>
-#endif
+
+// Boost includes
+#include <boost/bind.hpp>
 
 // Core includes
+#include <Core/DataBlock/RawVolumeReader.h>
 #include <Core/Volume/DataVolume.h>
 
 // Application includes
@@ -246,103 +244,22 @@ bool VFFLayerImporterPrivate::read_data()
     return false;
   }
 
-  // Now we read in the file
-  // NOTE: We had to split this out due to a bug in Visual Studio's implementation for filestreams
-  // These are unfortunately not 64bit compatible and hence use 32bit integers to denote offsets
-  // into a file. Hence this breaks large data support. Hence in the next piece of code we deal
-  // with windows separately.
-  
-#ifdef _WIN32
-  HANDLE file_desc = CreateFileA( this->importer_->get_filename().c_str(), GENERIC_READ,
-    FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
-  if ( file_desc == INVALID_HANDLE_VALUE ) 
-  {
-    this->importer_->set_error( "Could not open file." );
-    return false;
-  }
-#else
-  std::ifstream data_file( this->importer_->get_filename().c_str(), 
-    std::ios::in | std::ios::binary );
-  if( !data_file )
+  // Read the data straight into the data block, the reader checks the length of the file.
+  // VFF data is always stored as big endian data, hence we need to swap if we are on a 
+  // little endian system.
+  Core::RawVolumeReader reader;
+  reader.set_swap_endian( Core::DataBlock::IsLittleEndian() );
+  reader.set_progress_function( boost::bind( &LayerImporter::update_progress, 
+    this->importer_, _1 ) );
+
+  std::string error;
+  if ( !reader.read( this->importer_->get_filename(), this->vff_end_of_header_, 
+    this->data_block_, error ) )
   {
-    this->importer_->set_error( "Could not open file." );
-    return false;
-  }
-#endif
-
-  // We start by getting the length of the entire file
-#ifdef _WIN32
-  LARGE_INTEGER offset; offset.QuadPart = 0;
-    SetFilePointerEx( file_desc, offset, NULL, FILE_END);
-#else
-  data_file.seekg( 0, std::ios::end );
-#endif
-
-  // Next we compute the length of the data by subtracting the size of the header
-  size_t file_size = 0;
-
-#ifdef _WIN32
-  offset.QuadPart = 0;
-    LARGE_INTEGER cur_pos;
-  SetFilePointerEx( file_desc, offset, &cur_pos, FILE_CURRENT );
-  file_size = cur_pos.QuadPart + 1; 
-#else
-  file_size = static_cast<size_t>( data_file.tellg() ) + 1;
-#endif
-  
-  // Ensure that the vff file is of the right length
-  size_t length = this->data_block_->get_size() * Core::GetSizeDataType( this->data_type_ );  
-  if ( file_size - ( this->vff_end_of_header_ ) < length )
-  {
-    this->importer_->set_error( "Incorrect length of file." );
+    this->importer_->set_error( error );
     return false;
   }
 
-  // We move the reader's position back to the front of the file and then to the start of the data
-  char* data = reinterpret_cast<char *>( this->data_block_->get_data() );
-
-#ifdef _WIN32
-  offset.QuadPart = this->vff_end_of_header_;
-    SetFilePointerEx( file_desc, offset, NULL, FILE_BEGIN );
-#else
-  data_file.seekg( this->vff_end_of_header_, std::ios::beg );
-#endif
-
-  // Finally, we do the actual reading and then save the data to the data block.
-#ifdef _WIN32
-  // NOTE: For windows we need to divide the read in chuncks due to limitations in the
-  // sizes we can store in the ReadFile function.
-  char* data_ptr = data;
-    DWORD dwReadBytes;
-  size_t read_length = length;
-  size_t chunk = 1UL<<30;
-  
-  while ( read_length > chunk )
-  {
-    ReadFile( file_desc, data_ptr, DWORD(chunk), &dwReadBytes, NULL );
-    read_length -= static_cast<size_t>( dwReadBytes );
-    data_ptr += static_cast<size_t>( dwReadBytes );
-  }
-  ReadFile( file_desc, data_ptr, DWORD( read_length ), &dwReadBytes, NULL );
-
-#else
-  data_file.read( data, length );
-#endif
-  
-  // Close the file
-#ifdef _WIN32
-  CloseHandle( file_desc );
-#else
-  data_file.close();
-#endif
-
-  // VFF data is always stored as big endian data
-  // Hence we need to swap if we are on a little endian system.
-  if ( Core::DataBlock::IsLittleEndian() )
-  {
-    this->data_block_->swap_endian();
-  }
-
   // Mark that we have read the data.
   this->read_data_ = true;
 
@@ -415,4 +332,9 @@ bool VFFLayerImporter::get_file_data( LayerImporterFileDataHandle& data )
   return true;
 }
 
+bool VFFLayerImporter::has_progress_updates() const
+{
+  return true;
+}
+
 } // end namespace seg3D
@@ -78,6 +78,10 @@ public:
   /// NOTE: The information is generated again, so that hints can be processed
   virtual bool get_file_data( LayerImporterFileDataHandle& data );
 
+  /// HAS_PROGRESS_UPDATES
+  /// The data is read in slabs, which report their progress
+  virtual bool has_progress_updates() const;
+
   // --internals --
 public:
   VFFLayerImporterPrivateHandle private_;
@@ -188,6 +188,12 @@ void PreferencesManager::initialize_states()
   this->add_state( "percent_of_memory", this->percent_of_memory_state_, 
     percent_of_memory, 0.0, 0.5, 0.01 );
 
+  // Disk space in GB for undo check points that no longer fit in memory. Moving them to disk
+  // is off by default and zero disables it. When no directory is given the temporary
+  // directory is used.
+  this->add_state( "undo_disk_space", this->undo_disk_space_state_, 0, 0, 256, 1 );
+  this->add_state( "undo_directory", this->undo_directory_state_, "" );
+
   this->add_state( "embed_input_files_state", this->embed_input_files_state_, true );
   this->add_state( "generate_osx_project_bundle_state", this->generate_osx_project_bundle_state_, true );
 
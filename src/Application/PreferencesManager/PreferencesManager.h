@@ -83,6 +83,8 @@ public:
 
   Core::StateBoolHandle enable_undo_state_;
   Core::StateRangedDoubleHandle percent_of_memory_state_;
+  Core::StateRangedIntHandle undo_disk_space_state_;
+  Core::StateStringHandle undo_directory_state_;
   Core::StateBoolHandle embed_input_files_state_;
   Core::StateBoolHandle generate_osx_project_bundle_state_;
 
@@ -561,7 +561,9 @@ void ProjectPrivate::clean_up_data_files()
     // Skip non-nrrd files
     if ( Core::StringToLower( file_path.extension().string() ) != ".nrrd" ) continue;
 
+    // Masks are saved per bitplane in files named after the generation and the bit
     std::string file_name = file_path.stem().string();
+    file_name = file_name.substr( 0, file_name.find( '_' ) );
     try
     {
       long long generation_number = boost::lexical_cast< long long >( file_name );
@@ -2441,24 +2443,40 @@ bool Project::export_project( const boost::filesystem::path& export_path,
   }
 
   // Copy those data files
+  // NOTE: A generation is either saved as one file, or for masks as one file per bitplane
   BOOST_FOREACH( Core::DataBlock::generation_type generation, generations )
   {
-    boost::filesystem::path src_file = project_path / DATA_DIR_C / 
-      ( Core::ExportToString( generation ) + ".nrrd" );
-    boost::filesystem::path dst_file = export_path / DATA_DIR_C /
-      ( Core::ExportToString( generation ) + ".nrrd" );
-    if ( !boost::filesystem::exists( src_file ) )
+    std::vector< std::string > file_names;
+    file_names.push_back( Core::ExportToString( generation ) + ".nrrd" );
+    for ( int bit = 0; bit < 8; bit++ )
     {
-      CORE_LOG_ERROR( "Missing data file '" + src_file.string() + "'." );
-      return false;
+      file_names.push_back( Core::ExportToString( generation ) + "_" + 
+        Core::ExportToString( bit ) + ".nrrd" );
     }
-    try
+
+    bool found_file = false;
+    for ( size_t j = 0; j < file_names.size(); j++ )
     {
-      boost::filesystem::copy_file( src_file, dst_file );
+      boost::filesystem::path src_file = project_path / DATA_DIR_C / file_names[ j ];
+      boost::filesystem::path dst_file = export_path / DATA_DIR_C / file_names[ j ];
+      if ( !boost::filesystem::exists( src_file ) ) continue;
+
+      found_file = true;
+      try
+      {
+        boost::filesystem::copy_file( src_file, dst_file );
+      }
+      catch ( ... )
+      {
+        CORE_LOG_ERROR( "Failed to copy file '" + src_file.string() + "'." );
+        return false;
+      }
     }
-    catch ( ... )
+
+    if ( !found_file )
     {
-      CORE_LOG_ERROR( "Failed to copy file '" + src_file.string() + "'." );
+      CORE_LOG_ERROR( "Missing data file '" + ( project_path / DATA_DIR_C / 
+        file_names[ 0 ] ).string() + "'." );
       return false;
     }
   }
@@ -2635,6 +2653,11 @@ bool Project::load_session( SessionID session_id )
     return false;
   }
 
+  // We need to restore the generation count from the project before the layers are loaded,
+  // so layers that register new generations do not get the ones saved with other layers
+  Core::DataBlock::generation_type generation = this->generation_count_state_->get(); 
+  Core::DataBlockManager::Instance()->set_generation_count( generation );
+
   if ( ! Core::StateEngine::Instance()->load_states( state_io ) )
   {
     std::string error = std::string( "Failed to apply session data." );
@@ -2645,9 +2668,7 @@ bool Project::load_session( SessionID session_id )
   this->project_files_generated_state_->set( true );
   this->project_files_accessible_state_->set( true );
 
-  // We need to restore provenance and generation count from the project
-  Core::DataBlock::generation_type generation = this->generation_count_state_->get(); 
-  Core::DataBlockManager::Instance()->set_generation_count( generation );
+  // We need to restore provenance count from the project
   ProvenanceID provenance_id = this->provenance_count_state_->get();
   SetProvenanceCount( provenance_id );
 
@@ -30,6 +30,8 @@
 #include <boost/lambda/bind.hpp>
 
 #include <Core/Action/ActionFactory.h>
+#include <Core/DataBlock/MaskComponents.h>
+#include <Core/Math/MathFunctions.h>
 #include <Core/Volume/MaskVolumeSlice.h>
 #include <Core/Volume/DataVolumeSlice.h>
 #include <Core/Graphics/Algorithm.h>
@@ -63,6 +65,7 @@ public:
   std::string mask_cstr2_layer_id_;
   bool negative_mask_cstr2_;
   bool erase_;
+  bool fill_3d_;
   SandboxID sandbox_;
 
   Core::MaskVolumeSliceHandle vol_slice_;
@@ -71,6 +74,11 @@ public:
   Core::MaskVolumeSliceHandle mask_cstr2_slice_;
 
   std::vector< std::pair< int, int > > seeds_2d_;
+
+  // The seeds and constraints of a 3D flood fill
+  Core::MaskDataBlockHandle mask_data_block_;
+  std::vector< size_t > seed_indices_;
+  Core::MaskRegionConstraint constraint_;
 };
 
 ActionFloodFill::ActionFloodFill() :
@@ -89,6 +97,7 @@ ActionFloodFill::ActionFloodFill() :
   this->add_layer_id( this->private_->mask_cstr2_layer_id_ );
   this->add_parameter( this->private_->negative_mask_cstr2_ );
   this->add_parameter( this->private_->erase_ );
+  this->add_parameter( this->private_->fill_3d_ );
   this->add_parameter( this->private_->sandbox_ );
 }
 
@@ -136,6 +145,7 @@ bool ActionFloodFill::validate( Core::ActionContextHandle& context )
   }
 
   this->private_->vol_slice_->set_slice_number( this->private_->slice_number_ );
+  this->private_->constraint_ = Core::MaskRegionConstraint();
 
   if ( this->private_->data_cstr_layer_id_ != "" &&
     this->private_->data_cstr_layer_id_ != "<none>" )
@@ -161,6 +171,9 @@ bool ActionFloodFill::validate( Core::ActionContextHandle& context )
       this->private_->data_cstr_slice_.reset( new Core::DataVolumeSlice( 
         data_cstr_layer->get_data_volume(), slice_type, 
         this->private_->slice_number_ ) );
+      this->private_->constraint_.set_data_range( 
+        data_cstr_layer->get_data_volume()->get_data_block(), this->private_->min_val_, 
+        this->private_->max_val_, this->private_->negative_data_cstr_ );
     }
   }
   
@@ -188,6 +201,9 @@ bool ActionFloodFill::validate( Core::ActionContextHandle& context )
       this->private_->mask_cstr1_slice_.reset( new Core::MaskVolumeSlice(
         mask_cstr1_layer->get_mask_volume(), slice_type, 
         this->private_->slice_number_ ) );
+      this->private_->constraint_.add_mask( 
+        mask_cstr1_layer->get_mask_volume()->get_mask_data_block(),
+        this->private_->negative_mask_cstr1_ );
     }
   }
 
@@ -215,10 +231,45 @@ bool ActionFloodFill::validate( Core::ActionContextHandle& context )
       this->private_->mask_cstr2_slice_.reset( new Core::MaskVolumeSlice(
         mask_cstr2_layer->get_mask_volume(), slice_type, 
         this->private_->slice_number_ ) );
+      this->private_->constraint_.add_mask( 
+        mask_cstr2_layer->get_mask_volume()->get_mask_data_block(),
+        this->private_->negative_mask_cstr2_ );
     }
   }
 
   const std::vector< Core::Point >& seeds = this->private_->seeds_;
+
+  // A 3D flood fill finds the voxels of the seed points in the whole volume
+  if ( this->private_->fill_3d_ )
+  {
+    this->private_->mask_data_block_ = target_layer->get_mask_volume()->get_mask_data_block();
+    Core::MaskDataBlockHandle mask = this->private_->mask_data_block_;
+    Core::Transform inverse = target_layer->get_grid_transform().get_inverse();
+    this->private_->seed_indices_.clear();
+
+    for ( size_t i = 0; i < seeds.size(); ++i )
+    {
+      Core::Point location = inverse * seeds[ i ];
+      int x = Core::Round( location.x() );
+      int y = Core::Round( location.y() );
+      int z = Core::Round( location.z() );
+      if ( x >= 0 && x < static_cast< int >( mask->get_nx() ) && y >= 0 && 
+        y < static_cast< int >( mask->get_ny() ) && z >= 0 && 
+        z < static_cast< int >( mask->get_nz() ) )
+      {
+        this->private_->seed_indices_.push_back( mask->to_index( x, y, z ) );
+      }
+    }
+
+    if ( this->private_->seed_indices_.size() == 0 )
+    {
+      context->report_error( "A 3D flood fill needs at least one seed point inside the volume." );
+      return false;
+    }
+
+    return true;
+  }
+
   int nx = static_cast< int >( this->private_->vol_slice_->nx() );
   int ny = static_cast< int >( this->private_->vol_slice_->ny() );
   this->private_->seeds_2d_.clear();
@@ -249,32 +300,6 @@ bool ActionFloodFill::validate( Core::ActionContextHandle& context )
 
 bool ActionFloodFill::run( Core::ActionContextHandle& context, Core::ActionResultHandle& result )
 {
-  Core::MaskVolumeSliceHandle volume_slice = this->private_->vol_slice_;
-  int nx = static_cast< int >( volume_slice->nx() );
-  int ny = static_cast< int >( volume_slice->ny() );
-  unsigned char mask_value = volume_slice->get_mask_data_block()->get_mask_value();
-  
-  typedef std::vector< unsigned char > cstr_buffer_type;
-  std::vector< unsigned char > data_cstr( nx * ny, 1 );
-  std::vector< unsigned char > mask_cstr1( nx * ny, 1 );
-  std::vector< unsigned char > mask_cstr2( nx * ny, 1 );
-  if ( this->private_->data_cstr_slice_ )
-  {
-    this->private_->data_cstr_slice_->create_threshold_mask( data_cstr,
-      this->private_->min_val_, this->private_->max_val_, 
-      this->private_->negative_data_cstr_ );
-  }
-  if ( this->private_->mask_cstr1_slice_ )
-  {
-    this->private_->mask_cstr1_slice_->copy_slice_data( mask_cstr1,
-      this->private_->negative_mask_cstr1_ );
-  }
-  if ( this->private_->mask_cstr2_slice_ )
-  {
-    this->private_->mask_cstr2_slice_->copy_slice_data( mask_cstr2,
-      this->private_->negative_mask_cstr2_ );
-  }
-
   if ( this->private_->sandbox_ == -1 )
   {
     // Get the layer on which this action operates
@@ -301,15 +326,24 @@ bool ActionFloodFill::run( Core::ActionContextHandle& context, Core::ActionResul
     // Build the undo/redo for this action
     LayerUndoBufferItemHandle item( new LayerUndoBufferItem( "FloodFill" ) );
 
-    // Get the axis along which the flood fill works
-    Core::SliceType slice_type = static_cast< Core::SliceType::enum_type>(
-      this->private_->slice_type_ );
-    
-    // Get the slice number
-    size_t slice_number = this->private_->slice_number_;
-    
-    // Create a check point of the slice on which the flood fill will operate
-    LayerCheckPointHandle check_point( new LayerCheckPoint( layer, slice_type, slice_number ) );
+    LayerCheckPointHandle check_point;
+    if ( this->private_->fill_3d_ )
+    {
+      // Create a check point of the volume, as a 3D flood fill can change every slice
+      check_point.reset( new LayerCheckPoint( layer ) );
+    }
+    else
+    {
+      // Get the axis along which the flood fill works
+      Core::SliceType slice_type = static_cast< Core::SliceType::enum_type>(
+        this->private_->slice_type_ );
+      
+      // Get the slice number
+      size_t slice_number = this->private_->slice_number_;
+      
+      // Create a check point of the slice on which the flood fill will operate
+      check_point.reset( new LayerCheckPoint( layer, slice_type, slice_number ) );
+    }
 
     // The redo action is the current one
     item->set_redo_action( this->shared_from_this() );
@@ -325,6 +359,41 @@ bool ActionFloodFill::run( Core::ActionContextHandle& context, Core::ActionResul
     layer->provenance_id_state_->set( this->get_output_provenance_id( 0 ) );
   }
 
+  if ( this->private_->fill_3d_ )
+  {
+    // Fill the bits of the mask in place, this triggers the update of the mask
+    Core::MaskComponents::FloodFill( this->private_->mask_data_block_, 
+      this->private_->seed_indices_, this->private_->erase_, this->private_->constraint_ );
+    result.reset( new Core::ActionResult( this->private_->target_layer_id_ ) );
+    return true;
+  }
+
+  Core::MaskVolumeSliceHandle volume_slice = this->private_->vol_slice_;
+  int nx = static_cast< int >( volume_slice->nx() );
+  int ny = static_cast< int >( volume_slice->ny() );
+  unsigned char mask_value = volume_slice->get_mask_data_block()->get_mask_value();
+  
+  typedef std::vector< unsigned char > cstr_buffer_type;
+  std::vector< unsigned char > data_cstr( nx * ny, 1 );
+  std::vector< unsigned char > mask_cstr1( nx * ny, 1 );
+  std::vector< unsigned char > mask_cstr2( nx * ny, 1 );
+  if ( this->private_->data_cstr_slice_ )
+  {
+    this->private_->data_cstr_slice_->create_threshold_mask( data_cstr,
+      this->private_->min_val_, this->private_->max_val_, 
+      this->private_->negative_data_cstr_ );
+  }
+  if ( this->private_->mask_cstr1_slice_ )
+  {
+    this->private_->mask_cstr1_slice_->copy_slice_data( mask_cstr1,
+      this->private_->negative_mask_cstr1_ );
+  }
+  if ( this->private_->mask_cstr2_slice_ )
+  {
+    this->private_->mask_cstr2_slice_->copy_slice_data( mask_cstr2,
+      this->private_->negative_mask_cstr2_ );
+  }
+
   {
     Core::MaskVolumeSlice::lock_type lock( volume_slice->get_mutex() );
     unsigned char* slice_cache = volume_slice->get_cached_data();
@@ -378,6 +447,9 @@ void ActionFloodFill::clear_cache()
   this->private_->mask_cstr2_slice_.reset();
   this->private_->vol_slice_.reset();
   this->private_->seeds_2d_.clear();
+  this->private_->mask_data_block_.reset();
+  this->private_->seed_indices_.clear();
+  this->private_->constraint_ = Core::MaskRegionConstraint();
 }
 
 void ActionFloodFill::Dispatch( Core::ActionContextHandle context, 
@@ -397,6 +469,7 @@ void ActionFloodFill::Dispatch( Core::ActionContextHandle context,
   action->private_->mask_cstr2_layer_id_ = params.mask_constraint2_layer_id_;
   action->private_->negative_mask_cstr2_ = params.negative_mask_constraint2_;
   action->private_->erase_ = params.erase_;
+  action->private_->fill_3d_ = params.fill_3d_;
 
   Core::ActionDispatcher::PostAction( Core::ActionHandle( action ), context );
 }
@@ -58,6 +58,7 @@ public:
   std::string mask_constraint2_layer_id_;
   bool negative_mask_constraint2_;
   bool erase_;
+  bool fill_3d_;
 };
 
 class ActionFloodFill : public LayerAction
@@ -80,6 +81,8 @@ CORE_ACTION
   CORE_ACTION_OPTIONAL_ARGUMENT( "mask_constraint2", "<none>", "The ID of second mask constraint layer." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "negative_mask_constraint2", "false", "Whether to negate the second mask constraint." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "erase", "false", "Whether to erase instead of fill." )
+  CORE_ACTION_OPTIONAL_ARGUMENT( "fill_3d", "false", "Whether to fill the connected region "
+    "of the whole volume instead of the slice." )
   CORE_ACTION_OPTIONAL_ARGUMENT( "sandbox", "-1", "The sandbox in which to run the action." )
   CORE_ACTION_ARGUMENT_IS_NONPERSISTENT( "sandbox" )  
   CORE_ACTION_CHANGES_PROJECT_DATA()
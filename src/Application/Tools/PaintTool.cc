@@ -622,6 +622,7 @@ void PaintToolPrivate::flood_fill( Core::ActionContextHandle context,
     ff_params.negative_mask_constraint1_ = this->paint_tool_->negative_mask_constraint1_state_->get();
     ff_params.mask_constraint2_layer_id_ = this->paint_tool_->mask_constraint2_layer_state_->get();
     ff_params.negative_mask_constraint2_ = this->paint_tool_->negative_mask_constraint2_state_->get();
+    ff_params.fill_3d_ = this->paint_tool_->flood_fill_3d_state_->get();
   }
 
   ActionFloodFill::Dispatch( context, ff_params );
@@ -692,6 +693,7 @@ PaintTool::PaintTool( const std::string& toolid ) :
   this->add_state( "upper_threshold", this->upper_threshold_state_, inf, -inf, inf, 0.01 );
   this->add_state( "lower_threshold", this->lower_threshold_state_, -inf, -inf, inf, 0.01 );
   this->add_state( "erase", this->erase_state_, false );
+  this->add_state( "flood_fill_3d", this->flood_fill_3d_state_, false );
   
   this->add_connection( this->data_constraint_layer_state_->state_changed_signal_.connect(
     boost::bind( &PaintToolPrivate::handle_data_constraint_changed, this->private_.get() ) ) );
@@ -201,6 +201,9 @@ public:
   /// Erase data instead of painting
   Core::StateBoolHandle erase_state_;
 
+  /// Flood fill the connected region of the whole volume instead of the current slice
+  Core::StateBoolHandle flood_fill_3d_state_;
+
 private:
   PaintToolPrivateHandle private_;
 
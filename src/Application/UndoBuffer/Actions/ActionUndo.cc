@@ -46,6 +46,14 @@ bool ActionUndo::validate( Core::ActionContextHandle& context )
     context->report_error( "No action to undo." );
     return false;
   }
+
+  // A check point that is read back from disk is inserted later, the next step needs to wait
+  // for it as it would otherwise be applied to data that is not restored yet
+  if ( UndoBuffer::Instance()->is_restoring() )
+  {
+    context->report_error( "The previous undo or redo is still being applied." );
+    return false;
+  }
   
   return true; // validated
 }
@@ -28,9 +28,14 @@
 
 // STL includes
 #include <deque>
+#include <limits>
+
+// Boost includes
+#include <boost/filesystem.hpp>
 
 // Core includes
 #include <Core/Action/ActionContextContainer.h>
+#include <Core/Utils/Log.h>
 
 // Application includes
 #include <Application/UndoBuffer/UndoBuffer.h>
@@ -75,10 +80,56 @@ public:
   
   UndoBuffer* buffer_;
   long long max_mem_;
+
+  // Directory in which check points are stored that do not fit in memory
+  boost::filesystem::path disk_directory_;
+
+  // Whether the directory was created in the temporary directory and needs to be removed
+  bool remove_disk_directory_;
+
+  // Number of undo or redo steps that are still restoring data in the background
+  int num_restores_;
   
   void handle_enable( bool enable );
+
+  // GET_DISK_DIRECTORY:
+  // Get the directory for storing check points on disk, create it if needed.
+  bool get_disk_directory( boost::filesystem::path& directory );
 };
 
+bool UndoBufferPrivate::get_disk_directory( boost::filesystem::path& directory )
+{
+  std::string user_directory = PreferencesManager::Instance()->undo_directory_state_->get();
+  boost::system::error_code ec;
+
+  if ( !user_directory.empty() )
+  {
+    directory = boost::filesystem::path( user_directory );
+  }
+  else
+  {
+    if ( this->disk_directory_.empty() )
+    {
+      boost::filesystem::path temp_directory = boost::filesystem::temp_directory_path( ec );
+      if ( ec ) return false;
+      this->disk_directory_ = temp_directory / 
+        boost::filesystem::unique_path( "Seg3D-undo-%%%%-%%%%-%%%%" );
+      this->remove_disk_directory_ = true;
+    }
+    directory = this->disk_directory_;
+  }
+
+  if ( !boost::filesystem::exists( directory, ec ) )
+  {
+    if ( !boost::filesystem::create_directories( directory, ec ) )
+    {
+      CORE_LOG_ERROR( "Could not create undo directory: " + directory.string() );
+      return false;
+    }
+  }
+  return true;
+}
+
 
 void UndoBufferPrivate::handle_enable( bool enable )
 {
@@ -92,6 +143,8 @@ UndoBuffer::UndoBuffer() :
   private_( new UndoBufferPrivate )
 {
   this->private_->buffer_ = this;
+  this->private_->remove_disk_directory_ = false;
+  this->private_->num_restores_ = 0;
   this->private_->max_mem_ = Core::Application::Instance()->
     get_total_addressable_physical_memory();
   
@@ -105,6 +158,12 @@ UndoBuffer::UndoBuffer() :
 UndoBuffer::~UndoBuffer()
 {
   this->disconnect_all();
+
+  if ( this->private_->remove_disk_directory_ )
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( this->private_->disk_directory_, ec );
+  }
 }
 
 void UndoBuffer::insert_undo_item( Core::ActionContextHandle context, 
@@ -124,19 +183,50 @@ void UndoBuffer::insert_undo_item( Core::ActionContextHandle context,
   size_t max_size = static_cast<size_t> ( this->private_->max_mem_ * 
     PreferencesManager::Instance()->percent_of_memory_state_->get() );
 
+  // Older items that do not fit in memory are moved to disk until the disk space is used up
+  double max_disk_bytes = 
+    PreferencesManager::Instance()->undo_disk_space_state_->get() * 1073741824.0;
+  size_t max_disk_size = std::numeric_limits<size_t>::max();
+  if ( max_disk_bytes < static_cast<double>( max_disk_size ) )
+  {
+    max_disk_size = static_cast<size_t>( max_disk_bytes );
+  }
+
   // Get the size of the element
   size_t size = undo_item->get_byte_size();
+  size_t disk_size = 0;
 
   UndoBufferPrivate::undo_list_type::iterator it = this->private_->undo_list_.begin();
   UndoBufferPrivate::undo_list_type::iterator it_end = this->private_->undo_list_.end();
 
   size_t max_num_undos = 0;
+  boost::filesystem::path disk_directory;
 
   while ( it != it_end )
   {
-    size += (*it)->get_byte_size();
+    // NOTE: Check points of older items may have been replaced by smaller differences when
+    // the check points of the new item were made, hence their size needs to be updated.
+    (*it)->compute_size();
+    size_t item_size = (*it)->get_byte_size();
+
+    if ( size + item_size > max_size )
+    {
+      // NOTE: The size in memory is an upper bound for the size on disk until the file
+      // has been written
+      if ( disk_size + item_size > max_disk_size ) break;
+      if ( disk_directory.empty() && 
+        !this->private_->get_disk_directory( disk_directory ) ) break;
+      if ( !( (*it)->move_to_disk( disk_directory ) ) ) break;
+      
+      (*it)->compute_size();
+      item_size = (*it)->get_byte_size();
+    }
+
+    size += item_size;
+    disk_size += (*it)->get_disk_byte_size();
     max_num_undos++;
     if ( size > max_size ) break;
+    if ( disk_size > max_disk_size ) break;
     if ( max_num_undos >= 100 ) break;
     ++it;
   }
@@ -282,6 +372,21 @@ bool UndoBuffer::has_redo() const
   return ! ( this->private_->redo_list_.empty() );
 }
 
+void UndoBuffer::begin_restore()
+{
+  this->private_->num_restores_++;
+}
+
+void UndoBuffer::end_restore()
+{
+  if ( this->private_->num_restores_ > 0 ) this->private_->num_restores_--;
+}
+
+bool UndoBuffer::is_restoring() const
+{
+  return this->private_->num_restores_ > 0;
+}
+
 size_t UndoBuffer::num_undo_items()
 {
   return this->private_->undo_list_.size();
@@ -108,6 +108,20 @@ public:
   /// Check whether there is something to redo
   bool has_redo() const;
 
+  /// BEGIN_RESTORE:
+  /// Mark that an undo or redo step restores data in the background. No other step can be
+  /// applied until end_restore is called, as it would work on data that is not restored yet.
+  /// NOTE: These functions need to be called from the application thread.
+  void begin_restore();
+
+  /// END_RESTORE:
+  /// Mark that a restore started with begin_restore is done
+  void end_restore();
+
+  /// IS_RESTORING:
+  /// Check whether an undo or redo step is still restoring data
+  bool is_restoring() const;
+
   /// NUM_UNDO_ITEMS:
   /// Get the number of undo items on the stack
   size_t num_undo_items();
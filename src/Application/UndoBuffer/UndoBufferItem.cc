@@ -82,6 +82,16 @@ bool UndoBufferItem::apply_redo( Core::ActionContextHandle& context )
   return true;
 }
 
+size_t UndoBufferItem::get_disk_byte_size() const
+{
+  return 0;
+}
+
+bool UndoBufferItem::move_to_disk( const boost::filesystem::path& /*directory*/ )
+{
+  return false;
+}
+
 std::string UndoBufferItem::get_tag() const
 {
   return this->private_->tag_;
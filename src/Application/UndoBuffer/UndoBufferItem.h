@@ -29,6 +29,9 @@
 #ifndef APPLICATION_UNDOBUFFER_UNDOBUFFERITEM_H
 #define APPLICATION_UNDOBUFFER_UNDOBUFFERITEM_H
 
+// Boost includes
+#include <boost/filesystem/path.hpp>
+
 // Core includes
 #include <Core/Action/Action.h>
 
@@ -78,6 +81,17 @@ public:
   /// Compute the size of the item
   virtual void compute_size() = 0;
 
+  /// GET_DISK_BYTE_SIZE:
+  /// The size of the data of the item that was moved to disk ( approximately )
+  virtual size_t get_disk_byte_size() const;
+
+  /// MOVE_TO_DISK:
+  /// Write the data of the item to files in the given directory and release its memory once
+  /// they are written. The files are written in the background. Returns false if the item has
+  /// no data that can be moved to disk.
+  /// NOTE: compute_size needs to be called afterwards to update the size of the item.
+  virtual bool move_to_disk( const boost::filesystem::path& directory );
+
   /// GET_TAG:
   /// Tag that appears in the menu for this item
   std::string get_tag() const;
@@ -0,0 +1,212 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/DataBlock/DataType.h>
+#include <Core/DataBlock/DataBlockKernels.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/Parser/ArrayMathEngine.h>
+#include <Core/Application/Application.h>
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " [OPTIONS]" << std::endl;
+  std::cout << "Measures the expressions of the arithmetic filter, with each function run" << std::endl;
+  std::cout << "separately and with the expression fused into one loop." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --size=SCALAR                - Number of voxels in x and y, default is 1024." << std::endl;
+  std::cout << "  --slices=SCALAR              - Number of voxels in z, default is 256, which" << std::endl;
+  std::cout << "                                 makes a volume of 1 GB of floats." << std::endl;
+  std::cout << "  --type=TYPE                  - Data type of the input volume, default is float." << std::endl;
+  std::cout << "  --iterations=SCALAR          - Number of runs of every expression, default is 3." << std::endl;
+}
+
+static double ElapsedSeconds( const boost::posix_time::ptime& start_time )
+{
+  boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+  return ( end_time - start_time ).total_microseconds() * 1e-6;
+}
+
+static void PrintResult( const std::string& name, double seconds, size_t iterations, size_t size )
+{
+  double seconds_per_run = seconds / iterations;
+  std::cout << std::setw( 12 ) << name << std::setw( 12 ) << std::setprecision( 4 ) 
+    << seconds_per_run * 1e3 << " ms" << std::setw( 12 ) << std::setprecision( 4 ) 
+    << size / seconds_per_run * 1e-6 << " Mvoxels/s" << std::endl;
+}
+
+// Run an expression the way the arithmetic filter does, with the volume as 'data' and
+// a float volume, or a char volume for masks, as 'RESULT'
+static bool RunExpression( const std::string& expression, Core::DataBlockHandle data, 
+  Core::DataType output_type, bool fused )
+{
+  Core::ArrayMathEngine engine;
+  engine.set_fused_execution( fused );
+
+  std::string error;
+  std::string expressions = expression;
+  if ( !engine.add_input_data_block( "data", data, error ) ||
+    !engine.add_output_data_block( "RESULT", data->get_nx(), data->get_ny(), data->get_nz(),
+    output_type, error ) ||
+    !engine.add_expressions( expressions ) ||
+    !engine.parse_and_validate( error ) ||
+    !engine.run( error ) )
+  {
+    CORE_PRINT_AND_LOG_ERROR( "Expression '" + expression + "' failed: " + error );
+    return false;
+  }
+  return true;
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "ArithmeticFilterBenchmark" );
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 0 );
+
+  if ( Core::Application::Instance()->is_command_line_parameter( "help" ) )
+  {
+    printUsage();
+    return 0;
+  }
+
+  size_t edge = 1024;
+  std::string size_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "size", size_string ) )
+  {
+    if ( !Core::ImportFromString( size_string, edge ) || edge < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Size needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  size_t slices = 256;
+  std::string slices_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "slices", slices_string ) )
+  {
+    if ( !Core::ImportFromString( slices_string, slices ) || slices < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of slices needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  Core::DataType data_type = Core::DataType::FLOAT_E;
+  std::string type_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "type", type_string ) )
+  {
+    if ( !Core::ImportFromString( type_string, data_type ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Unknown data type '" + type_string + "'." );
+      return -1;
+    }
+  }
+
+  size_t iterations = 3;
+  std::string iterations_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "iterations", iterations_string ) )
+  {
+    if ( !Core::ImportFromString( iterations_string, iterations ) || iterations < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of iterations needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  // Expressions as they are typed into the arithmetic filter, the last two create masks
+  const char* expressions[] =
+  {
+    "RESULT = data * 2 + 1;",
+    "RESULT = abs( data - 50 ) / ( data + 1 );",
+    "RESULT = select( data > 20, sqrt( data ), -data );",
+    "RESULT = data > 20 && data < 80;",
+    "RESULT = data == 13 || data == 42;"
+  };
+  const size_t num_expressions = sizeof( expressions ) / sizeof( const char* );
+  const size_t num_float_expressions = 3;
+
+  Core::DataBlockHandle data = Core::StdDataBlock::New( edge, edge, slices, data_type );
+  if ( !data || data->get_data() == 0 )
+  {
+    CORE_PRINT_AND_LOG_ERROR( "Could not allocate the input volume." );
+    return -1;
+  }
+
+  size_t size = data->get_size();
+  std::vector< float > values( edge * edge );
+  for ( size_t j = 0; j < values.size(); j++ ) values[ j ] = static_cast< float >( ( j * 7919 ) % 101 );
+  for ( size_t k = 0; k < slices; k++ )
+  {
+    Core::DataBlockKernels::Convert( &values[ 0 ], Core::DataType::FLOAT_E, 
+      static_cast< char* >( data->get_data() ) + k * values.size() * data->get_elem_size(),
+      data_type, values.size() );
+  }
+
+  std::cout << "Volume of " << edge << "x" << edge << "x" << slices << " " 
+    << Core::ExportToString( data_type ) << " voxels (" << data->get_byte_size() / ( 1 << 20 ) 
+    << " MB), " << iterations << " runs per expression" << std::endl;
+
+  for ( size_t e = 0; e < num_expressions; e++ )
+  {
+    Core::DataType output_type = e < num_float_expressions ? Core::DataType::FLOAT_E : 
+      Core::DataType::CHAR_E;
+    std::cout << "== " << expressions[ e ] << " ==" << std::endl;
+
+    for ( int fused = 0; fused < 2; fused++ )
+    {
+      boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < iterations; j++ )
+      {
+        if ( !RunExpression( expressions[ e ], data, output_type, fused != 0 ) ) return -1;
+      }
+      PrintResult( fused ? "fused" : "functions", ElapsedSeconds( start_time ), iterations, size );
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/Math/MathFunctions.h>
+#include <Core/Application/Application.h>
+
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+#include <Core/LargeVolume/BrickCodec.h>
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " volume [OPTIONS]" << std::endl;
+  std::cout << "Compares the brick codecs and filters on bricks of an existing large volume." << std::endl << std::endl;
+  std::cout << "Mandatory arguments:" << std::endl;
+  std::cout << "  volume                       - Directory of a large volume (.s3dvol)." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --level=SCALAR               - Level to take bricks from, default is 0." << std::endl;
+  std::cout << "  --numbricks=SCALAR           - Number of bricks to test on, default is 32." << std::endl;
+}
+
+static double ElapsedSeconds( const boost::posix_time::ptime& start_time )
+{
+  boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+  return ( end_time - start_time ).total_microseconds() * 1e-6;
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "BrickCodecBenchmark" );
+
+  if ( argc < 2 )
+  {
+    printUsage();
+    return 0;
+  }
+
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 1 );
+
+  Core::LargeVolumeSchemaHandle schema( new Core::LargeVolumeSchema );
+  schema->set_dir( boost::filesystem::path( Core::Application::Instance()->get_argument( 0 ) ) );
+
+  std::string error;
+  if ( !schema->load( error ) )
+  {
+    printUsage();
+    CORE_PRINT_AND_LOG_ERROR( error );
+    return -1;
+  }
+
+  size_t level = 0;
+  std::string level_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "level", level_string ) )
+  {
+    if ( !Core::ImportFromString( level_string, level ) || level >= schema->get_num_levels() )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Level needs to be smaller than " + 
+        Core::ExportToString( schema->get_num_levels() ) + "." );
+      return -1;
+    }
+  }
+
+  size_t num_bricks = 32;
+  std::string num_bricks_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "numbricks", num_bricks_string ) )
+  {
+    if ( !Core::ImportFromString( num_bricks_string, num_bricks ) || num_bricks < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of bricks needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  // -- Read bricks spread evenly over the level --
+  size_t level_bricks = schema->compute_level_num_bricks( level );
+  num_bricks = Core::Min( num_bricks, level_bricks );
+
+  std::vector<Core::DataBlockHandle> bricks;
+  double total_bytes = 0.0;
+  for ( size_t j = 0; j < num_bricks; j++ )
+  {
+    Core::BrickInfo bi( ( j * level_bricks ) / num_bricks, level );
+    Core::DataBlockHandle brick;
+    if ( !schema->read_brick( brick, bi, error ) )
+    {
+      CORE_PRINT_AND_LOG_ERROR( error );
+      return -1;
+    }
+    bricks.push_back( brick );
+    total_bytes += static_cast<double>( brick->get_byte_size() );
+  }
+
+  std::cout << "== " << bricks.size() << " bricks of level " << level << ", " 
+    << Core::ExportToString( schema->get_data_type() ) << ", " 
+    << static_cast<long long>( total_bytes ) / ( 1 << 20 ) << " MB ==" << std::endl;
+  std::cout << std::setw( 8 ) << "codec" << std::setw( 10 ) << "filter" << std::setw( 10 ) << "ratio" 
+    << std::setw( 14 ) << "encode MB/s" << std::setw( 14 ) << "decode MB/s" << std::endl;
+
+  Core::BrickCodecType codecs[] = { Core::BrickCodecType::ZLIB_E, Core::BrickCodecType::LZ4_E };
+  Core::BrickFilterType filters[] = { Core::BrickFilterType::NONE_E, 
+    Core::BrickFilterType::SHUFFLE_E, Core::BrickFilterType::DELTA_SHUFFLE_E };
+
+  for ( size_t c = 0; c < 2; c++ )
+  {
+    for ( size_t f = 0; f < 3; f++ )
+    {
+      std::vector< std::vector<char> > buffers( bricks.size() );
+      double compressed_bytes = 0.0;
+
+      boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < bricks.size(); j++ )
+      {
+        // Bricks that do not compress are stored as is
+        if ( !Core::BrickCodec::Compress( codecs[ c ], filters[ f ], bricks[ j ]->get_data_type(), 
+          bricks[ j ]->get_data(), bricks[ j ]->get_byte_size(), buffers[ j ] ) )
+        {
+          buffers[ j ].clear();
+        }
+      }
+      double encode_time = ElapsedSeconds( start_time );
+
+      std::vector<char> output;
+      start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < bricks.size(); j++ )
+      {
+        size_t size = bricks[ j ]->get_byte_size();
+        if ( buffers[ j ].empty() )
+        {
+          compressed_bytes += static_cast<double>( size );
+          continue;
+        }
+
+        compressed_bytes += static_cast<double>( buffers[ j ].size() );
+        output.resize( size );
+        if ( !Core::BrickCodec::Decompress( codecs[ c ], filters[ f ], bricks[ j ]->get_data_type(),
+          &buffers[ j ][ 0 ], buffers[ j ].size(), &output[ 0 ], size ) )
+        {
+          CORE_PRINT_AND_LOG_ERROR( "Could not decompress brick." );
+          return -1;
+        }
+      }
+      double decode_time = ElapsedSeconds( start_time );
+
+      const double mb = total_bytes / ( 1 << 20 );
+      std::cout << std::setw( 8 ) << Core::ExportToString( codecs[ c ] ) 
+        << std::setw( 10 ) << Core::ExportToString( filters[ f ] )
+        << std::setw( 10 ) << std::setprecision( 3 ) << total_bytes / compressed_bytes
+        << std::setw( 14 ) << std::setprecision( 5 ) << mb / Core::Max( encode_time, 1e-6 )
+        << std::setw( 14 ) << mb / Core::Max( decode_time, 1e-6 ) << std::endl;
+    }
+  }
+
+  return 0;
+}
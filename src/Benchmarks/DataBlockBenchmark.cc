@@ -0,0 +1,193 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/DataBlock/DataType.h>
+#include <Core/DataBlock/DataBlockKernels.h>
+#include <Core/Application/Application.h>
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " [OPTIONS]" << std::endl;
+  std::cout << "Measures the data block kernels (min/max, endian swap, conversion to float and" << std::endl;
+  std::cout << "quantization to unsigned char) for every data type and instruction set." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --size=SCALAR                - Edge of the cubic volume, default is 512." << std::endl;
+  std::cout << "  --iterations=SCALAR          - Number of runs of every kernel, default is 3." << std::endl;
+}
+
+static double ElapsedSeconds( const boost::posix_time::ptime& start_time )
+{
+  boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+  return ( end_time - start_time ).total_microseconds() * 1e-6;
+}
+
+static void PrintResult( const std::string& name, double seconds, size_t iterations, size_t size )
+{
+  double seconds_per_run = seconds / iterations;
+  std::cout << std::setw( 16 ) << name << std::setw( 12 ) << std::setprecision( 4 ) 
+    << seconds_per_run * 1e3 << " ms" << std::setw( 12 ) << std::setprecision( 4 ) 
+    << size / seconds_per_run * 1e-6 << " Mvoxels/s" << std::endl;
+}
+
+static std::string InstructionSetName( Core::InstructionSetType instruction_set )
+{
+  switch ( instruction_set )
+  {
+  case Core::InstructionSetType::SSE2_E: return "sse2";
+  case Core::InstructionSetType::AVX2_E: return "avx2";
+  default: return "scalar";
+  }
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "DataBlockBenchmark" );
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 0 );
+
+  if ( Core::Application::Instance()->is_command_line_parameter( "help" ) )
+  {
+    printUsage();
+    return 0;
+  }
+
+  size_t edge = 512;
+  std::string size_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "size", size_string ) )
+  {
+    if ( !Core::ImportFromString( size_string, edge ) || edge < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Size needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  size_t iterations = 3;
+  std::string iterations_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "iterations", iterations_string ) )
+  {
+    if ( !Core::ImportFromString( iterations_string, iterations ) || iterations < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of iterations needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  const Core::DataType data_types[] = 
+  {
+    Core::DataType::CHAR_E, Core::DataType::UCHAR_E, Core::DataType::SHORT_E, 
+    Core::DataType::USHORT_E, Core::DataType::INT_E, Core::DataType::UINT_E, 
+    Core::DataType::FLOAT_E, Core::DataType::DOUBLE_E
+  };
+
+  std::vector< Core::InstructionSetType > instruction_sets;
+  for ( int j = Core::InstructionSetType::SCALAR_E; 
+    j <= Core::DataBlockKernels::GetSupportedInstructionSet(); j++ )
+  {
+    instruction_sets.push_back( static_cast< Core::InstructionSetType::enum_type >( j ) );
+  }
+
+  size_t size = edge * edge * edge;
+  std::vector< float > values( size );
+  for ( size_t j = 0; j < size; j++ ) values[ j ] = static_cast< float >( ( j * 7919 ) % 101 );
+  std::vector< unsigned char > src( size * sizeof( double ) );
+  std::vector< unsigned char > dst( size * sizeof( float ) );
+
+  std::cout << "Volume of " << edge << "^3 voxels, " << iterations << " runs per kernel" << std::endl;
+
+  for ( size_t t = 0; t < sizeof( data_types ) / sizeof( Core::DataType ); t++ )
+  {
+    Core::DataType data_type = data_types[ t ];
+    std::cout << "== " << Core::ExportToString( data_type ) << " ==" << std::endl;
+    Core::DataBlockKernels::Convert( &values[ 0 ], Core::DataType::FLOAT_E, &src[ 0 ], 
+      data_type, size );
+
+    for ( size_t k = 0; k < instruction_sets.size(); k++ )
+    {
+      Core::DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+      std::string suffix = " " + InstructionSetName( instruction_sets[ k ] );
+
+      double min, max;
+      boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < iterations; j++ )
+      {
+        Core::DataBlockKernels::ComputeMinMax( &src[ 0 ], data_type, size, min, max );
+      }
+      PrintResult( "minmax" + suffix, ElapsedSeconds( start_time ), iterations, size );
+
+      // Single bytes have no byte order
+      size_t elem_size = Core::GetSizeDataType( data_type );
+      if ( elem_size > 1 )
+      {
+        start_time = boost::posix_time::microsec_clock::local_time();
+        for ( size_t j = 0; j < iterations; j++ )
+        {
+          Core::DataBlockKernels::SwapEndian( &src[ 0 ], size, elem_size );
+        }
+        PrintResult( "swap" + suffix, ElapsedSeconds( start_time ), iterations, size );
+        if ( iterations % 2 ) Core::DataBlockKernels::SwapEndian( &src[ 0 ], size, elem_size );
+      }
+
+      start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < iterations; j++ )
+      {
+        Core::DataBlockKernels::Convert( &src[ 0 ], data_type, &dst[ 0 ], 
+          Core::DataType::FLOAT_E, size );
+      }
+      PrintResult( "to float" + suffix, ElapsedSeconds( start_time ), iterations, size );
+
+      start_time = boost::posix_time::microsec_clock::local_time();
+      for ( size_t j = 0; j < iterations; j++ )
+      {
+        Core::DataBlockKernels::Quantize( &src[ 0 ], data_type, &dst[ 0 ], 
+          Core::DataType::UCHAR_E, size, min, max );
+      }
+      PrintResult( "quantize" + suffix, ElapsedSeconds( start_time ), iterations, size );
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,347 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Geometry/Point.h>
+#include <Core/Geometry/Vector.h>
+#include <Core/Geometry/BBox.h>
+#include <Core/Utils/Log.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/Math/MathFunctions.h>
+#include <Core/Application/Application.h>
+#include <Core/DataBlock/StdDataBlock.h>
+
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+#include <Core/LargeVolume/LargeVolumeCache.h>
+
+// A single step of a recorded pan/zoom trace: the center of the viewport in world
+// coordinates and the size of a screen pixel in world units.
+struct TraceStep
+{
+  double x_;
+  double y_;
+  double pixel_size_;
+};
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " scratch_volume [OPTIONS]" << std::endl;
+  std::cout << "Replays a pan/zoom trace against a synthetic large volume and reports the time it takes"
+            << " for each view to be rendered at its full resolution." << std::endl << std::endl;
+  std::cout << "Mandatory arguments:" << std::endl;
+  std::cout << "  scratch_volume               - Directory in which the synthetic volume is generated." << std::endl
+            << "                                 An existing volume in this directory is reused." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --size=VECTOR                - Size of the synthetic volume, default is 8192,8192,64." << std::endl;
+  std::cout << "  --bricksize=SCALAR           - Brick size, default is 256." << std::endl;
+  std::cout << "  --trace=FILE                 - Trace file with one 'x y pixel_size' line per view." << std::endl
+            << "                                 By default a trace panning and zooming across the volume is used." << std::endl;
+  std::cout << "  --screen=SCALAR              - Width and height of the simulated viewer in pixels, default is 1024." << std::endl;
+  std::cout << "  --cachemb=SCALAR             - Capacity of the brick cache in MB, default is based on available memory." << std::endl;
+}
+
+// Generate bricks with a smooth pattern and some noise so they compress like image data
+void GenerateBricks( Core::LargeVolumeSchemaHandle schema, const std::vector<Core::BrickInfo>& bricks,
+  int thread, int num_threads, boost::barrier& barrier )
+{
+  for ( size_t j = thread; j < bricks.size(); j += num_threads )
+  {
+    Core::IndexVector size = schema->get_brick_size( bricks[ j ] );
+    Core::DataBlockHandle brick = Core::StdDataBlock::New( size.x(), size.y(), size.z(), 
+      Core::DataType::USHORT_E );
+    unsigned short* data = reinterpret_cast<unsigned short*>( brick->get_data() );
+
+    unsigned int seed = static_cast<unsigned int>( bricks[ j ].index_ * 31 + bricks[ j ].level_ );
+    size_t num_voxels = brick->get_size();
+    for ( size_t k = 0; k < num_voxels; k++ )
+    {
+      seed = seed * 1103515245u + 12345u;
+      data[ k ] = static_cast<unsigned short>( ( ( k / 7 ) & 0x3ff ) + ( ( seed >> 16 ) & 0x3f ) );
+    }
+
+    std::string error;
+    if ( !schema->write_brick( brick, bricks[ j ], error ) )
+    {
+      CORE_PRINT_AND_LOG_ERROR( error );
+    }
+  }
+}
+
+// Number of bricks that are needed to render a view at full resolution, this mirrors the
+// level selection done in LargeVolumeSchema::get_bricks_for_region
+size_t ComputeFullResolutionBricks( Core::LargeVolumeSchemaHandle schema, const Core::BBox& region,
+  double pixel_size, Core::LargeVolumeSchema::index_type& level )
+{
+  typedef Core::LargeVolumeSchema::index_type index_type;
+
+  level = 0;
+  index_type num_levels = static_cast<index_type>( schema->get_num_levels() );
+  while ( level + 1 < num_levels )
+  {
+    Core::Vector spacing = schema->get_level_spacing( level + 1 );
+    if ( Core::Max( spacing.x(), spacing.y() ) >= pixel_size ) break;
+    level++;
+  }
+
+  Core::Vector min = region.min() - schema->get_origin();
+  Core::Vector max = region.max() - schema->get_origin();
+  Core::Vector spacing = schema->get_level_spacing( level );
+  Core::IndexVector layout = schema->get_level_layout( level );
+  Core::IndexVector eb = schema->get_effective_brick_size();
+
+  index_type sx = Core::Max( 0, Core::Floor( min.x() / ( eb.x() * spacing.x() ) ) );
+  index_type ex = Core::Min( layout.x(), static_cast<index_type>( Core::Floor( max.x() / ( eb.x() * spacing.x() ) ) + 1 ) );
+  index_type sy = Core::Max( 0, Core::Floor( min.y() / ( eb.y() * spacing.y() ) ) );
+  index_type ey = Core::Min( layout.y(), static_cast<index_type>( Core::Floor( max.y() / ( eb.y() * spacing.y() ) ) + 1 ) );
+  index_type sz = Core::Max( 0, Core::Floor( min.z() / ( eb.z() * spacing.z() ) ) );
+  index_type ez = Core::Min( layout.z(), static_cast<index_type>( Core::Floor( max.z() / ( eb.z() * spacing.z() ) ) + 1 ) );
+
+  return static_cast<size_t>( ( ex - sx ) * ( ey - sy ) * ( ez - sz ) );
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "LargeVolumeCacheBenchmark" );
+
+  if ( argc < 2 )
+  {
+    printUsage();
+    return 0;
+  }
+
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 1 );
+
+  boost::filesystem::path volume_dir( Core::Application::Instance()->get_argument( 0 ) );
+
+  Core::IndexVector size( 8192, 8192, 64 );
+  std::string size_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "size", size_string ) )
+  {
+    if ( !Core::ImportFromString( size_string, size ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Size needs to be a vector in the following format: --size=8192,8192,64" );
+      return -1;
+    }
+  }
+
+  size_t brick_size = 256;
+  std::string brick_size_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "bricksize", brick_size_string ) )
+  {
+    if ( !Core::ImportFromString( brick_size_string, brick_size ) || !Core::IsPowerOf2( brick_size ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Brick size needs to be a power of two." );
+      return -1;
+    }
+  }
+
+  int screen = 1024;
+  std::string screen_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "screen", screen_string ) )
+  {
+    if ( !Core::ImportFromString( screen_string, screen ) || screen < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Screen size needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  std::string cache_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "cachemb", cache_string ) )
+  {
+    long long cache_mb;
+    if ( !Core::ImportFromString( cache_string, cache_mb ) || cache_mb < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Cache size needs to be a positive number of MB." );
+      return -1;
+    }
+    Core::LargeVolumeCache::Instance()->set_cache_capacity( cache_mb << 20 );
+  }
+
+  // -- Create or load the synthetic volume --
+  Core::LargeVolumeSchemaHandle schema( new Core::LargeVolumeSchema );
+  schema->set_dir( volume_dir );
+  std::string error;
+
+  if ( !schema->load( error ) )
+  {
+    std::cout << "== Generating synthetic volume " << Core::ExportToString( size ) << " ==" << std::endl;
+
+    schema->set_parameters( size, Core::Vector( 1.0, 1.0, 1.0 ), Core::Point( 0.0, 0.0, 0.0 ),
+      Core::IndexVector( brick_size, brick_size, brick_size ), 1, Core::DataType::USHORT_E );
+    schema->set_compression( true );
+    schema->enable_downsample( true, true, true );
+    schema->compute_levels();
+    schema->set_min_max( 0.0, 1087.0 );
+
+    if ( !schema->save( error ) )
+    {
+      CORE_PRINT_AND_LOG_ERROR( error );
+      return -1;
+    }
+
+    std::vector<Core::BrickInfo> bricks;
+    for ( size_t level = 0; level < schema->get_num_levels(); level++ )
+    {
+      size_t num_bricks = schema->compute_level_num_bricks( level );
+      for ( size_t j = 0; j < num_bricks; j++ )
+      {
+        bricks.push_back( Core::BrickInfo( j, level ) );
+      }
+    }
+
+    Core::Parallel parallel_generate( boost::bind( &GenerateBricks, schema, boost::cref( bricks ), 
+      _1, _2, _3 ) );
+    parallel_generate.run();
+  }
+
+  // -- Load or generate the trace --
+  std::vector<TraceStep> trace;
+  std::string trace_file;
+  if ( Core::Application::Instance()->check_command_line_parameter( "trace", trace_file ) )
+  {
+    std::ifstream input( trace_file.c_str() );
+    TraceStep step;
+    while ( input >> step.x_ >> step.y_ >> step.pixel_size_ )
+    {
+      trace.push_back( step );
+    }
+
+    if ( trace.empty() )
+    {
+      CORE_PRINT_AND_LOG_ERROR( "Could not read trace file '" + trace_file + "'." );
+      return -1;
+    }
+  }
+  else
+  {
+    // Start with the whole volume on screen, zoom into the center, pan across
+    // the volume at full resolution and zoom back out.
+    const double full_view = static_cast<double>( Core::Max( size.x(), size.y() ) ) / screen;
+    const double cx = 0.5 * size.xd();
+    const double cy = 0.5 * size.yd();
+    for ( double ps = full_view; ps > 0.5; ps *= 0.5 )
+    {
+      TraceStep step = { cx, cy, ps };
+      trace.push_back( step );
+    }
+    for ( int j = 0; j <= 16; j++ )
+    {
+      TraceStep step = { cx + ( j - 8 ) * 0.1 * size.xd(), cy + ( j - 8 ) * 0.05 * size.yd(), 1.0 };
+      trace.push_back( step );
+    }
+    for ( double ps = 2.0; ps < 2.0 * full_view; ps *= 2.0 )
+    {
+      TraceStep step = { cx, cy, ps };
+      trace.push_back( step );
+    }
+  }
+
+  // -- Replay the trace --
+  Core::LargeVolumeCache* cache = Core::LargeVolumeCache::Instance();
+  std::cout << "== Replaying " << trace.size() << " views using " 
+    << cache->get_num_load_threads() << " load threads ==" << std::endl;
+
+  const std::string load_key = "benchmark";
+  const double depth = 0.5 * size.zd();
+  Core::BBox volume_box( Core::Point( -0.5, -0.5, -0.5 ), 
+    Core::Point( size.xd() - 0.5, size.yd() - 0.5, size.zd() - 0.5 ) );
+
+  double total_time = 0.0;
+  double max_time = 0.0;
+
+  for ( size_t j = 0; j < trace.size(); j++ )
+  {
+    const double half_width = 0.5 * screen * trace[ j ].pixel_size_;
+    Core::BBox view( Core::Point( trace[ j ].x_ - half_width, trace[ j ].y_ - half_width, depth ),
+      Core::Point( trace[ j ].x_ + half_width, trace[ j ].y_ + half_width, depth ) );
+    if ( !view.overlaps( volume_box ) ) continue;
+    Core::BBox region( Core::Max( view.min(), volume_box.min() ), Core::Min( view.max(), volume_box.max() ) );
+
+    Core::LargeVolumeSchema::index_type level;
+    size_t num_bricks = ComputeFullResolutionBricks( schema, region, trace[ j ].pixel_size_, level );
+
+    boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+
+    // Poll like the renderer does on every redraw until the view is complete
+    for ( ;; )
+    {
+      std::vector<Core::BrickInfo> bricks = schema->get_bricks_for_region( region, 
+        trace[ j ].pixel_size_, Core::SliceType::AXIAL_E, load_key );
+      
+      size_t num_full_res = 0;
+      for ( size_t k = 0; k < bricks.size(); k++ )
+      {
+        if ( bricks[ k ].level_ == level ) num_full_res++;
+      }
+      if ( num_full_res == num_bricks && bricks.size() == num_bricks ) break;
+
+      boost::this_thread::sleep( boost::posix_time::milliseconds( 2 ) );
+    }
+
+    boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+    double step_time = ( end_time - start_time ).total_microseconds() * 1e-3;
+    total_time += step_time;
+    max_time = Core::Max( max_time, step_time );
+
+    std::cout << "view " << j << ": level=" << level << " bricks=" << num_bricks 
+      << " time-to-full-resolution=" << step_time << " ms" << std::endl;
+  }
+
+  std::cout << "== total=" << total_time << " ms, mean=" << total_time / trace.size() 
+    << " ms, max=" << max_time << " ms ==" << std::endl;
+
+  Core::LargeVolumeCacheStatistics statistics = cache->get_statistics();
+  std::cout << "== cache hits=" << statistics.hits_ << " misses=" << statistics.misses_
+    << " insertions=" << statistics.insertions_ << " evictions=" << statistics.evictions_
+    << " bricks=" << statistics.num_bricks_ << " size=" << ( statistics.size_ >> 20 ) << " MB"
+    << " capacity=" << ( statistics.capacity_ >> 20 ) << " MB ==" << std::endl;
+
+  return 0;
+}
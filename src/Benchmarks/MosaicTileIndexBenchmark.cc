@@ -0,0 +1,200 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/Application/Application.h>
+#include <Core/ITKCommon/mosaic_tile_index.hxx>
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " [OPTIONS]" << std::endl;
+  std::cout << "Measures how fast the tiles that cover each pixel of a mosaic are found, by testing" << std::endl;
+  std::cout << "every tile for every pixel and by looking up the tiles of each block of pixels in a" << std::endl;
+  std::cout << "mosaic tile index. The layout is a synthetic grid of overlapping, jittered tiles." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --tiles=SCALAR               - Number of tiles along each side, default is 100 (10k tiles)." << std::endl;
+  std::cout << "  --pixels=SCALAR              - Mosaic size in pixels along each side, default is 500." << std::endl;
+  std::cout << "  --block=SCALAR               - Size of the mosaic blocks in pixels, default is 64." << std::endl;
+}
+
+static double ElapsedSeconds( const boost::posix_time::ptime& start_time )
+{
+  boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+  return ( end_time - start_time ).total_microseconds() * 1e-6;
+}
+
+static bool InsideBBox( const double* bbox, double x, double y )
+{
+  return bbox[ 0 ] <= x && x <= bbox[ 2 ] && bbox[ 1 ] <= y && y <= bbox[ 3 ];
+}
+
+static bool ReadParameter( const std::string& name, size_t& value )
+{
+  std::string value_string;
+  if ( !Core::Application::Instance()->check_command_line_parameter( name, value_string ) )
+  {
+    return true;
+  }
+  return Core::ImportFromString( value_string, value ) && value > 0;
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "MosaicTileIndexBenchmark" );
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 0 );
+
+  if ( Core::Application::Instance()->is_command_line_parameter( "help" ) )
+  {
+    printUsage();
+    return 0;
+  }
+
+  size_t tiles_per_side = 100;
+  size_t pixels = 500;
+  size_t block_size = 64;
+  if ( !ReadParameter( "tiles", tiles_per_side ) || !ReadParameter( "pixels", pixels ) ||
+    !ReadParameter( "block", block_size ) )
+  {
+    printUsage();
+    CORE_PRINT_AND_LOG_ERROR( "Parameters need to be positive numbers." );
+    return -1;
+  }
+
+  // Tiles of 1000 units with 10% overlap, jittered by a few percent as after registration
+  const double tile_size = 1000.0;
+  const double tile_step = 900.0;
+  const size_t num_tiles = tiles_per_side * tiles_per_side;
+  std::vector<double> bbox( 4 * num_tiles );
+  unsigned int seed = 1;
+  for ( size_t j = 0; j < num_tiles; j++ )
+  {
+    seed = seed * 1103515245u + 12345u;
+    double jitter_x = static_cast<double>( ( seed >> 16 ) % 61 ) - 30.0;
+    seed = seed * 1103515245u + 12345u;
+    double jitter_y = static_cast<double>( ( seed >> 16 ) % 61 ) - 30.0;
+
+    double x = static_cast<double>( j % tiles_per_side ) * tile_step + jitter_x;
+    double y = static_cast<double>( j / tiles_per_side ) * tile_step + jitter_y;
+    bbox[ 4 * j + 0 ] = x;
+    bbox[ 4 * j + 1 ] = y;
+    bbox[ 4 * j + 2 ] = x + tile_size;
+    bbox[ 4 * j + 3 ] = y + tile_size;
+  }
+
+  const double extent = static_cast<double>( tiles_per_side - 1 ) * tile_step + tile_size;
+  const double spacing = extent / static_cast<double>( pixels );
+
+  std::cout << "== " << num_tiles << " tiles, mosaic of " << pixels << "x" << pixels 
+    << " pixels ==" << std::endl;
+
+  // Every tile is tested for every pixel, as the mosaic assembly used to do
+  boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+  size_t brute_force_hits = 0;
+  for ( size_t y = 0; y < pixels; y++ )
+  {
+    for ( size_t x = 0; x < pixels; x++ )
+    {
+      double px = x * spacing;
+      double py = y * spacing;
+      for ( size_t j = 0; j < num_tiles; j++ )
+      {
+        if ( InsideBBox( &bbox[ 4 * j ], px, py ) ) brute_force_hits++;
+      }
+    }
+  }
+  double brute_force_time = ElapsedSeconds( start_time );
+
+  // Tiles are looked up per block of pixels
+  start_time = boost::posix_time::microsec_clock::local_time();
+  mosaic_tile_index_t tile_index;
+  tile_index.setup( bbox );
+  double setup_time = ElapsedSeconds( start_time );
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  size_t index_hits = 0;
+  size_t candidates = 0;
+  std::vector<unsigned int> tiles;
+  for ( size_t by = 0; by < pixels; by += block_size )
+  {
+    for ( size_t bx = 0; bx < pixels; bx += block_size )
+    {
+      size_t x_end = std::min( bx + block_size, pixels );
+      size_t y_end = std::min( by + block_size, pixels );
+      tile_index.find( bx * spacing - spacing, by * spacing - spacing, 
+        ( x_end - 1 ) * spacing + spacing, ( y_end - 1 ) * spacing + spacing, tiles );
+      candidates += tiles.size();
+
+      for ( size_t y = by; y < y_end; y++ )
+      {
+        for ( size_t x = bx; x < x_end; x++ )
+        {
+          double px = x * spacing;
+          double py = y * spacing;
+          for ( size_t j = 0; j < tiles.size(); j++ )
+          {
+            if ( InsideBBox( &bbox[ 4 * tiles[ j ] ], px, py ) ) index_hits++;
+          }
+        }
+      }
+    }
+  }
+  double index_time = ElapsedSeconds( start_time );
+
+  size_t num_blocks = ( ( pixels + block_size - 1 ) / block_size ) * 
+    ( ( pixels + block_size - 1 ) / block_size );
+  std::cout << std::setw( 24 ) << "every tile" << std::setw( 12 ) << std::setprecision( 4 ) 
+    << brute_force_time << " s" << std::endl;
+  std::cout << std::setw( 24 ) << "tile index" << std::setw( 12 ) << std::setprecision( 4 ) 
+    << index_time << " s (setup " << setup_time << " s, " 
+    << static_cast<double>( candidates ) / num_blocks << " tiles per block)" << std::endl;
+
+  if ( brute_force_hits != index_hits )
+  {
+    CORE_PRINT_AND_LOG_ERROR( "The tile index missed tiles that cover a pixel." );
+    return -1;
+  }
+
+  return 0;
+}
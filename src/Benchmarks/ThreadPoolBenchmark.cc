@@ -0,0 +1,215 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef _MSC_VER
+#pragma warning( disable: 4244 4267 )
+#endif
+
+// STL includes
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// boost includes
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// Core includes
+#include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
+#include <Core/Math/MathFunctions.h>
+#include <Core/Application/Application.h>
+
+void printUsage()
+{
+  std::cout << "USAGE: " << Core::Application::Instance()->GetUtilName()
+            <<  " [OPTIONS]" << std::endl;
+  std::cout << "Measures the fork-join overhead of starting threads for every call, of Core::Parallel" << std::endl;
+  std::cout << "and of the thread pool, and how they balance uneven work." << std::endl << std::endl;
+  std::cout << "Optional arguments:" << std::endl;
+  std::cout << "  --iterations=SCALAR          - Number of fork-join calls, default is 2000." << std::endl;
+  std::cout << "  --threads=SCALAR             - Number of threads, default is the number of cores." << std::endl;
+}
+
+static double ElapsedSeconds( const boost::posix_time::ptime& start_time )
+{
+  boost::posix_time::ptime end_time = boost::posix_time::microsec_clock::local_time();
+  return ( end_time - start_time ).total_microseconds() * 1e-6;
+}
+
+// Work whose cost grows with the index, so equal slices of the range are not equal work
+static double UnevenWork( size_t index )
+{
+  double sum = 0.0;
+  for ( size_t j = 0; j < index; j++ ) sum += std::sqrt( static_cast<double>( j ) );
+  return sum;
+}
+
+static void EmptyThreadFunction( int thread, int num_threads, boost::barrier& barrier )
+{
+}
+
+static void EmptyRange( size_t begin, size_t end )
+{
+}
+
+static void UnevenThreadFunction( size_t size, std::vector<double>* results, 
+  int thread, int num_threads, boost::barrier& barrier )
+{
+  // Static slices, as the existing Parallel users split their work
+  size_t begin = size * thread / num_threads;
+  size_t end = size * ( thread + 1 ) / num_threads;
+  for ( size_t j = begin; j < end; j++ ) ( *results )[ j ] = UnevenWork( j );
+}
+
+static void UnevenRange( std::vector<double>* results, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ ) ( *results )[ j ] = UnevenWork( j );
+}
+
+// The way Core::Parallel used to run: new threads for every call
+static void RunThreadPerCall( boost::function< void ( int, int, boost::barrier& ) > function, 
+  int num_threads )
+{
+  boost::barrier barrier( num_threads );
+  boost::thread_group threads;
+  for ( int j = 0; j < num_threads; j++ )
+  {
+    threads.create_thread( boost::bind( function, j, num_threads, boost::ref( barrier ) ) );
+  }
+  threads.join_all();
+}
+
+static void PrintResult( const std::string& name, double seconds, size_t iterations )
+{
+  std::cout << std::setw( 24 ) << name << std::setw( 14 ) << std::setprecision( 4 ) 
+    << seconds * 1e6 / iterations << " us" << std::endl;
+}
+
+int main( int argc, char **argv )
+{
+  Core::Application::SetUtilName( "ThreadPoolBenchmark" );
+  Core::Application::Instance()->parse_command_line_parameters( argc, argv, 0 );
+
+  if ( Core::Application::Instance()->is_command_line_parameter( "help" ) )
+  {
+    printUsage();
+    return 0;
+  }
+
+  size_t iterations = 2000;
+  std::string iterations_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "iterations", iterations_string ) )
+  {
+    if ( !Core::ImportFromString( iterations_string, iterations ) || iterations < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of iterations needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  int num_threads = Core::Max( 1, static_cast<int>( boost::thread::hardware_concurrency() ) );
+  std::string threads_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "threads", threads_string ) )
+  {
+    if ( !Core::ImportFromString( threads_string, num_threads ) || num_threads < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR( "Number of threads needs to be a positive number." );
+      return -1;
+    }
+  }
+
+  // Start the pool, so its threads are not counted in the first measurement
+  Core::ThreadPool::Instance()->parallel_for( 0, 1, 1, &EmptyRange );
+  Core::Parallel warm_up( &EmptyThreadFunction, num_threads );
+  warm_up.run();
+
+  std::cout << "== Fork-join of an empty function on " << num_threads << " threads, time per call ==" 
+    << std::endl;
+
+  boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < iterations; j++ )
+  {
+    RunThreadPerCall( &EmptyThreadFunction, num_threads );
+  }
+  PrintResult( "thread per call", ElapsedSeconds( start_time ), iterations );
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < iterations; j++ )
+  {
+    Core::Parallel parallel( &EmptyThreadFunction, num_threads );
+    parallel.run();
+  }
+  PrintResult( "Parallel", ElapsedSeconds( start_time ), iterations );
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < iterations; j++ )
+  {
+    Core::ThreadPool::Instance()->parallel_for( 0, num_threads, 1, &EmptyRange );
+  }
+  PrintResult( "ThreadPool parallel_for", ElapsedSeconds( start_time ), iterations );
+
+  // -- Uneven work --
+  const size_t size = 5000;
+  const size_t uneven_iterations = Core::Max( static_cast<size_t>( 1 ), iterations / 100 );
+  std::vector<double> results( size );
+
+  std::cout << "== Uneven work over " << size << " items, time per call ==" << std::endl;
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < uneven_iterations; j++ )
+  {
+    RunThreadPerCall( boost::bind( &UnevenThreadFunction, size, &results, _1, _2, _3 ), num_threads );
+  }
+  PrintResult( "thread per call", ElapsedSeconds( start_time ), uneven_iterations );
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < uneven_iterations; j++ )
+  {
+    Core::Parallel parallel( boost::bind( &UnevenThreadFunction, size, &results, _1, _2, _3 ), 
+      num_threads );
+    parallel.run();
+  }
+  PrintResult( "Parallel", ElapsedSeconds( start_time ), uneven_iterations );
+
+  start_time = boost::posix_time::microsec_clock::local_time();
+  for ( size_t j = 0; j < uneven_iterations; j++ )
+  {
+    Core::ThreadPool::Instance()->parallel_for( 0, size, 0, boost::bind( &UnevenRange, &results, _1, _2 ) );
+  }
+  PrintResult( "ThreadPool parallel_for", ElapsedSeconds( start_time ), uneven_iterations );
+
+  return 0;
+}
@@ -422,6 +422,12 @@ void Application::PostEvent( boost::function< void() > function )
   Instance()->post_event( function );
 }
 
+void Application::PostCoalescedEvent( EventQueue::coalesce_key_type key, 
+  boost::function< void() > function )
+{
+  Instance()->post_coalesced_event( key, function );
+}
+
 void Application::PostAndWaitEvent( boost::function< void() > function )
 {
   Instance()->post_and_wait_event( function );
@@ -209,6 +209,12 @@ public:
   /// Short cut to the event handler
   static void PostEvent( boost::function< void() > function );
 
+  // POSTCOALESCEDEVENT:
+  /// Short cut to the event handler, the event replaces an event with the same key that is
+  /// still waiting to be handled
+  static void PostCoalescedEvent( EventQueue::coalesce_key_type key, 
+    boost::function< void() > function );
+
   // POSTANDWAITEVENT:
   /// Short cut to the event handler
   static void PostAndWaitEvent( boost::function< void() > function );
@@ -27,6 +27,7 @@
 */
 
 #include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/DataBlockKernels.h>
 #include <Core/DataBlock/DataBlockManager.h>
 #include <Core/DataBlock/StdDataBlock.h>
 
@@ -300,154 +301,6 @@ size_t DataBlock::get_elem_size() const
 }
 
 
-void SwapEndian( void* data, size_t size, size_t elem_size )
-{
-  unsigned char* udata = reinterpret_cast<unsigned char*>( data );
-  switch( elem_size )
-  {
-    case 1:
-      return;
-
-    case 2:
-    {
-      unsigned char tmp;
-    
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-      }
-                  
-      for( ;  j < size; j++ )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 1 ]; udata[ 1 ] = tmp;
-        udata += 2;
-      }
-      return;
-    }
-    case 4:
-    {
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      unsigned char tmp;
-
-      for ( ; j < size8; j+=8 )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;     
-      }
-      for( ;  j < size; j++ )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 3 ]; udata[ 3 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 2 ]; udata[ 2 ] = tmp;
-        udata += 4;
-      }
-      return;
-    
-    } 
-    case 8:
-    {
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      unsigned char tmp;
-
-      for ( ; j < size8; j+=8 )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;     
-      }
-      for( ;  j < size; j++ )
-      {
-        tmp = udata[ 0 ]; udata[ 0 ] = udata[ 7 ]; udata[ 7 ] = tmp;
-        tmp = udata[ 1 ]; udata[ 1 ] = udata[ 6 ]; udata[ 6 ] = tmp;
-        tmp = udata[ 2 ]; udata[ 2 ] = udata[ 5 ]; udata[ 5 ] = tmp;
-        tmp = udata[ 3 ]; udata[ 3 ] = udata[ 4 ]; udata[ 4 ] = tmp;
-        udata += 8;
-      }
-      return; 
-    }
-  }
-}
-
 void DataBlock::swap_endian()
 {
   lock_type lock( this->get_mutex() );
@@ -459,211 +312,20 @@ void DataBlock::swap_endian()
       break;
     case DataType::SHORT_E:
     case DataType::USHORT_E:
-      SwapEndian( get_data(), get_size(), 2 );
+      DataBlockKernels::SwapEndian( get_data(), get_size(), 2 );
       break;
     case DataType::INT_E:
     case DataType::UINT_E:
     case DataType::FLOAT_E:
-      SwapEndian( get_data(), get_size(), 4 );
+      DataBlockKernels::SwapEndian( get_data(), get_size(), 4 );
       break;
     case DataType::DOUBLE_E:
-      SwapEndian( get_data(), get_size(), 8 );
+      DataBlockKernels::SwapEndian( get_data(), get_size(), 8 );
       break;
   }
 }
 
 
-template<class DATA>
-static bool ConvertDataTypeInternal( DATA* src, DataBlockHandle& dst_data_block )
-{
-  size_t size = dst_data_block->get_size();
-  switch ( dst_data_block->get_data_type() )
-  {
-    case DataType::CHAR_E:  
-    {
-      signed char* dst = reinterpret_cast<signed char*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<signed char>( src[ j ] );
-        dst[ j + 1 ] = static_cast<signed char>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<signed char>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<signed char>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<signed char>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<signed char>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<signed char>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<signed char>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<signed char>( src[ j ] );
-      }
-      return true;
-    }
-    case DataType::UCHAR_E: 
-    {
-      unsigned char* dst = reinterpret_cast<unsigned char*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned char>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned char>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned char>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned char>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned char>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned char>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned char>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned char>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned char>( src[ j ] );
-      }     
-      return true;
-    }
-    case DataType::SHORT_E: 
-    {
-      short* dst = reinterpret_cast<short*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<short>( src[ j ] );
-        dst[ j + 1 ] = static_cast<short>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<short>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<short>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<short>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<short>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<short>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<short>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<short>( src[ j ] );
-      }     
-      return true;
-    }
-    case DataType::USHORT_E:  
-    {
-      unsigned short* dst = reinterpret_cast<unsigned short*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned short>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned short>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned short>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned short>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned short>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned short>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned short>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned short>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned short>( src[ j ] );
-      } 
-      return true;
-    }
-    case DataType::INT_E: 
-    {
-      int* dst = reinterpret_cast<int*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<int>( src[ j ] );
-        dst[ j + 1 ] = static_cast<int>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<int>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<int>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<int>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<int>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<int>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<int>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<int>( src[ j ] );
-      }   
-      return true;
-    }
-    case DataType::UINT_E:  
-    {
-      unsigned int* dst = reinterpret_cast<unsigned int*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<unsigned int>( src[ j ] );
-        dst[ j + 1 ] = static_cast<unsigned int>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<unsigned int>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<unsigned int>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<unsigned int>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<unsigned int>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<unsigned int>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<unsigned int>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned int>( src[ j ] );
-      } 
-      return true;
-    }
-    case DataType::FLOAT_E: 
-    {
-      float* dst = reinterpret_cast<float*>( dst_data_block->get_data() );
-      size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<float>( src[ j ] );
-        dst[ j + 1 ] = static_cast<float>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<float>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<float>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<float>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<float>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<float>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<float>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<float>( src[ j ] );
-      }       
-      return true;
-    }
-    case DataType::DOUBLE_E:  
-    {
-      double* dst = reinterpret_cast<double*>( dst_data_block->get_data() );
-            size_t size8 = size & ~(0x7);
-      size_t j = 0;
-      for ( ; j < size8; j+=8 )
-      {
-        dst[ j ] = static_cast<double>( src[ j ] );
-        dst[ j + 1 ] = static_cast<double>( src[ j + 1 ] );
-        dst[ j + 2 ] = static_cast<double>( src[ j + 2 ] );
-        dst[ j + 3 ] = static_cast<double>( src[ j + 3 ] );
-        dst[ j + 4 ] = static_cast<double>( src[ j + 4 ] );
-        dst[ j + 5 ] = static_cast<double>( src[ j + 5 ] );
-        dst[ j + 6 ] = static_cast<double>( src[ j + 6 ] );
-        dst[ j + 7 ] = static_cast<double>( src[ j + 7 ] );
-      }
-      for ( ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<double>( src[ j ] );
-      } 
-      return true;
-    }
-    default:
-    {
-      dst_data_block.reset();
-      return false;
-    }
-  }
-}
-
-
 bool DataBlock::ConvertDataType( const DataBlockHandle& src_data_block, 
   DataBlockHandle& dst_data_block, DataType new_data_type )
 {
@@ -680,36 +342,15 @@ bool DataBlock::ConvertDataType( const DataBlockHandle& src_data_block,
     return false;
   }
   
-  switch( src_data_block->get_data_type() )
+  if ( !DataBlockKernels::Convert( src_data_block->get_data(), 
+    src_data_block->get_data_type(), dst_data_block->get_data(), new_data_type,
+    src_data_block->get_size() ) )
   {
-    case DataType::CHAR_E:
-      return ConvertDataTypeInternal<signed char>( 
-        reinterpret_cast<signed char*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::UCHAR_E:
-      return ConvertDataTypeInternal<unsigned char>( 
-        reinterpret_cast<unsigned char*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::SHORT_E:
-      return ConvertDataTypeInternal<short>( 
-        reinterpret_cast<short*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::USHORT_E:
-      return ConvertDataTypeInternal<unsigned short>( 
-        reinterpret_cast<unsigned short*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::INT_E:
-      return ConvertDataTypeInternal<int>( 
-        reinterpret_cast<int*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::UINT_E:
-      return ConvertDataTypeInternal<unsigned int>( 
-        reinterpret_cast<unsigned int*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::FLOAT_E:
-      return ConvertDataTypeInternal<float>( 
-        reinterpret_cast<float*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::DOUBLE_E:
-      return ConvertDataTypeInternal<double>( 
-        reinterpret_cast<double*>( src_data_block->get_data() ), dst_data_block );
-    default:
-      dst_data_block.reset();
-      return false;
+    dst_data_block.reset();
+    return false;
   }
+  
+  return true;
 }
 
 template<class DATA>
@@ -855,118 +496,6 @@ bool DataBlock::PermuteData( const DataBlockHandle& src_data_block,
 }
 
 
-template<class DATA>
-static bool QuantizeDataInternal( double min, double max, DATA* src, DataBlockHandle& dst_data_block )
-{
-  float fmin = static_cast<float>( min );
-  float fmax = static_cast<float>( max );
-  
-  size_t size = dst_data_block->get_size();
-  switch ( dst_data_block->get_data_type() )
-  {
-    case DataType::CHAR_E:  
-    {
-      signed char* dst = reinterpret_cast<signed char*>( dst_data_block->get_data() );
-
-      float offset = 0.5f - static_cast<float>( 0x80 );
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x100 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<signed char>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      
-      return true;
-    }
-    case DataType::UCHAR_E: 
-    {
-      unsigned char* dst = reinterpret_cast<unsigned char*>( dst_data_block->get_data() );
-      
-      float offset = 0.5f;
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x100 ) / (fmax - fmin);
-             
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned char>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      return true;
-    }
-    case DataType::SHORT_E: 
-    {
-      short* dst = reinterpret_cast<short*>( dst_data_block->get_data() );
-
-      float offset = 0.5f - static_cast<float>( 0x8000 );
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x10000 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<short>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset );
-      }
-      
-      return true;
-    }
-    case DataType::USHORT_E:  
-    {
-      unsigned short* dst = reinterpret_cast<unsigned short*>( dst_data_block->get_data() );
-
-      float offset = 0.5f;
-      float multiplier = 0.0f;
-      if ( fmax > fmin ) multiplier = static_cast<float>( 0x10000 ) / (fmax - fmin);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned short>( multiplier * 
-          (static_cast<float>( src[ j ] ) - fmin)  + offset);
-      }
-      
-      return true;
-    }
-    case DataType::INT_E: 
-    {
-      int* dst = reinterpret_cast<int*>( dst_data_block->get_data() );
-
-      double offset = 0.5 -  static_cast<double>( 0x80000000 );
-      double multiplier = 0.0;
-      if ( max > min ) multiplier = static_cast<double>( 0x100000000ull ) / (max - min);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<int>( multiplier * 
-          (static_cast<double>( src[ j ] ) - min)  + offset);
-      }
-      
-      return true;
-    }
-    case DataType::UINT_E:  
-    {
-      unsigned int* dst = reinterpret_cast<unsigned int*>( dst_data_block->get_data() );
-
-      double offset = 0.5;
-      double multiplier = 0.0;
-      if ( max > min ) multiplier = static_cast<double>( 0x100000000ull ) / (max - min);
-      
-      for ( size_t j = 0 ; j < size; j++ )
-      {
-        dst[ j ] = static_cast<unsigned int>( multiplier * 
-          (static_cast<double>( src[ j ] ) - min)  + offset);
-      }
-      
-      return true;
-    }
-    default:
-    {
-      dst_data_block.reset();
-      return false;
-    }
-  }
-}
-
 bool DataBlock::QuantizeData( const DataBlockHandle& src_data_block, 
   DataBlockHandle& dst_data_block, DataType new_data_type )
 {
@@ -993,35 +522,15 @@ bool DataBlock::QuantizeData( const DataBlockHandle& src_data_block,
   double min = src_data_block->get_min();
   double max = src_data_block->get_max();
   
-  switch( src_data_block->get_data_type() )
+  if ( !DataBlockKernels::Quantize( src_data_block->get_data(), 
+    src_data_block->get_data_type(), dst_data_block->get_data(), new_data_type,
+    src_data_block->get_size(), min, max ) )
   {
-    case DataType::CHAR_E:
-      return QuantizeDataInternal<signed char>( min, max, 
-        reinterpret_cast<signed char*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::UCHAR_E:
-      return QuantizeDataInternal<unsigned char>( min, max, 
-        reinterpret_cast<unsigned char*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::SHORT_E:
-      return QuantizeDataInternal<short>( min, max,
-        reinterpret_cast<short*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::USHORT_E:
-      return QuantizeDataInternal<unsigned short>( min, max,
-        reinterpret_cast<unsigned short*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::INT_E:
-      return QuantizeDataInternal<int>( min, max,
-        reinterpret_cast<int*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::UINT_E:
-      return QuantizeDataInternal<unsigned int>( min, max,
-        reinterpret_cast<unsigned int*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::FLOAT_E:
-      return QuantizeDataInternal<float>( min, max,
-        reinterpret_cast<float*>( src_data_block->get_data() ), dst_data_block );
-    case DataType::DOUBLE_E:
-      return QuantizeDataInternal<double>( min, max,
-        reinterpret_cast<double*>( src_data_block->get_data() ), dst_data_block );
-    default:
-      return false;
+    dst_data_block.reset();
+    return false;
   }
+  
+  return true;
 }
 
 bool DataBlock::Duplicate( const DataBlockHandle& src_data_block, 
@@ -1247,6 +756,24 @@ bool DataBlock::extract_slice( SliceType type, index_type index, DataSliceHandle
 }
 
 
+// Update the histogram of the volume for the values of a slice that were replaced, or compute
+// it again if the range of the data changed. Histograms that were never computed are left
+// alone.
+template<class T>
+static void UpdateSliceHistogram( DataBlock* volume_data_block, const std::vector<T>& old_values, 
+  const T* slice_ptr )
+{
+  Histogram histogram = volume_data_block->get_histogram();
+  if ( !histogram.is_valid() || old_values.empty() ) return;
+
+  if ( !histogram.update( &old_values[ 0 ], slice_ptr, old_values.size() ) )
+  {
+    histogram.compute( reinterpret_cast<const T*>( volume_data_block->get_data() ), 
+      volume_data_block->get_size() );
+  }
+  volume_data_block->set_histogram( histogram );
+}
+
 template<class T>
 bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& slice )
 {
@@ -1278,6 +805,10 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
+      // Keep the values that are overwritten to update the histogram
+      std::vector<T> old_values( ny * nz );
+      T* old_ptr = &old_values[ 0 ];
+
       size_t nxy = nx * ny;
       // For loop unroll
       size_t ny8 = RemoveRemainder8( ny );
@@ -1291,22 +822,24 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
           // Copy data back
           size_t a = y + z * ny; 
           size_t b = index + y * nx + z * nxy;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b+= nx;
         }
         // Finish part that could not be unrolled
         for ( ; y < ny; y++ )
         {
+          old_ptr[ y + z * ny ] = volume_ptr[ index + y * nx + z * nxy ];
           volume_ptr[ index + y * nx + z * nxy ] = slice_ptr[ y + z * ny ];
         }
       }
       
+      UpdateSliceHistogram( volume_data_block, old_values, slice_ptr );
       volume_data_block->increase_generation();
 
       return true;
@@ -1320,6 +853,10 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
+      // Keep the values that are overwritten to update the histogram
+      std::vector<T> old_values( nx * nz );
+      T* old_ptr = &old_values[ 0 ];
+
       size_t nxy = nx * ny;
       // For loop unroll
       size_t nx8 = RemoveRemainder8( nx );
@@ -1333,22 +870,24 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
           // Copy data back
           size_t a = x + z * nx; 
           size_t b = x + index * nx + z * nxy;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
-          volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
+          old_ptr[ a ] = volume_ptr[ b ]; volume_ptr[ b ] = slice_ptr[ a ]; a++; b++;
         }
         // Finish part that could not be unrolled
         for ( ; x < nx; x++ )
         {
+          old_ptr[ x + z * nx ] = volume_ptr[ x + index * nx + z * nxy ];
           volume_ptr[ x + index * nx + z * nxy ] = slice_ptr[ x + z * nx ];
         }
       }
 
+      UpdateSliceHistogram( volume_data_block, old_values, slice_ptr );
       volume_data_block->increase_generation();
       
       return true;
@@ -1362,9 +901,14 @@ bool InsertSliceInternal( DataBlock* volume_data_block, const DataSliceHandle& s
       T* volume_ptr = reinterpret_cast<T*>( volume_data_block->get_data() );
       T* slice_ptr = reinterpret_cast<T*>( slice_data_block->get_data() );
       
+      // Keep the values that are overwritten to update the histogram
+      std::vector<T> old_values( volume_ptr + index * ( nx * ny ), 
+        volume_ptr + ( index + 1 ) * ( nx * ny ) );
+
       // Copy data as one memory block back
       std::memcpy( volume_ptr + index * ( nx * ny ), slice_ptr, nx * ny * sizeof( T ) );
       
+      UpdateSliceHistogram( volume_data_block, old_values, slice_ptr );
       volume_data_block->increase_generation();
       
       return true;
@@ -152,6 +152,47 @@ public:
     return this->data_;
   }
 
+  // GET_TYPED_DATA:
+  /// Pointer to the block of data as an array of T. Returns 0 if T does not match the type
+  /// of the data.
+  template< class T >
+  T* get_typed_data()
+  {
+    if ( GetDataType( static_cast< T* >( 0 ) ) != this->data_type_ ) return 0;
+    return static_cast< T* >( this->data_ );
+  }
+
+  // VISIT:
+  /// Call functor( T* data, size_t size ) with the data as an array of its actual type, so
+  /// loops over the data can be written once as a template instead of once per type or by
+  /// going through get_data_at. Returns false if the data type is not supported.
+  template< class FUNCTOR >
+  bool visit( FUNCTOR& functor )
+  {
+    size_t size = this->get_size();
+    switch ( this->data_type_ )
+    {
+    case DataType::CHAR_E:
+      functor( static_cast< signed char* >( this->data_ ), size ); return true;
+    case DataType::UCHAR_E:
+      functor( static_cast< unsigned char* >( this->data_ ), size ); return true;
+    case DataType::SHORT_E:
+      functor( static_cast< short* >( this->data_ ), size ); return true;
+    case DataType::USHORT_E:
+      functor( static_cast< unsigned short* >( this->data_ ), size ); return true;
+    case DataType::INT_E:
+      functor( static_cast< int* >( this->data_ ), size ); return true;
+    case DataType::UINT_E:
+      functor( static_cast< unsigned int* >( this->data_ ), size ); return true;
+    case DataType::FLOAT_E:
+      functor( static_cast< float* >( this->data_ ), size ); return true;
+    case DataType::DOUBLE_E:
+      functor( static_cast< double* >( this->data_ ), size ); return true;
+    default:
+      return false;
+    }
+  }
+
   // GET_DATA_AT:
   /// Get data at a certain location in the data block
   inline double get_data_at( index_type x, index_type y, index_type z ) const
@@ -0,0 +1,333 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <cstring>
+#include <vector>
+
+// Core includes
+#include <Core/DataBlock/DataBlockDelta.h>
+#include <Core/Math/MathFunctions.h>
+
+namespace Core
+{
+
+class DataBlockDeltaPrivate
+{
+public:
+  DataBlockDeltaPrivate() :
+    nx_( 0 ), ny_( 0 ), nz_( 0 ), data_type_( DataType::UNKNOWN_E ), mask_( false ),
+    checksum_( 0 )
+  {
+  }
+
+  // Dimensions and type of the data the delta was created from
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+  DataType data_type_;
+  bool mask_;
+
+  // Pairs of start and length of the runs of changed bytes, or voxels for a mask
+  std::vector< size_t > runs_;
+
+  // The bytes of the old version in the runs, masks only need to flip the voxels in the runs
+  std::vector< unsigned char > old_values_;
+
+  // Checksum of the new version
+  unsigned long long checksum_;
+
+  // CHECK_DIMENSIONS:
+  // Check whether data has the dimensions the delta was created from
+  template< class DATA >
+  bool check_dimensions( const DATA& data ) const
+  {
+    return data->get_nx() == this->nx_ && data->get_ny() == this->ny_ && 
+      data->get_nz() == this->nz_;
+  }
+};
+
+// Gaps of unchanged bytes that are shorter than the record of a new run are stored as part of
+// the surrounding run
+static const size_t MIN_GAP_C = 2 * sizeof( size_t );
+
+static const unsigned long long CHECKSUM_START_C = 14695981039346656037ULL;
+static const unsigned long long CHECKSUM_PRIME_C = 1099511628211ULL;
+
+static unsigned long long ComputeChecksum( const unsigned char* data, size_t size )
+{
+  unsigned long long checksum = CHECKSUM_START_C;
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    unsigned long long word;
+    std::memcpy( &word, data + j, 8 );
+    checksum = ( checksum ^ word ) * CHECKSUM_PRIME_C;
+  }
+  for ( ; j < size; j++ )
+  {
+    checksum = ( checksum ^ data[ j ] ) * CHECKSUM_PRIME_C;
+  }
+  return checksum;
+}
+
+static unsigned long long ComputeMaskChecksum( const unsigned char* data, 
+  unsigned char mask_value, size_t size )
+{
+  unsigned long long checksum = CHECKSUM_START_C;
+  size_t j = 0;
+  while ( j < size )
+  {
+    // Gather the bits of 64 voxels into one word
+    unsigned long long word = 0;
+    size_t end = Min( j + 64, size );
+    for ( ; j < end; j++ )
+    {
+      word = ( word << 1 ) | ( ( data[ j ] & mask_value ) ? 1 : 0 );
+    }
+    checksum = ( checksum ^ word ) * CHECKSUM_PRIME_C;
+  }
+  return checksum;
+}
+
+// FINDDIFFERENCE:
+// Find the first byte in [ begin, end ) that differs, returns end if there is none
+static size_t FindDifference( const unsigned char* a, const unsigned char* b, 
+  size_t begin, size_t end )
+{
+  size_t j = begin;
+  for ( ; j + 8 <= end; j += 8 )
+  {
+    unsigned long long word_a, word_b;
+    std::memcpy( &word_a, a + j, 8 );
+    std::memcpy( &word_b, b + j, 8 );
+    if ( word_a != word_b ) break;
+  }
+  for ( ; j < end; j++ )
+  {
+    if ( a[ j ] != b[ j ] ) return j;
+  }
+  return end;
+}
+
+DataBlockDelta::DataBlockDelta() :
+  private_( new DataBlockDeltaPrivate )
+{
+}
+
+DataBlockDelta::~DataBlockDelta()
+{
+}
+
+bool DataBlockDelta::apply( const DataBlockHandle& data ) const
+{
+  if ( this->private_->mask_ || !this->private_->check_dimensions( data ) ||
+    data->get_data_type() != this->private_->data_type_ )
+  {
+    return false;
+  }
+
+  DataBlock::lock_type lock( data->get_mutex() );
+  unsigned char* data_ptr = reinterpret_cast< unsigned char* >( data->get_data() );
+  if ( ComputeChecksum( data_ptr, data->get_byte_size() ) != this->private_->checksum_ )
+  {
+    return false;
+  }
+
+  const std::vector< size_t >& runs = this->private_->runs_;
+  const unsigned char* old_values = this->private_->old_values_.empty() ? 0 :
+    &this->private_->old_values_[ 0 ];
+  for ( size_t j = 0; j < runs.size(); j += 2 )
+  {
+    std::memcpy( data_ptr + runs[ j ], old_values, runs[ j + 1 ] );
+    old_values += runs[ j + 1 ];
+  }
+
+  return true;
+}
+
+bool DataBlockDelta::apply( const MaskDataBlockHandle& mask ) const
+{
+  if ( !this->private_->mask_ || !this->private_->check_dimensions( mask ) ) return false;
+
+  MaskDataBlock::lock_type lock( mask->get_mutex() );
+  unsigned char* mask_ptr = mask->get_mask_data();
+  unsigned char mask_value = mask->get_mask_value();
+  if ( ComputeMaskChecksum( mask_ptr, mask_value, mask->get_size() ) != 
+    this->private_->checksum_ )
+  {
+    return false;
+  }
+
+  const std::vector< size_t >& runs = this->private_->runs_;
+  for ( size_t j = 0; j < runs.size(); j += 2 )
+  {
+    size_t end = runs[ j ] + runs[ j + 1 ];
+    for ( size_t k = runs[ j ]; k < end; k++ )
+    {
+      mask_ptr[ k ] ^= mask_value;
+    }
+  }
+
+  return true;
+}
+
+bool DataBlockDelta::empty() const
+{
+  return this->private_->runs_.empty();
+}
+
+size_t DataBlockDelta::get_byte_size() const
+{
+  return sizeof( DataBlockDeltaPrivate ) + 
+    this->private_->runs_.capacity() * sizeof( size_t ) +
+    this->private_->old_values_.capacity();
+}
+
+bool DataBlockDelta::Create( const DataBlockHandle& old_data, const DataBlockHandle& new_data,
+  DataBlockDeltaHandle& delta )
+{
+  delta.reset();
+  if ( old_data->get_nx() != new_data->get_nx() || old_data->get_ny() != new_data->get_ny() ||
+    old_data->get_nz() != new_data->get_nz() || 
+    old_data->get_data_type() != new_data->get_data_type() )
+  {
+    return false;
+  }
+
+  delta = DataBlockDeltaHandle( new DataBlockDelta );
+  DataBlockDeltaPrivateHandle delta_private = delta->private_;
+  delta_private->nx_ = new_data->get_nx();
+  delta_private->ny_ = new_data->get_ny();
+  delta_private->nz_ = new_data->get_nz();
+  delta_private->data_type_ = new_data->get_data_type();
+
+  DataBlock::shared_lock_type old_lock( old_data->get_mutex() );
+  DataBlock::shared_lock_type new_lock;
+  if ( old_data != new_data )
+  {
+    DataBlock::shared_lock_type lock( new_data->get_mutex() );
+    new_lock.swap( lock );
+  }
+
+  const unsigned char* old_ptr = reinterpret_cast< const unsigned char* >( 
+    old_data->get_data() );
+  const unsigned char* new_ptr = reinterpret_cast< const unsigned char* >(
+    new_data->get_data() );
+  size_t size = new_data->get_byte_size();
+
+  delta_private->checksum_ = ComputeChecksum( new_ptr, size );
+
+  size_t start = FindDifference( old_ptr, new_ptr, 0, size );
+  while ( start < size )
+  {
+    // Extend the run until a long enough gap of unchanged bytes is found
+    size_t end = start + 1;
+    while ( end < size )
+    {
+      size_t gap_end = Min( end + MIN_GAP_C, size );
+      size_t next = FindDifference( old_ptr, new_ptr, end, gap_end );
+      if ( next == gap_end ) break;
+      end = next + 1;
+    }
+
+    delta_private->runs_.push_back( start );
+    delta_private->runs_.push_back( end - start );
+    delta_private->old_values_.insert( delta_private->old_values_.end(), old_ptr + start, old_ptr + end );
+
+    start = FindDifference( old_ptr, new_ptr, end, size );
+  }
+
+  // Release the memory that was reserved while growing the runs
+  std::vector< size_t >( delta_private->runs_ ).swap( delta_private->runs_ );
+  std::vector< unsigned char >( delta_private->old_values_ ).swap( delta_private->old_values_ );
+
+  return true;
+}
+
+bool DataBlockDelta::Create( const MaskDataBlockHandle& old_mask, 
+  const MaskDataBlockHandle& new_mask, DataBlockDeltaHandle& delta )
+{
+  delta.reset();
+  if ( old_mask->get_nx() != new_mask->get_nx() || old_mask->get_ny() != new_mask->get_ny() ||
+    old_mask->get_nz() != new_mask->get_nz() )
+  {
+    return false;
+  }
+
+  delta = DataBlockDeltaHandle( new DataBlockDelta );
+  DataBlockDeltaPrivateHandle delta_private = delta->private_;
+  delta_private->nx_ = new_mask->get_nx();
+  delta_private->ny_ = new_mask->get_ny();
+  delta_private->nz_ = new_mask->get_nz();
+  delta_private->data_type_ = DataType::UCHAR_E;
+  delta_private->mask_ = true;
+
+  // NOTE: Masks often share their datablock, in which case it should only be locked once
+  MaskDataBlock::shared_lock_type old_lock( old_mask->get_mutex() );
+  MaskDataBlock::shared_lock_type new_lock;
+  if ( &old_mask->get_mutex() != &new_mask->get_mutex() )
+  {
+    MaskDataBlock::shared_lock_type lock( new_mask->get_mutex() );
+    new_lock.swap( lock );
+  }
+
+  const unsigned char* old_ptr = old_mask->get_mask_data();
+  const unsigned char* new_ptr = new_mask->get_mask_data();
+  unsigned char old_value = old_mask->get_mask_value();
+  unsigned char new_value = new_mask->get_mask_value();
+  size_t size = new_mask->get_size();
+
+  delta_private->checksum_ = ComputeMaskChecksum( new_ptr, new_value, size );
+
+  size_t j = 0;
+  while ( j < size )
+  {
+    if ( ( ( old_ptr[ j ] & old_value ) != 0 ) == ( ( new_ptr[ j ] & new_value ) != 0 ) )
+    {
+      j++;
+      continue;
+    }
+
+    size_t start = j++;
+    while ( j < size && 
+      ( ( old_ptr[ j ] & old_value ) != 0 ) != ( ( new_ptr[ j ] & new_value ) != 0 ) )
+    {
+      j++;
+    }
+
+    delta_private->runs_.push_back( start );
+    delta_private->runs_.push_back( j - start );
+  }
+
+  std::vector< size_t >( delta_private->runs_ ).swap( delta_private->runs_ );
+
+  return true;
+}
+
+} // end namespace Core
@@ -0,0 +1,109 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_DATABLOCKDELTA_H
+#define CORE_DATABLOCK_DATABLOCKDELTA_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+
+namespace Core
+{
+
+// CLASS DataBlockDelta
+/// The differences between an old and a new version of a DataBlock or a MaskDataBlock, stored
+/// as runs of changed values. Applying the delta to the new version restores the old version.
+/// An operation that only changes part of the data can hence be undone without keeping a copy
+/// of all the data.
+
+class DataBlockDelta;
+class DataBlockDeltaPrivate;
+typedef boost::shared_ptr< DataBlockDelta > DataBlockDeltaHandle;
+typedef boost::shared_ptr< DataBlockDeltaPrivate > DataBlockDeltaPrivateHandle;
+
+class DataBlockDelta : public boost::noncopyable
+{
+  // -- Constructor/destructor --
+private:
+  DataBlockDelta();
+
+public:
+  virtual ~DataBlockDelta();
+
+  // -- Restoring the old version --
+public:
+  // APPLY:
+  /// Restore the old version of the data. The data needs to be identical to the new version
+  /// the delta was created with, otherwise false is returned and the data is not altered.
+  bool apply( const DataBlockHandle& data ) const;
+
+  // APPLY:
+  /// Restore the old version of a mask.
+  bool apply( const MaskDataBlockHandle& mask ) const;
+
+  // -- Size information --
+public:
+  // EMPTY:
+  /// Whether the two versions are identical
+  bool empty() const;
+
+  // GET_BYTE_SIZE:
+  /// The memory used to store the delta
+  size_t get_byte_size() const;
+
+  // -- Internals --
+private:
+  DataBlockDeltaPrivateHandle private_;
+
+  // -- Creation --
+public:
+  // CREATE:
+  /// Compute the delta between two versions of a DataBlock. Returns false if the dimensions
+  /// or data types of the two versions differ.
+  static bool Create( const DataBlockHandle& old_data, const DataBlockHandle& new_data,
+    DataBlockDeltaHandle& delta );
+
+  // CREATE:
+  /// Compute the delta between two versions of a mask. Returns false if the dimensions of
+  /// the two versions differ.
+  static bool Create( const MaskDataBlockHandle& old_mask, const MaskDataBlockHandle& new_mask,
+    DataBlockDeltaHandle& delta );
+};
+
+} // end namespace Core
+
+#endif
@@ -0,0 +1,1576 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/DataBlock/DataBlockKernels.h>
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) || ( defined( __i386__ ) && defined( __SSE2__ ) )
+#define CORE_DATABLOCK_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#define CORE_TARGET_AVX2
+#else
+#define CORE_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+namespace Core
+{
+
+// Arrays with fewer elements are processed on the calling thread
+static const size_t PARALLEL_SIZE_C = 1 << 20;
+// Number of elements processed by one task of the thread pool
+static const size_t PARALLEL_GRAIN_C = 1 << 18;
+// Number of elements that are quantized at once through a buffer of floats
+static const size_t QUANTIZE_BLOCK_C = 1024;
+
+//////////////////////////////////////////////////////////////////////////
+// Instruction set selection
+//////////////////////////////////////////////////////////////////////////
+
+static int DetectInstructionSet()
+{
+#ifdef CORE_DATABLOCK_SSE2
+#if defined( _MSC_VER )
+  int info[ 4 ];
+  __cpuid( info, 0 );
+  if ( info[ 0 ] >= 7 )
+  {
+    __cpuid( info, 1 );
+    // The OS needs to save the AVX registers
+    bool os_avx = ( info[ 2 ] & ( 1 << 27 ) ) && ( info[ 2 ] & ( 1 << 28 ) ) &&
+      ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+    __cpuidex( info, 7, 0 );
+    if ( os_avx && ( info[ 1 ] & ( 1 << 5 ) ) ) return InstructionSetType::AVX2_E;
+  }
+#else
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) return InstructionSetType::AVX2_E;
+#endif
+  return InstructionSetType::SSE2_E;
+#else
+  return InstructionSetType::SCALAR_E;
+#endif
+}
+
+static int SupportedInstructionSet()
+{
+  static const int supported = DetectInstructionSet();
+  return supported;
+}
+
+static int& ActiveInstructionSet()
+{
+  static int active = SupportedInstructionSet();
+  return active;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+//////////////////////////////////////////////////////////////////////////
+
+template< class SRC, class DST >
+static void ConvertScalar( const SRC* src, DST* dst, size_t size )
+{
+  for ( size_t j = 0; j < size; j++ ) dst[ j ] = static_cast< DST >( src[ j ] );
+}
+
+template< class T >
+static void ConvertScalar( const T* src, T* dst, size_t size )
+{
+  std::memcpy( dst, src, size * sizeof( T ) );
+}
+
+// Linear map of the quantization, both as scalar and as vector operation
+class QuantizeMap
+{
+public:
+  QuantizeMap( float scale, float min, float offset ) :
+    scale_( scale ), min_( min ), offset_( offset ) {}
+
+  float operator()( float value ) const
+  {
+    return this->scale_ * ( value - this->min_ ) + this->offset_;
+  }
+
+  float scale_;
+  float min_;
+  float offset_;
+};
+
+// Identity map, used for plain conversions from float
+class IdentityMap
+{
+public:
+  float operator()( float value ) const { return value; }
+};
+
+template< class DST, class MAP >
+static void FloatToIntegerScalar( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  for ( size_t j = 0; j < size; j++ ) dst[ j ] = static_cast< DST >( map( src[ j ] ) );
+}
+
+template< class T >
+static inline bool IsValue( T ) { return true; }
+static inline bool IsValue( float value ) { return value - value == 0.0f; }
+static inline bool IsValue( double value ) { return value - value == 0.0; }
+
+// Running minimum and maximum of one range of the data
+template< class T >
+class MinMax
+{
+public:
+  MinMax() : found_( false ), min_( 0 ), max_( 0 ) {}
+
+  void add( T value )
+  {
+    if ( !IsValue( value ) ) return;
+    if ( !this->found_ )
+    {
+      this->min_ = value; this->max_ = value; this->found_ = true;
+    }
+    else if ( value < this->min_ ) this->min_ = value;
+    else if ( value > this->max_ ) this->max_ = value;
+  }
+
+  void add( const T* data, size_t size )
+  {
+    for ( size_t j = 0; j < size; j++ ) this->add( data[ j ] );
+  }
+
+  bool found_;
+  T min_;
+  T max_;
+};
+
+static inline unsigned short SwapBytes( unsigned short value )
+{
+  return static_cast< unsigned short >( ( value << 8 ) | ( value >> 8 ) );
+}
+
+static inline unsigned int SwapBytes( unsigned int value )
+{
+  return ( value << 24 ) | ( ( value << 8 ) & 0x00FF0000u ) | 
+    ( ( value >> 8 ) & 0x0000FF00u ) | ( value >> 24 );
+}
+
+static inline unsigned long long SwapBytes( unsigned long long value )
+{
+  return ( static_cast< unsigned long long >( SwapBytes( static_cast< unsigned int >( value ) ) ) << 32 ) |
+    SwapBytes( static_cast< unsigned int >( value >> 32 ) );
+}
+
+template< class T >
+static void SwapEndianScalar( unsigned char* data, size_t size )
+{
+  for ( size_t j = 0; j < size; j++, data += sizeof( T ) )
+  {
+    T value;
+    std::memcpy( &value, data, sizeof( T ) );
+    value = SwapBytes( value );
+    std::memcpy( data, &value, sizeof( T ) );
+  }
+}
+
+static void SwapEndianGeneric( unsigned char* data, size_t size, size_t elem_size )
+{
+  for ( size_t j = 0; j < size; j++, data += elem_size )
+  {
+    for ( size_t k = 0; k < elem_size / 2; k++ ) std::swap( data[ k ], data[ elem_size - 1 - k ] );
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SSE2 and AVX2 kernels
+//////////////////////////////////////////////////////////////////////////
+
+// Conversions without a vector version use the scalar loop
+template< class SRC, class DST >
+static void ConvertSSE2( const SRC* src, DST* dst, size_t size )
+{
+  ConvertScalar( src, dst, size );
+}
+
+template< class SRC, class DST >
+static void ConvertAVX2( const SRC* src, DST* dst, size_t size )
+{
+  ConvertScalar( src, dst, size );
+}
+
+template< class DST, class MAP >
+static void FloatToIntegerSSE2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  FloatToIntegerScalar( src, dst, size, map );
+}
+
+template< class DST, class MAP >
+static void FloatToIntegerAVX2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  FloatToIntegerScalar( src, dst, size, map );
+}
+
+template< class T >
+static void MinMaxSSE2( const T* data, size_t size, MinMax< T >& result )
+{
+  result.add( data, size );
+}
+
+template< class T >
+static void MinMaxAVX2( const T* data, size_t size, MinMax< T >& result )
+{
+  result.add( data, size );
+}
+
+#ifdef CORE_DATABLOCK_SSE2
+
+// Loads and stores of unaligned vectors
+static inline __m128i Load128( const void* ptr )
+{
+  return _mm_loadu_si128( reinterpret_cast< const __m128i* >( ptr ) );
+}
+
+static inline void Store128( void* ptr, __m128i value )
+{
+  _mm_storeu_si128( reinterpret_cast< __m128i* >( ptr ), value );
+}
+
+CORE_TARGET_AVX2 static inline __m256i Load256( const void* ptr )
+{
+  return _mm256_loadu_si256( reinterpret_cast< const __m256i* >( ptr ) );
+}
+
+CORE_TARGET_AVX2 static inline void Store256( void* ptr, __m256i value )
+{
+  _mm256_storeu_si256( reinterpret_cast< __m256i* >( ptr ), value );
+}
+
+//// SSE2 conversions to float ////
+
+static inline void StoreIntegersAsFloats( float* dst, __m128i value )
+{
+  _mm_storeu_ps( dst, _mm_cvtepi32_ps( value ) );
+}
+
+static void ConvertSSE2( const signed char* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m128i value = Load128( src + j );
+    __m128i lo = _mm_srai_epi16( _mm_unpacklo_epi8( value, value ), 8 );
+    __m128i hi = _mm_srai_epi16( _mm_unpackhi_epi8( value, value ), 8 );
+    StoreIntegersAsFloats( dst + j, _mm_srai_epi32( _mm_unpacklo_epi16( lo, lo ), 16 ) );
+    StoreIntegersAsFloats( dst + j + 4, _mm_srai_epi32( _mm_unpackhi_epi16( lo, lo ), 16 ) );
+    StoreIntegersAsFloats( dst + j + 8, _mm_srai_epi32( _mm_unpacklo_epi16( hi, hi ), 16 ) );
+    StoreIntegersAsFloats( dst + j + 12, _mm_srai_epi32( _mm_unpackhi_epi16( hi, hi ), 16 ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const unsigned char* src, float* dst, size_t size )
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m128i value = Load128( src + j );
+    __m128i lo = _mm_unpacklo_epi8( value, zero );
+    __m128i hi = _mm_unpackhi_epi8( value, zero );
+    StoreIntegersAsFloats( dst + j, _mm_unpacklo_epi16( lo, zero ) );
+    StoreIntegersAsFloats( dst + j + 4, _mm_unpackhi_epi16( lo, zero ) );
+    StoreIntegersAsFloats( dst + j + 8, _mm_unpacklo_epi16( hi, zero ) );
+    StoreIntegersAsFloats( dst + j + 12, _mm_unpackhi_epi16( hi, zero ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const short* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    __m128i value = Load128( src + j );
+    StoreIntegersAsFloats( dst + j, _mm_srai_epi32( _mm_unpacklo_epi16( value, value ), 16 ) );
+    StoreIntegersAsFloats( dst + j + 4, _mm_srai_epi32( _mm_unpackhi_epi16( value, value ), 16 ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const unsigned short* src, float* dst, size_t size )
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    __m128i value = Load128( src + j );
+    StoreIntegersAsFloats( dst + j, _mm_unpacklo_epi16( value, zero ) );
+    StoreIntegersAsFloats( dst + j + 4, _mm_unpackhi_epi16( value, zero ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const int* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 ) StoreIntegersAsFloats( dst + j, Load128( src + j ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const unsigned int* src, float* dst, size_t size )
+{
+  // The two 16 bit halves convert exactly, so the sum is rounded only once
+  const __m128i mask = _mm_set1_epi32( 0xFFFF );
+  const __m128 scale = _mm_set1_ps( 65536.0f );
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m128i value = Load128( src + j );
+    __m128 hi = _mm_cvtepi32_ps( _mm_srli_epi32( value, 16 ) );
+    __m128 lo = _mm_cvtepi32_ps( _mm_and_si128( value, mask ) );
+    _mm_storeu_ps( dst + j, _mm_add_ps( _mm_mul_ps( hi, scale ), lo ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const double* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m128 lo = _mm_cvtpd_ps( _mm_loadu_pd( src + j ) );
+    __m128 hi = _mm_cvtpd_ps( _mm_loadu_pd( src + j + 2 ) );
+    _mm_storeu_ps( dst + j, _mm_movelh_ps( lo, hi ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+static void ConvertSSE2( const float* src, double* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m128 value = _mm_loadu_ps( src + j );
+    _mm_storeu_pd( dst + j, _mm_cvtps_pd( value ) );
+    _mm_storeu_pd( dst + j + 2, _mm_cvtps_pd( _mm_movehl_ps( value, value ) ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+//// SSE2 conversions from float ////
+
+class IdentityMapSSE2
+{
+public:
+  explicit IdentityMapSSE2( const IdentityMap& ) {}
+  __m128 operator()( __m128 value ) const { return value; }
+};
+
+class QuantizeMapSSE2
+{
+public:
+  explicit QuantizeMapSSE2( const QuantizeMap& map ) :
+    scale_( _mm_set1_ps( map.scale_ ) ), 
+    min_( _mm_set1_ps( map.min_ ) ), 
+    offset_( _mm_set1_ps( map.offset_ ) ) {}
+
+  __m128 operator()( __m128 value ) const
+  {
+    return _mm_add_ps( _mm_mul_ps( this->scale_, _mm_sub_ps( value, this->min_ ) ), this->offset_ );
+  }
+
+  __m128 scale_;
+  __m128 min_;
+  __m128 offset_;
+};
+
+template< class MAP >
+class VectorMapSSE2;
+
+template<> class VectorMapSSE2< IdentityMap > { public: typedef IdentityMapSSE2 type; };
+template<> class VectorMapSSE2< QuantizeMap > { public: typedef QuantizeMapSSE2 type; };
+
+// Truncate to integers and keep the low 16 bits of each, as a scalar conversion does on x86
+template< class MAP >
+static inline __m128i TruncateToInt16SSE2( const float* src, const MAP& map )
+{
+  __m128i value = _mm_cvttps_epi32( map( _mm_loadu_ps( src ) ) );
+  return _mm_srai_epi32( _mm_slli_epi32( value, 16 ), 16 );
+}
+
+template< class DST, class MAP >
+static void FloatToInt8SSE2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  typename VectorMapSSE2< MAP >::type vector_map( map );
+  const __m128i mask = _mm_set1_epi32( 0xFF );
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m128i v0 = _mm_and_si128( _mm_cvttps_epi32( vector_map( _mm_loadu_ps( src + j ) ) ), mask );
+    __m128i v1 = _mm_and_si128( _mm_cvttps_epi32( vector_map( _mm_loadu_ps( src + j + 4 ) ) ), mask );
+    __m128i v2 = _mm_and_si128( _mm_cvttps_epi32( vector_map( _mm_loadu_ps( src + j + 8 ) ) ), mask );
+    __m128i v3 = _mm_and_si128( _mm_cvttps_epi32( vector_map( _mm_loadu_ps( src + j + 12 ) ) ), mask );
+    Store128( dst + j, _mm_packus_epi16( _mm_packs_epi32( v0, v1 ), _mm_packs_epi32( v2, v3 ) ) );
+  }
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+template< class DST, class MAP >
+static void FloatToInt16SSE2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  typename VectorMapSSE2< MAP >::type vector_map( map );
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    Store128( dst + j, _mm_packs_epi32( TruncateToInt16SSE2( src + j, vector_map ), 
+      TruncateToInt16SSE2( src + j + 4, vector_map ) ) );
+  }
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+template< class MAP >
+static void FloatToIntegerSSE2( const float* src, signed char* dst, size_t size, const MAP& map )
+{
+  FloatToInt8SSE2( src, dst, size, map );
+}
+
+template< class MAP >
+static void FloatToIntegerSSE2( const float* src, unsigned char* dst, size_t size, const MAP& map )
+{
+  FloatToInt8SSE2( src, dst, size, map );
+}
+
+template< class MAP >
+static void FloatToIntegerSSE2( const float* src, short* dst, size_t size, const MAP& map )
+{
+  FloatToInt16SSE2( src, dst, size, map );
+}
+
+template< class MAP >
+static void FloatToIntegerSSE2( const float* src, unsigned short* dst, size_t size, const MAP& map )
+{
+  FloatToInt16SSE2( src, dst, size, map );
+}
+
+static void FloatToIntegerSSE2( const float* src, int* dst, size_t size, const IdentityMap& map )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 ) Store128( dst + j, _mm_cvttps_epi32( _mm_loadu_ps( src + j ) ) );
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+static void ConvertSSE2( const float* src, signed char* dst, size_t size )
+{
+  FloatToIntegerSSE2( src, dst, size, IdentityMap() );
+}
+
+static void ConvertSSE2( const float* src, unsigned char* dst, size_t size )
+{
+  FloatToIntegerSSE2( src, dst, size, IdentityMap() );
+}
+
+static void ConvertSSE2( const float* src, short* dst, size_t size )
+{
+  FloatToIntegerSSE2( src, dst, size, IdentityMap() );
+}
+
+static void ConvertSSE2( const float* src, unsigned short* dst, size_t size )
+{
+  FloatToIntegerSSE2( src, dst, size, IdentityMap() );
+}
+
+static void ConvertSSE2( const float* src, int* dst, size_t size )
+{
+  FloatToIntegerSSE2( src, dst, size, IdentityMap() );
+}
+
+//// AVX2 conversions to float ////
+
+CORE_TARGET_AVX2 static inline void StoreIntegersAsFloats( float* dst, __m256i value )
+{
+  _mm256_storeu_ps( dst, _mm256_cvtepi32_ps( value ) );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const signed char* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m128i value = Load128( src + j );
+    StoreIntegersAsFloats( dst + j, _mm256_cvtepi8_epi32( value ) );
+    StoreIntegersAsFloats( dst + j + 8, _mm256_cvtepi8_epi32( _mm_srli_si128( value, 8 ) ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const unsigned char* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m128i value = Load128( src + j );
+    StoreIntegersAsFloats( dst + j, _mm256_cvtepu8_epi32( value ) );
+    StoreIntegersAsFloats( dst + j + 8, _mm256_cvtepu8_epi32( _mm_srli_si128( value, 8 ) ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const short* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 ) StoreIntegersAsFloats( dst + j, _mm256_cvtepi16_epi32( Load128( src + j ) ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const unsigned short* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 ) StoreIntegersAsFloats( dst + j, _mm256_cvtepu16_epi32( Load128( src + j ) ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const int* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 ) StoreIntegersAsFloats( dst + j, Load256( src + j ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const unsigned int* src, float* dst, size_t size )
+{
+  const __m256i mask = _mm256_set1_epi32( 0xFFFF );
+  const __m256 scale = _mm256_set1_ps( 65536.0f );
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    __m256i value = Load256( src + j );
+    __m256 hi = _mm256_cvtepi32_ps( _mm256_srli_epi32( value, 16 ) );
+    __m256 lo = _mm256_cvtepi32_ps( _mm256_and_si256( value, mask ) );
+    _mm256_storeu_ps( dst + j, _mm256_add_ps( _mm256_mul_ps( hi, scale ), lo ) );
+  }
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const double* src, float* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 ) _mm_storeu_ps( dst + j, _mm256_cvtpd_ps( _mm256_loadu_pd( src + j ) ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, double* dst, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 ) _mm256_storeu_pd( dst + j, _mm256_cvtps_pd( _mm_loadu_ps( src + j ) ) );
+  ConvertScalar( src + j, dst + j, size - j );
+}
+
+//// AVX2 conversions from float ////
+
+class IdentityMapAVX2
+{
+public:
+  explicit IdentityMapAVX2( const IdentityMap& ) {}
+  CORE_TARGET_AVX2 __m256 operator()( __m256 value ) const { return value; }
+};
+
+class QuantizeMapAVX2
+{
+public:
+  CORE_TARGET_AVX2 explicit QuantizeMapAVX2( const QuantizeMap& map ) :
+    scale_( _mm256_set1_ps( map.scale_ ) ), 
+    min_( _mm256_set1_ps( map.min_ ) ), 
+    offset_( _mm256_set1_ps( map.offset_ ) ) {}
+
+  CORE_TARGET_AVX2 __m256 operator()( __m256 value ) const
+  {
+    return _mm256_add_ps( _mm256_mul_ps( this->scale_, _mm256_sub_ps( value, this->min_ ) ), 
+      this->offset_ );
+  }
+
+  __m256 scale_;
+  __m256 min_;
+  __m256 offset_;
+};
+
+template< class MAP >
+class VectorMapAVX2;
+
+template<> class VectorMapAVX2< IdentityMap > { public: typedef IdentityMapAVX2 type; };
+template<> class VectorMapAVX2< QuantizeMap > { public: typedef QuantizeMapAVX2 type; };
+
+template< class MAP >
+CORE_TARGET_AVX2 static inline __m256i TruncateToInt16AVX2( const float* src, const MAP& map )
+{
+  __m256i value = _mm256_cvttps_epi32( map( _mm256_loadu_ps( src ) ) );
+  return _mm256_srai_epi32( _mm256_slli_epi32( value, 16 ), 16 );
+}
+
+template< class DST, class MAP >
+CORE_TARGET_AVX2 static void FloatToInt8AVX2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  typename VectorMapAVX2< MAP >::type vector_map( map );
+  const __m256i mask = _mm256_set1_epi32( 0xFF );
+  // The packs work within 128 bit lanes, this restores the order of the 32 bit groups
+  const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+  size_t j = 0;
+  for ( ; j + 32 <= size; j += 32 )
+  {
+    __m256i v0 = _mm256_and_si256( _mm256_cvttps_epi32( vector_map( _mm256_loadu_ps( src + j ) ) ), mask );
+    __m256i v1 = _mm256_and_si256( _mm256_cvttps_epi32( vector_map( _mm256_loadu_ps( src + j + 8 ) ) ), mask );
+    __m256i v2 = _mm256_and_si256( _mm256_cvttps_epi32( vector_map( _mm256_loadu_ps( src + j + 16 ) ) ), mask );
+    __m256i v3 = _mm256_and_si256( _mm256_cvttps_epi32( vector_map( _mm256_loadu_ps( src + j + 24 ) ) ), mask );
+    __m256i packed = _mm256_packus_epi16( _mm256_packs_epi32( v0, v1 ), _mm256_packs_epi32( v2, v3 ) );
+    Store256( dst + j, _mm256_permutevar8x32_epi32( packed, order ) );
+  }
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+template< class DST, class MAP >
+CORE_TARGET_AVX2 static void FloatToInt16AVX2( const float* src, DST* dst, size_t size, const MAP& map )
+{
+  typename VectorMapAVX2< MAP >::type vector_map( map );
+  size_t j = 0;
+  for ( ; j + 16 <= size; j += 16 )
+  {
+    __m256i packed = _mm256_packs_epi32( TruncateToInt16AVX2( src + j, vector_map ), 
+      TruncateToInt16AVX2( src + j + 8, vector_map ) );
+    Store256( dst + j, _mm256_permute4x64_epi64( packed, _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+  }
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+template< class MAP >
+CORE_TARGET_AVX2 static void FloatToIntegerAVX2( const float* src, signed char* dst, size_t size, 
+  const MAP& map )
+{
+  FloatToInt8AVX2( src, dst, size, map );
+}
+
+template< class MAP >
+CORE_TARGET_AVX2 static void FloatToIntegerAVX2( const float* src, unsigned char* dst, size_t size, 
+  const MAP& map )
+{
+  FloatToInt8AVX2( src, dst, size, map );
+}
+
+template< class MAP >
+CORE_TARGET_AVX2 static void FloatToIntegerAVX2( const float* src, short* dst, size_t size, 
+  const MAP& map )
+{
+  FloatToInt16AVX2( src, dst, size, map );
+}
+
+template< class MAP >
+CORE_TARGET_AVX2 static void FloatToIntegerAVX2( const float* src, unsigned short* dst, size_t size, 
+  const MAP& map )
+{
+  FloatToInt16AVX2( src, dst, size, map );
+}
+
+CORE_TARGET_AVX2 static void FloatToIntegerAVX2( const float* src, int* dst, size_t size, 
+  const IdentityMap& map )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 ) Store256( dst + j, _mm256_cvttps_epi32( _mm256_loadu_ps( src + j ) ) );
+  FloatToIntegerScalar( src + j, dst + j, size - j, map );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, signed char* dst, size_t size )
+{
+  FloatToIntegerAVX2( src, dst, size, IdentityMap() );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, unsigned char* dst, size_t size )
+{
+  FloatToIntegerAVX2( src, dst, size, IdentityMap() );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, short* dst, size_t size )
+{
+  FloatToIntegerAVX2( src, dst, size, IdentityMap() );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, unsigned short* dst, size_t size )
+{
+  FloatToIntegerAVX2( src, dst, size, IdentityMap() );
+}
+
+CORE_TARGET_AVX2 static void ConvertAVX2( const float* src, int* dst, size_t size )
+{
+  FloatToIntegerAVX2( src, dst, size, IdentityMap() );
+}
+
+//// Endian swaps ////
+
+static void SwapEndian16SSE2( unsigned char* data, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    __m128i value = Load128( data + 2 * j );
+    Store128( data + 2 * j, _mm_or_si128( _mm_slli_epi16( value, 8 ), _mm_srli_epi16( value, 8 ) ) );
+  }
+  SwapEndianScalar< unsigned short >( data + 2 * j, size - j );
+}
+
+static void SwapEndian32SSE2( unsigned char* data, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m128i value = Load128( data + 4 * j );
+    value = _mm_or_si128( _mm_slli_epi16( value, 8 ), _mm_srli_epi16( value, 8 ) );
+    value = _mm_shufflelo_epi16( value, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    value = _mm_shufflehi_epi16( value, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    Store128( data + 4 * j, value );
+  }
+  SwapEndianScalar< unsigned int >( data + 4 * j, size - j );
+}
+
+static void SwapEndian64SSE2( unsigned char* data, size_t size )
+{
+  size_t j = 0;
+  for ( ; j + 2 <= size; j += 2 )
+  {
+    __m128i value = Load128( data + 8 * j );
+    value = _mm_or_si128( _mm_slli_epi16( value, 8 ), _mm_srli_epi16( value, 8 ) );
+    value = _mm_shufflelo_epi16( value, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+    value = _mm_shufflehi_epi16( value, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+    Store128( data + 8 * j, value );
+  }
+  SwapEndianScalar< unsigned long long >( data + 8 * j, size - j );
+}
+
+template< class T >
+CORE_TARGET_AVX2 static void SwapEndianAVX2( unsigned char* data, size_t size )
+{
+  // Byte order of one element, repeated over the register
+  char order[ 32 ];
+  for ( int j = 0; j < 32; j++ ) 
+  {
+    order[ j ] = static_cast< char >( ( j % 16 ) - ( j % sizeof( T ) ) + sizeof( T ) - 1 - ( j % sizeof( T ) ) );
+  }
+  const __m256i shuffle = Load256( order );
+  const size_t width = 32 / sizeof( T );
+  size_t j = 0;
+  for ( ; j + width <= size; j += width )
+  {
+    Store256( data + sizeof( T ) * j, _mm256_shuffle_epi8( Load256( data + sizeof( T ) * j ), shuffle ) );
+  }
+  SwapEndianScalar< T >( data + sizeof( T ) * j, size - j );
+}
+
+//// Minimum and maximum ////
+
+// The operations on one type of integer for the minimum and maximum. Types without
+// instructions of their own are biased into a type that has them.
+template< class T > class IntegerOpsSSE2;
+
+template<> class IntegerOpsSSE2< unsigned char >
+{
+public:
+  static __m128i load( const void* ptr ) { return Load128( ptr ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, value ); }
+  static __m128i min( __m128i a, __m128i b ) { return _mm_min_epu8( a, b ); }
+  static __m128i max( __m128i a, __m128i b ) { return _mm_max_epu8( a, b ); }
+};
+
+template<> class IntegerOpsSSE2< signed char >
+{
+public:
+  static __m128i bias() { return _mm_set1_epi8( static_cast< char >( 0x80 ) ); }
+  static __m128i load( const void* ptr ) { return _mm_xor_si128( Load128( ptr ), bias() ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, _mm_xor_si128( value, bias() ) ); }
+  static __m128i min( __m128i a, __m128i b ) { return _mm_min_epu8( a, b ); }
+  static __m128i max( __m128i a, __m128i b ) { return _mm_max_epu8( a, b ); }
+};
+
+template<> class IntegerOpsSSE2< short >
+{
+public:
+  static __m128i load( const void* ptr ) { return Load128( ptr ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, value ); }
+  static __m128i min( __m128i a, __m128i b ) { return _mm_min_epi16( a, b ); }
+  static __m128i max( __m128i a, __m128i b ) { return _mm_max_epi16( a, b ); }
+};
+
+template<> class IntegerOpsSSE2< unsigned short >
+{
+public:
+  static __m128i bias() { return _mm_set1_epi16( static_cast< short >( 0x8000 ) ); }
+  static __m128i load( const void* ptr ) { return _mm_xor_si128( Load128( ptr ), bias() ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, _mm_xor_si128( value, bias() ) ); }
+  static __m128i min( __m128i a, __m128i b ) { return _mm_min_epi16( a, b ); }
+  static __m128i max( __m128i a, __m128i b ) { return _mm_max_epi16( a, b ); }
+};
+
+template<> class IntegerOpsSSE2< int >
+{
+public:
+  static __m128i load( const void* ptr ) { return Load128( ptr ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, value ); }
+  static __m128i min( __m128i a, __m128i b ) 
+  { 
+    __m128i greater = _mm_cmpgt_epi32( a, b );
+    return _mm_or_si128( _mm_and_si128( greater, b ), _mm_andnot_si128( greater, a ) );
+  }
+  static __m128i max( __m128i a, __m128i b ) 
+  { 
+    __m128i greater = _mm_cmpgt_epi32( a, b );
+    return _mm_or_si128( _mm_and_si128( greater, a ), _mm_andnot_si128( greater, b ) );
+  }
+};
+
+template<> class IntegerOpsSSE2< unsigned int >
+{
+public:
+  static __m128i bias() { return _mm_set1_epi32( static_cast< int >( 0x80000000u ) ); }
+  static __m128i load( const void* ptr ) { return _mm_xor_si128( Load128( ptr ), bias() ); }
+  static void store( void* ptr, __m128i value ) { Store128( ptr, _mm_xor_si128( value, bias() ) ); }
+  static __m128i min( __m128i a, __m128i b ) { return IntegerOpsSSE2< int >::min( a, b ); }
+  static __m128i max( __m128i a, __m128i b ) { return IntegerOpsSSE2< int >::max( a, b ); }
+};
+
+template< class T >
+static void MinMaxIntegerSSE2( const T* data, size_t size, MinMax< T >& result )
+{
+  typedef IntegerOpsSSE2< T > ops;
+  const size_t width = 16 / sizeof( T );
+  if ( size < width )
+  {
+    result.add( data, size );
+    return;
+  }
+
+  __m128i min = ops::load( data );
+  __m128i max = min;
+  size_t j = width;
+  for ( ; j + width <= size; j += width )
+  {
+    __m128i value = ops::load( data + j );
+    min = ops::min( min, value );
+    max = ops::max( max, value );
+  }
+
+  T lanes[ 16 / sizeof( T ) ];
+  ops::store( lanes, min );
+  result.add( lanes, width );
+  ops::store( lanes, max );
+  result.add( lanes, width );
+  result.add( data + j, size - j );
+}
+
+static void MinMaxSSE2( const signed char* data, size_t size, MinMax< signed char >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+static void MinMaxSSE2( const unsigned char* data, size_t size, MinMax< unsigned char >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+static void MinMaxSSE2( const short* data, size_t size, MinMax< short >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+static void MinMaxSSE2( const unsigned short* data, size_t size, MinMax< unsigned short >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+static void MinMaxSSE2( const int* data, size_t size, MinMax< int >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+static void MinMaxSSE2( const unsigned int* data, size_t size, MinMax< unsigned int >& result )
+{
+  MinMaxIntegerSSE2( data, size, result );
+}
+
+// Values that are not finite are replaced by values that do not change the result:
+// x - x is zero only for finite values.
+static void MinMaxSSE2( const float* data, size_t size, MinMax< float >& result )
+{
+  const __m128 high = _mm_set1_ps( std::numeric_limits< float >::max() );
+  const __m128 low = _mm_set1_ps( -std::numeric_limits< float >::max() );
+  const __m128 zero = _mm_setzero_ps();
+  __m128 min = high;
+  __m128 max = low;
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m128 value = _mm_loadu_ps( data + j );
+    __m128 finite = _mm_cmpeq_ps( _mm_sub_ps( value, value ), zero );
+    __m128 finite_value = _mm_and_ps( finite, value );
+    min = _mm_min_ps( min, _mm_or_ps( finite_value, _mm_andnot_ps( finite, high ) ) );
+    max = _mm_max_ps( max, _mm_or_ps( finite_value, _mm_andnot_ps( finite, low ) ) );
+  }
+
+  float lanes[ 4 ];
+  _mm_storeu_ps( lanes, min );
+  float lane_min = std::min( std::min( lanes[ 0 ], lanes[ 1 ] ), std::min( lanes[ 2 ], lanes[ 3 ] ) );
+  _mm_storeu_ps( lanes, max );
+  float lane_max = std::max( std::max( lanes[ 0 ], lanes[ 1 ] ), std::max( lanes[ 2 ], lanes[ 3 ] ) );
+  // If no finite value was found only the sentinels are left, with min above max
+  if ( lane_min <= lane_max )
+  {
+    result.add( lane_min );
+    result.add( lane_max );
+  }
+  result.add( data + j, size - j );
+}
+
+static void MinMaxSSE2( const double* data, size_t size, MinMax< double >& result )
+{
+  const __m128d high = _mm_set1_pd( std::numeric_limits< double >::max() );
+  const __m128d low = _mm_set1_pd( -std::numeric_limits< double >::max() );
+  const __m128d zero = _mm_setzero_pd();
+  __m128d min = high;
+  __m128d max = low;
+  size_t j = 0;
+  for ( ; j + 2 <= size; j += 2 )
+  {
+    __m128d value = _mm_loadu_pd( data + j );
+    __m128d finite = _mm_cmpeq_pd( _mm_sub_pd( value, value ), zero );
+    __m128d finite_value = _mm_and_pd( finite, value );
+    min = _mm_min_pd( min, _mm_or_pd( finite_value, _mm_andnot_pd( finite, high ) ) );
+    max = _mm_max_pd( max, _mm_or_pd( finite_value, _mm_andnot_pd( finite, low ) ) );
+  }
+
+  double lanes[ 2 ];
+  _mm_storeu_pd( lanes, min );
+  double lane_min = std::min( lanes[ 0 ], lanes[ 1 ] );
+  _mm_storeu_pd( lanes, max );
+  double lane_max = std::max( lanes[ 0 ], lanes[ 1 ] );
+  if ( lane_min <= lane_max )
+  {
+    result.add( lane_min );
+    result.add( lane_max );
+  }
+  result.add( data + j, size - j );
+}
+
+template< class T > class IntegerOpsAVX2;
+
+template<> class IntegerOpsAVX2< signed char >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epi8( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epi8( a, b ); }
+};
+
+template<> class IntegerOpsAVX2< unsigned char >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epu8( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epu8( a, b ); }
+};
+
+template<> class IntegerOpsAVX2< short >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epi16( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epi16( a, b ); }
+};
+
+template<> class IntegerOpsAVX2< unsigned short >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epu16( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epu16( a, b ); }
+};
+
+template<> class IntegerOpsAVX2< int >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epi32( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epi32( a, b ); }
+};
+
+template<> class IntegerOpsAVX2< unsigned int >
+{
+public:
+  CORE_TARGET_AVX2 static __m256i min( __m256i a, __m256i b ) { return _mm256_min_epu32( a, b ); }
+  CORE_TARGET_AVX2 static __m256i max( __m256i a, __m256i b ) { return _mm256_max_epu32( a, b ); }
+};
+
+template< class T >
+CORE_TARGET_AVX2 static void MinMaxIntegerAVX2( const T* data, size_t size, MinMax< T >& result )
+{
+  typedef IntegerOpsAVX2< T > ops;
+  const size_t width = 32 / sizeof( T );
+  if ( size < width )
+  {
+    result.add( data, size );
+    return;
+  }
+
+  __m256i min = Load256( data );
+  __m256i max = min;
+  size_t j = width;
+  for ( ; j + width <= size; j += width )
+  {
+    __m256i value = Load256( data + j );
+    min = ops::min( min, value );
+    max = ops::max( max, value );
+  }
+
+  T lanes[ 32 / sizeof( T ) ];
+  Store256( lanes, min );
+  result.add( lanes, width );
+  Store256( lanes, max );
+  result.add( lanes, width );
+  result.add( data + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const signed char* data, size_t size, 
+  MinMax< signed char >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const unsigned char* data, size_t size, 
+  MinMax< unsigned char >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const short* data, size_t size, MinMax< short >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const unsigned short* data, size_t size, 
+  MinMax< unsigned short >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const int* data, size_t size, MinMax< int >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const unsigned int* data, size_t size, 
+  MinMax< unsigned int >& result )
+{
+  MinMaxIntegerAVX2( data, size, result );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const float* data, size_t size, MinMax< float >& result )
+{
+  const __m256 high = _mm256_set1_ps( std::numeric_limits< float >::max() );
+  const __m256 low = _mm256_set1_ps( -std::numeric_limits< float >::max() );
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 min = high;
+  __m256 max = low;
+  size_t j = 0;
+  for ( ; j + 8 <= size; j += 8 )
+  {
+    __m256 value = _mm256_loadu_ps( data + j );
+    __m256 finite = _mm256_cmp_ps( _mm256_sub_ps( value, value ), zero, _CMP_EQ_OQ );
+    min = _mm256_min_ps( min, _mm256_blendv_ps( high, value, finite ) );
+    max = _mm256_max_ps( max, _mm256_blendv_ps( low, value, finite ) );
+  }
+
+  float lanes[ 8 ];
+  _mm256_storeu_ps( lanes, min );
+  float lane_min = *std::min_element( lanes, lanes + 8 );
+  _mm256_storeu_ps( lanes, max );
+  float lane_max = *std::max_element( lanes, lanes + 8 );
+  if ( lane_min <= lane_max )
+  {
+    result.add( lane_min );
+    result.add( lane_max );
+  }
+  result.add( data + j, size - j );
+}
+
+CORE_TARGET_AVX2 static void MinMaxAVX2( const double* data, size_t size, MinMax< double >& result )
+{
+  const __m256d high = _mm256_set1_pd( std::numeric_limits< double >::max() );
+  const __m256d low = _mm256_set1_pd( -std::numeric_limits< double >::max() );
+  const __m256d zero = _mm256_setzero_pd();
+  __m256d min = high;
+  __m256d max = low;
+  size_t j = 0;
+  for ( ; j + 4 <= size; j += 4 )
+  {
+    __m256d value = _mm256_loadu_pd( data + j );
+    __m256d finite = _mm256_cmp_pd( _mm256_sub_pd( value, value ), zero, _CMP_EQ_OQ );
+    min = _mm256_min_pd( min, _mm256_blendv_pd( high, value, finite ) );
+    max = _mm256_max_pd( max, _mm256_blendv_pd( low, value, finite ) );
+  }
+
+  double lanes[ 4 ];
+  _mm256_storeu_pd( lanes, min );
+  double lane_min = *std::min_element( lanes, lanes + 4 );
+  _mm256_storeu_pd( lanes, max );
+  double lane_max = *std::max_element( lanes, lanes + 4 );
+  if ( lane_min <= lane_max )
+  {
+    result.add( lane_min );
+    result.add( lane_max );
+  }
+  result.add( data + j, size - j );
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Dispatch over instruction sets and data types
+//////////////////////////////////////////////////////////////////////////
+
+template< class SRC, class DST >
+static void ConvertTyped( const SRC* src, DST* dst, size_t size, int instruction_set )
+{
+#ifdef CORE_DATABLOCK_SSE2
+  if ( instruction_set >= InstructionSetType::AVX2_E ) ConvertAVX2( src, dst, size );
+  else if ( instruction_set >= InstructionSetType::SSE2_E ) ConvertSSE2( src, dst, size );
+  else
+#endif
+  ConvertScalar( src, dst, size );
+}
+
+template< class SRC >
+static void ConvertFrom( const SRC* src, void* dst, DataType dst_type, size_t size, 
+  int instruction_set )
+{
+  switch ( dst_type )
+  {
+  case DataType::CHAR_E:
+    ConvertTyped( src, static_cast< signed char* >( dst ), size, instruction_set ); break;
+  case DataType::UCHAR_E:
+    ConvertTyped( src, static_cast< unsigned char* >( dst ), size, instruction_set ); break;
+  case DataType::SHORT_E:
+    ConvertTyped( src, static_cast< short* >( dst ), size, instruction_set ); break;
+  case DataType::USHORT_E:
+    ConvertTyped( src, static_cast< unsigned short* >( dst ), size, instruction_set ); break;
+  case DataType::INT_E:
+    ConvertTyped( src, static_cast< int* >( dst ), size, instruction_set ); break;
+  case DataType::UINT_E:
+    ConvertTyped( src, static_cast< unsigned int* >( dst ), size, instruction_set ); break;
+  case DataType::FLOAT_E:
+    ConvertTyped( src, static_cast< float* >( dst ), size, instruction_set ); break;
+  case DataType::DOUBLE_E:
+    ConvertTyped( src, static_cast< double* >( dst ), size, instruction_set ); break;
+  default:
+    break;
+  }
+}
+
+static void ConvertRange( const unsigned char* src, DataType src_type, unsigned char* dst, 
+  DataType dst_type, int instruction_set, size_t begin, size_t end )
+{
+  src += begin * GetSizeDataType( src_type );
+  dst += begin * GetSizeDataType( dst_type );
+  size_t size = end - begin;
+
+  switch ( src_type )
+  {
+  case DataType::CHAR_E:
+    ConvertFrom( reinterpret_cast< const signed char* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::UCHAR_E:
+    ConvertFrom( src, dst, dst_type, size, instruction_set ); break;
+  case DataType::SHORT_E:
+    ConvertFrom( reinterpret_cast< const short* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::USHORT_E:
+    ConvertFrom( reinterpret_cast< const unsigned short* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::INT_E:
+    ConvertFrom( reinterpret_cast< const int* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::UINT_E:
+    ConvertFrom( reinterpret_cast< const unsigned int* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::FLOAT_E:
+    ConvertFrom( reinterpret_cast< const float* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  case DataType::DOUBLE_E:
+    ConvertFrom( reinterpret_cast< const double* >( src ), dst, dst_type, size, 
+      instruction_set ); break;
+  default:
+    break;
+  }
+}
+
+template< class DST, class MAP >
+static void FloatToInteger( const float* src, DST* dst, size_t size, const MAP& map, 
+  int instruction_set )
+{
+#ifdef CORE_DATABLOCK_SSE2
+  if ( instruction_set >= InstructionSetType::AVX2_E ) FloatToIntegerAVX2( src, dst, size, map );
+  else if ( instruction_set >= InstructionSetType::SSE2_E ) FloatToIntegerSSE2( src, dst, size, map );
+  else
+#endif
+  FloatToIntegerScalar( src, dst, size, map );
+}
+
+// Quantization into 8 and 16 bit types is done in single precision
+template< class SRC, class DST >
+static void QuantizeTyped( const SRC* src, DST* dst, size_t size, const QuantizeMap& map,
+  int instruction_set )
+{
+  // Convert blocks that stay in the cache to float and map those onto the integer range
+  float buffer[ QUANTIZE_BLOCK_C ];
+  for ( size_t j = 0; j < size; j += QUANTIZE_BLOCK_C )
+  {
+    size_t block_size = std::min( QUANTIZE_BLOCK_C, size - j );
+    ConvertTyped( src + j, buffer, block_size, instruction_set );
+    FloatToInteger( buffer, dst + j, block_size, map, instruction_set );
+  }
+}
+
+template< class DST >
+static void QuantizeTyped( const float* src, DST* dst, size_t size, const QuantizeMap& map,
+  int instruction_set )
+{
+  FloatToInteger( src, dst, size, map, instruction_set );
+}
+
+// Quantization into 32 bit types needs double precision
+template< class SRC, class DST >
+static void QuantizeWide( const SRC* src, DST* dst, size_t size, double min, double max, 
+  double offset )
+{
+  double multiplier = 0.0;
+  if ( max > min ) multiplier = static_cast< double >( 0x100000000ull ) / ( max - min );
+  for ( size_t j = 0; j < size; j++ )
+  {
+    dst[ j ] = static_cast< DST >( multiplier * ( static_cast< double >( src[ j ] ) - min ) + offset );
+  }
+}
+
+template< class SRC >
+static void QuantizeFrom( const SRC* src, void* dst, DataType dst_type, size_t size, 
+  double min, double max, int instruction_set )
+{
+  float fmin = static_cast< float >( min );
+  float fmax = static_cast< float >( max );
+  float range = fmax - fmin;
+
+  switch ( dst_type )
+  {
+  case DataType::CHAR_E:
+    QuantizeTyped( src, static_cast< signed char* >( dst ), size, QuantizeMap( 
+      range > 0.0f ? static_cast< float >( 0x100 ) / range : 0.0f, fmin, 0.5f - 0x80 ), 
+      instruction_set ); 
+    break;
+  case DataType::UCHAR_E:
+    QuantizeTyped( src, static_cast< unsigned char* >( dst ), size, QuantizeMap( 
+      range > 0.0f ? static_cast< float >( 0x100 ) / range : 0.0f, fmin, 0.5f ), 
+      instruction_set ); 
+    break;
+  case DataType::SHORT_E:
+    QuantizeTyped( src, static_cast< short* >( dst ), size, QuantizeMap( 
+      range > 0.0f ? static_cast< float >( 0x10000 ) / range : 0.0f, fmin, 0.5f - 0x8000 ), 
+      instruction_set ); 
+    break;
+  case DataType::USHORT_E:
+    QuantizeTyped( src, static_cast< unsigned short* >( dst ), size, QuantizeMap( 
+      range > 0.0f ? static_cast< float >( 0x10000 ) / range : 0.0f, fmin, 0.5f ), 
+      instruction_set ); 
+    break;
+  case DataType::INT_E:
+    QuantizeWide( src, static_cast< int* >( dst ), size, min, max, 0.5 - 0x80000000ull );
+    break;
+  case DataType::UINT_E:
+    QuantizeWide( src, static_cast< unsigned int* >( dst ), size, min, max, 0.5 );
+    break;
+  default:
+    break;
+  }
+}
+
+static void QuantizeRange( const unsigned char* src, DataType src_type, unsigned char* dst, 
+  DataType dst_type, double min, double max, int instruction_set, size_t begin, size_t end )
+{
+  src += begin * GetSizeDataType( src_type );
+  dst += begin * GetSizeDataType( dst_type );
+  size_t size = end - begin;
+
+  switch ( src_type )
+  {
+  case DataType::CHAR_E:
+    QuantizeFrom( reinterpret_cast< const signed char* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::UCHAR_E:
+    QuantizeFrom( src, dst, dst_type, size, min, max, instruction_set ); break;
+  case DataType::SHORT_E:
+    QuantizeFrom( reinterpret_cast< const short* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::USHORT_E:
+    QuantizeFrom( reinterpret_cast< const unsigned short* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::INT_E:
+    QuantizeFrom( reinterpret_cast< const int* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::UINT_E:
+    QuantizeFrom( reinterpret_cast< const unsigned int* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::FLOAT_E:
+    QuantizeFrom( reinterpret_cast< const float* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  case DataType::DOUBLE_E:
+    QuantizeFrom( reinterpret_cast< const double* >( src ), dst, dst_type, size, 
+      min, max, instruction_set ); break;
+  default:
+    break;
+  }
+}
+
+static void SwapEndianRange( unsigned char* data, size_t elem_size, int instruction_set, 
+  size_t begin, size_t end )
+{
+  data += begin * elem_size;
+  size_t size = end - begin;
+
+  switch ( elem_size )
+  {
+  case 1:
+    break;
+  case 2:
+#ifdef CORE_DATABLOCK_SSE2
+    if ( instruction_set >= InstructionSetType::AVX2_E ) 
+      SwapEndianAVX2< unsigned short >( data, size );
+    else if ( instruction_set >= InstructionSetType::SSE2_E ) SwapEndian16SSE2( data, size );
+    else
+#endif
+    SwapEndianScalar< unsigned short >( data, size );
+    break;
+  case 4:
+#ifdef CORE_DATABLOCK_SSE2
+    if ( instruction_set >= InstructionSetType::AVX2_E ) 
+      SwapEndianAVX2< unsigned int >( data, size );
+    else if ( instruction_set >= InstructionSetType::SSE2_E ) SwapEndian32SSE2( data, size );
+    else
+#endif
+    SwapEndianScalar< unsigned int >( data, size );
+    break;
+  case 8:
+#ifdef CORE_DATABLOCK_SSE2
+    if ( instruction_set >= InstructionSetType::AVX2_E ) 
+      SwapEndianAVX2< unsigned long long >( data, size );
+    else if ( instruction_set >= InstructionSetType::SSE2_E ) SwapEndian64SSE2( data, size );
+    else
+#endif
+    SwapEndianScalar< unsigned long long >( data, size );
+    break;
+  default:
+    SwapEndianGeneric( data, size, elem_size );
+    break;
+  }
+}
+
+// Collects the minimum and maximum of the ranges processed by the thread pool
+class MinMaxCollector
+{
+public:
+  MinMaxCollector() : found_( false ), min_( 0.0 ), max_( 0.0 ) {}
+
+  template< class T >
+  void add( const MinMax< T >& result )
+  {
+    if ( !result.found_ ) return;
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    if ( !this->found_ || result.min_ < this->min_ ) this->min_ = static_cast< double >( result.min_ );
+    if ( !this->found_ || result.max_ > this->max_ ) this->max_ = static_cast< double >( result.max_ );
+    this->found_ = true;
+  }
+
+  boost::mutex mutex_;
+  bool found_;
+  double min_;
+  double max_;
+};
+
+template< class T >
+static void MinMaxTyped( const T* data, int instruction_set, MinMaxCollector* collector, 
+  size_t begin, size_t end )
+{
+  MinMax< T > result;
+#ifdef CORE_DATABLOCK_SSE2
+  if ( instruction_set >= InstructionSetType::AVX2_E ) MinMaxAVX2( data + begin, end - begin, result );
+  else if ( instruction_set >= InstructionSetType::SSE2_E ) MinMaxSSE2( data + begin, end - begin, result );
+  else
+#endif
+  result.add( data + begin, end - begin );
+  collector->add( result );
+}
+
+static bool IsKernelDataType( DataType data_type )
+{
+  switch ( data_type )
+  {
+  case DataType::CHAR_E:
+  case DataType::UCHAR_E:
+  case DataType::SHORT_E:
+  case DataType::USHORT_E:
+  case DataType::INT_E:
+  case DataType::UINT_E:
+  case DataType::FLOAT_E:
+  case DataType::DOUBLE_E:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Run function on the calling thread, or split it over the thread pool for large arrays
+static void RunRanges( size_t size, const ThreadPool::range_function_type& function )
+{
+  if ( size < PARALLEL_SIZE_C )
+  {
+    function( 0, size );
+  }
+  else
+  {
+    ThreadPool::Instance()->parallel_for( 0, size, PARALLEL_GRAIN_C, function );
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class DataBlockKernels
+//////////////////////////////////////////////////////////////////////////
+
+bool DataBlockKernels::Convert( const void* src, DataType src_type, void* dst, 
+  DataType dst_type, size_t size )
+{
+  if ( !IsKernelDataType( src_type ) || !IsKernelDataType( dst_type ) ) return false;
+
+  RunRanges( size, boost::bind( &ConvertRange, static_cast< const unsigned char* >( src ), 
+    src_type, static_cast< unsigned char* >( dst ), dst_type, ActiveInstructionSet(), _1, _2 ) );
+  return true;
+}
+
+bool DataBlockKernels::Quantize( const void* src, DataType src_type, void* dst, 
+  DataType dst_type, size_t size, double min, double max )
+{
+  if ( !IsKernelDataType( src_type ) ) return false;
+  if ( dst_type != DataType::CHAR_E && dst_type != DataType::UCHAR_E &&
+    dst_type != DataType::SHORT_E && dst_type != DataType::USHORT_E &&
+    dst_type != DataType::INT_E && dst_type != DataType::UINT_E ) return false;
+
+  RunRanges( size, boost::bind( &QuantizeRange, static_cast< const unsigned char* >( src ), 
+    src_type, static_cast< unsigned char* >( dst ), dst_type, min, max, 
+    ActiveInstructionSet(), _1, _2 ) );
+  return true;
+}
+
+void DataBlockKernels::SwapEndian( void* data, size_t size, size_t elem_size )
+{
+  if ( elem_size < 2 ) return;
+  RunRanges( size, boost::bind( &SwapEndianRange, static_cast< unsigned char* >( data ), 
+    elem_size, ActiveInstructionSet(), _1, _2 ) );
+}
+
+bool DataBlockKernels::ComputeMinMax( const void* data, DataType data_type, size_t size, 
+  double& min, double& max )
+{
+  MinMaxCollector collector;
+  int instruction_set = ActiveInstructionSet();
+
+  switch ( data_type )
+  {
+  case DataType::CHAR_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< signed char >, 
+      static_cast< const signed char* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::UCHAR_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< unsigned char >, 
+      static_cast< const unsigned char* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::SHORT_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< short >, 
+      static_cast< const short* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::USHORT_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< unsigned short >, 
+      static_cast< const unsigned short* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::INT_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< int >, 
+      static_cast< const int* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::UINT_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< unsigned int >, 
+      static_cast< const unsigned int* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::FLOAT_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< float >, 
+      static_cast< const float* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  case DataType::DOUBLE_E:
+    RunRanges( size, boost::bind( &MinMaxTyped< double >, 
+      static_cast< const double* >( data ), instruction_set, &collector, _1, _2 ) );
+    break;
+  default:
+    return false;
+  }
+
+  if ( !collector.found_ ) return false;
+  min = collector.min_;
+  max = collector.max_;
+  return true;
+}
+
+InstructionSetType DataBlockKernels::GetInstructionSet()
+{
+  return static_cast< InstructionSetType::enum_type >( ActiveInstructionSet() );
+}
+
+void DataBlockKernels::SetInstructionSet( InstructionSetType instruction_set )
+{
+  ActiveInstructionSet() = std::min( static_cast< int >( instruction_set ), 
+    SupportedInstructionSet() );
+}
+
+InstructionSetType DataBlockKernels::GetSupportedInstructionSet()
+{
+  return static_cast< InstructionSetType::enum_type >( SupportedInstructionSet() );
+}
+
+} // end namespace Core
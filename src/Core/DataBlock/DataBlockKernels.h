@@ -0,0 +1,98 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_DATABLOCKKERNELS_H
+#define CORE_DATABLOCK_DATABLOCKKERNELS_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Core includes
+#include <Core/Utils/EnumClass.h>
+#include <Core/DataBlock/DataType.h>
+
+namespace Core
+{
+
+// CLASS InstructionSetType:
+/// Vector instructions used by the data block kernels
+CORE_ENUM_CLASS
+(
+  InstructionSetType,
+  SCALAR_E = 0,
+  SSE2_E,
+  AVX2_E
+)
+
+// CLASS DataBlockKernels:
+/// Loops over whole arrays of elements that are used by the data block functions. They
+/// work on typed data and use SSE2 or AVX2 instructions, depending on what the processor
+/// supports. Large arrays are split over the thread pool.
+class DataBlockKernels
+{
+public:
+  /// CONVERT
+  /// Convert size elements of src_type into dst_type, every element is converted as with
+  /// a static_cast. Returns false if one of the types is not supported.
+  static bool Convert( const void* src, DataType src_type, void* dst, DataType dst_type, 
+    size_t size );
+
+  /// QUANTIZE
+  /// Map the range [ min, max ] of the source data linearly onto the full range of the integer
+  /// type dst_type. Returns false if dst_type is not an integer type of at most 32 bits.
+  static bool Quantize( const void* src, DataType src_type, void* dst, DataType dst_type,
+    size_t size, double min, double max );
+
+  /// SWAP_ENDIAN
+  /// Reverse the bytes of size elements of elem_size bytes each
+  static void SwapEndian( void* data, size_t size, size_t elem_size );
+
+  /// COMPUTE_MIN_MAX
+  /// Compute the minimum and maximum of the data. Values that are not finite are skipped.
+  /// Returns false if there are no values, or if none of them is finite.
+  static bool ComputeMinMax( const void* data, DataType data_type, size_t size, 
+    double& min, double& max );
+
+  /// GET_INSTRUCTION_SET
+  /// The instructions the kernels currently use
+  static InstructionSetType GetInstructionSet();
+
+  /// SET_INSTRUCTION_SET
+  /// Limit the kernels to a set of instructions, for testing and benchmarking. Instructions
+  /// that the processor does not support are never used.
+  static void SetInstructionSet( InstructionSetType instruction_set );
+
+  /// GET_SUPPORTED_INSTRUCTION_SET
+  /// The best instructions supported by this processor and build
+  static InstructionSetType GetSupportedInstructionSet();
+};
+
+} // end namespace Core
+
+#endif
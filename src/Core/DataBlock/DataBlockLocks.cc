@@ -0,0 +1,91 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+
+// Core includes
+#include <Core/DataBlock/DataBlockLocks.h>
+
+namespace Core
+{
+
+DataBlockLocks::DataBlockLocks( DataBlockHandle write_block, 
+  const std::vector< DataBlockHandle >& read_blocks )
+{
+  mutex_type* write_mutex = write_block ? &write_block->get_mutex() : 0;
+
+  std::vector< mutex_type* > read_mutexes;
+  for ( size_t j = 0; j < read_blocks.size(); j++ )
+  {
+    if ( read_blocks[ j ] ) read_mutexes.push_back( &read_blocks[ j ]->get_mutex() );
+  }
+  this->lock( write_mutex, read_mutexes );
+}
+
+DataBlockLocks::DataBlockLocks( MaskDataBlockHandle write_mask, MaskDataBlockHandle read_mask1,
+  MaskDataBlockHandle read_mask2 )
+{
+  mutex_type* write_mutex = write_mask ? &write_mask->get_mutex() : 0;
+
+  std::vector< mutex_type* > read_mutexes;
+  if ( read_mask1 ) read_mutexes.push_back( &read_mask1->get_mutex() );
+  if ( read_mask2 ) read_mutexes.push_back( &read_mask2->get_mutex() );
+  this->lock( write_mutex, read_mutexes );
+}
+
+DataBlockLocks::DataBlockLocks( mutex_type* write_mutex, 
+  const std::vector< mutex_type* >& read_mutexes )
+{
+  this->lock( write_mutex, read_mutexes );
+}
+
+void DataBlockLocks::lock( mutex_type* write_mutex, std::vector< mutex_type* > mutexes )
+{
+  if ( write_mutex ) mutexes.push_back( write_mutex );
+  mutexes.erase( std::remove( mutexes.begin(), mutexes.end(), 
+    static_cast< mutex_type* >( 0 ) ), mutexes.end() );
+  std::sort( mutexes.begin(), mutexes.end() );
+  mutexes.erase( std::unique( mutexes.begin(), mutexes.end() ), mutexes.end() );
+
+  for ( size_t j = 0; j < mutexes.size(); j++ )
+  {
+    if ( mutexes[ j ] == write_mutex )
+    {
+      this->locks_.push_back( boost::shared_ptr< DataBlock::lock_type >( 
+        new DataBlock::lock_type( *mutexes[ j ] ) ) );
+    }
+    else
+    {
+      this->shared_locks_.push_back( boost::shared_ptr< DataBlock::shared_lock_type >( 
+        new DataBlock::shared_lock_type( *mutexes[ j ] ) ) );
+    }
+  }
+}
+
+} // end namespace Core
@@ -0,0 +1,79 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_DATABLOCKLOCKS_H
+#define CORE_DATABLOCK_DATABLOCKLOCKS_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <vector>
+
+// Boost includes
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+
+namespace Core
+{
+
+// CLASS DataBlockLocks:
+/// Locks one data block that is written and any number of data blocks that are read for as
+/// long as the object exists. Masks share their mutex and a block can be both written and
+/// read, so every mutex is only locked once, and the mutexes are always locked in the same
+/// order so two threads cannot wait on each other.
+class DataBlockLocks : public boost::noncopyable
+{
+public:
+  typedef DataBlock::mutex_type mutex_type;
+
+  DataBlockLocks( DataBlockHandle write_block, const std::vector< DataBlockHandle >& read_blocks );
+
+  /// NOTE: Masks are locked through the mutex of the mask, which stays the same when the
+  /// masks are compacted.
+  DataBlockLocks( MaskDataBlockHandle write_mask, MaskDataBlockHandle read_mask1,
+    MaskDataBlockHandle read_mask2 = MaskDataBlockHandle() );
+
+  /// Lock mutexes that were obtained from data blocks and masks. The write mutex can be 0.
+  DataBlockLocks( mutex_type* write_mutex, const std::vector< mutex_type* >& read_mutexes );
+
+private:
+  void lock( mutex_type* write_mutex, std::vector< mutex_type* > mutexes );
+
+  std::vector< boost::shared_ptr< DataBlock::lock_type > > locks_;
+  std::vector< boost::shared_ptr< DataBlock::shared_lock_type > > shared_locks_;
+};
+
+} // end namespace Core
+
+#endif
@@ -32,11 +32,15 @@
 
 // Boost includes
 #include <boost/algorithm/minmax_element.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/mutex.hpp>
 
 // Core includes
-#include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
 #include <Core/Utils/StringUtil.h>
 #include <Core/Math/MathFunctions.h>
+#include <Core/DataBlock/DataBlockKernels.h>
 #include <Core/DataBlock/Histogram.h>
 
 namespace Core
@@ -95,269 +99,250 @@ Histogram::~Histogram()
 {
 }
 
-// For char and short data we do a single pass over the data to speed up the computation. The
-// first pass is used to generate the histogram. In the next step we use this data to compute
-// min and max
+// Number of values that one task of the thread pool adds to the histogram
+static const size_t HISTOGRAM_GRAIN_C = 1 << 20;
 
-bool Histogram::compute( const signed char* data, size_t size )
+// Number of bins used for data with a large range
+static const size_t HISTOGRAM_SIZE_C = 0x100;
+
+// Run functor over [0, size) and split it over the thread pool if there is enough data
+template< class FUNCTOR >
+static void RunOverRanges( size_t size, FUNCTOR& functor )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
-  
-  try
+  if ( size <= HISTOGRAM_GRAIN_C )
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x100 , 0 );
-
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) + 0x80 ]++;
-    }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
-    {
-      if ( histogram[ j ] > 0 ) hist_end = j;
-    }
-
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
-    {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
-    }
-
-    this->min_ = static_cast<double>( hist_begin ) - static_cast<double>( 0x80 );
-    this->max_ = static_cast<double>( hist_end ) - static_cast<double>( 0x80 );
-
-    this->bin_size_  = 1.0;
-    this->bin_start_ = this->min_ - 0.5;
-
-    this->histogram_.resize( hist_end + 1 - hist_begin );
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
-    {
-      this->histogram_[ j ] = histogram[ j + hist_begin ];
-    }
-
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+    functor( 0, size );
   }
-  catch( ... )
+  else
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    ThreadPool::Instance()->parallel_for( 0, size, HISTOGRAM_GRAIN_C, boost::ref( functor ) );
   }
-  
-  return true;
 }
 
-bool Histogram::compute( const unsigned char* data, size_t size )
+// Counts how often every value of an 8 or 16 bit type occurs. Every range of the data is
+// counted in a table of its own and the tables are added together at the end.
+template< class T >
+class ValueCounter : public boost::noncopyable
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+public:
+  ValueCounter( const T* data, int offset, size_t num_values ) :
+    data_( data ), offset_( offset ), counts_( num_values, 0 ) {}
 
-  try
+  void operator()( size_t begin, size_t end )
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x100, 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
+    // Small tables are interleaved so that runs of equal values do not wait on each other
+    const size_t num_values = this->counts_.size();
+    const size_t num_tables = num_values <= 0x100 ? 4 : 1;
+    std::vector< size_t > counts( num_tables * num_values, 0 );
+
+    size_t j = begin;
+    if ( num_tables == 4 )
     {
-      histogram[ static_cast<int>( data[ j ] ) ]++;
+      for ( ; j + 4 <= end; j += 4 )
+      {
+        counts[ static_cast< int >( this->data_[ j ] ) + this->offset_ ]++;
+        counts[ num_values + static_cast< int >( this->data_[ j + 1 ] ) + this->offset_ ]++;
+        counts[ 2 * num_values + static_cast< int >( this->data_[ j + 2 ] ) + this->offset_ ]++;
+        counts[ 3 * num_values + static_cast< int >( this->data_[ j + 3 ] ) + this->offset_ ]++;
+      }
     }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
+    for ( ; j < end; j++ )
     {
-      if ( histogram[ j ] > 0 ) hist_end = j;
+      counts[ static_cast< int >( this->data_[ j ] ) + this->offset_ ]++;
     }
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
-    {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
-    }
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    for ( size_t k = 0; k < counts.size(); k++ ) this->counts_[ k % num_values ] += counts[ k ];
+  }
 
+  const T* data_;
+  int offset_;
+  std::vector< size_t > counts_;
+  boost::mutex mutex_;
+};
+
+// The binners all take the same arguments, so compute and update can construct the binner of
+// any type the same way. The bins of 8 and 16 bit types start at bin_start, the bins of the
+// other types start at min, as they always did. Each binner names only the start it uses.
+
+// Bins of 8 and 16 bit types are made from the table with the count of every value: bin j
+// holds the integers from ceil( bin_start + j * bin_size ) up to ceil( bin_start + ( j + 1 ) 
+// * bin_size ).
+template< class T >
+class SmallIntegerBinner
+{
+public:
+  SmallIntegerBinner( double /*min*/, double bin_start, double bin_size, size_t num_bins ) :
+    bin_start_( bin_start ), bin_size_( bin_size ), num_bins_( static_cast< int >( num_bins ) ) {}
 
-    this->min_ = static_cast<double>( hist_begin );
-    this->max_ = static_cast<double>( hist_end );
+  bool is_valid( T ) const { return true; }
 
-    this->bin_size_  = 1.0;
-    this->bin_start_ = this->min_ - 0.5;
+  size_t operator()( T value ) const
+  {
+    int val = static_cast< int >( value );
+    int bin = Clamp( static_cast< int >( ( val - this->bin_start_ ) / this->bin_size_ ), 
+      0, this->num_bins_ - 1 );
+    while ( bin > 0 && Ceil( this->bin_start_ + bin * this->bin_size_ ) > val ) bin--;
+    while ( bin + 1 < this->num_bins_ && 
+      Ceil( this->bin_start_ + ( bin + 1 ) * this->bin_size_ ) <= val ) bin++;
+    return static_cast< size_t >( bin );
+  }
 
-    this->histogram_.resize( hist_end + 1 - hist_begin );
+private:
+  double bin_start_;
+  double bin_size_;
+  int num_bins_;
+};
 
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
-    {
-      this->histogram_[ j ] = histogram[ j + hist_begin ];
-    }
+template< class T >
+class IntegerBinner
+{
+public:
+  IntegerBinner( double min, double /*bin_start*/, double bin_size, size_t num_bins ) :
+    min_( min ), inv_bin_size_( 1.0 / bin_size ), num_bins_( num_bins ) {}
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
+  bool is_valid( T ) const { return true; }
+
+  size_t operator()( T value ) const
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    size_t bin = static_cast< size_t >( ( static_cast< double >( value ) - this->min_ ) * 
+      this->inv_bin_size_ );
+    return bin < this->num_bins_ ? bin : this->num_bins_ - 1;
   }
-  
-  return true;  
-}
 
-bool Histogram::compute( const short* data, size_t size )
+private:
+  double min_;
+  double inv_bin_size_;
+  size_t num_bins_;
+};
+
+// Float data is binned in single precision
+class FloatBinner
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+public:
+  FloatBinner( double min, double /*bin_start*/, double bin_size, size_t num_bins ) :
+    min_( static_cast< float >( min ) ), 
+    inv_bin_size_( static_cast< float >( 1.0f / bin_size ) ), 
+    num_bins_( num_bins ) {}
 
-  try
+  bool is_valid( float value ) const { return IsFinite( value ); }
+
+  size_t operator()( float value ) const
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x10000 , 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) + 0x8000 ]++;
-    }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
-    {
-      if ( histogram[ j ] > 0 ) hist_end = j;
-    }
+    size_t bin = static_cast< size_t >( ( value - this->min_ ) * this->inv_bin_size_ );
+    return bin < this->num_bins_ ? bin : this->num_bins_ - 1;
+  }
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
-    {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
-    }
+private:
+  float min_;
+  float inv_bin_size_;
+  size_t num_bins_;
+};
 
-    this->min_ = static_cast<double>( hist_begin ) - static_cast<double>( 0x8000 );
-    this->max_ = static_cast<double>( hist_end ) - static_cast<double>( 0x8000 );
+class DoubleBinner
+{
+public:
+  DoubleBinner( double min, double /*bin_start*/, double bin_size, size_t num_bins ) :
+    min_( min ), inv_bin_size_( 1.0 / bin_size ), num_bins_( num_bins ) {}
 
-    size_t hist_length = hist_end + 1 - hist_begin;
-    if ( hist_length > 0x100 ) hist_length = 0x100;
-    
-    this->histogram_.resize( hist_length, 0 );
+  bool is_valid( double value ) const { return IsFinite( value ); }
 
-    if ( hist_length == 1 )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    else
-    {
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_length - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
-    {
-      double min_value = this->bin_start_ + j * this->bin_size_;
-      double max_value = this->bin_start_ + ( j + 1 ) * this->bin_size_;
+  size_t operator()( double value ) const
+  {
+    size_t bin = static_cast< size_t >( ( value - this->min_ ) * this->inv_bin_size_ );
+    return bin < this->num_bins_ ? bin : this->num_bins_ - 1;
+  }
 
-      for ( int k = Ceil( min_value ) ; k < Ceil( max_value ); k++ )
-      {
-        int idx = static_cast<int>( k ) + 0x8000;
-        if ( idx >= 0 && idx < static_cast<int>( histogram.size() ) ) 
-        {
-          this->histogram_[ j ] += histogram[ idx ];
-        }
-      }
-    }
+private:
+  double min_;
+  double inv_bin_size_;
+  size_t num_bins_;
+};
+
+template< class T > class HistogramBinner { public: typedef SmallIntegerBinner< T > type; };
+template<> class HistogramBinner< int > { public: typedef IntegerBinner< int > type; };
+template<> class HistogramBinner< unsigned int > { public: typedef IntegerBinner< unsigned int > type; };
+template<> class HistogramBinner< float > { public: typedef FloatBinner type; };
+template<> class HistogramBinner< double > { public: typedef DoubleBinner type; };
+
+// Adds the values of the data to the bins. Every range of the data is counted in a histogram
+// of its own and the histograms are added together at the end.
+template< class T >
+class BinCounter : public boost::noncopyable
+{
+public:
+  typedef typename HistogramBinner< T >::type binner_type;
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
+  BinCounter( const T* data, const binner_type& binner, size_t num_bins ) :
+    data_( data ), binner_( binner ), counts_( num_bins, 0 ) {}
+
+  void operator()( size_t begin, size_t end )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    std::vector< size_t > counts( this->counts_.size(), 0 );
+    for ( size_t j = begin; j < end; j++ )
+    {
+      T value = this->data_[ j ];
+      if ( this->binner_.is_valid( value ) ) counts[ this->binner_( value ) ]++;
+    }
+
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    for ( size_t k = 0; k < counts.size(); k++ ) this->counts_[ k ] += counts[ k ];
   }
-  
-  return true;  
-}
 
+  const T* data_;
+  binner_type binner_;
+  std::vector< size_t > counts_;
+  boost::mutex mutex_;
+};
 
-bool Histogram::compute( const unsigned short* data, size_t size )
+void Histogram::reset()
 {
   this->min_ = Core::Nan();
   this->max_ = Core::Nan();
   this->bin_start_ = Core::Nan();
   this->bin_size_ = Core::Nan();
   this->histogram_.resize( 0 );
+}
+
+void Histogram::update_bin_range()
+{
+  std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
+    boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
+  this->min_bin_ = (*min_max.first);
+  this->max_bin_ = (*min_max.second);
+}
+
+// For char and short data we do a single pass over the data: every value is counted in a 
+// table that covers the whole range of the type, which gives the min and max as well.
+template< class T >
+bool Histogram::compute_small_integer( const T* data, size_t size, int offset, size_t num_values )
+{
+  this->reset();
   if ( size == 0 ) return false;
 
   try
   {
-    std::vector<size_t> histogram;
-    histogram.resize( 0x10000 , 0 );
-    
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      histogram[ static_cast<int>( data[ j ] ) ]++;
-    }
-    
-    size_t hist_begin = 0;
-    size_t hist_end = 0;
-    
-    for ( size_t j = 0 ; j < histogram.size() ; j++ )
-    {
-      if ( histogram[ j ] > 0 ) hist_end = j;
-    }
+    ValueCounter< T > counter( data, offset, num_values );
+    RunOverRanges( size, counter );
+    const std::vector< size_t >& histogram = counter.counts_;
 
-    size_t hsize = histogram.size();
-    for ( size_t j = 0 ; j < hsize; j++ )
-    {
-      if ( histogram[ hsize - 1 - j ] > 0 ) hist_begin = hsize - 1 - j;
-    }
+    size_t hist_begin = 0;
+    while ( histogram[ hist_begin ] == 0 ) hist_begin++;
+    size_t hist_end = histogram.size() - 1;
+    while ( histogram[ hist_end ] == 0 ) hist_end--;
 
-    this->min_ = static_cast<double>( hist_begin );
-    this->max_ = static_cast<double>( hist_end );
+    this->min_ = static_cast<double>( hist_begin ) - static_cast<double>( offset );
+    this->max_ = static_cast<double>( hist_end ) - static_cast<double>( offset );
 
     size_t hist_length = hist_end + 1 - hist_begin;
-    if ( hist_length > 0x100 ) hist_length = 0x100;
+    if ( hist_length > HISTOGRAM_SIZE_C ) hist_length = HISTOGRAM_SIZE_C;
     
     this->histogram_.resize( hist_length, 0 );
 
     if ( hist_length == 1 )
     {
       this->bin_size_  = 1.0;
-      this->bin_start_ = min_ - ( this->bin_size_ * 0.5 );
+      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
     }
     else
     {
@@ -365,337 +350,229 @@ bool Histogram::compute( const unsigned short* data, size_t size )
       this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
     }
     
-    for ( size_t j = 0 ; j < histogram_.size() ; j++ )
+    if ( this->bin_size_ == 1.0 )
     {
-      double min_value = this->bin_start_ + j * this->bin_size_;
-      double max_value = this->bin_start_ + ( j + 1 ) * this->bin_size_;
-
-      for ( int k = Ceil( min_value ) ; k < Ceil( max_value ); k ++ )
+      std::copy( histogram.begin() + hist_begin, histogram.begin() + hist_end + 1, 
+        this->histogram_.begin() );
+    }
+    else
+    {
+      for ( size_t j = 0 ; j < this->histogram_.size() ; j++ )
       {
-        int idx = static_cast<int>( k );
-        if ( idx >= 0 && idx < static_cast<int>( histogram.size() ) ) 
+        double min_value = this->bin_start_ + j * this->bin_size_;
+        double max_value = this->bin_start_ + ( j + 1 ) * this->bin_size_;
+
+        for ( int k = Ceil( min_value ) ; k < Ceil( max_value ); k++ )
         {
-          this->histogram_[ j ] += histogram[ idx ];
+          int idx = k + offset;
+          if ( idx >= 0 && idx < static_cast<int>( histogram.size() ) ) 
+          {
+            this->histogram_[ j ] += histogram[ idx ];
+          }
         }
       }
     }
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+    this->update_bin_range();
   }
   catch( ... )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
+    this->reset();
     return false;
   }
   
-  return true;  
+  return true;
 }
 
-
-bool Histogram::compute( const int* data, size_t size )
+// For int and floating point data the min and max are computed first, after which the data
+// is added to the bins.
+template< class T >
+bool Histogram::compute_wide( const T* data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
+  this->reset();
   if ( size == 0 ) return false;
 
   try
   {
-    int int_min = data[ 0 ];
-    int int_max = data[ 0 ];
-
-    for ( size_t j = 1 ; j < size ; j++ )
+    double min, max;
+    if ( !DataBlockKernels::ComputeMinMax( data, GetDataType( const_cast< T* >( data ) ), 
+      size, min, max ) )
     {
-      if ( data[ j ] < int_min ) int_min = data[ j ];
-      if ( data[ j ] > int_max ) int_max = data[ j ];
+      // Most likely all the data is NaN
+      this->reset();
+      return false;
     }
-    
-    this->min_ = static_cast<double>( int_min );
-    this->max_ = static_cast<double>( int_max );
 
+    this->min_ = min;
+    this->max_ = max;
+
+    size_t hist_size = HISTOGRAM_SIZE_C;
     if ( this->min_ == this->max_ )
     {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
+      hist_size = 1;
+      this->bin_size_ = 1.0;
     }
-    else if ( ( this->max_ - this->min_ ) < 256.0 )
+    else if ( std::numeric_limits< T >::is_integer && ( this->max_ - this->min_ ) < 256.0 )
     {
-      size_t hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
-      this->histogram_.resize( hist_size, 0 );
+      hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
       this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
     }
     else
     {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
       this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
     }
+    this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
 
-    double inv_bin_size = 1.0 / this->bin_size_;
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      size_t idx = static_cast<size_t>( ( static_cast<double>( data[j] ) - 
-        this->min_ ) * inv_bin_size );
-      this->histogram_[ idx ]++;
-    }
+    typedef typename HistogramBinner< T >::type binner_type;
+    BinCounter< T > counter( data, binner_type( this->min_, this->bin_start_, this->bin_size_, 
+      hist_size ), hist_size );
+    RunOverRanges( size, counter );
+    this->histogram_.swap( counter.counts_ );
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+    this->update_bin_range();
   }
   catch( ... )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
+    this->reset();
     return false;
   }
   
   return true;
 }
 
-
-bool Histogram::compute( const unsigned int* data, size_t size )
+template< class T >
+bool Histogram::update_internal( const T* old_data, const T* new_data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  if ( !this->is_valid() || this->histogram_.empty() ) return false;
+  if ( size == 0 ) return true;
 
-  try
+  // New values outside of the current range change all the bins
+  double new_min, new_max;
+  if ( DataBlockKernels::ComputeMinMax( new_data, GetDataType( const_cast< T* >( new_data ) ), 
+    size, new_min, new_max ) && ( new_min < this->min_ || new_max > this->max_ ) )
   {
-    unsigned int int_min = data[ 0 ];
-    unsigned int int_max = data[ 0 ];
-
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      if ( data[ j ] < int_min ) int_min = data[ j ];
-      if ( data[ j ] > int_max ) int_max = data[ j ];
-    }
-    
-    this->min_ = static_cast<double>( int_min );
-    this->max_ = static_cast<double>( int_max );
-
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else if ( ( this->max_ - this->min_ ) < 256.0 )
-    {
-      size_t hist_size = static_cast<size_t>( this->max_ - this->min_ ) + 1;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
+    return false;
+  }
 
-    double inv_bin_size = 1.0 / this->bin_size_;
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      size_t idx = static_cast<size_t>( ( static_cast<double>( data[j] ) - this->min_ ) * inv_bin_size );
-      this->histogram_[ idx ]++;
-    }
+  typedef typename HistogramBinner< T >::type binner_type;
+  binner_type binner( this->min_, this->bin_start_, this->bin_size_, this->histogram_.size() );
+  std::vector< size_t > histogram( this->histogram_ );
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
+  size_t removed_min = 0;
+  size_t removed_max = 0;
+  for ( size_t j = 0; j < size; j++ )
+  {
+    T value = old_data[ j ];
+    if ( !binner.is_valid( value ) ) continue;
+    // The histogram does not match the old data
+    if ( value < this->min_ || value > this->max_ ) return false;
+    size_t bin = binner( value );
+    if ( histogram[ bin ] == 0 ) return false;
+    histogram[ bin ]--;
+    if ( value == this->min_ ) removed_min++;
+    if ( value == this->max_ ) removed_max++;
   }
-  catch( ... )
+
+  size_t added_min = 0;
+  size_t added_max = 0;
+  for ( size_t j = 0; j < size; j++ )
   {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
+    T value = new_data[ j ];
+    if ( !binner.is_valid( value ) ) continue;
+    histogram[ binner( value ) ]++;
+    if ( value == this->min_ ) added_min++;
+    if ( value == this->max_ ) added_max++;
   }
-  
+
+  // If values at the ends of the range were removed, the range may have become smaller. This
+  // can only be checked if every bin holds a single value.
+  bool single_values = std::numeric_limits< T >::is_integer && this->bin_size_ == 1.0;
+  if ( removed_min > added_min && !( single_values && histogram.front() > 0 ) ) return false;
+  if ( removed_max > added_max && !( single_values && histogram.back() > 0 ) ) return false;
+
+  this->histogram_.swap( histogram );
+  this->update_bin_range();
   return true;
 }
 
-
-bool Histogram::compute( const float* data, size_t size )
+bool Histogram::compute( const signed char* data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  return this->compute_small_integer( data, size, 0x80, 0x100 );
+}
 
-  try
-  {
-    float float_min = std::numeric_limits<float>::max();
-    float float_max = std::numeric_limits<float>::min();
+bool Histogram::compute( const unsigned char* data, size_t size )
+{
+  return this->compute_small_integer( data, size, 0, 0x100 );
+}
 
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      float val = data[ j ];
-      if ( ! Core::IsFinite( val ) ) continue;
-      if ( val < float_min ) float_min = val;
-      if ( val > float_max ) float_max = val;
-    }
-    
-    if ( float_min > float_max )
-    {
-      // Most likely all the data is NaN
-      this->min_ = Core::Nan();
-      this->max_ = Core::Nan();
-      this->bin_start_ = Core::Nan();
-      this->bin_size_ = Core::Nan();
-      this->histogram_.resize( 0 );
-      return false;   
-    }
-    
-    this->min_ = static_cast<double>( float_min );
-    this->max_ = static_cast<double>( float_max );
+bool Histogram::compute( const short* data, size_t size )
+{
+  return this->compute_small_integer( data, size, 0x8000, 0x10000 );
+}
 
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
+bool Histogram::compute( const unsigned short* data, size_t size )
+{
+  return this->compute_small_integer( data, size, 0, 0x10000 );
+}
 
-    float inv_bin_size = static_cast< float >( 1.0f / this->bin_size_ );
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      float val = data[ j ];
-      if ( Core::IsFinite( val ) )
-      {
-        size_t idx = static_cast<size_t>( ( val - float_min ) * inv_bin_size );
-        this->histogram_[ idx ]++;
-      }
-    }
+bool Histogram::compute( const int* data, size_t size )
+{
+  return this->compute_wide( data, size );
+}
 
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;
+bool Histogram::compute( const unsigned int* data, size_t size )
+{
+  return this->compute_wide( data, size );
 }
 
+bool Histogram::compute( const float* data, size_t size )
+{
+  return this->compute_wide( data, size );
+}
 
 bool Histogram::compute( const double* data, size_t size )
 {
-  this->min_ = Core::Nan();
-  this->max_ = Core::Nan();
-  this->bin_start_ = Core::Nan();
-  this->bin_size_ = Core::Nan();
-  this->histogram_.resize( 0 );
-  if ( size == 0 ) return false;
+  return this->compute_wide( data, size );
+}
 
-  try
-  {
-    this->min_ = std::numeric_limits<double>::max();
-    this->max_ = std::numeric_limits<double>::min();
+bool Histogram::update( const signed char* old_data, const signed char* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
 
-    for ( size_t j = 0 ; j < size ; j++ )
-    {
-      double val = data[ j ];
-      if ( ! Core::IsFinite( val ) ) continue;
-      if ( val < this->min_ ) this->min_ = val;
-      if ( val > this->max_ ) this->max_ = val;
-    }
-    
-    if ( this->min_ > this->max_ )
-    {
-      // Most likely all the data is NaN
-      this->min_ = Core::Nan();
-      this->max_ = Core::Nan();
-      this->bin_start_ = Core::Nan();
-      this->bin_size_ = Core::Nan();
-      this->histogram_.resize( 0 );
-      return false;   
-    }
-      
-    if ( this->min_ == this->max_ )
-    {
-      this->bin_size_  = 1.0;
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );
-      this->histogram_.resize( 1, 0 );
-    }
-    else
-    {
-      size_t hist_size = 0x100;
-      this->histogram_.resize( hist_size, 0 );
-      this->bin_size_ = ( this->max_ - this->min_ ) / static_cast<double>( hist_size - 1 );
-      this->bin_start_ = this->min_ - ( this->bin_size_ * 0.5 );  
-    }
+bool Histogram::update( const unsigned char* old_data, const unsigned char* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
 
-    double inv_bin_size = 1.0 / bin_size_;
+bool Histogram::update( const short* old_data, const short* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
 
+bool Histogram::update( const unsigned short* old_data, const unsigned short* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
 
-    for ( size_t j = 1 ; j < size ; j++ )
-    {
-      double val = data[ j ];
-      if ( Core::IsFinite( val ) )
-      {
-        size_t idx = static_cast<size_t>( ( val - this->min_ ) * inv_bin_size );
-        this->histogram_[ idx ]++;
-      }   
-    }
-    
-    std::pair< std::vector<size_t>::iterator, std::vector<size_t>::iterator > min_max = 
-      boost::minmax_element( this->histogram_.begin(), this->histogram_.end() );
-    this->min_bin_ = (*min_max.first);
-    this->max_bin_ = (*min_max.second);
-  }
-  catch( ... )
-  {
-    this->min_ = Core::Nan();
-    this->max_ = Core::Nan();
-    this->bin_start_ = Core::Nan();
-    this->bin_size_ = Core::Nan();
-    this->histogram_.resize( 0 );
-    return false;
-  }
-  
-  return true;  
+bool Histogram::update( const int* old_data, const int* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
+
+bool Histogram::update( const unsigned int* old_data, const unsigned int* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
+
+bool Histogram::update( const float* old_data, const float* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
+}
+
+bool Histogram::update( const double* old_data, const double* new_data, size_t size )
+{
+  return this->update_internal( old_data, new_data, size );
 }
 
 double Histogram::get_min() const
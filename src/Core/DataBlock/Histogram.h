@@ -66,6 +66,20 @@ public:
   bool compute( const unsigned int* data, size_t size );
   bool compute( const float* data, size_t size );
   bool compute( const double* data, size_t size );
+
+  // UPDATE:
+  /// Update the histogram for size values of the data that changed from old_data into 
+  /// new_data, e.g. after inserting a slice, without going over the rest of the data. 
+  /// Returns false and leaves the histogram unchanged if the range of the data may have 
+  /// changed, in which case it needs to be computed again over all the data.
+  bool update( const signed char* old_data, const signed char* new_data, size_t size );
+  bool update( const unsigned char* old_data, const unsigned char* new_data, size_t size );
+  bool update( const short* old_data, const short* new_data, size_t size );
+  bool update( const unsigned short* old_data, const unsigned short* new_data, size_t size );
+  bool update( const int* old_data, const int* new_data, size_t size );
+  bool update( const unsigned int* old_data, const unsigned int* new_data, size_t size );
+  bool update( const float* old_data, const float* new_data, size_t size );
+  bool update( const double* old_data, const double* new_data, size_t size );
   
   // GET_MIN:
   /// Get the minimum value of the data
@@ -112,6 +126,29 @@ public:
   bool is_valid() const;
         
 private:
+  // RESET:
+  /// Mark the histogram as invalid
+  void reset();
+
+  // UPDATE_BIN_RANGE:
+  /// Compute the smallest and largest bin
+  void update_bin_range();
+
+  // COMPUTE_SMALL_INTEGER:
+  /// Compute the histogram of 8 and 16 bit data from a count of every value
+  template< class T >
+  bool compute_small_integer( const T* data, size_t size, int offset, size_t num_values );
+
+  // COMPUTE_WIDE:
+  /// Compute the histogram of 32 bit and floating point data
+  template< class T >
+  bool compute_wide( const T* data, size_t size );
+
+  // UPDATE_INTERNAL:
+  /// Implementation of update for every data type
+  template< class T >
+  bool update_internal( const T* old_data, const T* new_data, size_t size );
+
   friend std::string ExportToString( const Histogram& value );
   friend bool ImportFromString( const std::string& str, Histogram& value );
   
@@ -0,0 +1,679 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+// Boost includes
+#include <boost/bind.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/DataBlock/DataBlockLocks.h>
+#include <Core/DataBlock/MaskComponents.h>
+
+namespace Core
+{
+
+// Number of rows processed by one task of the thread pool
+static const size_t ROW_GRAIN_C = 64;
+
+//////////////////////////////////////////////////////////////////////////
+// Class MaskRegionConstraint
+//////////////////////////////////////////////////////////////////////////
+
+template< class T >
+static bool InRange( const void* data, size_t index, double min, double max )
+{
+  T value = static_cast< const T* >( data )[ index ];
+  return value >= min && value <= max;
+}
+
+MaskRegionConstraint::MaskRegionConstraint() :
+  data_( 0 ),
+  in_range_( 0 ),
+  min_( 0.0 ),
+  max_( 0.0 ),
+  negate_data_( false )
+{
+}
+
+void MaskRegionConstraint::set_data_range( DataBlockHandle data, double min, double max, 
+  bool negate )
+{
+  this->data_block_.reset();
+  if ( !data ) return;
+
+  switch ( data->get_data_type() )
+  {
+  case DataType::CHAR_E: this->in_range_ = &InRange< signed char >; break;
+  case DataType::UCHAR_E: this->in_range_ = &InRange< unsigned char >; break;
+  case DataType::SHORT_E: this->in_range_ = &InRange< short >; break;
+  case DataType::USHORT_E: this->in_range_ = &InRange< unsigned short >; break;
+  case DataType::INT_E: this->in_range_ = &InRange< int >; break;
+  case DataType::UINT_E: this->in_range_ = &InRange< unsigned int >; break;
+  case DataType::FLOAT_E: this->in_range_ = &InRange< float >; break;
+  case DataType::DOUBLE_E: this->in_range_ = &InRange< double >; break;
+  default: return;
+  }
+
+  this->data_block_ = data;
+  this->data_ = data->get_data();
+  this->min_ = min;
+  this->max_ = max;
+  this->negate_data_ = negate;
+}
+
+void MaskRegionConstraint::add_mask( MaskDataBlockHandle mask, bool negate )
+{
+  if ( !mask ) return;
+  this->masks_.push_back( mask );
+  this->negate_masks_.push_back( negate );
+}
+
+bool MaskRegionConstraint::has_size( size_t nx, size_t ny, size_t nz ) const
+{
+  if ( this->data_block_ && ( this->data_block_->get_nx() != nx || 
+    this->data_block_->get_ny() != ny || this->data_block_->get_nz() != nz ) ) return false;
+
+  for ( size_t j = 0; j < this->masks_.size(); j++ )
+  {
+    if ( this->masks_[ j ]->get_nx() != nx || this->masks_[ j ]->get_ny() != ny || 
+      this->masks_[ j ]->get_nz() != nz ) return false;
+  }
+  return true;
+}
+
+std::vector< DataBlock::mutex_type* > MaskRegionConstraint::get_mutexes() const
+{
+  std::vector< DataBlock::mutex_type* > mutexes;
+  if ( this->data_block_ ) mutexes.push_back( &this->data_block_->get_mutex() );
+  for ( size_t j = 0; j < this->masks_.size(); j++ )
+  {
+    mutexes.push_back( &this->masks_[ j ]->get_mutex() );
+  }
+  return mutexes;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class MaskComponentsPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class MaskComponentsPrivate
+{
+public:
+  MaskComponentsPrivate() :
+    nx_( 0 ),
+    ny_( 0 ),
+    nz_( 0 ),
+    mask_data_( 0 ),
+    mask_value_( 0 ),
+    constraint_( 0 )
+  {
+  }
+
+  // IS_INSIDE:
+  // Whether the voxel is part of a component
+  bool is_inside( size_t index ) const
+  {
+    return ( this->mask_data_[ index ] & this->mask_value_ ) && 
+      ( this->constraint_->is_empty() || this->constraint_->is_inside( index ) );
+  }
+
+  // COUNT_RUNS_RANGE:
+  // Count the runs of voxels inside the components in the rows [ begin, end )
+  void count_runs_range( size_t* counts, size_t begin, size_t end );
+
+  // FIND_RUNS_RANGE:
+  // Store the runs of the rows [ begin, end ) from row_offsets_[ row ] onwards
+  void find_runs_range( size_t begin, size_t end );
+
+  // MERGE_RUNS_RANGE:
+  // Join the runs of the rows [ begin, end ) with the runs that they touch in the previous
+  // row and slice
+  void merge_runs_range( std::atomic< size_t >* parents, size_t begin, size_t end );
+
+  // MERGE_ROWS:
+  // Join the overlapping runs of two rows
+  void merge_rows( std::atomic< size_t >* parents, size_t row1, size_t row2 );
+
+  // RESOLVE_RANGE:
+  // Store the root of the runs [ begin, end ) in run_components_
+  void resolve_range( std::atomic< size_t >* parents, size_t begin, size_t end );
+
+  // FILL_MASK_RANGE:
+  // Write the selected components into the rows [ begin, end ) of a mask
+  void fill_mask_range( const std::vector< bool >* selected, unsigned char* data, 
+    unsigned char value, size_t begin, size_t end ) const;
+
+  // FILL_DATA_RANGE:
+  // Write the values of the components into the rows [ begin, end ) of a data block
+  template< class T >
+  void fill_data_range( const std::vector< double >* values, T* data, size_t begin, 
+    size_t end ) const;
+
+  // FIND_ROOT:
+  // Find the run that represents the set of a run, halving the path on the way
+  static size_t FindRoot( std::atomic< size_t >* parents, size_t run );
+
+  // UNITE:
+  // Join the sets of two runs. The root with the larger index is linked to the other one, so
+  // the root of a set is always its first run.
+  static void Unite( std::atomic< size_t >* parents, size_t run1, size_t run2 );
+
+  bool check_abort() const
+  {
+    return this->check_abort_ && this->check_abort_();
+  }
+
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+
+  // The runs of each row are run_starts_/run_ends_[ row_offsets_[ row ] .. row_offsets_[ row + 1 ] ), 
+  // the ends are exclusive
+  std::vector< size_t > row_offsets_;
+  std::vector< unsigned int > run_starts_;
+  std::vector< unsigned int > run_ends_;
+  std::vector< size_t > run_components_;
+  std::vector< size_t > component_sizes_;
+
+  boost::function< bool () > check_abort_;
+
+  // Only valid during compute
+  const unsigned char* mask_data_;
+  unsigned char mask_value_;
+  const MaskRegionConstraint* constraint_;
+};
+
+void MaskComponentsPrivate::count_runs_range( size_t* counts, size_t begin, size_t end )
+{
+  for ( size_t row = begin; row < end; row++ )
+  {
+    size_t index = row * this->nx_;
+    size_t count = 0;
+    bool previous = false;
+    for ( size_t x = 0; x < this->nx_; x++, index++ )
+    {
+      bool inside = this->is_inside( index );
+      if ( inside && !previous ) count++;
+      previous = inside;
+    }
+    counts[ row ] = count;
+  }
+}
+
+void MaskComponentsPrivate::find_runs_range( size_t begin, size_t end )
+{
+  for ( size_t row = begin; row < end; row++ )
+  {
+    size_t index = row * this->nx_;
+    size_t run = this->row_offsets_[ row ];
+    bool previous = false;
+    for ( size_t x = 0; x < this->nx_; x++, index++ )
+    {
+      bool inside = this->is_inside( index );
+      if ( inside && !previous ) this->run_starts_[ run ] = static_cast< unsigned int >( x );
+      if ( !inside && previous ) this->run_ends_[ run++ ] = static_cast< unsigned int >( x );
+      previous = inside;
+    }
+    if ( previous ) this->run_ends_[ run ] = static_cast< unsigned int >( this->nx_ );
+  }
+}
+
+size_t MaskComponentsPrivate::FindRoot( std::atomic< size_t >* parents, size_t run )
+{
+  while ( true )
+  {
+    size_t parent = parents[ run ].load();
+    if ( parent == run ) return run;
+    size_t grand_parent = parents[ parent ].load();
+    if ( grand_parent != parent ) parents[ run ].compare_exchange_weak( parent, grand_parent );
+    run = grand_parent;
+  }
+}
+
+void MaskComponentsPrivate::Unite( std::atomic< size_t >* parents, size_t run1, size_t run2 )
+{
+  while ( true )
+  {
+    run1 = FindRoot( parents, run1 );
+    run2 = FindRoot( parents, run2 );
+    if ( run1 == run2 ) return;
+    if ( run1 < run2 ) std::swap( run1, run2 );
+
+    // Another thread may have linked run1 in the mean time, in which case we start over
+    size_t expected = run1;
+    if ( parents[ run1 ].compare_exchange_strong( expected, run2 ) ) return;
+  }
+}
+
+void MaskComponentsPrivate::merge_rows( std::atomic< size_t >* parents, size_t row1, 
+  size_t row2 )
+{
+  size_t run1 = this->row_offsets_[ row1 ];
+  size_t end1 = this->row_offsets_[ row1 + 1 ];
+  size_t run2 = this->row_offsets_[ row2 ];
+  size_t end2 = this->row_offsets_[ row2 + 1 ];
+
+  while ( run1 < end1 && run2 < end2 )
+  {
+    if ( this->run_starts_[ run1 ] < this->run_ends_[ run2 ] && 
+      this->run_starts_[ run2 ] < this->run_ends_[ run1 ] )
+    {
+      Unite( parents, run1, run2 );
+    }
+    if ( this->run_ends_[ run1 ] < this->run_ends_[ run2 ] ) run1++;
+    else run2++;
+  }
+}
+
+void MaskComponentsPrivate::merge_runs_range( std::atomic< size_t >* parents, size_t begin, 
+  size_t end )
+{
+  for ( size_t row = begin; row < end; row++ )
+  {
+    if ( row % this->ny_ != 0 ) this->merge_rows( parents, row, row - 1 );
+    if ( row >= this->ny_ ) this->merge_rows( parents, row, row - this->ny_ );
+  }
+}
+
+void MaskComponentsPrivate::resolve_range( std::atomic< size_t >* parents, size_t begin, 
+  size_t end )
+{
+  for ( size_t run = begin; run < end; run++ )
+  {
+    this->run_components_[ run ] = FindRoot( parents, run );
+  }
+}
+
+void MaskComponentsPrivate::fill_mask_range( const std::vector< bool >* selected, 
+  unsigned char* data, unsigned char value, size_t begin, size_t end ) const
+{
+  unsigned char not_value = ~value;
+  for ( size_t row = begin; row < end; row++ )
+  {
+    unsigned char* row_data = data + row * this->nx_;
+    for ( size_t x = 0; x < this->nx_; x++ ) row_data[ x ] &= not_value;
+
+    for ( size_t run = this->row_offsets_[ row ]; run < this->row_offsets_[ row + 1 ]; run++ )
+    {
+      if ( !( *selected )[ this->run_components_[ run ] ] ) continue;
+      for ( size_t x = this->run_starts_[ run ]; x < this->run_ends_[ run ]; x++ )
+      {
+        row_data[ x ] |= value;
+      }
+    }
+  }
+}
+
+template< class T >
+void MaskComponentsPrivate::fill_data_range( const std::vector< double >* values, T* data, 
+  size_t begin, size_t end ) const
+{
+  for ( size_t row = begin; row < end; row++ )
+  {
+    T* row_data = data + row * this->nx_;
+    std::fill( row_data, row_data + this->nx_, T( 0 ) );
+
+    for ( size_t run = this->row_offsets_[ row ]; run < this->row_offsets_[ row + 1 ]; run++ )
+    {
+      T value = static_cast< T >( ( *values )[ this->run_components_[ run ] ] );
+      std::fill( row_data + this->run_starts_[ run ], row_data + this->run_ends_[ run ], 
+        value );
+    }
+  }
+}
+
+// Calls fill_data_range with the data block as an array of its actual type
+class MaskComponentsFillData
+{
+public:
+  MaskComponentsFillData( const MaskComponentsPrivate* components, 
+    const std::vector< double >& values ) :
+    components_( components ),
+    values_( values )
+  {
+  }
+
+  template< class T >
+  void operator()( T* data, size_t /*size*/ )
+  {
+    size_t num_rows = this->components_->ny_ * this->components_->nz_;
+    ThreadPool::Instance()->parallel_for( 0, num_rows, ROW_GRAIN_C, boost::bind( 
+      &MaskComponentsPrivate::fill_data_range< T >, this->components_, &this->values_, 
+      data, _1, _2 ) );
+  }
+
+private:
+  const MaskComponentsPrivate* components_;
+  const std::vector< double >& values_;
+};
+
+// Whether a voxel still needs to change and the flood fill is allowed to use it
+class MaskFloodFillCondition
+{
+public:
+  MaskFloodFillCondition( const unsigned char* data, unsigned char target_value, 
+    unsigned char value, const MaskRegionConstraint& constraint ) :
+    data_( data ),
+    target_value_( target_value ),
+    value_( value ),
+    constrained_( !constraint.is_empty() ),
+    constraint_( constraint )
+  {
+  }
+
+  bool operator()( size_t index ) const
+  {
+    return ( this->data_[ index ] & this->value_ ) == this->target_value_ && 
+      ( !this->constrained_ || this->constraint_.is_inside( index ) );
+  }
+
+private:
+  const unsigned char* data_;
+  unsigned char target_value_;
+  unsigned char value_;
+  bool constrained_;
+  const MaskRegionConstraint& constraint_;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Class MaskComponents
+//////////////////////////////////////////////////////////////////////////
+
+const size_t MaskComponents::NO_COMPONENT_C = std::numeric_limits< size_t >::max();
+
+MaskComponents::MaskComponents() :
+  private_( new MaskComponentsPrivate )
+{
+}
+
+MaskComponents::~MaskComponents()
+{
+}
+
+void MaskComponents::set_abort_function( boost::function< bool () > check_abort )
+{
+  this->private_->check_abort_ = check_abort;
+}
+
+bool MaskComponents::compute( MaskDataBlockHandle mask, const MaskRegionConstraint& constraint )
+{
+  MaskComponentsPrivate* p = this->private_.get();
+  p->nx_ = mask->get_nx();
+  p->ny_ = mask->get_ny();
+  p->nz_ = mask->get_nz();
+  p->row_offsets_.clear();
+  p->run_starts_.clear();
+  p->run_ends_.clear();
+  p->run_components_.clear();
+  p->component_sizes_.clear();
+
+  if ( !constraint.has_size( p->nx_, p->ny_, p->nz_ ) ) return false;
+
+  std::vector< DataBlock::mutex_type* > read_mutexes = constraint.get_mutexes();
+  read_mutexes.push_back( &mask->get_mutex() );
+  DataBlockLocks locks( 0, read_mutexes );
+
+  p->mask_data_ = mask->get_mask_data();
+  p->mask_value_ = mask->get_mask_value();
+  p->constraint_ = &constraint;
+
+  ThreadPool* pool = ThreadPool::Instance();
+  size_t num_rows = p->ny_ * p->nz_;
+
+  try
+  {
+    // Find the runs in two passes, so they can be stored in one array in raster order
+    p->row_offsets_.resize( num_rows + 1, 0 );
+    pool->parallel_for( 0, num_rows, ROW_GRAIN_C, boost::bind( 
+      &MaskComponentsPrivate::count_runs_range, p, &p->row_offsets_[ 1 ], _1, _2 ) );
+    for ( size_t row = 0; row < num_rows; row++ )
+    {
+      p->row_offsets_[ row + 1 ] += p->row_offsets_[ row ];
+    }
+    if ( p->check_abort() ) return false;
+
+    size_t num_runs = p->row_offsets_[ num_rows ];
+    p->run_starts_.resize( num_runs );
+    p->run_ends_.resize( num_runs );
+    pool->parallel_for( 0, num_rows, ROW_GRAIN_C, boost::bind( 
+      &MaskComponentsPrivate::find_runs_range, p, _1, _2 ) );
+    if ( p->check_abort() ) return false;
+
+    std::vector< std::atomic< size_t > > parents( num_runs );
+    for ( size_t run = 0; run < num_runs; run++ ) parents[ run ].store( run );
+
+    std::atomic< size_t >* parents_ptr = num_runs ? &parents[ 0 ] : 0;
+    pool->parallel_for( 0, num_rows, ROW_GRAIN_C, boost::bind( 
+      &MaskComponentsPrivate::merge_runs_range, p, parents_ptr, _1, _2 ) );
+    if ( p->check_abort() ) return false;
+
+    p->run_components_.resize( num_runs );
+    pool->parallel_for( 0, num_runs, ROW_GRAIN_C * 64, boost::bind( 
+      &MaskComponentsPrivate::resolve_range, p, parents_ptr, _1, _2 ) );
+
+    // The root of a set is its first run, so numbering the roots in order numbers the 
+    // components in the order of their first voxel
+    for ( size_t run = 0; run < num_runs; run++ )
+    {
+      size_t root = p->run_components_[ run ];
+      if ( root == run )
+      {
+        p->run_components_[ run ] = p->component_sizes_.size();
+        p->component_sizes_.push_back( 0 );
+      }
+      else
+      {
+        p->run_components_[ run ] = p->run_components_[ root ];
+      }
+      p->component_sizes_[ p->run_components_[ run ] ] += p->run_ends_[ run ] - 
+        p->run_starts_[ run ];
+    }
+  }
+  catch ( std::bad_alloc& )
+  {
+    p->row_offsets_.clear();
+    return false;
+  }
+
+  p->mask_data_ = 0;
+  p->constraint_ = 0;
+
+  return true;
+}
+
+size_t MaskComponents::get_num_components() const
+{
+  return this->private_->component_sizes_.size();
+}
+
+const std::vector< size_t >& MaskComponents::get_component_sizes() const
+{
+  return this->private_->component_sizes_;
+}
+
+size_t MaskComponents::get_component( size_t index ) const
+{
+  const MaskComponentsPrivate* p = this->private_.get();
+  size_t row = index / p->nx_;
+  if ( row + 1 >= p->row_offsets_.size() ) return NO_COMPONENT_C;
+  unsigned int x = static_cast< unsigned int >( index % p->nx_ );
+
+  // Find the last run that starts at or before x
+  std::vector< unsigned int >::const_iterator begin = 
+    p->run_starts_.begin() + p->row_offsets_[ row ];
+  std::vector< unsigned int >::const_iterator end = 
+    p->run_starts_.begin() + p->row_offsets_[ row + 1 ];
+  std::vector< unsigned int >::const_iterator it = std::upper_bound( begin, end, x );
+  if ( it == begin ) return NO_COMPONENT_C;
+
+  size_t run = ( it - p->run_starts_.begin() ) - 1;
+  if ( x >= p->run_ends_[ run ] ) return NO_COMPONENT_C;
+  return p->run_components_[ run ];
+}
+
+bool MaskComponents::select_components( const MaskRegionConstraint& region, 
+  std::vector< bool >& selected ) const
+{
+  const MaskComponentsPrivate* p = this->private_.get();
+  if ( !region.has_size( p->nx_, p->ny_, p->nz_ ) ) return false;
+  selected.resize( std::max( selected.size(), p->component_sizes_.size() ), false );
+
+  DataBlockLocks locks( 0, region.get_mutexes() );
+  size_t num_rows = p->row_offsets_.empty() ? 0 : p->row_offsets_.size() - 1;
+  for ( size_t row = 0; row < num_rows; row++ )
+  {
+    for ( size_t run = p->row_offsets_[ row ]; run < p->row_offsets_[ row + 1 ]; run++ )
+    {
+      size_t component = p->run_components_[ run ];
+      if ( selected[ component ] ) continue;
+      for ( size_t x = p->run_starts_[ run ]; x < p->run_ends_[ run ]; x++ )
+      {
+        if ( region.is_inside( row * p->nx_ + x ) )
+        {
+          selected[ component ] = true;
+          break;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool MaskComponents::fill_mask( const std::vector< bool >& selected, 
+  MaskDataBlockHandle dst ) const
+{
+  const MaskComponentsPrivate* p = this->private_.get();
+  if ( dst->get_nx() != p->nx_ || dst->get_ny() != p->ny_ || dst->get_nz() != p->nz_ ||
+    selected.size() < p->component_sizes_.size() ) return false;
+
+  DataBlockLocks locks( dst, MaskDataBlockHandle() );
+  unsigned char* data = dst->get_mask_data();
+  unsigned char value = dst->get_mask_value();
+  ThreadPool::Instance()->parallel_for( 0, p->ny_ * p->nz_, ROW_GRAIN_C, boost::bind( 
+    &MaskComponentsPrivate::fill_mask_range, p, &selected, data, value, _1, _2 ) );
+  dst->increase_generation();
+  return true;
+}
+
+bool MaskComponents::fill_data( const std::vector< double >& values, DataBlockHandle dst ) const
+{
+  const MaskComponentsPrivate* p = this->private_.get();
+  if ( dst->get_nx() != p->nx_ || dst->get_ny() != p->ny_ || dst->get_nz() != p->nz_ ||
+    values.size() < p->component_sizes_.size() ) return false;
+
+  DataBlock::lock_type lock( dst->get_mutex() );
+  MaskComponentsFillData functor( p, values );
+  if ( !dst->visit( functor ) ) return false;
+  dst->increase_generation();
+  return true;
+}
+
+bool MaskComponents::FloodFill( MaskDataBlockHandle mask, const std::vector< size_t >& seeds,
+  bool erase, const MaskRegionConstraint& constraint )
+{
+  const size_t nx = mask->get_nx();
+  const size_t ny = mask->get_ny();
+  const size_t nz = mask->get_nz();
+  if ( !constraint.has_size( nx, ny, nz ) ) return false;
+
+  bool changed = false;
+  {
+    DataBlockLocks locks( &mask->get_mutex(), constraint.get_mutexes() );
+
+    unsigned char* data = mask->get_mask_data();
+    const unsigned char value = mask->get_mask_value();
+    const unsigned char not_value = ~value;
+    const unsigned char target_value = erase ? value : 0;
+    const size_t size = nx * ny * nz;
+
+    MaskFloodFillCondition can_fill( data, target_value, value, constraint );
+
+    // Every entry is a voxel from which the fill continues along its row
+    std::vector< size_t > stack;
+    for ( size_t j = 0; j < seeds.size(); j++ )
+    {
+      if ( seeds[ j ] < size ) stack.push_back( seeds[ j ] );
+    }
+
+    while ( !stack.empty() )
+    {
+      size_t index = stack.back();
+      stack.pop_back();
+      if ( !can_fill( index ) ) continue;
+
+      // Extend the span to both sides and fill it
+      size_t row = index / nx;
+      size_t row_start = row * nx;
+      size_t x0 = index - row_start;
+      size_t x1 = x0;
+      while ( x0 > 0 && can_fill( row_start + x0 - 1 ) ) x0--;
+      while ( x1 + 1 < nx && can_fill( row_start + x1 + 1 ) ) x1++;
+
+      for ( size_t x = x0; x <= x1; x++ )
+      {
+        if ( erase ) data[ row_start + x ] &= not_value;
+        else data[ row_start + x ] |= value;
+      }
+      changed = true;
+
+      // Add one seed for each piece of the four neighboring rows that can be filled
+      size_t y = row % ny;
+      size_t z = row / ny;
+      size_t neighbors[ 4 ];
+      size_t num_neighbors = 0;
+      if ( y > 0 ) neighbors[ num_neighbors++ ] = row - 1;
+      if ( y + 1 < ny ) neighbors[ num_neighbors++ ] = row + 1;
+      if ( z > 0 ) neighbors[ num_neighbors++ ] = row - ny;
+      if ( z + 1 < nz ) neighbors[ num_neighbors++ ] = row + ny;
+
+      for ( size_t j = 0; j < num_neighbors; j++ )
+      {
+        size_t neighbor_start = neighbors[ j ] * nx;
+        bool previous = false;
+        for ( size_t x = x0; x <= x1; x++ )
+        {
+          bool fill = can_fill( neighbor_start + x );
+          if ( fill && !previous ) stack.push_back( neighbor_start + x );
+          previous = fill;
+        }
+      }
+    }
+
+    if ( changed ) mask->increase_generation();
+  }
+
+  if ( changed ) mask->mask_updated_signal_();
+  return true;
+}
+
+} // end namespace Core
@@ -0,0 +1,189 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_MASKCOMPONENTS_H
+#define CORE_DATABLOCK_MASKCOMPONENTS_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <limits>
+#include <vector>
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+
+namespace Core
+{
+
+// CLASS MaskRegionConstraint:
+/// The voxels that a flood fill or a connected component labelling may use: the voxels where
+/// the data lies within a range and that are inside a number of masks. Each condition can be
+/// negated. Without any conditions all voxels are inside.
+class MaskRegionConstraint
+{
+public:
+  MaskRegionConstraint();
+
+  // SET_DATA_RANGE:
+  /// Only use voxels where min <= data <= max, or the other voxels if negate is set.
+  void set_data_range( DataBlockHandle data, double min, double max, bool negate );
+
+  // ADD_MASK:
+  /// Only use voxels inside the mask, or outside it if negate is set.
+  void add_mask( MaskDataBlockHandle mask, bool negate );
+
+  // IS_EMPTY:
+  /// Whether there are no conditions at all.
+  bool is_empty() const
+  {
+    return !this->data_block_ && this->masks_.empty();
+  }
+
+  // HAS_SIZE:
+  /// Whether all the data blocks of the conditions have the given dimensions.
+  bool has_size( size_t nx, size_t ny, size_t nz ) const;
+
+  // GET_MUTEXES:
+  /// The mutexes that need to be locked while the constraint is used.
+  std::vector< DataBlock::mutex_type* > get_mutexes() const;
+
+  // IS_INSIDE:
+  /// Whether the voxel at index meets all conditions.
+  /// NOTE: The mutexes need to be locked by the caller. The data of the masks is looked up
+  /// on every call, as compaction moves masks while they are not locked.
+  bool is_inside( size_t index ) const
+  {
+    if ( this->data_block_ && this->in_range_( this->data_, index, this->min_, this->max_ ) ==
+      this->negate_data_ ) return false;
+    for ( size_t j = 0; j < this->masks_.size(); j++ )
+    {
+      MaskDataBlock* mask = this->masks_[ j ].get();
+      if ( ( ( mask->get_mask_data()[ index ] & mask->get_mask_value() ) != 0 ) == 
+        this->negate_masks_[ j ] ) return false;
+    }
+    return true;
+  }
+
+private:
+  typedef bool ( *in_range_function_type )( const void* data, size_t index, double min, 
+    double max );
+
+  DataBlockHandle data_block_;
+  const void* data_;
+  in_range_function_type in_range_;
+  double min_;
+  double max_;
+  bool negate_data_;
+
+  std::vector< MaskDataBlockHandle > masks_;
+  std::vector< bool > negate_masks_;
+};
+
+class MaskComponents;
+class MaskComponentsPrivate;
+typedef boost::shared_ptr< MaskComponentsPrivate > MaskComponentsPrivateHandle;
+
+// CLASS MaskComponents:
+/// Labelling of the face connected components of a mask. The mask bits are read directly and
+/// stored as runs of voxels along the rows of the volume. The runs are joined with a lock free
+/// union find over the thread pool, so no image of labels needs to be allocated. Components
+/// are numbered in the order in which their first voxel appears in the volume.
+class MaskComponents : public boost::noncopyable
+{
+public:
+  MaskComponents();
+  ~MaskComponents();
+
+  /// The component of voxels that are not part of any component
+  static const size_t NO_COMPONENT_C;
+
+  // SET_ABORT_FUNCTION:
+  /// Function that is called in between passes, compute stops if it returns true.
+  void set_abort_function( boost::function< bool () > check_abort );
+
+  // COMPUTE:
+  /// Find the components of the voxels that are inside mask and inside the constraint.
+  /// Returns false if the constraint does not have the size of the mask, if memory could not
+  /// be allocated, or if it was aborted.
+  bool compute( MaskDataBlockHandle mask, 
+    const MaskRegionConstraint& constraint = MaskRegionConstraint() );
+
+  // GET_NUM_COMPONENTS:
+  /// The number of components that were found.
+  size_t get_num_components() const;
+
+  // GET_COMPONENT_SIZES:
+  /// The number of voxels of each component.
+  const std::vector< size_t >& get_component_sizes() const;
+
+  // GET_COMPONENT:
+  /// The component of the voxel at index, or NO_COMPONENT_C.
+  size_t get_component( size_t index ) const;
+
+  // SELECT_COMPONENTS:
+  /// Set selected[ component ] to true for every component with a voxel inside region.
+  /// Returns false if the region does not have the size of the labelled mask.
+  bool select_components( const MaskRegionConstraint& region, 
+    std::vector< bool >& selected ) const;
+
+  // FILL_MASK:
+  /// Set the mask bit of the voxels of the components for which selected is true and clear it
+  /// for all other voxels. Returns false if dst does not have the size of the labelled mask.
+  bool fill_mask( const std::vector< bool >& selected, MaskDataBlockHandle dst ) const;
+
+  // FILL_DATA:
+  /// Store values[ component ] in the voxels of each component and zero in all other voxels.
+  /// Returns false if dst does not have the size of the labelled mask.
+  bool fill_data( const std::vector< double >& values, DataBlockHandle dst ) const;
+
+private:
+  MaskComponentsPrivateHandle private_;
+
+public:
+  // FLOODFILL:
+  /// Fill the face connected region of voxels inside the constraint that are not yet set
+  /// in mask, starting from the voxels at the seed indices, or clear the region of voxels that
+  /// are set if erase is true. The mask is changed in place, its generation is increased and
+  /// mask_updated_signal_ is triggered if any voxel changed. Returns false if the constraint
+  /// does not have the size of the mask.
+  static bool FloodFill( MaskDataBlockHandle mask, const std::vector< size_t >& seeds,
+    bool erase, const MaskRegionConstraint& constraint = MaskRegionConstraint() );
+};
+
+} // end namespace Core
+
+#endif
@@ -32,14 +32,16 @@
 namespace Core
 {
 
-MaskDataBlock::MaskDataBlock( DataBlockHandle data_block, unsigned int mask_bit ) :
+MaskDataBlock::MaskDataBlock( DataBlockHandle data_block, unsigned int mask_bit, 
+  mutex_handle_type mutex ) :
   nx_( data_block->get_nx() ),
   ny_( data_block->get_ny() ),
   nz_( data_block->get_nz() ),
   data_block_( data_block ),
   mask_bit_( mask_bit ),
   mask_value_( 1 << mask_bit ),
-  not_mask_value_( ~( 1 << mask_bit ) ) 
+  not_mask_value_( ~( 1 << mask_bit ) ),
+  mutex_( mutex )
 {
   this->data_ = reinterpret_cast<unsigned char*>( this->data_block_->get_data() );
 }
@@ -51,19 +53,32 @@ MaskDataBlock::~MaskDataBlock()
 
 DataBlockHandle MaskDataBlock::get_data_block()
 {
+  boost::mutex::scoped_lock lock( this->data_block_mutex_ );
   return this->data_block_;
 }
 
 DataBlock::generation_type MaskDataBlock::get_generation() const
 {
+  boost::mutex::scoped_lock lock( this->data_block_mutex_ );
   return  this->data_block_->get_generation();
 }
 
 void MaskDataBlock::increase_generation()
 {
+  boost::mutex::scoped_lock lock( this->data_block_mutex_ );
   this->data_block_->increase_generation();
 }
 
+void MaskDataBlock::move_to( DataBlockHandle data_block, unsigned int mask_bit )
+{
+  boost::mutex::scoped_lock lock( this->data_block_mutex_ );
+  this->data_block_ = data_block;
+  this->mask_bit_ = mask_bit;
+  this->mask_value_ = 1 << mask_bit;
+  this->not_mask_value_ = ~( 1 << mask_bit );
+  this->data_ = reinterpret_cast<unsigned char*>( this->data_block_->get_data() );
+}
+
 bool MaskDataBlock::extract_slice( SliceType type, 
   index_type index, MaskDataSliceHandle& slice  )
 {
@@ -91,7 +106,7 @@ bool MaskDataBlock::extract_slice( SliceType type,
       MaskDataBlock::lock_type lock( slice_mask_data_block->get_mutex() );
       MaskDataBlock::shared_lock_type slock;
 
-      if ( this->get_data_block() != slice_mask_data_block->get_data_block() )
+      if ( &this->get_mutex() != &slice_mask_data_block->get_mutex() )
       {
         // Need a read lock for the slice mask
         shared_lock_type read_lock( this->get_mutex() );
@@ -156,7 +171,7 @@ bool MaskDataBlock::extract_slice( SliceType type,
       MaskDataBlock::lock_type lock( slice_mask_data_block->get_mutex() );
       MaskDataBlock::shared_lock_type slock;
 
-      if ( this->get_data_block() != slice_mask_data_block->get_data_block() )
+      if ( &this->get_mutex() != &slice_mask_data_block->get_mutex() )
       {
         // Need a read lock for the slice mask
         shared_lock_type read_lock( this->get_mutex() );
@@ -223,7 +238,7 @@ bool MaskDataBlock::extract_slice( SliceType type,
       MaskDataBlock::lock_type lock( slice_mask_data_block->get_mutex() );
       MaskDataBlock::shared_lock_type slock;
 
-      if ( this->get_data_block() != slice_mask_data_block->get_data_block() )
+      if ( &this->get_mutex() != &slice_mask_data_block->get_mutex() )
       {
         // Need a read lock for the slice mask
         shared_lock_type read_lock( this->get_mutex() );
@@ -299,7 +314,7 @@ bool MaskDataBlock::insert_slice( const MaskDataSliceHandle slice )
   lock_type lock( this->get_mutex() );
   shared_lock_type slock;
 
-  if ( this->get_data_block() != slice_mask_data_block->get_data_block() )
+  if ( &this->get_mutex() != &slice_mask_data_block->get_mutex() )
   {
     // Need a read lock for the slice mask
     shared_lock_type read_lock( slice_mask_data_block->get_mutex() );
@@ -36,6 +36,7 @@
 // Boost includes
 #include <boost/utility.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 // Core includes
 #include <Core/DataBlock/MaskDataBlockFWD.h>
@@ -64,10 +65,15 @@ public:
   typedef DataBlock::shared_lock_type shared_lock_type;
 
   typedef DataBlock::index_type index_type;
+  typedef boost::shared_ptr< mutex_type > mutex_handle_type;
 
   // -- Constructor/destructor --
 public:
-  MaskDataBlock( DataBlockHandle data_block, unsigned int mask_bit );
+  /// NOTE: Masks that are managed by the MaskDataBlockManager share the mutex of their
+  /// grid, as they can be moved between datablocks. Other masks use the mutex of the
+  /// datablock.
+  MaskDataBlock( DataBlockHandle data_block, unsigned int mask_bit, 
+    mutex_handle_type mutex = mutex_handle_type() );
   virtual ~MaskDataBlock();
 
   // -- Access properties of data block --
@@ -102,11 +108,13 @@ public:
 
   inline size_t to_index( size_t x, size_t y, size_t z ) const
   {
-    return this->data_block_->to_index( x, y, z );
+    return z * this->nx_ * this->ny_ + y * this->nx_ + x;
   }
 
   // DATA
   /// Pointer to the block of data
+  /// NOTE: The pointer, bit, and value of a mask change when the masks are compacted, they
+  /// should only be used while the mutex of the mask is locked
   inline unsigned char* get_mask_data()
   {
     return  this->data_;
@@ -193,10 +201,11 @@ public:
 public:
 
   // GET_MUTEX:
-  /// Get the mutex that locks the datablock
+  /// Get the mutex that locks the datablock. This mutex stays the same when the mask is
+  /// moved to a different datablock.
   mutex_type& get_mutex() const
   { 
-    return data_block_->get_mutex();
+    return this->mutex_ ? *this->mutex_ : this->data_block_->get_mutex();
   }
 
   // -- Signals and slots --
@@ -220,6 +229,16 @@ public:
   /// Extract a slice from the datablock
   bool extract_slice( SliceType type, index_type index, MaskDataSliceHandle& slice  );
 
+  // -- moving the mask to a different bitplane --
+private:
+  friend class MaskDataBlockManagerInternal;
+
+  // MOVE_TO:
+  /// Point the mask at a different datablock and bit. The caller is responsible for copying
+  /// the bitplane and needs to hold the mutex of the mask as well as the locks of both the
+  /// old and the new datablock.
+  void move_to( DataBlockHandle data_block, unsigned int mask_bit );
+
   // -- internals of the DataBlock --
 private:
   /// The dimensions of the datablock
@@ -231,15 +250,21 @@ private:
   DataBlockHandle data_block_;
 
   /// The bit that is used for this mask
-  const unsigned int mask_bit_;
+  unsigned int mask_bit_;
 
   /// Values that have the maskbit set or all the other bits
-  const unsigned char mask_value_;
-  const unsigned char not_mask_value_;
+  unsigned char mask_value_;
+  unsigned char not_mask_value_;
 
   /// Cached data pointer of the underlying DataBlock
   unsigned char* data_;
 
+  /// Mutex shared by all the masks that can be moved into the same datablocks
+  mutex_handle_type mutex_;
+
+  /// Protects the handle to the datablock, which is read without locking the mask
+  mutable boost::mutex data_block_mutex_;
+
 };
 
 } // end namespace Core
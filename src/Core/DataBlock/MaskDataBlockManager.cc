@@ -31,13 +31,16 @@
 #endif
 
 // STL includes
+#include <algorithm>
 #include <bitset>
 
 // Boost includes
 #include <boost/filesystem.hpp>
 
 // Core includes
+#include <Core/Math/MathFunctions.h>
 #include <Core/Utils/Log.h>
+#include <Core/Utils/StringUtil.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/DataBlock/DataBlockManager.h>
@@ -53,8 +56,10 @@ CORE_SINGLETON_IMPLEMENTATION( MaskDataBlockManager );
 class MaskDataBlockEntry
 {
 public:
-  MaskDataBlockEntry( DataBlockHandle data_block, GridTransform grid_transform ) :
-    data_block_( data_block ), data_masks_( 8 ), grid_transform_( grid_transform )
+  MaskDataBlockEntry( DataBlockHandle data_block, GridTransform grid_transform,
+    MaskDataBlock::mutex_handle_type mutex ) :
+    data_block_( data_block ), data_masks_( 8 ), grid_transform_( grid_transform ),
+    mutex_( mutex )
   {
   }
 
@@ -69,6 +74,10 @@ public:
 
   GridTransform grid_transform_;
 
+  // The mutex that locks the masks. It is shared by all the entries with the same grid
+  // transform, so a mask keeps its mutex when it is moved to another entry.
+  MaskDataBlock::mutex_handle_type mutex_;
+
 };
 
 // CLASS MaskDataBlockManagerInternal
@@ -81,8 +90,140 @@ public:
   // List that maintains a list of which bits are used in
   typedef std::vector< MaskDataBlockEntry > mask_list_type;
   mask_list_type mask_list_;
+
+  typedef std::vector< MaskDataBlockEntry* > entry_group_type;
+
+  // GET_GROUPS:
+  // Group the entries that have bits in use by grid transform, as only datablocks with the
+  // same grid transform can share bitplanes. Entries that have been registered, but do not
+  // have any masks yet are waiting for a project to finish loading and are left alone.
+  void get_groups( std::vector< entry_group_type >& groups );
+
+  // IS_FRAGMENTED:
+  // Check whether any of the groups of entries uses more datablocks than needed.
+  bool is_fragmented();
+
+  // GET_GROUP_MUTEX:
+  // Get the mutex shared by the entries with the given grid transform.
+  MaskDataBlock::mutex_handle_type get_group_mutex( const GridTransform& grid_transform );
+
+  // MOVE_BITPLANES:
+  // Move as many bitplanes as fit from src into the free bits of dst. Nothing is moved if
+  // either of the datablocks is locked.
+  void move_bitplanes( MaskDataBlockEntry& src, MaskDataBlockEntry& dst,
+    std::vector< MaskDataBlockHandle >& moved_masks );
 };
 
+static bool MoreBitsUsed( const MaskDataBlockEntry* a, const MaskDataBlockEntry* b )
+{
+  return a->bits_used_.count() > b->bits_used_.count();
+}
+
+void MaskDataBlockManagerInternal::get_groups( std::vector< entry_group_type >& groups )
+{
+  groups.clear();
+  std::vector< bool > grouped( this->mask_list_.size(), false );
+  for ( size_t j = 0; j < this->mask_list_.size(); j++ )
+  {
+    if ( grouped[ j ] || this->mask_list_[ j ].bits_used_.none() ) continue;
+
+    groups.push_back( entry_group_type() );
+    for ( size_t k = j; k < this->mask_list_.size(); k++ )
+    {
+      if ( !grouped[ k ] && this->mask_list_[ k ].bits_used_.any() &&
+        this->mask_list_[ k ].grid_transform_ == this->mask_list_[ j ].grid_transform_ )
+      {
+        grouped[ k ] = true;
+        groups.back().push_back( &this->mask_list_[ k ] );
+      }
+    }
+  }
+}
+
+bool MaskDataBlockManagerInternal::is_fragmented()
+{
+  std::vector< entry_group_type > groups;
+  this->get_groups( groups );
+
+  for ( size_t j = 0; j < groups.size(); j++ )
+  {
+    size_t bits_used = 0;
+    for ( size_t k = 0; k < groups[ j ].size(); k++ )
+    {
+      bits_used += groups[ j ][ k ]->bits_used_.count();
+    }
+
+    // Every datablock that can be released frees the memory of a full volume
+    if ( groups[ j ].size() > ( bits_used + 7 ) / 8 ) return true;
+  }
+  
+  return false;
+}
+
+MaskDataBlock::mutex_handle_type MaskDataBlockManagerInternal::get_group_mutex( 
+  const GridTransform& grid_transform )
+{
+  for ( size_t j = 0; j < this->mask_list_.size(); j++ )
+  {
+    if ( this->mask_list_[ j ].grid_transform_ == grid_transform )
+    {
+      return this->mask_list_[ j ].mutex_;
+    }
+  }
+
+  return MaskDataBlock::mutex_handle_type( new MaskDataBlock::mutex_type );
+}
+
+void MaskDataBlockManagerInternal::move_bitplanes( MaskDataBlockEntry& src, 
+  MaskDataBlockEntry& dst, std::vector< MaskDataBlockHandle >& moved_masks )
+{
+  // Only try to lock, as the thread that is holding a lock may be waiting for the manager
+  DataBlock::lock_type src_lock( src.data_block_->get_mutex(), boost::try_to_lock );
+  if ( !src_lock.owns_lock() ) return;
+  DataBlock::lock_type dst_lock( dst.data_block_->get_mutex(), boost::try_to_lock );
+  if ( !dst_lock.owns_lock() ) return;
+
+  unsigned char* src_data = reinterpret_cast< unsigned char* >( src.data_block_->get_data() );
+  unsigned char* dst_data = reinterpret_cast< unsigned char* >( dst.data_block_->get_data() );
+  size_t size = src.data_block_->get_size();
+
+  bool moved = false;
+  for ( unsigned int src_bit = 0; src_bit < 8 && dst.bits_used_.count() != 8; src_bit++ )
+  {
+    if ( !src.bits_used_.test( src_bit ) ) continue;
+
+    // A mask that cannot be locked is being destroyed and will be released shortly
+    MaskDataBlockHandle mask = src.data_masks_[ src_bit ].lock();
+    if ( !mask ) continue;
+
+    unsigned int dst_bit = 0;
+    while ( dst.bits_used_.test( dst_bit ) ) dst_bit++;
+
+    unsigned char src_value = static_cast< unsigned char >( 1 << src_bit );
+    unsigned char dst_value = static_cast< unsigned char >( 1 << dst_bit );
+    unsigned char not_dst_value = ~dst_value;
+    for ( size_t j = 0; j < size; j++ )
+    {
+      if ( src_data[ j ] & src_value ) dst_data[ j ] |= dst_value;
+      else dst_data[ j ] &= not_dst_value;
+    }
+
+    mask->move_to( dst.data_block_, dst_bit );
+
+    src.bits_used_[ src_bit ] = 0;
+    src.data_masks_[ src_bit ].reset();
+    dst.bits_used_[ dst_bit ] = 1;
+    dst.data_masks_[ dst_bit ] = mask;
+
+    moved_masks.push_back( mask );
+    moved = true;
+  }
+
+  // The content of the destination changed, so it cannot be identified with data that
+  // has been saved under its old generation number
+  if ( moved ) dst.data_block_->increase_generation();
+}
+
 
 
 MaskDataBlockManager::MaskDataBlockManager() :
@@ -135,11 +276,13 @@ bool MaskDataBlockManager::create( GridTransform grid_transform, MaskDataBlockHa
     if ( !data_block ) return false;        
     mask_bit = 0;
     mask_entry_index = mask_list.size();
-    mask_list.push_back( MaskDataBlockEntry( data_block, grid_transform ) );
+    mask_list.push_back( MaskDataBlockEntry( data_block, grid_transform, 
+      this->private_->get_group_mutex( grid_transform ) ) );
   }
 
   // Generate the new mask
-  mask = MaskDataBlockHandle( new MaskDataBlock( data_block, mask_bit ) );
+  mask = MaskDataBlockHandle( new MaskDataBlock( data_block, mask_bit, 
+    mask_list[ mask_entry_index ].mutex_ ) );
   
   // Clear the mask before using it
   
@@ -187,7 +330,8 @@ bool MaskDataBlockManager::create( DataBlock::generation_type generation, unsign
     {
       assert( mask_list[ j ].bits_used_[ bit ] == 0 );
       grid_transform = mask_list[ j ].grid_transform_;
-      mask = MaskDataBlockHandle( new MaskDataBlock( mask_list[ j ].data_block_, bit ) );
+      mask = MaskDataBlockHandle( new MaskDataBlock( mask_list[ j ].data_block_, bit,
+        mask_list[ j ].mutex_ ) );
       mask_list[ j ].bits_used_[ bit ] = 1;
       mask_list[ j ].data_masks_[ bit ] = mask;
 
@@ -200,34 +344,117 @@ bool MaskDataBlockManager::create( DataBlock::generation_type generation, unsign
 
 void MaskDataBlockManager::release(DataBlockHandle& datablock, unsigned int mask_bit)
 {
-  lock_type lock( get_mutex() );
+  bool fragmented = false;
+  {
+    lock_type lock( get_mutex() );
 
-  MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+    MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+
+    // Remove the MaskDataBlock from the list
+    for ( size_t j = 0 ; j < mask_list.size() ; j++ )
+    {
+      if ( mask_list[ j ].data_block_ == datablock )
+      {
+        mask_list[ j ].bits_used_[mask_bit] = 0;
+        mask_list[ j ].data_masks_[mask_bit].reset();
+
+        // If the DataBlock is not used any more clear it
+        if ( mask_list[ j ].bits_used_.count() == 0 )
+        {
+          DataBlockManager::Instance()->unregister_datablock( datablock->get_generation() );
+          mask_list.erase( mask_list.begin() + j );
+        }
+
+        break;
+      }
+    }
+
+    fragmented = this->private_->is_fragmented();
+  }
 
-  // Remove the MaskDataBlock from the list
-  for ( size_t j = 0 ; j < mask_list.size() ; j++ )
+  // NOTE: This is called from the destructor of a mask, possibly while the caller holds the
+  // lock of another mask, hence compaction cannot be done here.
+  if ( fragmented ) this->fragmented_signal_();
+}
+
+bool MaskDataBlockManager::compact()
+{
+  // Moved masks are kept alive until the manager is unlocked, as destroying the last handle
+  // of a mask calls release, which alters the list of entries.
+  std::vector< MaskDataBlockHandle > moved_masks;
+
+  lock_type lock( this->get_mutex() );
+
+  std::vector< MaskDataBlockManagerInternal::entry_group_type > groups;
+  this->private_->get_groups( groups );
+
+  std::vector< DataBlockHandle > emptied_data_blocks;
+  for ( size_t j = 0; j < groups.size(); j++ )
   {
-    if ( mask_list[ j ].data_block_ == datablock )
+    MaskDataBlockManagerInternal::entry_group_type& group = groups[ j ];
+    if ( group.size() < 2 ) continue;
+
+    // Moving a bitplane changes the data pointer and bit of a mask, hence none of the masks
+    // of the group can be in use. Only try to lock, as the thread that is holding the lock
+    // may be waiting for the manager.
+    MaskDataBlock::lock_type group_lock( *group[ 0 ]->mutex_, boost::try_to_lock );
+    if ( !group_lock.owns_lock() ) continue;
+
+    // Fill the fullest datablocks with the bitplanes of the emptiest ones
+    std::sort( group.begin(), group.end(), MoreBitsUsed );
+    size_t dst = 0;
+    size_t src = group.size() - 1;
+    while ( dst < src )
     {
-      mask_list[ j ].bits_used_[mask_bit] = 0;
-      mask_list[ j ].data_masks_[mask_bit].reset();
+      if ( group[ dst ]->bits_used_.count() == 8 )
+      {
+        dst++;
+        continue;
+      }
 
-      // If the DataBlock is not used any more clear it
-      if ( mask_list[ j ].bits_used_.count() == 0 )
+      this->private_->move_bitplanes( *group[ src ], *group[ dst ], moved_masks );
+
+      if ( group[ src ]->bits_used_.none() )
+      {
+        emptied_data_blocks.push_back( group[ src ]->data_block_ );
+        src--;
+      }
+      else if ( group[ dst ]->bits_used_.count() != 8 )
       {
-        DataBlockManager::Instance()->unregister_datablock( datablock->get_generation() );
-        mask_list.erase( mask_list.begin() + j );
+        // The source is locked or has a mask that is being destroyed
+        src--;
       }
+    }
+  }
 
-      break;
+  MaskDataBlockManagerInternal::mask_list_type& mask_list = this->private_->mask_list_;
+  for ( size_t j = 0; j < emptied_data_blocks.size(); j++ )
+  {
+    for ( size_t k = 0; k < mask_list.size(); k++ )
+    {
+      if ( mask_list[ k ].data_block_ == emptied_data_blocks[ j ] )
+      {
+        DataBlockManager::Instance()->unregister_datablock( 
+          emptied_data_blocks[ j ]->get_generation() );
+        mask_list.erase( mask_list.begin() + k );
+        break;
+      }
     }
   }
+
+  if ( !emptied_data_blocks.empty() )
+  {
+    CORE_LOG_DEBUG( "Compacted masks, released " + 
+      ExportToString( emptied_data_blocks.size() ) + " datablocks" );
+  }
+
+  return !emptied_data_blocks.empty();
 }
 
-bool MaskDataBlockManager::compact()
+bool MaskDataBlockManager::is_fragmented()
 {
-  // TODO: Need to implement this
-  return false;
+  lock_type lock( this->get_mutex() );
+  return this->private_->is_fragmented();
 }
 
 void MaskDataBlockManager::register_data_block( DataBlockHandle data_block, 
@@ -235,7 +462,8 @@ void MaskDataBlockManager::register_data_block( DataBlockHandle data_block,
 {
   lock_type lock( get_mutex() );
 
-  this->private_->mask_list_.push_back( MaskDataBlockEntry( data_block, grid_transform ) );
+  this->private_->mask_list_.push_back( MaskDataBlockEntry( data_block, grid_transform,
+    this->private_->get_group_mutex( grid_transform ) ) );
 }
 
 void MaskDataBlockManager::clear()
@@ -648,7 +876,7 @@ bool MaskDataBlockManager::Duplicate( MaskDataBlockHandle src_mask_data_block,
   
   // NOTE: Need to check if we not already locked this one. If the underlying datablocks are
   // the same we do not need a read lock. In fact putting one would result in a deadlock
-  if ( src_mask_data_block->get_data_block( ) != dst_mask_data_block->get_data_block( ) )
+  if ( &src_mask_data_block->get_mutex( ) != &dst_mask_data_block->get_mutex( ) )
   {
     MaskDataBlock::shared_lock_type read_lock( src_mask_data_block->get_mutex( ) );
     slock.swap( read_lock );
@@ -1041,4 +1269,99 @@ bool MaskDataBlockManager::Inscribe( MaskDataBlockHandle mask, DataBlockHandle d
   }
 }
 
+bool MaskDataBlockManager::PackBitPlane( MaskDataBlockHandle mask_data_block, 
+  DataBlockHandle& packed_data )
+{
+  size_t nx = mask_data_block->get_nx();
+  size_t packed_nx = ( nx + 7 ) >> 3;
+  size_t num_rows = mask_data_block->get_ny() * mask_data_block->get_nz();
+
+  packed_data = StdDataBlock::New( packed_nx, mask_data_block->get_ny(), 
+    mask_data_block->get_nz(), DataType::UCHAR_E );
+  if ( !packed_data ) return false;
+
+  MaskDataBlock::shared_lock_type lock( mask_data_block->get_mutex() );
+  const unsigned char* mask_ptr = mask_data_block->get_mask_data();
+  unsigned char mask_value = mask_data_block->get_mask_value();
+  unsigned char* packed_ptr = reinterpret_cast< unsigned char* >( packed_data->get_data() );
+
+  size_t nx8 = RemoveRemainder8( nx );
+  for ( size_t row = 0; row < num_rows; row++ )
+  {
+    const unsigned char* src = mask_ptr + row * nx;
+    unsigned char* dst = packed_ptr + row * packed_nx;
+
+    size_t x = 0;
+    for ( ; x < nx8; x += 8 )
+    {
+      dst[ x >> 3 ] = 
+        ( ( src[ x ] & mask_value ) ? 0x01 : 0 ) | ( ( src[ x + 1 ] & mask_value ) ? 0x02 : 0 ) |
+        ( ( src[ x + 2 ] & mask_value ) ? 0x04 : 0 ) | ( ( src[ x + 3 ] & mask_value ) ? 0x08 : 0 ) |
+        ( ( src[ x + 4 ] & mask_value ) ? 0x10 : 0 ) | ( ( src[ x + 5 ] & mask_value ) ? 0x20 : 0 ) |
+        ( ( src[ x + 6 ] & mask_value ) ? 0x40 : 0 ) | ( ( src[ x + 7 ] & mask_value ) ? 0x80 : 0 );
+    }
+    if ( x < nx )
+    {
+      unsigned char byte = 0;
+      for ( size_t k = 0; x < nx; x++, k++ )
+      {
+        if ( src[ x ] & mask_value ) byte |= static_cast< unsigned char >( 1 << k );
+      }
+      dst[ nx8 >> 3 ] = byte;
+    }
+  }
+
+  return true;
+}
+
+bool MaskDataBlockManager::UnpackBitPlane( const DataBlockHandle& packed_data, 
+  const GridTransform& grid_transform, MaskDataBlockHandle& mask_data_block )
+{
+  size_t nx = grid_transform.get_nx();
+  size_t packed_nx = ( nx + 7 ) >> 3;
+  size_t num_rows = grid_transform.get_ny() * grid_transform.get_nz();
+
+  // Security check
+  if ( packed_data->get_data_type() != DataType::UCHAR_E ||
+    packed_data->get_nx() != packed_nx || 
+    packed_data->get_ny() != grid_transform.get_ny() ||
+    packed_data->get_nz() != grid_transform.get_nz() )
+  {
+    return false;
+  }
+
+  // NOTE: The bitplane of a new mask has already been cleared
+  if ( !( MaskDataBlockManager::Instance()->create( grid_transform, mask_data_block ) ) )
+  {
+    return false;
+  }
+
+  MaskDataBlock::lock_type lock( mask_data_block->get_mutex() );
+  unsigned char* mask_ptr = mask_data_block->get_mask_data();
+  unsigned char mask_value = mask_data_block->get_mask_value();
+  const unsigned char* packed_ptr = 
+    reinterpret_cast< const unsigned char* >( packed_data->get_data() );
+
+  for ( size_t row = 0; row < num_rows; row++ )
+  {
+    const unsigned char* src = packed_ptr + row * packed_nx;
+    unsigned char* dst = mask_ptr + row * nx;
+
+    for ( size_t j = 0; j < packed_nx; j++ )
+    {
+      // Masks are mostly empty, so skip bytes without any voxels quickly
+      unsigned char byte = src[ j ];
+      if ( byte == 0 ) continue;
+
+      size_t x_end = Min( ( j + 1 ) << 3, nx );
+      for ( size_t x = j << 3; x < x_end; x++, byte >>= 1 )
+      {
+        if ( byte & 0x01 ) dst[ x ] |= mask_value;
+      }
+    }
+  }
+
+  return true;
+}
+
 } // end namespace Core
@@ -40,6 +40,7 @@
 #include <boost/utility.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/signals2/signal.hpp>
 
 // Core includes
 #include <Core/Utils/Singleton.h>
@@ -94,9 +95,26 @@ public:
     
   // COMPACT:
   /// Compact the masks into less memory if possible by moving them around
-  /// to compact the space required.
+  /// to compact the space required. Bitplanes are moved from the emptiest datablocks into
+  /// the free bits of the fullest datablocks with the same grid transform, and datablocks
+  /// that end up empty are released. Datablocks that are locked by another user are skipped.
+  /// Returns true if any datablock was released.
+  /// NOTE: Moving a bitplane changes the datablock, bit, and generation of a mask. All the
+  /// masks with the same grid transform share a mutex, and groups of masks of which the mutex
+  /// is locked by another thread are skipped.
   bool compact();
 
+  // IS_FRAGMENTED:
+  /// Check whether compacting the masks would release enough memory to be worth it.
+  bool is_fragmented();
+
+  // -- Signals --
+public:
+  // FRAGMENTED_SIGNAL:
+  /// Triggered when releasing a mask leaves the masks fragmented. Compaction itself is left
+  /// to the application, which knows when no mask data is in use.
+  boost::signals2::signal< void () > fragmented_signal_;
+
   // -- MaskDataBlock callbacks --
 protected:
   friend class MaskDataBlock;
@@ -170,6 +188,17 @@ public:
   /// Duplicate a MaskDataBlock into a DataBlock
   static bool Duplicate( MaskDataBlockHandle src_mask_data_block, 
     const GridTransform& grid_transform, MaskDataBlockHandle& dst_mask_data_block );
+
+  // PACKBITPLANE:
+  /// Pack the bitplane of a mask into a UCHAR DataBlock with one bit per voxel. Every row in
+  /// x is padded to a whole number of bytes, hence the packed data has ( nx + 7 ) / 8 x ny x nz
+  /// bytes. Bit k of byte j in a row holds voxel 8 * j + k.
+  static bool PackBitPlane( MaskDataBlockHandle mask_data_block, DataBlockHandle& packed_data );
+
+  // UNPACKBITPLANE:
+  /// Create a new MaskDataBlock from a bitplane that was packed with PackBitPlane
+  static bool UnpackBitPlane( const DataBlockHandle& packed_data, 
+    const GridTransform& grid_transform, MaskDataBlockHandle& mask_data_block );
 };
 
 } // end namespace Core
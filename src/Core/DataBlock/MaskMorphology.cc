@@ -0,0 +1,743 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <vector>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/DataBlock/DataBlockLocks.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskMorphology.h>
+
+namespace Core
+{
+
+// Number of lines or voxels processed by one task of the thread pool
+static const size_t LINE_GRAIN_C = 256;
+static const size_t VOXEL_GRAIN_C = 1 << 18;
+static const size_t FRONT_GRAIN_C = 1 << 14;
+
+//////////////////////////////////////////////////////////////////////////
+// Class MaskMorphologyPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class MaskMorphologyOperation
+{
+public:
+  MaskMorphologyOperation( bool dilate, MorphologyShapeType shape, int radius ) :
+    dilate_( dilate ),
+    shape_( shape ),
+    radius_( radius )
+  {
+  }
+
+  bool dilate_;
+  MorphologyShapeType shape_;
+  int radius_;
+};
+
+class MaskMorphologyPrivate
+{
+public:
+  MaskMorphologyPrivate() :
+    invert_constraint_( false ),
+    only2d_( false ),
+    slice_type_( SliceType::AXIAL_E ),
+    nx_( 0 ),
+    ny_( 0 ),
+    nz_( 0 ),
+    size_( 0 ),
+    data_( 0 ),
+    value_( 0 ),
+    constraint_data_( 0 ),
+    constraint_value_( 0 ),
+    operation_( 0 ),
+    num_operations_( 1 )
+  {
+  }
+
+  // Whether the voxel is part of the mask that is being processed
+  bool is_set( size_t index ) const
+  {
+    return ( this->data_[ index ] & this->value_ ) != 0;
+  }
+
+  // Whether the voxel may change
+  bool is_allowed( size_t index ) const
+  {
+    if ( this->constraint_data_ == 0 ) return true;
+    return ( ( this->constraint_data_[ index ] & this->constraint_value_ ) != 0 ) != 
+      this->invert_constraint_;
+  }
+
+  // Get the data pointers and values of the masks, which change when the masks are compacted
+  // NOTE: The destination and constraint need to be locked by the caller
+  void read_mask_data()
+  {
+    this->data_ = this->dst_->get_mask_data();
+    this->value_ = this->dst_->get_mask_value();
+    this->constraint_data_ = this->constraint_ ? this->constraint_->get_mask_data() : 0;
+    this->constraint_value_ = this->constraint_ ? this->constraint_->get_mask_value() : 0;
+  }
+
+  // Whether the structuring elements extend along the axis
+  bool use_axis( int axis ) const
+  {
+    if ( !this->only2d_ ) return true;
+    if ( this->slice_type_ == SliceType::SAGITTAL_E ) return axis != 0;
+    if ( this->slice_type_ == SliceType::CORONAL_E ) return axis != 1;
+    return axis != 2;
+  }
+
+  // The lines along an axis, line is in [ 0, get_num_lines( axis ) )
+  size_t get_num_lines( int axis ) const;
+  void get_line( int axis, size_t line, size_t& start, size_t& stride, size_t& length ) const;
+
+  // Report the fraction of the current operation that has been done
+  void update_progress( double fraction );
+
+  // Call the abort function
+  bool check_abort();
+
+  // Copy the source mask into the destination
+  void copy_range( MaskDataBlockHandle src, size_t begin, size_t end );
+
+  // Dilate or erode with a ball, all voxels whose distance to the other side of the mask edge
+  // is at most the square root of threshold change
+  template< class DISTANCE >
+  bool run_ball( bool dilate, unsigned int threshold );
+
+  // Squared distance along the first axis to the nearest voxel on the other side of the edge
+  template< class DISTANCE >
+  void first_distance_range( DISTANCE* distance, bool dilate, int axis, 
+    size_t begin, size_t end );
+
+  // Extend the squared distances with the distances along the next axis
+  template< class DISTANCE >
+  void next_distance_range( DISTANCE* distance, int axis, size_t begin, size_t end );
+
+  template< class DISTANCE >
+  void apply_ball_range( const DISTANCE* distance, bool dilate, unsigned int threshold,
+    size_t begin, size_t end );
+
+  // Dilate or erode by repeated steps to the neighbors of the voxels that changed in the
+  // previous step, the search only visits voxels that are allowed to change
+  bool run_iterative( bool dilate, int radius );
+
+  void source_rows_range( bool dilate, size_t begin, size_t end );
+  void first_front_range( std::atomic< unsigned char >* state, bool dilate, 
+    size_t begin, size_t end );
+  void next_front_range( std::atomic< unsigned char >* state, size_t begin, size_t end );
+  void flip_front_range( size_t begin, size_t end );
+
+  // -- options --
+  MaskDataBlockHandle constraint_;
+  bool invert_constraint_;
+  bool only2d_;
+  SliceType slice_type_;
+  boost::function< void ( double ) > progress_;
+  boost::function< bool () > check_abort_;
+  std::vector< MaskMorphologyOperation > operations_;
+
+  // -- state of a run --
+  MaskDataBlockHandle dst_;
+  size_t nx_;
+  size_t ny_;
+  size_t nz_;
+  size_t size_;
+  unsigned char* data_;
+  unsigned char value_;
+  unsigned char* constraint_data_;
+  unsigned char constraint_value_;
+  size_t operation_;
+  size_t num_operations_;
+
+  // Offsets to the neighbors that the iterative shape steps to
+  std::vector< int > neighbor_dx_;
+  std::vector< int > neighbor_dy_;
+  std::vector< int > neighbor_dz_;
+
+  // Whether a row along the x axis contains voxels that the iterative shape starts from
+  std::vector< unsigned char > source_rows_;
+
+  // Voxels that changed in the last step of the iterative shape and the ones that change in
+  // the next step
+  std::vector< size_t > front_;
+  std::vector< size_t > next_front_;
+  boost::mutex front_mutex_;
+};
+
+size_t MaskMorphologyPrivate::get_num_lines( int axis ) const
+{
+  if ( axis == 0 ) return this->ny_ * this->nz_;
+  if ( axis == 1 ) return this->nx_ * this->nz_;
+  return this->nx_ * this->ny_;
+}
+
+void MaskMorphologyPrivate::get_line( int axis, size_t line, size_t& start, size_t& stride, 
+  size_t& length ) const
+{
+  if ( axis == 0 )
+  {
+    start = line * this->nx_;
+    stride = 1;
+    length = this->nx_;
+  }
+  else if ( axis == 1 )
+  {
+    start = ( line / this->nx_ ) * this->nx_ * this->ny_ + line % this->nx_;
+    stride = this->nx_;
+    length = this->ny_;
+  }
+  else
+  {
+    start = line;
+    stride = this->nx_ * this->ny_;
+    length = this->nz_;
+  }
+}
+
+void MaskMorphologyPrivate::update_progress( double fraction )
+{
+  if ( this->progress_ )
+  {
+    this->progress_( ( static_cast< double >( this->operation_ ) + fraction ) / 
+      static_cast< double >( this->num_operations_ ) );
+  }
+}
+
+bool MaskMorphologyPrivate::check_abort()
+{
+  return this->check_abort_ && this->check_abort_();
+}
+
+void MaskMorphologyPrivate::copy_range( MaskDataBlockHandle src, size_t begin, size_t end )
+{
+  const unsigned char* src_data = src->get_mask_data();
+  unsigned char src_value = src->get_mask_value();
+  unsigned char not_value = ~this->value_;
+
+  for ( size_t j = begin; j < end; j++ )
+  {
+    if ( src_data[ j ] & src_value ) this->data_[ j ] |= this->value_;
+    else this->data_[ j ] &= not_value;
+  }
+}
+
+template< class DISTANCE >
+void MaskMorphologyPrivate::first_distance_range( DISTANCE* distance, bool dilate, int axis, 
+  size_t begin, size_t end )
+{
+  const unsigned long long infinity = std::numeric_limits< DISTANCE >::max();
+  size_t start, stride, length;
+  std::vector< size_t > count;
+
+  for ( size_t line = begin; line < end; line++ )
+  {
+    this->get_line( axis, line, start, stride, length );
+    count.resize( length );
+
+    // Number of steps to the nearest source before and after each voxel, the sources of a
+    // dilation are the voxels inside the mask and those of an erosion the ones outside it
+    size_t steps = std::numeric_limits< size_t >::max();
+    for ( size_t j = 0, index = start; j < length; j++, index += stride )
+    {
+      if ( this->is_set( index ) == dilate ) steps = 0;
+      else if ( steps != std::numeric_limits< size_t >::max() ) steps++;
+      count[ j ] = steps;
+    }
+
+    steps = std::numeric_limits< size_t >::max();
+    for ( size_t j = length, index = start + ( length - 1 ) * stride; j-- > 0; index -= stride )
+    {
+      if ( count[ j ] == 0 ) steps = 0;
+      else if ( steps != std::numeric_limits< size_t >::max() ) steps++;
+      unsigned long long nearest = std::min( count[ j ], steps );
+      if ( nearest >= 0xffffffffULL ) distance[ index ] = static_cast< DISTANCE >( infinity );
+      else distance[ index ] = static_cast< DISTANCE >( std::min( nearest * nearest, infinity ) );
+    }
+  }
+}
+
+template< class DISTANCE >
+void MaskMorphologyPrivate::next_distance_range( DISTANCE* distance, int axis, 
+  size_t begin, size_t end )
+{
+  const DISTANCE infinity = std::numeric_limits< DISTANCE >::max();
+  size_t start, stride, length;
+
+  // Lower envelope of the parabolas centered on the voxels of the line that have a finite
+  // distance (Felzenszwalb and Huttenlocher). Distances that were clipped to infinity are
+  // larger than any threshold, so they can be left out.
+  std::vector< double > values;
+  std::vector< size_t > sites;
+  std::vector< double > bounds;
+
+  for ( size_t line = begin; line < end; line++ )
+  {
+    this->get_line( axis, line, start, stride, length );
+    values.resize( length );
+    sites.resize( length );
+    bounds.resize( length );
+
+    int k = -1;
+    for ( size_t q = 0, index = start; q < length; q++, index += stride )
+    {
+      values[ q ] = static_cast< double >( distance[ index ] );
+      if ( distance[ index ] == infinity ) continue;
+
+      double fq = values[ q ] + static_cast< double >( q ) * static_cast< double >( q );
+      double s = 0.0;
+      while ( k >= 0 )
+      {
+        double p = static_cast< double >( sites[ k ] );
+        s = ( fq - ( values[ sites[ k ] ] + p * p ) ) / ( 2.0 * ( static_cast< double >( q ) - p ) );
+        if ( s <= bounds[ k ] ) k--;
+        else break;
+      }
+      k++;
+      sites[ k ] = q;
+      bounds[ k ] = ( k == 0 ) ? -std::numeric_limits< double >::max() : s;
+    }
+
+    if ( k < 0 ) continue;
+
+    int j = 0;
+    for ( size_t q = 0, index = start; q < length; q++, index += stride )
+    {
+      while ( j < k && bounds[ j + 1 ] <= static_cast< double >( q ) ) j++;
+      double d = static_cast< double >( q ) - static_cast< double >( sites[ j ] );
+      double value = values[ sites[ j ] ] + d * d;
+      distance[ index ] = ( value >= static_cast< double >( infinity ) ) ? infinity :
+        static_cast< DISTANCE >( value );
+    }
+  }
+}
+
+template< class DISTANCE >
+void MaskMorphologyPrivate::apply_ball_range( const DISTANCE* distance, bool dilate, 
+  unsigned int threshold, size_t begin, size_t end )
+{
+  unsigned char not_value = ~this->value_;
+  for ( size_t j = begin; j < end; j++ )
+  {
+    if ( distance[ j ] > threshold || this->is_set( j ) == dilate || !this->is_allowed( j ) ) 
+    {
+      continue;
+    }
+
+    if ( dilate ) this->data_[ j ] |= this->value_;
+    else this->data_[ j ] &= not_value;
+  }
+}
+
+template< class DISTANCE >
+bool MaskMorphologyPrivate::run_ball( bool dilate, unsigned int threshold )
+{
+  std::vector< DISTANCE > distance;
+  try
+  {
+    distance.resize( this->size_ );
+  }
+  catch ( ... )
+  {
+    return false;
+  }
+
+  std::vector< int > axes;
+  for ( int axis = 0; axis < 3; axis++ )
+  {
+    if ( this->use_axis( axis ) ) axes.push_back( axis );
+  }
+
+  ThreadPool* pool = ThreadPool::Instance();
+  double num_passes = static_cast< double >( axes.size() + 1 );
+
+  {
+    DataBlockLocks locks( MaskDataBlockHandle(), this->dst_, this->constraint_ );
+    this->read_mask_data();
+    pool->parallel_for( 0, this->get_num_lines( axes[ 0 ] ), LINE_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::first_distance_range< DISTANCE >, this, &distance[ 0 ], 
+      dilate, axes[ 0 ], _1, _2 ) );
+  }
+  this->update_progress( 1.0 / num_passes );
+  if ( this->check_abort() ) return false;
+
+  for ( size_t j = 1; j < axes.size(); j++ )
+  {
+    pool->parallel_for( 0, this->get_num_lines( axes[ j ] ), LINE_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::next_distance_range< DISTANCE >, this, &distance[ 0 ], 
+      axes[ j ], _1, _2 ) );
+    this->update_progress( static_cast< double >( j + 1 ) / num_passes );
+    if ( this->check_abort() ) return false;
+  }
+
+  {
+    DataBlockLocks locks( this->dst_, this->constraint_ );
+    this->read_mask_data();
+    pool->parallel_for( 0, this->size_, VOXEL_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::apply_ball_range< DISTANCE >, this, &distance[ 0 ], 
+      dilate, threshold, _1, _2 ) );
+  }
+  this->update_progress( 1.0 );
+
+  return true;
+}
+
+void MaskMorphologyPrivate::source_rows_range( bool dilate, size_t begin, size_t end )
+{
+  for ( size_t row = begin; row < end; row++ )
+  {
+    unsigned char source = 0;
+    for ( size_t index = row * this->nx_, last = index + this->nx_; index < last; index++ )
+    {
+      if ( this->is_set( index ) == dilate )
+      {
+        source = 1;
+        break;
+      }
+    }
+    this->source_rows_[ row ] = source;
+  }
+}
+
+void MaskMorphologyPrivate::first_front_range( std::atomic< unsigned char >* state, 
+  bool dilate, size_t begin, size_t end )
+{
+  std::vector< size_t > front;
+  size_t nx = this->nx_;
+  size_t ny = this->ny_;
+  size_t nz = this->nz_;
+  size_t num_neighbors = this->neighbor_dx_.size();
+
+  // A voxel changes in the first step if it is allowed to and if it has a neighbor on the
+  // other side of the edge of the mask
+  for ( size_t row = begin; row < end; row++ )
+  {
+    size_t y = row % ny;
+    size_t z = row / ny;
+
+    // Rows that are not next to a row with sources can be skipped
+    bool near_source = false;
+    for ( size_t m = 0; m < num_neighbors && !near_source; m++ )
+    {
+      size_t py = y + this->neighbor_dy_[ m ];
+      size_t pz = z + this->neighbor_dz_[ m ];
+      if ( py < ny && pz < nz ) near_source = this->source_rows_[ py + ny * pz ] != 0;
+    }
+
+    for ( size_t x = 0, index = row * nx; x < nx; x++, index++ )
+    {
+      bool candidate = this->is_set( index ) != dilate && this->is_allowed( index );
+      if ( !candidate || !near_source )
+      {
+        state[ index ].store( candidate ? 0 : 1, std::memory_order_relaxed );
+        continue;
+      }
+
+      bool edge = false;
+      for ( size_t m = 0; m < num_neighbors && !edge; m++ )
+      {
+        size_t px = x + this->neighbor_dx_[ m ];
+        size_t py = y + this->neighbor_dy_[ m ];
+        size_t pz = z + this->neighbor_dz_[ m ];
+        // Coordinates below zero wrap around to large values
+        if ( px >= nx || py >= ny || pz >= nz ) continue;
+        edge = this->is_set( px + nx * ( py + ny * pz ) ) == dilate;
+      }
+
+      if ( edge ) front.push_back( index );
+      state[ index ].store( edge ? 1 : 0, std::memory_order_relaxed );
+    }
+  }
+
+  boost::mutex::scoped_lock lock( this->front_mutex_ );
+  this->next_front_.insert( this->next_front_.end(), front.begin(), front.end() );
+}
+
+void MaskMorphologyPrivate::next_front_range( std::atomic< unsigned char >* state, 
+  size_t begin, size_t end )
+{
+  std::vector< size_t > front;
+  size_t nx = this->nx_;
+  size_t ny = this->ny_;
+  size_t nz = this->nz_;
+  size_t num_neighbors = this->neighbor_dx_.size();
+
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t index = this->front_[ j ];
+    size_t x = index % nx;
+    size_t y = ( index / nx ) % ny;
+    size_t z = index / ( nx * ny );
+
+    for ( size_t m = 0; m < num_neighbors; m++ )
+    {
+      size_t px = x + this->neighbor_dx_[ m ];
+      size_t py = y + this->neighbor_dy_[ m ];
+      size_t pz = z + this->neighbor_dz_[ m ];
+      if ( px >= nx || py >= ny || pz >= nz ) continue;
+
+      // Claim the voxel, so it is only added once to the next front
+      size_t neighbor = px + nx * ( py + ny * pz );
+      unsigned char expected = 0;
+      if ( state[ neighbor ].load( std::memory_order_relaxed ) == 0 &&
+        state[ neighbor ].compare_exchange_strong( expected, 1 ) )
+      {
+        front.push_back( neighbor );
+      }
+    }
+  }
+
+  boost::mutex::scoped_lock lock( this->front_mutex_ );
+  this->next_front_.insert( this->next_front_.end(), front.begin(), front.end() );
+}
+
+void MaskMorphologyPrivate::flip_front_range( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    this->data_[ this->front_[ j ] ] ^= this->value_;
+  }
+}
+
+bool MaskMorphologyPrivate::run_iterative( bool dilate, int radius )
+{
+  if ( radius <= 0 ) 
+  {
+    this->update_progress( 1.0 );
+    return true;
+  }
+
+  // The state is 0 for voxels that can still change and 1 for all others
+  std::vector< std::atomic< unsigned char > > state;
+  try
+  {
+    state = std::vector< std::atomic< unsigned char > >( this->size_ );
+  }
+  catch ( ... )
+  {
+    return false;
+  }
+
+  this->neighbor_dx_.clear();
+  this->neighbor_dy_.clear();
+  this->neighbor_dz_.clear();
+  for ( int dz = -1; dz <= 1; dz++ )
+  {
+    for ( int dy = -1; dy <= 1; dy++ )
+    {
+      for ( int dx = -1; dx <= 1; dx++ )
+      {
+        // Face and edge neighbors within the axes that are used
+        int steps = ( dx != 0 ) + ( dy != 0 ) + ( dz != 0 );
+        if ( steps == 0 || steps == 3 ) continue;
+        if ( ( dx != 0 && !this->use_axis( 0 ) ) || ( dy != 0 && !this->use_axis( 1 ) ) ||
+          ( dz != 0 && !this->use_axis( 2 ) ) ) continue;
+        this->neighbor_dx_.push_back( dx );
+        this->neighbor_dy_.push_back( dy );
+        this->neighbor_dz_.push_back( dz );
+      }
+    }
+  }
+
+  ThreadPool* pool = ThreadPool::Instance();
+  this->front_.clear();
+  this->next_front_.clear();
+
+  try
+  {
+    this->source_rows_.resize( this->ny_ * this->nz_ );
+  }
+  catch ( ... )
+  {
+    return false;
+  }
+
+  {
+    DataBlockLocks locks( MaskDataBlockHandle(), this->dst_, this->constraint_ );
+    this->read_mask_data();
+    pool->parallel_for( 0, this->ny_ * this->nz_, LINE_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::source_rows_range, this, dilate, _1, _2 ) );
+    pool->parallel_for( 0, this->ny_ * this->nz_, LINE_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::first_front_range, this, &state[ 0 ], dilate, _1, _2 ) );
+  }
+  std::vector< unsigned char >().swap( this->source_rows_ );
+
+  for ( int step = 1; ; step++ )
+  {
+    this->front_.swap( this->next_front_ );
+    this->next_front_.clear();
+
+    {
+      DataBlockLocks locks( this->dst_, this->constraint_ );
+      this->read_mask_data();
+      pool->parallel_for( 0, this->front_.size(), FRONT_GRAIN_C, boost::bind( 
+        &MaskMorphologyPrivate::flip_front_range, this, _1, _2 ) );
+    }
+
+    this->update_progress( static_cast< double >( step ) / static_cast< double >( radius ) );
+    if ( step == radius || this->front_.empty() ) break;
+    if ( this->check_abort() ) return false;
+
+    pool->parallel_for( 0, this->front_.size(), FRONT_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::next_front_range, this, &state[ 0 ], _1, _2 ) );
+  }
+
+  this->front_.clear();
+  this->next_front_.clear();
+  this->update_progress( 1.0 );
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class MaskMorphology
+//////////////////////////////////////////////////////////////////////////
+
+MaskMorphology::MaskMorphology() :
+  private_( new MaskMorphologyPrivate )
+{
+}
+
+MaskMorphology::~MaskMorphology()
+{
+}
+
+void MaskMorphology::set_constraint( MaskDataBlockHandle constraint, bool invert )
+{
+  this->private_->constraint_ = constraint;
+  this->private_->invert_constraint_ = invert;
+}
+
+void MaskMorphology::set_only2d( bool only2d, SliceType slice_type )
+{
+  this->private_->only2d_ = only2d;
+  this->private_->slice_type_ = slice_type;
+}
+
+void MaskMorphology::set_progress_function( boost::function< void ( double ) > progress )
+{
+  this->private_->progress_ = progress;
+}
+
+void MaskMorphology::set_abort_function( boost::function< bool () > check_abort )
+{
+  this->private_->check_abort_ = check_abort;
+}
+
+void MaskMorphology::add_dilate( MorphologyShapeType shape, int radius )
+{
+  this->private_->operations_.push_back( MaskMorphologyOperation( true, shape, radius ) );
+}
+
+void MaskMorphology::add_erode( MorphologyShapeType shape, int radius )
+{
+  this->private_->operations_.push_back( MaskMorphologyOperation( false, shape, radius ) );
+}
+
+bool MaskMorphology::run( MaskDataBlockHandle src, const GridTransform& grid_transform, 
+  MaskDataBlockHandle& dst )
+{
+  MaskMorphologyPrivate* priv = this->private_.get();
+  MaskDataBlockHandle constraint = priv->constraint_;
+
+  if ( constraint && ( constraint->get_nx() != src->get_nx() || 
+    constraint->get_ny() != src->get_ny() || constraint->get_nz() != src->get_nz() ) )
+  {
+    return false;
+  }
+
+  if ( !( MaskDataBlockManager::Create( grid_transform, dst ) ) ) return false;
+
+  priv->dst_ = dst;
+  priv->nx_ = dst->get_nx();
+  priv->ny_ = dst->get_ny();
+  priv->nz_ = dst->get_nz();
+  priv->size_ = dst->get_size();
+  priv->operation_ = 0;
+  priv->num_operations_ = std::max< size_t >( priv->operations_.size(), 1 );
+
+  {
+    DataBlockLocks locks( dst, src, constraint );
+    priv->read_mask_data();
+    ThreadPool::Instance()->parallel_for( 0, priv->size_, VOXEL_GRAIN_C, boost::bind( 
+      &MaskMorphologyPrivate::copy_range, priv, src, _1, _2 ) );
+  }
+
+  bool success = true;
+  for ( size_t j = 0; j < priv->operations_.size() && success && priv->size_ > 0; j++ )
+  {
+    priv->operation_ = j;
+    const MaskMorphologyOperation& operation = priv->operations_[ j ];
+
+    if ( operation.shape_ == MorphologyShapeType::ITERATIVE_E )
+    {
+      success = priv->run_iterative( operation.dilate_, operation.radius_ );
+      continue;
+    }
+
+    // Squared radius of the ball, the ITK ball includes voxels up to half a voxel further
+    unsigned long long radius = static_cast< unsigned long long >( 
+      std::max( operation.radius_, 0 ) );
+    unsigned long long threshold = radius * radius;
+    if ( operation.shape_ == MorphologyShapeType::SMOOTH_BALL_E ) threshold += radius;
+
+    if ( threshold < std::numeric_limits< unsigned short >::max() )
+    {
+      success = priv->run_ball< unsigned short >( operation.dilate_, 
+        static_cast< unsigned int >( threshold ) );
+    }
+    else if ( threshold < std::numeric_limits< unsigned int >::max() )
+    {
+      success = priv->run_ball< unsigned int >( operation.dilate_, 
+        static_cast< unsigned int >( threshold ) );
+    }
+    else
+    {
+      success = false;
+    }
+  }
+
+  priv->dst_.reset();
+  priv->data_ = 0;
+  priv->constraint_data_ = 0;
+
+  if ( !success ) dst.reset();
+  return success;
+}
+
+} // end namespace Core
@@ -0,0 +1,116 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_MASKMORPHOLOGY_H
+#define CORE_DATABLOCK_MASKMORPHOLOGY_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/Utils/EnumClass.h>
+#include <Core/Geometry/GridTransform.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/DataBlock/SliceType.h>
+
+namespace Core
+{
+
+// CLASS MorphologyShapeType:
+/// The structuring elements of the morphology engine
+CORE_ENUM_CLASS
+(
+  MorphologyShapeType,
+  /// All voxels within the radius, as the sphere pattern of the fast dilate and erode filters
+  BALL_E = 0,
+  /// All voxels within the radius plus half a voxel, as the ITK ball structuring element
+  SMOOTH_BALL_E,
+  /// The voxels that can be reached in radius steps to face and edge neighbors without
+  /// leaving the voxels that are allowed to change, as the iterative filters
+  ITERATIVE_E
+)
+
+class MaskMorphology;
+class MaskMorphologyPrivate;
+typedef boost::shared_ptr< MaskMorphologyPrivate > MaskMorphologyPrivateHandle;
+
+// CLASS MaskMorphology:
+/// Binary dilation and erosion of masks. The mask bit planes are read and written directly
+/// and all passes are split over the thread pool. The ball shapes are computed from a
+/// separable Euclidean distance transform and the iterative shape by a breadth first search
+/// from the edge of the mask, so the cost does not depend on the radius.
+class MaskMorphology : public boost::noncopyable
+{
+public:
+  MaskMorphology();
+  ~MaskMorphology();
+
+  // SET_CONSTRAINT:
+  /// Only change voxels that are inside the constraint mask, or outside it if invert is set.
+  void set_constraint( MaskDataBlockHandle constraint, bool invert );
+
+  // SET_ONLY2D:
+  /// Limit the structuring elements to the slices of the given orientation.
+  void set_only2d( bool only2d, SliceType slice_type );
+
+  // SET_PROGRESS_FUNCTION:
+  /// Function that is called with the fraction of the work that has been done.
+  void set_progress_function( boost::function< void ( double ) > progress );
+
+  // SET_ABORT_FUNCTION:
+  /// Function that is called in between passes, run stops if it returns true.
+  void set_abort_function( boost::function< bool () > check_abort );
+
+  // ADD_DILATE:
+  /// Add a dilation to the operations that run applies in order.
+  void add_dilate( MorphologyShapeType shape, int radius );
+
+  // ADD_ERODE:
+  /// Add an erosion to the operations that run applies in order.
+  void add_erode( MorphologyShapeType shape, int radius );
+
+  // RUN:
+  /// Apply the operations to a copy of src, which is stored in a new mask dst with the given
+  /// grid transform. Returns false if memory could not be allocated, if the constraint does
+  /// not have the size of src, or if the run was aborted.
+  bool run( MaskDataBlockHandle src, const GridTransform& grid_transform, 
+    MaskDataBlockHandle& dst );
+
+private:
+  MaskMorphologyPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
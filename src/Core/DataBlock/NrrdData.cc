@@ -35,6 +35,7 @@
 #include <Core/Math/MathFunctions.h>
 #include <Core/Geometry/GridTransform.h>
 #include <Core/DataBlock/NrrdData.h>
+#include <Core/DataBlock/RawVolumeReader.h>
 
 // Boost includes
 #include <boost/filesystem.hpp>
@@ -395,6 +396,26 @@ void NrrdData::set_histogram( const Histogram& histogram )
   }
 }
 
+void NrrdData::set_meta_data( const std::string& key, const std::string& value )
+{
+  if ( this->private_->nrrd_ )
+  {
+    nrrdKeyValueAdd( this->private_->nrrd_, key.c_str(), value.c_str() );
+  }
+}
+
+bool NrrdData::get_meta_data( const std::string& key, std::string& value ) const
+{
+  if ( !this->private_->nrrd_ ) return false;
+
+  char* nrrd_value = nrrdKeyValueGet( this->private_->nrrd_, key.c_str() );
+  if ( !nrrd_value ) return false;
+
+  value = nrrd_value;
+  free( nrrd_value );
+  return true;
+}
+
 Histogram NrrdData::get_histogram( bool trust_meta_data )
 {
   Histogram result;
@@ -504,7 +525,67 @@ bool NrrdData::get_originally_node_centered() const
 }
 
 
-bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, std::string& error )
+// LOADNRRDPAYLOAD:
+// Load the header of a nrrd with teem and read a raw or gzip payload that is attached to the
+// header in parallel. Returns false if the nrrd needs to be loaded by teem instead.
+static bool LoadNrrdPayload( Nrrd* nrrd, const std::string& filename,
+  boost::function< void ( double ) > progress )
+{
+  NrrdIoState* nio = nrrdIoStateNew();
+  nio->skipData = AIR_TRUE;
+  nio->keepNrrdDataFileOpen = AIR_TRUE;
+
+  if ( nrrdLoad( nrrd, filename.c_str(), nio ) )
+  {
+    biffDone( NRRD );
+    nrrdIoStateNix( nio );
+    return false;
+  }
+
+  // The header was parsed up to the start of the data
+  long long offset = -1;
+  if ( nio->dataFile )
+  {
+    offset = static_cast< long long >( ftell( nio->dataFile ) );
+    fclose( nio->dataFile );
+    nio->dataFile = 0;
+  }
+
+  bool gzip = nio->encoding == nrrdEncodingGzip;
+  bool attached = nio->dataFNFormat == 0 && nio->dataFNArr->len == 0;
+  bool supported = ( gzip || nio->encoding == nrrdEncodingRaw ) && attached && 
+    nio->lineSkip == 0 && nio->byteSkip == 0 && offset >= 0 && nrrd->type != nrrdTypeBlock;
+  bool swap_endian = nrrdElementSize( nrrd ) > 1 && nio->endian != airEndianUnknown &&
+    ( nio->endian == airEndianLittle ) != DataBlock::IsLittleEndian();
+  nrrdIoStateNix( nio );
+  if ( !supported ) return false;
+
+  // The values are copied as they are, hence only their size matters
+  DataType data_type = DataType::UCHAR_E;
+  switch ( nrrdElementSize( nrrd ) )
+  {
+    case 1: data_type = DataType::UCHAR_E; break;
+    case 2: data_type = DataType::USHORT_E; break;
+    case 4: data_type = DataType::UINT_E; break;
+    case 8: data_type = DataType::ULONGLONG_E; break;
+    default: return false;
+  }
+
+  size_t size = nrrdElementNumber( nrrd );
+  nrrd->data = malloc( size * nrrdElementSize( nrrd ) );
+  if ( nrrd->data == 0 ) return false;
+
+  RawVolumeReader reader;
+  reader.set_swap_endian( swap_endian );
+  reader.set_gzip( gzip );
+  if ( progress ) reader.set_progress_function( progress );
+
+  std::string error;
+  return reader.read( filename, offset, nrrd->data, data_type, size, error );
+}
+
+bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, std::string& error,
+  boost::function< void ( double ) > progress )
 {
   // Lock down the Teem library
   lock_type lock( GetMutex() );
@@ -527,7 +608,16 @@ bool NrrdData::LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata,
         return false;
     }
 
-  if ( nrrdLoad( nrrd, filename_only.c_str(), 0 ) )
+  // Raw and gzip payloads are read with the RawVolumeReader, so teem only needs to parse the
+  // header. Any other encoding or layout of the data is left to teem.
+  bool loaded = LoadNrrdPayload( nrrd, filename_only, progress );
+  if ( !loaded )
+  {
+    nrrdNuke( nrrd );
+    nrrd = nrrdNew();
+  }
+
+  if ( !loaded && nrrdLoad( nrrd, filename_only.c_str(), 0 ) )
   {
     char *err = biffGet( NRRD );
     error = std::string( "Could not open file: " ) + filename + " : " + std::string( err );
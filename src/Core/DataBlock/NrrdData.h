@@ -37,6 +37,7 @@
 #include <teem/nrrd.h>
 
 // Boost includes
+#include <boost/function.hpp>
 #include <boost/utility.hpp>
 #include <boost/smart_ptr.hpp>
 #include <boost/thread/mutex.hpp>
@@ -123,6 +124,14 @@ public:
   /// Insert a histogram into a nrrd's meta data
   void set_histogram( const Histogram& histogram );
 
+  // SET_META_DATA:
+  /// Insert a key value pair into a nrrd's meta data
+  void set_meta_data( const std::string& key, const std::string& value );
+
+  // GET_META_DATA:
+  /// Get a value from a nrrd's meta data, returns false if the key is not present
+  bool get_meta_data( const std::string& key, std::string& value ) const;
+
   // GET_NX, GET_NY, GET_NZ:
   /// Get the dimensions of the nrrd
   size_t get_nx() const;
@@ -152,9 +161,11 @@ private:
 public:
 
   // LOADNRRD:
-  /// Load a nrrd into the nrrd data structure
+  /// Load a nrrd into the nrrd data structure. The progress function is called with the
+  /// fraction of the data that has been read, if the payload is read by the raw volume reader.
   static bool LoadNrrd( const std::string& filename, NrrdDataHandle& nrrddata, 
-    std::string& error );
+    std::string& error, 
+    boost::function< void ( double ) > progress = boost::function< void ( double ) >() );
 
   // SAVENRRD:
   /// Save a nrrd to file from nrrd data structure
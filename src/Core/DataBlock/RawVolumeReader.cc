@@ -0,0 +1,435 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// NOTE: Windows needs its own positioned reads, the STL file streams of some versions of
+// Visual Studio do not support 64bit offsets.
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Zlib includes
+#include <zlib.h>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/DataBlock/DataBlockKernels.h>
+#include <Core/DataBlock/RawVolumeReader.h>
+
+namespace Core
+{
+
+// Size of the slabs in which the file is read. A slab is small enough to stay in the cache
+// while it is swapped and converted, and the kernels process it on the reading thread.
+static const size_t SLAB_SIZE_C = 1 << 20;
+
+//////////////////////////////////////////////////////////////////////////
+// Class RawVolumeReaderPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class RawVolumeReaderPrivate
+{
+public:
+  RawVolumeReaderPrivate() :
+    file_data_type_( DataType::UNKNOWN_E ),
+    swap_endian_( false ),
+    gzip_( false ),
+#ifdef _WIN32
+    file_( INVALID_HANDLE_VALUE ),
+#else
+    file_( -1 ),
+#endif
+    data_type_( DataType::UNKNOWN_E ),
+    source_type_( DataType::UNKNOWN_E ),
+    size_( 0 ),
+    offset_( 0 ),
+    bytes_read_( 0 ),
+    total_bytes_( 0 ),
+    reported_( 0.0 )
+  {
+  }
+
+  // OPEN_FILE:
+  // Open the file for reading and get its size
+  bool open_file( const std::string& filename, long long& file_size );
+
+  // CLOSE_FILE:
+  void close_file();
+
+  // READ_AT:
+  // Read size bytes at offset from the file, the file needs to be long enough
+  bool read_at( void* buffer, size_t size, long long offset );
+
+  // PROCESS_SLAB:
+  // Swap the values of a slab that was read and convert them into the destination
+  void process_slab( unsigned char* src, size_t first, size_t size );
+
+  // READ_SLABS:
+  // Read the slabs [ begin, end ) of the payload, this runs on the thread pool
+  void read_slabs( size_t begin, size_t end );
+
+  // READ_RAW:
+  bool read_raw( long long file_size, std::string& error );
+
+  // READ_GZIP:
+  bool read_gzip( long long file_size, std::string& error );
+
+  // UPDATE_PROGRESS:
+  // Account for bytes that were read and report the progress
+  void update_progress( size_t bytes );
+
+public:
+  DataType file_data_type_;
+  bool swap_endian_;
+  bool gzip_;
+  boost::function< void ( double ) > progress_;
+
+  // -- state of the current read --
+public:
+#ifdef _WIN32
+  HANDLE file_;
+#else
+  int file_;
+#endif
+
+  unsigned char* data_;
+  DataType data_type_;
+  DataType source_type_;
+  size_t size_;
+  long long offset_;
+
+  boost::mutex mutex_;
+  std::string error_;
+  size_t bytes_read_;
+  size_t total_bytes_;
+  double reported_;
+};
+
+bool RawVolumeReaderPrivate::open_file( const std::string& filename, long long& file_size )
+{
+#ifdef _WIN32
+  this->file_ = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, 
+    OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+  if ( this->file_ == INVALID_HANDLE_VALUE ) return false;
+
+  LARGE_INTEGER size;
+  if ( !GetFileSizeEx( this->file_, &size ) ) return false;
+  file_size = size.QuadPart;
+#else
+  this->file_ = open( filename.c_str(), O_RDONLY );
+  if ( this->file_ < 0 ) return false;
+
+  struct stat info;
+  if ( fstat( this->file_, &info ) != 0 ) return false;
+  file_size = static_cast< long long >( info.st_size );
+#endif
+  return true;
+}
+
+void RawVolumeReaderPrivate::close_file()
+{
+#ifdef _WIN32
+  if ( this->file_ != INVALID_HANDLE_VALUE ) CloseHandle( this->file_ );
+  this->file_ = INVALID_HANDLE_VALUE;
+#else
+  if ( this->file_ >= 0 ) close( this->file_ );
+  this->file_ = -1;
+#endif
+}
+
+bool RawVolumeReaderPrivate::read_at( void* buffer, size_t size, long long offset )
+{
+  char* ptr = static_cast< char* >( buffer );
+  while ( size > 0 )
+  {
+#ifdef _WIN32
+    // NOTE: ReadFile can only read 32bit sizes at once
+    DWORD chunk = static_cast< DWORD >( std::min( size, static_cast< size_t >( 1 << 30 ) ) );
+    OVERLAPPED overlapped;
+    memset( &overlapped, 0, sizeof( overlapped ) );
+    overlapped.Offset = static_cast< DWORD >( offset & 0xffffffff );
+    overlapped.OffsetHigh = static_cast< DWORD >( offset >> 32 );
+    DWORD bytes = 0;
+    if ( !ReadFile( this->file_, ptr, chunk, &bytes, &overlapped ) || bytes == 0 ) return false;
+#else
+    ssize_t bytes = pread( this->file_, ptr, size, static_cast< off_t >( offset ) );
+    if ( bytes < 0 && errno == EINTR ) continue;
+    if ( bytes <= 0 ) return false;
+#endif
+    ptr += bytes;
+    size -= static_cast< size_t >( bytes );
+    offset += bytes;
+  }
+  return true;
+}
+
+void RawVolumeReaderPrivate::process_slab( unsigned char* src, size_t first, size_t size )
+{
+  size_t src_elem_size = GetSizeDataType( this->source_type_ );
+  if ( this->swap_endian_ ) DataBlockKernels::SwapEndian( src, size, src_elem_size );
+
+  if ( this->source_type_ != this->data_type_ )
+  {
+    DataBlockKernels::Convert( src, this->source_type_, 
+      this->data_ + first * GetSizeDataType( this->data_type_ ), this->data_type_, size );
+  }
+}
+
+void RawVolumeReaderPrivate::update_progress( size_t bytes )
+{
+  if ( !this->progress_ ) return;
+
+  // Only report when the progress changed noticeably, every report goes to the interface
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  this->bytes_read_ += bytes;
+  double fraction = static_cast< double >( this->bytes_read_ ) / 
+    static_cast< double >( std::max( this->total_bytes_, static_cast< size_t >( 1 ) ) );
+  if ( fraction - this->reported_ >= 0.01 || this->bytes_read_ == this->total_bytes_ )
+  {
+    this->reported_ = fraction;
+    this->progress_( fraction );
+  }
+}
+
+void RawVolumeReaderPrivate::read_slabs( size_t begin, size_t end )
+{
+  size_t src_elem_size = GetSizeDataType( this->source_type_ );
+  size_t slab_size = SLAB_SIZE_C / src_elem_size;
+
+  // Values that need to be converted are read into a buffer that is reused for the slabs
+  // of this range, the others are read straight into the destination
+  std::vector< unsigned char > buffer;
+  if ( this->source_type_ != this->data_type_ ) buffer.resize( slab_size * src_elem_size );
+
+  for ( size_t j = begin; j < end; j++ )
+  {
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      if ( !this->error_.empty() ) return;
+    }
+
+    size_t first = j * slab_size;
+    size_t size = std::min( slab_size, this->size_ - first );
+    unsigned char* src = buffer.empty() ? this->data_ + first * src_elem_size : &buffer[ 0 ];
+
+    if ( !this->read_at( src, size * src_elem_size, 
+      this->offset_ + static_cast< long long >( first * src_elem_size ) ) )
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      this->error_ = "Could not read data from file.";
+      return;
+    }
+
+    this->process_slab( src, first, size );
+    this->update_progress( size * src_elem_size );
+  }
+}
+
+bool RawVolumeReaderPrivate::read_raw( long long file_size, std::string& error )
+{
+  if ( file_size - this->offset_ < static_cast< long long >( this->total_bytes_ ) )
+  {
+    error = "Incorrect length of file.";
+    return false;
+  }
+
+  size_t slab_size = SLAB_SIZE_C / GetSizeDataType( this->source_type_ );
+  size_t num_slabs = ( this->size_ + slab_size - 1 ) / slab_size;
+
+  // Every slab is a task, so slow reads do not hold up the other threads
+  ThreadPool::Instance()->parallel_for( 0, num_slabs, 1, 
+    boost::bind( &RawVolumeReaderPrivate::read_slabs, this, _1, _2 ) );
+
+  if ( !this->error_.empty() )
+  {
+    error = this->error_;
+    return false;
+  }
+  return true;
+}
+
+bool RawVolumeReaderPrivate::read_gzip( long long file_size, std::string& error )
+{
+  size_t src_elem_size = GetSizeDataType( this->source_type_ );
+  size_t slab_size = SLAB_SIZE_C / src_elem_size;
+
+  std::vector< unsigned char > input( SLAB_SIZE_C );
+  std::vector< unsigned char > buffer;
+  if ( this->source_type_ != this->data_type_ ) buffer.resize( slab_size * src_elem_size );
+
+  z_stream stream;
+  memset( &stream, 0, sizeof( stream ) );
+  // Accept both gzip and zlib headers
+  if ( inflateInit2( &stream, 15 + 32 ) != Z_OK )
+  {
+    error = "Could not initialize decompression.";
+    return false;
+  }
+
+  long long input_offset = this->offset_;
+  bool success = true;
+  for ( size_t first = 0; first < this->size_ && success; first += slab_size )
+  {
+    size_t size = std::min( slab_size, this->size_ - first );
+    unsigned char* src = buffer.empty() ? this->data_ + first * src_elem_size : &buffer[ 0 ];
+
+    // Inflate one slab of values and process it while it is in the cache
+    stream.next_out = src;
+    stream.avail_out = static_cast< uInt >( size * src_elem_size );
+    while ( stream.avail_out > 0 )
+    {
+      if ( stream.avail_in == 0 )
+      {
+        size_t input_size = static_cast< size_t >( std::min( 
+          static_cast< long long >( input.size() ), file_size - input_offset ) );
+        if ( input_size == 0 || !this->read_at( &input[ 0 ], input_size, input_offset ) )
+        {
+          error = "Compressed data is shorter than expected.";
+          success = false;
+          break;
+        }
+        input_offset += input_size;
+        stream.next_in = &input[ 0 ];
+        stream.avail_in = static_cast< uInt >( input_size );
+      }
+
+      int result = inflate( &stream, Z_NO_FLUSH );
+      if ( result == Z_STREAM_END && stream.avail_out > 0 )
+      {
+        // Files may consist of several gzip members
+        result = inflateReset( &stream );
+      }
+      if ( result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR )
+      {
+        error = "Could not decompress data.";
+        success = false;
+        break;
+      }
+    }
+
+    if ( success )
+    {
+      this->process_slab( src, first, size );
+      this->update_progress( size * src_elem_size );
+    }
+  }
+
+  inflateEnd( &stream );
+  return success;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class RawVolumeReader
+//////////////////////////////////////////////////////////////////////////
+
+RawVolumeReader::RawVolumeReader() :
+  private_( new RawVolumeReaderPrivate )
+{
+}
+
+RawVolumeReader::~RawVolumeReader()
+{
+}
+
+void RawVolumeReader::set_file_data_type( DataType data_type )
+{
+  this->private_->file_data_type_ = data_type;
+}
+
+void RawVolumeReader::set_swap_endian( bool swap_endian )
+{
+  this->private_->swap_endian_ = swap_endian;
+}
+
+void RawVolumeReader::set_gzip( bool gzip )
+{
+  this->private_->gzip_ = gzip;
+}
+
+void RawVolumeReader::set_progress_function( boost::function< void ( double ) > progress )
+{
+  this->private_->progress_ = progress;
+}
+
+bool RawVolumeReader::read( const std::string& filename, long long offset, void* data, 
+  DataType data_type, size_t size, std::string& error )
+{
+  RawVolumeReaderPrivate* p = this->private_.get();
+  p->data_ = static_cast< unsigned char* >( data );
+  p->data_type_ = data_type;
+  p->source_type_ = p->file_data_type_ == DataType::UNKNOWN_E ? data_type : p->file_data_type_;
+  p->size_ = size;
+  p->offset_ = offset;
+  p->error_.clear();
+  p->bytes_read_ = 0;
+  p->total_bytes_ = size * GetSizeDataType( p->source_type_ );
+  p->reported_ = 0.0;
+
+  if ( GetSizeDataType( p->source_type_ ) == 0 || GetSizeDataType( data_type ) == 0 ||
+    ( p->source_type_ != data_type && !IsInteger( p->source_type_ ) && 
+    !IsReal( p->source_type_ ) ) )
+  {
+    error = "Unsupported data type.";
+    return false;
+  }
+
+  long long file_size = 0;
+  if ( !p->open_file( filename, file_size ) )
+  {
+    p->close_file();
+    error = "Could not open file.";
+    return false;
+  }
+
+  bool success = p->gzip_ ? p->read_gzip( file_size, error ) : p->read_raw( file_size, error );
+  p->close_file();
+  return success;
+}
+
+bool RawVolumeReader::read( const std::string& filename, long long offset, 
+  DataBlockHandle data_block, std::string& error )
+{
+  return this->read( filename, offset, data_block->get_data(), data_block->get_data_type(),
+    data_block->get_size(), error );
+}
+
+} // end namespace Core
@@ -0,0 +1,100 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_DATABLOCK_RAWVOLUMEREADER_H
+#define CORE_DATABLOCK_RAWVOLUMEREADER_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <string>
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/DataBlock/DataType.h>
+#include <Core/DataBlock/DataBlock.h>
+
+namespace Core
+{
+
+class RawVolumeReader;
+class RawVolumeReaderPrivate;
+typedef boost::shared_ptr< RawVolumeReaderPrivate > RawVolumeReaderPrivateHandle;
+
+// CLASS RawVolumeReader:
+/// Reads the raw payload of a volume file straight into memory. The file is read in slabs
+/// with positioned reads on the thread pool, and every slab is swapped and converted to the
+/// destination type while it is still in the cache. Gzip compressed payloads are inflated
+/// slab by slab on the calling thread, as the stream can only be decoded in order.
+class RawVolumeReader : public boost::noncopyable
+{
+public:
+  RawVolumeReader();
+  ~RawVolumeReader();
+
+  // SET_FILE_DATA_TYPE:
+  /// Type of the values in the file, by default it is the type of the destination.
+  void set_file_data_type( DataType data_type );
+
+  // SET_SWAP_ENDIAN:
+  /// Whether the bytes of the values in the file need to be swapped.
+  void set_swap_endian( bool swap_endian );
+
+  // SET_GZIP:
+  /// Whether the payload is compressed with gzip or zlib.
+  void set_gzip( bool gzip );
+
+  // SET_PROGRESS_FUNCTION:
+  /// Function that is called with the fraction of the data that has been read. It is called
+  /// from the threads that read the file, but never from two threads at the same time.
+  void set_progress_function( boost::function< void ( double ) > progress );
+
+  // READ:
+  /// Read size values of data_type from the file, the payload starts at offset bytes into
+  /// the file. Returns false if the file could not be read or is too short.
+  bool read( const std::string& filename, long long offset, void* data, DataType data_type,
+    size_t size, std::string& error );
+
+  // READ:
+  /// Read the data of the data block from the file.
+  bool read( const std::string& filename, long long offset, DataBlockHandle data_block, 
+    std::string& error );
+
+private:
+  RawVolumeReaderPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include <Core/DataBlock/DataBlockDelta.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/StdDataBlock.h>
+
+using namespace Core;
+
+namespace
+{
+
+const size_t NX = 37;
+const size_t NY = 29;
+const size_t NZ = 11;
+
+DataBlockHandle CreateData()
+{
+  DataBlockHandle data = StdDataBlock::New( NX, NY, NZ, DataType::SHORT_E );
+  short* data_ptr = data->get_typed_data< short >();
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    data_ptr[ j ] = static_cast< short >( ( j * 7919 ) % 4001 - 2000 );
+  }
+  return data;
+}
+
+} // end anonymous namespace
+
+TEST( DataBlockDeltaTest, RestoresOldData )
+{
+  DataBlockHandle old_data = CreateData();
+  DataBlockHandle new_data;
+  ASSERT_TRUE( DataBlock::Duplicate( old_data, new_data ) );
+
+  // Change a few scattered values and one larger region
+  short* new_ptr = new_data->get_typed_data< short >();
+  new_ptr[ 0 ] = 1;
+  new_ptr[ 3 ] = 2;
+  new_ptr[ 500 ] += 1;
+  for ( size_t j = 4000; j < 4100; j++ ) new_ptr[ j ] = 0;
+  new_ptr[ new_data->get_size() - 1 ] = 3;
+
+  DataBlockDeltaHandle delta;
+  ASSERT_TRUE( DataBlockDelta::Create( old_data, new_data, delta ) );
+  EXPECT_FALSE( delta->empty() );
+  EXPECT_LT( delta->get_byte_size(), new_data->get_byte_size() / 4 );
+
+  ASSERT_TRUE( delta->apply( new_data ) );
+  EXPECT_EQ( 0, std::memcmp( old_data->get_data(), new_data->get_data(), 
+    old_data->get_byte_size() ) );
+
+  // The data now is the old version, which the delta cannot be applied to
+  EXPECT_FALSE( delta->apply( new_data ) );
+}
+
+TEST( DataBlockDeltaTest, RejectsDifferentData )
+{
+  DataBlockHandle old_data = CreateData();
+  DataBlockHandle new_data = CreateData();
+  DataBlockDeltaHandle delta;
+  ASSERT_TRUE( DataBlockDelta::Create( old_data, new_data, delta ) );
+  EXPECT_TRUE( delta->empty() );
+
+  EXPECT_FALSE( DataBlockDelta::Create( old_data, 
+    StdDataBlock::New( NX, NY, NZ, DataType::INT_E ), delta ) );
+  EXPECT_FALSE( DataBlockDelta::Create( old_data, 
+    StdDataBlock::New( NX + 1, NY, NZ, DataType::SHORT_E ), delta ) );
+}
+
+TEST( DataBlockDeltaTest, RestoresOldMask )
+{
+  GridTransform grid_transform( NX, NY, NZ );
+  MaskDataBlockHandle old_mask, new_mask;
+  ASSERT_TRUE( MaskDataBlockManager::Create( grid_transform, old_mask ) );
+  for ( size_t j = 0; j < old_mask->get_size(); j++ )
+  {
+    if ( ( j / 13 ) % 3 == 0 ) old_mask->set_mask_at( j );
+  }
+  ASSERT_TRUE( MaskDataBlockManager::Duplicate( old_mask, grid_transform, new_mask ) );
+
+  // Paint a block and erase a few voxels
+  for ( size_t z = 2; z < 5; z++ )
+  {
+    for ( size_t y = 3; y < 9; y++ )
+    {
+      for ( size_t x = 10; x < 20; x++ ) new_mask->set_mask_at( x, y, z );
+    }
+  }
+  new_mask->clear_mask_at( 0 );
+  new_mask->clear_mask_at( new_mask->get_size() - 14 );
+
+  DataBlockDeltaHandle delta;
+  ASSERT_TRUE( DataBlockDelta::Create( old_mask, new_mask, delta ) );
+  EXPECT_FALSE( delta->empty() );
+
+  ASSERT_TRUE( delta->apply( new_mask ) );
+  for ( size_t j = 0; j < old_mask->get_size(); j++ )
+  {
+    ASSERT_EQ( old_mask->get_mask_at( j ), new_mask->get_mask_at( j ) ) << "voxel " << j;
+  }
+
+  EXPECT_FALSE( delta->apply( new_mask ) );
+}
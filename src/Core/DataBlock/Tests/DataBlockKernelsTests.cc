@@ -0,0 +1,318 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <Core/DataBlock/DataBlockKernels.h>
+
+using namespace Core;
+
+namespace
+{
+
+const DataType DATA_TYPES[] = 
+{
+  DataType::CHAR_E, DataType::UCHAR_E, DataType::SHORT_E, DataType::USHORT_E,
+  DataType::INT_E, DataType::UINT_E, DataType::FLOAT_E, DataType::DOUBLE_E
+};
+
+const size_t NUM_DATA_TYPES = sizeof( DATA_TYPES ) / sizeof( DataType );
+
+// Odd size, so both the vector loops and the remainders are used
+const size_t TEST_SIZE = 1037;
+
+// Fill an array with values between min and max that every type can represent exactly
+std::vector< unsigned char > GenerateData( DataType data_type, size_t size, int min, int max, 
+  bool fractions = true )
+{
+  std::vector< double > values( size );
+  for ( size_t j = 0; j < size; j++ )
+  {
+    values[ j ] = min + static_cast< double >( ( j * 7919 ) % ( max - min + 1 ) );
+    if ( fractions && IsReal( data_type ) ) values[ j ] += 0.25 * ( j % 4 );
+  }
+
+  std::vector< unsigned char > data( size * GetSizeDataType( data_type ) );
+  DataBlockKernels::SetInstructionSet( InstructionSetType::SCALAR_E );
+  DataBlockKernels::Convert( &values[ 0 ], DataType::DOUBLE_E, &data[ 0 ], data_type, size );
+  DataBlockKernels::SetInstructionSet( DataBlockKernels::GetSupportedInstructionSet() );
+  return data;
+}
+
+// Instruction sets that can be tested on this processor
+std::vector< InstructionSetType > VectorInstructionSets()
+{
+  std::vector< InstructionSetType > instruction_sets;
+  if ( DataBlockKernels::GetSupportedInstructionSet() >= InstructionSetType::SSE2_E )
+  {
+    instruction_sets.push_back( InstructionSetType::SSE2_E );
+  }
+  if ( DataBlockKernels::GetSupportedInstructionSet() >= InstructionSetType::AVX2_E )
+  {
+    instruction_sets.push_back( InstructionSetType::AVX2_E );
+  }
+  return instruction_sets;
+}
+
+class DataBlockKernelsTest : public ::testing::Test 
+{
+protected:
+  virtual void TearDown()
+  {
+    DataBlockKernels::SetInstructionSet( DataBlockKernels::GetSupportedInstructionSet() );
+  }
+};
+
+}
+
+TEST_F( DataBlockKernelsTest, ConvertMatchesScalar )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+
+  for ( size_t s = 0; s < NUM_DATA_TYPES; s++ )
+  {
+    DataType src_type = DATA_TYPES[ s ];
+    // Negative values only where every destination of the same signedness can hold them
+    std::vector< unsigned char > src = GenerateData( src_type, TEST_SIZE, 0, 120 );
+
+    for ( size_t d = 0; d < NUM_DATA_TYPES; d++ )
+    {
+      DataType dst_type = DATA_TYPES[ d ];
+      size_t dst_bytes = TEST_SIZE * GetSizeDataType( dst_type );
+      
+      std::vector< unsigned char > expected( dst_bytes );
+      DataBlockKernels::SetInstructionSet( InstructionSetType::SCALAR_E );
+      ASSERT_TRUE( DataBlockKernels::Convert( &src[ 0 ], src_type, &expected[ 0 ], dst_type, 
+        TEST_SIZE ) );
+
+      for ( size_t k = 0; k < instruction_sets.size(); k++ )
+      {
+        std::vector< unsigned char > result( dst_bytes );
+        DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+        ASSERT_TRUE( DataBlockKernels::Convert( &src[ 0 ], src_type, &result[ 0 ], dst_type, 
+          TEST_SIZE ) );
+        EXPECT_TRUE( result == expected ) << "from " << ExportToString( src_type ) << " to " <<
+          ExportToString( dst_type ) << " with instruction set " << int( instruction_sets[ k ] );
+      }
+    }
+  }
+}
+
+TEST_F( DataBlockKernelsTest, ConvertNegativeAndExtremeValues )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+
+  float floats[] = { -128.0f, -127.9f, -1.5f, -0.5f, 0.0f, 0.5f, 127.9f, 1e9f, -1e9f, 
+    32767.5f, -32768.0f, 4294967295.0f };
+  const size_t num_floats = sizeof( floats ) / sizeof( float );
+  std::vector< float > src( TEST_SIZE );
+  for ( size_t j = 0; j < TEST_SIZE; j++ ) src[ j ] = floats[ j % num_floats ] * ( j % 2 ? 1 : -1 );
+
+  // Float to the signed types, clipped to the range of each
+  const DataType signed_types[] = { DataType::CHAR_E, DataType::SHORT_E, DataType::INT_E };
+  const double limits[] = { 127.0, 32767.0, 2147483520.0 };
+  for ( size_t d = 0; d < 3; d++ )
+  {
+    std::vector< float > clipped( src );
+    for ( size_t j = 0; j < TEST_SIZE; j++ )
+    {
+      clipped[ j ] = static_cast< float >( std::max( -limits[ d ], 
+        std::min( limits[ d ], static_cast< double >( clipped[ j ] ) ) ) );
+    }
+
+    size_t dst_bytes = TEST_SIZE * GetSizeDataType( signed_types[ d ] );
+    std::vector< unsigned char > expected( dst_bytes );
+    DataBlockKernels::SetInstructionSet( InstructionSetType::SCALAR_E );
+    DataBlockKernels::Convert( &clipped[ 0 ], DataType::FLOAT_E, &expected[ 0 ], 
+      signed_types[ d ], TEST_SIZE );
+
+    for ( size_t k = 0; k < instruction_sets.size(); k++ )
+    {
+      std::vector< unsigned char > result( dst_bytes );
+      DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+      DataBlockKernels::Convert( &clipped[ 0 ], DataType::FLOAT_E, &result[ 0 ], 
+        signed_types[ d ], TEST_SIZE );
+      EXPECT_TRUE( result == expected ) << ExportToString( signed_types[ d ] );
+    }
+  }
+
+  // Large unsigned integers need all 32 bits in the conversion to float
+  std::vector< unsigned int > large( TEST_SIZE );
+  for ( size_t j = 0; j < TEST_SIZE; j++ ) large[ j ] = 0xFFFFFFFFu - static_cast< unsigned int >( j * 4099 );
+  std::vector< float > expected( TEST_SIZE );
+  for ( size_t j = 0; j < TEST_SIZE; j++ ) expected[ j ] = static_cast< float >( large[ j ] );
+  for ( size_t k = 0; k < instruction_sets.size(); k++ )
+  {
+    std::vector< float > result( TEST_SIZE );
+    DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+    DataBlockKernels::Convert( &large[ 0 ], DataType::UINT_E, &result[ 0 ], DataType::FLOAT_E, 
+      TEST_SIZE );
+    EXPECT_TRUE( result == expected );
+  }
+}
+
+TEST_F( DataBlockKernelsTest, QuantizeMatchesScalar )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+  const DataType quantize_types[] = { DataType::CHAR_E, DataType::UCHAR_E, DataType::SHORT_E, 
+    DataType::USHORT_E, DataType::INT_E, DataType::UINT_E };
+
+  for ( size_t s = 0; s < NUM_DATA_TYPES; s++ )
+  {
+    DataType src_type = DATA_TYPES[ s ];
+    std::vector< unsigned char > src = GenerateData( src_type, TEST_SIZE, 3, 117 );
+
+    for ( size_t d = 0; d < 6; d++ )
+    {
+      DataType dst_type = quantize_types[ d ];
+      size_t dst_bytes = TEST_SIZE * GetSizeDataType( dst_type );
+      
+      std::vector< unsigned char > expected( dst_bytes );
+      DataBlockKernels::SetInstructionSet( InstructionSetType::SCALAR_E );
+      ASSERT_TRUE( DataBlockKernels::Quantize( &src[ 0 ], src_type, &expected[ 0 ], dst_type, 
+        TEST_SIZE, 3.0, 118.0 ) );
+
+      for ( size_t k = 0; k < instruction_sets.size(); k++ )
+      {
+        std::vector< unsigned char > result( dst_bytes );
+        DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+        ASSERT_TRUE( DataBlockKernels::Quantize( &src[ 0 ], src_type, &result[ 0 ], dst_type, 
+          TEST_SIZE, 3.0, 118.0 ) );
+        EXPECT_TRUE( result == expected ) << "from " << ExportToString( src_type ) << " to " <<
+          ExportToString( dst_type );
+      }
+    }
+  }
+
+  unsigned char dst[ 4 ];
+  float src[ 4 ] = { 0.0f, 1.0f, 2.0f, 3.0f };
+  EXPECT_FALSE( DataBlockKernels::Quantize( src, DataType::FLOAT_E, dst, DataType::FLOAT_E, 
+    4, 0.0, 3.0 ) );
+}
+
+TEST_F( DataBlockKernelsTest, SwapEndian )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+  instruction_sets.insert( instruction_sets.begin(), InstructionSetType::SCALAR_E );
+  
+  const size_t elem_sizes[] = { 2, 4, 8, 3 };
+  for ( size_t e = 0; e < 4; e++ )
+  {
+    size_t elem_size = elem_sizes[ e ];
+    std::vector< unsigned char > data( TEST_SIZE * elem_size );
+    for ( size_t j = 0; j < data.size(); j++ ) data[ j ] = static_cast< unsigned char >( j * 31 );
+
+    for ( size_t k = 0; k < instruction_sets.size(); k++ )
+    {
+      std::vector< unsigned char > swapped( data );
+      DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+      DataBlockKernels::SwapEndian( &swapped[ 0 ], TEST_SIZE, elem_size );
+      for ( size_t j = 0; j < data.size(); j++ )
+      {
+        size_t elem = j / elem_size;
+        size_t byte = j % elem_size;
+        ASSERT_EQ( data[ elem * elem_size + elem_size - 1 - byte ], swapped[ j ] ) << 
+          "element size " << elem_size;
+      }
+    }
+  }
+}
+
+TEST_F( DataBlockKernelsTest, ComputeMinMax )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+  instruction_sets.insert( instruction_sets.begin(), InstructionSetType::SCALAR_E );
+  
+  for ( size_t s = 0; s < NUM_DATA_TYPES; s++ )
+  {
+    DataType data_type = DATA_TYPES[ s ];
+    bool is_signed = data_type != DataType::UCHAR_E && data_type != DataType::USHORT_E &&
+      data_type != DataType::UINT_E;
+    std::vector< unsigned char > data = GenerateData( data_type, TEST_SIZE, 
+      is_signed ? -100 : 20, 100, false );
+    
+    for ( size_t k = 0; k < instruction_sets.size(); k++ )
+    {
+      DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+      double min = 0.0, max = 0.0;
+      ASSERT_TRUE( DataBlockKernels::ComputeMinMax( &data[ 0 ], data_type, TEST_SIZE, min, max ) );
+      EXPECT_EQ( is_signed ? -100.0 : 20.0, min ) << ExportToString( data_type );
+      EXPECT_EQ( 100.0, max ) << ExportToString( data_type );
+    }
+  }
+}
+
+TEST_F( DataBlockKernelsTest, ComputeMinMaxSkipsNonFinite )
+{
+  std::vector< InstructionSetType > instruction_sets = VectorInstructionSets();
+  instruction_sets.insert( instruction_sets.begin(), InstructionSetType::SCALAR_E );
+
+  std::vector< float > data( TEST_SIZE );
+  for ( size_t j = 0; j < TEST_SIZE; j++ ) data[ j ] = -1000.0f - static_cast< float >( j % 17 );
+  data[ 3 ] = std::numeric_limits< float >::quiet_NaN();
+  data[ 200 ] = std::numeric_limits< float >::infinity();
+  data[ 201 ] = -std::numeric_limits< float >::infinity();
+  data[ TEST_SIZE - 1 ] = std::numeric_limits< float >::quiet_NaN();
+
+  std::vector< double > nans( 9, std::numeric_limits< double >::quiet_NaN() );
+
+  for ( size_t k = 0; k < instruction_sets.size(); k++ )
+  {
+    DataBlockKernels::SetInstructionSet( instruction_sets[ k ] );
+    double min = 0.0, max = 0.0;
+    ASSERT_TRUE( DataBlockKernels::ComputeMinMax( &data[ 0 ], DataType::FLOAT_E, TEST_SIZE, 
+      min, max ) );
+    EXPECT_EQ( -1016.0, min );
+    EXPECT_EQ( -1000.0, max );
+    EXPECT_FALSE( DataBlockKernels::ComputeMinMax( &nans[ 0 ], DataType::DOUBLE_E, nans.size(), 
+      min, max ) );
+  }
+}
+
+TEST_F( DataBlockKernelsTest, LargeArraysUseThreadPool )
+{
+  const size_t size = ( 1 << 22 ) + 5;
+  std::vector< unsigned short > data( size );
+  for ( size_t j = 0; j < size; j++ ) data[ j ] = static_cast< unsigned short >( 1000 + j % 5000 );
+  data[ size - 2 ] = 7;
+  data[ 12345 ] = 65535;
+
+  double min = 0.0, max = 0.0;
+  ASSERT_TRUE( DataBlockKernels::ComputeMinMax( &data[ 0 ], DataType::USHORT_E, size, min, max ) );
+  EXPECT_EQ( 7.0, min );
+  EXPECT_EQ( 65535.0, max );
+
+  std::vector< float > converted( size );
+  ASSERT_TRUE( DataBlockKernels::Convert( &data[ 0 ], DataType::USHORT_E, &converted[ 0 ], 
+    DataType::FLOAT_E, size ) );
+  for ( size_t j = 0; j < size; j++ ) ASSERT_EQ( static_cast< float >( data[ j ] ), converted[ j ] );
+}
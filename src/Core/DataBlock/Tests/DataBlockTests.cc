@@ -104,3 +104,46 @@ TEST_F(DataBlockTest, SetData)
   EXPECT_EQ(dataBlock_->get_nz(), 3);
 }
 
+
+class SumFunctor
+{
+public:
+  SumFunctor() : sum_(0.0), size_(0) {}
+
+  template< class T >
+  void operator()(T* data, size_t size)
+  {
+    for (size_t j = 0; j < size; j++) sum_ += data[j];
+    size_ += size;
+  }
+
+  double sum_;
+  size_t size_;
+};
+
+TEST_F(DataBlockTest, TypedDataAccess)
+{
+  std::vector<short> vec = generate3x3x3Data<short>();
+  short* data = new short[27];
+  std::copy(vec.begin(), vec.end(), data);
+
+  dataBlock_->set_data(reinterpret_cast<void*>(data));
+  dataBlock_->update_data_type(DataType::SHORT_E);
+  dataBlock_->set_size(3, 3, 3);
+
+  EXPECT_EQ(dataBlock_->get_typed_data<short>(), data);
+  EXPECT_TRUE(dataBlock_->get_typed_data<unsigned short>() == 0);
+  EXPECT_TRUE(dataBlock_->get_typed_data<float>() == 0);
+
+  SumFunctor functor;
+  ASSERT_TRUE(dataBlock_->visit(functor));
+  EXPECT_EQ(functor.size_, 27);
+  EXPECT_EQ(functor.sum_, 351.0);
+
+  dataBlock_->update_data_type(DataType::UNKNOWN_E);
+  SumFunctor unknown;
+  EXPECT_FALSE(dataBlock_->visit(unknown));
+
+  dataBlock_->set_data(0);
+  delete [] data;
+}
@@ -0,0 +1,165 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <Core/DataBlock/Histogram.h>
+
+using namespace Core;
+
+namespace
+{
+
+// More values than one task of the histogram handles, so the partial histograms are merged
+const size_t TEST_SIZE = ( 1 << 21 ) + 13;
+
+template< class T >
+std::vector< T > GenerateData( size_t size, int min, int max )
+{
+  std::vector< T > data( size );
+  for ( size_t j = 0; j < size; j++ )
+  {
+    data[ j ] = static_cast< T >( min + static_cast< int >( ( j * 7919 ) % ( max - min + 1 ) ) );
+  }
+  return data;
+}
+
+template< class T >
+size_t TotalCount( const Histogram& histogram )
+{
+  return std::accumulate( histogram.get_bins().begin(), histogram.get_bins().end(), 
+    static_cast< size_t >( 0 ) );
+}
+
+template< class T >
+void ExpectUpdateMatchesCompute( int min, int max )
+{
+  // The ends of the range only occur outside the part that changes
+  std::vector< T > data = GenerateData< T >( 4096, min + 1, max - 1 );
+  data[ 0 ] = static_cast< T >( min );
+  data[ 1 ] = static_cast< T >( max );
+  Histogram histogram( &data[ 0 ], data.size() );
+
+  // Replace a range with other values from inside the range of the data
+  std::vector< T > old_values( data.begin() + 1000, data.begin() + 1500 );
+  for ( size_t j = 1000; j < 1500; j++ ) data[ j ] = static_cast< T >( min + 1 + static_cast< int >( j % 3 ) );
+  ASSERT_TRUE( histogram.update( &old_values[ 0 ], &data[ 1000 ], old_values.size() ) );
+
+  Histogram expected( &data[ 0 ], data.size() );
+  EXPECT_EQ( expected.get_min(), histogram.get_min() );
+  EXPECT_EQ( expected.get_max(), histogram.get_max() );
+  EXPECT_EQ( expected.get_bin_start(), histogram.get_bin_start() );
+  EXPECT_EQ( expected.get_bin_size(), histogram.get_bin_size() );
+  EXPECT_TRUE( expected.get_bins() == histogram.get_bins() );
+  EXPECT_EQ( expected.get_min_bin(), histogram.get_min_bin() );
+  EXPECT_EQ( expected.get_max_bin(), histogram.get_max_bin() );
+
+  // Values beyond the range need a new histogram
+  Histogram unchanged( histogram );
+  old_values.assign( data.begin(), data.begin() + 10 );
+  std::vector< T > new_values( 10, static_cast< T >( max + 1 ) );
+  EXPECT_FALSE( histogram.update( &old_values[ 0 ], &new_values[ 0 ], new_values.size() ) );
+  EXPECT_TRUE( unchanged.get_bins() == histogram.get_bins() );
+}
+
+}
+
+TEST( HistogramTest, CountsEveryValue )
+{
+  std::vector< unsigned char > uchar_data = GenerateData< unsigned char >( TEST_SIZE, 10, 200 );
+  Histogram uchar_histogram( &uchar_data[ 0 ], uchar_data.size() );
+  EXPECT_EQ( 10.0, uchar_histogram.get_min() );
+  EXPECT_EQ( 200.0, uchar_histogram.get_max() );
+  EXPECT_EQ( 191u, uchar_histogram.get_size() );
+  EXPECT_EQ( TEST_SIZE, TotalCount< unsigned char >( uchar_histogram ) );
+
+  std::vector< short > short_data = GenerateData< short >( TEST_SIZE, -3000, 2000 );
+  Histogram short_histogram( &short_data[ 0 ], short_data.size() );
+  EXPECT_EQ( -3000.0, short_histogram.get_min() );
+  EXPECT_EQ( 2000.0, short_histogram.get_max() );
+  EXPECT_EQ( 256u, short_histogram.get_size() );
+  EXPECT_EQ( TEST_SIZE, TotalCount< short >( short_histogram ) );
+
+  std::vector< int > int_data = GenerateData< int >( TEST_SIZE, -100000, 70000 );
+  Histogram int_histogram( &int_data[ 0 ], int_data.size() );
+  EXPECT_EQ( -100000.0, int_histogram.get_min() );
+  EXPECT_EQ( 70000.0, int_histogram.get_max() );
+  EXPECT_EQ( TEST_SIZE, TotalCount< int >( int_histogram ) );
+
+  std::vector< float > float_data = GenerateData< float >( TEST_SIZE, -50, -10 );
+  float_data[ 17 ] = std::numeric_limits< float >::quiet_NaN();
+  float_data[ 18 ] = std::numeric_limits< float >::infinity();
+  Histogram float_histogram( &float_data[ 0 ], float_data.size() );
+  EXPECT_EQ( -50.0, float_histogram.get_min() );
+  EXPECT_EQ( -10.0, float_histogram.get_max() );
+  EXPECT_EQ( TEST_SIZE - 2, TotalCount< float >( float_histogram ) );
+}
+
+TEST( HistogramTest, UpdateMatchesCompute )
+{
+  ExpectUpdateMatchesCompute< signed char >( -100, 100 );
+  ExpectUpdateMatchesCompute< unsigned char >( 0, 200 );
+  ExpectUpdateMatchesCompute< short >( -3000, 2000 );
+  ExpectUpdateMatchesCompute< unsigned short >( 10, 60000 );
+  ExpectUpdateMatchesCompute< int >( -100000, 70000 );
+  ExpectUpdateMatchesCompute< unsigned int >( 5, 200 );
+  ExpectUpdateMatchesCompute< float >( -500, 700 );
+  ExpectUpdateMatchesCompute< double >( -500, 700 );
+}
+
+TEST( HistogramTest, UpdateDetectsSmallerRange )
+{
+  std::vector< unsigned char > data( 100, 50 );
+  data[ 10 ] = 5;
+  Histogram histogram( &data[ 0 ], data.size() );
+
+  // Removing the only minimum changes the range
+  unsigned char old_value = 5;
+  unsigned char new_value = 50;
+  EXPECT_FALSE( histogram.update( &old_value, &new_value, 1 ) );
+
+  // Removing one of several minima does not
+  data[ 11 ] = 5;
+  histogram.compute( &data[ 0 ], data.size() );
+  EXPECT_TRUE( histogram.update( &old_value, &new_value, 1 ) );
+  EXPECT_EQ( 5.0, histogram.get_min() );
+  EXPECT_EQ( 1u, histogram.get_bins()[ 0 ] );
+
+  // For floating point data the bins do not tell whether the minimum is still there
+  std::vector< float > float_data( 100, 50.0f );
+  float_data[ 10 ] = 5.0f;
+  float_data[ 11 ] = 5.0f;
+  Histogram float_histogram( &float_data[ 0 ], float_data.size() );
+  float old_float = 5.0f;
+  float new_float = 50.0f;
+  EXPECT_FALSE( float_histogram.update( &old_float, &new_float, 1 ) );
+}
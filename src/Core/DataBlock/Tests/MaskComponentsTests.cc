@@ -0,0 +1,308 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskComponents.h>
+#include <Core/DataBlock/StdDataBlock.h>
+
+using namespace Core;
+
+namespace
+{
+
+const int NX = 29;
+const int NY = 17;
+const int NZ = 11;
+
+// Shells, bars that only touch at edges and scattered voxels, so components join in both
+// directions and only face neighbors are connected
+bool ShapeAt( int x, int y, int z )
+{
+  int dx = x - 10, dy = y - 8, dz = z - 5;
+  int r = dx * dx + dy * dy + 2 * dz * dz;
+  if ( r < 12 || ( r >= 30 && r < 50 ) ) return true;
+  if ( x >= 22 && ( x + y ) % 4 == 0 ) return true;
+  return ( x * 7 + y * 13 + z * 5 ) % 37 == 0;
+}
+
+bool ConstraintAt( int x, int /*y*/, int z )
+{
+  return ( x + z ) % 9 != 4;
+}
+
+MaskDataBlockHandle CreateMask( bool ( *function )( int, int, int ) )
+{
+  MaskDataBlockHandle mask;
+  MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), mask );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        if ( function( x, y, z ) ) mask->set_mask_at( x, y, z );
+        else mask->clear_mask_at( x, y, z );
+      }
+  return mask;
+}
+
+// Label the voxels one at a time with a breadth first search over the face neighbors
+std::vector< size_t > LabelVoxels( const std::vector< bool >& inside, size_t& num_components )
+{
+  std::vector< size_t > labels( inside.size(), MaskComponents::NO_COMPONENT_C );
+  num_components = 0;
+  for ( size_t start = 0; start < inside.size(); start++ )
+  {
+    if ( !inside[ start ] || labels[ start ] != MaskComponents::NO_COMPONENT_C ) continue;
+    std::vector< size_t > front( 1, start );
+    labels[ start ] = num_components;
+    while ( !front.empty() )
+    {
+      size_t index = front.back();
+      front.pop_back();
+      int x = static_cast< int >( index % NX );
+      int y = static_cast< int >( ( index / NX ) % NY );
+      int z = static_cast< int >( index / ( NX * NY ) );
+      int offsets[ 6 ][ 3 ] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, 
+        { 0, 0, -1 }, { 0, 0, 1 } };
+      for ( int j = 0; j < 6; j++ )
+      {
+        int px = x + offsets[ j ][ 0 ], py = y + offsets[ j ][ 1 ], pz = z + offsets[ j ][ 2 ];
+        if ( px < 0 || px >= NX || py < 0 || py >= NY || pz < 0 || pz >= NZ ) continue;
+        size_t neighbor = px + NX * ( py + NY * pz );
+        if ( !inside[ neighbor ] || labels[ neighbor ] != MaskComponents::NO_COMPONENT_C ) 
+          continue;
+        labels[ neighbor ] = num_components;
+        front.push_back( neighbor );
+      }
+    }
+    num_components++;
+  }
+  return labels;
+}
+
+std::vector< bool > InsideVoxels( bool ( *function )( int, int, int ), 
+  bool ( *constraint )( int, int, int ) )
+{
+  std::vector< bool > inside( NX * NY * NZ );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        inside[ x + NX * ( y + NY * z ) ] = function( x, y, z ) && 
+          ( constraint == 0 || constraint( x, y, z ) );
+      }
+  return inside;
+}
+
+void CountUpdate( int* num_updates )
+{
+  ( *num_updates )++;
+}
+
+void ExpectSameLabels( const MaskComponents& components, const std::vector< size_t >& labels, 
+  size_t num_components )
+{
+  ASSERT_EQ( num_components, components.get_num_components() );
+  std::vector< size_t > sizes( num_components, 0 );
+  for ( size_t j = 0; j < labels.size(); j++ )
+  {
+    ASSERT_EQ( labels[ j ], components.get_component( j ) ) << "voxel " << j;
+    if ( labels[ j ] != MaskComponents::NO_COMPONENT_C ) sizes[ labels[ j ] ]++;
+  }
+  EXPECT_EQ( sizes, components.get_component_sizes() );
+}
+
+} // end namespace
+
+TEST( MaskComponentsTest, MatchesBreadthFirstLabels )
+{
+  MaskDataBlockHandle mask = CreateMask( &ShapeAt );
+
+  MaskComponents components;
+  ASSERT_TRUE( components.compute( mask ) );
+
+  size_t num_components;
+  std::vector< size_t > labels = LabelVoxels( InsideVoxels( &ShapeAt, 0 ), num_components );
+  EXPECT_GT( num_components, 3u );
+  ExpectSameLabels( components, labels, num_components );
+}
+
+TEST( MaskComponentsTest, Constraints )
+{
+  MaskDataBlockHandle mask = CreateMask( &ShapeAt );
+  MaskDataBlockHandle constraint_mask = CreateMask( &ConstraintAt );
+
+  // The data range keeps all voxels but the ones with z == 7
+  DataBlockHandle data = StdDataBlock::New( NX, NY, NZ, DataType::FLOAT_E );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ ) data->set_data_at( x, y, z, z == 7 ? 2.5 : 0.5 );
+
+  MaskRegionConstraint constraint;
+  constraint.add_mask( constraint_mask, true );
+  constraint.set_data_range( data, 2.0, 3.0, true );
+
+  MaskComponents components;
+  ASSERT_TRUE( components.compute( mask, constraint ) );
+
+  std::vector< bool > inside = InsideVoxels( &ShapeAt, 0 );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        if ( ConstraintAt( x, y, z ) || z == 7 ) inside[ x + NX * ( y + NY * z ) ] = false;
+      }
+
+  size_t num_components;
+  std::vector< size_t > labels = LabelVoxels( inside, num_components );
+  ExpectSameLabels( components, labels, num_components );
+
+  // A constraint of the wrong size is an error
+  MaskRegionConstraint wrong_size;
+  wrong_size.set_data_range( StdDataBlock::New( NX, NY, NZ + 1, DataType::UCHAR_E ), 
+    0.0, 1.0, false );
+  EXPECT_FALSE( components.compute( mask, wrong_size ) );
+}
+
+TEST( MaskComponentsTest, FillMaskAndData )
+{
+  MaskDataBlockHandle mask = CreateMask( &ShapeAt );
+  MaskComponents components;
+  ASSERT_TRUE( components.compute( mask ) );
+
+  size_t num_components = components.get_num_components();
+  std::vector< bool > selected( num_components, false );
+  std::vector< double > values( num_components );
+  for ( size_t j = 0; j < num_components; j++ )
+  {
+    selected[ j ] = j % 3 == 1;
+    values[ j ] = static_cast< double >( components.get_component_sizes()[ j ] );
+  }
+
+  MaskDataBlockHandle dst = CreateMask( &ConstraintAt );
+  ASSERT_TRUE( components.fill_mask( selected, dst ) );
+
+  // The components selected by a region are the ones with a voxel inside it
+  MaskRegionConstraint region;
+  region.add_mask( dst, false );
+  std::vector< bool > selected_by_region;
+  ASSERT_TRUE( components.select_components( region, selected_by_region ) );
+  EXPECT_EQ( selected, selected_by_region );
+
+  DataBlockHandle sizes = StdDataBlock::New( NX, NY, NZ, DataType::UINT_E );
+  sizes->set_data_at( 0, 0, 0, 1234.0 );
+  ASSERT_TRUE( components.fill_data( values, sizes ) );
+
+  for ( size_t j = 0; j < mask->get_size(); j++ )
+  {
+    size_t component = components.get_component( j );
+    bool inside = component != MaskComponents::NO_COMPONENT_C;
+    EXPECT_EQ( inside && selected[ component ], dst->get_mask_at( j ) );
+    EXPECT_EQ( inside ? values[ component ] : 0.0, sizes->get_data_at( j ) );
+  }
+}
+
+TEST( MaskComponentsTest, FloodFill3D )
+{
+  MaskDataBlockHandle mask = CreateMask( &ShapeAt );
+  MaskDataBlockHandle constraint_mask = CreateMask( &ConstraintAt );
+
+  MaskRegionConstraint constraint;
+  constraint.add_mask( constraint_mask, false );
+
+  // Fill the empty space that is connected to a voxel near a corner, which is the same as the
+  // component of the background voxels containing that voxel
+  std::vector< bool > background( NX * NY * NZ );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        size_t index = x + NX * ( y + NY * z );
+        background[ index ] = !ShapeAt( x, y, z ) && ConstraintAt( x, y, z );
+      }
+  size_t num_components;
+  std::vector< size_t > labels = LabelVoxels( background, num_components );
+  size_t seed = NX - 2;
+  ASSERT_NE( MaskComponents::NO_COMPONENT_C, labels[ seed ] );
+
+  int num_updates = 0;
+  mask->mask_updated_signal_.connect( boost::bind( &CountUpdate, &num_updates ) );
+  std::vector< size_t > seeds( 1, seed );
+  ASSERT_TRUE( MaskComponents::FloodFill( mask, seeds, false, constraint ) );
+  EXPECT_EQ( 1, num_updates );
+
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        size_t index = x + NX * ( y + NY * z );
+        EXPECT_EQ( ShapeAt( x, y, z ) || labels[ index ] == labels[ seed ], 
+          mask->get_mask_at( index ) );
+        EXPECT_EQ( ConstraintAt( x, y, z ), constraint_mask->get_mask_at( index ) );
+      }
+
+  // Erasing from the same seed without a constraint removes everything connected to it
+  MaskComponents filled;
+  ASSERT_TRUE( filled.compute( mask ) );
+  size_t filled_component = filled.get_component( seed );
+  ASSERT_TRUE( MaskComponents::FloodFill( mask, seeds, true ) );
+  for ( size_t j = 0; j < mask->get_size(); j++ )
+  {
+    EXPECT_EQ( filled.get_component( j ) != MaskComponents::NO_COMPONENT_C && 
+      filled.get_component( j ) != filled_component, mask->get_mask_at( j ) );
+  }
+
+  EXPECT_EQ( 2, num_updates );
+
+  // A seed that cannot be filled does not change the mask
+  ASSERT_TRUE( MaskComponents::FloodFill( mask, seeds, true ) );
+  EXPECT_EQ( 2, num_updates );
+}
+
+TEST( MaskComponentsTest, EmptyAndFull )
+{
+  MaskDataBlockHandle mask;
+  MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), mask );
+  for ( size_t j = 0; j < mask->get_size(); j++ ) mask->clear_mask_at( j );
+
+  MaskComponents components;
+  ASSERT_TRUE( components.compute( mask ) );
+  EXPECT_EQ( 0u, components.get_num_components() );
+  EXPECT_EQ( MaskComponents::NO_COMPONENT_C, components.get_component( 5 ) );
+
+  std::vector< size_t > seeds( 1, 0 );
+  ASSERT_TRUE( MaskComponents::FloodFill( mask, seeds, false ) );
+  ASSERT_TRUE( components.compute( mask ) );
+  ASSERT_EQ( 1u, components.get_num_components() );
+  EXPECT_EQ( mask->get_size(), components.get_component_sizes()[ 0 ] );
+}
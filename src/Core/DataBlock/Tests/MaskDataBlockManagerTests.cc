@@ -0,0 +1,344 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <Core/DataBlock/DataBlockLocks.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+
+using namespace Core;
+
+namespace
+{
+
+const size_t NX = 17;
+const size_t NY = 11;
+const size_t NZ = 5;
+
+// Give every mask a different pattern, so a mask that ends up with the data of another mask
+// is detected
+bool PatternAt( size_t mask, size_t index )
+{
+  return ( ( index * 31 + mask * 7 ) % ( mask + 3 ) ) == 0;
+}
+
+// The caller needs to hold the lock of the mask
+void WritePattern( MaskDataBlockHandle mask, size_t pattern )
+{
+  for ( size_t j = 0; j < mask->get_size(); j++ )
+  {
+    if ( PatternAt( pattern, j ) ) mask->set_mask_at( j );
+    else mask->clear_mask_at( j );
+  }
+}
+
+// The caller needs to hold the lock of the mask
+bool CheckPattern( MaskDataBlockHandle mask, size_t pattern )
+{
+  for ( size_t j = 0; j < mask->get_size(); j++ )
+  {
+    if ( mask->get_mask_at( j ) != PatternAt( pattern, j ) ) return false;
+  }
+  return true;
+}
+
+void SetPattern( MaskDataBlockHandle mask, size_t pattern )
+{
+  MaskDataBlock::lock_type lock( mask->get_mutex() );
+  WritePattern( mask, pattern );
+}
+
+bool HasPattern( MaskDataBlockHandle mask, size_t pattern )
+{
+  MaskDataBlock::shared_lock_type lock( mask->get_mutex() );
+  return CheckPattern( mask, pattern );
+}
+
+// Keep rewriting and checking the patterns of a set of masks until told to stop. Like the
+// filters, the pattern is written through the cached data pointer and value of the mask, so
+// the part that is written after the mask has been moved ends up in the old datablock.
+class MaskUser
+{
+public:
+  MaskUser( const std::vector< MaskDataBlockHandle >& masks ) :
+    masks_( masks ), patterns_( masks.size() ), done_( false ), uses_( 0 ), failures_( 0 )
+  {
+    for ( size_t j = 0; j < this->patterns_.size(); j++ ) this->patterns_[ j ] = j;
+  }
+
+  void run()
+  {
+    while ( !this->is_done() )
+    {
+      for ( size_t j = 0; j < this->masks_.size(); j++ )
+      {
+        this->masks_[ j ]->get_generation();
+
+        // Alternate between two patterns for every mask
+        this->patterns_[ j ] = this->patterns_[ j ] == j ? j + 16 : j;
+        bool ok;
+        {
+          MaskDataBlock::lock_type lock( this->masks_[ j ]->get_mutex() );
+          this->increase_uses();
+
+          unsigned char* data = this->masks_[ j ]->get_mask_data();
+          unsigned char value = this->masks_[ j ]->get_mask_value();
+          size_t size = this->masks_[ j ]->get_size();
+          for ( size_t k = 0; k < size; k++ )
+          {
+            if ( k == size / 2 ) boost::this_thread::yield();
+            if ( PatternAt( this->patterns_[ j ], k ) ) data[ k ] |= value;
+            else data[ k ] &= ~value;
+          }
+          ok = CheckPattern( this->masks_[ j ], this->patterns_[ j ] );
+        }
+
+        if ( !ok )
+        {
+          boost::mutex::scoped_lock lock( this->mutex_ );
+          this->failures_++;
+        }
+      }
+      boost::this_thread::yield();
+    }
+  }
+
+  void stop()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->done_ = true;
+  }
+
+  bool is_done()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    return this->done_;
+  }
+
+  void increase_uses()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->uses_++;
+  }
+
+  size_t get_uses()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    return this->uses_;
+  }
+
+  size_t get_failures()
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    return this->failures_;
+  }
+
+  std::vector< MaskDataBlockHandle > masks_;
+  std::vector< size_t > patterns_;
+  boost::mutex mutex_;
+  bool done_;
+  size_t uses_;
+  size_t failures_;
+};
+
+class MaskDataBlockManagerTest : public ::testing::Test 
+{
+protected:
+  virtual void SetUp()
+  {
+    MaskDataBlockManager::Instance()->clear();
+
+    // Fill two datablocks and then release most of the masks in both
+    masks_.resize( 16 );
+    for ( size_t j = 0; j < masks_.size(); j++ )
+    {
+      ASSERT_TRUE( MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), masks_[ j ] ) );
+      SetPattern( masks_[ j ], j );
+    }
+    ASSERT_NE( masks_[ 0 ]->get_data_block(), masks_[ 8 ]->get_data_block() );
+    for ( size_t j = 3; j < 8; j++ ) masks_[ j ].reset();
+    for ( size_t j = 12; j < 16; j++ ) masks_[ j ].reset();
+  }
+
+  virtual void TearDown()
+  {
+    masks_.clear();
+    MaskDataBlockManager::Instance()->clear();
+  }
+
+  std::vector< MaskDataBlockHandle > masks_;
+};
+
+} // end anonymous namespace
+
+TEST_F( MaskDataBlockManagerTest, CompactMovesBitplanes )
+{
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->is_fragmented() );
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->compact() );
+  ASSERT_FALSE( MaskDataBlockManager::Instance()->is_fragmented() );
+
+  DataBlockHandle data_block = masks_[ 0 ]->get_data_block();
+  std::vector< bool > bits_used( 8, false );
+  for ( size_t j = 0; j < masks_.size(); j++ )
+  {
+    if ( !masks_[ j ] ) continue;
+    EXPECT_EQ( masks_[ j ]->get_data_block(), data_block );
+    EXPECT_FALSE( bits_used[ masks_[ j ]->get_mask_bit() ] );
+    bits_used[ masks_[ j ]->get_mask_bit() ] = true;
+    EXPECT_TRUE( HasPattern( masks_[ j ], j ) ) << "mask " << j;
+  }
+
+  // New masks use the bits that are still free and do not disturb the moved masks
+  MaskDataBlockHandle mask;
+  ASSERT_TRUE( MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), mask ) );
+  EXPECT_EQ( mask->get_data_block(), data_block );
+  SetPattern( mask, 16 );
+  for ( size_t j = 0; j < masks_.size(); j++ )
+  {
+    if ( masks_[ j ] )
+    {
+      EXPECT_TRUE( HasPattern( masks_[ j ], j ) ) << "mask " << j;
+    }
+  }
+}
+
+TEST_F( MaskDataBlockManagerTest, CompactSkipsLockedDataBlocks )
+{
+  {
+    MaskDataBlock::shared_lock_type lock( masks_[ 8 ]->get_mutex() );
+    ASSERT_FALSE( MaskDataBlockManager::Instance()->compact() );
+  }
+  EXPECT_NE( masks_[ 0 ]->get_data_block(), masks_[ 8 ]->get_data_block() );
+  for ( size_t j = 0; j < masks_.size(); j++ )
+  {
+    if ( masks_[ j ] )
+    {
+      EXPECT_TRUE( HasPattern( masks_[ j ], j ) ) << "mask " << j;
+    }
+  }
+
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->compact() );
+  EXPECT_EQ( masks_[ 0 ]->get_data_block(), masks_[ 8 ]->get_data_block() );
+}
+
+TEST_F( MaskDataBlockManagerTest, CompactSkipsMasksLockedByDataBlockLocks )
+{
+  {
+    // The masks share one mutex, which is only locked once
+    DataBlockLocks locks( masks_[ 8 ], masks_[ 0 ], masks_[ 9 ] );
+    ASSERT_FALSE( MaskDataBlockManager::Instance()->compact() );
+  }
+  EXPECT_NE( masks_[ 0 ]->get_data_block(), masks_[ 8 ]->get_data_block() );
+
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->compact() );
+  EXPECT_EQ( masks_[ 0 ]->get_data_block(), masks_[ 8 ]->get_data_block() );
+}
+
+TEST_F( MaskDataBlockManagerTest, PackedBitPlaneRoundTrip )
+{
+  DataBlockHandle packed_data;
+  ASSERT_TRUE( MaskDataBlockManager::PackBitPlane( masks_[ 9 ], packed_data ) );
+  EXPECT_EQ( packed_data->get_nx(), ( NX + 7 ) / 8 );
+  EXPECT_EQ( packed_data->get_ny(), NY );
+  EXPECT_EQ( packed_data->get_nz(), NZ );
+
+  MaskDataBlockHandle mask;
+  ASSERT_TRUE( MaskDataBlockManager::UnpackBitPlane( packed_data, 
+    GridTransform( NX, NY, NZ ), mask ) );
+  EXPECT_TRUE( HasPattern( mask, 9 ) );
+  for ( size_t j = 0; j < masks_.size(); j++ )
+  {
+    if ( masks_[ j ] )
+    {
+      EXPECT_TRUE( HasPattern( masks_[ j ], j ) ) << "mask " << j;
+    }
+  }
+
+  EXPECT_FALSE( MaskDataBlockManager::UnpackBitPlane( packed_data, 
+    GridTransform( NX + 8, NY, NZ ), mask ) );
+}
+
+TEST_F( MaskDataBlockManagerTest, CompactWhileUsingMasks )
+{
+  // Leave masks 0 to 2 in a datablock that is filled up with masks that can be released
+  for ( size_t j = 8; j < 12; j++ ) masks_[ j ].reset();
+  std::vector< MaskDataBlockHandle > fillers( 5 );
+  for ( size_t j = 0; j < fillers.size(); j++ )
+  {
+    ASSERT_TRUE( MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), fillers[ j ] ) );
+  }
+
+  std::vector< MaskDataBlockHandle > masks( masks_.begin(), masks_.begin() + 3 );
+  MaskDataBlock::mutex_type* mutex = &masks[ 0 ]->get_mutex();
+
+  MaskUser user( masks );
+  boost::thread_group threads;
+  threads.create_thread( boost::bind( &MaskUser::run, &user ) );
+
+  // Every round the fillers move to a new datablock, after which compaction moves the masks
+  // that are in use into that datablock
+  size_t moves = 0;
+  for ( size_t round = 0; round < 100; round++ )
+  {
+    size_t uses = user.get_uses();
+    std::vector< MaskDataBlockHandle > new_fillers( 5 );
+    for ( size_t j = 0; j < new_fillers.size(); j++ )
+    {
+      EXPECT_TRUE( MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), 
+        new_fillers[ j ] ) );
+    }
+    fillers.swap( new_fillers );
+    new_fillers.clear();
+
+    // Compact while a mask is in use
+    while ( user.get_uses() == uses ) boost::this_thread::yield();
+    DataBlockHandle data_block = masks[ 0 ]->get_data_block();
+    for ( size_t tries = 0; tries < 100000; tries++ )
+    {
+      if ( MaskDataBlockManager::Instance()->compact() ) break;
+      boost::this_thread::yield();
+    }
+    if ( masks[ 0 ]->get_data_block() != data_block ) moves++;
+  }
+
+  user.stop();
+  threads.join_all();
+
+  EXPECT_EQ( user.get_failures(), 0u );
+  EXPECT_GT( moves, 0u );
+  for ( size_t j = 0; j < masks.size(); j++ )
+  {
+    EXPECT_EQ( &masks[ j ]->get_mutex(), mutex );
+    EXPECT_TRUE( HasPattern( masks[ j ], user.patterns_[ j ] ) ) << "mask " << j;
+  }
+}
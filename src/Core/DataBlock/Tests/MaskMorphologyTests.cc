@@ -0,0 +1,268 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/MaskMorphology.h>
+
+using namespace Core;
+
+namespace
+{
+
+const int NX = 23;
+const int NY = 19;
+const int NZ = 13;
+
+// A few blobs and single voxels, so edges, holes and the volume border are all covered
+bool ShapeAt( int x, int y, int z )
+{
+  int dx = x - 9, dy = y - 8, dz = z - 6;
+  if ( dx * dx + 2 * dy * dy + 3 * dz * dz < 40 ) return ( x + y + z ) % 11 != 0;
+  if ( x >= 16 && x < 21 && y >= 2 && y < 5 ) return true;
+  return ( x * 7 + y * 13 + z * 17 ) % 89 == 0;
+}
+
+bool ConstraintAt( int x, int y, int z )
+{
+  return x + 2 * y - z < 38;
+}
+
+MaskDataBlockHandle CreateMask( bool ( *function )( int, int, int ) )
+{
+  MaskDataBlockHandle mask;
+  MaskDataBlockManager::Create( GridTransform( NX, NY, NZ ), mask );
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        if ( function( x, y, z ) ) mask->set_mask_at( x, y, z );
+        else mask->clear_mask_at( x, y, z );
+      }
+  return mask;
+}
+
+typedef std::vector< unsigned char > Volume;
+
+Volume ToVolume( MaskDataBlockHandle mask )
+{
+  Volume volume( mask->get_size() );
+  for ( size_t j = 0; j < volume.size(); j++ ) volume[ j ] = mask->get_mask_at( j ) ? 1 : 0;
+  return volume;
+}
+
+// Stamp a ball of squared radius threshold around every voxel of the other side of the edge,
+// as the dilate and erode filters used to do
+Volume StampBall( const Volume& volume, const Volume& allowed, bool dilate, int threshold,
+  int xr, int yr, int zr )
+{
+  Volume result = volume;
+  for ( int z = 0; z < NZ; z++ )
+    for ( int y = 0; y < NY; y++ )
+      for ( int x = 0; x < NX; x++ )
+      {
+        if ( volume[ x + NX * ( y + NY * z ) ] != ( dilate ? 1 : 0 ) ) continue;
+        for ( int zz = -zr; zz <= zr; zz++ )
+          for ( int yy = -yr; yy <= yr; yy++ )
+            for ( int xx = -xr; xx <= xr; xx++ )
+            {
+              int px = x + xx, py = y + yy, pz = z + zz;
+              if ( px < 0 || px >= NX || py < 0 || py >= NY || pz < 0 || pz >= NZ ) continue;
+              if ( xx * xx + yy * yy + zz * zz > threshold ) continue;
+              size_t index = px + NX * ( py + NY * pz );
+              if ( allowed[ index ] ) result[ index ] = dilate ? 1 : 0;
+            }
+      }
+  return result;
+}
+
+// Grow one layer at a time over the face and edge neighbors, as the iterative filters used
+// to do
+Volume StepNeighbors( const Volume& volume, const Volume& allowed, bool dilate, int radius,
+  bool use_x, bool use_y, bool use_z )
+{
+  Volume result = volume;
+  unsigned char source = dilate ? 1 : 0;
+  for ( int i = 0; i < radius; i++ )
+  {
+    Volume previous = result;
+    for ( int z = 0; z < NZ; z++ )
+      for ( int y = 0; y < NY; y++ )
+        for ( int x = 0; x < NX; x++ )
+        {
+          size_t index = x + NX * ( y + NY * z );
+          if ( previous[ index ] == source || !allowed[ index ] ) continue;
+          for ( int dz = -1; dz <= 1; dz++ )
+            for ( int dy = -1; dy <= 1; dy++ )
+              for ( int dx = -1; dx <= 1; dx++ )
+              {
+                int steps = ( dx != 0 ) + ( dy != 0 ) + ( dz != 0 );
+                if ( steps == 0 || steps == 3 ) continue;
+                if ( ( dx && !use_x ) || ( dy && !use_y ) || ( dz && !use_z ) ) continue;
+                int px = x + dx, py = y + dy, pz = z + dz;
+                if ( px < 0 || px >= NX || py < 0 || py >= NY || pz < 0 || pz >= NZ ) continue;
+                if ( previous[ px + NX * ( py + NY * pz ) ] == source ) result[ index ] = source;
+              }
+        }
+  }
+  return result;
+}
+
+Volume ApplyMorphology( MaskMorphology& morphology, MaskDataBlockHandle src )
+{
+  MaskDataBlockHandle dst;
+  EXPECT_TRUE( morphology.run( src, GridTransform( NX, NY, NZ ), dst ) );
+  if ( !dst ) return Volume();
+  return ToVolume( dst );
+}
+
+class MaskMorphologyTest : public ::testing::Test 
+{
+protected:
+  virtual void SetUp()
+  {
+    this->src_ = CreateMask( ShapeAt );
+    this->constraint_ = CreateMask( ConstraintAt );
+    this->volume_ = ToVolume( this->src_ );
+    this->all_ = Volume( this->volume_.size(), 1 );
+    this->inside_ = ToVolume( this->constraint_ );
+  }
+
+  MaskDataBlockHandle src_;
+  MaskDataBlockHandle constraint_;
+  Volume volume_;
+  Volume all_;
+  Volume inside_;
+};
+
+} // end anonymous namespace
+
+TEST_F( MaskMorphologyTest, BallMatchesStampedSphere )
+{
+  for ( int radius = 0; radius <= 4; radius++ )
+  {
+    MaskMorphology dilate;
+    dilate.add_dilate( MorphologyShapeType::BALL_E, radius );
+    EXPECT_EQ( StampBall( this->volume_, this->all_, true, radius * radius, 
+      radius, radius, radius ), ApplyMorphology( dilate, this->src_ ) ) << "radius " << radius;
+
+    MaskMorphology erode;
+    erode.add_erode( MorphologyShapeType::BALL_E, radius );
+    EXPECT_EQ( StampBall( this->volume_, this->all_, false, radius * radius,
+      radius, radius, radius ), ApplyMorphology( erode, this->src_ ) ) << "radius " << radius;
+  }
+}
+
+TEST_F( MaskMorphologyTest, SmoothBallAddsHalfAVoxel )
+{
+  MaskMorphology morphology;
+  morphology.add_dilate( MorphologyShapeType::SMOOTH_BALL_E, 3 );
+  EXPECT_EQ( StampBall( this->volume_, this->all_, true, 12, 3, 3, 3 ), 
+    ApplyMorphology( morphology, this->src_ ) );
+}
+
+TEST_F( MaskMorphologyTest, ConstraintAndSequence )
+{
+  for ( int invert = 0; invert < 2; invert++ )
+  {
+    Volume allowed = this->inside_;
+    for ( size_t j = 0; j < allowed.size(); j++ ) if ( invert ) allowed[ j ] = !allowed[ j ];
+
+    MaskMorphology morphology;
+    morphology.set_constraint( this->constraint_, invert != 0 );
+    morphology.add_dilate( MorphologyShapeType::BALL_E, 3 );
+    morphology.add_erode( MorphologyShapeType::BALL_E, 2 );
+
+    Volume expected = StampBall( this->volume_, allowed, true, 9, 3, 3, 3 );
+    expected = StampBall( expected, allowed, false, 4, 2, 2, 2 );
+    EXPECT_EQ( expected, ApplyMorphology( morphology, this->src_ ) ) << "invert " << invert;
+  }
+}
+
+TEST_F( MaskMorphologyTest, Only2d )
+{
+  SliceType slice_types[] = { SliceType::SAGITTAL_E, SliceType::CORONAL_E, SliceType::AXIAL_E };
+  for ( int j = 0; j < 3; j++ )
+  {
+    int r[ 3 ] = { 3, 3, 3 };
+    r[ j ] = 0;
+
+    MaskMorphology ball;
+    ball.set_only2d( true, slice_types[ j ] );
+    ball.add_dilate( MorphologyShapeType::BALL_E, 3 );
+    EXPECT_EQ( StampBall( this->volume_, this->all_, true, 9, r[ 0 ], r[ 1 ], r[ 2 ] ),
+      ApplyMorphology( ball, this->src_ ) ) << "axis " << j;
+
+    MaskMorphology iterative;
+    iterative.set_only2d( true, slice_types[ j ] );
+    iterative.add_erode( MorphologyShapeType::ITERATIVE_E, 2 );
+    EXPECT_EQ( StepNeighbors( this->volume_, this->all_, false, 2, j != 0, j != 1, j != 2 ),
+      ApplyMorphology( iterative, this->src_ ) ) << "axis " << j;
+  }
+}
+
+TEST_F( MaskMorphologyTest, IterativeMatchesSteps )
+{
+  for ( int radius = 0; radius <= 5; radius++ )
+  {
+    MaskMorphology morphology;
+    morphology.set_constraint( this->constraint_, false );
+    morphology.add_dilate( MorphologyShapeType::ITERATIVE_E, radius );
+    morphology.add_erode( MorphologyShapeType::ITERATIVE_E, radius / 2 );
+
+    Volume expected = StepNeighbors( this->volume_, this->inside_, true, radius, 
+      true, true, true );
+    expected = StepNeighbors( expected, this->inside_, false, radius / 2, true, true, true );
+    EXPECT_EQ( expected, ApplyMorphology( morphology, this->src_ ) ) << "radius " << radius;
+  }
+}
+
+TEST_F( MaskMorphologyTest, LargeRadius )
+{
+  // Squared distances that do not fit in 16 bits
+  MaskMorphology morphology;
+  morphology.add_dilate( MorphologyShapeType::BALL_E, 300 );
+  EXPECT_EQ( this->all_, ApplyMorphology( morphology, this->src_ ) );
+
+  MaskMorphology erode;
+  erode.add_erode( MorphologyShapeType::BALL_E, 300 );
+  EXPECT_EQ( Volume( this->all_.size(), 0 ), ApplyMorphology( erode, this->src_ ) );
+}
+
+TEST_F( MaskMorphologyTest, Abort )
+{
+  MaskMorphology morphology;
+  morphology.set_abort_function( [] { return true; } );
+  morphology.add_dilate( MorphologyShapeType::BALL_E, 2 );
+  MaskDataBlockHandle dst;
+  EXPECT_FALSE( morphology.run( this->src_, GridTransform( NX, NY, NZ ), dst ) );
+  EXPECT_FALSE( dst );
+}
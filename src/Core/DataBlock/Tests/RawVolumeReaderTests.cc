@@ -0,0 +1,159 @@
+/*
+For more information, please see: http://software.sci.utah.edu
+
+The MIT License
+
+Copyright (c) 2016 Scientific Computing and Imaging Institute,
+University of Utah.
+
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <zlib.h>
+
+#include <Core/DataBlock/DataBlockKernels.h>
+#include <Core/DataBlock/RawVolumeReader.h>
+
+using namespace Core;
+
+namespace
+{
+
+// Larger than a slab, so the file is read by several tasks
+const size_t TEST_SIZE = 300007;
+
+const size_t HEADER_SIZE = 37;
+
+// Write a header of garbage followed by the payload to a temporary file
+std::string WriteFile( const std::vector< unsigned char >& payload )
+{
+  boost::filesystem::path path = boost::filesystem::temp_directory_path() / 
+    boost::filesystem::unique_path( "raw-volume-reader-%%%%-%%%%.raw" );
+
+  std::vector< unsigned char > header( HEADER_SIZE, 0xff );
+  FILE* file = fopen( path.string().c_str(), "wb" );
+  fwrite( &header[ 0 ], 1, header.size(), file );
+  if ( !payload.empty() ) fwrite( &payload[ 0 ], 1, payload.size(), file );
+  fclose( file );
+  return path.string();
+}
+
+std::vector< unsigned char > GenerateShorts( size_t size )
+{
+  std::vector< unsigned char > data( size * sizeof( short ) );
+  short* values = reinterpret_cast< short* >( &data[ 0 ] );
+  for ( size_t j = 0; j < size; j++ ) values[ j ] = static_cast< short >( ( j * 7919 ) % 60000 );
+  return data;
+}
+
+} // end anonymous namespace
+
+TEST(RawVolumeReaderTests, ReadRaw)
+{
+  std::vector< unsigned char > payload = GenerateShorts( TEST_SIZE );
+  std::string filename = WriteFile( payload );
+
+  std::vector< short > data( TEST_SIZE );
+  std::string error;
+  RawVolumeReader reader;
+  ASSERT_TRUE( reader.read( filename, HEADER_SIZE, &data[ 0 ], DataType::SHORT_E, TEST_SIZE, 
+    error ) ) << error;
+  EXPECT_EQ( 0, memcmp( &payload[ 0 ], &data[ 0 ], payload.size() ) );
+
+  boost::filesystem::remove( filename );
+}
+
+TEST(RawVolumeReaderTests, ReadSwappedAndConverted)
+{
+  std::vector< unsigned char > expected = GenerateShorts( TEST_SIZE );
+  std::vector< unsigned char > payload = expected;
+  DataBlockKernels::SwapEndian( &payload[ 0 ], TEST_SIZE, sizeof( short ) );
+  std::string filename = WriteFile( payload );
+
+  std::vector< float > data( TEST_SIZE );
+  std::string error;
+  RawVolumeReader reader;
+  reader.set_file_data_type( DataType::SHORT_E );
+  reader.set_swap_endian( true );
+  ASSERT_TRUE( reader.read( filename, HEADER_SIZE, &data[ 0 ], DataType::FLOAT_E, TEST_SIZE, 
+    error ) ) << error;
+
+  const short* values = reinterpret_cast< const short* >( &expected[ 0 ] );
+  for ( size_t j = 0; j < TEST_SIZE; j++ )
+  {
+    ASSERT_EQ( static_cast< float >( values[ j ] ), data[ j ] ) << "index " << j;
+  }
+
+  boost::filesystem::remove( filename );
+}
+
+TEST(RawVolumeReaderTests, ReadGzip)
+{
+  std::vector< unsigned char > expected = GenerateShorts( TEST_SIZE );
+  uLongf compressed_size = compressBound( static_cast< uLong >( expected.size() ) );
+  std::vector< unsigned char > payload( compressed_size );
+  ASSERT_EQ( Z_OK, compress( &payload[ 0 ], &compressed_size, &expected[ 0 ], 
+    static_cast< uLong >( expected.size() ) ) );
+  payload.resize( compressed_size );
+  std::string filename = WriteFile( payload );
+
+  std::vector< int > data( TEST_SIZE );
+  std::string error;
+  RawVolumeReader reader;
+  reader.set_file_data_type( DataType::SHORT_E );
+  reader.set_gzip( true );
+  ASSERT_TRUE( reader.read( filename, HEADER_SIZE, &data[ 0 ], DataType::INT_E, TEST_SIZE, 
+    error ) ) << error;
+
+  const short* values = reinterpret_cast< const short* >( &expected[ 0 ] );
+  for ( size_t j = 0; j < TEST_SIZE; j++ )
+  {
+    ASSERT_EQ( static_cast< int >( values[ j ] ), data[ j ] ) << "index " << j;
+  }
+
+  boost::filesystem::remove( filename );
+}
+
+TEST(RawVolumeReaderTests, ShortFileFails)
+{
+  std::vector< unsigned char > payload = GenerateShorts( TEST_SIZE - 1 );
+  std::string filename = WriteFile( payload );
+
+  std::vector< short > data( TEST_SIZE );
+  std::string error;
+  RawVolumeReader reader;
+  EXPECT_FALSE( reader.read( filename, HEADER_SIZE, &data[ 0 ], DataType::SHORT_E, TEST_SIZE,
+    error ) );
+  EXPECT_FALSE( error.empty() );
+
+  reader.set_gzip( true );
+  EXPECT_FALSE( reader.read( filename, HEADER_SIZE, &data[ 0 ], DataType::SHORT_E, TEST_SIZE,
+    error ) );
+
+  boost::filesystem::remove( filename );
+}
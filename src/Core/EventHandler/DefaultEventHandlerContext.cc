@@ -26,10 +26,8 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// STL includes
-#include <queue>
-
 // Boost includes
+#include <boost/bind.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
@@ -39,6 +37,7 @@
 
 #include <Core/EventHandler/Event.h>
 #include <Core/EventHandler/EventHandler.h>
+#include <Core/EventHandler/EventQueue.h>
 #include <Core/EventHandler/DefaultEventHandlerContext.h>
 
 namespace Core
@@ -47,23 +46,17 @@ namespace Core
 class DefaultEventHandlerContextPrivate
 {
 public:
-  // Queue type that is used to store the events
-  typedef std::queue< EventHandle > event_queue_type;
-
   // Whether the eventhandler started
   bool eventhandler_started_;
 
   // EventHandler thread id
   boost::thread* eventhandler_thread_;
 
-  // Mutex protecting the event queue
-  boost::mutex event_queue_mutex_;
-
-  // Condition variable signaling that a new event was posted
-  boost::condition_variable event_queue_new_event_;
-
   // The event queue
-  event_queue_type event_queue_;
+  EventQueue event_queue_;
+
+  // Mutex protecting done_
+  boost::mutex done_mutex_;
 
   // Indicating that event handling is done
   bool done_;
@@ -101,9 +94,8 @@ DefaultEventHandlerContext::~DefaultEventHandlerContext()
 
 void DefaultEventHandlerContext::post_event( EventHandle& event )
 {
-  boost::unique_lock< boost::mutex > lock( this->private_->event_queue_mutex_ );
-  this->private_->event_queue_.push( event );
-  this->private_->event_queue_new_event_.notify_all();
+  boost::function< void () > function = boost::bind( &Event::handle_event, event );
+  this->private_->event_queue_.push( function );
 }
 
 void DefaultEventHandlerContext::post_and_wait_event( EventHandle& event )
@@ -118,18 +110,31 @@ void DefaultEventHandlerContext::post_and_wait_event( EventHandle& event )
   // thread waits
   boost::unique_lock< boost::mutex > lock( sync->lock_ );
 
-  {
-    // Need to lock queue before inserting message
-    boost::unique_lock< boost::mutex > lock( this->private_->event_queue_mutex_ );
-    // Adding event to queue
-    this->private_->event_queue_.push( event );
-    this->private_->event_queue_new_event_.notify_all();
-  }
+  // Adding event to queue
+  boost::function< void () > function = boost::bind( &Event::handle_event, event );
+  this->private_->event_queue_.push( function );
 
   // wait for application to handle the event
   sync->condition_.wait( lock );
 }
 
+void DefaultEventHandlerContext::post_function( boost::function< void () >& function, 
+  EventQueue::coalesce_key_type key )
+{
+  this->private_->event_queue_.push( function, key );
+}
+
+bool DefaultEventHandlerContext::get_event_statistics( EventQueueStatistics& statistics ) const
+{
+  statistics = this->private_->event_queue_.get_statistics();
+  return true;
+}
+
+void DefaultEventHandlerContext::reset_event_statistics()
+{
+  this->private_->event_queue_.reset_statistics();
+}
+
 bool DefaultEventHandlerContext::process_events()
 {
   // Only run on the application thread
@@ -138,59 +143,31 @@ bool DefaultEventHandlerContext::process_events()
     CORE_THROW_LOGICERROR("process_events was called from a thread that is not processing the events");
   }
 
-  // lock the queue, so it is not changed while we are taking events of the
-  // the list.
-  boost::unique_lock< boost::mutex > lock( this->private_->event_queue_mutex_ );
-
-  while ( ! ( this->private_->event_queue_.empty() ) )
+  // NOTE: The queue is not locked while the functions run, so they can post new events
+  boost::function< void () > function;
+  while ( this->private_->event_queue_.pop( function ) )
   {
-    // get the next event
-    EventHandle event_handle;
-    event_handle.swap( this->private_->event_queue_.front() );
-    // pop the handled event from the list
-    this->private_->event_queue_.pop();
-
-    // unlock so the call back can add another event on the list
-    lock.unlock();
     // run the call back
-    event_handle->handle_event();
-    // lock again so we can change the queue
-    lock.lock();
+    function();
   }
 
+  boost::unique_lock< boost::mutex > lock( this->private_->done_mutex_ );
   return ( this->private_->done_ );
 }
 
 bool DefaultEventHandlerContext::wait_and_process_events()
 {
-  // lock the queue, so it is not changed while we are taking events of the
-  // the list.
-  boost::unique_lock< boost::mutex > lock( this->private_->event_queue_mutex_ );
-
   // wait for an event to come if the event queue is empty
-  if ( this->private_->event_queue_.empty() ) 
-  {
-    this->private_->event_queue_new_event_.wait( lock );
-  }
-  
-  while ( ! ( this->private_->event_queue_.empty() ) )
-  {
-    // get the next event
-    EventHandle event_handle;
-    event_handle.swap( this->private_->event_queue_.front() );
-    // pop the handled event from the list
-    this->private_->event_queue_.pop();
-
-    // unlock so the call back can add another event on the list
-    lock.unlock();
+  this->private_->event_queue_.wait();
 
+  boost::function< void () > function;
+  while ( this->private_->event_queue_.pop( function ) )
+  {
     // run the call back
-    event_handle->handle_event();
-
-    // lock again so we can change the queue
-    lock.lock();
+    function();
   }
 
+  boost::unique_lock< boost::mutex > lock( this->private_->done_mutex_ );
   return ( this->private_->done_ );
 }
 
@@ -228,7 +205,7 @@ void DefaultEventHandlerContext::terminate_eventhandler()
   // Signal that we are done handling events
   {
     // Lock the state of the eventhandler
-    boost::unique_lock< boost::mutex > lock( this->private_->event_queue_mutex_ );
+    boost::unique_lock< boost::mutex > lock( this->private_->done_mutex_ );
 
     // If it is already done, exit the function as this
     // function has already been executed
@@ -236,11 +213,11 @@ void DefaultEventHandlerContext::terminate_eventhandler()
 
     // Mark the eventhandler as done
     this->private_->done_ = true;
-
-    // Notify the thread waiting for input that it can stop waiting
-    this->private_->event_queue_new_event_.notify_one();
   }
 
+  // Notify the thread waiting for input that it can stop waiting
+  this->private_->event_queue_.interrupt();
+
   // Join the thread back into the main application thread
   this->private_->eventhandler_thread_->join();
 }
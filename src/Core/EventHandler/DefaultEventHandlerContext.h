@@ -74,6 +74,22 @@ public:
 
   virtual void post_and_wait_event( EventHandle& event );
 
+  // POST_FUNCTION:
+  /// Post a function onto the event queue, events with the same key are coalesced.
+
+  virtual void post_function( boost::function< void () >& function, 
+    EventQueue::coalesce_key_type key );
+
+  // GET_EVENT_STATISTICS:
+  /// Get the counters of the event queue
+
+  virtual bool get_event_statistics( EventQueueStatistics& statistics ) const;
+
+  // RESET_EVENT_STATISTICS:
+  /// Reset the counters of the event queue
+
+  virtual void reset_event_statistics();
+
   // PROCESS_EVENTS:
   /// process the events that are queued in the event handler mailbox
 
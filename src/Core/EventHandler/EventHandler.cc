@@ -84,8 +84,13 @@ void EventHandler::install_eventhandler_context( EventHandlerContextHandle& cont
 
 void EventHandler::post_event( boost::function< void() > function )
 {
-  EventHandle event = EventHandle( new EventT< boost::function< void() > > ( function ) );
-  eventhandler_context_->post_event( event );
+  eventhandler_context_->post_function( function, 0 );
+}
+
+void EventHandler::post_coalesced_event( EventQueue::coalesce_key_type key, 
+  boost::function< void() > function )
+{
+  eventhandler_context_->post_function( function, key );
 }
 
 void EventHandler::post_and_wait_event( boost::function< void() > function )
@@ -101,6 +106,16 @@ void EventHandler::post_and_wait_event( boost::function< void() > function )
   }
 }
 
+bool EventHandler::get_event_statistics( EventQueueStatistics& statistics ) const
+{
+  return ( eventhandler_context_->get_event_statistics( statistics ) );
+}
+
+void EventHandler::reset_event_statistics()
+{
+  eventhandler_context_->reset_event_statistics();
+}
+
 bool EventHandler::process_events()
 {
   // use the implementation of the application context
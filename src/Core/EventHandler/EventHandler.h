@@ -70,6 +70,13 @@ public:
   /// the same time.
   void post_event( boost::function< void() > function );
 
+  // POST_COALESCED_EVENT:
+  /// Post an event that replaces an event with the same key that is still waiting to be
+  /// handled, so redundant events such as redraws are only handled once. The replaced event
+  /// is not run. The key is usually the address of the object the event updates.
+  void post_coalesced_event( EventQueue::coalesce_key_type key, 
+    boost::function< void() > function );
+
   // POST_AND_WAIT_EVENT:
   /// This function is similar to post_event, but waits until the function
   /// has finished execution. Note in case the function is called from the
@@ -78,6 +85,17 @@ public:
   /// dead lock
   void post_and_wait_event( boost::function< void() > function );
 
+  // -- Event statistics --
+public:
+  // GET_EVENT_STATISTICS:
+  /// Get the counters of the event queue. Returns false if the event handler context does
+  /// not keep them.
+  bool get_event_statistics( EventQueueStatistics& statistics ) const;
+
+  // RESET_EVENT_STATISTICS:
+  /// Reset the counters of the event queue
+  void reset_event_statistics();
+
   // -- Processing events from within the event handler thread --
 public:
 
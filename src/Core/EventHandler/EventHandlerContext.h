@@ -34,11 +34,14 @@
 #endif 
 
 // Boost includes
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <Core/EventHandler/Event.h>
 #include <Core/EventHandler/EventFWD.h>
 #include <Core/EventHandler/EventHandlerContextFWD.h>
+#include <Core/EventHandler/EventQueue.h>
 
 namespace Core
 {
@@ -79,6 +82,31 @@ public:
   /// the synchronization.
   virtual void post_and_wait_event( EventHandle& event ) = 0;
 
+  // POST_FUNCTION:
+  /// Post a function onto the event handler stack without waiting for it to finish. If the
+  /// key is not 0, an event with the same key that is still waiting may be replaced by this
+  /// one. The function is swapped out of the argument. The default implementation wraps the
+  /// function into an Event and does not coalesce events.
+  virtual void post_function( boost::function< void () >& function, 
+    EventQueue::coalesce_key_type /*key*/ )
+  {
+    EventHandle event( new EventT< boost::function< void () > >( function ) );
+    this->post_event( event );
+  }
+
+  // GET_EVENT_STATISTICS:
+  /// Get the counters of the event queue. Returns false if the context does not keep them.
+  virtual bool get_event_statistics( EventQueueStatistics& /*statistics*/ ) const
+  {
+    return false;
+  }
+
+  // RESET_EVENT_STATISTICS:
+  /// Reset the counters of the event queue
+  virtual void reset_event_statistics()
+  {
+  }
+
   // PROCESS_EVENT:
   /// process the events that are queued in the event handler stack
   virtual bool process_events() = 0;
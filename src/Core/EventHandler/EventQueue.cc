@@ -0,0 +1,332 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <deque>
+#include <vector>
+
+// Boost includes
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+// Core includes
+#include <Core/EventHandler/EventQueue.h>
+
+namespace Core
+{
+
+class EventQueueSlot
+{
+public:
+  EventQueueSlot() :
+    key_( 0 ),
+    dead_( false )
+  {
+  }
+
+  // The function to call
+  boost::function< void () > function_;
+
+  // Key for coalescing events
+  EventQueue::coalesce_key_type key_;
+
+  // Whether the event was replaced by a newer event with the same key. Dead slots stay in
+  // place until they reach the front of the queue, where they are skipped.
+  bool dead_;
+
+  // When the event was posted
+  boost::posix_time::ptime posted_;
+};
+
+class EventQueuePrivate
+{
+public:
+  typedef boost::unordered_map< EventQueue::coalesce_key_type, EventQueueSlot* > key_map_type;
+
+  // Mutex protecting all of the members
+  mutable boost::mutex mutex_;
+
+  // Signals the thread handling the events that a new event was posted
+  boost::condition_variable event_posted_;
+
+  // Whether the waiting thread needs to wake up without an event
+  bool interrupted_;
+
+  // Ring of slots, events are taken from front_ and added after front_ + num_slots_used_
+  std::vector< EventQueueSlot > slots_;
+  size_t front_;
+  size_t num_slots_used_;
+
+  // Events that did not fit in the ring. These are always newer than the events in the ring,
+  // as no events are added to the ring while there are events in this list.
+  std::deque< EventQueueSlot > overflow_;
+
+  // The slots of waiting events that have a key
+  key_map_type keys_;
+
+  // Number of dead slots in the ring and the overflow list
+  size_t num_dead_slots_;
+
+  // -- statistics --
+  EventQueueStatistics statistics_;
+  double total_latency_;
+  boost::posix_time::ptime reset_time_;
+
+  // ADD_SLOT:
+  // Get an empty slot at the back of the queue
+  EventQueueSlot& add_slot();
+
+  // BACK_SLOT:
+  // Get the slot at the back of the queue, or 0 if the queue is empty
+  EventQueueSlot* back_slot();
+
+  // FRONT_SLOT:
+  // Get the slot at the front of the queue, or 0 if the queue is empty
+  EventQueueSlot* front_slot();
+
+  // REMOVE_FRONT_SLOT:
+  // Release the slot at the front of the queue
+  void remove_front_slot();
+
+  // NUM_EVENTS:
+  // Number of events waiting, not counting dead slots
+  size_t num_events() const;
+};
+
+EventQueueSlot& EventQueuePrivate::add_slot()
+{
+  if ( this->overflow_.empty() && this->num_slots_used_ < this->slots_.size() )
+  {
+    size_t index = ( this->front_ + this->num_slots_used_ ) % this->slots_.size();
+    this->num_slots_used_++;
+    return this->slots_[ index ];
+  }
+
+  // NOTE: Adding elements at the end of a deque does not move the other elements, hence the
+  // pointers stored in keys_ stay valid.
+  this->statistics_.overflowed_++;
+  this->overflow_.push_back( EventQueueSlot() );
+  return this->overflow_.back();
+}
+
+EventQueueSlot* EventQueuePrivate::back_slot()
+{
+  if ( !this->overflow_.empty() ) return &this->overflow_.back();
+  if ( this->num_slots_used_ == 0 ) return 0;
+  return &this->slots_[ ( this->front_ + this->num_slots_used_ - 1 ) % this->slots_.size() ];
+}
+
+EventQueueSlot* EventQueuePrivate::front_slot()
+{
+  if ( this->num_slots_used_ > 0 ) return &this->slots_[ this->front_ ];
+  if ( !this->overflow_.empty() ) return &this->overflow_.front();
+  return 0;
+}
+
+void EventQueuePrivate::remove_front_slot()
+{
+  if ( this->num_slots_used_ > 0 )
+  {
+    EventQueueSlot& slot = this->slots_[ this->front_ ];
+    slot.key_ = 0;
+    slot.dead_ = false;
+    this->front_ = ( this->front_ + 1 ) % this->slots_.size();
+    this->num_slots_used_--;
+  }
+  else
+  {
+    this->overflow_.pop_front();
+  }
+}
+
+size_t EventQueuePrivate::num_events() const
+{
+  return this->num_slots_used_ + this->overflow_.size() - this->num_dead_slots_;
+}
+
+EventQueue::EventQueue( size_t capacity ) :
+  private_( new EventQueuePrivate )
+{
+  this->private_->interrupted_ = false;
+  this->private_->slots_.resize( capacity > 0 ? capacity : 1 );
+  this->private_->front_ = 0;
+  this->private_->num_slots_used_ = 0;
+  this->private_->num_dead_slots_ = 0;
+  this->private_->total_latency_ = 0.0;
+  this->private_->reset_time_ = boost::posix_time::microsec_clock::universal_time();
+}
+
+EventQueue::~EventQueue()
+{
+}
+
+void EventQueue::push( boost::function< void () >& function, coalesce_key_type key )
+{
+  // NOTE: The function that is replaced is destroyed after the mutex is released, as its
+  // destructor may post events itself.
+  boost::function< void () > replaced_function;
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->statistics_.posted_++;
+
+  boost::posix_time::ptime posted = boost::posix_time::microsec_clock::universal_time();
+  if ( key != 0 )
+  {
+    EventQueuePrivate::key_map_type::iterator it = this->private_->keys_.find( key );
+    if ( it != this->private_->keys_.end() && it->second == this->private_->back_slot() )
+    {
+      // Nothing was posted after the waiting event, so it can be replaced in place
+      it->second->function_.swap( replaced_function );
+      it->second->function_.swap( function );
+      this->private_->statistics_.coalesced_++;
+      return;
+    }
+    else if ( it != this->private_->keys_.end() )
+    {
+      // NOTE: The waiting event is not replaced in place, as the new event would then run
+      // before the events posted in between. Its slot is marked dead instead and the new event
+      // is added at the back. It keeps the time the first event was posted, so the latency
+      // shows how long the coalesced events have been waiting.
+      EventQueueSlot* old_slot = it->second;
+      old_slot->function_.swap( replaced_function );
+      old_slot->key_ = 0;
+      old_slot->dead_ = true;
+      posted = old_slot->posted_;
+      this->private_->num_dead_slots_++;
+      this->private_->statistics_.coalesced_++;
+    }
+  }
+
+  EventQueueSlot& slot = this->private_->add_slot();
+  slot.function_.swap( function );
+  slot.key_ = key;
+  slot.posted_ = posted;
+  if ( key != 0 ) this->private_->keys_[ key ] = &slot;
+
+  long long depth = static_cast< long long >( this->private_->num_events() );
+  if ( depth > this->private_->statistics_.max_depth_ ) 
+  {
+    this->private_->statistics_.max_depth_ = depth;
+  }
+
+  this->private_->event_posted_.notify_one();
+}
+
+bool EventQueue::pop( boost::function< void () >& function )
+{
+  // NOTE: The previous function is destroyed before locking, as its destructor may post events
+  function.clear();
+
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+
+  // Skip the slots of events that were replaced by newer ones
+  EventQueueSlot* slot = this->private_->front_slot();
+  while ( slot != 0 && slot->dead_ )
+  {
+    this->private_->remove_front_slot();
+    this->private_->num_dead_slots_--;
+    slot = this->private_->front_slot();
+  }
+  if ( slot == 0 ) return false;
+
+  slot->function_.swap( function );
+  if ( slot->key_ != 0 ) this->private_->keys_.erase( slot->key_ );
+
+  double latency = static_cast< double >( ( boost::posix_time::microsec_clock::universal_time() - 
+    slot->posted_ ).total_microseconds() ) * 1.0e-6;
+  this->private_->statistics_.handled_++;
+  this->private_->total_latency_ += latency;
+  if ( latency > this->private_->statistics_.max_latency_ ) 
+  {
+    this->private_->statistics_.max_latency_ = latency;
+  }
+
+  this->private_->remove_front_slot();
+  return true;
+}
+
+void EventQueue::wait()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  while ( this->private_->num_events() == 0 && !this->private_->interrupted_ )
+  {
+    this->private_->event_posted_.wait( lock );
+  }
+  this->private_->interrupted_ = false;
+}
+
+void EventQueue::interrupt()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->interrupted_ = true;
+  this->private_->event_posted_.notify_one();
+}
+
+size_t EventQueue::size() const
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  return this->private_->num_events();
+}
+
+size_t EventQueue::get_capacity() const
+{
+  return this->private_->slots_.size();
+}
+
+EventQueueStatistics EventQueue::get_statistics() const
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  EventQueueStatistics statistics = this->private_->statistics_;
+  statistics.depth_ = static_cast< long long >( this->private_->num_events() );
+  
+  if ( statistics.handled_ > 0 )
+  {
+    statistics.average_latency_ = this->private_->total_latency_ / 
+      static_cast< double >( statistics.handled_ );
+  }
+
+  double elapsed = static_cast< double >( ( boost::posix_time::microsec_clock::universal_time() -
+    this->private_->reset_time_ ).total_microseconds() ) * 1.0e-6;
+  if ( elapsed > 0.0 )
+  {
+    statistics.events_per_second_ = static_cast< double >( statistics.handled_ ) / elapsed;
+  }
+  return statistics;
+}
+
+void EventQueue::reset_statistics()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->statistics_ = EventQueueStatistics();
+  this->private_->total_latency_ = 0.0;
+  this->private_->reset_time_ = boost::posix_time::microsec_clock::universal_time();
+}
+
+} // end namespace Core
@@ -0,0 +1,136 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_EVENTHANDLER_EVENTQUEUE_H
+#define CORE_EVENTHANDLER_EVENTQUEUE_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Core
+{
+
+class EventQueue;
+class EventQueuePrivate;
+typedef boost::shared_ptr< EventQueuePrivate > EventQueuePrivateHandle;
+
+/// Counters describing the traffic through an event queue, these show whether the thread
+/// handling the events keeps up with the threads posting them.
+struct EventQueueStatistics
+{
+  EventQueueStatistics() :
+    posted_( 0 ), handled_( 0 ), coalesced_( 0 ), overflowed_( 0 ), depth_( 0 ),
+    max_depth_( 0 ), average_latency_( 0.0 ), max_latency_( 0.0 ), events_per_second_( 0.0 )
+  {}
+
+  // Number of events posted
+  long long posted_;
+  // Number of events taken from the queue to be handled
+  long long handled_;
+  // Number of events that replaced an event with the same key that was still waiting
+  long long coalesced_;
+  // Number of events that did not fit in the queue and were stored separately
+  long long overflowed_;
+  // Number of events currently waiting
+  long long depth_;
+  // Maximum number of events that were waiting at the same time
+  long long max_depth_;
+  // Average and maximum time in seconds between posting and handling an event
+  double average_latency_;
+  double max_latency_;
+  // Number of events handled per second since the counters were reset
+  double events_per_second_;
+};
+
+// CLASS EVENTQUEUE:
+/// Queue of functions that many threads post and one thread handles. The events are stored in
+/// a ring of fixed size that is allocated once, the functions are swapped into it so posting
+/// an event does not allocate memory as long as the function fits in the small object buffer of
+/// boost::function. If the ring is full, events are stored in a separate list instead of
+/// blocking the thread that posts them, as that thread may hold up the thread handling them.
+class EventQueue : public boost::noncopyable
+{
+public:
+  /// Key used to coalesce events, events with a key of 0 are never coalesced
+  typedef const void* coalesce_key_type;
+
+  /// Default number of events that fit in the ring
+  static const size_t DEFAULT_CAPACITY_C = 1024;
+
+  EventQueue( size_t capacity = DEFAULT_CAPACITY_C );
+  ~EventQueue();
+
+  // PUSH:
+  /// Add a function to the back of the queue, the function is swapped out of the argument. If
+  /// an event with the same key is still waiting, it is dropped and only the new event is
+  /// handled, so redundant events such as redraws collapse. The new event still goes to the
+  /// back, so it never runs before events that were posted ahead of it.
+  void push( boost::function< void () >& function, coalesce_key_type key = 0 );
+
+  // POP:
+  /// Take the function from the front of the queue, the previous contents of the argument are
+  /// discarded. Returns false if the queue is empty.
+  bool pop( boost::function< void () >& function );
+
+  // WAIT:
+  /// Wait until there is an event in the queue, or until interrupt is called
+  void wait();
+
+  // INTERRUPT:
+  /// Wake up the thread that waits for events
+  void interrupt();
+
+  // SIZE:
+  /// Number of events waiting
+  size_t size() const;
+
+  // GET_CAPACITY:
+  /// Number of events that fit in the ring
+  size_t get_capacity() const;
+
+  // GET_STATISTICS:
+  /// Get the counters describing the traffic through the queue
+  EventQueueStatistics get_statistics() const;
+
+  // RESET_STATISTICS:
+  /// Reset the counters, except for the current depth
+  void reset_statistics();
+
+private:
+  EventQueuePrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
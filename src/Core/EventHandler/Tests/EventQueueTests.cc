@@ -0,0 +1,200 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <Core/EventHandler/EventQueue.h>
+
+static void Record( std::vector<int>* order, int value )
+{
+  order->push_back( value );
+}
+
+static void Post( Core::EventQueue* queue, std::vector<int>* order, int value, 
+  Core::EventQueue::coalesce_key_type key = 0 )
+{
+  boost::function< void () > function = boost::bind( &Record, order, value );
+  queue->push( function, key );
+}
+
+static void RunAll( Core::EventQueue* queue )
+{
+  boost::function< void () > function;
+  while ( queue->pop( function ) ) function();
+}
+
+TEST(EventQueueTests, KeepsOrderBeyondCapacity)
+{
+  Core::EventQueue queue( 4 );
+  std::vector<int> order;
+
+  // Fill the ring, then take some events out so it wraps around, then overflow it
+  for ( int j = 0; j < 3; j++ ) Post( &queue, &order, j );
+  boost::function< void () > function;
+  ASSERT_TRUE( queue.pop( function ) );
+  function();
+  for ( int j = 3; j < 10; j++ ) Post( &queue, &order, j );
+  EXPECT_EQ( 9u, queue.size() );
+
+  RunAll( &queue );
+  ASSERT_EQ( 10u, order.size() );
+  for ( int j = 0; j < 10; j++ ) EXPECT_EQ( j, order[ j ] );
+
+  Core::EventQueueStatistics statistics = queue.get_statistics();
+  EXPECT_EQ( 10, statistics.posted_ );
+  EXPECT_EQ( 10, statistics.handled_ );
+  EXPECT_EQ( 5, statistics.overflowed_ );
+  EXPECT_EQ( 0, statistics.depth_ );
+  EXPECT_EQ( 9, statistics.max_depth_ );
+}
+
+TEST(EventQueueTests, CoalescesWaitingEvents)
+{
+  Core::EventQueue queue( 2 );
+  std::vector<int> order;
+  int key1 = 0, key2 = 0;
+
+  Post( &queue, &order, 1, &key1 );
+  Post( &queue, &order, 2 );
+  Post( &queue, &order, 3, &key1 );
+  // This one does not fit in the ring anymore
+  Post( &queue, &order, 4, &key2 );
+  Post( &queue, &order, 5, &key2 );
+  EXPECT_EQ( 3u, queue.size() );
+
+  RunAll( &queue );
+  ASSERT_EQ( 3u, order.size() );
+  EXPECT_EQ( 2, order[ 0 ] );
+  EXPECT_EQ( 3, order[ 1 ] );
+  EXPECT_EQ( 5, order[ 2 ] );
+  EXPECT_EQ( 2, queue.get_statistics().coalesced_ );
+
+  // Once handled, an event with the same key is queued again
+  Post( &queue, &order, 6, &key1 );
+  RunAll( &queue );
+  ASSERT_EQ( 4u, order.size() );
+  EXPECT_EQ( 6, order[ 3 ] );
+}
+
+TEST(EventQueueTests, CoalescedEventsDoNotOvertakeOthers)
+{
+  Core::EventQueue queue( 4 );
+  std::vector<int> order;
+  int redraw = 0;
+
+  // A redraw, a resize, and another redraw: the second redraw must run after the resize
+  Post( &queue, &order, 1, &redraw );
+  Post( &queue, &order, 2 );
+  Post( &queue, &order, 3, &redraw );
+  EXPECT_EQ( 2u, queue.size() );
+
+  // Fill the ring and overflow it, the dead slot of the first redraw still takes up space
+  Post( &queue, &order, 4 );
+  Post( &queue, &order, 5, &redraw );
+  Post( &queue, &order, 6 );
+  Post( &queue, &order, 7, &redraw );
+  // Nothing was posted after this redraw, it is replaced in place
+  Post( &queue, &order, 8, &redraw );
+  EXPECT_EQ( 4u, queue.size() );
+  EXPECT_EQ( 4, queue.get_statistics().depth_ );
+
+  RunAll( &queue );
+  ASSERT_EQ( 4u, order.size() );
+  EXPECT_EQ( 2, order[ 0 ] );
+  EXPECT_EQ( 4, order[ 1 ] );
+  EXPECT_EQ( 6, order[ 2 ] );
+  EXPECT_EQ( 8, order[ 3 ] );
+
+  Core::EventQueueStatistics statistics = queue.get_statistics();
+  EXPECT_EQ( 8, statistics.posted_ );
+  EXPECT_EQ( 4, statistics.handled_ );
+  EXPECT_EQ( 4, statistics.coalesced_ );
+  EXPECT_EQ( 0, statistics.depth_ );
+  EXPECT_EQ( 0u, queue.size() );
+}
+
+static void Produce( Core::EventQueue* queue, std::vector<int>* order, int producer, int num )
+{
+  for ( int j = 0; j < num; j++ )
+  {
+    boost::function< void () > function = boost::bind( &Record, order, producer * num + j );
+    queue->push( function );
+  }
+}
+
+TEST(EventQueueTests, HandlesConcurrentProducers)
+{
+  const int num_producers = 4;
+  const int num_events = 10000;
+  Core::EventQueue queue( 64 );
+  std::vector<int> order;
+
+  boost::thread_group producers;
+  for ( int j = 0; j < num_producers; j++ )
+  {
+    producers.create_thread( boost::bind( &Produce, &queue, &order, j, num_events ) );
+  }
+
+  size_t handled = 0;
+  boost::function< void () > function;
+  while ( handled < static_cast<size_t>( num_producers * num_events ) )
+  {
+    queue.wait();
+    while ( queue.pop( function ) ) 
+    {
+      function();
+      handled++;
+    }
+  }
+  producers.join_all();
+
+  // Events of each producer arrive in the order they were posted
+  ASSERT_EQ( static_cast<size_t>( num_producers * num_events ), order.size() );
+  std::vector<int> last( num_producers, -1 );
+  for ( size_t j = 0; j < order.size(); j++ )
+  {
+    int producer = order[ j ] / num_events;
+    EXPECT_LT( last[ producer ], order[ j ] );
+    last[ producer ] = order[ j ];
+  }
+  EXPECT_EQ( num_producers * num_events, queue.get_statistics().handled_ );
+}
+
+TEST(EventQueueTests, InterruptWakesWaitingThread)
+{
+  Core::EventQueue queue;
+  boost::thread waiter( boost::bind( &Core::EventQueue::wait, &queue ) );
+  queue.interrupt();
+  waiter.join();
+  EXPECT_EQ( 0u, queue.size() );
+}
@@ -0,0 +1,252 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <gtest/gtest.h>
+
+// system includes:
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <vector>
+
+// Boost includes:
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// local includes:
+#include <Core/ITKCommon/FFT/fft.hxx>
+#include <Core/ITKCommon/FFT/fft_common.hxx>
+#include <Core/ITKCommon/ThreadUtils/the_boost_mutex.hxx>
+
+namespace
+{
+
+// The fftw mutex is created on first use, so the creator needs to be set before any transform
+void SetupMutexCreator()
+{
+  the_mutex_interface_t::set_creator(the_boost_mutex_t::create);
+}
+
+// Deterministic noise, which gives a single sharp correlation peak
+itk_image_t::Pointer MakeNoise(unsigned int w, unsigned int h, unsigned int seed)
+{
+  itk_image_t::SizeType sz;
+  sz[0] = w;
+  sz[1] = h;
+  itk_image_t::Pointer image = make_image<itk_image_t>(sz);
+
+  unsigned int state = seed;
+  itk_image_t::IndexType ix;
+  for (ix[1] = 0; ix[1] < static_cast<long>(h); ++ix[1])
+  {
+    for (ix[0] = 0; ix[0] < static_cast<long>(w); ++ix[0])
+    {
+      state = state * 1664525u + 1013904223u;
+      image->SetPixel(ix, static_cast<float>(state >> 8) / static_cast<float>(1 << 24));
+    }
+  }
+  return image;
+}
+
+// Window of an image, the windows of one image at different offsets overlap
+itk_image_t::Pointer Crop(const itk_image_t::Pointer & image,
+    unsigned int x0, unsigned int y0, unsigned int w, unsigned int h)
+{
+  itk_image_t::SizeType sz;
+  sz[0] = w;
+  sz[1] = h;
+  itk_image_t::Pointer window = make_image<itk_image_t>(sz);
+
+  itk_image_t::IndexType ix;
+  itk_image_t::IndexType src;
+  for (ix[1] = 0; ix[1] < static_cast<long>(h); ++ix[1])
+  {
+    for (ix[0] = 0; ix[0] < static_cast<long>(w); ++ix[0])
+    {
+      src[0] = ix[0] + x0;
+      src[1] = ix[1] + y0;
+      window->SetPixel(ix, image->GetPixel(src));
+    }
+  }
+  return window;
+}
+
+// Spectrum of the image from a plan that is created for this transform only
+void FreshPlanFFT(const itk_image_t::Pointer & image, fft_data_t & out)
+{
+  out.setup(image);
+  fft_data_t in(out);
+  fftwf_plan plan = fftwf_plan_dft_2d(out.nx(),
+      out.ny(),
+      (fftwf_complex *)(in.data()),
+      (fftwf_complex *)(out.data()),
+      FFTW_FORWARD,
+      FFTW_ESTIMATE);
+  ASSERT_TRUE(plan != NULL);
+  fftwf_execute(plan);
+  fftwf_destroy_plan(plan);
+}
+
+void ExpectSameSpectrum(const fft_data_t & expected, const fft_data_t & actual)
+{
+  ASSERT_EQ(expected.nx(), actual.nx());
+  ASSERT_EQ(expected.ny(), actual.ny());
+
+  double scale = 0.0;
+  for (unsigned int i = 0; i < expected.nx() * expected.ny(); i++)
+  {
+    scale = std::max(scale, static_cast<double>(std::abs(expected.data()[i])));
+  }
+
+  for (unsigned int x = 0; x < expected.nx(); x++)
+  {
+    for (unsigned int y = 0; y < expected.ny(); y++)
+    {
+      EXPECT_NEAR(0.0, std::abs(expected(x, y) - actual(x, y)), 1e-5 * scale)
+        << "at " << x << ", " << y;
+    }
+  }
+}
+
+const local_max_t & BestMaximum(const std::list<local_max_t> & max_list)
+{
+  return *std::max_element(max_list.begin(), max_list.end());
+}
+
+void CorrelateOnThread(std::list<local_max_t> * max_list,
+    const itk_image_t * fi, const itk_image_t * mi)
+{
+  find_correlation<itk_image_t>(*max_list, fi, mi, 0.5, 0.1);
+}
+
+const unsigned int NUM_MOVING = 4;
+const unsigned int OFFSETS[ NUM_MOVING ][ 2 ] = { { 5, 3 }, { 0, 9 }, { 11, 1 }, { 7, 7 } };
+
+}
+
+TEST(FFTPlanCacheTest, CachedPlansMatchFreshPlans)
+{
+  SetupMutexCreator();
+
+  const unsigned int sizes[][ 2 ] = { { 64, 48 }, { 37, 29 }, { 64, 48 } };
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    itk_image_t::Pointer image = MakeNoise(sizes[i][0], sizes[i][1], 7 + i);
+
+    fft_data_t expected;
+    FreshPlanFFT(image, expected);
+
+    // the first transform of a size creates the plan, the next ones take it from the cache
+    fft_data_t first;
+    ASSERT_TRUE(fft(image, first));
+    ExpectSameSpectrum(expected, first);
+
+    fft_data_t second;
+    ASSERT_TRUE(fft(image, second));
+    ExpectSameSpectrum(expected, second);
+  }
+}
+
+TEST(FFTPlanCacheTest, CachedCorrelationMatchesFreshPlans)
+{
+  SetupMutexCreator();
+
+  itk_image_t::Pointer texture = MakeNoise(96, 96, 3);
+  itk_image_t::Pointer fi = Crop(texture, 0, 0, 64, 64);
+  std::vector<itk_image_t::Pointer> moving;
+  std::vector<const itk_image_t *> mi;
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    moving.push_back(Crop(texture, OFFSETS[i][0], OFFSETS[i][1], 64, 64));
+    mi.push_back(moving.back().GetPointer());
+  }
+
+  // one correlator for the whole batch reuses the plans, its buffers and the fixed spectrum
+  fft_correlator_t batch;
+  std::vector<std::list<local_max_t> > batch_lists;
+  ASSERT_GT(batch.correlate(batch_lists, fi.GetPointer(), mi, 0.5, 0.1), 0u);
+  ASSERT_EQ(NUM_MOVING, batch_lists.size());
+
+  // the same plans used by new correlators give the same results
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    fft_correlator_t single;
+    std::list<local_max_t> max_list;
+    single.correlate(max_list, fi.GetPointer(), mi[i], 0.5, 0.1);
+    EXPECT_TRUE(max_list == batch_lists[i]) << "moving image " << i;
+  }
+
+  // other planner flags are a different cache entry, so these plans are created anew
+  unsigned int flags = set_fftw_planner_flags(FFTW_ESTIMATE);
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    fft_correlator_t fresh;
+    std::list<local_max_t> max_list;
+    ASSERT_GT(fresh.correlate(max_list, fi.GetPointer(), mi[i], 0.5, 0.1), 0u);
+    ASSERT_FALSE(batch_lists[i].empty());
+
+    const local_max_t & expected = BestMaximum(max_list);
+    const local_max_t & actual = BestMaximum(batch_lists[i]);
+    EXPECT_NEAR(expected.x_, actual.x_, 1e-2) << "moving image " << i;
+    EXPECT_NEAR(expected.y_, actual.y_, 1e-2) << "moving image " << i;
+    EXPECT_NEAR(expected.value_, actual.value_, 1e-3 * std::fabs(expected.value_))
+      << "moving image " << i;
+  }
+  set_fftw_planner_flags(flags);
+}
+
+TEST(FFTPlanCacheTest, ThreadsShareCachedPlans)
+{
+  SetupMutexCreator();
+
+  itk_image_t::Pointer texture = MakeNoise(80, 72, 11);
+  itk_image_t::Pointer fi = Crop(texture, 0, 0, 48, 40);
+  std::vector<itk_image_t::Pointer> moving;
+  std::vector<std::list<local_max_t> > expected(NUM_MOVING);
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    moving.push_back(Crop(texture, OFFSETS[i][0], OFFSETS[i][1], 48, 40));
+    fft_correlator_t correlator;
+    correlator.correlate(expected[i], fi.GetPointer(), moving[i].GetPointer(), 0.5, 0.1);
+  }
+
+  // every thread correlates on its own correlator, and all of them share the cached plans
+  std::vector<std::list<local_max_t> > results(NUM_MOVING);
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    threads.create_thread(boost::bind(&CorrelateOnThread, &results[i],
+        fi.GetPointer(), moving[i].GetPointer()));
+  }
+  threads.join_all();
+
+  for (unsigned int i = 0; i < NUM_MOVING; i++)
+  {
+    EXPECT_TRUE(results[i] == expected[i]) << "moving image " << i;
+  }
+}
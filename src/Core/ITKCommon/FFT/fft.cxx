@@ -39,6 +39,8 @@
 #endif
 #include <string.h>
 #include <math.h>
+#include <map>
+#include <string>
 
 // ITK includes:
 #include <itkImage.h>
@@ -90,105 +92,208 @@ namespace itk_fft
   
   
   //----------------------------------------------------------------
-  // fft_cache_t
+  // FFTW_PLANNER_FLAGS
   // 
-  class fft_cache_t
+  // planning rigor of new plans, measured plans take longer to create
+  // but execute faster, and are created only once per transform size:
+  static unsigned int FFTW_PLANNER_FLAGS = FFTW_MEASURE;
+  
+  //----------------------------------------------------------------
+  // FFTW_WISDOM_PATH
+  // 
+  // file where the FFTW wisdom is saved whenever a new plan is created:
+  static std::string FFTW_WISDOM_PATH;
+  
+  //----------------------------------------------------------------
+  // set_fftw_planner_flags
+  // 
+  unsigned int set_fftw_planner_flags(unsigned int flags)
+  {
+    the_lock_t<the_mutex_interface_t> lock(fftw_mutex());
+    unsigned int prev = FFTW_PLANNER_FLAGS;
+    FFTW_PLANNER_FLAGS = flags;
+    return prev;
+  }
+  
+  //----------------------------------------------------------------
+  // set_fftw_wisdom_path
+  // 
+  bool set_fftw_wisdom_path(const std::string & path)
+  {
+    the_lock_t<the_mutex_interface_t> lock(fftw_mutex());
+    FFTW_WISDOM_PATH = path;
+    if (path.empty()) return false;
+    
+    // plans that were measured before are created from the wisdom:
+    return fftwf_import_wisdom_from_filename(path.c_str()) != 0;
+  }
+  
+  
+  //----------------------------------------------------------------
+  // fft_plan_key_t
+  // 
+  // FFTW plans are reused for every transform of the same
+  // size, kind, number of threads and planning rigor:
+  class fft_plan_key_t
   {
   public:
-    fft_cache_t():
-    fwd_(NULL),
-    inv_(NULL),
-    w_(0),
-    h_(0),
-    h_complex_(0),
-    h_padded_(0),
-    buffer_(NULL)
+    fft_plan_key_t(unsigned int w,
+                   unsigned int h,
+                   int kind,
+                   std::size_t num_threads,
+                   unsigned int flags):
+    w_(w),
+    h_(h),
+    kind_(kind),
+    num_threads_(num_threads),
+    flags_(flags)
     {}
     
-    ~fft_cache_t()
+    inline bool operator < (const fft_plan_key_t & key) const
     {
-      clear();
+      if (w_ != key.w_) return w_ < key.w_;
+      if (h_ != key.h_) return h_ < key.h_;
+      if (kind_ != key.kind_) return kind_ < key.kind_;
+      if (num_threads_ != key.num_threads_) return num_threads_ < key.num_threads_;
+      return flags_ < key.flags_;
     }
     
-    void clear()
+    unsigned int w_;
+    unsigned int h_;
+    int kind_;
+    std::size_t num_threads_;
+    unsigned int flags_;
+  };
+  
+  //----------------------------------------------------------------
+  // FFT_R2C
+  // 
+  // kind of the in-place real to complex transform used by fft,
+  // the complex transforms use their direction as kind:
+  static const int FFT_R2C = 0;
+  
+  //----------------------------------------------------------------
+  // fft_plan_cache_t
+  // 
+  // Plans shared by all threads. Executing a plan is thread safe,
+  // creating one is not, so plans are created under the fftw mutex.
+  // The plans are executed on other arrays than the ones they were
+  // created with, all of them are allocated with fftwf_malloc and
+  // therefore have the same alignment.
+  // 
+  class fft_plan_cache_t
+  {
+  public:
+    ~fft_plan_cache_t()
     {
-      if (buffer_)
+      for (std::map<fft_plan_key_t, fftwf_plan>::iterator i = plans_.begin();
+           i != plans_.end(); ++i)
       {
-        // fftw is not thread safe:
-        the_lock_t<the_mutex_interface_t> lock(fftw_mutex());
-        
-        fftwf_destroy_plan(fwd_);
-        fwd_ = NULL;
-        
-        fftwf_destroy_plan(inv_);
-        inv_ = NULL;
-        
-        fftwf_free(buffer_);
-        buffer_ = NULL;
+        if (i->second) fftwf_destroy_plan(i->second);
       }
-      
-      w_ = 0;
-      h_ = 0;
-      h_complex_ = 0;
-      h_padded_ = 0;
     }
     
-    void update(const unsigned int & w, const unsigned int & h)
+    fftwf_plan get(unsigned int w, unsigned int h, int kind)
     {
-      if (w_ == w && h_ == h)
-      {
-        return;
-      }
-      
       // fftw is not thread safe:
       the_lock_t<the_mutex_interface_t> lock(fftw_mutex());
       
-      if (buffer_)
+      fft_plan_key_t key(w, h, kind, NUM_FFTW_THREADS, FFTW_PLANNER_FLAGS);
+      std::map<fft_plan_key_t, fftwf_plan>::iterator found = plans_.find(key);
+      if (found != plans_.end())
       {
-        fftwf_destroy_plan(fwd_);
-        fftwf_destroy_plan(inv_);
-        fftwf_free(buffer_);
+        return found->second;
       }
       
-      w_ = w;
-      h_ = h;
+      // measuring overwrites the arrays, so plan on scratch arrays:
+      fftwf_plan plan = NULL;
+      fftwf_plan_with_nthreads(NUM_FFTW_THREADS);
+      if (kind == FFT_R2C)
+      {
+        const unsigned int h_padded = (h / 2 + 1) * 2;
+        float * buffer = (float *)(fftwf_malloc(w * h_padded * sizeof(float)));
+        plan = fftwf_plan_dft_r2c_2d(w,
+                                     h,
+                                     buffer,
+                                     (fftwf_complex *)buffer,
+                                     FFTW_DESTROY_INPUT | FFTW_PLANNER_FLAGS);
+        fftwf_free(buffer);
+      }
+      else
+      {
+        fft_data_t scratch_in(w, h);
+        fft_data_t scratch_out(w, h);
+        plan = fftwf_plan_dft_2d(w,
+                                 h,
+                                 (fftwf_complex *)(scratch_in.data()),
+                                 (fftwf_complex *)(scratch_out.data()),
+                                 kind,
+                                 FFTW_PLANNER_FLAGS);
+      }
       
-      h_complex_ = h_ / 2 + 1;
-      h_padded_ = h_complex_ * 2;
+      plans_[key] = plan;
+      if (plan && !FFTW_WISDOM_PATH.empty())
+      {
+        fftwf_export_wisdom_to_filename(FFTW_WISDOM_PATH.c_str());
+      }
       
-      buffer_ = (float *)(fftwf_malloc(w_ * h_padded_ * sizeof(float)));
-      fftwf_plan_with_nthreads(NUM_FFTW_THREADS);
-      fwd_ = fftwf_plan_dft_r2c_2d(w_,
-                                   h_,
-                                   buffer_,
-                                   (fftwf_complex *)buffer_,
-                                   FFTW_DESTROY_INPUT | FFTW_ESTIMATE);
+      return plan;
+    }
+    
+  private:
+    std::map<fft_plan_key_t, fftwf_plan> plans_;
+  };
+  
+  //----------------------------------------------------------------
+  // fft_plans
+  // 
+  static fft_plan_cache_t &
+  fft_plans()
+  {
+    static fft_plan_cache_t plans;
+    return plans;
+  }
+  
+  //----------------------------------------------------------------
+  // fft_buffer_t
+  // 
+  // Per thread buffer for the in-place real to complex transform.
+  // 
+  class fft_buffer_t
+  {
+  public:
+    fft_buffer_t():
+    size_(0),
+    data_(NULL)
+    {}
+    
+    ~fft_buffer_t()
+    {
+      if (data_) fftwf_free(data_);
+    }
+    
+    float * reserve(std::size_t size)
+    {
+      if (size > size_)
+      {
+        if (data_) fftwf_free(data_);
+        data_ = (float *)(fftwf_malloc(size * sizeof(float)));
+        size_ = data_ ? size : 0;
+      }
       
-      fft_data_t dummy_in(4, 4);
-      fft_data_t dummy_out(4, 4);
-      fftwf_plan_with_nthreads(NUM_FFTW_THREADS);
-      inv_ = fftwf_plan_dft_2d(w_,
-                               h_,
-                               (fftwf_complex *)(dummy_in.data()),
-                               (fftwf_complex *)(dummy_out.data()),
-                               FFTW_BACKWARD,
-                               FFTW_ESTIMATE);
+      return data_;
     }
     
-    fftwf_plan fwd_; // analysis, forward fft
-    fftwf_plan inv_; // synthesis, inverse fft
-    unsigned int w_;
-    unsigned int h_;
-    unsigned int h_complex_;
-    unsigned int h_padded_;
-    float * buffer_;
+  private:
+    std::size_t size_;
+    float * data_;
   };
   
   //----------------------------------------------------------------
   // tss
   // 
-  static boost::thread_specific_ptr<fft_cache_t> tss;
-  
+  static boost::thread_specific_ptr<fft_buffer_t> tss;
+
   //----------------------------------------------------------------
   // fft_data_t::fft_data_t
   // 
@@ -439,13 +544,20 @@ namespace itk_fft
     const unsigned int w = size[0];
     const unsigned int h = size[1];
     
-    fft_cache_t * cache = tss.get();
+    fftwf_plan plan = fft_plans().get(w, h, FFT_R2C);
+    if (!plan) return false;
+    
+    fft_buffer_t * cache = tss.get();
     if (!cache)
     {
-      cache = new fft_cache_t();
+      cache = new fft_buffer_t();
       tss.reset(cache);
     }
-    cache->update(w, h);
+    
+    const unsigned int h_complex = h / 2 + 1;
+    const unsigned int h_padded = h_complex * 2;
+    float * data = cache->reserve(w * h_padded);
+    if (!data) return false;
     
     // iterate over the image:
     itex_t itex(in, in->GetLargestPossibleRegion());
@@ -454,19 +566,15 @@ namespace itk_fft
       const index_t index = itex.GetIndex();
       const unsigned int x = index[0];
       const unsigned int y = index[1];
-      const unsigned int i = y + cache->h_padded_ * x;
+      const unsigned int i = y + h_padded * x;
       
-      cache->buffer_[i] = itex.Get();
+      data[i] = itex.Get();
     }
     
-    if (!cache->fwd_) return false;
-    fftwf_execute_dft_r2c(cache->fwd_,
-                          cache->buffer_,
-                          (fftwf_complex *)(cache->buffer_));
+    fftwf_execute_dft_r2c(plan, data, (fftwf_complex *)(data));
     
     // shortcuts:
-    const unsigned int h_complex = cache->h_complex_;
-    fft_complex_t * buffer = (fft_complex_t *)cache->buffer_;
+    fft_complex_t * buffer = (fft_complex_t *)data;
     
     // fill in the rest of the output data:
     out.resize(w, h);
@@ -497,13 +605,10 @@ namespace itk_fft
   {
     out.resize(in.nx(), in.ny());
     
-    fft_cache_t * cache = tss.get();
-    if (!cache)
-    {
-      return false;
-    }
+    fftwf_plan plan = fft_plans().get(in.nx(), in.ny(), FFTW_BACKWARD);
+    if (!plan) return false;
     
-    fftwf_execute_dft(cache->inv_,
+    fftwf_execute_dft(plan,
                       (fftwf_complex *)(in.data()),
                       (fftwf_complex *)(out.data()));
     return true;
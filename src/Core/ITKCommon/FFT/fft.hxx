@@ -44,6 +44,7 @@
 
 // system includes:
 #include <complex>
+#include <string>
 #include <stdlib.h>
 
 #include <Core/Utils/Exception.h>
@@ -57,6 +58,22 @@ namespace itk_fft
   // set's number of threads used by fftw, returns previous value:
   extern std::size_t set_num_fftw_threads(std::size_t num_threads);
   
+  //----------------------------------------------------------------
+  // set_fftw_planner_flags
+  //
+  // set's the planning rigor (FFTW_ESTIMATE, FFTW_MEASURE, ...) of
+  // new fftw plans, returns previous value. Plans are cached per
+  // transform size and direction and shared by all threads:
+  extern unsigned int set_fftw_planner_flags(unsigned int flags);
+  
+  //----------------------------------------------------------------
+  // set_fftw_wisdom_path
+  //
+  // load the fftw wisdom from a file, and save the wisdom to it
+  // whenever a new plan is created. Returns true if the wisdom
+  // was loaded:
+  extern bool set_fftw_wisdom_path(const std::string & path);
+  
   //----------------------------------------------------------------
   // itk_image_t
   // 
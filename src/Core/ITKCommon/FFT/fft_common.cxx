@@ -39,6 +39,9 @@
 
 #include <Core/Utils/Exception.h>
 
+// Boost includes:
+#include <boost/thread/tss.hpp>
+
 // system includes:
 #include <functional>
 
@@ -462,11 +465,38 @@ reject_negligible_overlap(std::list<overlap_t> & ol, const double threshold)
 
 
 //----------------------------------------------------------------
-// find_correlation
+// fft_correlator_t::fft_correlator_t
+//
+fft_correlator_t::fft_correlator_t():
+  fi_(NULL),
+  fi_mtime_(0),
+  fi_lp_filter_r_(0.0),
+  fi_lp_filter_s_(0.0)
+{
+  fi_padded_sz_.Fill(0);
+}
+
+//----------------------------------------------------------------
+// fft_correlator_t::clear
+//
+void
+fft_correlator_t::clear()
+{
+  fi_ = NULL;
+  fi_mtime_ = 0;
+  fi_padded_sz_.Fill(0);
+
+  f0_.cleanup();
+  f1_.cleanup();
+  P_.cleanup();
+  ifft_P_.cleanup();
+}
+
+//----------------------------------------------------------------
+// fft_correlator_t::correlate
 //
-template <>
 unsigned int
-find_correlation(std::list<local_max_t> & max_list,
+fft_correlator_t::correlate(std::list<local_max_t> & max_list,
     const itk_image_t * fi,
     const itk_image_t * mi,
 
@@ -476,20 +506,41 @@ find_correlation(std::list<local_max_t> & max_list,
     double lp_filter_s)
 {
   itk_image_t::SizeType max_sz = calc_padding<itk_image_t>(fi, mi);
-  itk_image_t::Pointer z0 = pad<itk_image_t>(fi, max_sz);
-  itk_image_t::Pointer z1 = pad<itk_image_t>(mi, max_sz);
 
-  fft_data_t f0;
-  fft(z0, f0);
-  f0.apply_lp_filter(lp_filter_r, lp_filter_s);
+  // the spectrum of the fixed image is still valid if the image has
+  // not been modified since, a new image always gets a new time stamp:
+  if (fi != fi_ ||
+      fi->GetMTime() != fi_mtime_ ||
+      max_sz != fi_padded_sz_ ||
+      lp_filter_r != fi_lp_filter_r_ ||
+      lp_filter_s != fi_lp_filter_s_)
+  {
+    fi_ = NULL;
+
+    itk_image_t::Pointer z0 = pad<itk_image_t>(fi, max_sz);
+    if (!fft(z0, f0_))
+    {
+      CORE_THROW_EXCEPTION("fft failed");
+    }
+    f0_.apply_lp_filter(lp_filter_r, lp_filter_s);
 
-  fft_data_t f1;
-  fft(z1, f1);
-  f1.apply_lp_filter(lp_filter_r, lp_filter_s);
+    fi_ = fi;
+    fi_mtime_ = fi->GetMTime();
+    fi_padded_sz_ = max_sz;
+    fi_lp_filter_r_ = lp_filter_r;
+    fi_lp_filter_s_ = lp_filter_s;
+  }
 
-  const unsigned int & nx = f0.nx();
-  const unsigned int & ny = f0.ny();
-  fft_data_t P(nx, ny);
+  itk_image_t::Pointer z1 = pad<itk_image_t>(mi, max_sz);
+  if (!fft(z1, f1_))
+  {
+    CORE_THROW_EXCEPTION("fft failed");
+  }
+  f1_.apply_lp_filter(lp_filter_r, lp_filter_s);
+
+  const unsigned int & nx = f0_.nx();
+  const unsigned int & ny = f0_.ny();
+  P_.resize(nx, ny);
 
   for (unsigned int x = 0; x < nx; x++)
   {
@@ -498,33 +549,31 @@ find_correlation(std::list<local_max_t> & max_list,
       //#if 1
       // Girod-Kuo, normalized cross power spectrum,
       // corresponds to phase correlation in spatial domain:
-      fft_complex_t p10 = f1(x, y) * std::conj(f0(x, y));
-      P(x, y) = _div(p10, _add(std::sqrt(p10 * std::conj(p10)), 1e-8f));
+      fft_complex_t p10 = f1_(x, y) * std::conj(f0_(x, y));
+      P_(x, y) = _div(p10, _add(std::sqrt(p10 * std::conj(p10)), 1e-8f));
       //#else
       //      // cross power spectrum,
       //      // corresponds to cross correlation in spatial domain:
-      //      P(x, y) = f1(x, y) * std::conj(f0(x, y));
+      //      P_(x, y) = f1_(x, y) * std::conj(f0_(x, y));
       //#endif
     }
   }
 
   // resampled data produces less noisy PDF and requires less smoothing:
-  P.apply_lp_filter(lp_filter_r * 0.8, lp_filter_s);
+  P_.apply_lp_filter(lp_filter_r * 0.8, lp_filter_s);
 
   // calculate the displacement probability density function:
-  fft_data_t ifft_P;
-
   //#ifndef NDEBUG // get around an annoying compiler warning:
   //  bool ok =
   //#endif
-  bool ok =ifft(P, ifft_P);
+  bool ok = ifft(P_, ifft_P_);
   //  assert(ok);
   if (! ok)
   {
     CORE_THROW_EXCEPTION("ifft failed");
   }
 
-  itk_image_t::Pointer PDF = ifft_P.real();
+  itk_image_t::Pointer PDF = ifft_P_.real();
 
   // look for the maxima in the PDF:
   double area = static_cast<double>(max_sz[0] * max_sz[1]);
@@ -544,3 +593,56 @@ find_correlation(std::list<local_max_t> & max_list,
   // find the maxima clusters:
   return find_maxima_cm(max_list, PDF, 1.0 - fraction);
 }
+
+//----------------------------------------------------------------
+// fft_correlator_t::correlate
+//
+unsigned int
+fft_correlator_t::correlate(std::vector<std::list<local_max_t> > & max_lists,
+    const itk_image_t * fi,
+    const std::vector<const itk_image_t *> & mi,
+    double lp_filter_r,
+    double lp_filter_s)
+{
+  unsigned int total = 0;
+  max_lists.resize(mi.size());
+  for (std::size_t i = 0; i < mi.size(); i++)
+  {
+    max_lists[i].clear();
+    total += correlate(max_lists[i], fi, mi[i], lp_filter_r, lp_filter_s);
+  }
+
+  return total;
+}
+
+//----------------------------------------------------------------
+// correlator_tss
+//
+// Every thread keeps a correlator, so that consecutive correlations
+// on a thread reuse its buffers and the fixed image spectrum:
+//
+static boost::thread_specific_ptr<fft_correlator_t> correlator_tss;
+
+//----------------------------------------------------------------
+// find_correlation
+//
+template <>
+unsigned int
+find_correlation(std::list<local_max_t> & max_list,
+    const itk_image_t * fi,
+    const itk_image_t * mi,
+
+    // low pass filter parameters
+    // (resampled data requires less smoothing):
+    double lp_filter_r,
+    double lp_filter_s)
+{
+  fft_correlator_t * correlator = correlator_tss.get();
+  if (!correlator)
+  {
+    correlator = new fft_correlator_t();
+    correlator_tss.reset(correlator);
+  }
+
+  return correlator->correlate(max_list, fi, mi, lp_filter_r, lp_filter_s);
+}
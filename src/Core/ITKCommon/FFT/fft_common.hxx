@@ -46,6 +46,7 @@
 #include <list>
 #include <limits.h>
 #include <sstream>
+#include <vector>
 
 #ifndef WIN32
 #include <unistd.h>
@@ -206,6 +207,56 @@ find_correlation(std::list<local_max_t> & max_list,
     double lp_filter_s);
 
 
+//----------------------------------------------------------------
+// fft_correlator_t
+//
+// Phase correlation of image pairs. The transform buffers are kept
+// between correlations, and the filtered spectrum of the fixed image
+// is reused while one fixed image is correlated with several moving
+// images, as when a tile is matched against its neighbors.
+//
+class fft_correlator_t
+{
+  public:
+    fft_correlator_t();
+
+    // find the maxima of the displacement probability density function
+    // of the moving image relative to the fixed image,
+    // returns the number of maxima found:
+    unsigned int correlate(std::list<local_max_t> & max_list,
+        const itk_image_t * fi,
+        const itk_image_t * mi,
+        double lp_filter_r,
+        double lp_filter_s);
+
+    // correlate one fixed image with a batch of moving images,
+    // returns the total number of maxima found:
+    unsigned int correlate(std::vector<std::list<local_max_t> > & max_lists,
+        const itk_image_t * fi,
+        const std::vector<const itk_image_t *> & mi,
+        double lp_filter_r,
+        double lp_filter_s);
+
+    // release the buffers and forget the fixed image:
+    void clear();
+
+  private:
+    // the fixed image whose spectrum is in f0_:
+    const itk_image_t * fi_;
+    unsigned long fi_mtime_;
+    itk_image_t::SizeType fi_padded_sz_;
+    double fi_lp_filter_r_;
+    double fi_lp_filter_s_;
+
+    // spectra of the fixed and moving images, cross power spectrum
+    // and displacement probability density function:
+    fft_data_t f0_;
+    fft_data_t f1_;
+    fft_data_t P_;
+    fft_data_t ifft_P_;
+};
+
+
 //----------------------------------------------------------------
 // find_correlation
 //
@@ -43,6 +43,9 @@
 #include <Core/Utils/Log.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+
+#include <algorithm>
 
 namespace bfs=boost::filesystem;
 
@@ -73,6 +76,22 @@ IRImageLoader::sharedImageLoader()
   return __sharedIRImageLoader;
 }
 
+//----------------------------------------------------------------
+// IMAGE_CACHE_SIZE, FULL_RES_IMAGE_CACHE_SIZE, MASK_CACHE_SIZE
+// 
+// default byte budgets of the image caches:
+// 
+static const std::size_t IMAGE_CACHE_SIZE = std::size_t(1) << 30;
+static const std::size_t FULL_RES_IMAGE_CACHE_SIZE = std::size_t(512) << 20;
+static const std::size_t MASK_CACHE_SIZE = std::size_t(256) << 20;
+
+//----------------------------------------------------------------
+// PREFETCH_DEPTH
+// 
+// default number of images to load ahead of time:
+// 
+static const unsigned int PREFETCH_DEPTH = 2;
+
 //----------------------------------------------------------------
 // IRImageLoader::IRImageLoader
 // 
@@ -80,20 +99,32 @@ IRImageLoader::IRImageLoader() :
   SHRINK_FACTOR(1),
   PIXEL_SPACING(1.0),
   _shrinkFactor(SHRINK_FACTOR),
-  _pixelSpacing(PIXEL_SPACING)
+  _pixelSpacing(PIXEL_SPACING),
+  _images(IMAGE_CACHE_SIZE),
+  _fullResImages(FULL_RES_IMAGE_CACHE_SIZE),
+  _masks(MASK_CACHE_SIZE),
+  _prefetchThreadStarted(false),
+  _stopPrefetch(false),
+  _prefetchDepth(PREFETCH_DEPTH)
 {}
 
 //----------------------------------------------------------------
 // IRImageLoader::~IRImageLoader
 // 
 IRImageLoader::~IRImageLoader()
-{}
-
-//----------------------------------------------------------------
-// __IRImageLoaderImageAcessLock
-// 
-static itk::SimpleMutexLock __IRImageLoaderImageAcessLock;
-static itk::SimpleMutexLock __IRImageLoaderMaskAcessLock;
+{
+  {
+    boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+    _stopPrefetch = true;
+    _prefetchQueue.clear();
+  }
+  _prefetchCondition.notify_all();
+  
+  if (_prefetchThreadStarted)
+  {
+    _prefetchThread.join();
+  }
+}
 
 //----------------------------------------------------------------
 // IRImageLoader::setTransformList
@@ -102,17 +133,34 @@ void
 IRImageLoader::setTransformList(const IRTransformVector & transforms,
                                 const TheTextVector & imageIDs)
 {
-  __IRImageLoaderImageAcessLock.Lock();
-  
   IRTransformVector::const_iterator transformIter = transforms.begin();
   TheTextVector::const_iterator imageIDIter = imageIDs.begin();
   for (; transformIter != transforms.end(); transformIter++, imageIDIter++)
   {
     _transformations[*imageIDIter] = *transformIter;
   }
-  _images = imageMap();
+  _images.clear();
+  
+  setImageOrder(imageIDs);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::setImageOrder
+// 
+void
+IRImageLoader::setImageOrder(const TheTextVector & imageIDs)
+{
+  boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+  
+  _imageOrder = imageIDs;
+  _imageOrderIndex.clear();
+  _prefetchQueue.clear();
   
-  __IRImageLoaderImageAcessLock.Unlock();
+  // if an image appears more than once the first position is used:
+  for (std::size_t i = 0; i < _imageOrder.size(); i++)
+  {
+    _imageOrderIndex.insert(std::make_pair(_imageOrder[i], i));
+  }
 }
 
 //----------------------------------------------------------------
@@ -121,7 +169,14 @@ IRImageLoader::setTransformList(const IRTransformVector & transforms,
 void
 IRImageLoader::setShrinkFactor(unsigned int shrinkFactor)
 {
-  _shrinkFactor = shrinkFactor;
+  {
+    boost::lock_guard<boost::mutex> lock(_settingsMutex);
+    if (shrinkFactor == _shrinkFactor) return;
+    _shrinkFactor = shrinkFactor;
+  }
+  
+  // the cached and queued shrunken images no longer match:
+  clearShrunkenImages();
 }
 
 //----------------------------------------------------------------
@@ -130,6 +185,7 @@ IRImageLoader::setShrinkFactor(unsigned int shrinkFactor)
 unsigned int
 IRImageLoader::shrinkFactor()
 {
+  boost::lock_guard<boost::mutex> lock(_settingsMutex);
   return _shrinkFactor;
 }
 
@@ -139,7 +195,13 @@ IRImageLoader::shrinkFactor()
 void
 IRImageLoader::setPixelSpacing(double pixelSpacing)
 {
-  _pixelSpacing = pixelSpacing;
+  {
+    boost::lock_guard<boost::mutex> lock(_settingsMutex);
+    if (pixelSpacing == _pixelSpacing) return;
+    _pixelSpacing = pixelSpacing;
+  }
+  
+  clearShrunkenImages();
 }
 
 //----------------------------------------------------------------
@@ -148,9 +210,75 @@ IRImageLoader::setPixelSpacing(double pixelSpacing)
 double
 IRImageLoader::pixelSpacing()
 {
+  boost::lock_guard<boost::mutex> lock(_settingsMutex);
   return _pixelSpacing;
 }
 
+//----------------------------------------------------------------
+// IRImageLoader::clearShrunkenImages
+// 
+void
+IRImageLoader::clearShrunkenImages()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+    _prefetchQueue.clear();
+  }
+  
+  // images that are still being loaded with the previous settings
+  // are not added to the caches once they are done:
+  _images.clear();
+  _masks.clear();
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::setImageCacheSize
+// 
+void
+IRImageLoader::setImageCacheSize(std::size_t bytes)
+{
+  _images.setMaxBytes(bytes);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::setFullResImageCacheSize
+// 
+void
+IRImageLoader::setFullResImageCacheSize(std::size_t bytes)
+{
+  _fullResImages.setMaxBytes(bytes);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::setMaskCacheSize
+// 
+void
+IRImageLoader::setMaskCacheSize(std::size_t bytes)
+{
+  _masks.setMaxBytes(bytes);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::setPrefetchDepth
+// 
+void
+IRImageLoader::setPrefetchDepth(unsigned int depth)
+{
+  boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+  _prefetchDepth = depth;
+  if (depth == 0) _prefetchQueue.clear();
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::prefetchDepth
+// 
+unsigned int
+IRImageLoader::prefetchDepth()
+{
+  boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+  return _prefetchDepth;
+}
+
 //----------------------------------------------------------------
 // IRImageLoader::getImageSize
 // 
@@ -180,7 +308,7 @@ IRImageLoader::getImageSize(const std::string& imageID,
     pnt2d_t bbox_max;
     calc_image_bbox<image_t>(image, bbox_min, bbox_max);
     imageSize = bbox_max - bbox_min;
-    imageSize *= _pixelSpacing;
+    imageSize *= pixelSpacing();
   }
   
   return imageSize;
@@ -189,21 +317,16 @@ IRImageLoader::getImageSize(const std::string& imageID,
 //----------------------------------------------------------------
 // IRImageLoader::getFullResImage
 // 
-// this does not cache the image
-// 
 image_t::Pointer
 IRImageLoader::getFullResImage(const std::string& imageID)
 {
-  bfs::path imagePath(imageID);
-  if (! bfs::exists(imagePath) )
-  {
-    std::ostringstream oss;
-    oss << "Tile " << imageID << " cannot be found.";
-    CORE_LOG_WARNING(oss.str());
-  }
-  return std_tile<image_t>(imagePath,
-                           SHRINK_FACTOR,
-                           PIXEL_SPACING);
+  image_t::Pointer image =
+    _fullResImages.get(imageID,
+                       boost::bind(&IRImageLoader::loadFullResImage,
+                                   this,
+                                   imageID));
+  schedulePrefetch(imageID, true);
+  return image;
 }
 
 //----------------------------------------------------------------
@@ -212,12 +335,10 @@ IRImageLoader::getFullResImage(const std::string& imageID)
 image_t::Pointer
 IRImageLoader::getImage(const std::string& imageID)
 {
-  imageCheckLoad(imageID);
-  
-  __IRImageLoaderImageAcessLock.Lock();
-  image_t::Pointer image = _images[imageID];
-  __IRImageLoaderImageAcessLock.Unlock();
-  
+  image_t::Pointer image =
+    _images.get(imageID,
+                boost::bind(&IRImageLoader::loadImage, this, imageID));
+  schedulePrefetch(imageID, false);
   return image;
 }
 
@@ -227,84 +348,150 @@ IRImageLoader::getImage(const std::string& imageID)
 mask_t::Pointer
 IRImageLoader::getMask(const std::string& maskID)
 {
-  maskCheckLoad(maskID);
+  if (maskID.empty())
+  {
+    return mask_t::Pointer();
+  }
   
-  __IRImageLoaderImageAcessLock.Lock();
-  mask_t::Pointer mask = _masks[maskID];
-  __IRImageLoaderImageAcessLock.Unlock();
+  return _masks.get(maskID,
+                    boost::bind(&IRImageLoader::loadMask, this, maskID));
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::loadImage
+// 
+image_t::Pointer
+IRImageLoader::loadImage(const std::string& imageID)
+{
+  unsigned int shrinkFactor;
+  double pixelSpacing;
+  {
+    boost::lock_guard<boost::mutex> lock(_settingsMutex);
+    shrinkFactor = _shrinkFactor;
+    pixelSpacing = _pixelSpacing;
+  }
   
-  return mask;
+  return std_tile<image_t>(imageID.c_str(), shrinkFactor, pixelSpacing);
 }
 
 //----------------------------------------------------------------
-// IRImageLoader::imageCheckLoad
+// IRImageLoader::loadFullResImage
+// 
+image_t::Pointer
+IRImageLoader::loadFullResImage(const std::string& imageID)
+{
+  bfs::path imagePath(imageID);
+  if (! bfs::exists(imagePath) )
+  {
+    std::ostringstream oss;
+    oss << "Tile " << imageID << " cannot be found.";
+    CORE_LOG_WARNING(oss.str());
+  }
+  return std_tile<image_t>(imagePath,
+                           SHRINK_FACTOR,
+                           PIXEL_SPACING);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::loadMask
+// 
+mask_t::Pointer
+IRImageLoader::loadMask(const std::string& maskID)
+{
+  unsigned int shrinkFactor;
+  double pixelSpacing;
+  {
+    boost::lock_guard<boost::mutex> lock(_settingsMutex);
+    shrinkFactor = _shrinkFactor;
+    pixelSpacing = _pixelSpacing;
+  }
+  
+  return std_tile<mask_t>(maskID.c_str(), shrinkFactor, pixelSpacing);
+}
+
+//----------------------------------------------------------------
+// IRImageLoader::schedulePrefetch
 // 
 void
-IRImageLoader::imageCheckLoad(const std::string& imageID)
+IRImageLoader::schedulePrefetch(const std::string& imageID, bool fullRes)
 {
-  __IRImageLoaderImageAcessLock.Lock();
+  boost::lock_guard<boost::mutex> lock(_prefetchMutex);
+  if (_prefetchDepth == 0 || _stopPrefetch) return;
   
-  if (_images.find(imageID) != _images.end())
+  boost::unordered_map<std::string, std::size_t>::const_iterator found =
+    _imageOrderIndex.find(imageID);
+  if (found == _imageOrderIndex.end()) return;
+  
+  // the most recent request decides what is needed next,
+  // anything still queued from earlier requests is dropped:
+  _prefetchQueue.clear();
+  
+  imageCache & cache = fullRes ? _fullResImages : _images;
+  std::size_t end = std::min(found->second + 1 + _prefetchDepth,
+                             _imageOrder.size());
+  for (std::size_t i = found->second + 1; i < end; i++)
   {
-    while (_images[imageID].IsNull())
+    if (!cache.contains(_imageOrder[i]))
     {
-      // if another thread is already loading this same image,
-      // spin until it is loaded
-      __IRImageLoaderImageAcessLock.Unlock();
-      sleep_msec(1000);
-      __IRImageLoaderImageAcessLock.Lock();
+      _prefetchQueue.push_back(std::make_pair(_imageOrder[i], fullRes));
     }
-    
-    __IRImageLoaderImageAcessLock.Unlock();
-    return;
   }
   
-  _images[imageID] = NULL;
-  __IRImageLoaderImageAcessLock.Unlock();
+  if (_prefetchQueue.empty()) return;
   
-  image_t::Pointer image = std_tile<image_t>(imageID.c_str(),
-                                             _shrinkFactor,
-                                             _pixelSpacing);
+  if (!_prefetchThreadStarted)
+  {
+    _prefetchThread =
+      boost::thread(boost::bind(&IRImageLoader::prefetchLoop, this));
+    _prefetchThreadStarted = true;
+  }
   
-  __IRImageLoaderImageAcessLock.Lock();
-  _images[imageID] = image;
-  __IRImageLoaderImageAcessLock.Unlock();
+  _prefetchCondition.notify_one();
 }
 
 //----------------------------------------------------------------
-// IRImageLoader::maskCheckLoad
+// IRImageLoader::prefetchLoop
 // 
 void
-IRImageLoader::maskCheckLoad(const std::string& maskID)
+IRImageLoader::prefetchLoop()
 {
-  __IRImageLoaderMaskAcessLock.Lock();
-  
-  if (_masks.find(maskID) != _masks.end())
+  while (true)
   {
-    if ( !maskID.empty() )
+    std::pair<std::string, bool> next;
     {
-      while (_masks[maskID].IsNull())
+      boost::unique_lock<boost::mutex> lock(_prefetchMutex);
+      while (_prefetchQueue.empty() && !_stopPrefetch)
       {
-        // if another thread is already loading this same image,
-        // spin until it is loaded
-        __IRImageLoaderMaskAcessLock.Unlock();
-        sleep_msec(1000);
-        __IRImageLoaderMaskAcessLock.Lock();
+        _prefetchCondition.wait(lock);
       }
+      
+      if (_stopPrefetch) return;
+      
+      next = _prefetchQueue.front();
+      _prefetchQueue.pop_front();
     }
     
-    __IRImageLoaderMaskAcessLock.Unlock();
-    return;
+    try
+    {
+      if (next.second)
+      {
+        _fullResImages.get(next.first,
+                           boost::bind(&IRImageLoader::loadFullResImage,
+                                       this,
+                                       next.first));
+      }
+      else
+      {
+        _images.get(next.first,
+                    boost::bind(&IRImageLoader::loadImage,
+                                this,
+                                next.first));
+      }
+    }
+    catch (...)
+    {
+      // the tile will be loaded, and the error reported,
+      // when it is actually requested
+    }
   }
-  
-  _masks[maskID] = NULL;
-  __IRImageLoaderMaskAcessLock.Unlock();
-  
-  mask_t::Pointer mask;
-  if ( !maskID.empty() )
-    mask = std_tile<mask_t>(maskID.c_str(), _shrinkFactor, _pixelSpacing);
-  
-  __IRImageLoaderMaskAcessLock.Lock();
-  _masks[maskID] = mask;
-  __IRImageLoaderMaskAcessLock.Unlock();
 }
@@ -36,7 +36,9 @@
 #define __IR_IMAGE_LOADER_HXX__
 
 #include <vector>
+#include <list>
 #include <map>
+#include <deque>
 
 #include <Core/ITKCommon/common.hxx>
 #include <Core/ITKCommon/the_text.hxx>
@@ -44,29 +46,192 @@
 
 #include <itkTransformBase.h>
 
+#include <boost/unordered_map.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 class IRTransform;
 
-class IRImageLoader
+//----------------------------------------------------------------
+// IRImageCache
+// 
+// A least recently used cache of images keyed by the image path,
+// bounded by the number of bytes of pixel data it holds. An image
+// is loaded once, by the first thread that asks for it; any other
+// thread asking for the same image while it is being loaded waits
+// for it instead of loading it again. Images whose load started
+// before the cache was cleared are not added to it, since they may
+// have been loaded with settings that no longer apply.
+// 
+template <typename image_pointer_t>
+class IRImageCache
 {
+public:
+  typedef boost::function<image_pointer_t()> Loader;
   
-  struct lt_the_text
+  IRImageCache(std::size_t maxBytes):
+    _maxBytes(maxBytes),
+    _bytes(0),
+    _generation(0)
+  {}
+  
+  // return the cached image, load it if it is not cached yet:
+  image_pointer_t get(const std::string& imageID, const Loader& loader)
   {
-    bool operator()(const std::string& s1, const std::string& s2) const
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    
+    typename EntryMap::iterator found = _entries.find(imageID);
+    while (found != _entries.end() && found->second.loading)
+    {
+      _loaded.wait(lock);
+      found = _entries.find(imageID);
+    }
+    
+    if (found != _entries.end())
+    {
+      // move it to the front of the LRU list:
+      _lru.splice(_lru.begin(), _lru, found->second.lru);
+      return found->second.image;
+    }
+    
+    _entries[imageID].loading = true;
+    const std::size_t generation = _generation;
+    lock.unlock();
+    
+    image_pointer_t image;
+    try
+    {
+      image = loader();
+    }
+    catch (...)
+    {
+      lock.lock();
+      if (generation == _generation)
+      {
+        _entries.erase(imageID);
+      }
+      _loaded.notify_all();
+      throw;
+    }
+    
+    lock.lock();
+    if (generation != _generation)
     {
-      the_text_t t1(s1.c_str());
-      the_text_t t2(s2.c_str());
-      return (t1 < t2);
+      // the cache was cleared while the image was loading, the
+      // caller gets the image but it is not cached:
+      _loaded.notify_all();
+      return image;
     }
+    
+    Entry & entry = _entries[imageID];
+    entry.image = image;
+    entry.bytes = byteSize(image);
+    entry.loading = false;
+    entry.lru = _lru.insert(_lru.begin(), imageID);
+    _bytes += entry.bytes;
+    evict();
+    _loaded.notify_all();
+    
+    return image;
+  }
+  
+  // check whether an image is cached or being loaded:
+  bool contains(const std::string& imageID)
+  {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _entries.find(imageID) != _entries.end();
+  }
+  
+  // drop all images, images that are still being loaded are not
+  // added when they are done and are loaded again when requested:
+  void clear()
+  {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+    _bytes = 0;
+    _generation++;
+    _loaded.notify_all();
+  }
+  
+  void setMaxBytes(std::size_t maxBytes)
+  {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _maxBytes = maxBytes;
+    evict();
+  }
+  
+  std::size_t maxBytes()
+  {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _maxBytes;
+  }
+  
+  std::size_t bytes()
+  {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    return _bytes;
+  }
+  
+private:
+  struct Entry
+  {
+    Entry(): bytes(0), loading(false) {}
+    
+    image_pointer_t image;
+    std::size_t bytes;
+    bool loading;
+    std::list<std::string>::iterator lru;
   };
   
-  //typedef std::map<the_text_t, IRTransform*, struct lt_the_text> transformationMap;
-  //typedef std::map<the_text_t, image_t::Pointer, struct lt_the_text> imageMap;
-  //typedef std::map<the_text_t, mask_t::Pointer, struct lt_the_text> maskMap;
-  //typedef std::vector<IRTransform*> IRTransformVector;
-  //typedef std::vector<the_text_t> TheTextVector;
-  typedef std::map<std::string, IRTransform*, struct lt_the_text> transformationMap;
-  typedef std::map<std::string, image_t::Pointer, struct lt_the_text> imageMap;
-  typedef std::map<std::string, mask_t::Pointer, struct lt_the_text> maskMap;
+  typedef boost::unordered_map<std::string, Entry> EntryMap;
+  
+  static std::size_t byteSize(const image_pointer_t& image)
+  {
+    if (image.IsNull()) return 0;
+    
+    typedef typename image_pointer_t::ObjectType::PixelType pixel_t;
+    return (image->GetBufferedRegion().GetNumberOfPixels() *
+            sizeof(pixel_t));
+  }
+  
+  // drop the least recently used images until the cache fits its
+  // budget, the most recently used image is always kept. Images
+  // that are still referenced by a caller stay alive until the
+  // caller releases them:
+  void evict()
+  {
+    while (_bytes > _maxBytes && _lru.size() > 1)
+    {
+      typename EntryMap::iterator found = _entries.find(_lru.back());
+      _bytes -= found->second.bytes;
+      _entries.erase(found);
+      _lru.pop_back();
+    }
+  }
+  
+  boost::mutex _mutex;
+  boost::condition_variable _loaded;
+  EntryMap _entries;
+  
+  // most recently used image first:
+  std::list<std::string> _lru;
+  
+  std::size_t _maxBytes;
+  std::size_t _bytes;
+  
+  // incremented every time the cache is cleared:
+  std::size_t _generation;
+};
+
+
+class IRImageLoader
+{
+  typedef boost::unordered_map<std::string, IRTransform*> transformationMap;
+  typedef IRImageCache<image_t::Pointer> imageCache;
+  typedef IRImageCache<mask_t::Pointer> maskCache;
   typedef std::vector<IRTransform*> IRTransformVector;
   typedef std::vector<std::string> TheTextVector;
   
@@ -75,32 +240,70 @@ public:
   
   virtual ~IRImageLoader();
   
+  // this also sets the order in which the images are prefetched:
   void setTransformList(const IRTransformVector& transforms, const TheTextVector& imageIDs);
   
+  // the images following the one that was just requested in this
+  // list are loaded ahead of time on a worker thread:
+  void setImageOrder(const TheTextVector& imageIDs);
+  
   void setShrinkFactor(unsigned int shrinkFactor);
   unsigned int shrinkFactor();
   void setPixelSpacing(double pixelSpacing);
   double pixelSpacing();
   
+  // byte budgets of the shrunken image, full resolution image
+  // and mask caches, each cache evicts its images independently:
+  void setImageCacheSize(std::size_t bytes);
+  void setFullResImageCacheSize(std::size_t bytes);
+  void setMaskCacheSize(std::size_t bytes);
+  
+  // number of images to prefetch, 0 disables prefetching:
+  void setPrefetchDepth(unsigned int depth);
+  unsigned int prefetchDepth();
+  
   image_t::Pointer getImage(const std::string& imageID);
   mask_t::Pointer  getMask(const std::string& maskID);
-  image_t::Pointer getFullResImage(const std::string& imageID); // this does not cache the image
+  image_t::Pointer getFullResImage(const std::string& imageID);
   vec2d_t getImageSize(const std::string& imageID, base_transform_t::Pointer transform);
   
 private:
   IRImageLoader();
   
-  void imageCheckLoad(const std::string& imageID); 
-  void maskCheckLoad(const std::string& maskID); 
+  image_t::Pointer loadImage(const std::string& imageID);
+  image_t::Pointer loadFullResImage(const std::string& imageID);
+  mask_t::Pointer loadMask(const std::string& maskID);
+  
+  // drop the shrunken images and masks after their settings changed:
+  void clearShrunkenImages();
+  
+  // queue the images that follow imageID in the image order:
+  void schedulePrefetch(const std::string& imageID, bool fullRes);
+  void prefetchLoop();
 
   const unsigned int SHRINK_FACTOR;
   const double PIXEL_SPACING;
   
+  // guards the shrink factor and pixel spacing, which are read by
+  // the threads that load images:
+  boost::mutex _settingsMutex;
   unsigned int _shrinkFactor;
   double _pixelSpacing;
-  imageMap _images;
-  maskMap _masks;
+  imageCache _images;
+  imageCache _fullResImages;
+  maskCache _masks;
   transformationMap _transformations;
+  
+  // prefetching:
+  boost::mutex _prefetchMutex;
+  boost::condition_variable _prefetchCondition;
+  boost::thread _prefetchThread;
+  bool _prefetchThreadStarted;
+  bool _stopPrefetch;
+  unsigned int _prefetchDepth;
+  TheTextVector _imageOrder;
+  boost::unordered_map<std::string, std::size_t> _imageOrderIndex;
+  std::deque<std::pair<std::string, bool> > _prefetchQueue;
 };
 
 
@@ -42,6 +42,7 @@
 #include <Core/ITKCommon/Transform/IRRefineTranslateCanvas.hxx>
 #include <Core/ITKCommon/Transform/IRTransform.hxx>
 #include <Core/ITKCommon/Transform/IRConnection.hxx>
+#include <Core/ITKCommon/IRImageLoader.hxx>
 
 
 //----------------------------------------------------------------
@@ -74,6 +75,14 @@ setBaseTransforms(const TrasformBasePointerVector & transforms,
   TrasformBasePointerVector::const_iterator transformIter =
   transforms.begin();
   
+  // load the tiles ahead of the transforms that need them:
+  std::vector<std::string> imageOrder;
+  for (TheTextVector::const_iterator i = imageIDs.begin(); i != imageIDs.end(); ++i)
+  {
+    imageOrder.push_back(i->string());
+  }
+  IRImageLoader::sharedImageLoader()->setImageOrder(imageOrder);
+  
   TheTextVector::const_iterator imageIDIter = imageIDs.begin();
   TheTextVector::const_iterator maskIDIter = maskIDs.begin();
   for (; transformIter != transforms.end(); transformIter++, imageIDIter++, maskIDIter++)
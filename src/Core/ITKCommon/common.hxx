@@ -40,6 +40,7 @@
 // local includes:
 #include <Core/ITKCommon/the_text.hxx>
 #include <Core/ITKCommon/the_utils.hxx>
+#include <Core/ITKCommon/mosaic_tile_index.hxx>
 #include <Core/ITKCommon/ThreadUtils/itk_terminator.hxx>
 #include <Core/ITKCommon/ThreadUtils/the_boost_thread.hxx>
 #include <Core/ITKCommon/ThreadUtils/the_transaction.hxx>
@@ -2473,6 +2474,261 @@ typedef enum {
   FEATHER_BINARY_E
 } feathering_t;
 
+//----------------------------------------------------------------
+// MOSAIC_BLOCK_SIZE
+// 
+// The mosaic is assembled in square blocks of pixels. The tiles
+// overlapping a block are looked up once for the whole block,
+// and the pixels of a block stay in cache while it is assembled.
+// 
+static const unsigned int MOSAIC_BLOCK_SIZE = 64;
+
+//----------------------------------------------------------------
+// calc_num_mosaic_blocks
+// 
+// Number of blocks the mosaic is assembled in.
+// 
+template <class region_t>
+unsigned int
+calc_num_mosaic_blocks(const region_t & region)
+{
+  const typename region_t::SizeType & size = region.GetSize();
+  unsigned int bx = (size[0] + MOSAIC_BLOCK_SIZE - 1) / MOSAIC_BLOCK_SIZE;
+  unsigned int by = (size[1] + MOSAIC_BLOCK_SIZE - 1) / MOSAIC_BLOCK_SIZE;
+  return bx * by;
+}
+
+//----------------------------------------------------------------
+// get_mosaic_block
+// 
+// Region covered by a given block of the mosaic, the blocks
+// are numbered in row order.
+// 
+template <class region_t>
+region_t
+get_mosaic_block(const region_t & region, const unsigned int block)
+{
+  const typename region_t::SizeType & size = region.GetSize();
+  unsigned int bx = (size[0] + MOSAIC_BLOCK_SIZE - 1) / MOSAIC_BLOCK_SIZE;
+  unsigned int x = (block % bx) * MOSAIC_BLOCK_SIZE;
+  unsigned int y = (block / bx) * MOSAIC_BLOCK_SIZE;
+  
+  typename region_t::IndexType index = region.GetIndex();
+  index[0] += x;
+  index[1] += y;
+  
+  typename region_t::SizeType block_size;
+  block_size[0] = std::min<unsigned int>(MOSAIC_BLOCK_SIZE, size[0] - x);
+  block_size[1] = std::min<unsigned int>(MOSAIC_BLOCK_SIZE, size[1] - y);
+  
+  return region_t(index, block_size);
+}
+
+//----------------------------------------------------------------
+// assemble_mosaic_block
+// 
+// Assemble one block of the mosaic from the tiles that overlap it.
+// The tile index contains only the tiles that are not omitted.
+// 
+template <class image_pointer_t, class transform_pointer_t>
+void
+assemble_mosaic_block
+(// mosaic being assembled, the mask is optional:
+ typename image_pointer_t::ObjectType::Pointer::ObjectType * mosaic,
+ mask_t * mosaic_mask,
+ 
+ // block of the mosaic to assemble:
+ const typename image_pointer_t::ObjectType::RegionType & block,
+ 
+ // mosaic space tile index:
+ const mosaic_tile_index_t & tile_index,
+ 
+ // tile tint and transforms:
+ const std::vector<double> & tint,
+ const std::vector<transform_pointer_t> & transform,
+ 
+ // tile and tile mask interpolators:
+ const std::vector<typename itk::LinearInterpolateImageFunction
+ <typename image_pointer_t::ObjectType::Pointer::ObjectType, double>::Pointer> & img,
+ const std::vector<itk::NearestNeighborInterpolateImageFunction
+ <mask_t, double>::Pointer> & msk,
+ 
+ // image space tile bounding boxes (for feathering):
+ const std::vector<typename image_pointer_t::ObjectType::PointType> & bbox_min,
+ const std::vector<typename image_pointer_t::ObjectType::PointType> & bbox_max,
+ 
+ // mosaic space tile bounding boxes:
+ const std::vector<typename image_pointer_t::ObjectType::PointType> & min,
+ const std::vector<typename image_pointer_t::ObjectType::PointType> & max,
+ 
+ // overlap region feathering method:
+ const feathering_t feathering,
+ 
+ // default mosaic pixel value:
+ const double background)
+{
+  WRAP(itk_terminator_t terminator("assemble_mosaic_block"));
+  
+  typedef typename image_pointer_t::ObjectType::Pointer::ObjectType image_t;
+  typedef typename image_t::IndexType index_t;
+  typedef typename image_t::PointType point_t;
+  typedef typename image_t::PixelType pixel_t;
+  typedef typename itk::ImageRegionIteratorWithIndex<image_t> itex_t;
+  
+  // mosaic space bounding box of the block, padded by a pixel:
+  const typename image_t::SizeType & block_size = block.GetSize();
+  const typename image_t::SpacingType & sp = mosaic->GetSpacing();
+  const double pad = std::max(fabs(sp[0]), fabs(sp[1]));
+  
+  point_t block_min;
+  point_t block_max;
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    index_t corner = block.GetIndex();
+    corner[0] += (i & 1) ? block_size[0] - 1 : 0;
+    corner[1] += (i & 2) ? block_size[1] - 1 : 0;
+    
+    point_t point;
+    mosaic->TransformIndexToPhysicalPoint(corner, point);
+    for (unsigned int j = 0; j < 2; j++)
+    {
+      block_min[j] = (i == 0) ? point[j] : std::min(block_min[j], point[j]);
+      block_max[j] = (i == 0) ? point[j] : std::max(block_max[j], point[j]);
+    }
+  }
+  
+  // the tiles that may contribute to this block:
+  std::vector<unsigned int> tiles;
+  tile_index.find(block_min[0] - pad,
+                  block_min[1] - pad,
+                  block_max[0] + pad,
+                  block_max[1] + pad,
+                  tiles);
+  const std::size_t num_tiles = tiles.size();
+  
+  // this is needed in order to prevent holes in the mask mosaic:
+  const bool integer_pixel = std::numeric_limits<pixel_t>::is_integer;
+  const double pixel_max = static_cast<double>(std::numeric_limits<pixel_t>::max());
+  const double pixel_min = integer_pixel ?
+  static_cast<double>(std::numeric_limits<pixel_t>::min()) : -pixel_max;
+  
+  itex_t itex(mosaic, block);
+  for (itex.GoToBegin(); !itex.IsAtEnd(); ++itex)
+  {
+    // make sure there hasn't been an interrupt:
+    WRAP(terminator.terminate_on_request());
+    
+    point_t point;
+    mosaic->TransformIndexToPhysicalPoint(itex.GetIndex(), point);
+    
+    double pixel = 0.0;
+    double weight = 0.0;
+    unsigned int num_pixels = 0;
+    for (std::size_t j = 0; j < num_tiles; j++)
+    {
+      const unsigned int k = tiles[j];
+      
+      // avoid undesirable distortion artifacts:
+      if (!inside_bbox(min[k], max[k], point)) continue;
+      
+      const transform_pointer_t & t = transform[k];
+      point_t pt_k = t->TransformPoint(point);
+      
+      // make sure the pixel maps into the image:
+      if (!img[k]->IsInsideBuffer(pt_k)) continue;
+      
+      // make sure the pixel maps into the image mask:
+      double alpha = 1.0;
+      if ((msk[k].GetPointer() != NULL) &&
+          (alpha = msk[k]->Evaluate(pt_k)) < 1.0) continue;
+      
+      // feather out the edges by giving them a tiny weight:
+      num_pixels++;
+      double wp = tint[k];
+      double p = img[k]->Evaluate(pt_k) * wp;
+      double wa = ((alpha == 1.0) ? 1e-0 : 1e-6) * wp;
+      
+      if (feathering == FEATHER_NONE_E)
+      {
+        pixel += p * wa;
+        weight += wa;
+      }
+      else
+      {
+        double pixel_weight =
+        calc_pixel_weight(bbox_min[k], bbox_max[k], pt_k);
+        
+        if (feathering == FEATHER_BLEND_E)
+        {
+          pixel += pixel_weight * p * wa;
+          weight += pixel_weight * wa;
+        }
+        else // FEATHER_BINARY_E
+        {
+          if (pixel_weight > weight)
+          {
+            pixel = pixel_weight * p * wa;
+            weight = pixel_weight * wa;
+          }
+        }
+      }
+    }
+    
+    // calculate the final pixel value:
+    if (weight > 0.0)
+    {
+      pixel /= weight;
+      if (integer_pixel)
+      {
+        pixel = floor(pixel + 0.5);
+        
+        // make sure we don't exceed the intensity range:
+        pixel = std::max(pixel_min, std::min(pixel_max, pixel));
+      }
+      
+      pixel_t tmp = pixel_t(pixel);
+      itex.Set(tmp);
+    }
+    else
+    {
+      itex.Set(num_pixels > 0 ? 0 : pixel_t(background));
+    }
+    
+    if (mosaic_mask)
+    {
+      mask_t::PixelType mask_pixel = (weight > 0.0) ? 1 : 0;
+      mosaic_mask->SetPixel(itex.GetIndex(), mask_pixel);
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// setup_mosaic_tile_index
+// 
+// Index the mosaic space bounding boxes of the tiles that are
+// used for the mosaic, omitted and missing tiles are left out.
+// 
+template <class image_pointer_t, class point_t>
+void
+setup_mosaic_tile_index(mosaic_tile_index_t & tile_index,
+                        const unsigned int num_images,
+                        const std::vector<bool> & omit,
+                        const std::vector<image_pointer_t> & image,
+                        const std::vector<point_t> & min,
+                        const std::vector<point_t> & max)
+{
+  std::vector<bool> skip(num_images);
+  for (unsigned int k = 0; k < num_images; k++)
+  {
+    // don't try to add missing or omitted images to the mosaic:
+    skip[k] = omit[k] || (image[k].GetPointer() == NULL);
+  }
+  
+  std::vector<point_t> used_min(min.begin(), min.begin() + num_images);
+  std::vector<point_t> used_max(max.begin(), max.begin() + num_images);
+  tile_index.setup<point_t>(used_min, used_max, skip);
+}
+
 //----------------------------------------------------------------
 // make_mosaic_st
 // 
@@ -2511,10 +2767,8 @@ make_mosaic_st
   typedef typename image_pointer_t::ObjectType::Pointer::ObjectType image_t;
   //typedef typename image_t::IndexType index_t;
   typedef typename image_t::PointType point_t;
-  typedef typename image_t::PixelType pixel_t;
   //typedef typename image_t::SpacingType spacing_t;
   //typedef typename image_t::RegionType::SizeType imagesz_t;
-  typedef typename itk::ImageRegionIteratorWithIndex<image_t> itex_t;
   
   // setup the image interpolators:
   typedef typename itk::LinearInterpolateImageFunction
@@ -2587,100 +2841,38 @@ make_mosaic_st
     mosaic_mask->Allocate();
   }
   
-  // this is needed in order to prevent holes in the mask mosaic:
-  bool integer_pixel = std::numeric_limits<pixel_t>::is_integer;
-  double pixel_max = static_cast<double>(std::numeric_limits<pixel_t>::max());
-  double pixel_min = integer_pixel ?
-  static_cast<double>(std::numeric_limits<pixel_t>::min()) : -pixel_max;
+  // index the tiles, so that each block only visits the tiles
+  // that overlap it:
+  mosaic_tile_index_t tile_index;
+  setup_mosaic_tile_index<image_pointer_t, point_t>(tile_index,
+                                                    num_images,
+                                                    omit,
+                                                    image,
+                                                    min,
+                                                    max);
   
-  itex_t itex(mosaic, mosaic->GetLargestPossibleRegion());
-  for (itex.GoToBegin(); !itex.IsAtEnd(); ++itex)
+  typename image_t::RegionType region = mosaic->GetLargestPossibleRegion();
+  const unsigned int num_blocks = calc_num_mosaic_blocks(region);
+  for (unsigned int i = 0; i < num_blocks; i++)
   {
     // make sure there hasn't been an interrupt:
     WRAP(terminator.terminate_on_request());
     
-    point_t point;
-    mosaic->TransformIndexToPhysicalPoint(itex.GetIndex(), point);
-    
-    double pixel = 0.0;
-    double weight = 0.0;
-    unsigned int num_pixels = 0;
-    for (unsigned int k = 0; k < num_images; k++)
-    {
-      // don't try to add missing or omitted images to the mosaic:
-      if (omit[k] || (image[k].GetPointer() == NULL)) continue;
-      
-      // avoid undesirable distortion artifacts:
-      if (!inside_bbox(min[k], max[k], point)) continue;
-      
-      const transform_pointer_t & t = transform[k];
-      point_t pt_k = t->TransformPoint(point);
-      
-      // make sure the pixel maps into the image:
-      if (!img[k]->IsInsideBuffer(pt_k)) continue;
-      
-      // make sure the pixel maps into the image mask:
-      double alpha = 1.0;
-      if ((msk[k].GetPointer() != NULL) &&
-          (alpha = msk[k]->Evaluate(pt_k)) < 1.0) continue;
-      
-      // feather out the edges by giving them a tiny weight:
-      num_pixels++;
-      double wp = tint[k];
-      double p = img[k]->Evaluate(pt_k) * wp;
-      double wa = ((alpha == 1.0) ? 1e-0 : 1e-6) * wp;
-      
-      if (feathering == FEATHER_NONE_E)
-      {
-        pixel += p * wa;
-        weight += wa;
-      }
-      else
-      {
-        double pixel_weight =
-        calc_pixel_weight(bbox_min[k], bbox_max[k], pt_k);
-        
-        if (feathering == FEATHER_BLEND_E)
-        {
-          pixel += pixel_weight * p * wa;
-          weight += pixel_weight * wa;
-        }
-        else // FEATHER_BINARY_E
-        {
-          if (pixel_weight > weight)
-          {
-            pixel = pixel_weight * p * wa;
-            weight = pixel_weight * wa;
-          }
-        }
-      }
-    }
-    
-    // calculate the final pixel value:
-    if (weight > 0.0)
-    {
-      pixel /= weight;
-      if (integer_pixel)
-      {
-        pixel = floor(pixel + 0.5);
-        
-        // make sure we don't exceed the intensity range:
-        pixel = std::max(pixel_min, std::min(pixel_max, pixel));
-      }
-      
-      pixel_t tmp = pixel_t(pixel);
-      itex.Set(tmp);
-    }
-    else
-    {
-      itex.Set(num_pixels > 0 ? 0 : pixel_t(background));
-    }
-    
-    if (mosaic_mask.GetPointer())
-    {
-      mask_t::PixelType mask_pixel = (weight > 0.0) ? 1 : 0;
-      mosaic_mask->SetPixel(itex.GetIndex(), mask_pixel);
-    }
+    assemble_mosaic_block<image_pointer_t, transform_pointer_t>
+    (mosaic,
+     mosaic_mask.GetPointer(),
+     get_mosaic_block(region, i),
+     tile_index,
+     tint,
+     transform,
+     img,
+     msk,
+     bbox_min,
+     bbox_max,
+     min,
+     max,
+     feathering,
+     background);
   }
   
   return mosaic;
@@ -2697,16 +2889,14 @@ class assemble_mosaic_t : public the_transaction_t
 {
 public:
   typedef typename image_pointer_t::ObjectType::Pointer::ObjectType tile_t;
-  typedef typename image_t::PointType pnt_t;
-  typedef typename image_t::PixelType pxl_t;
-  typedef typename image_t::RegionType rn_t;
-  typedef typename image_t::RegionType::SizeType sz_t;
-  typedef typename image_t::RegionType::IndexType ix_t;
+  typedef typename tile_t::PointType pnt_t;
+  typedef typename tile_t::RegionType rn_t;
   typedef typename itk::LinearInterpolateImageFunction<tile_t, double> itile_t;
   typedef itk::NearestNeighborInterpolateImageFunction<mask_t, double> imask_t;
   
-  assemble_mosaic_t(// thread index and number of threads, used to avoid
-                    // concurrent access to the same point in the mosaic:
+  assemble_mosaic_t(// thread index and number of threads, each thread
+                    // assembles every thread_stride-th block of the mosaic
+                    // starting with block thread_offset:
                     unsigned int thread_offset,
                     unsigned int thread_stride,
                     
@@ -2714,12 +2904,9 @@ public:
                     typename tile_t::Pointer & mosaic,
                     mask_t * mosaic_mask,
                     
-                    // number of tiles to use for this mosaic (may be fewer
-                    // then the number of tiles available):
-                    unsigned int num_tiles,
-                    
-                    // omitted tile flags:
-                    const std::vector<bool> & omit,
+                    // mosaic space index of the tiles used for this mosaic
+                    // (omitted and missing tiles are not indexed):
+                    const mosaic_tile_index_t & tile_index,
                     
                     // tile tint:
                     const std::vector<double> & tint,
@@ -2727,10 +2914,6 @@ public:
                     // tile trasforms:
                     const std::vector<transform_pointer_t> & transform,
                     
-                    // tiles and tile masks
-                    const std::vector<image_pointer_t> & tile,
-                    const std::vector<mask_t::ConstPointer> & mask,
-                    
                     // tile and tile mask interpolators:
                     const std::vector<typename itile_t::Pointer> & itile,
                     const std::vector<typename imask_t::Pointer> & imask,
@@ -2753,12 +2936,9 @@ public:
   thread_stride_(thread_stride),
   mosaic_(mosaic),
   mosaic_mask_(mosaic_mask),
-  num_tiles_(num_tiles),
-  omit_(omit),
+  tile_index_(tile_index),
   tint_(tint),
   transform_(transform),
-  tile_(tile),
-  mask_(mask),
   itile_(itile),
   imask_(imask),
   bbox_min_(bbox_min),
@@ -2773,126 +2953,30 @@ public:
   {
     WRAP(itk_terminator_t terminator("assemble_mosaic_t::execute"));
     
-    // this is needed in order to prevent holes in the mask mosaic:
-    const bool integer_pixel = std::numeric_limits<pxl_t>::is_integer;
-    const double pixel_max = static_cast<double>(std::numeric_limits<pxl_t>::max());
-    const double pixel_min = integer_pixel ?
-    static_cast<double>(std::numeric_limits<pxl_t>::min()) : -pixel_max;
-    
+    // the blocks are interleaved between the threads, so that
+    // sparse areas of the mosaic are shared evenly:
     rn_t region = mosaic_->GetLargestPossibleRegion();
-    ix_t origin = region.GetIndex();
-    sz_t extent = region.GetSize();
-    ix_t::IndexValueType x_end = origin[0] + extent[0];
-    ix_t::IndexValueType y_end = origin[1] + extent[1];
-    
-    ix_t ix = origin;
-    for (ix[1] = origin[1]; ix[1] < y_end; ++ix[1])
+    const unsigned int num_blocks = calc_num_mosaic_blocks(region);
+    for (unsigned int i = thread_offset_; i < num_blocks; i += thread_stride_)
     {
-      for (ix[0] = origin[0] + thread_offset_;
-           ix[0] < x_end;
-           ix[0] += thread_stride_)
-      {
-        // check whether termination was requested:
-        WRAP(terminator.terminate_on_request());
-        
-        pnt_t point;
-        mosaic_->TransformIndexToPhysicalPoint(ix, point);
-        
-        double pixel = 0.0;
-        double weight = 0.0;
-        unsigned int num_pixels = 0;
-        
-        for (unsigned int k = 0; k < num_tiles_; k++)
-        {
-          // don't try to add missing or omitted images to the mosaic:
-          if (omit_[k] || (tile_[k].GetPointer() == NULL))
-          {
-            continue;
-          }
-          
-          // avoid undesirable distortion artifacts:
-          if (!inside_bbox(min_[k], max_[k], point))
-          {
-            continue;
-          }
-          
-          const transform_pointer_t & t = transform_[k];
-          pnt_t pt_k = t->TransformPoint(point);
-          
-          // make sure the pixel maps into the image:
-          if (!itile_[k]->IsInsideBuffer(pt_k))
-          {
-            continue;
-          }
-          
-          // make sure the pixel maps into the image mask:
-          double alpha = 1.0;
-          if ((imask_[k].GetPointer() != NULL) &&
-              (alpha = imask_[k]->Evaluate(pt_k)) < 1.0)
-          {
-            continue;
-          }
-          
-          // feather out the edges by giving them a tiny weight:
-          num_pixels++;
-          double wp = tint_[k];
-          double p = itile_[k]->Evaluate(pt_k) * wp;
-          double wa = ((alpha == 1.0) ? 1e-0 : 1e-6) * wp;
-          
-          if (feathering_ == FEATHER_NONE_E)
-          {
-            pixel += p * wa;
-            weight += wa;
-          }
-          else
-          {
-            double pixel_weight = calc_pixel_weight(bbox_min_[k],
-                                                    bbox_max_[k],
-                                                    pt_k);
-            
-            if (feathering_ == FEATHER_BLEND_E)
-            {
-              pixel += pixel_weight * p * wa;
-              weight += pixel_weight * wa;
-            }
-            else // FEATHER_BINARY_E
-            {
-              if (pixel_weight > weight)
-              {
-                pixel = pixel_weight * p * wa;
-                weight = pixel_weight * wa;
-              }
-            }
-          }
-        }
-        
-        // calculate the final pixel value:
-        if (weight > 0.0)
-        {
-          pixel /= weight;
-          if (integer_pixel)
-          {
-            pixel = floor(pixel + 0.5);
-            
-            // make sure we don't exceed the intensity range:
-            pixel = std::max(pixel_min, std::min(pixel_max, pixel));
-          }
-          
-          pxl_t output = pxl_t(pixel);
-          mosaic_->SetPixel(ix, output);
-        }
-        else
-        {
-          pxl_t output = num_pixels > 0 ? 0 : pxl_t(background_);
-          mosaic_->SetPixel(ix, output);
-        }
-        
-        if (mosaic_mask_)
-        {
-          mask_t::PixelType mask_pixel = (weight > 0.0) ? 1 : 0;
-          mosaic_mask_->SetPixel(ix, mask_pixel);
-        }
-      }
+      // check whether termination was requested:
+      WRAP(terminator.terminate_on_request());
+      
+      assemble_mosaic_block<image_pointer_t, transform_pointer_t>
+      (mosaic_.GetPointer(),
+       mosaic_mask_,
+       get_mosaic_block(region, i),
+       tile_index_,
+       tint_,
+       transform_,
+       itile_,
+       imask_,
+       bbox_min_,
+       bbox_max_,
+       min_,
+       max_,
+       feathering_,
+       background_);
     }
   }
   
@@ -2904,12 +2988,8 @@ public:
   typename tile_t::Pointer & mosaic_;
   mask_t * mosaic_mask_;
   
-  // number of tiles used for this mosaic (may be fewer than
-  // what's available from the tile vector):
-  unsigned int num_tiles_;
-  
-  // omitted tile flags:
-  const std::vector<bool> & omit_;
+  // mosaic space index of the tiles used for this mosaic:
+  const mosaic_tile_index_t & tile_index_;
   
   // tile tint:
   const std::vector<double> & tint_;
@@ -2917,11 +2997,6 @@ public:
   // tile trasforms:
   const std::vector<transform_pointer_t> & transform_;
   
-  // tiles and tile masks
-  const std::vector<image_pointer_t> & tile_;
-  const std::vector<mask_t::ConstPointer> & mask_;
-  
-  
   // tile and tile mask interpolators:
   const std::vector<typename itile_t::Pointer> & itile_;
   const std::vector<typename imask_t::Pointer> & imask_;
@@ -3069,6 +3144,16 @@ make_mosaic_mt
     mosaic_mask->Allocate();
   }
   
+  // index the tiles, so that each block only visits the tiles
+  // that overlap it:
+  mosaic_tile_index_t tile_index;
+  setup_mosaic_tile_index<image_pointer_t, pnt_t>(tile_index,
+                                                  num_images,
+                                                  omit,
+                                                  image,
+                                                  min,
+                                                  max);
+  
   // setup transactions for multi-threaded mosaic assembly:
   std::list<the_transaction_t *> schedule;
   for (unsigned int i = 0; i < num_threads; i++)
@@ -3079,12 +3164,9 @@ make_mosaic_mt
      num_threads,
      mosaic,
      mosaic_mask.GetPointer(),
-     num_images,
-     omit,
+     tile_index,
      tint,
      transform,
-     image,
-     image_mask,
      img,
      msk,
      bbox_min,
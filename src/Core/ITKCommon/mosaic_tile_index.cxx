@@ -0,0 +1,260 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// File         : mosaic_tile_index.cxx
+// Created      : 2016/11/02 14:20
+// Copyright    : (C) 2016 University of Utah
+// Description  : Uniform grid index over the mosaic space bounding
+//                boxes of the mosaic tiles.
+
+// system includes:
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// local includes:
+#include <Core/ITKCommon/mosaic_tile_index.hxx>
+
+
+//----------------------------------------------------------------
+// mosaic_tile_index_t::mosaic_tile_index_t
+// 
+mosaic_tile_index_t::mosaic_tile_index_t():
+  nx_(0),
+  ny_(0),
+  num_indexed_(0)
+{
+  origin_[0] = 0.0;
+  origin_[1] = 0.0;
+  cell_size_[0] = 1.0;
+  cell_size_[1] = 1.0;
+}
+
+//----------------------------------------------------------------
+// mosaic_tile_index_t::setup
+// 
+void
+mosaic_tile_index_t::setup(const std::vector<double> & bbox,
+                           const std::vector<bool> & skip)
+{
+  bbox_ = bbox;
+  cell_start_.clear();
+  cell_tiles_.clear();
+  nx_ = 0;
+  ny_ = 0;
+  num_indexed_ = 0;
+  
+  // find the tiles worth indexing and the area they cover, a bounding
+  // box that is empty or not finite never contains a mosaic point:
+  const std::size_t num_tiles = bbox_.size() / 4;
+  std::vector<unsigned int> indexed;
+  double min_x = 0.0;
+  double min_y = 0.0;
+  double max_x = 0.0;
+  double max_y = 0.0;
+  double sum_w = 0.0;
+  double sum_h = 0.0;
+  const double max_value = std::numeric_limits<double>::max();
+  
+  for (std::size_t i = 0; i < num_tiles; i++)
+  {
+    if (i < skip.size() && skip[i]) continue;
+    
+    const double * b = &bbox_[4 * i];
+    if (!(b[0] <= b[2] && b[1] <= b[3])) continue;
+    if (!(std::fabs(b[0]) <= max_value && std::fabs(b[1]) <= max_value &&
+          std::fabs(b[2]) <= max_value && std::fabs(b[3]) <= max_value))
+    {
+      continue;
+    }
+    
+    if (indexed.empty())
+    {
+      min_x = b[0];
+      min_y = b[1];
+      max_x = b[2];
+      max_y = b[3];
+    }
+    else
+    {
+      min_x = std::min(min_x, b[0]);
+      min_y = std::min(min_y, b[1]);
+      max_x = std::max(max_x, b[2]);
+      max_y = std::max(max_y, b[3]);
+    }
+    
+    sum_w += b[2] - b[0];
+    sum_h += b[3] - b[1];
+    indexed.push_back(static_cast<unsigned int>(i));
+  }
+  
+  num_indexed_ = indexed.size();
+  if (indexed.empty()) return;
+  
+  // cells roughly the size of an average tile, so that each tile
+  // lands in a few cells only; the grid size is limited in case
+  // of a few very small tiles spread over a large area:
+  const double num = static_cast<double>(num_indexed_);
+  const double w = max_x - min_x;
+  const double h = max_y - min_y;
+  double cell_w = sum_w / num;
+  double cell_h = sum_h / num;
+  
+  const double max_cells = 4.0 * num + 1.0;
+  double cells_x = (cell_w > 0.0) ? std::ceil(w / cell_w) : 1.0;
+  double cells_y = (cell_h > 0.0) ? std::ceil(h / cell_h) : 1.0;
+  cells_x = std::max(1.0, cells_x);
+  cells_y = std::max(1.0, cells_y);
+  if (cells_x * cells_y > max_cells)
+  {
+    double s = std::sqrt(cells_x * cells_y / max_cells);
+    cells_x = std::max(1.0, std::floor(cells_x / s));
+    cells_y = std::max(1.0, std::floor(cells_y / s));
+  }
+  
+  nx_ = static_cast<std::size_t>(cells_x);
+  ny_ = static_cast<std::size_t>(cells_y);
+  origin_[0] = min_x;
+  origin_[1] = min_y;
+  cell_size_[0] = (w > 0.0) ? w / cells_x : 1.0;
+  cell_size_[1] = (h > 0.0) ? h / cells_y : 1.0;
+  
+  // count the tiles of every cell, then fill in the tile ids:
+  cell_start_.assign(nx_ * ny_ + 1, 0);
+  for (std::size_t j = 0; j < indexed.size(); j++)
+  {
+    const double * b = &bbox_[4 * indexed[j]];
+    std::size_t x0, y0, x1, y1;
+    cell_range(b[0], b[1], b[2], b[3], x0, y0, x1, y1);
+    
+    for (std::size_t y = y0; y <= y1; y++)
+    {
+      for (std::size_t x = x0; x <= x1; x++)
+      {
+        cell_start_[y * nx_ + x + 1]++;
+      }
+    }
+  }
+  
+  for (std::size_t c = 0; c < nx_ * ny_; c++)
+  {
+    cell_start_[c + 1] += cell_start_[c];
+  }
+  
+  cell_tiles_.resize(cell_start_[nx_ * ny_]);
+  std::vector<std::size_t> cell_next(cell_start_.begin(), cell_start_.end() - 1);
+  for (std::size_t j = 0; j < indexed.size(); j++)
+  {
+    const double * b = &bbox_[4 * indexed[j]];
+    std::size_t x0, y0, x1, y1;
+    cell_range(b[0], b[1], b[2], b[3], x0, y0, x1, y1);
+    
+    for (std::size_t y = y0; y <= y1; y++)
+    {
+      for (std::size_t x = x0; x <= x1; x++)
+      {
+        cell_tiles_[cell_next[y * nx_ + x]++] = indexed[j];
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------
+// mosaic_tile_index_t::find
+// 
+void
+mosaic_tile_index_t::find(const double & min_x,
+                          const double & min_y,
+                          const double & max_x,
+                          const double & max_y,
+                          std::vector<unsigned int> & tiles) const
+{
+  tiles.clear();
+  if (num_indexed_ == 0) return;
+  
+  // regions outside the grid do not overlap any tile:
+  if (max_x < origin_[0] || max_y < origin_[1] ||
+      min_x > origin_[0] + cell_size_[0] * nx_ ||
+      min_y > origin_[1] + cell_size_[1] * ny_)
+  {
+    return;
+  }
+  
+  std::size_t x0, y0, x1, y1;
+  cell_range(min_x, min_y, max_x, max_y, x0, y0, x1, y1);
+  
+  for (std::size_t y = y0; y <= y1; y++)
+  {
+    for (std::size_t x = x0; x <= x1; x++)
+    {
+      const std::size_t c = y * nx_ + x;
+      for (std::size_t j = cell_start_[c]; j < cell_start_[c + 1]; j++)
+      {
+        const unsigned int i = cell_tiles_[j];
+        const double * b = &bbox_[4 * i];
+        if (b[0] <= max_x && min_x <= b[2] &&
+            b[1] <= max_y && min_y <= b[3])
+        {
+          tiles.push_back(i);
+        }
+      }
+    }
+  }
+  
+  // a tile that spans several cells is found once per cell:
+  std::sort(tiles.begin(), tiles.end());
+  tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+}
+
+//----------------------------------------------------------------
+// mosaic_tile_index_t::cell_range
+// 
+void
+mosaic_tile_index_t::cell_range(const double & min_x,
+                                const double & min_y,
+                                const double & max_x,
+                                const double & max_y,
+                                std::size_t & x0,
+                                std::size_t & y0,
+                                std::size_t & x1,
+                                std::size_t & y1) const
+{
+  // clamp to the grid, regions that extend past the grid are
+  // covered by the border cells:
+  double fx0 = std::floor((min_x - origin_[0]) / cell_size_[0]);
+  double fy0 = std::floor((min_y - origin_[1]) / cell_size_[1]);
+  double fx1 = std::floor((max_x - origin_[0]) / cell_size_[0]);
+  double fy1 = std::floor((max_y - origin_[1]) / cell_size_[1]);
+  
+  const double last_x = static_cast<double>(nx_ - 1);
+  const double last_y = static_cast<double>(ny_ - 1);
+  x0 = static_cast<std::size_t>(std::min(last_x, std::max(0.0, fx0)));
+  y0 = static_cast<std::size_t>(std::min(last_y, std::max(0.0, fy0)));
+  x1 = static_cast<std::size_t>(std::min(last_x, std::max(0.0, fx1)));
+  y1 = static_cast<std::size_t>(std::min(last_y, std::max(0.0, fy1)));
+}
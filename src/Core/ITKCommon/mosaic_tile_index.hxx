@@ -0,0 +1,123 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// File         : mosaic_tile_index.hxx
+// Created      : 2016/11/02 14:20
+// Copyright    : (C) 2016 University of Utah
+// Description  : Uniform grid index over the mosaic space bounding
+//                boxes of the mosaic tiles.
+
+#ifndef MOSAIC_TILE_INDEX_HXX_
+#define MOSAIC_TILE_INDEX_HXX_
+
+// system includes:
+#include <vector>
+#include <cstddef>
+
+
+//----------------------------------------------------------------
+// mosaic_tile_index_t
+// 
+// Buckets the tile bounding boxes into a uniform grid of cells,
+// roughly the size of an average tile, so that the tiles overlapping
+// a region of the mosaic can be found without looking at every tile.
+// 
+class mosaic_tile_index_t
+{
+public:
+  mosaic_tile_index_t();
+  
+  // index the mosaic space bounding boxes of the tiles, tiles
+  // that are flagged to be skipped are left out of the index:
+  template <class point_t>
+  void setup(const std::vector<point_t> & min,
+             const std::vector<point_t> & max,
+             const std::vector<bool> & skip = std::vector<bool>())
+  {
+    const std::size_t num_tiles = min.size();
+    std::vector<double> bbox(4 * num_tiles);
+    for (std::size_t i = 0; i < num_tiles; i++)
+    {
+      bbox[4 * i + 0] = min[i][0];
+      bbox[4 * i + 1] = min[i][1];
+      bbox[4 * i + 2] = max[i][0];
+      bbox[4 * i + 3] = max[i][1];
+    }
+    
+    setup(bbox, skip);
+  }
+  
+  // same as above, the bounding boxes are stored as
+  // consecutive (min x, min y, max x, max y) values:
+  void setup(const std::vector<double> & bbox,
+             const std::vector<bool> & skip = std::vector<bool>());
+  
+  // find the tiles whose bounding box overlaps a given region of
+  // the mosaic (boundaries included), the tile ids are returned in
+  // ascending order so that the tiles are always blended in the
+  // same order:
+  void find(const double & min_x,
+            const double & min_y,
+            const double & max_x,
+            const double & max_y,
+            std::vector<unsigned int> & tiles) const;
+  
+  // number of tiles stored in the index:
+  inline std::size_t size() const
+  { return num_indexed_; }
+  
+private:
+  // grid cell range covered by a given region:
+  void cell_range(const double & min_x,
+                  const double & min_y,
+                  const double & max_x,
+                  const double & max_y,
+                  std::size_t & x0,
+                  std::size_t & y0,
+                  std::size_t & x1,
+                  std::size_t & y1) const;
+  
+  // bounding boxes of all the tiles:
+  std::vector<double> bbox_;
+  
+  // the grid covers the union of the indexed bounding boxes:
+  double origin_[2];
+  double cell_size_[2];
+  std::size_t nx_;
+  std::size_t ny_;
+  
+  // tile ids of each cell, cell (x, y) owns the entries
+  // from cell_start_[y * nx_ + x] to cell_start_[y * nx_ + x + 1]:
+  std::vector<std::size_t> cell_start_;
+  std::vector<unsigned int> cell_tiles_;
+  
+  std::size_t num_indexed_;
+};
+
+
+#endif // MOSAIC_TILE_INDEX_HXX_
@@ -27,7 +27,9 @@
 */
 
 // STL includes
+#include <algorithm>
 #include <fstream>
+#include <limits>
 
 // Boost includes
 #include <boost/array.hpp>
@@ -36,8 +38,9 @@
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/Isosurface/Isosurface.h>
 #include <Core/Isosurface/IsosurfaceExporter.h>
-#include <Core/Utils/StackVector.h>
+#include <Core/Isosurface/MeshDecimation.h>
 #include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
 #include <Core/Utils/Log.h>
 #include <Core/Graphics/VertexBufferObject.h>
 #include <Core/RenderResources/RenderResources.h>
@@ -357,12 +360,12 @@ public:
 typedef boost::shared_ptr< VertexBufferBatch > VertexBufferBatchHandle;
 
 #if defined (_WIN32) || defined(__APPLE__)
-const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl)" );
+const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl);;Binary VTK (*.vtk)" );
 #else
-const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl *)" );
+const std::string Isosurface::EXPORT_FORMATS_C( "VTK (*.vtk);;OBJ (*.obj);;ASCII (*.fac *.pts *.val);;ASCII STL (*.stl);;Binary STL (*.stl *);;Binary VTK (*.vtk *)" );
 #endif
 
-// Binary STL handled as special case in LayerIOFunctions::ExportIsosurface
+// Binary STL and VTK handled as special cases in LayerIOFunctions::ExportIsosurface
     const FilterMap Isosurface::EXPORT_FORMATS_MAP_C = { { "VTK (*.vtk)", ".vtk" }, {"OBJ (*.obj)", ".obj"},
         { "ASCII (*.fac *.pts *.val)", ".fac" }, { "ASCII STL (*.stl)", ".stl" } };
 
@@ -382,13 +385,42 @@ public:
   // and before face computation.
   void compute_setup();
 
-  // SETUP:
-  // Setup the algorithm and the buffers for face computation
-  void compute_faces_setup( int num_threads );
-
-  // PARALLEL_COMPUTE_FACES:
-  // Parallelized isosurface computation algorithm 
-  void parallel_compute_faces( int thread, int num_threads, boost::barrier& barrier );
+  // COMPUTE_FACES_SETUP:
+  // Setup the algorithm and the buffers for face computation, returns false if the volume has
+  // no elements (cubes)
+  bool compute_faces_setup();
+
+  // COMPUTE_FACES:
+  // Compute the isosurface without caps, returns false if aborted or if the surface is too
+  // large to be indexed
+  bool compute_faces();
+
+  // ELEMENT_TYPE:
+  // Index into the marching cubes table of the element (cube) at index q of a slice
+  unsigned char element_type( const unsigned char* data1, const unsigned char* data2, 
+    size_t q ) const;
+
+  // ADD_EDGE_POINT:
+  // Add a point in the middle of a split edge, or only count it if generate is false
+  void add_edge_point( bool generate, float x, float y, float z, unsigned int& edge, 
+    size_t& point_index );
+
+  // COMPUTE_TILE_POINTS:
+  // Create the points on the split edges owned by the elements of a tile in slice z, starting
+  // at point_index, and count the faces of the tile. If generate is false, only count. Returns
+  // the number of points.
+  size_t compute_tile_points( size_t tile, size_t z, size_t point_index, bool generate,
+    size_t& num_faces );
+
+  // COMPUTE_TILE_FACES:
+  // Create the faces of the elements of a tile in the current slice, starting at face_index
+  void compute_tile_faces( size_t tile, size_t face_index, double& area );
+
+  // COUNT_TILES, GENERATE_SLICE_POINTS, GENERATE_SLICE_FACES:
+  // Ranges of tiles processed by one task of the thread pool
+  void count_tiles( size_t begin, size_t end );
+  void generate_slice_points( size_t begin, size_t end );
+  void generate_slice_faces( size_t begin, size_t end );
 
   void translate_cap_coords( int cap_num, float i, float j, float& x, float& y, float& z );
 
@@ -401,6 +433,14 @@ public:
   // be turned on/off independently from the rest of the isosurface.
   void compute_cap_faces();
 
+  // DECIMATE:
+  // Reduce the number of faces, returns false if aborted
+  bool decimate( size_t max_faces, double max_error );
+
+  // UPDATE_DECIMATION_PROGRESS:
+  // Report the progress of the decimation
+  void update_decimation_progress( double progress );
+
   // PARALLEL_COMPUTE_NORMALS:
   // Parallelized isosurface normal computation algorithm 
   void parallel_compute_normals( int thread, int num_threads,  boost::barrier& barrier );
@@ -444,6 +484,25 @@ public:
 
   UCharVector type_buffer_;
   std::vector< UIntVector > edge_buffer_;
+  int back_buffer_x_;
+  int back_buffer_y_;
+  int front_buffer_x_;
+  int front_buffer_y_;
+  int side_buffer_;
+  unsigned int* edge_table_[ 12 ];
+  GridTransform grid_transform_;
+
+  // Slices are split into tiles of elements, which are scheduled on the thread pool. The
+  // number of points and faces of each tile is counted first, so each tile can write its
+  // results straight into the output.
+  size_t tile_nx_, tile_ny_; // Number of tiles per slice
+  UIntVector tile_point_counts_; // Points per tile, for all slices
+  UIntVector tile_face_counts_; // Faces per tile, for all slices
+  size_t slice_z_;
+  IVector slice_tiles_; // Tiles of the current slice with points or faces
+  IVector slice_point_offsets_;
+  IVector slice_face_offsets_;
+  std::vector< double > slice_tile_areas_;
 
   UIntVector min_point_index_;
   UIntVector max_point_index_;
@@ -454,34 +513,31 @@ public:
   std::vector< std::pair< unsigned int, unsigned int > > part_faces_;
   std::vector< UIntVector > part_indices_;
 
-  std::vector< PointFVector > new_points_; 
-  std::vector< std::vector< StackVector< size_t, 3 > > > new_elems_;
-  FloatVector new_elem_areas_;
-
-  IVector front_offset_;
-  IVector back_offset_;
-  size_t global_point_cnt_;
-
-  unsigned int prev_point_min_;
-  unsigned int prev_point_max_;
-
   std::vector< VertexBufferBatchHandle > vbo_batches_;
   bool vbo_available_;
   bool surface_changed_;
   bool values_changed_;
 
-  bool need_abort_;
   boost::function< bool () > check_abort_;
 
   const static double COMPUTE_PERCENT_PROGRESS_C;
   const static double NORMAL_PERCENT_PROGRESS_C;
   const static double PARTITION_PERCENT_PROGRESS_C;
+
+  const static size_t TILE_SIZE_X_C;
+  const static size_t TILE_SIZE_Y_C;
+  const static size_t COUNT_GRAIN_C;
 };
 
 // Initialize static variables
 const double IsosurfacePrivate::COMPUTE_PERCENT_PROGRESS_C = 0.8;
 const double IsosurfacePrivate::NORMAL_PERCENT_PROGRESS_C = 0.05;
 const double IsosurfacePrivate::PARTITION_PERCENT_PROGRESS_C = 0.15; 
+// Number of elements (cubes) in a tile along x and y
+const size_t IsosurfacePrivate::TILE_SIZE_X_C = 128;
+const size_t IsosurfacePrivate::TILE_SIZE_Y_C = 32;
+// Number of tiles counted by one task
+const size_t IsosurfacePrivate::COUNT_GRAIN_C = 16;
 
 void IsosurfacePrivate::downsample_setup( int num_threads, double quality_factor )
 {
@@ -632,15 +688,21 @@ void IsosurfacePrivate::compute_setup()
   this->mask_value_ = this->compute_mask_volume_->get_mask_data_block()->get_mask_value();
 }
 
-void IsosurfacePrivate::compute_faces_setup( int num_threads )
+bool IsosurfacePrivate::compute_faces_setup()
 {
   // Number of elements (cubes) in each dimension
-  this->elem_nx_ = this->nx_ - 1;
-  this->elem_ny_ = this->ny_ - 1;
-  this->elem_nz_ = this->nz_ - 1;
+  this->elem_nx_ = this->nx_ > 0 ? this->nx_ - 1 : 0;
+  this->elem_ny_ = this->ny_ > 0 ? this->ny_ - 1 : 0;
+  this->elem_nz_ = this->nz_ > 0 ? this->nz_ - 1 : 0;
+
+  this->min_point_index_.assign( this->elem_nz_, 0 );
+  this->max_point_index_.assign( this->elem_nz_, 0 );
+  this->min_face_index_.assign( this->elem_nz_, 0 );
+  this->max_face_index_.assign( this->elem_nz_, 0 );
 
-  // Stores index into polygon configuration table for each element (cube)?
-  // Why +1?  Maybe just padding for safety?
+  if ( this->elem_nx_ == 0 || this->elem_ny_ == 0 || this->elem_nz_ == 0 ) return false;
+
+  // Stores index into polygon configuration table for each element (cube) of a slice
   this->type_buffer_.resize( ( this->nx_ + 1 ) * ( this->ny_ + 1 ) );
   // For each element (cube), holds edge ID (12 edges) back_buffer_x, back_buffer_y, 
   // front_buffer_x, front_buffer_y, and side_buffer 
@@ -649,31 +711,52 @@ void IsosurfacePrivate::compute_faces_setup( int num_threads )
   {
     this->edge_buffer_[ q ].resize( ( this->nx_ + 1 ) * ( this->ny_ + 1 ) );
   }
+  this->back_buffer_x_ = 0;
+  this->back_buffer_y_ = 1;
+  this->front_buffer_x_ = 2;
+  this->front_buffer_y_ = 3;
+  this->side_buffer_ = 4;
+
+  this->tile_nx_ = ( this->elem_nx_ + TILE_SIZE_X_C - 1 ) / TILE_SIZE_X_C;
+  this->tile_ny_ = ( this->elem_ny_ + TILE_SIZE_Y_C - 1 ) / TILE_SIZE_Y_C;
+  size_t num_tiles = this->tile_nx_ * this->tile_ny_ * this->elem_nz_;
+  this->tile_point_counts_.assign( num_tiles, 0 );
+  this->tile_face_counts_.assign( num_tiles, 0 );
 
-  // Interpolated edge points for isosurface per thread
-  this->new_points_.resize( num_threads );
-
-  // Vector of face indices per triangle, per thread
-  this->new_elems_.resize( num_threads );
-  // Surface areas of generated triangles per thread
-  this->new_elem_areas_.resize( num_threads, 0 );
-  // Offset allows zero-based indexing over multiple slices
-  this->front_offset_.resize( num_threads, 0 );
-  this->back_offset_.resize( num_threads, 0 ); 
-
-  // Total number of isosurface points
-  this->global_point_cnt_ = 0;
+  // Get mask transform from MaskVolume 
+  this->grid_transform_ = this->compute_mask_volume_->get_grid_transform();
 
-  this->min_point_index_.resize( this->elem_nz_ );
-  this->max_point_index_.resize( this->elem_nz_ );
-  this->min_face_index_.resize( this->elem_nz_ );
-  this->max_face_index_.resize( this->elem_nz_ );
+  return true;
+}
 
-  this->prev_point_min_ = 0;
-  this->prev_point_max_ = 0;
-  
-  this->need_abort_ = false;
+unsigned char IsosurfacePrivate::element_type( const unsigned char* data1, 
+  const unsigned char* data2, size_t q ) const
+{
+  // An 8 bit index is formed where each bit corresponds to a vertex 
+  // Bit on if vertex is inside surface, off otherwise
+  unsigned char type = 0;
+  if ( data1[ q ] & this->mask_value_ )         type |= 0x1;
+  if ( data1[ q + 1 ] & this->mask_value_ )       type |= 0x2;
+  if ( data1[ q + this->nx_ + 1 ] & this->mask_value_ ) type |= 0x4;
+  if ( data1[ q + this->nx_ ] & this->mask_value_ )   type |= 0x8;
+
+  if ( data2[ q ] & this->mask_value_ )         type |= 0x10;
+  if ( data2[ q + 1 ] & this->mask_value_ )       type |= 0x20;
+  if ( data2[ q + this->nx_ + 1 ] & this->mask_value_ ) type |= 0x40;
+  if ( data2[ q + this->nx_ ] & this->mask_value_ )   type |= 0x80;
+  return type;
+}
 
+void IsosurfacePrivate::add_edge_point( bool generate, float x, float y, float z, 
+  unsigned int& edge, size_t& point_index )
+{
+  if ( generate )
+  {
+    // Transform point by mask transform
+    this->points_[ point_index ] = this->grid_transform_.project( PointF( x, y, z ) );
+    edge = static_cast< unsigned int >( point_index );
+  }
+  point_index++;
 }
 
 /*
@@ -691,484 +774,327 @@ Basic ideas:
 - These are tables of split edges with indices into a points vector of actual points.
 - Number points as you encounter split edges.
 - After edge tables are built, go back to type list, use configurations to lookup into the tables.
-- Tables are built in parallel using relative indices per thread.
-- Parallel point lists are merged together at the end.
+- Each slice is split into tiles of elements. All tiles of all slices are first counted in 
+  parallel, which gives every tile a fixed range of point and face indices. Tiles of a slice
+  are then processed in parallel and write their points and faces directly into the output.
+  Tiles without any points or faces are skipped.
 - At end, swap front and back data (front is now back).
 - One advantage of this approach is that we don't need complex and confusing linked lists; we can
   use tables that directly correspond to elements.
 - Point of confusion: sometimes "element" is synonymous with "cube" and sometimes it refers
   to a triangle.
 */
-void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads, 
-  boost::barrier& barrier )
+size_t IsosurfacePrivate::compute_tile_points( size_t tile, size_t z, size_t point_index,
+  bool generate, size_t& num_faces )
 {
-  // Setup the algorithm and the buffers
-  if ( thread == 0 ) // Only need to setup once 
-  {
-    this->compute_faces_setup( num_threads ); 
-  }
-
-  // An object of class barrier is a synchronization primitive used to cause a set of threads 
-  // to wait until they each perform a certain function or each reach a particular point in their 
-  // execution.  This mechanism proves useful in situations where processing progresses in 
-  // stages and completion of the current stage by all threads is the entry criteria for the next 
-  // stage.
-  barrier.wait();
-
-  // In order to parallelize the algorithm, each thread processes a different horizontal strip
-  // of data
-  // Determine the element (cube) range for each thread in the y dimension
-  size_t ysize = static_cast< size_t >( this->ny_ / num_threads );
-  if ( ysize * num_threads < this->ny_ ) 
-  {
-    ysize++;
-  }
-
-  size_t nystart = thread * ysize;
-  size_t nyend = ( thread + 1 ) * ysize;
-  if ( nyend > this->ny_ ) 
-  {
-    nyend = this->ny_;
-  }
-
-  size_t elem_ysize = static_cast< size_t >( this->elem_ny_ / num_threads );
-  if ( elem_ysize * num_threads < this->elem_ny_ ) 
-  {
-    elem_ysize++;
-  }
-
-  size_t elem_nystart = thread * elem_ysize;
-  size_t elem_nyend = ( thread + 1 ) * elem_ysize;
-  if ( elem_nyend > this->elem_ny_ ) 
-  {
-    elem_nyend = this->elem_ny_;
-  }
-
-  // Each thread generates new points for the isosurface
-  PointFVector& points = this->new_points_[ thread ];
-  // StackVector is a SCIRun class.  
-  // StackVector implements a subclass of the std::vector class, except that
-  // the vector is statically allocated on the stack for performance.
-  // elems = triangles
-  std::vector< StackVector < size_t, 3 > >& elements = this->new_elems_[ thread ];
-
-  // mark the point counter with the process number
-  unsigned int point_cnt = 0;
-
-  // Vector of pointers into edge_buffer_ for each of the 12 edges.  edge_buffer_ has indices into
-  // vector of actual points.
-  std::vector< unsigned int* > edge_table( 12 );
-
-  barrier.wait();
-
-  // See function description
-  int back_buffer_x = 0;
-  int back_buffer_y = 1;
-  int front_buffer_x = 2;
-  int front_buffer_y = 3;
-  int side_buffer = 4;
-
-  StackVector< size_t, 3 > elems( 3 );    
-
-  // Get mask transform from MaskVolume 
-  GridTransform grid_transform = this->compute_mask_volume_->get_grid_transform();
-
-  // Loop over all the slices
-  for ( size_t z = 0;  z < this->elem_nz_; z++ ) 
+  // Process two adjacent slices at a time (back and front)
+  // Get pointer to beginning of each slice in the data
+  const unsigned char* data1 = this->data_ + z * ( this->nx_ * this->ny_ );
+  const unsigned char* data2 = data1 + this->nx_ * this->ny_;
+
+  size_t x_start = ( tile % this->tile_nx_ ) * TILE_SIZE_X_C;
+  size_t x_end = std::min( x_start + TILE_SIZE_X_C, this->elem_nx_ );
+  size_t y_start = ( tile / this->tile_nx_ ) * TILE_SIZE_Y_C;
+  size_t y_end = std::min( y_start + TILE_SIZE_Y_C, this->elem_ny_ );
+
+  // References to back/front/side tables
+  UIntVector& back_edge_x = this->edge_buffer_[ this->back_buffer_x_ ];
+  UIntVector& back_edge_y = this->edge_buffer_[ this->back_buffer_y_ ];
+  UIntVector& front_edge_x = this->edge_buffer_[ this->front_buffer_x_ ];
+  UIntVector& front_edge_y = this->edge_buffer_[ this->front_buffer_y_ ];
+  UIntVector& side_edge = this->edge_buffer_[ this->side_buffer_ ];
+
+  // Since mask values are either on or off, no need to interpolate 
+  // between vertices along edges.  Always put point in center of edge.
+  const float INTERP_EDGE_OFFSET_C = 0.5f;
+
+  size_t first_point_index = point_index;
+  num_faces = 0;
+
+  // Step 1: determine the type of marching cube pattern (triangles) that needs
+  // to go in each element (cube) and the intersecting points on each edge
+  for ( size_t y = y_start; y < y_end; y++ )
   {
-    // Process two adjacent slices at a time (back and front)
-    // Get pointer to beginning of each slice in the data
-    unsigned char* data1 = this->data_ + z * ( this->nx_ * this->ny_ );
-    unsigned char* data2 = this->data_ + ( z + 1 ) * ( this->nx_ * this->ny_ );
-
-    points.clear();
-    point_cnt = thread<<24; // upper 8 bits are used to store thread id -- efficiency trick
-
-    // References to back/front/side tables
-    UIntVector& back_edge_x = this->edge_buffer_[ back_buffer_x ];
-    UIntVector& back_edge_y = this->edge_buffer_[ back_buffer_y ];
+    for ( size_t x = x_start; x < x_end; x++ )
+    {
+      size_t q = y * this->nx_ + x; // Index into data
+      unsigned char type = this->element_type( data1, data2, q );
+      if ( generate ) this->type_buffer_[ q ] = type;
 
-    UIntVector& front_edge_x = this->edge_buffer_[ front_buffer_x ];
-    UIntVector& front_edge_y = this->edge_buffer_[ front_buffer_y ];
+      // All points are inside or outside the cube -- does not contribute to the 
+      // isosurface 
+      if (type == 0x00 || type == 0xFF ) 
+      {
+        continue;
+      }
+      num_faces += MARCHING_CUBES_TABLE_C[ type ].num_triangles_;
 
-    UIntVector& side_edge = this->edge_buffer_[ side_buffer ];
+      float fx = static_cast< float >( x );
+      float fy = static_cast< float >( y );
+      float fz = static_cast< float >( z );
 
-    // Use relative offsets to find edges
-    edge_table[ 0 ] = &( this->edge_buffer_[ back_buffer_x ][ 0 ] );
-    edge_table[ 1 ] = &( this->edge_buffer_[ back_buffer_y ][ 1 ] );
-    edge_table[ 2 ] = &( this->edge_buffer_[ back_buffer_x ][ this->nx_ ] );
-    edge_table[ 3 ] = &( this->edge_buffer_[ back_buffer_y ][ 0 ] );
-
-    edge_table[ 4 ] = &( this->edge_buffer_[ front_buffer_x ][ 0 ] );
-    edge_table[ 5 ] = &( this->edge_buffer_[ front_buffer_y ][ 1 ] );
-    edge_table[ 6 ] = &( this->edge_buffer_[ front_buffer_x ][ this->nx_ ] );
-    edge_table[ 7 ] = &( this->edge_buffer_[ front_buffer_y ][ 0 ] );
-
-    edge_table[ 8 ] = &( this->edge_buffer_[ side_buffer ][ 0 ] );
-    edge_table[ 9 ] = &( this->edge_buffer_[ side_buffer ][ 1 ] );
-    edge_table[ 10 ] = &( this->edge_buffer_[ side_buffer ][ this->nx_ ] );
-    edge_table[ 11 ] = &( this->edge_buffer_[ side_buffer ][ this->nx_ + 1 ] );
-
-    // Step 1: determine the type of marching cube pattern (triangles) that needs
-    // to go in each element (cube) and the intersecting points on each edge
-
-    // Loop over horizontal strip of elements (cubes)
-    for ( size_t y = nystart; y < nyend; y++ )
-    {
-      for ( size_t x = 0; x < this->nx_; x++ )
+      if ( z == 0 )
       {
-        // There are dim - 1 elements (cubes)
-        if ( x < this->elem_nx_ && y < this->elem_ny_ )
+        // top border and center ones
+        if ( ( ( type>>0 ) ^ ( type>>1 ) ) & 0x01 ) 
         {
-          // type = index into polygonal configuration table
-          unsigned char type = 0;
-          size_t q = y * this->nx_ + x; // Index into data
-          // An 8 bit index is formed where each bit corresponds to a vertex 
-          // Bit on if vertex is inside surface, off otherwise
-          if ( data1[ q ] & this->mask_value_ )         type |= 0x1;
-          if ( data1[ q + 1 ] & this->mask_value_ )       type |= 0x2;
-          if ( data1[ q + this->nx_ + 1 ] & this->mask_value_ ) type |= 0x4;
-          if ( data1[ q + this->nx_ ] & this->mask_value_ )   type |= 0x8;
-
-          if ( data2[ q ] & this->mask_value_ )         type |= 0x10;
-          if ( data2[ q + 1 ] & this->mask_value_ )       type |= 0x20;
-          if ( data2[ q + this->nx_ + 1 ] & this->mask_value_ ) type |= 0x40;
-          if ( data2[ q + this->nx_ ] & this->mask_value_ )   type |= 0x80;
-
-          this->type_buffer_[ q ] = type;
-
-          // All points are inside or outside the cube -- does not contribute to the 
-          // isosurface 
-          if (type == 0x00 || type == 0xFF ) 
-          {
-            continue;
-          }
-
-          // Since mask values are either on or off, no need to interpolate 
-          // between vertices along edges.  Always put point in center of edge.
-          const float INTERP_EDGE_OFFSET_C = 0.5f;
-
-          if ( z == 0 )
-          {
-            // top border and center ones
-            if ( ( ( type>>0 ) ^ ( type>>1 ) ) & 0x01 ) 
-            {
-              PointF edge_point = PointF( static_cast< float >( x ) + 
-                INTERP_EDGE_OFFSET_C,
-                static_cast< float >( y ),
-                static_cast< float >( z ) );
-
-              // Transform point by mask transform
-              edge_point = grid_transform.project( edge_point );
-
-              points.push_back( edge_point );
-              back_edge_x[ q ] = point_cnt;
-              point_cnt++;
-            }
-
-            // bottom border one
-            if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>2 ) ^ ( type>>3 ) ) & 0x01 ) )
-            {
-              PointF edge_point = PointF( static_cast< float >( x ) + 
-                INTERP_EDGE_OFFSET_C,
-                static_cast< float>( y + 1 ),
-                static_cast< float >( z ) );
-
-              // Transform point by mask transform
-              edge_point = grid_transform.project( edge_point );
-
-              points.push_back( edge_point );
-              back_edge_x[ q + this->nx_ ] = point_cnt;
-              point_cnt++;
-            }
-
-            // left border and center ones
-            if ( ( ( type>>0 ) ^ ( type>>3 ) ) & 0x01 )
-            {
-              PointF edge_point = PointF( static_cast< float >( x ),
-                static_cast< float >( y ) + INTERP_EDGE_OFFSET_C,
-                static_cast< float >( z ) );
-
-              // Transform point by mask transform
-              edge_point = grid_transform.project( edge_point );
-
-              points.push_back( edge_point );
-              back_edge_y[ q ] = point_cnt;
-              point_cnt++;
-            }
-
-            // right one
-            if ( ( x == this->elem_nx_ - 1 ) && ( ( ( type>>1 ) ^ ( type>>2 ) ) & 0x01 ) )
-            {
-              PointF edge_point = PointF( static_cast< float >( x + 1 ), 
-                static_cast< float >( y ) + INTERP_EDGE_OFFSET_C,
-                static_cast< float >( z ) );
-
-              // Transform point by mask transform
-              edge_point = grid_transform.project( edge_point );
-
-              points.push_back( edge_point );
-              back_edge_y[ q + 1 ] = point_cnt;
-              point_cnt++;
-            }
-          }
-
-          // top border and center ones
-          if ( ( ( type>>4 ) ^ ( type>>5 ) ) & 0x01 )
-          {
-            PointF edge_point = PointF( static_cast< float >( x ) + INTERP_EDGE_OFFSET_C,
-              static_cast< float >( y ),
-              static_cast< float >( z + 1 ) );
-
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
-
-            points.push_back( edge_point );
-            front_edge_x[ q ] = point_cnt;
-            point_cnt++;
-          }
-
-          // bottom border one
-
-          if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>6 ) ^ ( type>>7 ) ) & 0x01 ) )
-          {
-            PointF edge_point = PointF( static_cast< float >( x ) + INTERP_EDGE_OFFSET_C,
-              static_cast< float >( y + 1 ),
-              static_cast< float >( z + 1 ) );
-
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
-
-            points.push_back( edge_point );
-            front_edge_x[ q + this->nx_ ] = point_cnt;
-            point_cnt++;
-          }
-
-          // left border and center ones
-          if ( ( ( type>>4 ) ^ ( type>>7 ) ) & 0x01 )
-          {
-            PointF edge_point = PointF( static_cast< float >( x ),
-              static_cast< float >( y ) + INTERP_EDGE_OFFSET_C,
-              static_cast< float >( z + 1 ) );
-
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
-
-            points.push_back( edge_point );
-            front_edge_y[ q ] = point_cnt;
-            point_cnt++;
-          }
-
-          // bottom one
-          if ( ( x== this->elem_nx_ - 1 ) && ( ( ( type>>5 ) ^ ( type>>6 ) ) & 0x01 ) )
-          {
-            PointF edge_point = PointF( static_cast< float >( x + 1 ), 
-              static_cast< float >( y ) + INTERP_EDGE_OFFSET_C,
-              static_cast< float >( z + 1 ) );
-
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
+          this->add_edge_point( generate, fx + INTERP_EDGE_OFFSET_C, fy, fz, 
+            back_edge_x[ q ], point_index );
+        }
 
-            points.push_back( edge_point );
-            front_edge_y[ q + 1 ] = point_cnt;
-            point_cnt++;
-          }
+        // bottom border one
+        if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>2 ) ^ ( type>>3 ) ) & 0x01 ) )
+        {
+          this->add_edge_point( generate, fx + INTERP_EDGE_OFFSET_C, fy + 1.0f, fz, 
+            back_edge_x[ q + this->nx_ ], point_index );
+        }
 
-          // side edges
+        // left border and center ones
+        if ( ( ( type>>0 ) ^ ( type>>3 ) ) & 0x01 )
+        {
+          this->add_edge_point( generate, fx, fy + INTERP_EDGE_OFFSET_C, fz, 
+            back_edge_y[ q ], point_index );
+        }
 
-          if ( ( ( type>>0 ) ^ ( type >> 4 ) ) & 0x01 )
-          {
-            PointF edge_point = PointF( static_cast< float >( x ), 
-              static_cast< float >( y ), 
-              static_cast< float >( z ) + INTERP_EDGE_OFFSET_C );
+        // right one
+        if ( ( x == this->elem_nx_ - 1 ) && ( ( ( type>>1 ) ^ ( type>>2 ) ) & 0x01 ) )
+        {
+          this->add_edge_point( generate, fx + 1.0f, fy + INTERP_EDGE_OFFSET_C, fz, 
+            back_edge_y[ q + 1 ], point_index );
+        }
+      }
 
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
+      // top border and center ones
+      if ( ( ( type>>4 ) ^ ( type>>5 ) ) & 0x01 )
+      {
+        this->add_edge_point( generate, fx + INTERP_EDGE_OFFSET_C, fy, fz + 1.0f, 
+          front_edge_x[ q ], point_index );
+      }
 
-            points.push_back( edge_point );
-            side_edge[ q ] = point_cnt;
-            point_cnt++;              
-          }    
+      // bottom border one
+      if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>6 ) ^ ( type>>7 ) ) & 0x01 ) )
+      {
+        this->add_edge_point( generate, fx + INTERP_EDGE_OFFSET_C, fy + 1.0f, fz + 1.0f, 
+          front_edge_x[ q + this->nx_ ], point_index );
+      }
 
+      // left border and center ones
+      if ( ( ( type>>4 ) ^ ( type>>7 ) ) & 0x01 )
+      {
+        this->add_edge_point( generate, fx, fy + INTERP_EDGE_OFFSET_C, fz + 1.0f, 
+          front_edge_y[ q ], point_index );
+      }
 
-          if ( ( x == this->elem_nx_ - 1 ) && ( ( ( type>>1 ) ^ ( type>>5 ) ) & 0x01 ) )
-          {
-            PointF edge_point = PointF( static_cast< float >( x + 1 ), 
-              static_cast< float >( y ),
-              static_cast< float >( z ) + INTERP_EDGE_OFFSET_C );
+      // bottom one
+      if ( ( x== this->elem_nx_ - 1 ) && ( ( ( type>>5 ) ^ ( type>>6 ) ) & 0x01 ) )
+      {
+        this->add_edge_point( generate, fx + 1.0f, fy + INTERP_EDGE_OFFSET_C, fz + 1.0f, 
+          front_edge_y[ q + 1 ], point_index );
+      }
 
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
+      // side edges
+      if ( ( ( type>>0 ) ^ ( type >> 4 ) ) & 0x01 )
+      {
+        this->add_edge_point( generate, fx, fy, fz + INTERP_EDGE_OFFSET_C, 
+          side_edge[ q ], point_index );
+      }    
 
-            points.push_back( edge_point );
-            side_edge[ q + 1 ] = point_cnt;
-            point_cnt++;              
-          }
+      if ( ( x == this->elem_nx_ - 1 ) && ( ( ( type>>1 ) ^ ( type>>5 ) ) & 0x01 ) )
+      {
+        this->add_edge_point( generate, fx + 1.0f, fy, fz + INTERP_EDGE_OFFSET_C, 
+          side_edge[ q + 1 ], point_index );
+      }
 
-          if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>3 ) ^ ( type>>7 ) ) & 0x01 ) )
-          {
-            PointF edge_point = PointF( static_cast< float >( x ), 
-              static_cast< float >( y + 1 ), 
-              static_cast< float >( z ) + INTERP_EDGE_OFFSET_C );
+      if ( ( y == this->elem_ny_ - 1 ) && ( ( ( type>>3 ) ^ ( type>>7 ) ) & 0x01 ) )
+      {
+        this->add_edge_point( generate, fx, fy + 1.0f, fz + INTERP_EDGE_OFFSET_C, 
+          side_edge[ q + this->nx_ ], point_index );
+      }
 
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
+      if ( ( ( y == this->elem_ny_ - 1 ) && ( x == this->elem_nx_ - 1 ) ) && 
+        ( ( ( type>>2 ) ^ ( type>>6 ) ) & 0x01 ) )
+      {
+        this->add_edge_point( generate, fx + 1.0f, fy + 1.0f, fz + INTERP_EDGE_OFFSET_C, 
+          side_edge[ q + this->nx_ + 1 ], point_index );
+      }
+    }
+  }
 
-            points.push_back( edge_point );
-            side_edge[ q + this->nx_ ] = point_cnt;
-            point_cnt++;              
-          }
+  return point_index - first_point_index;
+}
 
-          if ( ( ( y == this->elem_ny_ - 1 ) && ( x == this->elem_nx_ - 1 ) ) && 
-            ( ( ( type>>2 ) ^ ( type>>6 ) ) & 0x01 ) )
-          {
-            PointF edge_point = PointF( static_cast< float >( x + 1 ), 
-              static_cast< float >( y + 1 ), 
-              static_cast< float >( z ) + INTERP_EDGE_OFFSET_C );
+void IsosurfacePrivate::compute_tile_faces( size_t tile, size_t face_index, double& area )
+{
+  size_t x_start = ( tile % this->tile_nx_ ) * TILE_SIZE_X_C;
+  size_t x_end = std::min( x_start + TILE_SIZE_X_C, this->elem_nx_ );
+  size_t y_start = ( tile / this->tile_nx_ ) * TILE_SIZE_Y_C;
+  size_t y_end = std::min( y_start + TILE_SIZE_Y_C, this->elem_ny_ );
 
-            // Transform point by mask transform
-            edge_point = grid_transform.project( edge_point );
+  unsigned int* faces = &this->faces_[ 3 * face_index ];
+  area = 0.0;
 
-            points.push_back( edge_point );
-            side_edge[ q + this->nx_ + 1 ] = point_cnt;
-            point_cnt++;              
-          }
-        }
-      }
-    }
+  // Build triangles
+  for ( size_t y = y_start; y < y_end; y++ )
+  {
+    for ( size_t x = x_start; x < x_end; x++ )
+    {
+      size_t elem_offset = y * this->nx_ + x;
+      unsigned char type = this->type_buffer_[ elem_offset ];
 
-    barrier.wait();
-    elements.clear();
-
-    // Combine points from all threads
-    if ( thread == 0 )
-    {   
-      size_t local_size = 0;
-      for ( int p = 0; p < num_threads; p++ )
-      {            
-        this->front_offset_[ p ] = this->global_point_cnt_ + local_size;
-        if ( z == 0 )
-        {
-          this->back_offset_[ p ] = this->front_offset_[ p ];
-        }
-        local_size += this->new_points_[ p ].size();
-        PointFVector& points = this->new_points_[ p ];
-        for ( size_t q = 0; q < points.size(); q++ )
-        {
-          this->points_.push_back( points[ q ] ); 
-        }
+      // All points are inside or outside the cube -- does not contribute to the 
+      // isosurface 
+      if ( type == 0 || type == 0xFF ) 
+      {
+        continue;
       }
-      this->global_point_cnt_ += local_size;
-    
-      this->min_point_index_[ z ] = this->prev_point_min_;
-      this->max_point_index_[ z ] = static_cast<unsigned int>( this->points_.size() );
-      this->prev_point_min_ = this->prev_point_max_;
-      this->prev_point_max_ = this->max_point_index_[ z ];
-    }
 
-    barrier.wait();
+      // Get the edges from the marching cube table 
+      const MarchingCubesTableType& table = MARCHING_CUBES_TABLE_C[ type ];
 
-    // Build triangles
-    for ( size_t y = elem_nystart; y < elem_nyend; y++ )
-    {
-      for (size_t x=0;x<elem_nx_;x++)
+      for ( int k = 0; k < table.num_triangles_; k++ )
       {
-        size_t elem_offset = y * this->nx_ + x;
-        unsigned char type = this->type_buffer_[ elem_offset ];
-
-        // All points are inside or outside the cube -- does not contribute to the 
-        // isosurface 
-        if ( type == 0 || type == 0xFF ) 
+        // Get the edge index (0-11 for 12 edges) and look up its point
+        for ( int i = 0; i < 3; i++ )
         {
-          continue;
+          faces[ i ] = this->edge_table_[ table.edges_[ 3 * k + i ] ][ elem_offset ];
         }
 
-        // Get the edges from the marching cube table 
-        const MarchingCubesTableType& table = MARCHING_CUBES_TABLE_C[ type ];
+        // Add the area of the triangle to the total
+        area += 0.5f * Cross( this->points_[ faces[ 1 ] ] - this->points_[ faces[ 0 ] ], 
+          this->points_[ faces[ 2 ] ] - this->points_[ faces[ 0 ] ] ).length();
+        faces += 3;
+      }
+    }
+  }
+}
 
-        for ( int k = 0; k < table.num_triangles_; k++ )
-        {
-          // Get the edge index (0-11 for 12 edges)
-          int i1 = table.edges_[ 3 * k ];
-          int i2 = table.edges_[ 3 * k + 1 ];
-          int i3 = table.edges_[ 3 * k + 2 ];
+void IsosurfacePrivate::count_tiles( size_t begin, size_t end )
+{
+  size_t tiles_per_slice = this->tile_nx_ * this->tile_ny_;
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t num_faces;
+    size_t num_points = this->compute_tile_points( j % tiles_per_slice, j / tiles_per_slice, 
+      0, false, num_faces );
+    this->tile_point_counts_[ j ] = static_cast< unsigned int >( num_points );
+    this->tile_face_counts_[ j ] = static_cast< unsigned int >( num_faces );
+  }
+}
 
-          unsigned int p1 = edge_table[ i1 ][ elem_offset ];
-          unsigned int p2 = edge_table[ i2 ][ elem_offset ];
-          unsigned int p3 = edge_table[ i3 ][ elem_offset ];
+void IsosurfacePrivate::generate_slice_points( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    size_t num_faces;
+    this->compute_tile_points( this->slice_tiles_[ j ], this->slice_z_, 
+      this->slice_point_offsets_[ j ], true, num_faces );
+  }
+}
 
-          if ( i1 < 4 ) 
-          {
-            elems[ 0 ] = ( p1 & 0x00FFFFFF ) + this->back_offset_[ p1>>24 ];
-          }
-          else
-          {
-            elems[ 0 ] = ( p1 & 0x00FFFFFF ) + this->front_offset_[ p1>>24 ];            
-          }
+void IsosurfacePrivate::generate_slice_faces( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    this->compute_tile_faces( this->slice_tiles_[ j ], this->slice_face_offsets_[ j ],
+      this->slice_tile_areas_[ j ] );
+  }
+}
 
-          if ( i2 < 4 ) 
-          {
-            elems[ 1 ] = ( p2 & 0x00FFFFFF ) + this->back_offset_[ p2>>24 ];
-          }
-          else
-          {
-            elems[ 1 ] = ( p2 & 0x00FFFFFF ) + this->front_offset_[ p2>>24 ];            
-          }
+bool IsosurfacePrivate::compute_faces()
+{
+  // Setup the algorithm and the buffers
+  if ( !this->compute_faces_setup() ) return true;
 
-          if ( i3 < 4 ) 
-          {
-            elems[ 2 ] = ( p3 & 0x00FFFFFF ) + this->back_offset_[ p3>>24 ];
-          }
-          else
-          {
-            elems[ 2 ] = ( p3 & 0x00FFFFFF ) + this->front_offset_[ p3>>24 ];            
-          }
-          elements.push_back( elems );
-          // Add the area of the triangle to the total
-          this->new_elem_areas_[ thread ] += 0.5f * 
-            Cross( this->points_[ elems[ 1 ] ] - this->points_[ elems[ 0 ] ], 
-            this->points_[ elems[ 2 ] ] - this->points_[ elems[ 0 ] ] ).length();
-        }
-      }
-    }
+  ThreadPool* thread_pool = ThreadPool::Instance();
+  size_t tiles_per_slice = this->tile_nx_ * this->tile_ny_;
+  thread_pool->parallel_for( 0, this->tile_point_counts_.size(), COUNT_GRAIN_C, 
+    boost::bind( &IsosurfacePrivate::count_tiles, this, _1, _2 ) );
 
-    std::swap( back_buffer_x, front_buffer_x );
-    std::swap( back_buffer_y, front_buffer_y );
-    barrier.wait();
+  // Points and faces are indexed with unsigned int, because GL expects this
+  size_t num_points = 0;
+  size_t num_faces = 0;
+  for ( size_t j = 0; j < this->tile_point_counts_.size(); j++ )
+  {
+    num_points += this->tile_point_counts_[ j ];
+    num_faces += this->tile_face_counts_[ j ];
+  }
+  if ( num_points > std::numeric_limits< unsigned int >::max() || 
+    3 * num_faces > std::numeric_limits< unsigned int >::max() )
+  {
+    CORE_LOG_ERROR( "Isosurface has too many points or faces to be indexed." );
+    return false;
+  }
 
-    if ( thread == 0 )
-    {
-      this->min_face_index_[ z ] = static_cast<unsigned int>( this->faces_.size() );
+  this->points_.resize( num_points );
+  this->faces_.resize( 3 * num_faces );
 
-      for ( int w = 0;  w < num_threads; w++ )
-      {
-        std::vector< StackVector< size_t, 3 > >& pelements = this->new_elems_[ w ];
-        for ( size_t p = 0; p < pelements.size(); p++ )
-        {
-          StackVector< size_t, 3 >& el = pelements[ p ];
-          this->faces_.push_back( static_cast< unsigned int >( el[ 0 ] ) );
-          this->faces_.push_back( static_cast< unsigned int >( el[ 1 ] ) );
-          this->faces_.push_back( static_cast< unsigned int >( el[ 2 ] ) );
-        }
-      }
-      this->back_offset_ = this->front_offset_;
+  size_t point_index = 0;
+  size_t face_index = 0;
+  size_t prev_point_min = 0;
 
-      this->max_face_index_[ z ] = static_cast<unsigned int>( this->faces_.size() );
+  // Loop over all the slices
+  for ( size_t z = 0;  z < this->elem_nz_; z++ ) 
+  {
+    // Give each tile of the slice that has points or faces its range of indices
+    size_t slice_point_min = point_index;
+    this->slice_z_ = z;
+    this->slice_tiles_.clear();
+    this->slice_point_offsets_.clear();
+    this->slice_face_offsets_.clear();
+    this->min_face_index_[ z ] = static_cast< unsigned int >( 3 * face_index );
+    for ( size_t tile = 0; tile < tiles_per_slice; tile++ )
+    {
+      size_t j = z * tiles_per_slice + tile;
+      if ( this->tile_point_counts_[ j ] == 0 && this->tile_face_counts_[ j ] == 0 ) continue;
+      this->slice_tiles_.push_back( tile );
+      this->slice_point_offsets_.push_back( point_index );
+      this->slice_face_offsets_.push_back( face_index );
+      point_index += this->tile_point_counts_[ j ];
+      face_index += this->tile_face_counts_[ j ];
     }
+    this->max_face_index_[ z ] = static_cast< unsigned int >( 3 * face_index );
+    this->slice_tile_areas_.assign( this->slice_tiles_.size(), 0.0 );
 
-    if ( thread == 0 )
+    // Use relative offsets to find edges
+    this->edge_table_[ 0 ] = &( this->edge_buffer_[ this->back_buffer_x_ ][ 0 ] );
+    this->edge_table_[ 1 ] = &( this->edge_buffer_[ this->back_buffer_y_ ][ 1 ] );
+    this->edge_table_[ 2 ] = &( this->edge_buffer_[ this->back_buffer_x_ ][ this->nx_ ] );
+    this->edge_table_[ 3 ] = &( this->edge_buffer_[ this->back_buffer_y_ ][ 0 ] );
+
+    this->edge_table_[ 4 ] = &( this->edge_buffer_[ this->front_buffer_x_ ][ 0 ] );
+    this->edge_table_[ 5 ] = &( this->edge_buffer_[ this->front_buffer_y_ ][ 1 ] );
+    this->edge_table_[ 6 ] = &( this->edge_buffer_[ this->front_buffer_x_ ][ this->nx_ ] );
+    this->edge_table_[ 7 ] = &( this->edge_buffer_[ this->front_buffer_y_ ][ 0 ] );
+
+    this->edge_table_[ 8 ] = &( this->edge_buffer_[ this->side_buffer_ ][ 0 ] );
+    this->edge_table_[ 9 ] = &( this->edge_buffer_[ this->side_buffer_ ][ 1 ] );
+    this->edge_table_[ 10 ] = &( this->edge_buffer_[ this->side_buffer_ ][ this->nx_ ] );
+    this->edge_table_[ 11 ] = &( this->edge_buffer_[ this->side_buffer_ ][ this->nx_ + 1 ] );
+
+    // All points of the slice need to exist before the faces can refer to them
+    thread_pool->parallel_for( 0, this->slice_tiles_.size(), 1, 
+      boost::bind( &IsosurfacePrivate::generate_slice_points, this, _1, _2 ) );
+    thread_pool->parallel_for( 0, this->slice_tiles_.size(), 1, 
+      boost::bind( &IsosurfacePrivate::generate_slice_faces, this, _1, _2 ) );
+
+    double area = 0.0;
+    for ( size_t j = 0; j < this->slice_tile_areas_.size(); j++ )
     {
-      if ( this->check_abort_() ) 
-      {
-        this->need_abort_ = true;
-      }
+      area += this->slice_tile_areas_[ j ];
     }
+    this->area_ += static_cast< float >( area );
+
+    // Faces use the points of this slice and the front points of the previous one
+    this->min_point_index_[ z ] = static_cast< unsigned int >( prev_point_min );
+    this->max_point_index_[ z ] = static_cast< unsigned int >( point_index );
+    prev_point_min = slice_point_min;
 
-    barrier.wait();   
+    std::swap( this->back_buffer_x_, this->front_buffer_x_ );
+    std::swap( this->back_buffer_y_, this->front_buffer_y_ );
 
-    if ( this->need_abort_ ) 
+    if ( this->check_abort_() ) 
     {
-      return;
+      return false;
     }
     
     // Update progress based on number of z slices processed
@@ -1178,18 +1104,10 @@ void IsosurfacePrivate::parallel_compute_faces( int thread, int num_threads,
     this->isosurface_->update_progress_signal_( total_progress );
   }   
 
-  barrier.wait();
+  UIntVector().swap( this->tile_point_counts_ );
+  UIntVector().swap( this->tile_face_counts_ );
 
-  // Add up surface areas computed in all threads
-  if ( thread == 0 )
-  {
-    for ( int p = 0; p < num_threads; ++p )
-    {
-      this->area_ += this->new_elem_areas_[ p ];
-    }
-  }
-  
-  barrier.wait();
+  return true;
 }
 
 //  Translates border face coords (i, j) to volume coords (x, y, z).  
@@ -1748,6 +1666,54 @@ void IsosurfacePrivate::upload_to_vertex_buffer()
   this->vbo_available_ = true;
 }
 
+bool IsosurfacePrivate::decimate( size_t max_faces, double max_error )
+{
+  MeshDecimation decimation;
+  decimation.set_target_faces( max_faces );
+  decimation.set_max_error( max_error );
+  decimation.set_progress_function( boost::bind( 
+    &IsosurfacePrivate::update_decimation_progress, this, _1 ) );
+  decimation.set_abort_function( this->check_abort_ );
+  if ( !decimation.run( this->points_, this->faces_ ) ) return false;
+
+  // Faces now refer to points outside of their slice, so split the faces into chunks and 
+  // record the range of points that each of them uses
+  const size_t chunk_size = 3 * 100000;
+  this->min_point_index_.clear();
+  this->max_point_index_.clear();
+  this->min_face_index_.clear();
+  this->max_face_index_.clear();
+  this->area_ = 0;
+  for ( size_t start = 0; start < this->faces_.size(); start += chunk_size )
+  {
+    size_t end = std::min( start + chunk_size, this->faces_.size() );
+    unsigned int min_point_index = this->faces_[ start ];
+    unsigned int max_point_index = this->faces_[ start ];
+    for ( size_t j = start; j < end; j += 3 )
+    {
+      const unsigned int* face = &this->faces_[ j ];
+      for ( int k = 0; k < 3; k++ )
+      {
+        min_point_index = std::min( min_point_index, face[ k ] );
+        max_point_index = std::max( max_point_index, face[ k ] );
+      }
+      this->area_ += 0.5f * Cross( this->points_[ face[ 1 ] ] - this->points_[ face[ 0 ] ],
+        this->points_[ face[ 2 ] ] - this->points_[ face[ 0 ] ] ).length();
+    }
+    this->min_point_index_.push_back( min_point_index );
+    this->max_point_index_.push_back( max_point_index + 1 );
+    this->min_face_index_.push_back( static_cast< unsigned int >( start ) );
+    this->max_face_index_.push_back( static_cast< unsigned int >( end ) );
+  }
+  return true;
+}
+
+void IsosurfacePrivate::update_decimation_progress( double progress )
+{
+  this->isosurface_->update_progress_signal_( COMPUTE_PERCENT_PROGRESS_C + 
+    progress * NORMAL_PERCENT_PROGRESS_C );
+}
+
 void IsosurfacePrivate::reset()
 {
   this->points_.clear();
@@ -1771,7 +1737,7 @@ Isosurface::Isosurface( const MaskVolumeHandle& mask_volume ) :
 }
 
 void Isosurface::compute( double quality_factor, bool capping_enabled, 
-  boost::function< bool () > check_abort )
+  boost::function< bool () > check_abort, size_t max_faces, double max_error )
 {
   lock_type lock( this->get_mutex() );
 
@@ -1809,11 +1775,7 @@ void Isosurface::compute( double quality_factor, bool capping_enabled,
     this->private_->compute_setup();
 
     // Compute isosurface without caps
-    Parallel parallel_faces( boost::bind( &IsosurfacePrivate::parallel_compute_faces, 
-      this->private_, _1, _2, _3 ) );
-    parallel_faces.run();
-
-    if ( check_abort() )
+    if ( !this->private_->compute_faces() )
     {
       // leave it in a decent state
       this->private_->reset();
@@ -1833,6 +1795,16 @@ void Isosurface::compute( double quality_factor, bool capping_enabled,
     return;
   }
 
+  if ( max_faces > 0 || max_error > 0.0 )
+  {
+    if ( !this->private_->decimate( max_faces, max_error ) )
+    {
+      // leave it in a decent state
+      this->private_->reset();
+      return;
+    }
+  }
+
   // Test code -- assign values to vertices in range [0, 1].  
   /*size_t num_points = this->private_->points_.size();
   for( size_t i = 0; i < num_points; i++ )
@@ -1857,11 +1829,10 @@ void Isosurface::compute( double quality_factor, bool capping_enabled,
 
   this->private_->type_buffer_.clear();
   this->private_->edge_buffer_.clear();
-  this->private_->new_points_.clear();
-  this->private_->new_elems_.clear();
-  this->private_->new_elem_areas_.clear();
-  this->private_->front_offset_.clear();
-  this->private_->back_offset_.clear();
+  this->private_->slice_tiles_.clear();
+  this->private_->slice_point_offsets_.clear();
+  this->private_->slice_face_offsets_.clear();
+  this->private_->slice_tile_areas_.clear();
   
   this->private_->part_points_.clear();
   this->private_->part_faces_.clear();
@@ -1869,22 +1840,31 @@ void Isosurface::compute( double quality_factor, bool capping_enabled,
   
   unsigned int num_faces = 0;
   unsigned int min_point_index = 0;
+  unsigned int max_point_index = 0;
   unsigned int min_face_index = 0;
   
   for ( size_t j = 0; j < this->private_->min_point_index_.size(); j++ )
   {
+    // Track the range over all slices in the part, as the faces of a decimated surface can
+    // use points that were made for another slice
     if ( num_faces == 0 )
     {
       min_point_index = this->private_->min_point_index_[ j ];
+      max_point_index = this->private_->max_point_index_[ j ];
       min_face_index = this->private_->min_face_index_[ j ];
     }
+    else if ( this->private_->max_face_index_[ j ] > this->private_->min_face_index_[ j ] )
+    {
+      min_point_index = std::min( min_point_index, this->private_->min_point_index_[ j ] );
+      max_point_index = std::max( max_point_index, this->private_->max_point_index_[ j ] );
+    }
     
     num_faces += this->private_->max_face_index_[ j ] - this->private_->min_face_index_[ j ];
     
     if ( num_faces > 0 && (num_faces > 1000000 || j == this->private_->min_point_index_.size() - 1 ) )
     {
       this->private_->part_points_.push_back( std::make_pair(
-        min_point_index, this->private_->max_point_index_[ j ] ) );
+        min_point_index, max_point_index ) );
       this->private_->part_faces_.push_back( std::make_pair(
         min_face_index, this->private_->max_face_index_[ j ] ) );
       num_faces = 0;
@@ -2139,9 +2119,16 @@ bool Isosurface::export_legacy_isosurface( const boost::filesystem::path& path,
 }
 
 
-bool Isosurface::export_vtk_isosurface( const boost::filesystem::path& filename )
+bool Isosurface::export_vtk_isosurface( const boost::filesystem::path& filename, bool binary )
 {
   lock_type lock( this->get_mutex() );
+  if ( binary )
+  {
+    return IsosurfaceExporter::ExportVTKBinary( filename,
+                                                this->private_->points_,
+                                                this->private_->faces_
+                                              );
+  }
   bool result = IsosurfaceExporter::ExportVTKASCII( filename,
                                                     this->private_->points_,
                                                     this->private_->faces_
@@ -72,7 +72,10 @@ public:
 
   // COMPUTE:
   /// Compute isosurface.  quality_factor must be one of: {0.125, 0.25, 0.5, 1.0} 
-  void compute( double quality_factor, bool capping_enabled, boost::function< bool () > check_abort );
+  /// If max_faces or max_error is not 0, the surface is decimated afterwards until it has at
+  /// most max_faces faces, or until removing more would move it by more than max_error.
+  void compute( double quality_factor, bool capping_enabled, boost::function< bool () > check_abort,
+    size_t max_faces = 0, double max_error = 0.0 );
 
   // GET_POINTS:
   /// Get 3D points for vertices, each stored only once
@@ -151,8 +154,8 @@ public:
                                  const std::string& file_prefix ); 
 
   // EXPORT_VTK_ISOSURFACE:
-  /// Writes out an isosurface in ASCII VTK mesh format
-  bool export_vtk_isosurface( const boost::filesystem::path& filename );
+  /// Writes out an isosurface in legacy VTK mesh format, with ASCII or binary data
+  bool export_vtk_isosurface( const boost::filesystem::path& filename, bool binary = false );
     
   // EXPORT_OBJ_ISOSURFACE:
   /// Writes out an isosurface in OBJ file format
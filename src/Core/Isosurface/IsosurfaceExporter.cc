@@ -28,32 +28,318 @@
 
 #include <Core/Isosurface/IsosurfaceExporter.h>
 #include <Core/Geometry/Point.h>
+#include <Core/Utils/ThreadPool.h>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/shared_array.hpp>
+#include <boost/function.hpp>
 
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <string>
 
 namespace Core
 {
 
-std::vector<float>
-computeFaceNormal(const PointF& p1, const PointF& p2, const PointF& p3)
+// Number of points or faces that are formatted as one chunk
+static const size_t EXPORT_CHUNK_SIZE_C = 65536;
+
+// Formats the items [ begin, end ) into the buffer, returns false if the items are invalid
+typedef boost::function< bool ( size_t, size_t, std::string& ) > ExportChunkFunction;
+
+// CLASS ExportChunkWriter:
+/// Writes a large number of items to a stream in chunks. The chunks of a batch are formatted
+/// in parallel and then written in order, so only one batch is ever held in memory.
+class ExportChunkWriter
+{
+public:
+  ExportChunkWriter( size_t num_items, ExportChunkFunction format ) :
+    num_items_( num_items ),
+    format_( format )
+  {
+  }
+
+  bool write( std::ostream& stream )
+  {
+    size_t num_chunks = ( this->num_items_ + EXPORT_CHUNK_SIZE_C - 1 ) / EXPORT_CHUNK_SIZE_C;
+    size_t batch_size = 2 * static_cast< size_t >( ThreadPool::Instance()->get_num_threads() );
+    this->buffers_.resize( std::min( batch_size, num_chunks ) );
+    this->valid_.resize( this->buffers_.size() );
+
+    for ( size_t batch = 0; batch < num_chunks; batch += batch_size )
+    {
+      this->batch_start_ = batch;
+      size_t batch_end = std::min( batch + batch_size, num_chunks );
+      ThreadPool::Instance()->parallel_for( batch, batch_end, 1, 
+        boost::bind( &ExportChunkWriter::format_chunks, this, _1, _2 ) );
+
+      for ( size_t j = batch; j < batch_end; j++ )
+      {
+        if ( !this->valid_[ j - batch ] ) return false;
+        const std::string& buffer = this->buffers_[ j - batch ];
+        stream.write( buffer.data(), buffer.size() );
+      }
+      if ( !stream ) return false;
+    }
+    return true;
+  }
+
+private:
+  void format_chunks( size_t begin, size_t end )
+  {
+    for ( size_t j = begin; j < end; j++ )
+    {
+      std::string& buffer = this->buffers_[ j - this->batch_start_ ];
+      buffer.clear();
+      this->valid_[ j - this->batch_start_ ] = this->format_( j * EXPORT_CHUNK_SIZE_C, 
+        std::min( ( j + 1 ) * EXPORT_CHUNK_SIZE_C, this->num_items_ ), buffer );
+    }
+  }
+
+  size_t num_items_;
+  ExportChunkFunction format_;
+  size_t batch_start_;
+  std::vector< std::string > buffers_;
+  std::vector< unsigned char > valid_;
+};
+
+// Append a printf style formatted line to the buffer
+static void AppendFormatted( std::string& buffer, const char* format, ... )
 {
-  // compute face normal:
-  //   U = p2 - p1
-  //   V = p3 - p1
-  //   Ni = UyVz - UzVy
-  //   Nj = UzVx - UxVz
-  //   Nk = UxVy - UyVx
+  char line[ 256 ];
+  va_list args;
+  va_start( args, format );
+  int length = vsnprintf( line, sizeof( line ), format, args );
+  va_end( args );
+  if ( length > 0 ) buffer.append( line, std::min( static_cast< size_t >( length ), 
+    sizeof( line ) - 1 ) );
+}
 
-  VectorF U = p2 - p1;
-  VectorF V = p3 - p1;
+// Store 32 bits in little or big endian byte order, independent of the byte order of the 
+// machine
+static inline void StoreLittleEndian( unsigned int value, char* dst )
+{
+  dst[ 0 ] = static_cast< char >( value & 0xff );
+  dst[ 1 ] = static_cast< char >( ( value >> 8 ) & 0xff );
+  dst[ 2 ] = static_cast< char >( ( value >> 16 ) & 0xff );
+  dst[ 3 ] = static_cast< char >( ( value >> 24 ) & 0xff );
+}
 
-  return{ (U.y() * V.z()) - (U.z() * V.y()),(U.z() * V.x()) - (U.x() * V.z()),(U.x() * V.y()) - (U.y() * V.x()) };
+static inline void StoreBigEndian( unsigned int value, char* dst )
+{
+  dst[ 0 ] = static_cast< char >( ( value >> 24 ) & 0xff );
+  dst[ 1 ] = static_cast< char >( ( value >> 16 ) & 0xff );
+  dst[ 2 ] = static_cast< char >( ( value >> 8 ) & 0xff );
+  dst[ 3 ] = static_cast< char >( value & 0xff );
 }
 
+static inline unsigned int FloatBits( float value )
+{
+  unsigned int bits;
+  std::memcpy( &bits, &value, sizeof( bits ) );
+  return bits;
+}
+
+// Unnormalized normal of a face
+static inline VectorF ComputeFaceNormal( const PointF& p1, const PointF& p2, const PointF& p3 )
+{
+  return Cross( p2 - p1, p3 - p1 );
+}
+
+// Whether the three indices starting at face refer to existing points
+static inline bool ValidFace( const unsigned int* face, size_t num_points )
+{
+  return face[ 0 ] < num_points && face[ 1 ] < num_points && face[ 2 ] < num_points;
+}
+
+// CLASS ExportPointsFormat:
+/// Formats points as prefix followed by the coordinates, one point per line
+class ExportPointsFormat
+{
+public:
+  ExportPointsFormat( const PointFVector& points, const char* prefix ) :
+    points_( points ), prefix_( prefix ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    buffer.reserve( ( end - begin ) * 40 );
+    for ( size_t i = begin; i < end; i++ )
+    {
+      const PointF& pt = this->points_[ i ];
+      AppendFormatted( buffer, "%s%g %g %g\n", this->prefix_, pt.x(), pt.y(), pt.z() );
+    }
+    return true;
+  }
+
+private:
+  const PointFVector& points_;
+  const char* prefix_;
+};
+
+// CLASS ExportFacesFormat:
+/// Formats faces as prefix followed by the indices plus offset, one face per line
+class ExportFacesFormat
+{
+public:
+  ExportFacesFormat( const UIntVector& faces, const char* prefix, unsigned int offset ) :
+    faces_( faces ), prefix_( prefix ), offset_( offset ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    buffer.reserve( ( end - begin ) * 32 );
+    for ( size_t i = begin; i < end; i++ )
+    {
+      const unsigned int* face = &this->faces_[ 3 * i ];
+      AppendFormatted( buffer, "%s%u %u %u\n", this->prefix_, face[ 0 ] + this->offset_, 
+        face[ 1 ] + this->offset_, face[ 2 ] + this->offset_ );
+    }
+    return true;
+  }
+
+private:
+  const UIntVector& faces_;
+  const char* prefix_;
+  unsigned int offset_;
+};
+
+// CLASS ExportValuesFormat:
+/// Formats one value per line
+class ExportValuesFormat
+{
+public:
+  ExportValuesFormat( const FloatVector& values ) : values_( values ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    buffer.reserve( ( end - begin ) * 14 );
+    for ( size_t i = begin; i < end; i++ )
+    {
+      AppendFormatted( buffer, "%g\n", this->values_[ i ] );
+    }
+    return true;
+  }
+
+private:
+  const FloatVector& values_;
+};
+
+// CLASS ExportSTLASCIIFormat:
+/// Formats faces as ASCII STL facets
+class ExportSTLASCIIFormat
+{
+public:
+  ExportSTLASCIIFormat( const PointFVector& points, const UIntVector& faces ) :
+    points_( points ), faces_( faces ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    buffer.reserve( ( end - begin ) * 256 );
+    for ( size_t i = begin; i < end; i++ )
+    {
+      const unsigned int* face = &this->faces_[ 3 * i ];
+      if ( !ValidFace( face, this->points_.size() ) ) return false;
+
+      const PointF& p1 = this->points_[ face[ 0 ] ];
+      const PointF& p2 = this->points_[ face[ 1 ] ];
+      const PointF& p3 = this->points_[ face[ 2 ] ];
+      VectorF normal = ComputeFaceNormal( p1, p2, p3 );
+
+      AppendFormatted( buffer, "  facet normal %f %f %f\n", normal.x(), normal.y(), normal.z() );
+      buffer.append( "    outer loop\n" );
+      AppendFormatted( buffer, "      vertex %f %f %f\n", p1.x(), p1.y(), p1.z() );
+      AppendFormatted( buffer, "      vertex %f %f %f\n", p2.x(), p2.y(), p2.z() );
+      AppendFormatted( buffer, "      vertex %f %f %f\n", p3.x(), p3.y(), p3.z() );
+      buffer.append( "    endloop\n" );
+      buffer.append( "  endfacet\n" );
+    }
+    return true;
+  }
+
+private:
+  const PointFVector& points_;
+  const UIntVector& faces_;
+};
+
+// CLASS ExportSTLBinaryFormat:
+/// Formats faces as 50 byte binary STL records
+class ExportSTLBinaryFormat
+{
+public:
+  ExportSTLBinaryFormat( const PointFVector& points, const UIntVector& faces ) :
+    points_( points ), faces_( faces ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    // Normal, three vertices and an attribute byte count of 0
+    const size_t RECORD_LENGTH = 50;
+    buffer.assign( ( end - begin ) * RECORD_LENGTH, '\0' );
+    char* dst = &buffer[ 0 ];
+    for ( size_t i = begin; i < end; i++, dst += RECORD_LENGTH )
+    {
+      const unsigned int* face = &this->faces_[ 3 * i ];
+      if ( !ValidFace( face, this->points_.size() ) ) return false;
+
+      const PointF& p1 = this->points_[ face[ 0 ] ];
+      const PointF& p2 = this->points_[ face[ 1 ] ];
+      const PointF& p3 = this->points_[ face[ 2 ] ];
+      VectorF normal = ComputeFaceNormal( p1, p2, p3 );
+
+      for ( int k = 0; k < 3; k++ )
+      {
+        StoreLittleEndian( FloatBits( normal[ k ] ), dst + 4 * k );
+        StoreLittleEndian( FloatBits( p1[ k ] ), dst + 12 + 4 * k );
+        StoreLittleEndian( FloatBits( p2[ k ] ), dst + 24 + 4 * k );
+        StoreLittleEndian( FloatBits( p3[ k ] ), dst + 36 + 4 * k );
+      }
+    }
+    return true;
+  }
+
+private:
+  const PointFVector& points_;
+  const UIntVector& faces_;
+};
+
+// CLASS ExportVTKBinaryFormat:
+/// Formats points as big endian floats, or faces as big endian integers preceded by the
+/// number of vertices
+class ExportVTKBinaryFormat
+{
+public:
+  ExportVTKBinaryFormat( const PointFVector& points, const UIntVector& faces, bool write_faces ) :
+    points_( points ), faces_( faces ), write_faces_( write_faces ) {}
+
+  bool operator()( size_t begin, size_t end, std::string& buffer ) const
+  {
+    buffer.assign( ( end - begin ) * ( this->write_faces_ ? 16 : 12 ), '\0' );
+    char* dst = &buffer[ 0 ];
+    for ( size_t i = begin; i < end; i++ )
+    {
+      if ( this->write_faces_ )
+      {
+        const unsigned int* face = &this->faces_[ 3 * i ];
+        if ( !ValidFace( face, this->points_.size() ) ) return false;
+        StoreBigEndian( 3, dst );
+        for ( int k = 0; k < 3; k++ ) StoreBigEndian( face[ k ], dst + 4 + 4 * k );
+        dst += 16;
+      }
+      else
+      {
+        const PointF& pt = this->points_[ i ];
+        for ( int k = 0; k < 3; k++ ) StoreBigEndian( FloatBits( pt[ k ] ), dst + 4 * k );
+        dst += 12;
+      }
+    }
+    return true;
+  }
+
+private:
+  const PointFVector& points_;
+  const UIntVector& faces_;
+  bool write_faces_;
+};
 
 bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
                                        const std::string& file_prefix,
@@ -70,9 +356,10 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
     return false;
   }
 
-  for ( auto &pt: points )
+  ExportChunkWriter points_writer( points.size(), ExportPointsFormat( points, "" ) );
+  if ( ! points_writer.write( pts_file ) )
   {
-    pts_file << pt.x() << " " << pt.y() << " " << pt.z() << std::endl;
+    return false;
   }
   pts_file.close();
 
@@ -84,11 +371,10 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
     return false;
   }
 
-  for ( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  ExportChunkWriter faces_writer( faces.size() / 3, ExportFacesFormat( faces, "", 0 ) );
+  if ( ! faces_writer.write( fac_file ) )
   {
-    fac_file << faces[ i ] << " " <<
-                faces[ i + 1 ] << " " <<
-                faces[ i + 2 ] << std::endl;
+    return false;
   }
   fac_file.close();
 
@@ -102,10 +388,10 @@ bool IsosurfaceExporter::ExportLegacy( const boost::filesystem::path& path,
       return false;
     }
 
-//    for ( size_t i = 0; i < this->private_->values_.size(); i++ )
-    for ( auto &value: values )
+    ExportChunkWriter values_writer( values.size(), ExportValuesFormat( values ) );
+    if ( ! values_writer.write( val_file ) )
     {
-      val_file << value << std::endl;
+      return false;
     }
     val_file.close();
   }
@@ -133,26 +419,67 @@ bool IsosurfaceExporter::ExportVTKASCII( const boost::filesystem::path& filename
   vtk_file << "DATASET POLYDATA\n";
   vtk_file << "POINTS " << points.size() << " float\n";
 
-  for ( auto &pt : points )
+  ExportChunkWriter points_writer( points.size(), ExportPointsFormat( points, "" ) );
+  if ( ! points_writer.write( vtk_file ) )
+  {
+    return false;
+  }
+
+  size_t num_triangles = faces.size() / 3;
+  vtk_file << "\nPOLYGONS " << num_triangles << " " << num_triangles * 4 << "\n";
+
+  ExportChunkWriter faces_writer( num_triangles, ExportFacesFormat( faces, "3 ", 0 ) );
+  if ( ! faces_writer.write( vtk_file ) )
   {
-    vtk_file << pt.x() << " " << pt.y() << " " << pt.z() << std::endl;
+    return false;
   }
 
-  unsigned int num_triangles = faces.size() / 3;
-  unsigned int triangle_list_size = num_triangles * 4;
+  vtk_file.close();
 
-  vtk_file << "\nPOLYGONS " << num_triangles << " " << triangle_list_size << std::endl;
+  return !vtk_file.fail();
+}
 
-  for( size_t i = 0; i + 2 < faces.size(); i += 3 )
+// Legacy VTK file format (http://vtk.org/VTK/img/file-formats.pdf), binary data is stored
+// in big endian byte order
+bool IsosurfaceExporter::ExportVTKBinary( const boost::filesystem::path& filename,
+                                          const PointFVector& points,
+                                          const UIntVector& faces
+                                         )
+{
+  std::ofstream vtk_file( filename.string().c_str(), std::ios::binary );
+  if ( ! vtk_file.is_open() )
   {
-    vtk_file << "3 " << faces[ i ] << " " <<
-                        faces[ i + 1 ] << " " <<
-                        faces[ i + 2 ] << std::endl;
+    return false;
   }
 
+  // write header
+  vtk_file << "# vtk DataFile Version 3.0\n";
+  vtk_file << "vtk output\n";
+
+  vtk_file << "BINARY\n";
+  vtk_file << "DATASET POLYDATA\n";
+  vtk_file << "POINTS " << points.size() << " float\n";
+
+  ExportChunkWriter points_writer( points.size(), 
+    ExportVTKBinaryFormat( points, faces, false ) );
+  if ( ! points_writer.write( vtk_file ) )
+  {
+    return false;
+  }
+
+  size_t num_triangles = faces.size() / 3;
+  vtk_file << "\nPOLYGONS " << num_triangles << " " << num_triangles * 4 << "\n";
+
+  ExportChunkWriter faces_writer( num_triangles, ExportVTKBinaryFormat( points, faces, true ) );
+  if ( ! faces_writer.write( vtk_file ) )
+  {
+    return false;
+  }
+  vtk_file << "\n";
+
   vtk_file.close();
 
-  return true;
+  return !vtk_file.fail();
 }
 
 //OBJ format: https://en.wikipedia.org/wiki/Wavefront_.obj_file
@@ -161,39 +488,34 @@ bool IsosurfaceExporter::ExportOBJ( const boost::filesystem::path& filename,
                                     const UIntVector& faces
                                   )
 {
-  std::ofstream obj_file( filename.string().c_str() );
-
   if( points.size() == 0 )
   {
     return false;
   }
-    
+
+  std::ofstream obj_file( filename.string().c_str() );
   if (! obj_file.is_open() )
   {
     return false;
   }
   
   //Print points
-  for( size_t i = 0; i < points.size(); i++ )
+  ExportChunkWriter points_writer( points.size(), ExportPointsFormat( points, "v " ) );
+  if ( ! points_writer.write( obj_file ) )
   {
-    PointF p = points[ i ];
-    
-    obj_file << "v " << p.x() << " " << p.y() << " " << p.z() << std::endl;
+    return false;
   }
    
-  //Print faces
-  for( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  //Print faces, OBJ face indices are 1-based.  Seriously.
+  ExportChunkWriter faces_writer( faces.size() / 3, ExportFacesFormat( faces, "f ", 1 ) );
+  if ( ! faces_writer.write( obj_file ) )
   {
-    // OBJ face indices are 1-based.  Seriously.
-    obj_file << "f " << faces[ i ] + 1 << " "
-                     << faces[ i+1 ] + 1 << " "
-                     << faces[ i+2 ] + 1 << std::endl;
+    return false;
   }
     
   obj_file.close();
     
-  return true;
-    
+  return !obj_file.fail();
 }
 
 // ASCII STL format: https://en.wikipedia.org/wiki/STL_(file_format)
@@ -209,47 +531,19 @@ bool IsosurfaceExporter::ExportSTLASCII( const boost::filesystem::path& filename
     return false;
   }
 
-  const std::string delim(" ");
-  const std::string indent_level1("  ");
-  const std::string indent_level2("    ");
-  const std::string indent_level3("      ");
-  stl_file << "solid " << name << std::endl;
+  stl_file << "solid " << name << "\n";
 
-  for( size_t i = 0; i + 2 < faces.size(); i += 3 )
+  ExportChunkWriter faces_writer( faces.size() / 3, ExportSTLASCIIFormat( points, faces ) );
+  if ( ! faces_writer.write( stl_file ) )
   {
-    size_t vertex_index1 = faces[ i ];
-    size_t vertex_index2 = faces[ i + 1 ];
-    size_t vertex_index3 = faces[ i + 2 ];
-
-    // Get vertices of face
-    PointF p1 = points[ vertex_index1 ];
-    PointF p2 = points[ vertex_index2 ];
-    PointF p3 = points[ vertex_index3 ];
-
-   auto normal = computeFaceNormal(p1, p2, p3);
-
-    stl_file << indent_level1 << "facet normal " << std::fixed <<
-                                 normal[0] << delim <<
-                                 normal[1] << delim <<
-                                 normal[2] << std::endl;
-    stl_file << indent_level2 << "outer loop" << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p1.x() << delim <<
-                                                            p1.y() << delim <<
-                                                            p1.z() << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p2.x() << delim <<
-                                                            p2.y() << delim <<
-                                                            p2.z() << std::endl;
-    stl_file << indent_level3 << "vertex " << std::fixed << p3.x() << delim <<
-                                                            p3.y() << delim <<
-                                                            p3.z() << std::endl;
-    stl_file << indent_level2 << "endloop" << std::endl;
-    stl_file << indent_level1 << "endfacet" << std::endl;
+    return false;
   }
-  stl_file << "endsolid" << std::endl;
+
+  stl_file << "endsolid\n";
 
   stl_file.close();
   
-  return true;
+  return !stl_file.fail();
 }
 
 // Binary STL format: https://en.wikipedia.org/wiki/STL_(file_format)
@@ -261,11 +555,6 @@ bool IsosurfaceExporter::ExportSTLBinary( const boost::filesystem::path& filenam
 {
   // 80 byte header, usually ignored
   const unsigned short STL_HEADER_LENGTH = 80;
-  // STL binary contains unsigned ints, floats
-  const unsigned short STL_FIELD_LENGTH = 4;
-  const unsigned short POINT_LEN = 3;
-  const unsigned short FIELD_LEN = 12;
-  const unsigned short ATTRIBUTE_BYTE_COUNT = 2;
 
   std::ofstream stl_file(filename.string().c_str(), std::ios::binary | std::ios::out);
   if ( ! stl_file.is_open() )
@@ -275,43 +564,22 @@ bool IsosurfaceExporter::ExportSTLBinary( const boost::filesystem::path& filenam
 
   std::string header("STL header: Seg3D isosurface to STL Binary export");
   header.resize(STL_HEADER_LENGTH);
-  char* headerBuffer = const_cast<char*>(header.c_str());
-  stl_file.write(headerBuffer, STL_HEADER_LENGTH);
-
-  unsigned int numTriangles = faces.size() / 3;
-  stl_file.write(reinterpret_cast<char*>(&numTriangles), STL_FIELD_LENGTH);
+  stl_file.write(header.data(), STL_HEADER_LENGTH);
 
-  // 0 is an acceptable value for this field
-  const unsigned short byteAttributeCount = 0;
+  // Little endian number of triangles followed by one 50 byte record per triangle
+  char num_triangles[ 4 ];
+  StoreLittleEndian( static_cast< unsigned int >( faces.size() / 3 ), num_triangles );
+  stl_file.write(num_triangles, 4);
 
-  for (size_t i = 0; i + 2 < faces.size(); i += 3)
+  ExportChunkWriter faces_writer( faces.size() / 3, ExportSTLBinaryFormat( points, faces ) );
+  if ( ! faces_writer.write( stl_file ) )
   {
-    size_t vertex_index1 = faces[i];
-    size_t vertex_index2 = faces[i + 1];
-    size_t vertex_index3 = faces[i + 2];
-
-    // Get vertices of face
-    if (vertex_index1 >= points.size() || vertex_index2 >= points.size() || vertex_index3 >= points.size())
-    {
-      throw("verticies are out of points bounds");
-    }
-
-    PointF p1 = points[vertex_index1];
-    PointF p2 = points[vertex_index2];
-    PointF p3 = points[vertex_index3];
-   
-    auto normal = computeFaceNormal(p1, p2, p3);
-    stl_file.write(reinterpret_cast<char*>(&normal[0]), FIELD_LEN);
-
-    stl_file.write(reinterpret_cast<char*>(&p1[0]), FIELD_LEN);
-    stl_file.write(reinterpret_cast<char*>(&p2[0]), FIELD_LEN);
-    stl_file.write(reinterpret_cast<char*>(&p3[0]), FIELD_LEN);
-
-    stl_file.write(reinterpret_cast<const char*>(&byteAttributeCount), ATTRIBUTE_BYTE_COUNT);
+    return false;
   }
+
   stl_file.close();
 
-  return true;
+  return !stl_file.fail();
 }
 
 }
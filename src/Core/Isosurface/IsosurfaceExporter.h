@@ -55,6 +55,11 @@ class IsosurfaceExporter
                               const UIntVector& faces
                             );
 
+  static bool ExportVTKBinary( const boost::filesystem::path& filename,
+                               const PointFVector& points,
+                               const UIntVector& faces
+                             );
+
   static bool ExportSTLASCII( const boost::filesystem::path& filename,
                               const std::string& name,
                               const PointFVector& points,
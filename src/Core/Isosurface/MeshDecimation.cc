@@ -0,0 +1,767 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+// Boost includes
+#include <boost/bind.hpp>
+
+// Core includes
+#include <Core/Geometry/Vector.h>
+#include <Core/Utils/ThreadPool.h>
+#include <Core/Isosurface/MeshDecimation.h>
+
+namespace Core
+{
+
+// Number of faces that are decimated together by one task
+static const double FACES_PER_CELL_C = 16384.0;
+
+// Upper bound on the number of cells in the grid
+static const double MAX_CELLS_C = 1048576.0;
+
+// Maximum number of passes over the grid
+static const int MAX_PASSES_C = 8;
+
+// Offset of the grid in each pass, in units of the cell size
+static const double PASS_SHIFT_C[] = { 0.0, 0.5, 0.25, 0.75 };
+
+// Marker for vertices that are not part of the current cell
+static const unsigned int NO_VERTEX_C = std::numeric_limits< unsigned int >::max();
+
+// CLASS MeshDecimationQuadric:
+/// Symmetric 4x4 matrix that sums the squared distances to a set of planes, stored as its
+/// upper triangle.
+class MeshDecimationQuadric
+{
+public:
+  MeshDecimationQuadric()
+  {
+    std::fill( this->q_, this->q_ + 10, 0.0 );
+  }
+
+  void add_plane( double a, double b, double c, double d )
+  {
+    this->q_[ 0 ] += a * a; this->q_[ 1 ] += a * b; this->q_[ 2 ] += a * c; 
+    this->q_[ 3 ] += a * d; this->q_[ 4 ] += b * b; this->q_[ 5 ] += b * c;
+    this->q_[ 6 ] += b * d; this->q_[ 7 ] += c * c; this->q_[ 8 ] += c * d;
+    this->q_[ 9 ] += d * d;
+  }
+
+  void add( const MeshDecimationQuadric& other )
+  {
+    for ( int j = 0; j < 10; j++ ) this->q_[ j ] += other.q_[ j ];
+  }
+
+  // ERROR:
+  /// Sum of the squared distances of p to the planes
+  double error( const Point& p ) const
+  {
+    const double* q = this->q_;
+    double x = p.x(), y = p.y(), z = p.z();
+    return x * ( q[ 0 ] * x + 2.0 * ( q[ 1 ] * y + q[ 2 ] * z + q[ 3 ] ) ) +
+      y * ( q[ 4 ] * y + 2.0 * ( q[ 5 ] * z + q[ 6 ] ) ) + 
+      z * ( q[ 7 ] * z + 2.0 * q[ 8 ] ) + q[ 9 ];
+  }
+
+  // OPTIMIZE:
+  /// Find the point with the smallest error, returns false if it is not well defined
+  bool optimize( Point& p ) const
+  {
+    const double* q = this->q_;
+    double det = q[ 0 ] * ( q[ 4 ] * q[ 7 ] - q[ 5 ] * q[ 5 ] ) - 
+      q[ 1 ] * ( q[ 1 ] * q[ 7 ] - q[ 5 ] * q[ 2 ] ) + 
+      q[ 2 ] * ( q[ 1 ] * q[ 5 ] - q[ 4 ] * q[ 2 ] );
+    double scale = std::max( q[ 0 ], std::max( q[ 4 ], q[ 7 ] ) );
+    if ( scale <= 0.0 || std::abs( det ) < 1e-10 * scale * scale * scale ) return false;
+
+    // Solve A p = -b with Cramer's rule
+    double bx = -q[ 3 ], by = -q[ 6 ], bz = -q[ 8 ];
+    p = Point( 
+      ( bx * ( q[ 4 ] * q[ 7 ] - q[ 5 ] * q[ 5 ] ) - q[ 1 ] * ( by * q[ 7 ] - q[ 5 ] * bz ) +
+        q[ 2 ] * ( by * q[ 5 ] - q[ 4 ] * bz ) ) / det,
+      ( q[ 0 ] * ( by * q[ 7 ] - bz * q[ 5 ] ) - bx * ( q[ 1 ] * q[ 7 ] - q[ 5 ] * q[ 2 ] ) +
+        q[ 2 ] * ( q[ 1 ] * bz - by * q[ 2 ] ) ) / det,
+      ( q[ 0 ] * ( q[ 4 ] * bz - q[ 5 ] * by ) - q[ 1 ] * ( q[ 1 ] * bz - by * q[ 2 ] ) +
+        bx * ( q[ 1 ] * q[ 5 ] - q[ 4 ] * q[ 2 ] ) ) / det );
+    return true;
+  }
+
+private:
+  double q_[ 10 ];
+};
+
+// CLASS MeshDecimationCandidate:
+/// An edge collapse that removes vertex u_ and moves vertex v_ to position_. The stamps tell
+/// whether the vertices have changed since the candidate was made.
+class MeshDecimationCandidate
+{
+public:
+  double cost_;
+  unsigned int u_;
+  unsigned int v_;
+  unsigned int u_stamp_;
+  unsigned int v_stamp_;
+  Point position_;
+
+  // Reversed, so the priority queue returns the cheapest candidate first
+  bool operator<( const MeshDecimationCandidate& other ) const
+  {
+    return this->cost_ > other.cost_;
+  }
+};
+
+// CLASS MeshDecimationCell:
+/// The state of one cell while it is being decimated. Vertices are numbered locally.
+class MeshDecimationCell
+{
+public:
+  /// Global index of each vertex
+  std::vector< unsigned int > vertices_;
+  /// Faces around each vertex
+  std::vector< std::vector< unsigned int > > vertex_faces_;
+  /// Whether the vertex lies on a border or non-manifold edge and cannot move
+  std::vector< unsigned char > fixed_;
+  /// Whether the vertex was removed by a collapse
+  std::vector< unsigned char > removed_;
+  /// Number of times the vertex has changed
+  std::vector< unsigned int > stamps_;
+  /// Collapses that can still be done
+  std::priority_queue< MeshDecimationCandidate > candidates_;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Class MeshDecimationPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class MeshDecimationPrivate
+{
+public:
+  // COMPUTE_QUADRICS:
+  /// Sum the planes of the faces around each vertex
+  void compute_quadrics();
+
+  // SETUP_CELLS:
+  /// Sort the faces into the cells of the grid of the given pass, returns the number of
+  /// faces that lie within a cell
+  size_t setup_cells( int pass );
+
+  // DECIMATE_CELLS:
+  /// Decimate the cells with the given indices in non_empty_cells_
+  void decimate_cells( size_t begin, size_t end );
+
+  // DECIMATE_CELL:
+  /// Collapse edges in one cell until the budget has been used, returns the number of faces
+  /// that were removed
+  size_t decimate_cell( size_t cell );
+
+  // PUSH_CANDIDATE:
+  /// Add the collapse of the edge between the local vertices a and b to the candidates of
+  /// the cell, if it is allowed and within the maximum error
+  void push_candidate( MeshDecimationCell& cell, unsigned int a, unsigned int b );
+
+  // FACE_NORMAL:
+  /// Unnormalized normal of a face, with vertex replaced by the point p
+  Vector face_normal( unsigned int face, unsigned int vertex, const Point& p ) const;
+
+  // Parameters
+  size_t target_faces_;
+  double max_error_;
+  double max_cost_;
+  boost::function< void ( double ) > progress_;
+  boost::function< bool () > check_abort_;
+
+  // The mesh
+  std::vector< PointF >* points_;
+  std::vector< unsigned int >* faces_;
+  std::vector< unsigned char > face_alive_;
+  size_t num_alive_faces_;
+  std::vector< MeshDecimationQuadric > quadrics_;
+
+  // The grid
+  Point origin_;
+  double cell_size_;
+  size_t grid_dims_[ 3 ];
+  double budget_fraction_;
+
+  // Per vertex: its cell in this pass, whether all of its faces lie within that cell, and its
+  // index within the cell while the cell is decimated
+  std::vector< unsigned int > vertex_cell_;
+  std::vector< unsigned char > vertex_free_;
+  std::vector< unsigned int > vertex_local_;
+
+  // Faces of each cell, stored consecutively
+  std::vector< size_t > cell_offsets_;
+  std::vector< unsigned int > cell_faces_;
+  std::vector< size_t > non_empty_cells_;
+  std::vector< size_t > removed_faces_;
+};
+
+void MeshDecimationPrivate::compute_quadrics()
+{
+  const std::vector< PointF >& points = *this->points_;
+  const std::vector< unsigned int >& faces = *this->faces_;
+  this->quadrics_.assign( points.size(), MeshDecimationQuadric() );
+
+  size_t num_faces = faces.size() / 3;
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    const unsigned int* face = &faces[ 3 * j ];
+    Point p0( points[ face[ 0 ] ] );
+    Vector normal = Cross( Point( points[ face[ 1 ] ] ) - p0, Point( points[ face[ 2 ] ] ) - p0 );
+    if ( normal.normalize() == 0.0 ) continue;
+
+    double d = -Dot( normal, p0 );
+    for ( int k = 0; k < 3; k++ )
+    {
+      this->quadrics_[ face[ k ] ].add_plane( normal.x(), normal.y(), normal.z(), d );
+    }
+  }
+}
+
+size_t MeshDecimationPrivate::setup_cells( int pass )
+{
+  const std::vector< PointF >& points = *this->points_;
+  const std::vector< unsigned int >& faces = *this->faces_;
+  size_t num_faces = faces.size() / 3;
+  size_t num_cells = this->grid_dims_[ 0 ] * this->grid_dims_[ 1 ] * this->grid_dims_[ 2 ];
+
+  // Shift the grid in each pass, so faces that crossed a border can be decimated later
+  double shift = ( PASS_SHIFT_C[ pass % 4 ] - 1.0 ) * this->cell_size_;
+  Point origin = this->origin_ + Vector( shift, shift, shift );
+
+  this->vertex_cell_.assign( points.size(), 0 );
+  this->vertex_free_.assign( points.size(), 1 );
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    if ( !this->face_alive_[ j ] ) continue;
+    for ( int k = 0; k < 3; k++ )
+    {
+      unsigned int vertex = faces[ 3 * j + k ];
+      Vector offset = Point( points[ vertex ] ) - origin;
+      size_t cell = 0;
+      for ( int d = 2; d >= 0; d-- )
+      {
+        double coord = std::floor( offset[ d ] / this->cell_size_ );
+        size_t index = coord <= 0.0 ? 0 : static_cast< size_t >( coord );
+        cell = cell * this->grid_dims_[ d ] + std::min( index, this->grid_dims_[ d ] - 1 );
+      }
+      this->vertex_cell_[ vertex ] = static_cast< unsigned int >( cell );
+    }
+  }
+
+  // Count the faces that lie within a cell, the vertices of the other faces cannot be moved
+  this->cell_offsets_.assign( num_cells + 1, 0 );
+  size_t cell_face_count = 0;
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    if ( !this->face_alive_[ j ] ) continue;
+    const unsigned int* face = &faces[ 3 * j ];
+    unsigned int cell = this->vertex_cell_[ face[ 0 ] ];
+    if ( this->vertex_cell_[ face[ 1 ] ] == cell && this->vertex_cell_[ face[ 2 ] ] == cell )
+    {
+      this->cell_offsets_[ cell + 1 ]++;
+      cell_face_count++;
+    }
+    else
+    {
+      for ( int k = 0; k < 3; k++ ) this->vertex_free_[ face[ k ] ] = 0;
+    }
+  }
+
+  this->non_empty_cells_.clear();
+  for ( size_t j = 0; j < num_cells; j++ )
+  {
+    if ( this->cell_offsets_[ j + 1 ] > 0 ) this->non_empty_cells_.push_back( j );
+    this->cell_offsets_[ j + 1 ] += this->cell_offsets_[ j ];
+  }
+
+  this->cell_faces_.resize( cell_face_count );
+  std::vector< size_t > fill( this->cell_offsets_.begin(), this->cell_offsets_.end() - 1 );
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    if ( !this->face_alive_[ j ] ) continue;
+    const unsigned int* face = &faces[ 3 * j ];
+    unsigned int cell = this->vertex_cell_[ face[ 0 ] ];
+    if ( this->vertex_cell_[ face[ 1 ] ] == cell && this->vertex_cell_[ face[ 2 ] ] == cell )
+    {
+      this->cell_faces_[ fill[ cell ]++ ] = static_cast< unsigned int >( j );
+    }
+  }
+
+  this->removed_faces_.assign( this->non_empty_cells_.size(), 0 );
+  return cell_face_count;
+}
+
+void MeshDecimationPrivate::decimate_cells( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    this->removed_faces_[ j ] = this->decimate_cell( this->non_empty_cells_[ j ] );
+  }
+}
+
+Vector MeshDecimationPrivate::face_normal( unsigned int face, unsigned int vertex, 
+  const Point& p ) const
+{
+  const std::vector< PointF >& points = *this->points_;
+  const unsigned int* indices = &( *this->faces_ )[ 3 * face ];
+  Point corners[ 3 ];
+  for ( int k = 0; k < 3; k++ )
+  {
+    corners[ k ] = indices[ k ] == vertex ? p : Point( points[ indices[ k ] ] );
+  }
+  return Cross( corners[ 1 ] - corners[ 0 ], corners[ 2 ] - corners[ 0 ] );
+}
+
+void MeshDecimationPrivate::push_candidate( MeshDecimationCell& cell, unsigned int a, 
+  unsigned int b )
+{
+  const std::vector< PointF >& points = *this->points_;
+  unsigned int ga = cell.vertices_[ a ], gb = cell.vertices_[ b ];
+  if ( !this->vertex_free_[ ga ] || !this->vertex_free_[ gb ] ) return;
+  if ( cell.fixed_[ a ] && cell.fixed_[ b ] ) return;
+
+  MeshDecimationQuadric quadric = this->quadrics_[ ga ];
+  quadric.add( this->quadrics_[ gb ] );
+
+  MeshDecimationCandidate candidate;
+  if ( cell.fixed_[ a ] ) std::swap( a, b );
+  candidate.u_ = a;
+  candidate.v_ = b;
+  Point pa( points[ cell.vertices_[ a ] ] );
+  Point pb( points[ cell.vertices_[ b ] ] );
+
+  if ( cell.fixed_[ b ] )
+  {
+    candidate.position_ = pb;
+    candidate.cost_ = quadric.error( pb );
+  }
+  else
+  {
+    // Use the optimal position if it is near the edge, otherwise the best of the end
+    // points and the middle of the edge
+    Point p;
+    Point middle( ( pa + pb ) * 0.5 );
+    if ( quadric.optimize( p ) && ( p - middle ).length2() <= ( pb - pa ).length2() )
+    {
+      candidate.position_ = p;
+      candidate.cost_ = quadric.error( p );
+    }
+    else
+    {
+      candidate.position_ = middle;
+      candidate.cost_ = quadric.error( middle );
+      double cost = quadric.error( pa );
+      if ( cost < candidate.cost_ ) { candidate.position_ = pa; candidate.cost_ = cost; }
+      cost = quadric.error( pb );
+      if ( cost < candidate.cost_ ) { candidate.position_ = pb; candidate.cost_ = cost; }
+    }
+  }
+
+  if ( candidate.cost_ > this->max_cost_ ) return;
+
+  // Round to the precision of the mesh, so the checks see the final position
+  candidate.position_ = Point( PointF( candidate.position_ ) );
+  candidate.u_stamp_ = cell.stamps_[ candidate.u_ ];
+  candidate.v_stamp_ = cell.stamps_[ candidate.v_ ];
+  cell.candidates_.push( candidate );
+}
+
+// Collect the vertices that share a face with vertex, sorted and with duplicates
+static void GetNeighbors( const std::vector< unsigned int >& faces, 
+  const std::vector< unsigned int >& vertex_faces, unsigned int vertex, 
+  std::vector< unsigned int >& neighbors )
+{
+  neighbors.clear();
+  for ( size_t j = 0; j < vertex_faces.size(); j++ )
+  {
+    const unsigned int* face = &faces[ 3 * vertex_faces[ j ] ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      if ( face[ k ] != vertex ) neighbors.push_back( face[ k ] );
+    }
+  }
+  std::sort( neighbors.begin(), neighbors.end() );
+}
+
+size_t MeshDecimationPrivate::decimate_cell( size_t cell_index )
+{
+  std::vector< PointF >& points = *this->points_;
+  std::vector< unsigned int >& faces = *this->faces_;
+  const unsigned int* cell_faces = &this->cell_faces_[ this->cell_offsets_[ cell_index ] ];
+  size_t num_cell_faces = this->cell_offsets_[ cell_index + 1 ] - 
+    this->cell_offsets_[ cell_index ];
+
+  size_t budget = std::numeric_limits< size_t >::max();
+  if ( this->target_faces_ > 0 )
+  {
+    budget = static_cast< size_t >( std::ceil( num_cell_faces * this->budget_fraction_ ) );
+    if ( budget == 0 ) return 0;
+  }
+
+  // Number the vertices of the cell and collect the faces around each of them
+  MeshDecimationCell cell;
+  for ( size_t j = 0; j < num_cell_faces; j++ )
+  {
+    const unsigned int* face = &faces[ 3 * cell_faces[ j ] ];
+    bool degenerate = face[ 0 ] == face[ 1 ] || face[ 1 ] == face[ 2 ] || face[ 0 ] == face[ 2 ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      unsigned int& local = this->vertex_local_[ face[ k ] ];
+      if ( local == NO_VERTEX_C )
+      {
+        local = static_cast< unsigned int >( cell.vertices_.size() );
+        cell.vertices_.push_back( face[ k ] );
+        cell.vertex_faces_.push_back( std::vector< unsigned int >() );
+        cell.fixed_.push_back( 0 );
+      }
+      cell.vertex_faces_[ local ].push_back( cell_faces[ j ] );
+      if ( degenerate ) cell.fixed_[ local ] = 1;
+    }
+  }
+
+  // Vertices on an open border or on an edge with more than two faces never move
+  size_t num_vertices = cell.vertices_.size();
+  std::vector< unsigned int > neighbors;
+  std::vector< unsigned int > other_neighbors;
+  for ( size_t j = 0; j < num_vertices; j++ )
+  {
+    if ( cell.fixed_[ j ] || !this->vertex_free_[ cell.vertices_[ j ] ] ) continue;
+    GetNeighbors( faces, cell.vertex_faces_[ j ], cell.vertices_[ j ], neighbors );
+    for ( size_t k = 0; k < neighbors.size(); k += 2 )
+    {
+      if ( k + 1 >= neighbors.size() || neighbors[ k ] != neighbors[ k + 1 ] ||
+        ( k + 2 < neighbors.size() && neighbors[ k + 2 ] == neighbors[ k ] ) )
+      {
+        cell.fixed_[ j ] = 1;
+        break;
+      }
+    }
+  }
+  cell.stamps_.assign( num_vertices, 0 );
+  cell.removed_.assign( num_vertices, 0 );
+
+  // Edges between two faces appear once in each direction, so each is added once. Border
+  // edges are not needed as both of their ends are fixed.
+  for ( size_t j = 0; j < num_cell_faces; j++ )
+  {
+    const unsigned int* face = &faces[ 3 * cell_faces[ j ] ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      unsigned int a = face[ k ], b = face[ ( k + 1 ) % 3 ];
+      if ( a < b )
+      {
+        this->push_candidate( cell, this->vertex_local_[ a ], this->vertex_local_[ b ] );
+      }
+    }
+  }
+
+  size_t removed_faces = 0;
+  std::vector< unsigned int > shared_faces;
+  while ( removed_faces < budget && !cell.candidates_.empty() )
+  {
+    MeshDecimationCandidate candidate = cell.candidates_.top();
+    cell.candidates_.pop();
+    unsigned int u = candidate.u_, v = candidate.v_;
+    if ( cell.removed_[ u ] || cell.removed_[ v ] || cell.stamps_[ u ] != candidate.u_stamp_ ||
+      cell.stamps_[ v ] != candidate.v_stamp_ ) continue;
+    unsigned int gu = cell.vertices_[ u ], gv = cell.vertices_[ v ];
+    std::vector< unsigned int >& u_faces = cell.vertex_faces_[ u ];
+    std::vector< unsigned int >& v_faces = cell.vertex_faces_[ v ];
+
+    // The edge needs exactly two faces, and the vertices may not share other neighbors, or
+    // the collapse would change the topology of the mesh
+    shared_faces.clear();
+    for ( size_t j = 0; j < u_faces.size(); j++ )
+    {
+      const unsigned int* face = &faces[ 3 * u_faces[ j ] ];
+      if ( face[ 0 ] == gv || face[ 1 ] == gv || face[ 2 ] == gv ) 
+      {
+        shared_faces.push_back( u_faces[ j ] );
+      }
+    }
+    if ( shared_faces.size() != 2 ) continue;
+
+    GetNeighbors( faces, u_faces, gu, neighbors );
+    neighbors.erase( std::unique( neighbors.begin(), neighbors.end() ), neighbors.end() );
+    GetNeighbors( faces, v_faces, gv, other_neighbors );
+    other_neighbors.erase( std::unique( other_neighbors.begin(), other_neighbors.end() ), 
+      other_neighbors.end() );
+    size_t common = 0;
+    for ( size_t j = 0, k = 0; j < neighbors.size() && k < other_neighbors.size(); )
+    {
+      if ( neighbors[ j ] < other_neighbors[ k ] ) j++;
+      else if ( neighbors[ j ] > other_neighbors[ k ] ) k++;
+      else { common++; j++; k++; }
+    }
+    if ( common != 2 || neighbors.size() + other_neighbors.size() - common < 5 ) continue;
+
+    // No face may flip or become degenerate
+    bool flipped = false;
+    for ( int side = 0; side < 2 && !flipped; side++ )
+    {
+      unsigned int vertex = side == 0 ? gu : gv;
+      const std::vector< unsigned int >& vertex_faces = side == 0 ? u_faces : v_faces;
+      Point old_position( points[ vertex ] );
+      for ( size_t j = 0; j < vertex_faces.size() && !flipped; j++ )
+      {
+        unsigned int face = vertex_faces[ j ];
+        if ( face == shared_faces[ 0 ] || face == shared_faces[ 1 ] ) continue;
+        Vector old_normal = this->face_normal( face, vertex, old_position );
+        Vector new_normal = this->face_normal( face, vertex, candidate.position_ );
+        flipped = Dot( old_normal, new_normal ) <= 0.0;
+      }
+    }
+    if ( flipped ) continue;
+
+    // Remove the faces of the edge
+    for ( size_t j = 0; j < 2; j++ )
+    {
+      unsigned int face = shared_faces[ j ];
+      this->face_alive_[ face ] = 0;
+      for ( int k = 0; k < 3; k++ )
+      {
+        std::vector< unsigned int >& list = 
+          cell.vertex_faces_[ this->vertex_local_[ faces[ 3 * face + k ] ] ];
+        list.erase( std::find( list.begin(), list.end(), face ) );
+      }
+    }
+
+    // Move the remaining faces of u over to v
+    for ( size_t j = 0; j < u_faces.size(); j++ )
+    {
+      unsigned int face = u_faces[ j ];
+      for ( int k = 0; k < 3; k++ )
+      {
+        if ( faces[ 3 * face + k ] == gu ) faces[ 3 * face + k ] = gv;
+      }
+      v_faces.push_back( face );
+    }
+    std::vector< unsigned int >().swap( u_faces );
+    cell.removed_[ u ] = 1;
+
+    points[ gv ] = PointF( candidate.position_ );
+    this->quadrics_[ gv ].add( this->quadrics_[ gu ] );
+    cell.stamps_[ v ]++;
+    removed_faces += 2;
+
+    GetNeighbors( faces, v_faces, gv, neighbors );
+    neighbors.erase( std::unique( neighbors.begin(), neighbors.end() ), neighbors.end() );
+    for ( size_t j = 0; j < neighbors.size(); j++ )
+    {
+      this->push_candidate( cell, v, this->vertex_local_[ neighbors[ j ] ] );
+    }
+  }
+
+  for ( size_t j = 0; j < num_vertices; j++ )
+  {
+    this->vertex_local_[ cell.vertices_[ j ] ] = NO_VERTEX_C;
+  }
+
+  return removed_faces;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class MeshDecimation
+//////////////////////////////////////////////////////////////////////////
+
+MeshDecimation::MeshDecimation() :
+  private_( new MeshDecimationPrivate )
+{
+  this->private_->target_faces_ = 0;
+  this->private_->max_error_ = 0.0;
+  this->private_->max_cost_ = 0.0;
+  this->private_->points_ = 0;
+  this->private_->faces_ = 0;
+  this->private_->num_alive_faces_ = 0;
+  this->private_->cell_size_ = 1.0;
+  this->private_->budget_fraction_ = 1.0;
+}
+
+MeshDecimation::~MeshDecimation()
+{
+}
+
+void MeshDecimation::set_target_faces( size_t target_faces )
+{
+  this->private_->target_faces_ = target_faces;
+}
+
+void MeshDecimation::set_max_error( double max_error )
+{
+  this->private_->max_error_ = max_error;
+}
+
+void MeshDecimation::set_progress_function( boost::function< void ( double ) > progress )
+{
+  this->private_->progress_ = progress;
+}
+
+void MeshDecimation::set_abort_function( boost::function< bool () > check_abort )
+{
+  this->private_->check_abort_ = check_abort;
+}
+
+bool MeshDecimation::run( std::vector< PointF >& points, std::vector< unsigned int >& faces )
+{
+  MeshDecimationPrivate* p = this->private_.get();
+  size_t num_faces = faces.size() / 3;
+  if ( num_faces == 0 || ( p->target_faces_ == 0 && p->max_error_ <= 0.0 ) ) return true;
+  if ( p->target_faces_ >= num_faces ) return true;
+
+  p->points_ = &points;
+  p->faces_ = &faces;
+  p->face_alive_.assign( num_faces, 1 );
+  p->num_alive_faces_ = num_faces;
+  p->vertex_local_.assign( points.size(), NO_VERTEX_C );
+  p->max_cost_ = p->max_error_ > 0.0 ? p->max_error_ * p->max_error_ :
+    std::numeric_limits< double >::max();
+  p->compute_quadrics();
+
+  // Size the cells so each holds about FACES_PER_CELL_C faces
+  Point min( points[ faces[ 0 ] ] ), max( min );
+  double area = 0.0;
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    Point p0( points[ faces[ 3 * j ] ] );
+    Point p1( points[ faces[ 3 * j + 1 ] ] );
+    Point p2( points[ faces[ 3 * j + 2 ] ] );
+    area += 0.5 * Cross( p1 - p0, p2 - p0 ).length();
+    min = Min( min, Min( p0, Min( p1, p2 ) ) );
+    max = Max( max, Max( p0, Max( p1, p2 ) ) );
+  }
+
+  Vector extent = max - min;
+  double cell_size = std::sqrt( FACES_PER_CELL_C * area / num_faces );
+  double max_extent = std::max( extent.x(), std::max( extent.y(), extent.z() ) );
+  if ( !( cell_size > 0.0 ) ) cell_size = max_extent > 0.0 ? max_extent : 1.0;
+  for ( ;; )
+  {
+    double num_cells = 1.0;
+    for ( int d = 0; d < 3; d++ )
+    {
+      p->grid_dims_[ d ] = static_cast< size_t >( extent[ d ] / cell_size ) + 2;
+      num_cells *= static_cast< double >( p->grid_dims_[ d ] );
+    }
+    if ( num_cells <= MAX_CELLS_C ) break;
+    cell_size *= 2.0;
+  }
+  p->cell_size_ = cell_size;
+  p->origin_ = min;
+
+  bool completed = true;
+  for ( int pass = 0; pass < MAX_PASSES_C; pass++ )
+  {
+    if ( p->target_faces_ > 0 && p->num_alive_faces_ <= p->target_faces_ ) break;
+    if ( p->check_abort_ && p->check_abort_() )
+    {
+      completed = false;
+      break;
+    }
+
+    size_t cell_face_count = p->setup_cells( pass );
+    if ( cell_face_count == 0 ) break;
+    if ( p->target_faces_ > 0 )
+    {
+      p->budget_fraction_ = static_cast< double >( p->num_alive_faces_ - p->target_faces_ ) / 
+        static_cast< double >( p->num_alive_faces_ );
+    }
+
+    ThreadPool::Instance()->parallel_for( 0, p->non_empty_cells_.size(), 1, 
+      boost::bind( &MeshDecimationPrivate::decimate_cells, p, _1, _2 ) );
+
+    size_t removed_faces = 0;
+    for ( size_t j = 0; j < p->removed_faces_.size(); j++ ) 
+    {
+      removed_faces += p->removed_faces_[ j ];
+    }
+    size_t alive_faces = p->num_alive_faces_;
+    p->num_alive_faces_ -= removed_faces;
+
+    if ( p->progress_ )
+    {
+      if ( p->target_faces_ > 0 )
+      {
+        p->progress_( std::min( 1.0, static_cast< double >( num_faces - p->num_alive_faces_ ) /
+          static_cast< double >( num_faces - p->target_faces_ ) ) );
+      }
+      else
+      {
+        p->progress_( static_cast< double >( pass + 1 ) / MAX_PASSES_C );
+      }
+    }
+
+    // Stop when a pass hardly changes the mesh
+    if ( removed_faces * 1000 < alive_faces ) break;
+  }
+
+  // Remove the faces that were collapsed and the points that are no longer used
+  std::vector< unsigned int > point_map( points.size(), NO_VERTEX_C );
+  size_t num_alive = 0;
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    if ( !p->face_alive_[ j ] ) continue;
+    for ( int k = 0; k < 3; k++ )
+    {
+      faces[ 3 * num_alive + k ] = faces[ 3 * j + k ];
+      point_map[ faces[ 3 * j + k ] ] = 0;
+    }
+    num_alive++;
+  }
+  faces.resize( 3 * num_alive );
+
+  size_t num_points = 0;
+  for ( size_t j = 0; j < points.size(); j++ )
+  {
+    if ( point_map[ j ] == NO_VERTEX_C ) continue;
+    point_map[ j ] = static_cast< unsigned int >( num_points );
+    points[ num_points++ ] = points[ j ];
+  }
+  points.resize( num_points );
+  for ( size_t j = 0; j < faces.size(); j++ ) faces[ j ] = point_map[ faces[ j ] ];
+
+  // Release the work space
+  std::vector< unsigned char >().swap( p->face_alive_ );
+  std::vector< MeshDecimationQuadric >().swap( p->quadrics_ );
+  std::vector< unsigned int >().swap( p->vertex_cell_ );
+  std::vector< unsigned char >().swap( p->vertex_free_ );
+  std::vector< unsigned int >().swap( p->vertex_local_ );
+  std::vector< size_t >().swap( p->cell_offsets_ );
+  std::vector< unsigned int >().swap( p->cell_faces_ );
+  p->points_ = 0;
+  p->faces_ = 0;
+
+  return completed;
+}
+
+} // end namespace Core
@@ -0,0 +1,95 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CORE_ISOSURFACE_MESHDECIMATION_H
+#define CORE_ISOSURFACE_MESHDECIMATION_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// STL includes
+#include <vector>
+
+// Boost includes
+#include <boost/function.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/Geometry/Point.h>
+
+namespace Core
+{
+
+class MeshDecimation;
+class MeshDecimationPrivate;
+typedef boost::shared_ptr< MeshDecimationPrivate > MeshDecimationPrivateHandle;
+
+// CLASS MeshDecimation:
+/// Simplification of triangle meshes by collapsing edges in the order of their quadric error
+/// (Garland and Heckbert, 1997). The bounding box of the mesh is split into cells that are
+/// decimated in parallel. Faces that cross the border of a cell are left alone until a later
+/// pass, in which the cells are shifted. Vertices on open borders and on edges that are shared
+/// by more than two faces never move, and no collapse flips a face or changes the topology.
+class MeshDecimation : public boost::noncopyable
+{
+public:
+  MeshDecimation();
+  ~MeshDecimation();
+
+  // SET_TARGET_FACES:
+  /// Stop when the mesh has this number of faces, 0 means no limit.
+  void set_target_faces( size_t target_faces );
+
+  // SET_MAX_ERROR:
+  /// Only collapse edges when the new vertex is within about max_error of the planes of the
+  /// original faces around it, 0 means no limit.
+  void set_max_error( double max_error );
+
+  // SET_PROGRESS_FUNCTION:
+  /// Function that is called with the fraction of the work that has been done.
+  void set_progress_function( boost::function< void ( double ) > progress );
+
+  // SET_ABORT_FUNCTION:
+  /// Function that is called in between passes, run stops if it returns true.
+  void set_abort_function( boost::function< bool () > check_abort );
+
+  // RUN:
+  /// Decimate the mesh in place, faces holds three indices into points per face. Unused
+  /// points are removed, the remaining points and faces keep their order. Returns false if
+  /// the run was aborted, the mesh is then only partially decimated.
+  bool run( std::vector< PointF >& points, std::vector< unsigned int >& faces );
+
+private:
+  MeshDecimationPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Isosurface/Isosurface.h>
+#include <Core/Volume/MaskVolume.h>
+
+#include <Testing/Utils/FilesystemPaths.h>
+
+using namespace Core;
+using namespace Testing::Utils;
+
+namespace
+{
+
+std::string ReadFile( const boost::filesystem::path& filename )
+{
+  std::ifstream file( filename.string().c_str(), std::ios::binary );
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+unsigned int LoadLittleEndian( const char* src )
+{
+  const unsigned char* bytes = reinterpret_cast< const unsigned char* >( src );
+  return static_cast< unsigned int >( bytes[ 0 ] ) | 
+    ( static_cast< unsigned int >( bytes[ 1 ] ) << 8 ) |
+    ( static_cast< unsigned int >( bytes[ 2 ] ) << 16 ) | 
+    ( static_cast< unsigned int >( bytes[ 3 ] ) << 24 );
+}
+
+unsigned int LoadBigEndian( const char* src )
+{
+  const unsigned char* bytes = reinterpret_cast< const unsigned char* >( src );
+  return ( static_cast< unsigned int >( bytes[ 0 ] ) << 24 ) | 
+    ( static_cast< unsigned int >( bytes[ 1 ] ) << 16 ) |
+    ( static_cast< unsigned int >( bytes[ 2 ] ) << 8 ) | 
+    static_cast< unsigned int >( bytes[ 3 ] );
+}
+
+float BitsToFloat( unsigned int bits )
+{
+  float value;
+  std::memcpy( &value, &bits, sizeof( value ) );
+  return value;
+}
+
+// Whether the normal points the same way as the normal of the face
+bool SameOrientation( const VectorF& normal, const PointF& p1, const PointF& p2, 
+  const PointF& p3 )
+{
+  return Dot( normal, Cross( p2 - p1, p3 - p1 ) ) > 0.0f;
+}
+
+bool NeverAbort()
+{
+  return false;
+}
+
+// Computes the isosurface of a solid torus. The surface has more faces than the exporters
+// put in one chunk, so the chunks need to be written in order.
+class IsosurfaceExportTest : public ::testing::Test 
+{
+protected:
+  virtual void SetUp()
+  {
+    const size_t nx = 144, ny = 144, nz = 44;
+    MaskVolumeHandle mask_volume;
+    ASSERT_TRUE( MaskVolume::CreateEmptyMask( GridTransform( nx, ny, nz ), mask_volume ) );
+    MaskDataBlockHandle mask_data_block = mask_volume->get_mask_data_block();
+    for ( size_t z = 0; z < nz; z++ )
+    {
+      for ( size_t y = 0; y < ny; y++ )
+      {
+        for ( size_t x = 0; x < nx; x++ )
+        {
+          double dx = x - 0.5 * nx, dy = y - 0.5 * ny, dz = z - 0.5 * nz;
+          double radius = std::sqrt( dx * dx + dy * dy ) - 45.0;
+          if ( radius * radius + dz * dz < 18.0 * 18.0 ) mask_data_block->set_mask_at( x, y, z );
+        }
+      }
+    }
+
+    isosurface_.reset( new Isosurface( mask_volume ) );
+    isosurface_->compute( 1.0, false, &NeverAbort );
+    points_ = isosurface_->get_points();
+    faces_ = isosurface_->get_faces();
+
+    export_dir_ = testOutputDir() / "isosurface_export";
+    boost::filesystem::create_directories( export_dir_ );
+  }
+
+  virtual void TearDown()
+  {
+    isosurface_.reset();
+    MaskDataBlockManager::Instance()->clear();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( export_dir_, ec );
+  }
+
+  IsosurfaceHandle isosurface_;
+  PointFVector points_;
+  UIntVector faces_;
+  boost::filesystem::path export_dir_;
+};
+
+} // end anonymous namespace
+
+TEST_F( IsosurfaceExportTest, SurfaceSpansSeveralChunks )
+{
+  EXPECT_GT( faces_.size() / 3, 65536u );
+}
+
+TEST_F( IsosurfaceExportTest, STLASCIIRoundTrip )
+{
+  boost::filesystem::path filename = export_dir_ / "torus.stl";
+  ASSERT_TRUE( isosurface_->export_stl_ascii_isosurface( filename, "torus" ) );
+
+  std::ifstream file( filename.string().c_str() );
+  std::string keyword, name;
+  file >> keyword >> name;
+  EXPECT_EQ( "solid", keyword );
+  EXPECT_EQ( "torus", name );
+
+  // The coordinates are written with six decimals
+  size_t num_faces = faces_.size() / 3;
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    std::string facet, normal_keyword, outer, loop;
+    float nx, ny, nz;
+    file >> facet >> normal_keyword >> nx >> ny >> nz >> outer >> loop;
+    ASSERT_EQ( "facet", facet ) << "face " << j;
+    ASSERT_EQ( "loop", loop ) << "face " << j;
+
+    PointF vertices[ 3 ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      std::string vertex;
+      float x, y, z;
+      file >> vertex >> x >> y >> z;
+      ASSERT_EQ( "vertex", vertex ) << "face " << j;
+      vertices[ k ] = PointF( x, y, z );
+
+      const PointF& point = points_[ faces_[ 3 * j + k ] ];
+      ASSERT_NEAR( point.x(), x, 1e-5 ) << "face " << j;
+      ASSERT_NEAR( point.y(), y, 1e-5 ) << "face " << j;
+      ASSERT_NEAR( point.z(), z, 1e-5 ) << "face " << j;
+    }
+    EXPECT_TRUE( SameOrientation( VectorF( nx, ny, nz ), vertices[ 0 ], vertices[ 1 ], 
+      vertices[ 2 ] ) ) << "face " << j;
+
+    std::string endloop, endfacet;
+    file >> endloop >> endfacet;
+    ASSERT_EQ( "endloop", endloop ) << "face " << j;
+    ASSERT_EQ( "endfacet", endfacet ) << "face " << j;
+  }
+
+  file >> keyword;
+  EXPECT_EQ( "endsolid", keyword );
+}
+
+TEST_F( IsosurfaceExportTest, STLBinaryRoundTrip )
+{
+  boost::filesystem::path filename = export_dir_ / "torus_binary.stl";
+  ASSERT_TRUE( isosurface_->export_stl_binary_isosurface( filename, "torus" ) );
+
+  // An 80 byte header, the number of faces and a 50 byte record per face
+  std::string contents = ReadFile( filename );
+  size_t num_faces = faces_.size() / 3;
+  ASSERT_EQ( 84 + 50 * num_faces, contents.size() );
+  EXPECT_EQ( num_faces, LoadLittleEndian( &contents[ 80 ] ) );
+
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    const char* record = &contents[ 84 + 50 * j ];
+    float values[ 12 ];
+    for ( int k = 0; k < 12; k++ ) values[ k ] = BitsToFloat( LoadLittleEndian( record + 4 * k ) );
+
+    for ( int k = 0; k < 3; k++ )
+    {
+      const PointF& point = points_[ faces_[ 3 * j + k ] ];
+      ASSERT_EQ( point.x(), values[ 3 + 3 * k ] ) << "face " << j;
+      ASSERT_EQ( point.y(), values[ 4 + 3 * k ] ) << "face " << j;
+      ASSERT_EQ( point.z(), values[ 5 + 3 * k ] ) << "face " << j;
+    }
+    EXPECT_TRUE( SameOrientation( VectorF( values[ 0 ], values[ 1 ], values[ 2 ] ), 
+      points_[ faces_[ 3 * j ] ], points_[ faces_[ 3 * j + 1 ] ], 
+      points_[ faces_[ 3 * j + 2 ] ] ) ) << "face " << j;
+    EXPECT_EQ( 0, record[ 48 ] );
+    EXPECT_EQ( 0, record[ 49 ] );
+  }
+}
+
+TEST_F( IsosurfaceExportTest, VTKASCIIRoundTrip )
+{
+  boost::filesystem::path filename = export_dir_ / "torus.vtk";
+  ASSERT_TRUE( isosurface_->export_vtk_isosurface( filename, false ) );
+
+  std::ifstream file( filename.string().c_str() );
+  std::string line;
+  std::getline( file, line );
+  EXPECT_EQ( "# vtk DataFile Version 3.0", line );
+  std::getline( file, line );
+  std::getline( file, line );
+  EXPECT_EQ( "ASCII", line );
+  std::getline( file, line );
+  EXPECT_EQ( "DATASET POLYDATA", line );
+
+  std::string keyword, type;
+  size_t num_points = 0;
+  file >> keyword >> num_points >> type;
+  EXPECT_EQ( "POINTS", keyword );
+  ASSERT_EQ( points_.size(), num_points );
+  EXPECT_EQ( "float", type );
+
+  // The coordinates are written with six significant digits
+  for ( size_t j = 0; j < num_points; j++ )
+  {
+    float x, y, z;
+    file >> x >> y >> z;
+    ASSERT_TRUE( file.good() ) << "point " << j;
+    ASSERT_NEAR( points_[ j ].x(), x, 1e-4 ) << "point " << j;
+    ASSERT_NEAR( points_[ j ].y(), y, 1e-4 ) << "point " << j;
+    ASSERT_NEAR( points_[ j ].z(), z, 1e-4 ) << "point " << j;
+  }
+
+  size_t num_faces = 0, size = 0;
+  file >> keyword >> num_faces >> size;
+  EXPECT_EQ( "POLYGONS", keyword );
+  ASSERT_EQ( faces_.size() / 3, num_faces );
+  EXPECT_EQ( 4 * num_faces, size );
+
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    unsigned int count, a, b, c;
+    file >> count >> a >> b >> c;
+    ASSERT_FALSE( file.fail() ) << "face " << j;
+    ASSERT_EQ( 3u, count ) << "face " << j;
+    ASSERT_EQ( faces_[ 3 * j ], a ) << "face " << j;
+    ASSERT_EQ( faces_[ 3 * j + 1 ], b ) << "face " << j;
+    ASSERT_EQ( faces_[ 3 * j + 2 ], c ) << "face " << j;
+  }
+}
+
+TEST_F( IsosurfaceExportTest, VTKBinaryRoundTrip )
+{
+  boost::filesystem::path filename = export_dir_ / "torus_binary.vtk";
+  ASSERT_TRUE( isosurface_->export_vtk_isosurface( filename, true ) );
+
+  std::string contents = ReadFile( filename );
+  std::ostringstream points_header;
+  points_header << "# vtk DataFile Version 3.0\nvtk output\nBINARY\nDATASET POLYDATA\n" <<
+    "POINTS " << points_.size() << " float\n";
+  ASSERT_EQ( 0u, contents.find( points_header.str() ) );
+
+  // Big endian coordinates
+  size_t offset = points_header.str().size();
+  ASSERT_LE( offset + 12 * points_.size(), contents.size() );
+  for ( size_t j = 0; j < points_.size(); j++ )
+  {
+    const char* point = &contents[ offset + 12 * j ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      ASSERT_EQ( points_[ j ][ k ], BitsToFloat( LoadBigEndian( point + 4 * k ) ) ) << 
+        "point " << j;
+    }
+  }
+  offset += 12 * points_.size();
+
+  size_t num_faces = faces_.size() / 3;
+  std::ostringstream faces_header;
+  faces_header << "\nPOLYGONS " << num_faces << " " << 4 * num_faces << "\n";
+  ASSERT_EQ( faces_header.str(), contents.substr( offset, faces_header.str().size() ) );
+  offset += faces_header.str().size();
+
+  // Big endian number of vertices followed by the indices
+  ASSERT_EQ( offset + 16 * num_faces + 1, contents.size() );
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    const char* face = &contents[ offset + 16 * j ];
+    ASSERT_EQ( 3u, LoadBigEndian( face ) ) << "face " << j;
+    for ( int k = 0; k < 3; k++ )
+    {
+      ASSERT_EQ( faces_[ 3 * j + k ], LoadBigEndian( face + 4 + 4 * k ) ) << "face " << j;
+    }
+  }
+  EXPECT_EQ( '\n', contents[ contents.size() - 1 ] );
+}
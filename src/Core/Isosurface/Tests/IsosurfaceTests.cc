@@ -0,0 +1,171 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Isosurface/Isosurface.h>
+#include <Core/Volume/MaskVolume.h>
+
+#include <Testing/Utils/MeshChecks.h>
+
+using namespace Core;
+using namespace Testing::Utils;
+
+namespace
+{
+
+// The volume is split into three tiles along x and y, and the shapes cross the tile borders
+// at elements 128 and 256 along x and 32 and 64 along y
+const size_t NX = 300;
+const size_t NY = 96;
+const size_t NZ = 28;
+
+// Surfaces of the shapes, the faces are the same as before the faces were generated in tiles,
+// the area differs slightly as it is summed in a different order
+const size_t BOX_FACES_C = 120304;
+const double BOX_AREA_C = 59703.4;
+const size_t TORUS_FACES_C = 30848;
+const double TORUS_AREA_C = 11548.9;
+
+typedef bool ( *shape_function_type )( double x, double y, double z );
+
+bool InBox( double x, double y, double z )
+{
+  return x >= 5.0 && x < 288.0 && y >= 3.0 && y < 86.0 && z >= 2.0 && z < 20.0;
+}
+
+// Solid torus around ( 128, 48 ), the tile border along x runs through its hole
+bool InTorus( double x, double y, double z )
+{
+  double dx = x - 128.0, dy = y - 48.0, dz = z - 11.5;
+  double radius = std::sqrt( dx * dx + dy * dy ) - 30.0;
+  return radius * radius + dz * dz < 9.0 * 9.0;
+}
+
+bool NeverAbort()
+{
+  return false;
+}
+
+// Compute the surface of a shape that is moved by an offset
+IsosurfaceHandle ComputeIsosurface( shape_function_type shape, size_t offset_x, 
+  size_t offset_y, size_t offset_z )
+{
+  MaskVolumeHandle mask_volume;
+  if ( !MaskVolume::CreateEmptyMask( GridTransform( NX, NY, NZ ), mask_volume ) )
+  {
+    return IsosurfaceHandle();
+  }
+
+  MaskDataBlockHandle mask_data_block = mask_volume->get_mask_data_block();
+  for ( size_t z = offset_z; z < NZ; z++ )
+  {
+    for ( size_t y = offset_y; y < NY; y++ )
+    {
+      for ( size_t x = offset_x; x < NX; x++ )
+      {
+        if ( shape( static_cast< double >( x - offset_x ), static_cast< double >( y - offset_y ), 
+          static_cast< double >( z - offset_z ) ) )
+        {
+          mask_data_block->set_mask_at( x, y, z );
+        }
+      }
+    }
+  }
+
+  IsosurfaceHandle isosurface( new Isosurface( mask_volume ) );
+  isosurface->compute( 1.0, false, &NeverAbort );
+  return isosurface;
+}
+
+class IsosurfaceTest : public ::testing::Test 
+{
+protected:
+  virtual void TearDown()
+  {
+    MaskDataBlockManager::Instance()->clear();
+  }
+};
+
+} // end anonymous namespace
+
+TEST_F( IsosurfaceTest, BoxIsClosedAcrossTiles )
+{
+  IsosurfaceHandle isosurface = ComputeIsosurface( &InBox, 0, 0, 0 );
+  ASSERT_TRUE( isosurface );
+
+  int euler_characteristic = 0;
+  ASSERT_TRUE( CheckClosedManifold( isosurface->get_points(), isosurface->get_faces(), 
+    euler_characteristic ) );
+  EXPECT_EQ( 2, euler_characteristic );
+  EXPECT_EQ( BOX_FACES_C, isosurface->get_faces().size() / 3 );
+  EXPECT_NEAR( BOX_AREA_C, isosurface->surface_area(), 1e-4 * BOX_AREA_C );
+}
+
+TEST_F( IsosurfaceTest, TorusIsClosedAcrossTiles )
+{
+  IsosurfaceHandle isosurface = ComputeIsosurface( &InTorus, 0, 0, 0 );
+  ASSERT_TRUE( isosurface );
+
+  int euler_characteristic = 0;
+  ASSERT_TRUE( CheckClosedManifold( isosurface->get_points(), isosurface->get_faces(), 
+    euler_characteristic ) );
+  EXPECT_EQ( 0, euler_characteristic );
+  EXPECT_EQ( TORUS_FACES_C, isosurface->get_faces().size() / 3 );
+  EXPECT_NEAR( TORUS_AREA_C, isosurface->surface_area(), 1e-4 * TORUS_AREA_C );
+}
+
+TEST_F( IsosurfaceTest, MovedShapesCrossTilesAnywhere )
+{
+  // Moving the shapes changes where the tile borders cut them, but not their surface
+  for ( size_t offset = 1; offset < 4; offset++ )
+  {
+    IsosurfaceHandle box = ComputeIsosurface( &InBox, 2 * offset, offset, offset );
+    ASSERT_TRUE( box );
+    int euler_characteristic = 0;
+    EXPECT_TRUE( CheckClosedManifold( box->get_points(), box->get_faces(), 
+      euler_characteristic ) ) << "offset " << offset;
+    EXPECT_EQ( 2, euler_characteristic ) << "offset " << offset;
+    EXPECT_EQ( BOX_FACES_C, box->get_faces().size() / 3 ) << "offset " << offset;
+    EXPECT_NEAR( BOX_AREA_C, box->surface_area(), 1e-4 * BOX_AREA_C ) << "offset " << offset;
+
+    IsosurfaceHandle torus = ComputeIsosurface( &InTorus, 5 * offset, 2 * offset, offset );
+    ASSERT_TRUE( torus );
+    EXPECT_TRUE( CheckClosedManifold( torus->get_points(), torus->get_faces(), 
+      euler_characteristic ) ) << "offset " << offset;
+    EXPECT_EQ( 0, euler_characteristic ) << "offset " << offset;
+    EXPECT_EQ( TORUS_FACES_C, torus->get_faces().size() / 3 ) << "offset " << offset;
+    EXPECT_NEAR( TORUS_AREA_C, torus->surface_area(), 1e-4 * TORUS_AREA_C ) << 
+      "offset " << offset;
+  }
+}
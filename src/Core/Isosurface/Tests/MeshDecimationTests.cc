@@ -0,0 +1,190 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <Core/Geometry/Point.h>
+#include <Core/Isosurface/MeshDecimation.h>
+
+#include <Testing/Utils/MeshChecks.h>
+
+using namespace Core;
+using namespace Testing::Utils;
+
+namespace
+{
+
+const double TORUS_RADIUS_C = 1.0;
+const double TUBE_RADIUS_C = 0.35;
+
+// Closed torus with two triangles per quad, 2 * num_u * num_v faces in total
+void MakeTorus( size_t num_u, size_t num_v, std::vector< PointF >& points, 
+  std::vector< unsigned int >& faces )
+{
+  const double PI = 3.14159265358979323846;
+  points.clear();
+  faces.clear();
+  for ( size_t i = 0; i < num_u; i++ )
+  {
+    double u = 2.0 * PI * i / num_u;
+    for ( size_t j = 0; j < num_v; j++ )
+    {
+      double v = 2.0 * PI * j / num_v;
+      double radius = TORUS_RADIUS_C + TUBE_RADIUS_C * std::cos( v );
+      points.push_back( PointF( static_cast< float >( radius * std::cos( u ) ),
+        static_cast< float >( radius * std::sin( u ) ), 
+        static_cast< float >( TUBE_RADIUS_C * std::sin( v ) ) ) );
+    }
+  }
+
+  for ( size_t i = 0; i < num_u; i++ )
+  {
+    for ( size_t j = 0; j < num_v; j++ )
+    {
+      unsigned int p00 = static_cast< unsigned int >( i * num_v + j );
+      unsigned int p10 = static_cast< unsigned int >( ( ( i + 1 ) % num_u ) * num_v + j );
+      unsigned int p01 = static_cast< unsigned int >( i * num_v + ( j + 1 ) % num_v );
+      unsigned int p11 = static_cast< unsigned int >( ( ( i + 1 ) % num_u ) * num_v + 
+        ( j + 1 ) % num_v );
+      faces.push_back( p00 ); faces.push_back( p10 ); faces.push_back( p11 );
+      faces.push_back( p00 ); faces.push_back( p11 ); faces.push_back( p01 );
+    }
+  }
+}
+
+// Distance of a point to the surface of the torus
+double TorusDistance( const PointF& point )
+{
+  double radius = std::sqrt( point.x() * point.x() + point.y() * point.y() ) - TORUS_RADIUS_C;
+  return std::abs( std::sqrt( radius * radius + point.z() * point.z() ) - TUBE_RADIUS_C );
+}
+
+void RecordProgress( std::vector< double >* progress, double amount )
+{
+  progress->push_back( amount );
+}
+
+bool AlwaysAbort()
+{
+  return true;
+}
+
+class MeshDecimationTest : public ::testing::Test 
+{
+protected:
+  virtual void SetUp()
+  {
+    MakeTorus( 400, 120, points_, faces_ );
+  }
+
+  std::vector< PointF > points_;
+  std::vector< unsigned int > faces_;
+};
+
+} // end anonymous namespace
+
+TEST_F( MeshDecimationTest, TorusIsClosedManifold )
+{
+  int euler_characteristic = -1;
+  ASSERT_EQ( 96000u, faces_.size() / 3 );
+  ASSERT_TRUE( CheckClosedManifold( points_, faces_, euler_characteristic ) );
+  EXPECT_EQ( 0, euler_characteristic );
+}
+
+TEST_F( MeshDecimationTest, DecimatesToTargetFaces )
+{
+  const size_t targets[] = { 20000, 2000 };
+  for ( size_t j = 0; j < 2; j++ )
+  {
+    SCOPED_TRACE( targets[ j ] );
+    std::vector< PointF > points = points_;
+    std::vector< unsigned int > faces = faces_;
+
+    MeshDecimation decimation;
+    decimation.set_target_faces( targets[ j ] );
+    EXPECT_TRUE( decimation.run( points, faces ) );
+
+    // The cells are decimated in parallel, each with its share of the faces to remove, so
+    // the result is close to the target but not exactly on it
+    size_t num_faces = faces.size() / 3;
+    EXPECT_LE( num_faces, targets[ j ] + targets[ j ] / 20 );
+    EXPECT_GE( num_faces, targets[ j ] - targets[ j ] / 10 );
+
+    int euler_characteristic = -1;
+    ASSERT_TRUE( CheckClosedManifold( points, faces, euler_characteristic ) );
+    EXPECT_EQ( 0, euler_characteristic );
+  }
+}
+
+TEST_F( MeshDecimationTest, StaysWithinMaxError )
+{
+  const double max_error = 0.05;
+  std::vector< PointF > points = points_;
+  std::vector< unsigned int > faces = faces_;
+
+  MeshDecimation decimation;
+  decimation.set_max_error( max_error );
+  std::vector< double > progress;
+  decimation.set_progress_function( boost::bind( &RecordProgress, &progress, _1 ) );
+  EXPECT_TRUE( decimation.run( points, faces ) );
+
+  EXPECT_LT( faces.size() / 3, faces_.size() / 3 / 2 );
+  int euler_characteristic = -1;
+  ASSERT_TRUE( CheckClosedManifold( points, faces, euler_characteristic ) );
+  EXPECT_EQ( 0, euler_characteristic );
+
+  // The vertices stay close to the planes of the original faces, which are within about
+  // 1e-4 of the torus
+  double max_distance = 0.0;
+  for ( size_t j = 0; j < points.size(); j++ )
+  {
+    max_distance = std::max( max_distance, TorusDistance( points[ j ] ) );
+  }
+  EXPECT_LT( max_distance, max_error );
+
+  ASSERT_FALSE( progress.empty() );
+  for ( size_t j = 1; j < progress.size(); j++ ) EXPECT_LE( progress[ j - 1 ], progress[ j ] );
+}
+
+TEST_F( MeshDecimationTest, StopsWhenAborted )
+{
+  std::vector< PointF > points = points_;
+  std::vector< unsigned int > faces = faces_;
+
+  MeshDecimation decimation;
+  decimation.set_target_faces( 2000 );
+  decimation.set_abort_function( &AlwaysAbort );
+  EXPECT_FALSE( decimation.run( points, faces ) );
+  EXPECT_EQ( faces_.size(), faces.size() );
+}
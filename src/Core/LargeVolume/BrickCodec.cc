@@ -0,0 +1,472 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <zlib.h>
+
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+
+#include <Core/LargeVolume/BrickCodec.h>
+
+#ifdef Z_PREFIX
+  #define zlib_uLongf z_uLongf
+  #define zlib_Bytef z_Bytef
+  #define zlib_uncompress z_uncompress
+  #define zlib_compress2 z_compress2
+  #define zlib_compressBound z_compressBound
+#else
+  #define zlib_uLongf uLongf
+  #define zlib_Bytef Bytef
+  #define zlib_uncompress uncompress
+  #define zlib_compress2 compress2
+  #define zlib_compressBound compressBound
+#endif
+
+namespace Core
+{
+
+bool ImportFromString( const std::string& codec_string, BrickCodecType& codec )
+{
+  if ( codec_string == "none" ) codec = BrickCodecType::NONE_E;
+  else if ( codec_string == "zlib" ) codec = BrickCodecType::ZLIB_E;
+  else if ( codec_string == "lz4" ) codec = BrickCodecType::LZ4_E;
+  else return false;
+
+  return true;
+}
+
+bool ImportFromString( const std::string& filter_string, BrickFilterType& filter )
+{
+  if ( filter_string == "none" ) filter = BrickFilterType::NONE_E;
+  else if ( filter_string == "shuffle" ) filter = BrickFilterType::SHUFFLE_E;
+  else if ( filter_string == "delta" ) filter = BrickFilterType::DELTA_SHUFFLE_E;
+  else return false;
+
+  return true;
+}
+
+std::string ExportToString( BrickCodecType codec )
+{
+  switch ( codec )
+  {
+    case BrickCodecType::ZLIB_E:
+      return "zlib";
+    case BrickCodecType::LZ4_E:
+      return "lz4";
+    default:
+      return "none";
+  }
+}
+
+std::string ExportToString( BrickFilterType filter )
+{
+  switch ( filter )
+  {
+    case BrickFilterType::SHUFFLE_E:
+      return "shuffle";
+    case BrickFilterType::DELTA_SHUFFLE_E:
+      return "delta";
+    default:
+      return "none";
+  }
+}
+
+// -- Filters --
+
+// Store the difference with the previous element, using unsigned arithmetic so it
+// wraps around and can be undone exactly
+template< class T >
+static void DeltaEncode( T* data, size_t num_elements )
+{
+  T previous = 0;
+  for ( size_t j = 0; j < num_elements; j++ )
+  {
+    T value = data[ j ];
+    data[ j ] = static_cast<T>( value - previous );
+    previous = value;
+  }
+}
+
+template< class T >
+static void DeltaDecode( T* data, size_t num_elements )
+{
+  T previous = 0;
+  for ( size_t j = 0; j < num_elements; j++ )
+  {
+    previous = static_cast<T>( previous + data[ j ] );
+    data[ j ] = previous;
+  }
+}
+
+static void DeltaEncode( void* data, size_t size, size_t element_size )
+{
+  switch ( element_size )
+  {
+    case 1: DeltaEncode( reinterpret_cast<boost::uint8_t*>( data ), size ); break;
+    case 2: DeltaEncode( reinterpret_cast<boost::uint16_t*>( data ), size / 2 ); break;
+    case 4: DeltaEncode( reinterpret_cast<boost::uint32_t*>( data ), size / 4 ); break;
+    case 8: DeltaEncode( reinterpret_cast<boost::uint64_t*>( data ), size / 8 ); break;
+  }
+}
+
+static void DeltaDecode( void* data, size_t size, size_t element_size )
+{
+  switch ( element_size )
+  {
+    case 1: DeltaDecode( reinterpret_cast<boost::uint8_t*>( data ), size ); break;
+    case 2: DeltaDecode( reinterpret_cast<boost::uint16_t*>( data ), size / 2 ); break;
+    case 4: DeltaDecode( reinterpret_cast<boost::uint32_t*>( data ), size / 4 ); break;
+    case 8: DeltaDecode( reinterpret_cast<boost::uint64_t*>( data ), size / 8 ); break;
+  }
+}
+
+// Group byte k of all elements together: the high bytes of image data are very
+// repetitive, which the compressors pick up much better once they are contiguous
+static void Shuffle( const char* src, char* dst, size_t size, size_t element_size )
+{
+  const size_t num_elements = size / element_size;
+  for ( size_t b = 0; b < element_size; b++ )
+  {
+    const char* s = src + b;
+    char* d = dst + b * num_elements;
+    for ( size_t j = 0; j < num_elements; j++, s += element_size )
+    {
+      d[ j ] = *s;
+    }
+  }
+  // Trailing bytes that do not form a complete element are copied as is
+  std::memcpy( dst + num_elements * element_size, src + num_elements * element_size,
+    size - num_elements * element_size );
+}
+
+static void Unshuffle( const char* src, char* dst, size_t size, size_t element_size )
+{
+  const size_t num_elements = size / element_size;
+  for ( size_t b = 0; b < element_size; b++ )
+  {
+    const char* s = src + b * num_elements;
+    char* d = dst + b;
+    for ( size_t j = 0; j < num_elements; j++, d += element_size )
+    {
+      *d = s[ j ];
+    }
+  }
+  std::memcpy( dst + num_elements * element_size, src + num_elements * element_size,
+    size - num_elements * element_size );
+}
+
+// -- LZ4 block format --
+// A self contained implementation of the LZ4 block format: a greedy single hash table
+// compressor with a bounds checked decompressor. Decompression speed is what matters for
+// streaming bricks, compression only runs once during conversion.
+
+static const size_t LZ4_MIN_MATCH_C = 4;
+static const size_t LZ4_MF_LIMIT_C = 12;
+static const size_t LZ4_LAST_LITERALS_C = 5;
+static const size_t LZ4_MAX_OFFSET_C = 65535;
+static const int LZ4_HASH_LOG_C = 16;
+
+static inline boost::uint32_t Lz4Read32( const unsigned char* p )
+{
+  boost::uint32_t value;
+  std::memcpy( &value, p, sizeof( value ) );
+  return value;
+}
+
+static inline boost::uint32_t Lz4Hash( boost::uint32_t sequence )
+{
+  return ( sequence * 2654435761U ) >> ( 32 - LZ4_HASH_LOG_C );
+}
+
+static inline unsigned char* Lz4WriteLength( unsigned char* op, size_t length )
+{
+  while ( length >= 255 )
+  {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<unsigned char>( length );
+  return op;
+}
+
+static size_t Lz4CompressBound( size_t size )
+{
+  return size + size / 255 + 16;
+}
+
+// Emit one sequence; returns 0 if it does not fit in the output buffer
+static unsigned char* Lz4WriteSequence( unsigned char* op, unsigned char* oend,
+  const unsigned char* literals, size_t num_literals, size_t offset, size_t match_length )
+{
+  if ( op + 1 + num_literals + num_literals / 255 + 1 + 2 + match_length / 255 + 1 > oend ) return 0;
+
+  unsigned char* token = op++;
+  *token = static_cast<unsigned char>( ( num_literals >= 15 ? 15 : num_literals ) << 4 );
+  if ( num_literals >= 15 ) op = Lz4WriteLength( op, num_literals - 15 );
+  std::memcpy( op, literals, num_literals );
+  op += num_literals;
+
+  if ( match_length == 0 ) return op;
+
+  *op++ = static_cast<unsigned char>( offset & 0xff );
+  *op++ = static_cast<unsigned char>( offset >> 8 );
+
+  size_t match_code = match_length - LZ4_MIN_MATCH_C;
+  *token |= static_cast<unsigned char>( match_code >= 15 ? 15 : match_code );
+  if ( match_code >= 15 ) op = Lz4WriteLength( op, match_code - 15 );
+
+  return op;
+}
+
+static size_t Lz4Compress( const unsigned char* src, size_t size, unsigned char* dst, size_t capacity )
+{
+  unsigned char* op = dst;
+  unsigned char* oend = dst + capacity;
+  const unsigned char* anchor = src;
+
+  if ( size > LZ4_MF_LIMIT_C )
+  {
+    std::vector<boost::uint32_t> table( static_cast<size_t>( 1 ) << LZ4_HASH_LOG_C, 0 );
+    const unsigned char* ip = src;
+    const unsigned char* match_limit = src + size - LZ4_MF_LIMIT_C;
+    const unsigned char* extend_limit = src + size - LZ4_LAST_LITERALS_C;
+    size_t misses = 0;
+
+    while ( ip < match_limit )
+    {
+      boost::uint32_t sequence = Lz4Read32( ip );
+      boost::uint32_t hash = Lz4Hash( sequence );
+      const unsigned char* ref = src + table[ hash ];
+      table[ hash ] = static_cast<boost::uint32_t>( ip - src );
+
+      if ( ref >= ip || static_cast<size_t>( ip - ref ) > LZ4_MAX_OFFSET_C || Lz4Read32( ref ) != sequence )
+      {
+        // Skip faster through data that does not compress
+        ip += 1 + ( misses++ >> 6 );
+        continue;
+      }
+      misses = 0;
+
+      // Extend the match backwards into the pending literals and forwards
+      while ( ip > anchor && ref > src && ip[ -1 ] == ref[ -1 ] ) 
+      { 
+        ip--; 
+        ref--; 
+      }
+      size_t match_length = LZ4_MIN_MATCH_C;
+      while ( ip + match_length < extend_limit && ip[ match_length ] == ref[ match_length ] ) 
+      {
+        match_length++;
+      }
+
+      op = Lz4WriteSequence( op, oend, anchor, ip - anchor, ip - ref, match_length );
+      if ( op == 0 ) return 0;
+
+      ip += match_length;
+      anchor = ip;
+      if ( ip < match_limit )
+      {
+        table[ Lz4Hash( Lz4Read32( ip - 2 ) ) ] = static_cast<boost::uint32_t>( ip - 2 - src );
+      }
+    }
+  }
+
+  // The last sequence only contains literals
+  op = Lz4WriteSequence( op, oend, anchor, src + size - anchor, 0, 0 );
+  if ( op == 0 ) return 0;
+
+  return op - dst;
+}
+
+static bool Lz4Decompress( const unsigned char* src, size_t src_size, unsigned char* dst, size_t size )
+{
+  const unsigned char* ip = src;
+  const unsigned char* iend = src + src_size;
+  unsigned char* op = dst;
+  unsigned char* oend = dst + size;
+
+  while ( ip < iend )
+  {
+    unsigned int token = *ip++;
+
+    size_t num_literals = token >> 4;
+    if ( num_literals == 15 )
+    {
+      unsigned char b;
+      do
+      {
+        if ( ip >= iend ) return false;
+        b = *ip++;
+        num_literals += b;
+      } while ( b == 255 );
+    }
+
+    if ( static_cast<size_t>( iend - ip ) < num_literals || 
+      static_cast<size_t>( oend - op ) < num_literals ) return false;
+    std::memcpy( op, ip, num_literals );
+    ip += num_literals;
+    op += num_literals;
+
+    // The last sequence has no match
+    if ( ip == iend ) break;
+
+    if ( iend - ip < 2 ) return false;
+    size_t offset = ip[ 0 ] | ( static_cast<size_t>( ip[ 1 ] ) << 8 );
+    ip += 2;
+    if ( offset == 0 || offset > static_cast<size_t>( op - dst ) ) return false;
+
+    size_t match_length = token & 15;
+    if ( match_length == 15 )
+    {
+      unsigned char b;
+      do
+      {
+        if ( ip >= iend ) return false;
+        b = *ip++;
+        match_length += b;
+      } while ( b == 255 );
+    }
+    match_length += LZ4_MIN_MATCH_C;
+
+    if ( static_cast<size_t>( oend - op ) < match_length ) return false;
+
+    const unsigned char* match = op - offset;
+    if ( offset >= match_length )
+    {
+      std::memcpy( op, match, match_length );
+      op += match_length;
+    }
+    else
+    {
+      // Overlapping copy, used for runs of repeated values
+      for ( size_t j = 0; j < match_length; j++ ) *op++ = *match++;
+    }
+  }
+
+  return op == oend;
+}
+
+// -- Codec interface --
+
+bool BrickCodec::Compress( BrickCodecType codec, BrickFilterType filter, DataType data_type,
+  const void* data, size_t size, std::vector<char>& buffer )
+{
+  if ( codec == BrickCodecType::NONE_E ) return false;
+
+  const size_t element_size = GetSizeDataType( data_type );
+
+  // Apply the filter on a copy of the data
+  std::vector<char> filtered;
+  const char* src = reinterpret_cast<const char*>( data );
+  if ( filter != BrickFilterType::NONE_E && element_size > 0 )
+  {
+    filtered.resize( size );
+    if ( filter == BrickFilterType::DELTA_SHUFFLE_E && IsInteger( data_type ) )
+    {
+      std::vector<char> delta( src, src + size );
+      DeltaEncode( &delta[ 0 ], size, element_size );
+      Shuffle( &delta[ 0 ], &filtered[ 0 ], size, element_size );
+    }
+    else
+    {
+      Shuffle( src, &filtered[ 0 ], size, element_size );
+    }
+    src = &filtered[ 0 ];
+  }
+
+  if ( codec == BrickCodecType::ZLIB_E )
+  {
+    zlib_uLongf compressed_size = zlib_compressBound( static_cast<zlib_uLongf>( size ) );
+    buffer.resize( compressed_size );
+    if ( zlib_compress2( reinterpret_cast<zlib_Bytef*>( &buffer[ 0 ] ), &compressed_size,
+      reinterpret_cast<const zlib_Bytef*>( src ), size, Z_DEFAULT_COMPRESSION ) != Z_OK )
+    {
+      return false;
+    }
+    buffer.resize( compressed_size );
+  }
+  else if ( codec == BrickCodecType::LZ4_E )
+  {
+    buffer.resize( Lz4CompressBound( size ) );
+    size_t compressed_size = Lz4Compress( reinterpret_cast<const unsigned char*>( src ), size,
+      reinterpret_cast<unsigned char*>( &buffer[ 0 ] ), buffer.size() );
+    if ( compressed_size == 0 ) return false;
+    buffer.resize( compressed_size );
+  }
+  else
+  {
+    return false;
+  }
+
+  return buffer.size() < size;
+}
+
+bool BrickCodec::Decompress( BrickCodecType codec, BrickFilterType filter, DataType data_type,
+  const char* buffer, size_t buffer_size, void* data, size_t size )
+{
+  if ( codec == BrickCodecType::ZLIB_E )
+  {
+    zlib_uLongf uncompressed_size = size;
+    if ( zlib_uncompress( reinterpret_cast<zlib_Bytef*>( data ), &uncompressed_size,
+      reinterpret_cast<const zlib_Bytef*>( buffer ), buffer_size ) != Z_OK )
+    {
+      return false;
+    }
+    if ( uncompressed_size != size ) return false;
+  }
+  else if ( codec == BrickCodecType::LZ4_E )
+  {
+    if ( !Lz4Decompress( reinterpret_cast<const unsigned char*>( buffer ), buffer_size,
+      reinterpret_cast<unsigned char*>( data ), size ) )
+    {
+      return false;
+    }
+  }
+  else
+  {
+    return false;
+  }
+
+  const size_t element_size = GetSizeDataType( data_type );
+  if ( filter != BrickFilterType::NONE_E && element_size > 0 )
+  {
+    char* dst = reinterpret_cast<char*>( data );
+    std::vector<char> shuffled( dst, dst + size );
+    Unshuffle( &shuffled[ 0 ], dst, size, element_size );
+
+    if ( filter == BrickFilterType::DELTA_SHUFFLE_E && IsInteger( data_type ) )
+    {
+      DeltaDecode( dst, size, element_size );
+    }
+  }
+
+  return true;
+}
+
+} // end namespace Core
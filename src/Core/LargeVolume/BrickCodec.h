@@ -0,0 +1,95 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_LARGEVOLUME_BRICKCODEC_H
+#define CORE_LARGEVOLUME_BRICKCODEC_H
+
+// STL includes
+#include <string>
+#include <vector>
+
+// Core includes
+#include <Core/Utils/EnumClass.h>
+#include <Core/DataBlock/DataType.h>
+
+namespace Core
+{
+
+// CLASS BrickCodecType:
+/// Compression method used for the bricks of a large volume. Volumes without a codec
+/// field in their volume file are zlib compressed.
+CORE_ENUM_CLASS
+(
+  BrickCodecType,
+  NONE_E = 0,
+  ZLIB_E,
+  LZ4_E
+)
+
+// CLASS BrickFilterType:
+/// Reversible filter applied to the brick data before compression.
+/// SHUFFLE_E groups the n-th byte of every element together, DELTA_SHUFFLE_E stores the
+/// difference with the previous element before shuffling (integer data only).
+CORE_ENUM_CLASS
+(
+  BrickFilterType,
+  NONE_E = 0,
+  SHUFFLE_E,
+  DELTA_SHUFFLE_E
+)
+
+// IMPORTFROMSTRING:
+/// Import a codec or filter from a string, returns false if the string is not recognized
+bool ImportFromString( const std::string& codec_string, BrickCodecType& codec );
+bool ImportFromString( const std::string& filter_string, BrickFilterType& filter );
+
+// EXPORTTOSTRING:
+/// Export a codec or filter to the string used in the volume file
+std::string ExportToString( BrickCodecType codec );
+std::string ExportToString( BrickFilterType filter );
+
+class BrickCodec
+{
+public:
+  /// COMPRESS
+  /// Filter and compress size bytes of brick data into buffer. Returns false if the data
+  /// could not be compressed or did not get smaller, in which case the brick should be
+  /// stored as is.
+  static bool Compress( BrickCodecType codec, BrickFilterType filter, DataType data_type,
+    const void* data, size_t size, std::vector<char>& buffer );
+
+  /// DECOMPRESS
+  /// Decompress buffer into exactly size bytes of brick data and undo the filter.
+  /// Returns false if the buffer is corrupt or does not decompress to size bytes.
+  static bool Decompress( BrickCodecType codec, BrickFilterType filter, DataType data_type,
+    const char* buffer, size_t buffer_size, void* data, size_t size );
+};
+
+} // end namespace Core
+
+#endif
@@ -26,13 +26,16 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-#include <list>
-#include <queue>
+#include <algorithm>
+#include <vector>
 
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/thread.hpp>
 
 #include <Core/Application/Application.h>
 #include <Core/Utils/ConnectionHandler.h>
+#include <Core/Utils/Lockable.h>
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/LargeVolume/LargeVolumeCache.h>
 
@@ -40,46 +43,255 @@ namespace Core
 {
 CORE_SINGLETON_IMPLEMENTATION( LargeVolumeCache );
 
-class LargeVolumeCachePrivate : ConnectionHandler, Lockable, public EventHandler
+// Bricks are identified by the schema id, the level and the index of the brick packed
+// into one 64 bit integer.
+typedef unsigned long long brick_key_type;
+
+static brick_key_type ComputeBrickKey( const LargeVolumeSchemaHandle& schema, const BrickInfo& bi )
 {
-  typedef std::list<std::string> cache_access_list_type;
+  return ( static_cast<brick_key_type>( schema->get_id() & 0xfffff ) << 44 ) |
+    ( static_cast<brick_key_type>( bi.level_ & 0x3f ) << 38 ) |
+    ( static_cast<brick_key_type>( bi.index_ ) & 0x3fffffffffULL );
+}
 
-  struct CacheEntry
+// CLASS LARGEVOLUMECACHESHARD:
+/// One independently locked part of the brick cache. Bricks are replaced using
+/// the CLOCK algorithm: every brick has a reference bit that is set when it is
+/// accessed, and the clock hand evicts the first brick without its bit set while
+/// clearing the bits it passes.
+class LargeVolumeCacheShard : public Lockable
+{
+  struct Slot
   {
+    Slot() : key_( 0 ), referenced_( false ) {}
+
+    brick_key_type key_;
     DataBlockHandle data_block_;
-    cache_access_list_type::iterator access_record_;
+    bool referenced_;
   };
 
+  typedef boost::unordered_map<brick_key_type, size_t> slot_map_type;
+
+public:
+  LargeVolumeCacheShard() :
+    hand_( 0 ), size_( 0 ), capacity_( 0 ),
+    hits_( 0 ), misses_( 0 ), insertions_( 0 ), evictions_( 0 )
+  {
+  }
+
+  bool get_entry( brick_key_type key, DataBlockHandle& data_block )
+  {
+    lock_type lock( this->get_mutex() );
+
+    slot_map_type::iterator it = this->slot_map_.find( key );
+    if ( it == this->slot_map_.end() ) 
+    {
+      this->misses_++;
+      return false;
+    }
+
+    Slot& slot = this->slots_[ it->second ];
+    slot.referenced_ = true;
+    data_block = slot.data_block_;
+    this->hits_++;
+
+    return true;
+  }
+
+  bool has_entry( brick_key_type key ) const
+  {
+    lock_type lock( this->get_mutex() );
+    return this->slot_map_.find( key ) != this->slot_map_.end();
+  }
+
+  void add_entry( brick_key_type key, DataBlockHandle data_block )
+  {
+    lock_type lock( this->get_mutex() );
+
+    // Another thread may have inserted the same brick in the mean time
+    if ( this->slot_map_.find( key ) != this->slot_map_.end() ) return;
+
+    size_t idx;
+    if ( this->free_slots_.empty() )
+    {
+      idx = this->slots_.size();
+      this->slots_.push_back( Slot() );
+    }
+    else
+    {
+      idx = this->free_slots_.back();
+      this->free_slots_.pop_back();
+    }
+
+    Slot& slot = this->slots_[ idx ];
+    slot.key_ = key;
+    slot.data_block_ = data_block;
+    slot.referenced_ = true;
+
+    this->slot_map_[ key ] = idx;
+    this->size_ += data_block->get_byte_size();
+    this->insertions_++;
+
+    this->constraint_size( idx );
+  }
+
+  void set_capacity( long long capacity )
+  {
+    lock_type lock( this->get_mutex() );
+    this->capacity_ = capacity;
+    this->constraint_size( this->slots_.size() );
+  }
+
+  void clear()
+  {
+    lock_type lock( this->get_mutex() );
+
+    this->slots_.clear();
+    this->free_slots_.clear();
+    this->slot_map_.clear();
+    this->hand_ = 0;
+    this->size_ = 0;
+  }
+
+  void add_statistics( LargeVolumeCacheStatistics& statistics ) const
+  {
+    lock_type lock( this->get_mutex() );
+
+    statistics.hits_ += this->hits_;
+    statistics.misses_ += this->misses_;
+    statistics.insertions_ += this->insertions_;
+    statistics.evictions_ += this->evictions_;
+    statistics.num_bricks_ += static_cast<long long>( this->slot_map_.size() );
+    statistics.size_ += this->size_;
+  }
+
+  void reset_statistics()
+  {
+    lock_type lock( this->get_mutex() );
+
+    this->hits_ = 0;
+    this->misses_ = 0;
+    this->insertions_ = 0;
+    this->evictions_ = 0;
+  }
+
+private:
+  // Evict bricks until the shard fits in its capacity. The brick in slot keep_idx was
+  // just inserted and is never evicted, so a single brick larger than the capacity of
+  // the shard can still be cached.
+  void constraint_size( size_t keep_idx )
+  {
+    while ( this->size_ > this->capacity_ && this->slot_map_.size() > 1 )
+    {
+      if ( this->hand_ >= this->slots_.size() ) this->hand_ = 0;
+      Slot& slot = this->slots_[ this->hand_ ];
+
+      if ( slot.data_block_ && this->hand_ != keep_idx )
+      {
+        if ( slot.referenced_ )
+        {
+          slot.referenced_ = false;
+        }
+        else
+        {
+          this->size_ -= slot.data_block_->get_byte_size();
+          this->slot_map_.erase( slot.key_ );
+          slot.data_block_.reset();
+          this->free_slots_.push_back( this->hand_ );
+          this->evictions_++;
+        }
+      }
+
+      this->hand_++;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_slots_;
+  slot_map_type slot_map_;
+  size_t hand_;
+
+  long long size_;
+  long long capacity_;
+
+  long long hits_;
+  long long misses_;
+  long long insertions_;
+  long long evictions_;
+};
+
+class LargeVolumeCachePrivate : ConnectionHandler
+{
   struct LoadJob
   {
-    LoadJob( LargeVolumeSchemaHandle schema, BrickInfo bi ) :
-      schema_( schema ), bi_( bi )
+    LoadJob( LargeVolumeSchemaHandle schema, BrickInfo bi, brick_key_type key, 
+      const std::string& load_key, double center_distance, unsigned long long sequence ) :
+      schema_( schema ), bi_( bi ), key_( key ), load_key_( load_key ), 
+      center_distance_( center_distance ), sequence_( sequence )
     {
     };
 
     LargeVolumeSchemaHandle schema_;
     BrickInfo bi_;
+    brick_key_type key_;
+    std::string load_key_;
+    double center_distance_;
+    unsigned long long sequence_;
   };
 
-  typedef boost::unordered_map<std::string, CacheEntry> cache_map_type;
+  // Ordering of the job heap: the job that compares largest is loaded first.
+  // Coarse levels go first as they are needed to fill in the screen, then bricks
+  // closest to the center of the viewport, then the oldest request.
+  struct LoadJobLess
+  {
+    bool operator()( const LoadJob& lhs, const LoadJob& rhs ) const
+    {
+      if ( lhs.bi_.level_ != rhs.bi_.level_ ) return lhs.bi_.level_ < rhs.bi_.level_;
+      if ( lhs.center_distance_ != rhs.center_distance_ ) 
+        return lhs.center_distance_ > rhs.center_distance_;
+      return lhs.sequence_ > rhs.sequence_;
+    }
+  };
+
+  struct LoadJobHasKey
+  {
+    LoadJobHasKey( const std::string& load_key ) : load_key_( load_key ) {}
+    bool operator()( const LoadJob& job ) const { return job.load_key_ == this->load_key_; }
+    const std::string& load_key_;
+  };
 
 public:
+  // Number of independently locked parts of the cache
+  static const size_t NUM_SHARDS_C = 16;
+
   long long cache_capacity_;
-  long long cache_size_;
-  cache_access_list_type cache_access_list_;
-  cache_map_type cache_map_;
+  LargeVolumeCacheShard shards_[ NUM_SHARDS_C ];
 
   LargeVolumeCache* instance_;
 
-  boost::unordered_map<std::string,std::queue<LoadJob> > jobs_;
+  // Pending load jobs, organized as a heap using LoadJobLess
+  std::vector<LoadJob> jobs_;
+  // Bricks that are currently being read by one of the workers
+  boost::unordered_set<brick_key_type> jobs_in_progress_;
+  unsigned long long job_sequence_;
+
+  // Mutex and condition variable protecting the job queue
+  boost::mutex jobs_mutex_;
+  boost::condition_variable jobs_condition_;
 
-  LargeVolumeCachePrivate()
+  boost::thread_group load_threads_;
+  int num_load_threads_;
+  bool done_;
+
+  LargeVolumeCachePrivate() :
+    job_sequence_( 0 ),
+    done_( false )
   {
     if (sizeof( void * ) == 4)
     {
       // For 32bit systems, do not exceed 1 GB of data usage.
       // On Windows, addressable space is 2 GB, hence this leaves enough space for the program itself.
-      this->cache_capacity_ = static_cast<long long>( 1 ) << 30;
+      this->set_cache_capacity( static_cast<long long>( 1 ) << 30 );
     }
     else
     {
@@ -92,114 +304,155 @@ public:
       // If less than 1 GB, use 1 GB.
       if (mem_size < ( static_cast<long long>( 1 ) << 30 )) mem_size = static_cast<long long>( 1 ) << 30;
 
-      // Do not use more than 32 GB, unless explicity requested.
-      this->cache_capacity_ = Core::Min( static_cast<long long>( 32 ) << 30, mem_size );
+      // Do not use more than 32 GB, unless explicity requested using set_cache_capacity.
+      this->set_cache_capacity( Core::Min( static_cast<long long>( 32 ) << 30, mem_size ) );
     }
 
-    this->cache_size_ = 0;
+    // Reading bricks is a mix of disk access and decompression, hence use a couple of
+    // threads even on small machines, but do not flood the disk on large ones.
+    this->num_load_threads_ = Core::Max( 2, Core::Min( 8, 
+      static_cast<int>( boost::thread::hardware_concurrency() ) ) );
 
     this->add_connection( Application::Instance()->reset_signal_.connect(
-      boost::bind( &LargeVolumeCachePrivate::clear_cache, this ) ) );
+      boost::bind( &LargeVolumeCachePrivate::reset, this ) ) );
   }
 
   ~LargeVolumeCachePrivate()
   {
     this->disconnect_all();
+    this->stop_load_threads();
   }
 
-  void add_entry(const std::string& brick_name, DataBlockHandle data_block)
+  LargeVolumeCacheShard& get_shard( brick_key_type key )
   {
-    lock_type lock( this->get_mutex() );
-
-    this->cache_access_list_.push_front( brick_name );
-    this->cache_size_ += data_block->get_byte_size();
-
-    CacheEntry entry;
-    entry.data_block_ = data_block;
-    entry.access_record_ = this->cache_access_list_.begin();
-    this->cache_map_[ brick_name ] = entry;
-
-    this->constraint_cache_size();
+    // Mix the bits, so neighboring bricks end up in different shards
+    brick_key_type hash = key * 0x9e3779b97f4a7c15ULL;
+    return this->shards_[ ( hash >> 32 ) % NUM_SHARDS_C ];
   }
 
-  void constraint_cache_size()
+  void set_cache_capacity( long long capacity )
   {
-    while (this->cache_size_ > this->cache_capacity_)
+    this->cache_capacity_ = capacity;
+    for ( size_t j = 0; j < NUM_SHARDS_C; j++ )
     {
-      std::string brick_name = this->cache_access_list_.back();
-      cache_map_type::iterator it = this->cache_map_.find( brick_name );
-      this->cache_size_ -= it->second.data_block_->get_byte_size();
-      this->cache_access_list_.pop_back();
-      this->cache_map_.erase( it );
+      this->shards_[ j ].set_capacity( capacity / static_cast<long long>( NUM_SHARDS_C ) );
     }
   }
 
-  bool get_entry( const std::string& brick_name, DataBlockHandle& data_block )
+  void start_load_threads()
   {
-    lock_type lock( this->get_mutex() );
+    for ( int j = 0; j < this->num_load_threads_; j++ )
+    {
+      this->load_threads_.create_thread( boost::bind( &LargeVolumeCachePrivate::run_load_thread, this ) );
+    }
+  }
 
-    cache_map_type::iterator it = this->cache_map_.find( brick_name );
-    if (it == this->cache_map_.end()) 
-      return false;
+  void stop_load_threads()
+  {
+    {
+      boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+      this->done_ = true;
+      this->jobs_condition_.notify_all();
+    }
+    this->load_threads_.join_all();
+  }
 
-    this->cache_access_list_.erase( it->second.access_record_ );
-    this->cache_access_list_.push_front( brick_name );
-    it->second.access_record_ = this->cache_access_list_.begin();
-    data_block = it->second.data_block_;
+  bool get_entry( brick_key_type key, DataBlockHandle& data_block )
+  {
+    return this->get_shard( key ).get_entry( key, data_block );
+  }
 
-    return true;
+  void add_entry( brick_key_type key, DataBlockHandle data_block )
+  {
+    this->get_shard( key ).add_entry( key, data_block );
   }
 
   void clear_cache()
   {
-    lock_type lock( this->get_mutex() );
+    for ( size_t j = 0; j < NUM_SHARDS_C; j++ )
+    {
+      this->shards_[ j ].clear();
+    }
+  }
 
-    this->cache_access_list_.clear();
-    this->cache_map_.clear();
-    this->cache_size_ = 0;
+  void reset()
+  {
+    {
+      boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+      this->jobs_.clear();
+    }
+    this->clear_cache();
   }
 
-  void load_brick( LargeVolumeSchemaHandle schema, BrickInfo bi, std::string load_key )
+  void load_brick( LargeVolumeSchemaHandle schema, BrickInfo bi, brick_key_type key,
+    const std::string& load_key, double center_distance )
   {
-    this->jobs_[ load_key ].push( LoadJob( schema, bi ) );
+    boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+    this->jobs_.push_back( LoadJob( schema, bi, key, load_key, center_distance, 
+      this->job_sequence_++ ) );
+    std::push_heap( this->jobs_.begin(), this->jobs_.end(), LoadJobLess() );
+    this->jobs_condition_.notify_one();
+  }
 
-    this->post_event( boost::bind( &LargeVolumeCachePrivate::process_load_job, this, load_key ) );
+  void clear_load_queue( const std::string& load_key )
+  {
+    boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+    std::vector<LoadJob>::iterator it = std::remove_if( this->jobs_.begin(), this->jobs_.end(), 
+      LoadJobHasKey( load_key ) );
+    if ( it == this->jobs_.end() ) return;
+    this->jobs_.erase( it, this->jobs_.end() );
+    std::make_heap( this->jobs_.begin(), this->jobs_.end(), LoadJobLess() );
   }
 
-  void process_load_job( std::string load_key )
+  void run_load_thread()
   {
-    if (! this->jobs_[ load_key ].empty() )
+    for ( ;; )
     {
-      LoadJob lj = this->jobs_[ load_key ].front();
-      this->jobs_[ load_key ].pop();
+      LargeVolumeSchemaHandle schema;
+      BrickInfo bi( 0, 0 );
+      brick_key_type key;
+      {
+        boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+        while ( !this->done_ && this->jobs_.empty() )
+        {
+          this->jobs_condition_.wait( lock );
+        }
+        if ( this->done_ ) return;
+
+        std::pop_heap( this->jobs_.begin(), this->jobs_.end(), LoadJobLess() );
+        LoadJob& job = this->jobs_.back();
+        schema = job.schema_;
+        bi = job.bi_;
+        key = job.key_;
+        this->jobs_.pop_back();
+
+        // Some other worker is already reading this brick
+        if ( !this->jobs_in_progress_.insert( key ).second ) continue;
+      }
 
-      std::string brick_name = lj.schema_->get_brick_file_name( lj.bi_ ).string();
-      DataBlockHandle data_block;
-      if (! this->get_entry( brick_name, data_block )) 
+      if ( !this->get_shard( key ).has_entry( key ) ) 
       {
+        DataBlockHandle data_block;
         std::string error;
-        lj.schema_->read_brick( data_block, lj.bi_, error );
-        this->add_entry( brick_name, data_block );
-        this->instance_->brick_loaded_signal_();
+        if ( schema->read_brick( data_block, bi, error ) )
+        {
+          this->add_entry( key, data_block );
+          this->instance_->brick_loaded_signal_();
+        }
       }
-    }
 
-    if (! this->jobs_[ load_key ].empty() )
-    {
-      this->post_event( boost::bind( &LargeVolumeCachePrivate::process_load_job, this, load_key ) );  
+      {
+        boost::unique_lock< boost::mutex > lock( this->jobs_mutex_ );
+        this->jobs_in_progress_.erase( key );
+      }
     }
   }
-
-  void clear_load_queue( std::string load_key )
-  {
-    this->jobs_[ load_key ] = std::queue<LoadJob>();
-  }
 };
 
 LargeVolumeCache::LargeVolumeCache() : private_( new LargeVolumeCachePrivate )
 {
   this->private_->instance_ = this;
-  this->private_->start_eventhandler();
+  this->private_->start_load_threads();
 }
 
 LargeVolumeCache::~LargeVolumeCache()
@@ -209,36 +462,70 @@ LargeVolumeCache::~LargeVolumeCache()
 
 bool LargeVolumeCache::mark_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi )
 {
-  std::string brick_name = schema->get_brick_file_name( bi ).string();
-
   DataBlockHandle data_block;
-  return this->private_->get_entry( brick_name, data_block );
+  return this->private_->get_entry( ComputeBrickKey( schema, bi ), data_block );
 }
 
 bool LargeVolumeCache::get_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
   const std::string& load_key, DataBlockHandle& data_block )
 {
-  std::string brick_name = schema->get_brick_file_name( bi ).string();
+  brick_key_type key = ComputeBrickKey( schema, bi );
 
-  if (this->private_->get_entry( brick_name, data_block ))
+  if (this->private_->get_entry( key, data_block ))
   {
     return true;
   }
 
-  this->private_->post_event( boost::bind( &LargeVolumeCachePrivate::load_brick, this->private_, schema, bi, load_key ) );
+  this->private_->load_brick( schema, bi, key, load_key, 0.0 );
 
   return false;
 }
 
-void LargeVolumeCache::load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, const std::string& load_key )
+void LargeVolumeCache::load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
+  const std::string& load_key, double center_distance )
 {
-  DataBlockHandle data_block;
-  this->get_brick( schema, bi, load_key, data_block ); 
+  // NOTE: Callers only request bricks they could not find in the cache, so checking
+  // the cache again here would only inflate the miss counter.
+  this->private_->load_brick( schema, bi, ComputeBrickKey( schema, bi ), load_key, center_distance );
 }
 
 void LargeVolumeCache::clear_load_queue( const std::string& load_key )
 {
-  this->private_->post_event( boost::bind( &LargeVolumeCachePrivate::clear_load_queue, this->private_, load_key ) );
+  this->private_->clear_load_queue( load_key );
+}
+
+long long LargeVolumeCache::get_cache_capacity() const
+{
+  return this->private_->cache_capacity_;
+}
+
+void LargeVolumeCache::set_cache_capacity( long long capacity )
+{
+  this->private_->set_cache_capacity( capacity );
+}
+
+LargeVolumeCacheStatistics LargeVolumeCache::get_statistics() const
+{
+  LargeVolumeCacheStatistics statistics;
+  for ( size_t j = 0; j < LargeVolumeCachePrivate::NUM_SHARDS_C; j++ )
+  {
+    this->private_->shards_[ j ].add_statistics( statistics );
+  }
+  statistics.capacity_ = this->private_->cache_capacity_;
+  return statistics;
+}
+
+void LargeVolumeCache::reset_statistics()
+{
+  for ( size_t j = 0; j < LargeVolumeCachePrivate::NUM_SHARDS_C; j++ )
+  {
+    this->private_->shards_[ j ].reset_statistics();
+  }
+}
+
+int LargeVolumeCache::get_num_load_threads() const
+{
+  return this->private_->num_load_threads_;
 }
 
 } // end namespace
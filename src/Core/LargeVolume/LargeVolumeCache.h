@@ -45,6 +45,31 @@ typedef boost::shared_ptr< LargeVolumeCache > LargeVolumeCacheHandle;
 class LargeVolumeCachePrivate;
 typedef boost::shared_ptr< LargeVolumeCachePrivate > LargeVolumeCachePrivateHandle;
 
+/// Counters describing how well the brick cache performs, these can be used to size
+/// the cache capacity for a given data set and viewing pattern.
+struct LargeVolumeCacheStatistics
+{
+  LargeVolumeCacheStatistics() :
+    hits_( 0 ), misses_( 0 ), insertions_( 0 ), evictions_( 0 ), 
+    num_bricks_( 0 ), size_( 0 ), capacity_( 0 )
+  {}
+
+  // Number of lookups that found the brick in the cache
+  long long hits_;
+  // Number of lookups that did not find the brick in the cache
+  long long misses_;
+  // Number of bricks added to the cache
+  long long insertions_;
+  // Number of bricks removed to make space for new ones
+  long long evictions_;
+  // Number of bricks currently in the cache
+  long long num_bricks_;
+  // Number of bytes currently in the cache
+  long long size_;
+  // Maximum number of bytes the cache is allowed to hold
+  long long capacity_;
+};
+
 class LargeVolumeCache
 {
   CORE_SINGLETON( LargeVolumeCache );
@@ -60,11 +85,37 @@ public:
   bool get_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
     const std::string& load_key, DataBlockHandle& data_block );
 
+  /// LOAD_BRICK
+  /// Queue a brick for loading. Coarser levels are loaded first and within a level
+  /// bricks with a smaller center_distance (distance to the center of the viewport)
+  /// are loaded first.
   void load_brick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
-    const std::string& load_key );
+    const std::string& load_key, double center_distance = 0.0 );
 
+  /// CLEAR_LOAD_QUEUE
+  /// Drop all pending load requests that were issued with this load key
   void clear_load_queue( const std::string& load_key );
 
+  /// GET_CACHE_CAPACITY
+  /// Get the maximum number of bytes used for caching bricks
+  long long get_cache_capacity() const;
+
+  /// SET_CACHE_CAPACITY
+  /// Set the maximum number of bytes used for caching bricks
+  void set_cache_capacity( long long capacity );
+
+  /// GET_STATISTICS
+  /// Get the hit, miss and eviction counters of the cache
+  LargeVolumeCacheStatistics get_statistics() const;
+
+  /// RESET_STATISTICS
+  /// Set the hit, miss, insertion and eviction counters back to zero
+  void reset_statistics();
+
+  /// GET_NUM_LOAD_THREADS
+  /// Number of worker threads that read and decompress bricks
+  int get_num_load_threads() const;
+
   boost::signals2::signal<void()> brick_loaded_signal_;
 
 private:
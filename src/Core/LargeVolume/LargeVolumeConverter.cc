@@ -27,15 +27,22 @@
  */
 
 #include <string>
+#include <cstring>
 #include <vector>
+#include <map>
+#include <fstream>
 #include <iomanip>
 
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+
 #include <Core/DataBlock/ITKDataBlock.h>
 #include <Core/DataBlock/ITKImage2DData.h>
 #include <Core/DataBlock/StdDataBlock.h>
 #include <Core/Geometry/IndexVector.h>
 #include <Core/Utils/FileUtil.h>
 #include <Core/Utils/Parallel.h>
+#include <Core/Utils/StringUtil.h>
 
 #include <itkPNGImageIO.h>
 #include <itkTIFFImageIO.h>
@@ -50,18 +57,25 @@
 namespace Core
 {
 
+// Slices with at least this many pixels are bricked and downsampled in parallel
+static const size_t PARALLEL_SLICE_SIZE_C = 1 << 20;
+
+// Sections are rendered in blocks of this many columns
+static const IndexVector::index_type SECTION_BLOCK_WIDTH_C = 1024;
+
 class LargeVolumeBrickLevel;
 typedef boost::shared_ptr<LargeVolumeBrickLevel> LargeVolumeBrickLevelHandle;
 
 class LargeVolumeBrickLevel
 {
 public:
-  LargeVolumeBrickLevel( LargeVolumeSchemaHandle schema, size_t level ) :
+  LargeVolumeBrickLevel( LargeVolumeSchemaHandle schema, size_t level, int num_threads ) :
     level_( level ),
     buffer_start_( 0 ),
     buffer_size_( 0 ),
     buffer_index_( 0 ),
     buffer_count_( 0 ),
+    num_threads_( num_threads ),
     schema_( schema )
   {
     this->layout_ = schema_->get_level_layout( this->level_ );
@@ -73,6 +87,7 @@ public:
   size_t buffer_size_;
   size_t buffer_index_;
   size_t buffer_count_;
+  int num_threads_;
 
   IndexVector layout_;
 
@@ -88,10 +103,21 @@ public:
 
   void allocate_buffers( size_t size );
 
+  template<class T>
+  void insert_slice_rows( DataBlockHandle slice, int thread, int num_threads );
   template<class T>
   bool insert_slice_internals( DataBlockHandle slice );
   bool insert_slice( DataBlockHandle slice );
   bool sync_buffers( bool done, std::string& error );
+
+  // Write all slices that are still buffered to the brick files
+  bool flush_buffers( std::string& error );
+
+  // Continue bricking after the given number of slices, which are already on disk
+  void restore( size_t count );
+
+private:
+  bool write_buffers( std::string& error );
 };
 
 void LargeVolumeBrickLevel::allocate_buffers( size_t size )
@@ -107,13 +133,17 @@ void LargeVolumeBrickLevel::allocate_buffers( size_t size )
 }
 
 template<class T>
-bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
+void LargeVolumeBrickLevel::insert_slice_rows( DataBlockHandle slice, int thread, int num_threads )
 {
+  // Each thread fills a consecutive range of brick rows
+  const IndexVector::index_type by_start = this->layout_.y() * thread / num_threads;
+  const IndexVector::index_type by_end = this->layout_.y() * ( thread + 1 ) / num_threads;
+
   const IndexVector::index_type overlap = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
   const IndexVector brick_size = this->schema_->get_brick_size();
   const IndexVector eff_brick_size =  this->schema_->get_effective_brick_size();
 
-  IndexVector::index_type k = 0;
+  IndexVector::index_type k = by_start * this->layout_.x();
 
   if (slice)
   {
@@ -121,7 +151,7 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
     IndexVector::index_type snx = slice->get_nx();
     IndexVector::index_type sny = slice->get_ny();
 
-    for ( IndexVector::index_type by = 0; by < this->layout_.y(); by++ )
+    for ( IndexVector::index_type by = by_start; by < by_end; by++ )
     {
       for ( IndexVector::index_type bx = 0; bx < this->layout_.x(); bx++, k++ )
       {
@@ -180,7 +210,7 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
   } 
   else
   {
-    for ( IndexVector::index_type by = 0; by < this->layout_.y(); by++ )
+    for ( IndexVector::index_type by = by_start; by < by_end; by++ )
     {
       for ( IndexVector::index_type bx = 0; bx < this->layout_.x(); bx++, k++ )
       {
@@ -200,6 +230,30 @@ bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
     }
   }
 
+}
+
+template<class T>
+bool LargeVolumeBrickLevel::insert_slice_internals( DataBlockHandle slice )
+{
+  // Only split large slices, for small ones starting the threads costs more than the copy
+  int num_threads = 1;
+  if ( slice && slice->get_nx() * slice->get_ny() >= PARALLEL_SLICE_SIZE_C )
+  {
+    num_threads = static_cast<int>( Min( static_cast<IndexVector::index_type>( this->num_threads_ ), 
+      this->layout_.y() ) );
+  }
+
+  if ( num_threads > 1 )
+  {
+    Parallel parallel( boost::bind( &LargeVolumeBrickLevel::insert_slice_rows<T>, this, slice, _1, _2 ),
+      num_threads );
+    parallel.run();
+  }
+  else
+  {
+    this->insert_slice_rows<T>( slice, 0, 1 );
+  }
+
   buffer_index_++;
   buffer_count_++;
 
@@ -242,57 +296,75 @@ bool LargeVolumeBrickLevel::sync_buffers( bool done, std::string& error )
 
   if ( done || this->buffer_index_ == this->buffer_size_ )
   {
-    IndexVector::index_type buffer_start = this->buffer_count_ - this->buffer_index_;
-    IndexVector::index_type buffer_size = this->buffer_count_ - buffer_start;
-        
-    IndexVector brick_size = this->schema_->get_brick_size();
-    IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
-    IndexVector::index_type overlap = this->schema_->get_overlap();
-    IndexVector level_size = this->schema_->get_level_size( this->level_ );
+    return this->write_buffers( error );
+  }
 
-    for (IndexVector::index_type z = 0; z < this->layout_.z(); z++)
-    {
-      IndexVector::index_type b_start = ( z * eff_brick_size.z() );
-      IndexVector::index_type b_end = ( Min( ( z + 1 ) * eff_brick_size.z(), level_size.z() ) ) + 2 * overlap;
+  return true;
+}
+
+bool LargeVolumeBrickLevel::flush_buffers( std::string& error )
+{
+  if ( this->buffer_index_ == 0 ) return true;
+  return this->write_buffers( error );
+}
+
+void LargeVolumeBrickLevel::restore( size_t count )
+{
+  this->buffer_index_ = 0;
+  this->buffer_count_ = count;
+}
 
-      IndexVector::index_type z_start = b_start - buffer_start;
-      IndexVector::index_type z_end = b_end - buffer_start;
+bool LargeVolumeBrickLevel::write_buffers( std::string& error )
+{
+  IndexVector::index_type buffer_start = this->buffer_count_ - this->buffer_index_;
+  IndexVector::index_type buffer_size = this->buffer_count_ - buffer_start;
+      
+  IndexVector brick_size = this->schema_->get_brick_size();
+  IndexVector eff_brick_size = this->schema_->get_effective_brick_size();
+  IndexVector::index_type overlap = this->schema_->get_overlap();
+  IndexVector level_size = this->schema_->get_level_size( this->level_ );
 
-      IndexVector::index_type start = Max( IndexVector::index_type( 0 ), z_start );
-      IndexVector::index_type end = Min( z_end , buffer_size );
+  for (IndexVector::index_type z = 0; z < this->layout_.z(); z++)
+  {
+    IndexVector::index_type b_start = ( z * eff_brick_size.z() );
+    IndexVector::index_type b_end = ( Min( ( z + 1 ) * eff_brick_size.z(), level_size.z() ) ) + 2 * overlap;
 
-            IndexVector::index_type offset = buffer_start + start - b_start;
-            
-      if ( end >= 0 && start < buffer_size && start < end)
-      {
+    IndexVector::index_type z_start = b_start - buffer_start;
+    IndexVector::index_type z_end = b_end - buffer_start;
 
-        std::cout << "saving buffers level " << this->level_ << ": 000000/000000";
+    IndexVector::index_type start = Max( IndexVector::index_type( 0 ), z_start );
+    IndexVector::index_type end = Min( z_end , buffer_size );
 
-        for (size_t k = 0; k < this->buffers_.size(); k++ )
-        {
+          IndexVector::index_type offset = buffer_start + start - b_start;
           
+    if ( end >= 0 && start < buffer_size && start < end)
+    {
 
-          IndexVector::index_type brick = k + z * (this->layout_.x() * this->layout_.y() );
-          BrickInfo bi( brick, this->level_ );
+      std::cout << "saving buffers level " << this->level_ << ": 000000/000000";
 
-          std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << (k+1) << "/" << std::setfill('0') << std::setw(6) << this->buffers_.size();
-          std::cout.flush();
+      for (size_t k = 0; k < this->buffers_.size(); k++ )
+      {
+        
 
-          if (! this->schema_->append_brick_buffer( this->buffers_[ k ], start, end, offset, bi, error ) )
-          {
-            return false;
-          }
+        IndexVector::index_type brick = k + z * (this->layout_.x() * this->layout_.y() );
+        BrickInfo bi( brick, this->level_ );
+
+        std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << (k+1) << "/" << std::setfill('0') << std::setw(6) << this->buffers_.size();
+        std::cout.flush();
+
+        if (! this->schema_->append_brick_buffer( this->buffers_[ k ], start, end, offset, bi, error ) )
+        {
+          return false;
         }
-        std::cout << std::endl;
       }
-
+      std::cout << std::endl;
     }
 
+  }
 
-    // reset ring buffer count
-    this->buffer_index_ = 0;
 
-  }
+  // reset ring buffer count
+  this->buffer_index_ = 0;
 
   return true;
 }
@@ -303,7 +375,19 @@ class LargeVolumeConverterPrivate {
 
 public:
   LargeVolumeConverterPrivate() :
-    data_type_( DataType::UNKNOWN_E )
+    data_type_( DataType::UNKNOWN_E ),
+    codec_( BrickCodecType::ZLIB_E ),
+    filter_( BrickFilterType::NONE_E ),
+    packed_( false ),
+    num_threads_( Max( 1, static_cast<int>( boost::thread::hardware_concurrency() ) ) ),
+    resume_( false ),
+    append_( false ),
+    phase_( 2 ),
+    start_slice_( 0 ),
+    append_size_( 0 ),
+    append_prepared_( false ),
+    min_( std::numeric_limits<double>::max() ),
+    max_( -std::numeric_limits<double>::max() )
   {}
 
   // -- input parameters --
@@ -320,10 +404,69 @@ public:
   IndexVector brick_size_;
   size_t overlap_;
 
+  BrickCodecType codec_;
+  BrickFilterType filter_;
+  bool packed_;
+
   long long mem_limit_;
+  int num_threads_;
 
   LargeVolumeSchemaHandle schema_;
 
+  // -- checkpoints --
+public:
+  // Continue a conversion that was interrupted
+  bool resume_;
+  // Add slices to the end of an existing volume
+  bool append_;
+
+  // Phase the conversion is in according to the checkpoint
+  size_t phase_;
+  // First slice of the stack that needs to be bricked
+  size_t start_slice_;
+  // Number of slices in the volume before appending, zero when not appending
+  size_t append_size_;
+  // Whether the bricks that are affected by appending have been prepared
+  bool append_prepared_;
+
+  double min_;
+  double max_;
+
+  /// GET_CHECKPOINT_FILE_NAME
+  /// File that records the progress of the conversion, it is removed once the volume is complete
+  boost::filesystem::path get_checkpoint_file_name() const;
+
+  /// WRITE_CHECKPOINT
+  /// Record the current progress of the conversion
+  bool write_checkpoint( std::string& error );
+
+  /// READ_CHECKPOINT
+  /// Read the progress of an interrupted conversion
+  bool read_checkpoint( std::string& error );
+
+  /// OPEN_EXISTING_VOLUME
+  /// Check that the existing volume matches the input for resuming or appending
+  bool open_existing_volume( std::string& error );
+
+  /// COMPUTE_RESTART_SLICE
+  /// Find the last slice at or before the given slice where the conversion can restart,
+  /// no partially downsampled slices are pending at such a slice
+  size_t compute_restart_slice( size_t slice ) const;
+
+  /// COMPUTE_PREFIX_ROWS
+  /// Number of slices of a brick layer that are stored on disk when the conversion
+  /// restarts at the given slice of the level
+  IndexVector::index_type compute_prefix_rows( size_t level, IndexVector::index_type z,
+    size_t level_slice ) const;
+
+  /// PREPARE_APPEND
+  /// Reduce the bricks that are affected by appending slices to the part that stays the same
+  bool prepare_append( std::string& error );
+
+  /// RESTORE_BRICKS
+  /// Cut the brick files back to the start slice and continue bricking from there
+  bool restore_bricks( std::string& error );
+
   // -- loaders --
 public:
   /// LOAD_FILE
@@ -347,21 +490,23 @@ public:
         const IndexVector& input_ratio, const IndexVector& output_ratio );
     
     /// DOWNSAMPLE_INTERNALS
-    /// Templated version that does internal computation
+    /// Templated version that does internal computation, when add is set the result is
+    /// averaged with the contents of the output slice
     template<class T, class U>
     bool downsample_internals( DataBlockHandle input, DataBlockHandle output,
-        const IndexVector& input_ratio, const IndexVector& output_ratio );
+        const IndexVector& input_ratio, const IndexVector& output_ratio, bool add );
+
+    /// DOWNSAMPLE_ROWS
+    /// Down sample the part of the output rows that is assigned to one thread
+    template<class T, class U>
+    void downsample_rows( DataBlockHandle input, DataBlockHandle output,
+        DataBlock::index_type ratio_x, DataBlock::index_type ratio_y, bool add, 
+        int thread, int num_threads );
 
     /// DOWNSAMPLE_ADD
     /// Down sample a slice based on the level ratios and adds it to the existing slice
     bool downsample_add( DataBlockHandle input, DataBlockHandle output,
         const IndexVector& input_ratio, const IndexVector& output_ratio );
-    
-    /// DOWNSAMPLE_ADD_INTERNALS
-    /// Templated version that does internal computation
-    template<class T, class U>
-    bool downsample_add_internals( DataBlockHandle input, DataBlockHandle output,
-        const IndexVector& input_ratio, const IndexVector& output_ratio );
 
     // -- min and max --
 public:
@@ -389,10 +534,479 @@ public:
 
   void run_phase3_parallel( int num_threads, int thread_num, boost::barrier& barrier  );
 
+  // -- sections --
+public:
+  // Source that renders the section, empty when converting an image stack
+  LargeVolumeSectionSourceHandle section_source_;
+
+  /// COMPUTE_SECTION_SLICES
+  /// Determine the number of slices of the volume the section is added to
+  bool compute_section_slices( std::string& error );
+
+  /// BRICK_SECTION
+  /// Render the section band by band and brick it as the next slice of the volume
+  bool brick_section( std::string& error );
+
+  /// RENDER_SECTION_BLOCKS
+  /// Render the blocks of a band of the section that are assigned to one thread
+  void render_section_blocks( DataBlockHandle band, IndexVector::index_type y, 
+    IndexVector::index_type num_rows, std::vector<std::string>* errors, 
+    std::vector<double>* min, std::vector<double>* max, int thread, int num_threads );
+
+  // Check whether a brick file already holds a compressed brick
+  bool is_brick_compressed( const BrickInfo& bi );
+
   bool success_;
 
 };
 
+// Decodes the files of the image stack on multiple threads ahead of the slice that
+// is being bricked. At most max_slices files are decoded or being decoded at any time,
+// which bounds the memory used by the read ahead.
+class LargeVolumeSliceReader : public boost::noncopyable
+{
+public:
+  LargeVolumeSliceReader( LargeVolumeConverterPrivate* converter, int num_threads, size_t max_slices,
+    size_t first_slice );
+  ~LargeVolumeSliceReader();
+
+  /// GET_SLICE
+  /// Wait for the next slice of the stack to be decoded
+  bool get_slice( DataBlockHandle& slice, double& min, double& max, std::string& error );
+
+private:
+  struct Slice
+  {
+    DataBlockHandle data_;
+    double min_;
+    double max_;
+    bool clipped_;
+    std::string error_;
+  };
+
+  void run();
+
+  LargeVolumeConverterPrivate* converter_;
+  size_t max_slices_;
+
+  // Next file that will be picked up by a reader thread
+  size_t next_file_;
+  // Next slice that will be handed out to the bricking thread
+  size_t next_slice_;
+  std::map< size_t, Slice > slices_;
+  bool done_;
+
+  boost::mutex mutex_;
+  boost::condition_variable slice_ready_;
+  boost::condition_variable slot_free_;
+  boost::thread_group threads_;
+};
+
+LargeVolumeSliceReader::LargeVolumeSliceReader( LargeVolumeConverterPrivate* converter,
+  int num_threads, size_t max_slices, size_t first_slice ) :
+  converter_( converter ),
+  max_slices_( Max( max_slices, static_cast<size_t>( 1 ) ) ),
+  next_file_( first_slice ),
+  next_slice_( first_slice ),
+  done_( false )
+{
+  for ( int j = 0; j < num_threads; j++ )
+  {
+    this->threads_.create_thread( boost::bind( &LargeVolumeSliceReader::run, this ) );
+  }
+}
+
+LargeVolumeSliceReader::~LargeVolumeSliceReader()
+{
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->done_ = true;
+  }
+  this->slot_free_.notify_all();
+  this->threads_.join_all();
+}
+
+void LargeVolumeSliceReader::run()
+{
+  const std::vector< boost::filesystem::path >& files = this->converter_->files_;
+  IndexVector total_size = this->converter_->schema_->get_size();
+
+  while ( true )
+  {
+    size_t file_idx;
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      while ( !this->done_ && this->next_file_ < files.size() && 
+        this->next_file_ >= this->next_slice_ + this->max_slices_ )
+      {
+        this->slot_free_.wait( lock );
+      }
+
+      if ( this->done_ || this->next_file_ >= files.size() ) return;
+      file_idx = this->next_file_++;
+    }
+
+    Slice slice;
+    slice.min_ = std::numeric_limits<double>::max();
+    slice.max_ = -std::numeric_limits<double>::max();
+    slice.clipped_ = false;
+    slice.data_ = this->converter_->load_file( files[ file_idx ], slice.error_ );
+
+    if ( slice.data_ )
+    {
+      if ( slice.data_->get_nx() != total_size.x() ||  slice.data_->get_ny() != total_size.y() )
+      {
+        DataBlock::Clip( slice.data_, slice.data_, total_size.x(), total_size.y(), 1, 0.0 );
+        slice.clipped_ = true;
+      }
+
+      if ( !this->converter_->compute_min_max( slice.data_, slice.min_, slice.max_ ) )
+      {
+        slice.data_.reset();
+        slice.error_ = "Could not compute min and max.";
+      }
+    }
+
+    {
+      boost::mutex::scoped_lock lock( this->mutex_ );
+      this->slices_[ file_idx ] = slice;
+    }
+    this->slice_ready_.notify_all();
+  }
+}
+
+bool LargeVolumeSliceReader::get_slice( DataBlockHandle& data, double& min, double& max, std::string& error )
+{
+  Slice slice;
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    std::map< size_t, Slice >::iterator it;
+    while ( ( it = this->slices_.find( this->next_slice_ ) ) == this->slices_.end() )
+    {
+      this->slice_ready_.wait( lock );
+    }
+
+    slice = it->second;
+    this->slices_.erase( it );
+    this->next_slice_++;
+  }
+  this->slot_free_.notify_all();
+
+  if ( !slice.data_ )
+  {
+    error = slice.error_;
+    return false;
+  }
+
+  if ( slice.clipped_ )
+  {
+    std::cout << "WARNING: Dimensions of the slices are not equal, clipping/padding image to fit dimensions of first image." <<std::endl;
+  }
+
+  data = slice.data_;
+  min = Min( min, slice.min_ );
+  max = Max( max, slice.max_ );
+  return true;
+}
+
+class LargeVolumeSectionLevel;
+typedef boost::shared_ptr<LargeVolumeSectionLevel> LargeVolumeSectionLevelHandle;
+
+// Bricks one level of a section while the section is produced from top to bottom. A level
+// only keeps the rows that are needed for the next row of bricks and for downsampling into
+// the next level, hence the memory used depends on the width of the section and not on its
+// height. Each row of bricks is appended as one slice to the bricks that contain the slice.
+class LargeVolumeSectionLevel
+{
+public:
+  LargeVolumeSectionLevel( LargeVolumeConverterPrivate* converter, size_t level, 
+    IndexVector::index_type slice );
+
+  /// ADD_ROWS
+  /// Add the first num_rows rows of the block to the level, rows are added from top to bottom
+  bool add_rows( DataBlockHandle rows, IndexVector::index_type num_rows, std::string& error );
+
+  /// ADD_EMPTY_SLICE
+  /// Append a slice of zeros to all the bricks of this level that contain the slice
+  bool add_empty_slice( IndexVector::index_type slice, std::string& error );
+
+  /// IS_DONE
+  /// Whether all rows of bricks have been written
+  bool is_done() const
+  {
+    return this->next_brick_row_ == this->layout_.y();
+  }
+
+  // Level that receives the downsampled rows, empty for the coarsest level
+  LargeVolumeSectionLevelHandle next_level_;
+
+private:
+  // Write the rows of bricks that are complete, downsample into the next level and drop
+  // the rows that are no longer needed
+  bool process_rows( std::string& error );
+
+  // Append the slice to the bricks in one row of bricks, an empty slice is written when
+  // empty is set
+  bool write_brick_row( IndexVector::index_type by, IndexVector::index_type slice, bool empty,
+    std::string& error );
+
+  void write_brick_row_parallel( IndexVector::index_type by, IndexVector::index_type slice, 
+    bool empty, std::vector<std::string>* errors, int thread, int num_threads );
+
+  LargeVolumeConverterPrivate* converter_;
+  LargeVolumeSchemaHandle schema_;
+  size_t level_;
+  // Slice of the bricks that the section is written to, including the leading overlap
+  IndexVector::index_type slice_;
+
+  IndexVector layout_;
+  IndexVector level_size_;
+  IndexVector eff_brick_size_;
+  IndexVector::index_type overlap_;
+  size_t element_size_;
+
+  // Rows of the level that are kept, starting at row first_row_
+  DataBlockHandle rows_;
+  IndexVector::index_type first_row_;
+  IndexVector::index_type num_rows_;
+
+  IndexVector::index_type next_brick_row_;
+  // Next row of the next level and the number of rows that are averaged into it
+  IndexVector::index_type next_down_row_;
+  IndexVector::index_type ratio_y_;
+};
+
+LargeVolumeSectionLevel::LargeVolumeSectionLevel( LargeVolumeConverterPrivate* converter, 
+  size_t level, IndexVector::index_type slice ) :
+  converter_( converter ),
+  schema_( converter->schema_ ),
+  level_( level ),
+  slice_( slice ),
+  first_row_( 0 ),
+  num_rows_( 0 ),
+  next_brick_row_( 0 ),
+  next_down_row_( 0 ),
+  ratio_y_( 1 )
+{
+  this->layout_ = this->schema_->get_level_layout( level );
+  this->level_size_ = this->schema_->get_level_size( level );
+  this->eff_brick_size_ = this->schema_->get_effective_brick_size();
+  this->overlap_ = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
+  this->element_size_ = GetSizeDataType( this->schema_->get_data_type() );
+
+  if ( level + 1 < this->schema_->get_num_levels() )
+  {
+    IndexVector::index_type ratio = this->schema_->get_level_downsample_ratio( level + 1 ).y() /
+      this->schema_->get_level_downsample_ratio( level ).y();
+    this->ratio_y_ = ( ratio == 2 ) ? 2 : 1;
+  }
+
+  // A row of bricks needs the effective brick size plus the overlap on both sides, the
+  // extra rows leave room for rows that still need to be downsampled
+  IndexVector::index_type capacity = Min( this->eff_brick_size_.y() + 2 * this->overlap_ + 2,
+    this->level_size_.y() );
+  this->rows_ = StdDataBlock::New( this->level_size_.x(), capacity, 1, 
+    this->schema_->get_data_type() );
+}
+
+bool LargeVolumeSectionLevel::add_rows( DataBlockHandle rows, IndexVector::index_type num_rows, 
+  std::string& error )
+{
+  const size_t row_size = this->level_size_.x() * this->element_size_;
+  const IndexVector::index_type capacity = static_cast<IndexVector::index_type>( this->rows_->get_ny() );
+  const char* src = reinterpret_cast<const char*>( rows->get_data() );
+
+  while ( num_rows > 0 )
+  {
+    IndexVector::index_type count = Min( num_rows, capacity - this->num_rows_ );
+    if ( count <= 0 )
+    {
+      error = "Rows of the section were not consumed.";
+      return false;
+    }
+
+    char* dst = reinterpret_cast<char*>( this->rows_->get_data() ) + this->num_rows_ * row_size;
+    std::memcpy( dst, src, count * row_size );
+    this->num_rows_ += count;
+    src += count * row_size;
+    num_rows -= count;
+
+    if ( !this->process_rows( error ) ) return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeSectionLevel::process_rows( std::string& error )
+{
+  const IndexVector::index_type ny = this->level_size_.y();
+  const IndexVector::index_type end_row = this->first_row_ + this->num_rows_;
+
+  // Write the rows of bricks that have all their rows
+  while ( this->next_brick_row_ < this->layout_.y() )
+  {
+    IndexVector::index_type by = this->next_brick_row_;
+    if ( end_row < Min( ( by + 1 ) * this->eff_brick_size_.y() + this->overlap_, ny ) ) break;
+
+    if ( !this->write_brick_row( by, this->slice_, false, error ) ) return false;
+    this->next_brick_row_++;
+  }
+
+  // Downsample the rows that are complete into the next level
+  if ( this->next_level_ )
+  {
+    IndexVector::index_type next_ny = ( ny + this->ratio_y_ - 1 ) / this->ratio_y_;
+    IndexVector::index_type down_end = ( end_row == ny ) ? next_ny : end_row / this->ratio_y_;
+    IndexVector::index_type count = down_end - this->next_down_row_;
+
+    if ( count > 0 )
+    {
+      IndexVector::index_type row_start = this->next_down_row_ * this->ratio_y_;
+      IndexVector::index_type row_count = Min( count * this->ratio_y_, ny - row_start );
+      const size_t row_size = this->level_size_.x() * this->element_size_;
+
+      DataBlockHandle input = StdDataBlock::New( this->level_size_.x(), row_count, 1,
+        this->schema_->get_data_type() );
+      DataBlockHandle output = StdDataBlock::New( this->next_level_->level_size_.x(), count, 1,
+        this->schema_->get_data_type() );
+      std::memcpy( input->get_data(), reinterpret_cast<char*>( this->rows_->get_data() ) +
+        ( row_start - this->first_row_ ) * row_size, row_count * row_size );
+
+      if ( !this->converter_->downsample( input, output, 
+        this->schema_->get_level_downsample_ratio( this->level_ ),
+        this->schema_->get_level_downsample_ratio( this->level_ + 1 ) ) )
+      {
+        error = "Failed to downsample section.";
+        return false;
+      }
+
+      this->next_down_row_ = down_end;
+      if ( !this->next_level_->add_rows( output, count, error ) ) return false;
+    }
+  }
+
+  // Drop the rows that neither the next row of bricks nor the next level need
+  IndexVector::index_type keep = end_row;
+  if ( this->next_brick_row_ < this->layout_.y() )
+  {
+    keep = Max( this->next_brick_row_ * this->eff_brick_size_.y() - this->overlap_,
+      static_cast<IndexVector::index_type>( 0 ) );
+  }
+  if ( this->next_level_ )
+  {
+    keep = Min( keep, this->next_down_row_ * this->ratio_y_ );
+  }
+
+  if ( keep > this->first_row_ )
+  {
+    const size_t row_size = this->level_size_.x() * this->element_size_;
+    IndexVector::index_type drop = Min( keep - this->first_row_, this->num_rows_ );
+    char* data = reinterpret_cast<char*>( this->rows_->get_data() );
+    std::memmove( data, data + drop * row_size, ( this->num_rows_ - drop ) * row_size );
+    this->first_row_ += drop;
+    this->num_rows_ -= drop;
+  }
+
+  return true;
+}
+
+bool LargeVolumeSectionLevel::add_empty_slice( IndexVector::index_type slice, std::string& error )
+{
+  for ( IndexVector::index_type by = 0; by < this->layout_.y(); by++ )
+  {
+    if ( !this->write_brick_row( by, slice, true, error ) ) return false;
+  }
+  return true;
+}
+
+bool LargeVolumeSectionLevel::write_brick_row( IndexVector::index_type by, 
+  IndexVector::index_type slice, bool empty, std::string& error )
+{
+  // Wide levels have many bricks per row, which are all separate files
+  int num_threads = static_cast<int>( Min( static_cast<IndexVector::index_type>( 
+    this->converter_->num_threads_ ), this->layout_.x() ) );
+  std::vector<std::string> errors( num_threads );
+
+  if ( num_threads > 1 )
+  {
+    Parallel parallel( boost::bind( &LargeVolumeSectionLevel::write_brick_row_parallel, this,
+      by, slice, empty, &errors, _1, _2 ), num_threads );
+    parallel.run();
+  }
+  else
+  {
+    this->write_brick_row_parallel( by, slice, empty, &errors, 0, 1 );
+  }
+
+  for ( size_t j = 0; j < errors.size(); j++ )
+  {
+    if ( !errors[ j ].empty() )
+    {
+      error = errors[ j ];
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void LargeVolumeSectionLevel::write_brick_row_parallel( IndexVector::index_type by, 
+  IndexVector::index_type slice, bool empty, std::vector<std::string>* errors, 
+  int thread, int num_threads )
+{
+  const IndexVector::index_type nx = this->level_size_.x();
+  const IndexVector::index_type ny = this->level_size_.y();
+  const IndexVector::index_type nz = this->level_size_.z();
+  const IndexVector::index_type nxy = this->layout_.x() * this->layout_.y();
+  const size_t row_size = nx * this->element_size_;
+  const char* rows = reinterpret_cast<const char*>( this->rows_->get_data() );
+
+  for ( IndexVector::index_type bx = thread; bx < this->layout_.x(); bx += num_threads )
+  {
+    BrickInfo first_bi( bx + by * this->layout_.x(), this->level_ );
+    IndexVector brick_size = this->schema_->get_brick_size( first_bi );
+    DataBlockHandle brick = StdDataBlock::New( brick_size.x(), brick_size.y(), 1,
+      this->schema_->get_data_type() );
+    brick->clear();
+
+    if ( !empty )
+    {
+      // Copy the part of the brick that lies within the level, the overlap outside of the
+      // level stays zero
+      IndexVector::index_type sx_begin = bx * this->eff_brick_size_.x() - this->overlap_;
+      IndexVector::index_type sy_begin = by * this->eff_brick_size_.y() - this->overlap_;
+      IndexVector::index_type x_begin = Max( sx_begin, static_cast<IndexVector::index_type>( 0 ) );
+      IndexVector::index_type x_end = Min( sx_begin + brick_size.x(), nx );
+      IndexVector::index_type y_begin = Max( sy_begin, static_cast<IndexVector::index_type>( 0 ) );
+      IndexVector::index_type y_end = Min( sy_begin + brick_size.y(), ny );
+      size_t brick_row_size = brick_size.x() * this->element_size_;
+
+      for ( IndexVector::index_type y = y_begin; y < y_end; y++ )
+      {
+        std::memcpy( reinterpret_cast<char*>( brick->get_data() ) + ( y - sy_begin ) * brick_row_size +
+          ( x_begin - sx_begin ) * this->element_size_, rows + ( y - this->first_row_ ) * row_size + 
+          x_begin * this->element_size_, ( x_end - x_begin ) * this->element_size_ );
+      }
+    }
+
+    // A slice in the overlap between two layers of bricks goes into both
+    for ( IndexVector::index_type bz = 0; bz < this->layout_.z(); bz++ )
+    {
+      IndexVector::index_type b_start = bz * this->eff_brick_size_.z();
+      IndexVector::index_type b_end = Min( ( bz + 1 ) * this->eff_brick_size_.z(), nz ) + 
+        2 * this->overlap_;
+      if ( slice < b_start || slice >= b_end ) continue;
+
+      BrickInfo bi( first_bi.index_ + bz * nxy, this->level_ );
+      if ( !this->schema_->append_brick_buffer( brick, 0, 1, slice - b_start, bi, 
+        ( *errors )[ thread ] ) )
+      {
+        return;
+      }
+    }
+  }
+}
+
 template<class T>
 bool LargeVolumeConverterPrivate::compute_min_max_internals( DataBlockHandle slice, double& min, double& max )
 {
@@ -691,92 +1305,83 @@ bool LargeVolumeConverterPrivate::scan_file( const boost::filesystem::path& file
 
 
 template<class T, class U>
-bool LargeVolumeConverterPrivate::downsample_internals( DataBlockHandle input, DataBlockHandle output,
-    const IndexVector& input_ratio, const IndexVector& output_ratio )
+void LargeVolumeConverterPrivate::downsample_rows( DataBlockHandle input, DataBlockHandle output,
+    DataBlock::index_type ratio_x, DataBlock::index_type ratio_y, bool add, int thread, int num_threads )
 {
-    DataBlock::index_type ratio_x = output_ratio.x() / input_ratio.x();
-    DataBlock::index_type ratio_y = output_ratio.y() / input_ratio.y();
-
-    T* src = reinterpret_cast<T*>( input->get_data() );
+    const T* src = reinterpret_cast<T*>( input->get_data() );
     T* dst = reinterpret_cast<T*>( output->get_data() );
 
     DataBlock::index_type nx = input->get_nx();
     DataBlock::index_type ny = input->get_ny();
+    DataBlock::index_type onx = ( nx + ratio_x - 1 ) / ratio_x;
+    DataBlock::index_type ony = ( ny + ratio_y - 1 ) / ratio_y;
 
-    if ( ratio_x == 2 && ratio_y == 2 )
+    // Each thread computes a consecutive range of output rows
+    DataBlock::index_type oy_start = ony * thread / num_threads;
+    DataBlock::index_type oy_end = ony * ( thread + 1 ) / num_threads;
+
+    for ( DataBlock::index_type oy = oy_start; oy < oy_end; oy++ )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
+        // Rows and columns on the edge of an odd sized slice average fewer samples
+        const DataBlock::index_type nys = Min( ratio_y, ny - oy * ratio_y );
+        const T* row0 = src + oy * ratio_y * nx;
+        const T* row1 = ( nys == 2 ) ? row0 + nx : 0;
+        T* drow = dst + oy * onx;
+
+        for ( DataBlock::index_type ox = 0; ox < onx; ox++ )
         {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 4 );
-            }
-        
-            if (nx % 2)
+            const DataBlock::index_type x = ox * ratio_x;
+            const DataBlock::index_type nxs = Min( ratio_x, nx - x );
+
+            U sum = static_cast<U>( row0[ x ] );
+            if ( nxs == 2 ) sum += static_cast<U>( row0[ x + 1 ] );
+            if ( row1 )
             {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 2 );
-                dst++;
-                src++;
+                sum += static_cast<U>( row1[ x ] );
+                if ( nxs == 2 ) sum += static_cast<U>( row1[ x + 1 ] );
             }
-        }
-        
-        if ( ny % 2 )
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
+
+            const U count = static_cast<U>( nxs * nys );
+            if ( add )
             {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 2 );
+                // Average with the slice that was downsampled previously
+                drow[ ox ] = static_cast<T>( ( static_cast<U>( drow[ ox ] ) * count + sum ) / ( count * 2 ) );
             }
-        
-            if (nx % 2)
+            else
             {
-                *dst = *src;
-                dst++;
-                src++;
+                drow[ ox ] = static_cast<T>( sum / count );
             }
         }
     }
-    else if ( ratio_x == 2 && ratio_y == 1 )
-    {
-        for ( DataBlock::index_type y = 0; y < ny; y ++)
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 2 );
-            }
-        
-            if (nx % 2)
-            {
-                *dst = *src;
-                dst++;
-                src++;
-            }
-        }
+}
+
+template<class T, class U>
+bool LargeVolumeConverterPrivate::downsample_internals( DataBlockHandle input, DataBlockHandle output,
+    const IndexVector& input_ratio, const IndexVector& output_ratio, bool add )
+{
+    // Only factors of two are used between levels, anything else is copied
+    DataBlock::index_type ratio_x = output_ratio.x() / input_ratio.x();
+    DataBlock::index_type ratio_y = output_ratio.y() / input_ratio.y();
+    if ( ratio_x != 2 ) ratio_x = 1;
+    if ( ratio_y != 2 ) ratio_y = 1;
+
+    DataBlock::index_type ony = ( input->get_ny() + ratio_y - 1 ) / ratio_y;
+
+    int num_threads = 1;
+    if ( input->get_nx() * input->get_ny() >= PARALLEL_SLICE_SIZE_C )
+    {
+        num_threads = static_cast<int>( Min( static_cast<DataBlock::index_type>( this->num_threads_ ), ony ) );
     }
-    else if ( ratio_x == 1 && ratio_y == 2 )
+
+    if ( num_threads > 1 )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
-        {
-            for ( DataBlock::index_type x = 0; x < nx; x++, src ++, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 2 );
-            }
-        }
-        
-        if ( ny % 2 )
-        {
-            for ( DataBlock::index_type x = 0; x < nx; x ++, src ++, dst++ )
-            {
-                *dst = *src;
-            }
-        }
+        Parallel parallel( boost::bind( &LargeVolumeConverterPrivate::downsample_rows<T, U>, this,
+            input, output, ratio_x, ratio_y, add, _1, _2 ), num_threads );
+        parallel.run();
     }
     else
     {
-        DataBlock::index_type nxy = nx * ny;
-        for ( DataBlock::index_type k = 0; k < nxy; k++, src++, dst++  )
-        {
-            *dst = *src;
-        }
+        this->downsample_rows<T, U>( input, output, ratio_x, ratio_y, add, 0, 1 );
     }
     
     return true;
@@ -793,148 +1398,655 @@ bool LargeVolumeConverterPrivate::downsample( DataBlockHandle input, DataBlockHa
     switch( input->get_data_type() )
     {
         case DataType::UCHAR_E:
-            return this->downsample_internals<unsigned char, unsigned short>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<unsigned char, unsigned short>( input, output, input_ratio, output_ratio, false );
         case DataType::CHAR_E:
-            return this->downsample_internals<signed char, short>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<signed char, short>( input, output, input_ratio, output_ratio, false );
         case DataType::USHORT_E:
-            return this->downsample_internals<unsigned short, unsigned int>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<unsigned short, unsigned int>( input, output, input_ratio, output_ratio, false );
         case DataType::SHORT_E:
-            return this->downsample_internals<short, int>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<short, int>( input, output, input_ratio, output_ratio, false );
         case DataType::UINT_E:
-            return this->downsample_internals<unsigned int, unsigned long long>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<unsigned int, unsigned long long>( input, output, input_ratio, output_ratio, false );
         case DataType::INT_E:
-            return this->downsample_internals<int, long long>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<int, long long>( input, output, input_ratio, output_ratio, false );
         case DataType::FLOAT_E:
-            return this->downsample_internals<float, float>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<float, float>( input, output, input_ratio, output_ratio, false );
         case DataType::DOUBLE_E:
-            return this->downsample_internals<double, double>( input, output, input_ratio, output_ratio );
+            return this->downsample_internals<double, double>( input, output, input_ratio, output_ratio, false );
     }
     
     return false;
 }
 
-template<class T, class U>
-bool LargeVolumeConverterPrivate::downsample_add_internals( DataBlockHandle input, DataBlockHandle output,
+bool LargeVolumeConverterPrivate::downsample_add( DataBlockHandle input, DataBlockHandle output,
     const IndexVector& input_ratio, const IndexVector& output_ratio )
 {
-    DataBlock::index_type ratio_x = output_ratio.x() / input_ratio.x();
-    DataBlock::index_type ratio_y = output_ratio.y() / input_ratio.y();
+    if ( input->get_data_type() != output->get_data_type() )
+    {
+        return false;
+    }
+    
+    switch( input->get_data_type() )
+    {
+        case DataType::UCHAR_E:
+            return this->downsample_internals<unsigned char, unsigned short>( input, output, input_ratio, output_ratio, true );
+        case DataType::CHAR_E:
+            return this->downsample_internals<signed char, short>( input, output, input_ratio, output_ratio, true );
+        case DataType::USHORT_E:
+            return this->downsample_internals<unsigned short, unsigned int>( input, output, input_ratio, output_ratio, true );
+        case DataType::SHORT_E:
+            return this->downsample_internals<short, int>( input, output, input_ratio, output_ratio, true );
+        case DataType::UINT_E:
+            return this->downsample_internals<unsigned int, unsigned long long>( input, output, input_ratio, output_ratio, true );
+        case DataType::INT_E:
+            return this->downsample_internals<int, long long>( input, output, input_ratio, output_ratio, true );
+        case DataType::FLOAT_E:
+            return this->downsample_internals<float, float>( input, output, input_ratio, output_ratio, true );
+        case DataType::DOUBLE_E:
+            return this->downsample_internals<double, double>( input, output, input_ratio, output_ratio, true );
+    }
+    
+    return false;
+}
 
-    T* src = reinterpret_cast<T*>( input->get_data() );
-    T* dst = reinterpret_cast<T*>( output->get_data() );
 
-    DataBlock::index_type nx = input->get_nx();
-    DataBlock::index_type ny = input->get_ny();
+// Check whether two schemas divide the volume into the same bricks and levels
+static bool CompareSchemaLayout( LargeVolumeSchemaHandle a, LargeVolumeSchemaHandle b, 
+  bool compare_z, std::string& error )
+{
+  if ( a->get_nx() != b->get_nx() || a->get_ny() != b->get_ny() ||
+    ( compare_z && a->get_nz() != b->get_nz() ) )
+  {
+    error = "The size of the existing volume does not match the image stack.";
+    return false;
+  }
+
+  if ( a->get_brick_size() != b->get_brick_size() || a->get_overlap() != b->get_overlap() ||
+    a->get_data_type() != b->get_data_type() )
+  {
+    error = "The existing volume was created with a different brick size, overlap or data type.";
+    return false;
+  }
+
+  if ( a->get_num_levels() != b->get_num_levels() )
+  {
+    error = "The number of resolution levels of the existing volume does not match, "
+      "the volume needs to be converted again.";
+    return false;
+  }
 
-    if ( ratio_x == 2 && ratio_y == 2 )
+  for ( size_t j = 0; j < a->get_num_levels(); j++ )
+  {
+    if ( a->get_level_downsample_ratio( j ) != b->get_level_downsample_ratio( j ) )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 4 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) + static_cast<U>( src[nx] ) +  static_cast<U>( src[nx+1] ) ) / 8 );
-            }
-        
-            if (nx % 2)
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 4 );
-                dst++;
-                src++;
-            }
-        }
-        
-        if ( ny % 2 )
-        {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) +  static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
-            }
-        
-            if (nx % 2)
-            {
-                *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-                dst++;
-                src++;
-            }
-        }
+      error = "The resolution levels of the existing volume do not match, "
+        "the volume needs to be converted again.";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+boost::filesystem::path LargeVolumeConverterPrivate::get_checkpoint_file_name() const
+{
+  return this->schema_->get_dir() / "conversion.txt";
+}
+
+bool LargeVolumeConverterPrivate::write_checkpoint( std::string& error )
+{
+  boost::filesystem::path filename = this->get_checkpoint_file_name();
+  boost::filesystem::path tmp_filename = filename.string() + ".tmp";
+
+  // Write a new file and swap it in, so there is always a complete checkpoint on disk
+  try
+  {
+    std::ofstream text_file( tmp_filename.string().c_str() );
+    text_file << "phase: " << ExportToString( this->phase_ ) << std::endl;
+    text_file << "slice: " << ExportToString( this->start_slice_ ) << std::endl;
+    text_file << "min: " << ExportToString( this->min_ ) << std::endl;
+    text_file << "max: " << ExportToString( this->max_ ) << std::endl;
+    if ( this->append_size_ > 0 )
+    {
+      text_file << "append: " << ExportToString( this->append_size_ ) << std::endl;
+      text_file << "prepared: " << ( this->append_prepared_ ? "true" : "false" ) << std::endl;
+    }
+    text_file.close();
+
+    if ( !text_file )
+    {
+      error = "Could not write checkpoint file '" + tmp_filename.string() + "'.";
+      return false;
     }
-    else if ( ratio_x == 2 && ratio_y == 1 )
+
+    boost::filesystem::rename( tmp_filename, filename );
+  }
+  catch ( ... )
+  {
+    error = "Could not write checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::read_checkpoint( std::string& error )
+{
+  boost::filesystem::path filename = this->get_checkpoint_file_name();
+  std::map<std::string,std::string> values;
+
+  try
+  {
+    std::ifstream text_file( filename.string().c_str() );
+    std::string line;
+    while ( std::getline( text_file, line ) )
     {
-        for ( DataBlock::index_type y = 0; y < ny; y ++)
+      std::vector<std::string> key_value = SplitString( line, ":" );
+      if ( key_value.size() == 2 )
+      {
+        std::string val = key_value[ 1 ];
+        StripSurroundingSpaces( val );
+        values[ key_value[ 0 ] ] = val;
+      }
+    }
+  }
+  catch ( ... )
+  {
+    error = "Could not read checkpoint file '" + filename.string() + "'.";
+    return false;
+  }
+
+  if ( !ImportFromString( values[ "phase" ], this->phase_ ) ||
+    !ImportFromString( values[ "slice" ], this->start_slice_ ) ||
+    !ImportFromString( values[ "min" ], this->min_ ) ||
+    !ImportFromString( values[ "max" ], this->max_ ) )
+  {
+    error = "Checkpoint file '" + filename.string() + "' is incomplete.";
+    return false;
+  }
+
+  this->append_size_ = 0;
+  this->append_prepared_ = false;
+  if ( values.find( "append" ) != values.end() )
+  {
+    if ( !ImportFromString( values[ "append" ], this->append_size_ ) ||
+      !ImportFromString( values[ "prepared" ], this->append_prepared_ ) )
+    {
+      error = "Checkpoint file '" + filename.string() + "' is incomplete.";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LargeVolumeConverterPrivate::open_existing_volume( std::string& error )
+{
+  LargeVolumeSchemaHandle existing( new LargeVolumeSchema );
+  existing->set_dir( this->schema_->get_dir() );
+  if ( !existing->load( error ) )
+  {
+    error = "Could not read existing volume: " + error;
+    return false;
+  }
+
+  bool has_checkpoint = boost::filesystem::exists( this->get_checkpoint_file_name() );
+
+  if ( this->resume_ )
+  {
+    if ( !has_checkpoint )
+    {
+      error = "The volume does not contain an interrupted conversion.";
+      return false;
+    }
+
+    if ( !this->read_checkpoint( error ) ) return false;
+
+    // When the conversion was interrupted while preparing to append slices, 
+    // the volume file still describes the volume before appending
+    bool before_append = this->append_size_ > 0 && !this->append_prepared_;
+    if ( !CompareSchemaLayout( existing, this->schema_, !before_append, error ) )
+    {
+      return false;
+    }
+
+    if ( this->phase_ == 3 )
+    {
+      this->min_ = existing->get_min();
+      this->max_ = existing->get_max();
+    }
+  }
+  else
+  {
+    if ( has_checkpoint )
+    {
+      error = "The volume contains an unfinished conversion, which needs to be resumed first.";
+      return false;
+    }
+
+    if ( existing->is_packed() )
+    {
+      error = "Slices can only be appended to volumes that store one file per brick.";
+      return false;
+    }
+
+    if ( !CompareSchemaLayout( existing, this->schema_, false, error ) )
+    {
+      return false;
+    }
+
+    if ( existing->get_nz() >= this->schema_->get_nz() )
+    {
+      error = "The image stack does not contain any slices beyond the existing volume.";
+      return false;
+    }
+
+    this->phase_ = 2;
+    this->append_size_ = existing->get_nz();
+    this->append_prepared_ = false;
+    this->start_slice_ = this->compute_restart_slice( this->append_size_ );
+    this->min_ = existing->get_min();
+    this->max_ = existing->get_max();
+  }
+
+  // Bricks that are kept need to be decoded with the codec the volume was created with
+  this->schema_->set_compression( existing->get_codec() != BrickCodecType::NONE_E );
+  this->schema_->set_codec( existing->get_codec(), existing->get_filter() );
+  this->schema_->set_min_max( this->min_, this->max_ );
+
+  return true;
+}
+
+size_t LargeVolumeConverterPrivate::compute_restart_slice( size_t slice ) const
+{
+  // The coarsest level has the largest downsample ratio in z, at multiples of it
+  // every level has completed its downsampled slices
+  size_t num_levels = this->schema_->get_num_levels();
+  size_t ratio = static_cast<size_t>( this->schema_->get_level_downsample_ratio( num_levels - 1 ).z() );
+  return ( slice / ratio ) * ratio;
+}
+
+IndexVector::index_type LargeVolumeConverterPrivate::compute_prefix_rows( size_t level, 
+  IndexVector::index_type z, size_t level_slice ) const
+{
+  // A restart at the first slice adds the leading overlap again
+  if ( level_slice == 0 ) return 0;
+
+  // Slices are counted including the leading overlap, as they are in the brick buffers
+  IndexVector::index_type overlap = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
+  IndexVector::index_type eff_brick_size_z = this->schema_->get_effective_brick_size().z();
+  IndexVector::index_type rows = static_cast<IndexVector::index_type>( level_slice ) + overlap - z * eff_brick_size_z;
+
+  return Max( rows, static_cast<IndexVector::index_type>( 0 ) );
+}
+
+bool LargeVolumeConverterPrivate::prepare_append( std::string& error )
+{
+  namespace bfs = boost::filesystem;
+  size_t num_levels = this->schema_->get_num_levels();
+  size_t element_size = GetSizeDataType( this->schema_->get_data_type() );
+
+  if ( !this->append_prepared_ )
+  {
+    LargeVolumeSchemaHandle old_schema( new LargeVolumeSchema );
+    old_schema->set_dir( this->schema_->get_dir() );
+    if ( !old_schema->load( error ) ) return false;
+
+    // Record where the conversion restarts before any brick is changed
+    if ( !this->write_checkpoint( error ) ) return false;
+
+    std::cout << "Preparing bricks for appending slices" << std::endl;
+
+    // Copy the slices that stay the same into new raw brick files next to the existing bricks
+    for ( size_t j = 0; j < num_levels; j++ )
+    {
+      size_t level_slice = this->start_slice_ / this->schema_->get_level_downsample_ratio( j ).z();
+      IndexVector layout = this->schema_->get_level_layout( j );
+      IndexVector old_layout = old_schema->get_level_layout( j );
+      IndexVector::index_type nxy = layout.x() * layout.y();
+      IndexVector::index_type eff_brick_size_z = this->schema_->get_effective_brick_size().z();
+
+      for ( IndexVector::index_type z = 0; z < layout.z(); z++ )
+      {
+        IndexVector::index_type rows = this->compute_prefix_rows( j, z, level_slice );
+        IndexVector::index_type layer_size = this->schema_->get_brick_size( BrickInfo( z * nxy, j ) ).z();
+        if ( rows == 0 || rows >= layer_size ) continue;
+
+        // A new layer starts with the overlap that is stored at the end of the last existing layer
+        IndexVector::index_type old_z = Min( z, old_layout.z() - 1 );
+        IndexVector::index_type row_offset = ( z - old_z ) * eff_brick_size_z;
+
+        for ( IndexVector::index_type k = 0; k < nxy; k++ )
         {
-            for ( DataBlock::index_type x = 0; x < (nx-1); x += 2, src += 2, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[1] ) ) / 4 );
-            }
-        
-            if (nx % 2)
+          BrickInfo bi( k + z * nxy, j );
+          bfs::path prefix_file = this->schema_->get_brick_file_name( bi ).string() + ".append";
+          if ( bfs::exists( prefix_file ) ) continue;
+
+          DataBlockHandle brick;
+          if ( !old_schema->read_brick( brick, BrickInfo( k + old_z * nxy, j ), error ) ) return false;
+
+          size_t row_size = brick->get_nx() * brick->get_ny() * element_size;
+          if ( row_offset + rows > static_cast<IndexVector::index_type>( brick->get_nz() ) )
+          {
+            error = "Existing brick is smaller than expected.";
+            return false;
+          }
+
+          bfs::path tmp_file = prefix_file.string() + ".tmp";
+          try
+          {
+            std::ofstream output( tmp_file.string().c_str(), std::ios_base::trunc | 
+              std::ios_base::binary | std::ios_base::out );
+            output.write( reinterpret_cast<char*>( brick->get_data() ) + row_offset * row_size, 
+              rows * row_size );
+            output.close();
+            if ( !output )
             {
-                *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-                dst++;
-                src++;
+              error = "Could not write to file '" + tmp_file.string() + "'.";
+              return false;
             }
+            bfs::rename( tmp_file, prefix_file );
+          }
+          catch ( ... )
+          {
+            error = "Could not write to file '" + tmp_file.string() + "'.";
+            return false;
+          }
         }
+      }
     }
-    else if ( ratio_x == 1 && ratio_y == 2 )
+
+    this->append_prepared_ = true;
+    if ( !this->write_checkpoint( error ) ) return false;
+  }
+
+  // From here on the volume file describes the volume after appending
+  if ( !this->schema_->save( error ) ) return false;
+
+  // Swap in the reduced bricks and remove bricks that will be rebuilt completely
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    size_t level_slice = this->start_slice_ / this->schema_->get_level_downsample_ratio( j ).z();
+    IndexVector layout = this->schema_->get_level_layout( j );
+    IndexVector::index_type nxy = layout.x() * layout.y();
+
+    for ( IndexVector::index_type z = 0; z < layout.z(); z++ )
     {
-        for ( DataBlock::index_type y = 0; y < (ny-1); y += 2, src+= nx )
+      IndexVector::index_type rows = this->compute_prefix_rows( j, z, level_slice );
+      IndexVector::index_type layer_size = this->schema_->get_brick_size( BrickInfo( z * nxy, j ) ).z();
+      if ( rows >= layer_size ) continue;
+
+      for ( IndexVector::index_type k = 0; k < nxy; k++ )
+      {
+        BrickInfo bi( k + z * nxy, j );
+        bfs::path brick_file = this->schema_->get_brick_file_name( bi );
+        bfs::path prefix_file = brick_file.string() + ".append";
+
+        try
         {
-            for ( DataBlock::index_type x = 0; x < nx; x++, src++, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( dst[0] * 2 ) + static_cast<U>( src[0] ) + static_cast<U>( src[nx] ) ) / 4 );
-            }
+          if ( rows == 0 )
+          {
+            bfs::remove( brick_file );
+          }
+          else if ( bfs::exists( prefix_file ) )
+          {
+            bfs::rename( prefix_file, brick_file );
+          }
         }
-        
-        if ( ny % 2 )
+        catch ( ... )
         {
-            for ( DataBlock::index_type x = 0; x < nx; x ++, src++, dst++ )
-            {
-                *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
-            }
+          error = "Could not replace brick file '" + brick_file.string() + "'.";
+          return false;
         }
+      }
     }
-    else
+  }
+
+  this->append_size_ = 0;
+  this->append_prepared_ = false;
+  return this->write_checkpoint( error );
+}
+
+bool LargeVolumeConverterPrivate::restore_bricks( std::string& error )
+{
+  namespace bfs = boost::filesystem;
+  size_t num_levels = this->schema_->get_num_levels();
+  size_t element_size = GetSizeDataType( this->schema_->get_data_type() );
+  IndexVector::index_type overlap = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    size_t level_slice = this->start_slice_ / this->schema_->get_level_downsample_ratio( j ).z();
+    IndexVector layout = this->schema_->get_level_layout( j );
+    IndexVector::index_type nxy = layout.x() * layout.y();
+
+    for ( IndexVector::index_type z = 0; z < layout.z(); z++ )
     {
-        DataBlock::index_type nxy = nx * ny;
-        for ( DataBlock::index_type k = 0; k < nxy; k++, src++, dst++  )
+      IndexVector::index_type rows = this->compute_prefix_rows( j, z, level_slice );
+      IndexVector::index_type layer_size = this->schema_->get_brick_size( BrickInfo( z * nxy, j ) ).z();
+      if ( rows >= layer_size ) continue;
+
+      for ( IndexVector::index_type k = 0; k < nxy; k++ )
+      {
+        BrickInfo bi( k + z * nxy, j );
+        bfs::path brick_file = this->schema_->get_brick_file_name( bi );
+        IndexVector brick_size = this->schema_->get_brick_size( bi );
+        boost::uintmax_t length = static_cast<boost::uintmax_t>( rows ) * brick_size.x() * 
+          brick_size.y() * element_size;
+
+        try
         {
-            *dst = static_cast<T>( ( static_cast<U>( *dst ) + static_cast<U>( *src ) ) / 2 );
+          if ( rows == 0 )
+          {
+            bfs::remove( brick_file );
+          }
+          else if ( !bfs::exists( brick_file ) || bfs::file_size( brick_file ) < length )
+          {
+            error = "Brick file '" + brick_file.string() + "' does not match the checkpoint.";
+            return false;
+          }
+          else
+          {
+            // Drop everything that was written after the checkpoint
+            bfs::resize_file( brick_file, length );
+          }
         }
+        catch ( ... )
+        {
+          error = "Could not restore brick file '" + brick_file.string() + "'.";
+          return false;
+        }
+      }
     }
-    
+
+    this->brick_level_[ j ]->restore( level_slice == 0 ? 0 : level_slice + overlap );
+    this->index_[ j ] = level_slice;
+  }
+
+  return true;
+}
+
+
+bool LargeVolumeConverterPrivate::compute_section_slices( std::string& error )
+{
+  if ( !this->resume_ && !this->append_ )
+  {
+    this->data_size_.z( 1 );
+    return true;
+  }
+
+  LargeVolumeSchemaHandle existing( new LargeVolumeSchema );
+  existing->set_dir( this->schema_->get_dir() );
+  if ( !existing->load( error ) )
+  {
+    error = "Could not read existing volume: " + error;
+    return false;
+  }
+
+  if ( this->append_ )
+  {
+    this->data_size_.z( existing->get_nz() + 1 );
     return true;
+  }
+
+  // An interrupted section is bricked again from the start, once it has been bricked the
+  // volume file includes it
+  if ( !this->read_checkpoint( error ) ) return false;
+  this->data_size_.z( this->phase_ == 3 ? existing->get_nz() : this->start_slice_ + 1 );
+  return true;
 }
 
+void LargeVolumeConverterPrivate::render_section_blocks( DataBlockHandle band, 
+  IndexVector::index_type y, IndexVector::index_type num_rows, std::vector<std::string>* errors, 
+  std::vector<double>* min, std::vector<double>* max, int thread, int num_threads )
+{
+  const IndexVector::index_type nx = static_cast<IndexVector::index_type>( band->get_nx() );
+  const IndexVector::index_type num_blocks = ( nx + SECTION_BLOCK_WIDTH_C - 1 ) / SECTION_BLOCK_WIDTH_C;
+  const size_t element_size = GetSizeDataType( band->get_data_type() );
 
-bool LargeVolumeConverterPrivate::downsample_add( DataBlockHandle input, DataBlockHandle output,
-    const IndexVector& input_ratio, const IndexVector& output_ratio )
+  // Blocks are interleaved between the threads, so sparse parts of the section are shared
+  for ( IndexVector::index_type b = thread; b < num_blocks; b += num_threads )
+  {
+    IndexVector::index_type x = b * SECTION_BLOCK_WIDTH_C;
+    IndexVector::index_type width = Min( SECTION_BLOCK_WIDTH_C, nx - x );
+    DataBlockHandle block = StdDataBlock::New( width, num_rows, 1, band->get_data_type() );
+
+    if ( !this->section_source_->render_block( block, x, y, ( *errors )[ thread ] ) )
+    {
+      if ( ( *errors )[ thread ].empty() ) ( *errors )[ thread ] = "Could not render section.";
+      return;
+    }
+
+    this->compute_min_max( block, ( *min )[ thread ], ( *max )[ thread ] );
+
+    for ( IndexVector::index_type row = 0; row < num_rows; row++ )
+    {
+      std::memcpy( reinterpret_cast<char*>( band->get_data() ) + ( row * nx + x ) * element_size,
+        reinterpret_cast<char*>( block->get_data() ) + row * width * element_size, 
+        width * element_size );
+    }
+  }
+}
+
+bool LargeVolumeConverterPrivate::brick_section( std::string& error )
 {
-    if ( input->get_data_type() != output->get_data_type() )
+  size_t num_levels = this->schema_->get_num_levels();
+  IndexVector::index_type overlap = static_cast<IndexVector::index_type>( this->schema_->get_overlap() );
+
+  // The brick levels are only used for restoring the brick files to the checkpoint
+  this->index_.resize( num_levels, 0 );
+  this->brick_level_.resize( num_levels );
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    this->brick_level_[ j ] = LargeVolumeBrickLevelHandle( new LargeVolumeBrickLevel( this->schema_, j,
+      this->num_threads_ ) );
+  }
+
+  if ( this->resume_ || this->append_ )
+  {
+    if ( !this->restore_bricks( error ) ) return false;
+  }
+  else if ( !this->write_checkpoint( error ) )
+  {
+    return false;
+  }
+
+  // Slices in the bricks are counted including the leading overlap
+  IndexVector::index_type section = static_cast<IndexVector::index_type>( this->start_slice_ );
+  IndexVector::index_type slice = section + overlap;
+
+  std::vector<LargeVolumeSectionLevelHandle> levels( num_levels );
+  for ( size_t j = num_levels; j-- > 0; )
+  {
+    levels[ j ] = LargeVolumeSectionLevelHandle( new LargeVolumeSectionLevel( this, j, slice ) );
+    if ( j + 1 < num_levels ) levels[ j ]->next_level_ = levels[ j + 1 ];
+  }
+
+  if ( section == 0 )
+  {
+    for ( IndexVector::index_type k = 0; k < overlap; k++ )
+    {
+      for ( size_t j = 0; j < num_levels; j++ )
+      {
+        if ( !levels[ j ]->add_empty_slice( k, error ) ) return false;
+      }
+    }
+  }
+
+  // Render the section in bands of the height of a row of bricks
+  IndexVector size = this->schema_->get_size();
+  IndexVector::index_type band_height = Min( this->schema_->get_effective_brick_size().y(), size.y() );
+  DataBlockHandle band = StdDataBlock::New( size.x(), band_height, 1, this->schema_->get_data_type() );
+  
+  std::vector<std::string> errors( this->num_threads_ );
+  std::vector<double> min( this->num_threads_, this->min_ );
+  std::vector<double> max( this->num_threads_, this->max_ );
+
+  std::cout << "rendering section rows: 000000/000000";
+  for ( IndexVector::index_type y = 0; y < size.y(); y += band_height )
+  {
+    std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << y << "/" << 
+      std::setfill('0') << std::setw(6) << size.y();
+    std::cout.flush();
+
+    IndexVector::index_type num_rows = Min( band_height, size.y() - y );
+    if ( !this->section_source_->begin_rows( y, y + num_rows, error ) ) return false;
+
+    Parallel parallel( boost::bind( &LargeVolumeConverterPrivate::render_section_blocks, this,
+      band, y, num_rows, &errors, &min, &max, _1, _2 ), this->num_threads_ );
+    parallel.run();
+
+    for ( size_t j = 0; j < errors.size(); j++ )
     {
+      if ( !errors[ j ].empty() )
+      {
+        std::cout << std::endl;
+        error = errors[ j ];
         return false;
+      }
     }
-    
-    switch( input->get_data_type() )
+
+    if ( !levels[ 0 ]->add_rows( band, num_rows, error ) ) return false;
+  }
+  std::cout << "\b\b\b\b\b\b\b\b\b\b\b\b\b" << std::setfill('0') << std::setw(6) << size.y() << "/" << 
+    std::setfill('0') << std::setw(6) << size.y() << std::endl;
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    if ( !levels[ j ]->is_done() )
     {
-        case DataType::UCHAR_E:
-            return downsample_add_internals<unsigned char, unsigned short>( input, output, input_ratio, output_ratio );
-        case DataType::CHAR_E:
-            return downsample_add_internals<signed char, short>( input, output, input_ratio, output_ratio );
-        case DataType::USHORT_E:
-            return downsample_add_internals<unsigned short, unsigned int>( input, output, input_ratio, output_ratio );
-        case DataType::SHORT_E:
-            return downsample_add_internals<short, int>( input, output, input_ratio, output_ratio );
-        case DataType::UINT_E:
-            return downsample_add_internals<unsigned int, unsigned long long>( input, output, input_ratio, output_ratio );
-        case DataType::INT_E:
-            return downsample_add_internals<int, long long>( input, output, input_ratio, output_ratio );
-        case DataType::FLOAT_E:
-            return downsample_add_internals<float, float>( input, output, input_ratio, output_ratio );
-        case DataType::DOUBLE_E:
-            return downsample_add_internals<double, double>( input, output, input_ratio, output_ratio );
+      error = "Not all bricks of the section were written.";
+      return false;
     }
-    
-    return false;
+  }
+
+  // The section is the last slice of the volume, hence it is followed by the trailing overlap
+  for ( IndexVector::index_type k = 1; k <= overlap; k++ )
+  {
+    for ( size_t j = 0; j < num_levels; j++ )
+    {
+      if ( !levels[ j ]->add_empty_slice( slice + k, error ) ) return false;
+    }
+  }
+
+  for ( size_t j = 0; j < min.size(); j++ )
+  {
+    this->min_ = Min( this->min_, min[ j ] );
+    this->max_ = Max( this->max_, max[ j ] );
+  }
+  this->schema_->set_min_max( this->min_, this->max_ );
+
+  // Save schema file to update min and max
+  if ( !this->schema_->save( error ) ) return false;
+
+  this->phase_ = 3;
+  this->start_slice_ = section + 1;
+  if ( !this->write_checkpoint( error ) ) return false;
+
+  this->brick_level_.clear();
+  this->index_.clear();
+
+  return true;
 }
 
 
@@ -968,34 +2080,103 @@ void LargeVolumeConverter::set_schema_parameters( const Vector& spacing, const P
   this->private_->overlap_ = overlap;
 }
 
+void LargeVolumeConverter::set_codec( BrickCodecType codec, BrickFilterType filter )
+{
+  this->private_->codec_ = codec;
+  this->private_->filter_ = filter;
+}
+
+void LargeVolumeConverter::set_packed( bool packed )
+{
+  this->private_->packed_ = packed;
+}
+
+void LargeVolumeConverter::set_section_source( LargeVolumeSectionSourceHandle source, size_t nx,
+  size_t ny, DataType data_type )
+{
+  this->private_->section_source_ = source;
+  this->private_->data_size_.x( nx );
+  this->private_->data_size_.y( ny );
+  this->private_->data_type_ = data_type;
+}
+
 bool LargeVolumeConverter::run_phase1( std::string& error )
 {
   error = "";
 
-  // Find all the other files in the series
-  if( ! FileUtil::FindFileSeries( this->private_->first_file_, this->private_->files_, error ) )
+  if ( this->private_->section_source_ )
   {
-    return false;
+    // The section is the next slice of the volume
+    if (! this->private_->compute_section_slices( error ) )
+    {
+      return false;
+    }
   }
+  else
+  {
+    // Find all the other files in the series
+    if( ! FileUtil::FindFileSeries( this->private_->first_file_, this->private_->files_, error ) )
+    {
+      return false;
+    }
 
-  // Set the output size
-  this->private_->data_size_.z( this->private_->files_.size() );
+    // Set the output size
+    this->private_->data_size_.z( this->private_->files_.size() );
 
-  // Now load a file to determine data type and size
-  if (! this->private_->scan_file( this->private_->files_[ 0 ], error ) )
-  {
-    return false;
+    // Now load a file to determine data type and size
+    if (! this->private_->scan_file( this->private_->files_[ 0 ], error ) )
+    {
+      return false;
+    }
   }
 
   this->private_->schema_->set_parameters( this->private_->data_size_, this->private_->spacing_,
     this->private_->origin_, this->private_->brick_size_, this->private_->overlap_, this->private_->data_type_ );
 
-  this->private_->schema_->set_compression( true );
+  this->private_->schema_->set_compression( this->private_->codec_ != BrickCodecType::NONE_E );
+  this->private_->schema_->set_codec( this->private_->codec_, this->private_->filter_ );
   this->private_->schema_->compute_levels();
 
+  if ( this->private_->section_source_ )
+  {
+    for ( size_t j = 0; j < this->private_->schema_->get_num_levels(); j++ )
+    {
+      if ( this->private_->schema_->get_level_downsample_ratio( j ).z() != 1 )
+      {
+        error = "Sections can only be downsampled in x and y.";
+        return false;
+      }
+    }
+  }
+
+  if ( this->private_->resume_ || this->private_->append_ )
+  {
+    return this->private_->open_existing_volume( error );
+  }
+
   return true;
 }
 
+void LargeVolumeConverter::set_resume( bool resume )
+{
+  this->private_->resume_ = resume;
+}
+
+void LargeVolumeConverter::set_append( bool append )
+{
+  this->private_->append_ = append;
+}
+
+size_t LargeVolumeConverter::get_start_slice() const
+{
+  return this->private_->start_slice_;
+}
+
+void LargeVolumeConverter::set_num_threads( int num_threads )
+{
+  this->private_->num_threads_ = Max( 1, num_threads );
+}
+
 void LargeVolumeConverter::set_mem_limit( long long mem_limit )
 {
   this->private_->mem_limit_ = mem_limit;
@@ -1006,10 +2187,32 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
 {
   error = "";
 
-  // Save schema file
-  if (! this->private_->schema_->save(error) )
+  if ( this->private_->resume_ && this->private_->phase_ == 3 )
   {
-    return false;
+    std::cout << "All slices were bricked before the conversion was interrupted." << std::endl;
+    return true;
+  }
+
+  if ( this->private_->append_size_ > 0 )
+  {
+    // Cut the bricks back to the slices that do not change, this saves the schema as well
+    if (! this->private_->prepare_append( error ) )
+    {
+      return false;
+    }
+  }
+  else
+  {
+    // Save schema file
+    if (! this->private_->schema_->save(error) )
+    {
+      return false;
+    }
+  }
+
+  if ( this->private_->section_source_ )
+  {
+    return this->private_->brick_section( error );
   }
 
   // Start creating bricks
@@ -1038,6 +2241,15 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
     return false;
   }
 
+  // Files are decoded ahead of the slice being bricked, allow the read ahead to use up to a
+  // quarter of the remaining memory. One decoded slice is already accounted for above.
+  IndexVector full_size = this->private_->schema_->get_level_size( 0 );
+  size_t full_slice_size = full_size.x() * full_size.y() * element_size;
+  size_t num_read_ahead = Min( static_cast<size_t>( 2 * this->private_->num_threads_ ),
+    static_cast<size_t>( ( this->private_->mem_limit_ - slice_buffer_size ) / ( 4 * full_slice_size ) ) );
+  num_read_ahead = Max( num_read_ahead, static_cast<size_t>( 1 ) );
+  slice_buffer_size += ( num_read_ahead - 1 ) * full_slice_size;
+
     // Initialize parameters for each level
     this->private_->slices_.resize( num_levels );
     this->private_->index_.resize( num_levels, 0 );
@@ -1057,7 +2269,8 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
         // NOTE: The first one will always be allocated by ITK
       this->private_->slices_[ j ] = StdDataBlock::New( level_size.x(), level_size.y(), 1, this->private_->schema_->get_data_type() );
     }
-    this->private_->brick_level_[ j ] = LargeVolumeBrickLevelHandle( new LargeVolumeBrickLevel( this->private_->schema_, j ) ) ;
+    this->private_->brick_level_[ j ] = LargeVolumeBrickLevelHandle( new LargeVolumeBrickLevel( this->private_->schema_, j,
+      this->private_->num_threads_ ) ) ;
 
     num_buffers += this->private_->brick_level_[ j ]->get_num_buffers();
     }
@@ -1076,37 +2289,43 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
     this->private_->brick_level_[ j ]->allocate_buffers( buffer_size );
   }
 
+  // Continue from the checkpoint or from the end of the existing volume
+  size_t start_slice = this->private_->start_slice_;
+  if ( this->private_->resume_ || this->private_->append_ )
+  {
+    if (! this->private_->restore_bricks( error ) )
+    {
+      return false;
+    }
+  }
+  else if (! this->private_->write_checkpoint( error ) )
+  {
+    return false;
+  }
+
+  // Checkpoint about once per layer of bricks, at slices where no downsampled slices are pending
+  size_t restart_ratio = this->private_->schema_->get_level_downsample_ratio( num_levels - 1 ).z();
+  size_t checkpoint_interval = Max( static_cast<size_t>( 1 ), 
+    static_cast<size_t>( this->private_->schema_->get_effective_brick_size().z() ) / restart_ratio ) * restart_ratio;
+
     // Main loading loop
     size_t num_files = this->private_->files_.size();
-    double min = std::numeric_limits<double>::max();
-  double max = std::numeric_limits<double>::min();
+    double min = this->private_->min_;
+  double max = this->private_->max_;
 
-  IndexVector total_size = this->private_->schema_->get_size();
+  // Decode files on separate threads, while this thread bricks and downsamples
+  int num_read_threads = static_cast<int>( Min( static_cast<size_t>( this->private_->num_threads_ ), num_read_ahead ) );
+  LargeVolumeSliceReader reader( this->private_.get(), num_read_threads, num_read_ahead, start_slice );
 
-    for ( IndexVector::index_type slice_idx = 0; slice_idx < num_files; slice_idx++)
+    for ( IndexVector::index_type slice_idx = start_slice; slice_idx < num_files; slice_idx++)
     {
 
         // indicate which slice is being processed
         std::cout << "Processing file: " << this->private_->files_[ slice_idx ].string() << std::endl;
     
-        // load slice
-        this->private_->slices_[ 0 ] = this->private_->load_file( this->private_->files_[ slice_idx ], error );
-    
-    if (! this->private_->slices_[ 0 ] ) 
-    {
-      return false;
-    }
-
-    if ( this->private_->slices_[ 0 ]->get_nx() != total_size.x() ||  this->private_->slices_[ 0 ]->get_ny() != total_size.y() )
-    {
-      std::cout << "WARNING: Dimensions of the slices are not equal, clipping/padding image to fit dimensions of first image." <<std::endl;
-      DataBlock::Clip( this->private_->slices_[ 0 ], this->private_->slices_[ 0 ], total_size.x(), total_size.y(), 1, 0.0 );
-    } 
-  
-    
-    if (! this->private_->compute_min_max( this->private_->slices_[ 0 ], min, max ) )
+        // get the decoded slice
+    if (! reader.get_slice( this->private_->slices_[ 0 ], min, max, error ) )
     {
-      error = "Could not compute min and max.";
       return false;
     }
 
@@ -1116,6 +2335,26 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
         {
             return false;
         }
+
+        if ( ( slice_idx + 1 ) % checkpoint_interval == 0 && static_cast<size_t>( slice_idx + 1 ) < num_files )
+        {
+          // Write out everything that is buffered, so the brick files match the checkpoint
+          for ( size_t j = 0; j < num_levels; j++ )
+          {
+            if (! this->private_->brick_level_[ j ]->flush_buffers( error ) )
+            {
+              return false;
+            }
+          }
+
+          this->private_->start_slice_ = slice_idx + 1;
+          this->private_->min_ = min;
+          this->private_->max_ = max;
+          if (! this->private_->write_checkpoint( error ) )
+          {
+            return false;
+          }
+        }
     }
 
   // Save schema file to update min and max
@@ -1124,6 +2363,15 @@ bool LargeVolumeConverter::run_phase2( std::string& error )
     return false;
   }
 
+  this->private_->phase_ = 3;
+  this->private_->start_slice_ = num_files;
+  this->private_->min_ = min;
+  this->private_->max_ = max;
+  if (! this->private_->write_checkpoint( error ) )
+  {
+    return false;
+  }
+
   this->private_->slices_.clear();
   this->private_->brick_level_.clear();
   this->private_->index_.clear();
@@ -1162,7 +2410,25 @@ void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_t
       }
       
       BrickInfo bi( k ,j );
-            if (! this->schema_->reprocess_brick( bi, error) )
+      if ( this->packed_ )
+      {
+        // Move the brick from its temporary file into the pack file
+        DataBlockHandle data_block;
+        if ( !this->schema_->read_brick( data_block, bi, error ) ||
+          !this->schema_->write_packed_brick( data_block, bi, error ) )
+        {
+          std::cerr << error << std::endl;
+          this->success_ = false;
+          break;
+        }
+      }
+      else if ( this->is_brick_compressed( bi ) )
+      {
+        // Brick was compressed before the conversion was interrupted or was not
+        // affected by appending slices
+        continue;
+      }
+            else if (! this->schema_->reprocess_brick( bi, error) )
       {
                 std::cerr << error << std::endl;
                 this->success_ = false;
@@ -1181,19 +2447,67 @@ void LargeVolumeConverterPrivate::run_phase3_parallel( int thread_num, int num_t
 
 }
 
+bool LargeVolumeConverterPrivate::is_brick_compressed( const BrickInfo& bi )
+{
+  boost::filesystem::path brick_file = this->schema_->get_brick_file_name( bi );
+  IndexVector size = this->schema_->get_brick_size( bi );
+  boost::uintmax_t brick_size = static_cast<boost::uintmax_t>( size[0] ) * size[1] * size[2] * 
+    GetSizeDataType( this->schema_->get_data_type() );
+
+  boost::system::error_code ec;
+  boost::uintmax_t file_size = boost::filesystem::file_size( brick_file, ec );
+  return !ec && file_size < brick_size;
+}
+
 bool LargeVolumeConverter::run_phase3( std::string& error )
 {
   error = "";
   this->private_->success_ = true;
 
-  Parallel parallel( boost::bind( &LargeVolumeConverterPrivate::run_phase3_parallel, this->private_, _1, _2, _3 ) );
+  if ( this->private_->packed_ )
+  {
+    if ( !this->private_->schema_->begin_packed_file( error ) )
+    {
+      return false;
+    }
+  }
+
+  Parallel parallel( boost::bind( &LargeVolumeConverterPrivate::run_phase3_parallel, this->private_, _1, _2, _3 ),
+    this->private_->num_threads_ );
 
   parallel.run();
     if ( !this->private_->success_ )
     {
         error = "Could not compress bricks.";
+        return false;
+    }
+
+  if ( this->private_->packed_ )
+  {
+    // Finalize the index and record the packed layout in the volume file
+    if ( !this->private_->schema_->end_packed_file( error ) ||
+      !this->private_->schema_->save( error ) )
+    {
+      return false;
     }
 
+    // The raw bricks are only removed once the pack is complete, so an interrupted
+    // conversion can build the pack again
+    for ( size_t j = 0; j < this->private_->schema_->get_num_levels(); j++ )
+    {
+      size_t num_bricks = this->private_->schema_->compute_level_num_bricks( j );
+      for ( size_t k = 0; k < num_bricks; k++ )
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove( this->private_->schema_->get_brick_file_name( BrickInfo( k, j ) ), ec );
+      }
+    }
+  }
+
+  // The volume is complete
+  boost::system::error_code ec;
+  boost::filesystem::remove( this->private_->get_checkpoint_file_name(), ec );
+
   return this->private_->success_;
 }
 
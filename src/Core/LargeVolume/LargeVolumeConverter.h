@@ -29,6 +29,9 @@
 #ifndef CORE_LARGEVOLUME_LARGEVOLUMECONVERTER_H
 #define CORE_LARGEVOLUME_LARGEVOLUMECONVERTER_H
 
+// STL includes
+#include <string>
+
 // Boost includes
 #include <boost/shared_ptr.hpp>
 #include <boost/filesystem.hpp>
@@ -56,6 +59,33 @@ typedef boost::shared_ptr< LargeVolumeConverterPrivate > LargeVolumeConverterPri
 class LargeVolumeConverter;
 typedef boost::shared_ptr< LargeVolumeConverter > LargeVolumeConverterHandle;
 
+class LargeVolumeSectionSource;
+typedef boost::shared_ptr< LargeVolumeSectionSource > LargeVolumeSectionSourceHandle;
+
+// CLASS LargeVolumeSectionSource:
+/// Produces a section that is too large to be held in memory as a whole, such as a
+/// mosaic that is assembled from many tiles. The converter asks for the section in bands
+/// of rows from top to bottom, and for each band in blocks that are rendered on multiple
+/// threads at the same time.
+class LargeVolumeSectionSource
+{
+public:
+  typedef IndexVector::index_type index_type;
+
+  virtual ~LargeVolumeSectionSource() {}
+
+  /// BEGIN_ROWS
+  /// Called before the blocks of the rows [ y_start, y_end ) are rendered, the rows of
+  /// earlier bands are never asked for again
+  virtual bool begin_rows( index_type y_start, index_type y_end, std::string& error ) = 0;
+
+  /// RENDER_BLOCK
+  /// Fill the block with the part of the section that starts at column x and row y
+  /// NOTE: This function is called from multiple threads at the same time
+  virtual bool render_block( DataBlockHandle block, index_type x, index_type y, 
+    std::string& error ) = 0;
+};
+
 
 class LargeVolumeConverter
 {
@@ -77,22 +107,59 @@ public:
   /// Upload parameters for schema
   void set_schema_parameters( const Vector& spacing, const Point& origin, const IndexVector& brick_size, size_t overlap );
 
+  /// SET_CODEC
+  /// Set the codec and filter used for compressing the bricks, default is zlib without filter
+  void set_codec( BrickCodecType codec, BrickFilterType filter );
+
+  /// SET_PACKED
+  /// Store all bricks in a single pack file instead of one file per brick
+  void set_packed( bool packed );
+
+  /// SET_RESUME
+  /// Continue a conversion into the output directory that was interrupted, progress
+  /// is read from the checkpoint that the conversion keeps in the output directory
+  void set_resume( bool resume );
+
+  /// SET_APPEND
+  /// Add the slices of the image stack beyond the existing volume in the output directory,
+  /// only the bricks that are affected by the new slices are rebuilt
+  void set_append( bool append );
+
+  /// SET_SECTION_SOURCE
+  /// Brick a single section of nx by ny samples, which is rendered by the source while it
+  /// is bricked, instead of an image stack. Only a band of rows of the section is held in
+  /// memory at any time. When appending, the section is added as the next slice of the
+  /// existing volume.
+  /// NOTE: Sections can only be downsampled in x and y
+  void set_section_source( LargeVolumeSectionSourceHandle source, size_t nx, size_t ny,
+    DataType data_type );
+
   /// RUN_PHASE1
-  /// Check files and determine size
+  /// Check files and determine size, when resuming or appending the existing
+  /// volume is checked against the image stack
   bool run_phase1( std::string& error );
 
   /// SET_MEM_LIMIT
   /// How much meory to devote to the conversion process
   void set_mem_limit( long long mem_limit );
 
+  /// SET_NUM_THREADS
+  /// Number of threads used for decoding, bricking and compressing, default is
+  /// the number of cores
+  void set_num_threads( int num_threads );
+
   /// RUN_PHASE2
-  /// Downsample and build bricks
+  /// Downsample and build bricks, a section is rendered and bricked in this phase
   bool run_phase2( std::string& error );
 
     /// RUN_PHASE3
     /// Compress bricks
     bool run_phase3( std::string& error );
 
+  /// GET_START_SLICE
+  /// Get the first slice that will be bricked in phase 2
+  size_t get_start_slice() const;
+
   /// GET_SCHEMA
   /// Get information about bricking schema
   LargeVolumeSchemaHandle get_schema() const;
@@ -0,0 +1,1129 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+// Boost includes
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/Math/MathFunctions.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/LargeVolumeFilter.h>
+
+namespace Core
+{
+
+bool ImportFromString( const std::string& filter_string, LargeVolumeFilterType& filter )
+{
+  if ( filter_string == "threshold" ) filter = LargeVolumeFilterType::THRESHOLD_E;
+  else if ( filter_string == "arithmetic" ) filter = LargeVolumeFilterType::ARITHMETIC_E;
+  else if ( filter_string == "gaussian" ) filter = LargeVolumeFilterType::GAUSSIAN_E;
+  else if ( filter_string == "median" ) filter = LargeVolumeFilterType::MEDIAN_E;
+  else return false;
+
+  return true;
+}
+
+std::string ExportToString( LargeVolumeFilterType filter )
+{
+  switch ( filter )
+  {
+    case LargeVolumeFilterType::ARITHMETIC_E:
+      return "arithmetic";
+    case LargeVolumeFilterType::GAUSSIAN_E:
+      return "gaussian";
+    case LargeVolumeFilterType::MEDIAN_E:
+      return "median";
+    default:
+      return "threshold";
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LargeVolumeBrickCache
+//////////////////////////////////////////////////////////////////////////
+
+class LargeVolumeBrickCache;
+typedef boost::shared_ptr< LargeVolumeBrickCache > LargeVolumeBrickCacheHandle;
+
+// Keeps the most recently used bricks of one level of a volume in memory. Neighboring bricks
+// are filtered at the same time and need the same bricks to fill in their borders, so most
+// bricks are only read and decompressed once.
+class LargeVolumeBrickCache : public boost::noncopyable
+{
+public:
+  typedef IndexVector::index_type index_type;
+
+  LargeVolumeBrickCache( LargeVolumeSchemaHandle schema, size_t level, long long mem_limit ) :
+    schema_( schema ),
+    level_( level ),
+    mem_limit_( mem_limit ),
+    mem_used_( 0 )
+  {}
+
+  // GET_BRICK:
+  // Get a brick from the cache or read it, a brick that is being read by one thread is
+  // waited for by the others
+  bool get_brick( index_type index, DataBlockHandle& brick, std::string& error );
+
+  // READ_REGION:
+  // Copy the samples of the region [ start, start + size ) of the level into region, samples
+  // outside the volume are copies of the nearest sample inside the volume
+  bool read_region( const IndexVector& start, const IndexVector& size, DataBlockHandle& region,
+    std::string& error );
+
+private:
+  typedef std::list< index_type > lru_list_type;
+
+  struct Entry
+  {
+    DataBlockHandle brick_;
+    lru_list_type::iterator lru_;
+  };
+
+  LargeVolumeSchemaHandle schema_;
+  size_t level_;
+  long long mem_limit_;
+  long long mem_used_;
+
+  // Bricks in the cache, the front of the list is the most recently used brick
+  std::map< index_type, Entry > bricks_;
+  lru_list_type lru_;
+
+  // Bricks that are being read
+  std::set< index_type > loading_;
+
+  boost::mutex mutex_;
+  boost::condition_variable brick_loaded_;
+};
+
+bool LargeVolumeBrickCache::get_brick( index_type index, DataBlockHandle& brick, 
+  std::string& error )
+{
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    while ( true )
+    {
+      std::map< index_type, Entry >::iterator it = this->bricks_.find( index );
+      if ( it != this->bricks_.end() )
+      {
+        this->lru_.splice( this->lru_.begin(), this->lru_, it->second.lru_ );
+        brick = it->second.brick_;
+        return true;
+      }
+
+      if ( this->loading_.find( index ) == this->loading_.end() ) break;
+      this->brick_loaded_.wait( lock );
+    }
+    this->loading_.insert( index );
+  }
+
+  // Read the brick without holding the lock, so other bricks can be read at the same time
+  bool success = this->schema_->read_brick( brick, BrickInfo( index, this->level_ ), error );
+
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->loading_.erase( index );
+
+    if ( success )
+    {
+      this->lru_.push_front( index );
+      Entry& entry = this->bricks_[ index ];
+      entry.brick_ = brick;
+      entry.lru_ = this->lru_.begin();
+      this->mem_used_ += brick->get_byte_size();
+
+      // The brick that was just read is never removed, as it is about to be used
+      while ( this->mem_used_ > this->mem_limit_ && this->lru_.size() > 1 )
+      {
+        std::map< index_type, Entry >::iterator it = this->bricks_.find( this->lru_.back() );
+        this->mem_used_ -= it->second.brick_->get_byte_size();
+        this->bricks_.erase( it );
+        this->lru_.pop_back();
+      }
+    }
+  }
+  this->brick_loaded_.notify_all();
+
+  return success;
+}
+
+bool LargeVolumeBrickCache::read_region( const IndexVector& start, const IndexVector& size, 
+  DataBlockHandle& region, std::string& error )
+{
+  IndexVector level_size = this->schema_->get_level_size( this->level_ );
+  IndexVector layout = this->schema_->get_level_layout( this->level_ );
+  IndexVector effective_brick_size = this->schema_->get_effective_brick_size();
+  index_type overlap = static_cast< index_type >( this->schema_->get_overlap() );
+
+  region = StdDataBlock::New( size.x(), size.y(), size.z(), this->schema_->get_data_type() );
+  size_t elem_size = region->get_elem_size();
+  unsigned char* region_data = static_cast< unsigned char* >( region->get_data() );
+  index_type region_nx = size.x();
+  index_type region_nxy = size.x() * size.y();
+
+  // Part of the region that lies within the volume
+  IndexVector lo, hi;
+  for ( size_t d = 0; d < 3; d++ )
+  {
+    lo[ d ] = Max( start[ d ], static_cast< index_type >( 0 ) );
+    hi[ d ] = Min( start[ d ] + size[ d ], level_size[ d ] );
+    if ( lo[ d ] >= hi[ d ] )
+    {
+      region->clear();
+      return true;
+    }
+  }
+
+  // A region that lies within a brick including its overlap is copied from that brick alone,
+  // otherwise it is gathered from the bricks that hold the samples without their overlap
+  IndexVector first, last;
+  bool single_brick = true;
+  for ( size_t d = 0; d < 3; d++ )
+  {
+    index_type brick = Min( ( lo[ d ] + overlap ) / effective_brick_size[ d ], layout[ d ] - 1 );
+    index_type brick_start = brick * effective_brick_size[ d ] - overlap;
+    index_type brick_end = brick * effective_brick_size[ d ] + effective_brick_size[ d ] + overlap;
+    if ( lo[ d ] < brick_start || hi[ d ] > brick_end ) single_brick = false;
+    first[ d ] = brick;
+  }
+
+  if ( !single_brick )
+  {
+    for ( size_t d = 0; d < 3; d++ )
+    {
+      first[ d ] = lo[ d ] / effective_brick_size[ d ];
+      last[ d ] = ( hi[ d ] - 1 ) / effective_brick_size[ d ];
+    }
+  }
+  else
+  {
+    last = first;
+  }
+
+  for ( index_type bz = first.z(); bz <= last.z(); bz++ )
+  {
+    for ( index_type by = first.y(); by <= last.y(); by++ )
+    {
+      for ( index_type bx = first.x(); bx <= last.x(); bx++ )
+      {
+        IndexVector brick_idx( bx, by, bz );
+        DataBlockHandle brick;
+        if ( !this->get_brick( bx + by * layout.x() + bz * layout.x() * layout.y(), brick, error ) )
+        {
+          return false;
+        }
+
+        // Samples that are copied from this brick
+        IndexVector copy_start, copy_end, brick_start;
+        for ( size_t d = 0; d < 3; d++ )
+        {
+          index_type core_start = brick_idx[ d ] * effective_brick_size[ d ];
+          brick_start[ d ] = core_start - overlap;
+          copy_start[ d ] = single_brick ? lo[ d ] : Max( lo[ d ], core_start );
+          copy_end[ d ] = single_brick ? hi[ d ] : 
+            Min( hi[ d ], core_start + effective_brick_size[ d ] );
+        }
+
+        const unsigned char* brick_data = static_cast< const unsigned char* >( brick->get_data() );
+        index_type brick_nx = static_cast< index_type >( brick->get_nx() );
+        index_type brick_nxy = brick_nx * static_cast< index_type >( brick->get_ny() );
+        size_t row_size = ( copy_end.x() - copy_start.x() ) * elem_size;
+
+        for ( index_type z = copy_start.z(); z < copy_end.z(); z++ )
+        {
+          for ( index_type y = copy_start.y(); y < copy_end.y(); y++ )
+          {
+            index_type dst = ( copy_start.x() - start.x() ) + ( y - start.y() ) * region_nx +
+              ( z - start.z() ) * region_nxy;
+            index_type src = ( copy_start.x() - brick_start.x() ) + 
+              ( y - brick_start.y() ) * brick_nx + ( z - brick_start.z() ) * brick_nxy;
+            std::memcpy( region_data + dst * elem_size, brick_data + src * elem_size, row_size );
+          }
+        }
+      }
+    }
+  }
+
+  // Replicate the samples at the boundary of the volume, first along the rows, then
+  // complete rows and finally complete slices
+  IndexVector end = start + size;
+  for ( index_type z = lo.z(); z < hi.z(); z++ )
+  {
+    for ( index_type y = lo.y(); y < hi.y(); y++ )
+    {
+      unsigned char* row = region_data + ( ( y - start.y() ) * region_nx + 
+        ( z - start.z() ) * region_nxy ) * elem_size;
+      for ( index_type x = start.x(); x < lo.x(); x++ )
+      {
+        std::memcpy( row + ( x - start.x() ) * elem_size, 
+          row + ( lo.x() - start.x() ) * elem_size, elem_size );
+      }
+      for ( index_type x = hi.x(); x < end.x(); x++ )
+      {
+        std::memcpy( row + ( x - start.x() ) * elem_size, 
+          row + ( hi.x() - 1 - start.x() ) * elem_size, elem_size );
+      }
+    }
+  }
+
+  for ( index_type z = lo.z(); z < hi.z(); z++ )
+  {
+    unsigned char* slice = region_data + ( z - start.z() ) * region_nxy * elem_size;
+    for ( index_type y = start.y(); y < end.y(); y++ )
+    {
+      if ( y >= lo.y() && y < hi.y() ) continue;
+      index_type src_y = y < lo.y() ? lo.y() : hi.y() - 1;
+      std::memcpy( slice + ( y - start.y() ) * region_nx * elem_size, 
+        slice + ( src_y - start.y() ) * region_nx * elem_size, region_nx * elem_size );
+    }
+  }
+
+  for ( index_type z = start.z(); z < end.z(); z++ )
+  {
+    if ( z >= lo.z() && z < hi.z() ) continue;
+    index_type src_z = z < lo.z() ? lo.z() : hi.z() - 1;
+    std::memcpy( region_data + ( z - start.z() ) * region_nxy * elem_size, 
+      region_data + ( src_z - start.z() ) * region_nxy * elem_size, region_nxy * elem_size );
+  }
+
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Sample functions
+//////////////////////////////////////////////////////////////////////////
+
+// Convert a value to the data type of the output, integer types are rounded and clamped
+template< class U >
+static U ClampValue( double value )
+{
+  if ( std::numeric_limits< U >::is_integer )
+  {
+    if ( value <= static_cast< double >( std::numeric_limits< U >::min() ) )
+    {
+      return std::numeric_limits< U >::min();
+    }
+    if ( value >= static_cast< double >( std::numeric_limits< U >::max() ) )
+    {
+      return std::numeric_limits< U >::max();
+    }
+    return static_cast< U >( value < 0.0 ? value - 0.5 : value + 0.5 );
+  }
+  return static_cast< U >( value );
+}
+
+// Whether a sample of a brick that starts at origin lies inside the level
+static inline bool IsInside( const IndexVector& origin, const IndexVector& level_size,
+  IndexVector::index_type x, IndexVector::index_type y, IndexVector::index_type z )
+{
+  return origin.x() + x >= 0 && origin.x() + x < level_size.x() &&
+    origin.y() + y >= 0 && origin.y() + y < level_size.y() &&
+    origin.z() + z >= 0 && origin.z() + z < level_size.z();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LargeVolumeFilterPrivate
+//////////////////////////////////////////////////////////////////////////
+
+class LargeVolumeFilterPrivate
+{
+public:
+  typedef IndexVector::index_type index_type;
+
+  LargeVolumeFilterPrivate() :
+    filter_( LargeVolumeFilterType::THRESHOLD_E ),
+    lower_( 0.0 ),
+    upper_( 0.0 ),
+    scale_( 1.0 ),
+    offset_( 0.0 ),
+    sigma_( 1.0 ),
+    radius_( 1 ),
+    preserve_data_format_( false ),
+    mem_limit_( 1LL << 30 ),
+    level_( 0 ),
+    min_( std::numeric_limits< double >::max() ),
+    max_( -std::numeric_limits< double >::max() ),
+    bricks_done_( 0 ),
+    total_bricks_( 0 ),
+    reported_( 0.0 ),
+    aborted_( false )
+  {}
+
+  // -- parameters --
+public:
+  LargeVolumeSchemaHandle source_;
+  boost::filesystem::path output_dir_;
+
+  LargeVolumeFilterType filter_;
+  double lower_;
+  double upper_;
+  double scale_;
+  double offset_;
+  double sigma_;
+  int radius_;
+  bool preserve_data_format_;
+  long long mem_limit_;
+
+  boost::function< void ( double ) > progress_;
+
+  // -- state --
+public:
+  // Schema of the filtered volume
+  LargeVolumeSchemaHandle schema_;
+
+  // Bricks the samples of the level that is processed are computed from
+  LargeVolumeBrickCacheHandle cache_;
+  size_t level_;
+
+  // Weights of the gaussian kernel
+  std::vector< double > kernel_;
+
+  boost::mutex mutex_;
+  std::string error_;
+  double min_;
+  double max_;
+  size_t bricks_done_;
+  size_t total_bricks_;
+  double reported_;
+  bool aborted_;
+
+  // -- functions --
+public:
+  // GET_OUTPUT_TYPE:
+  // Data type of the filtered volume
+  DataType get_output_type() const;
+
+  // GET_STENCIL_RADIUS:
+  int get_stencil_radius() const;
+
+  // GET_BRICK_ORIGIN:
+  // Position of the first sample of a brick including its overlap within its level
+  IndexVector get_brick_origin( const BrickInfo& bi ) const;
+
+  // FILTER_BRICK:
+  // Filter a brick of the full resolution level
+  bool filter_brick( const BrickInfo& bi, std::string& error );
+
+  // DOWNSAMPLE_BRICK:
+  // Compute a brick of a coarser level from the filtered level before it
+  bool downsample_brick( const BrickInfo& bi, std::string& error );
+
+  // PROCESS_BRICKS:
+  // Filter or downsample the bricks [ begin, end ) of the current level, this runs on the
+  // thread pool
+  void process_bricks( size_t begin, size_t end );
+
+  // PACK_BRICKS:
+  // Move the bricks [ begin, end ) of a level into the pack file
+  void pack_bricks( size_t level, size_t begin, size_t end );
+
+  // PROCESS_LEVEL:
+  bool process_level( size_t level, std::string& error );
+
+  // PACK_VOLUME:
+  // Store the filtered volume in a pack file like the source volume
+  bool pack_volume( std::string& error );
+
+  // UPDATE_PROGRESS:
+  // Account for a brick that was written and report the progress
+  void update_progress();
+
+  // IS_STOPPED:
+  // Whether an error occured or the filter was aborted
+  bool is_stopped();
+
+  // SET_ERROR:
+  void set_error( const std::string& error );
+
+  template< class T, class U >
+  void filter_samples( const T* src, const IndexVector& region_size, U* dst, 
+    const IndexVector& brick_size, const IndexVector& origin, const IndexVector& level_size,
+    double& min, double& max );
+
+  template< class T >
+  void filter_typed( DataBlockHandle region, DataBlockHandle brick, const IndexVector& origin,
+    const IndexVector& level_size, double& min, double& max );
+
+  template< class T >
+  void downsample_samples( const T* src, const IndexVector& region_size, T* dst,
+    const IndexVector& brick_size, const IndexVector& origin, const IndexVector& ratio, 
+    const IndexVector& level_size, const IndexVector& prev_level_size );
+};
+
+DataType LargeVolumeFilterPrivate::get_output_type() const
+{
+  switch ( this->filter_ )
+  {
+    case LargeVolumeFilterType::THRESHOLD_E:
+      return DataType::UCHAR_E;
+    case LargeVolumeFilterType::MEDIAN_E:
+      return this->source_->get_data_type();
+    default:
+      return this->preserve_data_format_ ? this->source_->get_data_type() : DataType::FLOAT_E;
+  }
+}
+
+int LargeVolumeFilterPrivate::get_stencil_radius() const
+{
+  switch ( this->filter_ )
+  {
+    case LargeVolumeFilterType::GAUSSIAN_E:
+      return Max( 0, static_cast< int >( std::ceil( 3.0 * this->sigma_ ) ) );
+    case LargeVolumeFilterType::MEDIAN_E:
+      return Max( 0, this->radius_ );
+    default:
+      return 0;
+  }
+}
+
+IndexVector LargeVolumeFilterPrivate::get_brick_origin( const BrickInfo& bi ) const
+{
+  IndexVector layout = this->schema_->get_level_layout( bi.level_ );
+  IndexVector effective_brick_size = this->schema_->get_effective_brick_size();
+  index_type overlap = static_cast< index_type >( this->schema_->get_overlap() );
+
+  index_type bx = bi.index_ % layout.x();
+  index_type by = ( bi.index_ / layout.x() ) % layout.y();
+  index_type bz = bi.index_ / ( layout.x() * layout.y() );
+
+  return IndexVector( bx * effective_brick_size.x() - overlap, 
+    by * effective_brick_size.y() - overlap, bz * effective_brick_size.z() - overlap );
+}
+
+template< class T, class U >
+void LargeVolumeFilterPrivate::filter_samples( const T* src, const IndexVector& region_size,
+  U* dst, const IndexVector& brick_size, const IndexVector& origin, 
+  const IndexVector& level_size, double& min, double& max )
+{
+  index_type r = this->get_stencil_radius();
+  index_type sx = region_size.x();
+  index_type sxy = region_size.x() * region_size.y();
+
+  // The gaussian is separable, the region is smoothed along each axis in turn. Only the
+  // samples that are needed for the next pass are computed.
+  std::vector< float > smoothed;
+  if ( this->filter_ == LargeVolumeFilterType::GAUSSIAN_E )
+  {
+    std::vector< float > buffer( region_size.x() * region_size.y() * region_size.z() );
+    smoothed.resize( buffer.size() );
+
+    for ( index_type z = 0; z < region_size.z(); z++ )
+    {
+      for ( index_type y = 0; y < region_size.y(); y++ )
+      {
+        for ( index_type x = r; x < region_size.x() - r; x++ )
+        {
+          index_type idx = x + y * sx + z * sxy;
+          double value = 0.0;
+          for ( index_type k = -r; k <= r; k++ ) value += this->kernel_[ k + r ] * src[ idx + k ];
+          buffer[ idx ] = static_cast< float >( value );
+        }
+      }
+    }
+
+    for ( index_type z = 0; z < region_size.z(); z++ )
+    {
+      for ( index_type y = r; y < region_size.y() - r; y++ )
+      {
+        for ( index_type x = r; x < region_size.x() - r; x++ )
+        {
+          index_type idx = x + y * sx + z * sxy;
+          double value = 0.0;
+          for ( index_type k = -r; k <= r; k++ ) value += this->kernel_[ k + r ] * buffer[ idx + k * sx ];
+          smoothed[ idx ] = static_cast< float >( value );
+        }
+      }
+    }
+
+    for ( index_type z = r; z < region_size.z() - r; z++ )
+    {
+      for ( index_type y = r; y < region_size.y() - r; y++ )
+      {
+        for ( index_type x = r; x < region_size.x() - r; x++ )
+        {
+          index_type idx = x + y * sx + z * sxy;
+          double value = 0.0;
+          for ( index_type k = -r; k <= r; k++ ) value += this->kernel_[ k + r ] * smoothed[ idx + k * sxy ];
+          buffer[ idx ] = static_cast< float >( value );
+        }
+      }
+    }
+    smoothed.swap( buffer );
+  }
+
+  std::vector< T > window;
+  size_t window_size = static_cast< size_t >( ( 2 * r + 1 ) * ( 2 * r + 1 ) * ( 2 * r + 1 ) );
+  if ( this->filter_ == LargeVolumeFilterType::MEDIAN_E ) window.resize( window_size );
+
+  for ( index_type z = 0; z < brick_size.z(); z++ )
+  {
+    for ( index_type y = 0; y < brick_size.y(); y++ )
+    {
+      for ( index_type x = 0; x < brick_size.x(); x++ )
+      {
+        U& value = dst[ x + y * brick_size.x() + z * brick_size.x() * brick_size.y() ];
+
+        // Overlap outside the volume is zero, as it is in bricks written by the converter
+        if ( !IsInside( origin, level_size, x, y, z ) )
+        {
+          value = 0;
+          continue;
+        }
+
+        index_type idx = ( x + r ) + ( y + r ) * sx + ( z + r ) * sxy;
+        switch ( this->filter_ )
+        {
+          case LargeVolumeFilterType::THRESHOLD_E:
+            value = ( src[ idx ] >= this->lower_ && src[ idx ] <= this->upper_ ) ? 1 : 0;
+            break;
+          case LargeVolumeFilterType::ARITHMETIC_E:
+            value = ClampValue< U >( src[ idx ] * this->scale_ + this->offset_ );
+            break;
+          case LargeVolumeFilterType::GAUSSIAN_E:
+            value = ClampValue< U >( smoothed[ idx ] );
+            break;
+          case LargeVolumeFilterType::MEDIAN_E:
+          {
+            size_t k = 0;
+            for ( index_type wz = -r; wz <= r; wz++ )
+            {
+              for ( index_type wy = -r; wy <= r; wy++ )
+              {
+                const T* row = src + idx + wy * sx + wz * sxy;
+                for ( index_type wx = -r; wx <= r; wx++ ) window[ k++ ] = row[ wx ];
+              }
+            }
+            std::nth_element( window.begin(), window.begin() + window_size / 2, window.end() );
+            value = ClampValue< U >( window[ window_size / 2 ] );
+            break;
+          }
+        }
+
+        double v = static_cast< double >( value );
+        if ( v < min ) min = v;
+        if ( v > max ) max = v;
+      }
+    }
+  }
+}
+
+template< class T >
+void LargeVolumeFilterPrivate::filter_typed( DataBlockHandle region, DataBlockHandle brick, 
+  const IndexVector& origin, const IndexVector& level_size, double& min, double& max )
+{
+  const T* src = static_cast< const T* >( region->get_data() );
+  IndexVector region_size( region->get_nx(), region->get_ny(), region->get_nz() );
+  IndexVector brick_size( brick->get_nx(), brick->get_ny(), brick->get_nz() );
+
+  switch ( brick->get_data_type() )
+  {
+    case DataType::UCHAR_E:
+      this->filter_samples( src, region_size, static_cast< unsigned char* >( brick->get_data() ),
+        brick_size, origin, level_size, min, max );
+      break;
+    case DataType::FLOAT_E:
+      this->filter_samples( src, region_size, static_cast< float* >( brick->get_data() ),
+        brick_size, origin, level_size, min, max );
+      break;
+    default:
+      this->filter_samples( src, region_size, static_cast< T* >( brick->get_data() ),
+        brick_size, origin, level_size, min, max );
+      break;
+  }
+}
+
+bool LargeVolumeFilterPrivate::filter_brick( const BrickInfo& bi, std::string& error )
+{
+  IndexVector brick_size = this->schema_->get_brick_size( bi );
+  IndexVector origin = this->get_brick_origin( bi );
+  IndexVector level_size = this->schema_->get_level_size( 0 );
+  index_type r = this->get_stencil_radius();
+
+  // The brick including its overlap and the samples needed by the stencil around it
+  DataBlockHandle region;
+  if ( !this->cache_->read_region( origin - IndexVector( r, r, r ), 
+    brick_size + IndexVector( 2 * r, 2 * r, 2 * r ), region, error ) )
+  {
+    return false;
+  }
+
+  DataBlockHandle brick = StdDataBlock::New( brick_size.x(), brick_size.y(), brick_size.z(),
+    this->schema_->get_data_type() );
+
+  double min = std::numeric_limits< double >::max();
+  double max = -std::numeric_limits< double >::max();
+  switch ( region->get_data_type() )
+  {
+    case DataType::CHAR_E:
+      this->filter_typed< signed char >( region, brick, origin, level_size, min, max ); break;
+    case DataType::UCHAR_E:
+      this->filter_typed< unsigned char >( region, brick, origin, level_size, min, max ); break;
+    case DataType::SHORT_E:
+      this->filter_typed< short >( region, brick, origin, level_size, min, max ); break;
+    case DataType::USHORT_E:
+      this->filter_typed< unsigned short >( region, brick, origin, level_size, min, max ); break;
+    case DataType::INT_E:
+      this->filter_typed< int >( region, brick, origin, level_size, min, max ); break;
+    case DataType::UINT_E:
+      this->filter_typed< unsigned int >( region, brick, origin, level_size, min, max ); break;
+    case DataType::FLOAT_E:
+      this->filter_typed< float >( region, brick, origin, level_size, min, max ); break;
+    case DataType::DOUBLE_E:
+      this->filter_typed< double >( region, brick, origin, level_size, min, max ); break;
+    default:
+      error = "Unsupported data type.";
+      return false;
+  }
+
+  {
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    this->min_ = Min( this->min_, min );
+    this->max_ = Max( this->max_, max );
+  }
+
+  return this->schema_->write_brick( brick, bi, error );
+}
+
+template< class T >
+void LargeVolumeFilterPrivate::downsample_samples( const T* src, const IndexVector& region_size,
+  T* dst, const IndexVector& brick_size, const IndexVector& origin, const IndexVector& ratio,
+  const IndexVector& level_size, const IndexVector& prev_level_size )
+{
+  index_type sx = region_size.x();
+  index_type sxy = region_size.x() * region_size.y();
+
+  for ( index_type z = 0; z < brick_size.z(); z++ )
+  {
+    for ( index_type y = 0; y < brick_size.y(); y++ )
+    {
+      for ( index_type x = 0; x < brick_size.x(); x++ )
+      {
+        T& value = dst[ x + y * brick_size.x() + z * brick_size.x() * brick_size.y() ];
+        if ( !IsInside( origin, level_size, x, y, z ) )
+        {
+          value = 0;
+          continue;
+        }
+
+        // Average the samples of the previous level that are inside the volume
+        double sum = 0.0;
+        int count = 0;
+        for ( index_type dz = 0; dz < ratio.z(); dz++ )
+        {
+          if ( ( origin.z() + z ) * ratio.z() + dz >= prev_level_size.z() ) continue;
+          for ( index_type dy = 0; dy < ratio.y(); dy++ )
+          {
+            if ( ( origin.y() + y ) * ratio.y() + dy >= prev_level_size.y() ) continue;
+            for ( index_type dx = 0; dx < ratio.x(); dx++ )
+            {
+              if ( ( origin.x() + x ) * ratio.x() + dx >= prev_level_size.x() ) continue;
+              sum += src[ ( x * ratio.x() + dx ) + ( y * ratio.y() + dy ) * sx + 
+                ( z * ratio.z() + dz ) * sxy ];
+              count++;
+            }
+          }
+        }
+        value = static_cast< T >( sum / count );
+      }
+    }
+  }
+}
+
+bool LargeVolumeFilterPrivate::downsample_brick( const BrickInfo& bi, std::string& error )
+{
+  IndexVector brick_size = this->schema_->get_brick_size( bi );
+  IndexVector origin = this->get_brick_origin( bi );
+  IndexVector level_size = this->schema_->get_level_size( bi.level_ );
+  IndexVector prev_level_size = this->schema_->get_level_size( bi.level_ - 1 );
+
+  // Levels are downsampled by either one or two along each axis
+  IndexVector ratio;
+  const IndexVector& level_ratio = this->schema_->get_level_downsample_ratio( bi.level_ );
+  const IndexVector& prev_level_ratio = this->schema_->get_level_downsample_ratio( bi.level_ - 1 );
+  for ( size_t d = 0; d < 3; d++ ) ratio[ d ] = level_ratio[ d ] / prev_level_ratio[ d ];
+
+  IndexVector region_start( origin.x() * ratio.x(), origin.y() * ratio.y(), origin.z() * ratio.z() );
+  IndexVector region_size( brick_size.x() * ratio.x(), brick_size.y() * ratio.y(), 
+    brick_size.z() * ratio.z() );
+
+  DataBlockHandle region;
+  if ( !this->cache_->read_region( region_start, region_size, region, error ) )
+  {
+    return false;
+  }
+
+  DataBlockHandle brick = StdDataBlock::New( brick_size.x(), brick_size.y(), brick_size.z(),
+    this->schema_->get_data_type() );
+
+  switch ( brick->get_data_type() )
+  {
+#define DOWNSAMPLE_SAMPLES( TYPE ) \
+    this->downsample_samples( static_cast< const TYPE* >( region->get_data() ), region_size, \
+      static_cast< TYPE* >( brick->get_data() ), brick_size, origin, ratio, level_size, \
+      prev_level_size )
+
+    case DataType::CHAR_E: DOWNSAMPLE_SAMPLES( signed char ); break;
+    case DataType::UCHAR_E: DOWNSAMPLE_SAMPLES( unsigned char ); break;
+    case DataType::SHORT_E: DOWNSAMPLE_SAMPLES( short ); break;
+    case DataType::USHORT_E: DOWNSAMPLE_SAMPLES( unsigned short ); break;
+    case DataType::INT_E: DOWNSAMPLE_SAMPLES( int ); break;
+    case DataType::UINT_E: DOWNSAMPLE_SAMPLES( unsigned int ); break;
+    case DataType::FLOAT_E: DOWNSAMPLE_SAMPLES( float ); break;
+    case DataType::DOUBLE_E: DOWNSAMPLE_SAMPLES( double ); break;
+    default:
+      error = "Unsupported data type.";
+      return false;
+
+#undef DOWNSAMPLE_SAMPLES
+  }
+
+  return this->schema_->write_brick( brick, bi, error );
+}
+
+void LargeVolumeFilterPrivate::process_bricks( size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    if ( this->is_stopped() ) return;
+
+    std::string error;
+    BrickInfo bi( j, this->level_ );
+    bool success = this->level_ == 0 ? this->filter_brick( bi, error ) : 
+      this->downsample_brick( bi, error );
+    if ( !success )
+    {
+      this->set_error( error );
+      return;
+    }
+
+    this->update_progress();
+  }
+}
+
+bool LargeVolumeFilterPrivate::process_level( size_t level, std::string& error )
+{
+  // The full resolution level is computed from the source, the others from the level
+  // before them
+  this->level_ = level;
+  if ( level == 0 )
+  {
+    this->cache_.reset( new LargeVolumeBrickCache( this->source_, 0, this->mem_limit_ ) );
+  }
+  else
+  {
+    this->cache_.reset( new LargeVolumeBrickCache( this->schema_, level - 1, this->mem_limit_ ) );
+  }
+
+  // Bricks are processed one plane at a time, so the bricks that are processed at the same
+  // time share most of the bricks they are computed from
+  IndexVector layout = this->schema_->get_level_layout( level );
+  size_t plane_size = static_cast< size_t >( layout.x() * layout.y() );
+  for ( index_type z = 0; z < layout.z(); z++ )
+  {
+    ThreadPool::Instance()->parallel_for( z * plane_size, ( z + 1 ) * plane_size, 1,
+      boost::bind( &LargeVolumeFilterPrivate::process_bricks, this, _1, _2 ) );
+    if ( this->is_stopped() ) break;
+  }
+  this->cache_.reset();
+
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  if ( !this->error_.empty() )
+  {
+    error = this->error_;
+    return false;
+  }
+  if ( this->aborted_ )
+  {
+    error = "Filtering the volume was aborted.";
+    return false;
+  }
+  return true;
+}
+
+void LargeVolumeFilterPrivate::pack_bricks( size_t level, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    if ( this->is_stopped() ) return;
+
+    std::string error;
+    DataBlockHandle brick;
+    BrickInfo bi( j, level );
+    if ( !this->schema_->read_brick( brick, bi, error ) ||
+      !this->schema_->write_packed_brick( brick, bi, error ) )
+    {
+      this->set_error( error );
+      return;
+    }
+
+    this->update_progress();
+  }
+}
+
+bool LargeVolumeFilterPrivate::pack_volume( std::string& error )
+{
+  if ( !this->schema_->begin_packed_file( error ) ) return false;
+
+  size_t num_levels = this->schema_->get_num_levels();
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    ThreadPool::Instance()->parallel_for( 0, this->schema_->compute_level_num_bricks( j ), 1,
+      boost::bind( &LargeVolumeFilterPrivate::pack_bricks, this, j, _1, _2 ) );
+
+    boost::mutex::scoped_lock lock( this->mutex_ );
+    if ( !this->error_.empty() )
+    {
+      error = this->error_;
+      return false;
+    }
+  }
+
+  if ( !this->schema_->end_packed_file( error ) ) return false;
+
+  // The brick files are only removed once the pack is complete
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    size_t num_bricks = this->schema_->compute_level_num_bricks( j );
+    for ( size_t k = 0; k < num_bricks; k++ )
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove( this->schema_->get_brick_file_name( BrickInfo( k, j ) ), ec );
+    }
+  }
+
+  return true;
+}
+
+void LargeVolumeFilterPrivate::update_progress()
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  this->bricks_done_++;
+  if ( !this->progress_ ) return;
+
+  double progress = static_cast< double >( this->bricks_done_ ) / this->total_bricks_;
+  if ( progress - this->reported_ >= 0.01 || this->bricks_done_ == this->total_bricks_ )
+  {
+    this->reported_ = progress;
+    this->progress_( progress );
+  }
+}
+
+bool LargeVolumeFilterPrivate::is_stopped()
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  return this->aborted_ || !this->error_.empty();
+}
+
+void LargeVolumeFilterPrivate::set_error( const std::string& error )
+{
+  boost::mutex::scoped_lock lock( this->mutex_ );
+  if ( this->error_.empty() ) this->error_ = error;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Class LargeVolumeFilter
+//////////////////////////////////////////////////////////////////////////
+
+LargeVolumeFilter::LargeVolumeFilter( LargeVolumeSchemaHandle source ) :
+  private_( new LargeVolumeFilterPrivate )
+{
+  this->private_->source_ = source;
+}
+
+void LargeVolumeFilter::set_output_dir( const boost::filesystem::path& dir )
+{
+  this->private_->output_dir_ = dir;
+}
+
+void LargeVolumeFilter::set_threshold( double lower, double upper )
+{
+  this->private_->filter_ = LargeVolumeFilterType::THRESHOLD_E;
+  this->private_->lower_ = lower;
+  this->private_->upper_ = upper;
+}
+
+void LargeVolumeFilter::set_arithmetic( double scale, double offset )
+{
+  this->private_->filter_ = LargeVolumeFilterType::ARITHMETIC_E;
+  this->private_->scale_ = scale;
+  this->private_->offset_ = offset;
+}
+
+void LargeVolumeFilter::set_gaussian( double sigma )
+{
+  this->private_->filter_ = LargeVolumeFilterType::GAUSSIAN_E;
+  this->private_->sigma_ = sigma;
+}
+
+void LargeVolumeFilter::set_median( int radius )
+{
+  this->private_->filter_ = LargeVolumeFilterType::MEDIAN_E;
+  this->private_->radius_ = radius;
+}
+
+void LargeVolumeFilter::set_preserve_data_format( bool preserve_data_format )
+{
+  this->private_->preserve_data_format_ = preserve_data_format;
+}
+
+void LargeVolumeFilter::set_mem_limit( long long mem_limit )
+{
+  this->private_->mem_limit_ = mem_limit;
+}
+
+void LargeVolumeFilter::set_progress_function( boost::function< void ( double ) > progress )
+{
+  this->private_->progress_ = progress;
+}
+
+int LargeVolumeFilter::get_stencil_radius() const
+{
+  return this->private_->get_stencil_radius();
+}
+
+void LargeVolumeFilter::abort()
+{
+  boost::mutex::scoped_lock lock( this->private_->mutex_ );
+  this->private_->aborted_ = true;
+}
+
+bool LargeVolumeFilter::run( std::string& error )
+{
+  error = "";
+  LargeVolumeSchemaHandle source = this->private_->source_;
+
+  if ( this->private_->output_dir_.empty() )
+  {
+    error = "No output directory was given.";
+    return false;
+  }
+
+  boost::system::error_code ec;
+  if ( boost::filesystem::equivalent( this->private_->output_dir_, source->get_dir(), ec ) )
+  {
+    error = "The filtered volume cannot be written into the directory of the source volume.";
+    return false;
+  }
+
+  // The samples the stencil needs beyond the overlap are held by the direct neighbors of a brick
+  if ( this->private_->get_stencil_radius() > static_cast< int >( source->get_overlap() ) )
+  {
+    error = "The filter needs " + ExportToString( this->private_->get_stencil_radius() ) +
+      " neighboring samples, but the bricks of the volume only overlap by " + 
+      ExportToString( source->get_overlap() ) + ".";
+    return false;
+  }
+
+  // The filtered volume has the same bricks and levels as the source
+  DataType data_type = this->private_->get_output_type();
+  LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+  schema->set_dir( this->private_->output_dir_ );
+  schema->set_parameters( source->get_size(), source->get_spacing(), source->get_origin(),
+    source->get_brick_size(), source->get_overlap(), data_type );
+
+  std::vector< IndexVector > levels;
+  for ( size_t j = 0; j < source->get_num_levels(); j++ )
+  {
+    levels.push_back( source->get_level_downsample_ratio( j ) );
+  }
+  schema->set_level_downsample_ratios( levels );
+
+  BrickCodecType codec = source->is_compressed() ? source->get_codec() : BrickCodecType::NONE_E;
+  BrickFilterType brick_filter = source->get_filter();
+  if ( brick_filter == BrickFilterType::DELTA_SHUFFLE_E && IsReal( data_type ) )
+  {
+    brick_filter = BrickFilterType::SHUFFLE_E;
+  }
+  schema->set_codec( codec, brick_filter );
+  schema->set_compression( codec != BrickCodecType::NONE_E );
+  schema->set_min_max( 0.0, 0.0 );
+
+  if ( !schema->save( error ) ) return false;
+  this->private_->schema_ = schema;
+
+  // Gaussian kernel normalized over the samples within the stencil
+  int radius = this->private_->get_stencil_radius();
+  this->private_->kernel_.clear();
+  if ( this->private_->filter_ == LargeVolumeFilterType::GAUSSIAN_E )
+  {
+    double sum = 0.0;
+    for ( int k = -radius; k <= radius; k++ )
+    {
+      double weight = this->private_->sigma_ > 0.0 ? 
+        std::exp( -( k * k ) / ( 2.0 * this->private_->sigma_ * this->private_->sigma_ ) ) : 1.0;
+      this->private_->kernel_.push_back( weight );
+      sum += weight;
+    }
+    for ( size_t k = 0; k < this->private_->kernel_.size(); k++ ) 
+    {
+      this->private_->kernel_[ k ] /= sum;
+    }
+  }
+
+  size_t num_levels = schema->get_num_levels();
+  size_t total_bricks = 0;
+  for ( size_t j = 0; j < num_levels; j++ ) total_bricks += schema->compute_level_num_bricks( j );
+  this->private_->total_bricks_ = source->is_packed() ? 2 * total_bricks : total_bricks;
+  this->private_->bricks_done_ = 0;
+  this->private_->reported_ = 0.0;
+  this->private_->error_ = "";
+  this->private_->min_ = std::numeric_limits< double >::max();
+  this->private_->max_ = -std::numeric_limits< double >::max();
+
+  for ( size_t j = 0; j < num_levels; j++ )
+  {
+    if ( !this->private_->process_level( j, error ) ) return false;
+  }
+
+  schema->set_min_max( this->private_->min_, this->private_->max_ );
+
+  if ( source->is_packed() && !this->private_->pack_volume( error ) ) return false;
+
+  return schema->save( error );
+}
+
+LargeVolumeSchemaHandle LargeVolumeFilter::get_schema() const
+{
+  return this->private_->schema_;
+}
+
+} // end namespace Core
@@ -0,0 +1,147 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_LARGEVOLUME_LARGEVOLUMEFILTER_H
+#define CORE_LARGEVOLUME_LARGEVOLUMEFILTER_H
+
+// STL includes
+#include <string>
+
+// Boost includes
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/utility.hpp>
+
+// Core includes
+#include <Core/Utils/EnumClass.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+namespace Core
+{
+
+// CLASS LargeVolumeFilterType:
+/// Filters that can be applied to a large volume brick by brick.
+CORE_ENUM_CLASS
+(
+  LargeVolumeFilterType,
+  THRESHOLD_E = 0,
+  ARITHMETIC_E,
+  GAUSSIAN_E,
+  MEDIAN_E
+)
+
+// IMPORTFROMSTRING:
+/// Import a filter type from a string, returns false if the string is not recognized
+bool ImportFromString( const std::string& filter_string, LargeVolumeFilterType& filter );
+
+// EXPORTTOSTRING:
+/// Export a filter type to a string
+std::string ExportToString( LargeVolumeFilterType filter );
+
+// Internals are separated from the interface
+class LargeVolumeFilterPrivate;
+typedef boost::shared_ptr< LargeVolumeFilterPrivate > LargeVolumeFilterPrivateHandle;
+
+class LargeVolumeFilter;
+typedef boost::shared_ptr< LargeVolumeFilter > LargeVolumeFilterHandle;
+
+// CLASS LargeVolumeFilter:
+/// Applies a pointwise or small stencil filter to a large volume without loading it into
+/// memory. The bricks of the full resolution level are streamed from the source volume,
+/// filtered on the thread pool and written to a new volume, after which the coarser levels
+/// of the new volume are regenerated from the filtered data. The stencil of the filter
+/// needs to fit within the overlap of the bricks.
+class LargeVolumeFilter : public boost::noncopyable
+{
+  // -- constructor --
+public:
+  LargeVolumeFilter( LargeVolumeSchemaHandle source );
+
+  // -- parameters --
+public:
+  /// SET_OUTPUT_DIR
+  /// Set the directory the filtered volume is written to
+  void set_output_dir( const boost::filesystem::path& dir );
+
+  /// SET_THRESHOLD
+  /// Mark the samples with a value within [ lower, upper ] with 1 and all other samples with 0,
+  /// the result is stored as unsigned char
+  void set_threshold( double lower, double upper );
+
+  /// SET_ARITHMETIC
+  /// Compute value * scale + offset for every sample
+  void set_arithmetic( double scale, double offset );
+
+  /// SET_GAUSSIAN
+  /// Smooth with a gaussian kernel with a standard deviation of sigma samples, the kernel
+  /// is cut off at three standard deviations
+  void set_gaussian( double sigma );
+
+  /// SET_MEDIAN
+  /// Replace every sample by the median of the cube of samples within radius
+  void set_median( int radius );
+
+  /// SET_PRESERVE_DATA_FORMAT
+  /// Store the result of the arithmetic and gaussian filters in the data type of the
+  /// source, values are clamped to the range of the type. By default they are stored as float.
+  void set_preserve_data_format( bool preserve_data_format );
+
+  /// SET_MEM_LIMIT
+  /// How much memory to devote to caching the bricks that are shared by neighboring bricks
+  void set_mem_limit( long long mem_limit );
+
+  /// SET_PROGRESS_FUNCTION
+  /// Function that is called with the fraction of the bricks that has been written, it is
+  /// called from the threads that filter the bricks, but never from two threads at the same time
+  void set_progress_function( boost::function< void ( double ) > progress );
+
+  /// GET_STENCIL_RADIUS
+  /// Number of neighboring samples on each side the filter needs to compute a sample
+  int get_stencil_radius() const;
+
+  /// ABORT
+  /// Stop filtering as soon as the bricks that are being processed are done
+  void abort();
+
+  /// RUN
+  /// Filter the volume and build the levels of the new volume
+  bool run( std::string& error );
+
+  /// GET_SCHEMA
+  /// Get the schema of the filtered volume
+  LargeVolumeSchemaHandle get_schema() const;
+
+  // -- internals --
+private:
+  LargeVolumeFilterPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
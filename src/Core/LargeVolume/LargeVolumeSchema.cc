@@ -26,17 +26,23 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-#include <zlib.h>
-
 #include <limits>
 #include <fstream>
 #include <set>
 #include <queue>
+#include <cstring>
 
 // test
 #include <iostream>
 // test
 
+// Boost includes
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <Core/Utils/AtomicCounter.h>
 #include <Core/Utils/FilesystemUtil.h>
 #include <Core/Utils/StringUtil.h>
 #include <Core/Math/MathFunctions.h>
@@ -44,24 +50,14 @@
 
 #include <Core/LargeVolume/LargeVolumeSchema.h>
 #include <Core/LargeVolume/LargeVolumeCache.h>
+#include <Core/LargeVolume/BrickCodec.h>
 
 namespace bfs=boost::filesystem;
+namespace bip=boost::interprocess;
 
 namespace Core
 {
 
-#ifdef Z_PREFIX
-  #define zlib_uLongf z_uLongf
-  #define zlib_Bytef z_Bytef
-  #define zlib_uncompress z_uncompress
-  #define zlib_compress2 z_compress2
-#else
-  #define zlib_uLongf uLongf
-  #define zlib_Bytef Bytef
-  #define zlib_uncompress uncompress
-  #define zlib_compress2 compress2
-#endif
-
 class LargeVolumeSchemaPrivate {
 
 public:
@@ -76,12 +72,17 @@ public:
     overlap_(0),
     data_type_(DataType::UNKNOWN_E),
     compression_(false),
+    codec_(BrickCodecType::ZLIB_E),
+    filter_(BrickFilterType::NONE_E),
     little_endian_(DataBlock::IsLittleEndian()),
     downsample_x_( true ),
     downsample_y_( true ),
     downsample_z_( true ),
     min_( 0.0 ),
-    max_( 0.0 )
+    max_( 0.0 ),
+    packed_( false ),
+    memory_mapping_( true ),
+    pack_end_( 0 )
   {
   }
 
@@ -149,6 +150,16 @@ public:
     return this->dir_ / filename;
   }
 
+  bfs::path get_pack_file_name() const
+  {
+    return this->dir_ / "bricks.pack";
+  }
+
+  size_t get_pack_entry( const BrickInfo& bi ) const
+  {
+    return this->level_brick_offset_[ bi.level_ ] + static_cast<size_t>( bi.index_ );
+  }
+
 
   void compute_cached_level_info() 
   {
@@ -162,8 +173,45 @@ public:
       this->level_size_.push_back( this->compute_level_size( j ) );
       this->level_layout_.push_back( this->compute_brick_layout( this->level_size_[ j ] ) );
     }
+
+    // Bricks of all levels are numbered consecutively in the pack file
+    this->level_brick_offset_.clear();
+    size_t num_bricks = 0;
+    for ( size_t j = 0; j < this->levels_.size(); j++ )
+    {
+      this->level_brick_offset_.push_back( num_bricks );
+      num_bricks += this->compute_level_num_bricks( j );
+    }
+    this->level_brick_offset_.push_back( num_bricks );
   }
 
+  // Decode a brick from a buffer that is either raw or compressed
+  bool decode_brick( const char* buffer, size_t buffer_size, DataBlockHandle brick,
+    size_t brick_size, std::string& error );
+
+  // Read a brick that is stored in its own file
+  bool read_brick_file( DataBlockHandle brick, size_t brick_size, const BrickInfo& bi,
+    std::string& error );
+
+  // Check that a brick that is about to be written has the size and data type of the brick
+  // in the volume, and compute the size of its data in bytes
+  bool check_brick( DataBlockHandle data_block, const BrickInfo& bi, size_t& brick_size,
+    std::string& error );
+
+  // Write a brick to the given file, compressing it if enabled
+  bool write_brick_file( DataBlockHandle data_block, const BrickInfo& bi, 
+    const bfs::path& brick_file, std::string& error );
+
+  // Read a brick from the pack file
+  bool read_packed_brick( DataBlockHandle brick, size_t brick_size, const BrickInfo& bi,
+    std::string& error );
+
+  // Read the index of the pack file and map it into memory
+  bool open_pack( std::string& error );
+
+  // Release the pack file
+  void close_pack();
+
 
   template<class T>
   bool insert_brick_internals( DataBlockHandle volume, DataBlockHandle brick,
@@ -180,7 +228,8 @@ public:
                      const IndexVector& clip_start,
                      const IndexVector& clip_end );
 
-  void load_and_substitue_missing_bricks( std::vector<BrickInfo>& want_to_render, SliceType slice, 
+  void load_and_substitue_missing_bricks( std::vector<BrickInfo>& want_to_render, 
+    const std::vector<double>& center_distances, SliceType slice, 
     double depth, const std::string& load_key, std::vector<BrickInfo>& current_render );
 
   // -- contents in the text header --
@@ -197,6 +246,8 @@ public:
   DataType data_type_;
 
   bool compression_;
+  BrickCodecType codec_;
+  BrickFilterType filter_;
   bool little_endian_;
 
   bool downsample_x_;
@@ -213,8 +264,63 @@ public:
   
   bfs::path dir_;
   LargeVolumeSchema* schema_;
+
+  // Unique id of this schema within this process
+  size_t id_;
+
+  // -- packed brick container --
+public:
+  typedef std::pair< boost::uint64_t, boost::uint64_t > pack_entry_type;
+
+  // Whether the bricks are stored in a single pack file instead of one file per brick
+  bool packed_;
+
+  // Whether the pack file may be mapped into memory for reading
+  bool memory_mapping_;
+
+  // Index of the first brick of each level in the pack index
+  std::vector< size_t > level_brick_offset_;
+
+  // Offset and length of every brick in the pack file
+  std::vector< pack_entry_type > pack_index_;
+
+  // Protects the stream and the end of the pack file when writing
+  boost::mutex pack_mutex_;
+
+  // Stream used for writing the pack file, or for reading it when it cannot be mapped
+  boost::shared_ptr< std::fstream > pack_stream_;
+  boost::uint64_t pack_end_;
+
+  // Memory mapping of the pack file
+  boost::shared_ptr< bip::file_mapping > pack_mapping_;
+  boost::shared_ptr< bip::mapped_region > pack_region_;
 };
 
+// Pack file layout: magic, number of bricks and an (offset, length) pair per brick,
+// all stored as little endian 64 bit numbers, followed by the brick data.
+// Bricks whose length equals the uncompressed brick size are stored raw.
+static const char PACK_MAGIC_C[ 8 ] = { 'S', '3', 'D', 'P', 'A', 'C', 'K', '1' };
+
+static size_t PackHeaderSize( size_t num_bricks )
+{
+  return sizeof( PACK_MAGIC_C ) + 8 + 16 * num_bricks;
+}
+
+static void EncodePackNumber( boost::uint64_t value, unsigned char* buffer )
+{
+  for ( int j = 0; j < 8; j++ ) buffer[ j ] = static_cast<unsigned char>( value >> ( 8 * j ) );
+}
+
+static boost::uint64_t DecodePackNumber( const unsigned char* buffer )
+{
+  boost::uint64_t value = 0;
+  for ( int j = 7; j >= 0; j-- ) value = ( value << 8 ) | buffer[ j ];
+  return value;
+}
+
+// Counter for handing out unique schema ids
+static AtomicCounter SchemaIdCounter;
+
 template<class T>
 bool LargeVolumeSchemaPrivate::insert_brick_internals( DataBlockHandle volume, DataBlockHandle brick,
                                                        const IndexVector& offset,
@@ -321,11 +427,305 @@ bool LargeVolumeSchemaPrivate::insert_brick_internals( DataBlockHandle volume, D
   return true;
 }
 
+bool LargeVolumeSchemaPrivate::decode_brick( const char* buffer, size_t buffer_size, 
+  DataBlockHandle brick, size_t brick_size, std::string& error )
+{
+  if ( brick_size > buffer_size )
+  {
+    if ( !BrickCodec::Decompress( this->codec_, this->filter_, this->data_type_, 
+      buffer, buffer_size, brick->get_data(), brick_size ) )
+    {
+      error = "Could not decompress brick.";
+      brick->clear();
+      return false;
+    }
+  }
+  else if ( brick_size == buffer_size )
+  {
+    std::memcpy( brick->get_data(), buffer, brick_size );
+  }
+  else
+  {
+    error = "Brick data is too large to be a brick.";
+    brick->clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeSchemaPrivate::read_brick_file( DataBlockHandle brick, size_t brick_size,
+  const BrickInfo& bi, std::string& error )
+{
+  bfs::path brick_file = this->get_brick_file_name( bi );
+
+  if ( !bfs::exists(brick_file ) )
+  {
+    error = "Could not open brick.";
+    return false; 
+  }
+
+  size_t file_size = bfs::file_size( brick_file );
+
+  if ( brick_size > file_size )
+  {
+    try
+    {
+      std::vector<char> buffer( file_size );
+
+      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+      input.read( &buffer[0],  file_size);
+      input.close();
+
+      if ( !this->decode_brick( &buffer[ 0 ], file_size, brick, brick_size, error ) )
+      {
+        error = "Could not decompress file '" + brick_file.string() + "'.";
+        return false;
+      }
+    }
+    catch ( ... )
+    {
+      error = "Error reading file '" + brick_file.string() + "'.";
+      brick->clear();
+      return false;
+    }
+  }
+  else if ( brick_size == file_size )
+  {
+    try
+    {
+      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+      input.read( reinterpret_cast<char *>(brick->get_data()), brick_size );
+      input.close();
+    }
+    catch ( ... )
+    {
+      error = "Error reading file '" + brick_file.string() + "'.";
+      brick->clear();
+      return false;
+    } 
+  }
+  else 
+  {
+    error = "Brick file is too large to be a brick.";
+    brick->clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool LargeVolumeSchemaPrivate::read_packed_brick( DataBlockHandle brick, size_t brick_size,
+  const BrickInfo& bi, std::string& error )
+{
+  size_t entry = this->get_pack_entry( bi );
+  if ( entry >= this->pack_index_.size() || this->pack_index_[ entry ].second == 0 )
+  {
+    error = "Brick is not part of the pack file.";
+    brick->clear();
+    return false;
+  }
+
+  boost::uint64_t offset = this->pack_index_[ entry ].first;
+  size_t length = static_cast<size_t>( this->pack_index_[ entry ].second );
+
+  // When the file is mapped, bricks can be decoded straight from the mapping without locking
+  if ( this->pack_region_ )
+  {
+    if ( offset + length > this->pack_region_->get_size() )
+    {
+      error = "Brick is located beyond the end of the pack file.";
+      brick->clear();
+      return false;
+    }
+
+    return this->decode_brick( static_cast<const char*>( this->pack_region_->get_address() ) + offset,
+      length, brick, brick_size, error );
+  }
+
+  std::vector<char> buffer( length );
+  {
+    boost::mutex::scoped_lock lock( this->pack_mutex_ );
+    if ( !this->pack_stream_ )
+    {
+      error = "Pack file is not open.";
+      brick->clear();
+      return false;
+    }
+
+    this->pack_stream_->clear();
+    this->pack_stream_->seekg( static_cast<std::streamoff>( offset ), std::ios_base::beg );
+    this->pack_stream_->read( &buffer[ 0 ], length );
+    if ( !( *this->pack_stream_ ) )
+    {
+      error = "Error reading file '" + this->get_pack_file_name().string() + "'.";
+      brick->clear();
+      return false;
+    }
+  }
+
+  return this->decode_brick( &buffer[ 0 ], length, brick, brick_size, error );
+}
+
+bool LargeVolumeSchemaPrivate::open_pack( std::string& error )
+{
+  this->close_pack();
+
+  bfs::path pack_file = this->get_pack_file_name();
+  size_t num_bricks = this->level_brick_offset_.back();
+  size_t header_size = PackHeaderSize( num_bricks );
+
+  if ( !bfs::exists( pack_file ) || bfs::file_size( pack_file ) < header_size )
+  {
+    error = "Could not open pack file '" + pack_file.string() + "'.";
+    return false;
+  }
+
+  boost::uint64_t file_size = bfs::file_size( pack_file );
+
+  try
+  {
+    std::vector<unsigned char> header( header_size );
+    std::ifstream input( pack_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
+    input.read( reinterpret_cast<char*>( &header[ 0 ] ), header_size );
+    if ( !input )
+    {
+      error = "Could not read pack file '" + pack_file.string() + "'.";
+      return false;
+    }
+
+    if ( std::memcmp( &header[ 0 ], PACK_MAGIC_C, sizeof( PACK_MAGIC_C ) ) != 0 ||
+      DecodePackNumber( &header[ sizeof( PACK_MAGIC_C ) ] ) != num_bricks )
+    {
+      error = "Pack file '" + pack_file.string() + "' does not match the volume file.";
+      return false;
+    }
+
+    this->pack_index_.resize( num_bricks );
+    const unsigned char* index = &header[ sizeof( PACK_MAGIC_C ) + 8 ];
+    for ( size_t j = 0; j < num_bricks; j++ )
+    {
+      this->pack_index_[ j ].first = DecodePackNumber( index + 16 * j );
+      this->pack_index_[ j ].second = DecodePackNumber( index + 16 * j + 8 );
+      if ( this->pack_index_[ j ].first + this->pack_index_[ j ].second > file_size )
+      {
+        error = "Pack file '" + pack_file.string() + "' is truncated.";
+        return false;
+      }
+    }
+  }
+  catch ( ... )
+  {
+    error = "Could not read pack file '" + pack_file.string() + "'.";
+    return false;
+  }
+
+  // Map the whole file when the address space allows it, the OS will page bricks in on demand
+  if ( this->memory_mapping_ && sizeof( void* ) == 8 )
+  {
+    try
+    {
+      this->pack_mapping_.reset( new bip::file_mapping( pack_file.string().c_str(), bip::read_only ) );
+      this->pack_region_.reset( new bip::mapped_region( *this->pack_mapping_, bip::read_only ) );
+      return true;
+    }
+    catch ( ... )
+    {
+      this->pack_region_.reset();
+      this->pack_mapping_.reset();
+    }
+  }
+
+  // Fall back to reading bricks with explicit seeks
+  this->pack_stream_.reset( new std::fstream( pack_file.string().c_str(),
+    std::ios_base::in | std::ios_base::binary ) );
+  if ( !( *this->pack_stream_ ) )
+  {
+    this->pack_stream_.reset();
+    error = "Could not open pack file '" + pack_file.string() + "'.";
+    return false;
+  }
+
+  return true;
+}
+
+void LargeVolumeSchemaPrivate::close_pack()
+{
+  boost::mutex::scoped_lock lock( this->pack_mutex_ );
+  this->pack_region_.reset();
+  this->pack_mapping_.reset();
+  this->pack_stream_.reset();
+}
+
+bool LargeVolumeSchemaPrivate::check_brick( DataBlockHandle data_block, const BrickInfo& bi,
+  size_t& brick_size, std::string& error )
+{
+  IndexVector size = this->schema_->get_brick_size( bi );
+  size_t nx = static_cast< size_t >( size[ 0 ] );
+  size_t ny = static_cast< size_t >( size[ 1 ] );
+  size_t nz = static_cast< size_t >( size[ 2 ] );
+
+  if ( nx != data_block->get_nx() || ny != data_block->get_ny() || nz != data_block->get_nz() )
+  {
+    error = "Brick is of incorrect size.";
+    return false;
+  }
+
+  if ( this->data_type_ != data_block->get_data_type() )
+  {
+    error = "Brick is incorrect data type.";
+    return false;
+  }
+
+  brick_size = nx * ny * nz * GetSizeDataType( this->data_type_ );
+  return true;
+}
+
+bool LargeVolumeSchemaPrivate::write_brick_file( DataBlockHandle data_block, const BrickInfo& bi,
+  const bfs::path& brick_file, std::string& error )
+{
+  size_t brick_size = 0;
+  if ( !this->check_brick( data_block, bi, brick_size, error ) ) return false;
+
+  std::vector<char> buffer;
+  if ( this->compression_ && BrickCodec::Compress( this->codec_, 
+    this->filter_, this->data_type_, data_block->get_data(), brick_size, buffer ) ) 
+  {
+    // Compression succeeded
+    try
+    {
+      std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+      output.write( &buffer[0], buffer.size() );
+    }
+    catch ( ... )
+    {
+      error = "Could not write to file '" + brick_file.string() + "'.";
+      return false;
+    }
+  }
+  else
+  {
+    try
+    {
+      std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
+      output.write( reinterpret_cast<char *>( data_block->get_data() ) , brick_size );
+    }
+    catch ( ... )
+    {
+      error = "Could not write to file '" + brick_file.string() + "'.";
+      return false;
+    }   
+  }
+
+  return true;
+}
+
 LargeVolumeSchema::LargeVolumeSchema() :
   private_(new LargeVolumeSchemaPrivate),
   VOLUME_FILE_NAME_("volume.txt")
 {
   this->private_->schema_ = this;
+  this->private_->id_ = static_cast<size_t>( ++SchemaIdCounter );
 }
 
 
@@ -488,6 +888,28 @@ bool LargeVolumeSchema::load( std::string& error)
       return false;
     }
 
+    // Volumes written before codecs were introduced do not have these fields
+    // and are zlib compressed without a filter
+    this->private_->codec_ = BrickCodecType::ZLIB_E;
+    if ( values.find( "codec" ) != values.end() )
+    {
+      if ( !ImportFromString( values[ "codec" ], this->private_->codec_ ) )
+      {
+        error = "Unknown codec '" + values[ "codec" ] + "'.";
+        return false;
+      }
+    }
+
+    this->private_->filter_ = BrickFilterType::NONE_E;
+    if ( values.find( "filter" ) != values.end() )
+    {
+      if ( !ImportFromString( values[ "filter" ], this->private_->filter_ ) )
+      {
+        error = "Unknown filter '" + values[ "filter" ] + "'.";
+        return false;
+      }
+    }
+
     size_t level = 0;
     
     while ( values.find( "level" + ExportToString(level)) != values.end() )
@@ -507,6 +929,21 @@ bool LargeVolumeSchema::load( std::string& error)
     }
     
     this->private_->compute_cached_level_info();
+
+    // Volumes written before pack files were introduced store one file per brick
+    this->private_->packed_ = false;
+    if ( values.find( "layout" ) != values.end() )
+    {
+      if ( values[ "layout" ] == "packed" )
+      {
+        this->private_->packed_ = true;
+      }
+      else if ( values[ "layout" ] != "files" )
+      {
+        error = "Unknown brick layout '" + values[ "layout" ] + "'.";
+        return false;
+      }
+    }
   }
   catch (...)
   {
@@ -514,6 +951,11 @@ bool LargeVolumeSchema::load( std::string& error)
     return false;
   }
 
+  if ( this->private_->packed_ )
+  {
+    return this->private_->open_pack( error );
+  }
+
   return true;
 }
 
@@ -541,6 +983,9 @@ bool LargeVolumeSchema::save( std::string& error ) const
     text_file << "endian: " << ( this->private_->little_endian_ ? "little" : "big" ) << std::endl;
     text_file << "min: " << ExportToString( this->private_->min_ ) << std::endl;
     text_file << "max: " << ExportToString( this->private_->max_ ) << std::endl;
+    text_file << "codec: " << ExportToString( this->private_->codec_ ) << std::endl;
+    text_file << "filter: " << ExportToString( this->private_->filter_ ) << std::endl;
+    text_file << "layout: " << ( this->private_->packed_ ? "packed" : "files" ) << std::endl;
     
     for (size_t j = 0 ; j < this->private_->levels_.size(); j++ )
     {    
@@ -621,6 +1066,11 @@ bfs::path LargeVolumeSchema::get_dir() const
   return this->private_->dir_;
 }
 
+size_t LargeVolumeSchema::get_id() const
+{
+  return this->private_->id_;
+}
+
 
 GridTransform LargeVolumeSchema::get_grid_transform() const
 {
@@ -665,6 +1115,16 @@ bool LargeVolumeSchema::is_compressed() const
   return this->private_->compression_;
 }
 
+BrickCodecType LargeVolumeSchema::get_codec() const
+{
+  return this->private_->codec_;
+}
+
+BrickFilterType LargeVolumeSchema::get_filter() const
+{
+  return this->private_->filter_;
+}
+
 bool LargeVolumeSchema::is_little_endian() const
 {
   return this->private_->little_endian_;
@@ -704,6 +1164,23 @@ void LargeVolumeSchema::set_compression( bool compression )
   this->private_->compression_ = compression;
 }
 
+void LargeVolumeSchema::set_memory_mapping( bool memory_mapping )
+{
+  this->private_->memory_mapping_ = memory_mapping;
+}
+
+void LargeVolumeSchema::set_codec( BrickCodecType codec, BrickFilterType filter )
+{
+  this->private_->codec_ = codec;
+  this->private_->filter_ = filter;
+}
+
+void LargeVolumeSchema::set_level_downsample_ratios( const std::vector< IndexVector >& ratios )
+{
+  this->private_->levels_ = ratios;
+  this->private_->compute_cached_level_info();
+}
+
 void LargeVolumeSchema::compute_levels()
 {
   // Insert level 0:
@@ -763,6 +1240,11 @@ IndexVector LargeVolumeSchema::get_level_layout( index_type level ) const
   return this->private_->level_layout_[ level ];
 }
 
+size_t LargeVolumeSchema::compute_level_num_bricks( index_type level ) const
+{
+  return this->private_->compute_level_num_bricks( level );
+}
+
 IndexVector LargeVolumeSchema::get_brick_size( const BrickInfo& bi ) const
 {
   const IndexVector& effective_brick_size = this->private_->effective_brick_size_;
@@ -784,69 +1266,15 @@ bool LargeVolumeSchema::read_brick( DataBlockHandle& brick, const BrickInfo& bi,
     return false;
   }
 
-  bfs::path brick_file = this->private_->get_brick_file_name( bi );
-
-  if ( !bfs::exists(brick_file ) )
-  {
-    error = "Could not open brick.";
-    return false; 
-  }
-
-  size_t file_size = bfs::file_size( brick_file );
   size_t brick_size = size[0] * size[1] * size[2] * GetSizeDataType( this->get_data_type() );
 
-  if ( brick_size > file_size )
+  if ( this->private_->packed_ )
   {
-    try
-    {
-      std::vector<char> buffer( file_size );
-
-      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
-      input.read( &buffer[0],  file_size);
-      input.close();
-
-      zlib_uLongf brick_size_ul = brick_size;
-      if ( zlib_uncompress( reinterpret_cast<zlib_Bytef*>( brick->get_data() ), &brick_size_ul,
-        reinterpret_cast<zlib_Bytef*>(&buffer[0]), file_size ) != Z_OK)
-      {
-        error = "Could not decompress file '" + brick_file.string() + "'.";
-        return false;
-      }
-
-      if ( brick_size_ul != brick_size )
-      {
-        error = "Brick '" + brick_file.string() + "' contains invalid data.";
-        brick->clear();
-        return false;     
-      }
-    }
-    catch ( ... )
-    {
-      error = "Error reading file '" + brick_file.string() + "'.";
-      brick->clear();
-      return false;
-    }
+    if ( !this->private_->read_packed_brick( brick, brick_size, bi, error ) ) return false;
   }
-  else if ( brick_size == file_size )
-  {
-    try
-    {
-      std::ifstream input( brick_file.string().c_str(), std::ios_base::in | std::ios_base::binary );
-      input.read( reinterpret_cast<char *>(brick->get_data()), brick_size );
-      input.close();
-    }
-    catch ( ... )
-    {
-      error = "Error reading file '" + brick_file.string() + "'.";
-      brick->clear();
-      return false;
-    } 
-  }
-  else 
+  else
   {
-    error = "Brick file is too large to be a brick.";
-    brick->clear();
-    return false;
+    if ( !this->private_->read_brick_file( brick, brick_size, bi, error ) ) return false;
   }
 
   if ( DataBlock::IsLittleEndian() != this->private_->little_endian_ )
@@ -899,85 +1327,9 @@ bool LargeVolumeSchema::append_brick_buffer( DataBlockHandle data_block, size_t
 
 bool LargeVolumeSchema::write_brick( DataBlockHandle data_block, const BrickInfo& bi, std::string& error ) const
 {
-  IndexVector size = this->get_brick_size( bi );
-  
-  if ( size[0] != data_block->get_nx() || size[1] != data_block->get_ny() ||
-    size[2] != data_block->get_nz() )
-  {
-    error = "Brick is of incorrect size.";
-    return false;
-  }
-
-  if ( this->private_->data_type_ != data_block->get_data_type() )
-  {
-    error = "Brick is incorrect data type.";
-    return false;
-  }
-
-  bfs::path brick_file = this->private_->get_brick_file_name( bi );
-
-  size_t brick_size = size[0] * size[1] * size[2] * GetSizeDataType( this->get_data_type() );
-
-  if ( this->private_->compression_) 
-  {
-    std::vector<char> buffer( brick_size + 12 );
-    zlib_uLongf brick_size_ul = brick_size + 12;
-
-    int result = zlib_compress2( reinterpret_cast<zlib_Bytef*>( &buffer[0] ), &brick_size_ul,
-      reinterpret_cast<zlib_Bytef*>(data_block->get_data()), brick_size, Z_DEFAULT_COMPRESSION );
-    if (result != Z_OK )
-    {
-      error = "Could not compress file.";
-      return false;
-    }
-  
-    if ( brick_size_ul < brick_size )
-    {
-      // Compression succeeded
-      try
-      {
-        std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-        output.write( &buffer[0], brick_size_ul );
-      }
-      catch ( ... )
-      {
-        error = "Could not write to file '" + brick_file.string() + "'.";
-        return false;
-      }
-
-    } 
-    else 
-    {
-      try
-      {
-        std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-        output.write( reinterpret_cast<char *>( data_block->get_data() ) , brick_size );
-      }
-      catch ( ... )
-      {
-        error = "Could not write to file '" + brick_file.string() + "'.";
-        return false;
-      }   
-    }
-  }
-  else
-  {
-    try
-    {
-      std::ofstream output( brick_file.string().c_str(), std::ios_base::trunc | std::ios_base::binary | std::ios_base::out );
-      output.write( reinterpret_cast<char *>( data_block->get_data() ) , brick_size );
-    }
-    catch ( ... )
-    {
-      error = "Could not write to file '" + brick_file.string() + "'.";
-      return false;
-    }   
-  }
-
-  return true;
+  return this->private_->write_brick_file( data_block, bi, this->private_->get_brick_file_name( bi ), error );
 }
 
-
 bool LargeVolumeSchema::get_parent(const BrickInfo& bi, BrickInfo& parent)
 {
   BrickInfo::index_type level = bi.level_;
@@ -1121,11 +1473,20 @@ bool LargeVolumeSchema::get_children( const BrickInfo& bi, SliceType slice, doub
 }
 
 
+// Squared distance of a projected brick to the center of the screen in normalized
+// device coordinates, used to load bricks in the center of the view first
+static double ScreenCenterDistance( const BBox& plane )
+{
+  Point center = plane.center();
+  return center.x() * center.x() + center.y() * center.y();
+}
+
 std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_volume( Transform world_viewport, 
   int width, int height, SliceType slice, const BBox& effective_bbox, double depth,
   const std::string& load_key )
 {
   std::vector<BrickInfo> result;
+  std::vector<double> center_distances;
 
   int num_levels = static_cast<int>( this->get_num_levels() );
   int level = num_levels - 1;
@@ -1202,12 +1563,14 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_volume( Transform world
           }
           else
           {
-            result.push_back( bi );       
+            result.push_back( bi );
+            center_distances.push_back( ScreenCenterDistance( plane ) );
           }
         }
         else
         {
           result.push_back( bi );
+          center_distances.push_back( ScreenCenterDistance( plane ) );
         }
       }
       break;
@@ -1259,12 +1622,14 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_volume( Transform world
           }
           else
           {
-            result.push_back( bi );       
+            result.push_back( bi );
+            center_distances.push_back( ScreenCenterDistance( plane ) );
           }
         }
         else
         {
           result.push_back( bi );
+          center_distances.push_back( ScreenCenterDistance( plane ) );
         }
       }
       break;
@@ -1316,12 +1681,14 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_volume( Transform world
           }
           else
           {
-            result.push_back( bi );       
+            result.push_back( bi );
+            center_distances.push_back( ScreenCenterDistance( plane ) );
           }
         }
         else
         {
           result.push_back( bi );
+          center_distances.push_back( ScreenCenterDistance( plane ) );
         }
       }
       break;
@@ -1329,19 +1696,22 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_volume( Transform world
   }
 
   std::vector<BrickInfo> current_render;
-  this->private_->load_and_substitue_missing_bricks( result, slice, depth, load_key, current_render );
+  this->private_->load_and_substitue_missing_bricks( result, center_distances, slice, depth, 
+    load_key, current_render );
 
   return current_render;
 }
 
 void LargeVolumeSchemaPrivate::load_and_substitue_missing_bricks( std::vector<BrickInfo>& want_to_render, 
-  SliceType slice, double depth, const std::string& load_key, std::vector<BrickInfo>& current_render )
+  const std::vector<double>& center_distances, SliceType slice, double depth, 
+  const std::string& load_key, std::vector<BrickInfo>& current_render )
 {
   LargeVolumeCache* cache = LargeVolumeCache::Instance();
 
   index_type num_levels = this->schema_->get_num_levels();
   std::vector<std::set<BrickInfo> > bricks_to_render( num_levels );
   std::vector<BrickInfo> bricks_to_load;
+  std::vector<double> bricks_to_load_distances;
 
   for (size_t k = 0; k < want_to_render.size(); k++)
   {
@@ -1387,6 +1757,7 @@ void LargeVolumeSchemaPrivate::load_and_substitue_missing_bricks( std::vector<Br
         }
       }
       bricks_to_load.push_back( brick );
+      bricks_to_load_distances.push_back( center_distances[ k ] );
     }
     else
     {
@@ -1402,7 +1773,8 @@ void LargeVolumeSchemaPrivate::load_and_substitue_missing_bricks( std::vector<Br
   cache->clear_load_queue( load_key );
   for (size_t k = 0; k < bricks_to_load.size(); k++)
   {
-    cache->load_brick( this->schema_->shared_from_this(), bricks_to_load[ k ], load_key );
+    cache->load_brick( this->schema_->shared_from_this(), bricks_to_load[ k ], load_key, 
+      bricks_to_load_distances[ k ] );
   }
 }
 
@@ -1473,10 +1845,15 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_region( const BBox& reg
   index_type ez = Min( layout.z(), static_cast<index_type>( Floor( max.z() / ( eb.z() * spacing.z()) ) + 1 ) );
 
   std::vector<BrickInfo> want_to_render;
+  std::vector<double> center_distances;
 
   index_type nx = layout.x();
   index_type nxy = layout.x() * layout.y();
 
+  // Distance of each brick to the center of the region, measured in bricks
+  Vector brick_extent( eb.x() * spacing.x(), eb.y() * spacing.y(), eb.z() * spacing.z() );
+  Vector center = region.center() - origin;
+
   for (index_type z = sz; z < ez; z++ )
   {
     for (index_type y = sy; y < ey; y++ )
@@ -1484,12 +1861,23 @@ std::vector<BrickInfo> LargeVolumeSchema::get_bricks_for_region( const BBox& reg
       for (index_type x = sx; x < ex; x++ )
       {
         want_to_render.push_back(BrickInfo( x + nx * y + nxy * z, level ));
+
+        Vector offset( ( x + 0.5 ) - center.x() / brick_extent.x(), 
+          ( y + 0.5 ) - center.y() / brick_extent.y(), ( z + 0.5 ) - center.z() / brick_extent.z() );
+        switch( slice )
+        {
+          case SliceType::SAGITTAL_E: offset.x( 0.0 ); break;
+          case SliceType::CORONAL_E: offset.y( 0.0 ); break;
+          case SliceType::AXIAL_E: offset.z( 0.0 ); break;
+        }
+        center_distances.push_back( offset.length2() );
       }
     } 
   }
 
   std::vector<BrickInfo> current_render;
-  this->private_->load_and_substitue_missing_bricks( want_to_render, slice, depth, load_key, current_render );
+  this->private_->load_and_substitue_missing_bricks( want_to_render, center_distances, slice, depth, 
+    load_key, current_render );
 
   return current_render;
 }
@@ -1508,25 +1896,179 @@ bool LargeVolumeSchema::reprocess_brick( const BrickInfo& bi,
   }
 
 
-  // Delete file, so that when we write the file again it will be more likely
-  // to be in a continuous block, especially since we do it as one write, hence
-  // a good FS should give us contiguous blocks on disk
+  // Write the file as one entity to a new file, so that it is more likely to end up
+  // in a continuous block, especially since we do it as one write, hence a good FS
+  // should give us contiguous blocks on disk. The new file replaces the old one in
+  // one step, so an interrupted conversion never leaves a partially written brick.
   bfs::path brick_file = this->private_->get_brick_file_name( bi );
-  if (! bfs::remove( brick_file ) )
+  bfs::path tmp_file = brick_file.string() + ".tmp";
+  if (! this->private_->write_brick_file( data_block, bi, tmp_file, error ) )
   {
-    error = "Could not remove brick file.";
     return false;
   }
 
-  // Write the file as one entity back to disk
-  if (! this->write_brick( data_block, bi, error ) )
+  try
   {
+    bfs::rename( tmp_file, brick_file );
+  }
+  catch ( ... )
+  {
+    error = "Could not replace brick file '" + brick_file.string() + "'.";
     return false;
   }
 
   return true;
 }
 
+bool LargeVolumeSchema::begin_packed_file( std::string& error ) const
+{
+  this->private_->close_pack();
+
+  bfs::path pack_file = this->private_->get_pack_file_name();
+  size_t num_bricks = this->private_->level_brick_offset_.back();
+  size_t header_size = PackHeaderSize( num_bricks );
+
+  boost::mutex::scoped_lock lock( this->private_->pack_mutex_ );
+  this->private_->packed_ = false;
+  this->private_->pack_index_.assign( num_bricks, LargeVolumeSchemaPrivate::pack_entry_type( 0, 0 ) );
+
+  try
+  {
+    this->private_->pack_stream_.reset( new std::fstream( pack_file.string().c_str(),
+      std::ios_base::out | std::ios_base::trunc | std::ios_base::binary ) );
+
+    // Reserve space for the header, it is filled in once all bricks have been written
+    std::vector<char> header( header_size, 0 );
+    this->private_->pack_stream_->write( &header[ 0 ], header_size );
+    if ( !( *this->private_->pack_stream_ ) )
+    {
+      this->private_->pack_stream_.reset();
+      error = "Could not write to file '" + pack_file.string() + "'.";
+      return false;
+    }
+  }
+  catch ( ... )
+  {
+    this->private_->pack_stream_.reset();
+    error = "Could not create file '" + pack_file.string() + "'.";
+    return false;
+  }
+
+  this->private_->pack_end_ = header_size;
+  return true;
+}
+
+bool LargeVolumeSchema::write_packed_brick( DataBlockHandle data_block, 
+  const BrickInfo& bi, std::string& error ) const
+{
+  size_t brick_size = 0;
+  if ( !this->private_->check_brick( data_block, bi, brick_size, error ) ) return false;
+
+  // Compress outside of the lock, so multiple threads can compress bricks at the same time
+  std::vector<char> buffer;
+  const char* data = reinterpret_cast<const char*>( data_block->get_data() );
+  size_t length = brick_size;
+  if ( this->private_->compression_ && BrickCodec::Compress( this->private_->codec_, 
+    this->private_->filter_, this->private_->data_type_, data_block->get_data(), brick_size, buffer ) ) 
+  {
+    data = &buffer[ 0 ];
+    length = buffer.size();
+  }
+
+  boost::mutex::scoped_lock lock( this->private_->pack_mutex_ );
+  size_t entry = this->private_->get_pack_entry( bi );
+  if ( !this->private_->pack_stream_ || entry >= this->private_->pack_index_.size() )
+  {
+    error = "Pack file is not open for writing.";
+    return false;
+  }
+
+  try
+  {
+    this->private_->pack_stream_->seekp( static_cast<std::streamoff>( this->private_->pack_end_ ),
+      std::ios_base::beg );
+    this->private_->pack_stream_->write( data, length );
+    if ( !( *this->private_->pack_stream_ ) )
+    {
+      error = "Could not write to file '" + this->private_->get_pack_file_name().string() + "'.";
+      return false;
+    }
+  }
+  catch ( ... )
+  {
+    error = "Could not write to file '" + this->private_->get_pack_file_name().string() + "'.";
+    return false;
+  }
+
+  this->private_->pack_index_[ entry ] = 
+    LargeVolumeSchemaPrivate::pack_entry_type( this->private_->pack_end_, length );
+  this->private_->pack_end_ += length;
+
+  return true;
+}
+
+bool LargeVolumeSchema::end_packed_file( std::string& error ) const
+{
+  bfs::path pack_file = this->private_->get_pack_file_name();
+
+  {
+    boost::mutex::scoped_lock lock( this->private_->pack_mutex_ );
+    if ( !this->private_->pack_stream_ )
+    {
+      error = "Pack file is not open for writing.";
+      return false;
+    }
+
+    const std::vector< LargeVolumeSchemaPrivate::pack_entry_type >& index = this->private_->pack_index_;
+    for ( size_t j = 0; j < index.size(); j++ )
+    {
+      if ( index[ j ].second == 0 )
+      {
+        error = "Not all bricks were written to file '" + pack_file.string() + "'.";
+        return false;
+      }
+    }
+
+    std::vector<unsigned char> header( PackHeaderSize( index.size() ) );
+    std::memcpy( &header[ 0 ], PACK_MAGIC_C, sizeof( PACK_MAGIC_C ) );
+    EncodePackNumber( index.size(), &header[ sizeof( PACK_MAGIC_C ) ] );
+    for ( size_t j = 0; j < index.size(); j++ )
+    {
+      EncodePackNumber( index[ j ].first, &header[ sizeof( PACK_MAGIC_C ) + 8 + 16 * j ] );
+      EncodePackNumber( index[ j ].second, &header[ sizeof( PACK_MAGIC_C ) + 16 + 16 * j ] );
+    }
+
+    try
+    {
+      this->private_->pack_stream_->seekp( 0, std::ios_base::beg );
+      this->private_->pack_stream_->write( reinterpret_cast<char*>( &header[ 0 ] ), header.size() );
+      this->private_->pack_stream_->flush();
+      if ( !( *this->private_->pack_stream_ ) )
+      {
+        error = "Could not write to file '" + pack_file.string() + "'.";
+        return false;
+      }
+      this->private_->pack_stream_->close();
+    }
+    catch ( ... )
+    {
+      error = "Could not write to file '" + pack_file.string() + "'.";
+      return false;
+    }
+
+    this->private_->pack_stream_.reset();
+    this->private_->packed_ = true;
+  }
+
+  // Reopen the file for reading
+  return this->private_->open_pack( error );
+}
+
+bool LargeVolumeSchema::is_packed() const
+{
+  return this->private_->packed_;
+}
+
 void LargeVolumeSchema::enable_downsample( bool downsample_x, bool downsample_y, bool downsample_z )
 {
   this->private_->downsample_x_ = downsample_x;
@@ -37,6 +37,7 @@
 #include <Core/Geometry/GridTransform.h>
 #include <Core/DataBlock/DataType.h>
 #include <Core/DataBlock/DataBlock.h>
+#include <Core/LargeVolume/BrickCodec.h>
 
 // Boost includes
 #include <boost/shared_ptr.hpp>
@@ -156,6 +157,10 @@ public:
   // GET_DIR
   boost::filesystem::path get_dir() const;
 
+  /// GET_ID
+  /// Get the id that uniquely identifies this schema within the running program
+  size_t get_id() const;
+
   // GET_SIZE
   // Get size as an index
   const IndexVector& get_size() const;
@@ -189,6 +194,18 @@ public:
   /// Check whether the data is compressed
   bool is_compressed() const;
 
+  /// GET_CODEC
+  /// Get the codec used for compressing bricks
+  BrickCodecType get_codec() const;
+
+  /// GET_FILTER
+  /// Get the filter applied to bricks before compression
+  BrickFilterType get_filter() const;
+
+  /// IS_PACKED
+  /// Check whether the bricks are stored in a single pack file
+  bool is_packed() const;
+
   /// IS_LITTLE_ENDIAN
   /// Check whether data is little endian
   bool is_little_endian() const;
@@ -221,6 +238,15 @@ public:
   /// Set whether data is compressed
   void set_compression( bool compression );
 
+  /// SET_CODEC
+  /// Set the codec and filter used for compressing bricks
+  void set_codec( BrickCodecType codec, BrickFilterType filter );
+
+  /// SET_MEMORY_MAPPING
+  /// Set whether a pack file is mapped into memory, otherwise bricks are read from it 
+  /// with explicit seeks. This needs to be set before the schema is loaded.
+  void set_memory_mapping( bool memory_mapping );
+
   /// SET_MIN_MAX
   /// Set min and max values for the dataset
   void set_min_max( double min, double max ) const;
@@ -229,6 +255,11 @@ public:
   /// Enable down sample in certain directions only
   void enable_downsample( bool downsample_x, bool downsample_y, bool downsample_z );
 
+  /// SET_LEVEL_DOWNSAMPLE_RATIOS
+  /// Use the given downsample ratios as levels instead of computing them, so a volume
+  /// can be given the same levels as another volume
+  void set_level_downsample_ratios( const std::vector< IndexVector >& ratios );
+
   // -- schema computations --
 public:
 
@@ -318,6 +349,21 @@ public:
   bool reprocess_brick( const BrickInfo& bi,
     std::string& error ) const;
 
+  /// BEGIN_PACKED_FILE
+  /// Start writing all bricks into a single pack file, bricks are read from the
+  /// individual brick files until END_PACKED_FILE is called
+  bool begin_packed_file( std::string& error ) const;
+
+  /// WRITE_PACKED_BRICK
+  /// Compress a brick and append it to the pack file, this function is thread safe
+  bool write_packed_brick( DataBlockHandle data_block, 
+    const BrickInfo& bi, std::string& error ) const;
+
+  /// END_PACKED_FILE
+  /// Write the brick index to the pack file and switch to reading bricks from it
+  /// NOTE: The schema needs to be saved afterwards to record the new layout
+  bool end_packed_file( std::string& error ) const;
+
   /// APPEND_BRICK_BUFFER
   /// Append data to a brick to disk
   bool append_brick_buffer( DataBlockHandle data_block, size_t z_start, size_t z_end, const size_t offset,
@@ -0,0 +1,249 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <Core/LargeVolume/BrickCodec.h>
+
+using namespace Core;
+
+namespace
+{
+
+const BrickCodecType CODECS[] = { BrickCodecType::ZLIB_E, BrickCodecType::LZ4_E };
+
+const BrickFilterType FILTERS[] = 
+  { BrickFilterType::NONE_E, BrickFilterType::SHUFFLE_E, BrickFilterType::DELTA_SHUFFLE_E };
+
+const DataType DATA_TYPES[] = { DataType::CHAR_E, DataType::UCHAR_E, DataType::SHORT_E, 
+  DataType::USHORT_E, DataType::INT_E, DataType::UINT_E, DataType::LONGLONG_E, 
+  DataType::ULONGLONG_E, DataType::FLOAT_E, DataType::DOUBLE_E };
+
+// Elements in a brick, odd so no filter can rely on a round number of elements
+const size_t NUM_ELEMENTS = 33 * 29 * 17;
+
+template< class T >
+void FillImage( T* data, size_t num_elements )
+{
+  // Smooth ramps with a little noise, which is what the filters are made for
+  for ( size_t j = 0; j < num_elements; j++ )
+  {
+    data[ j ] = static_cast< T >( ( j % 33 ) * 3 + ( j / 33 ) % 29 + ( ( j * 7919 ) % 5 ) );
+  }
+}
+
+std::vector< char > CreateImage( DataType data_type, size_t num_elements )
+{
+  std::vector< char > data( num_elements * GetSizeDataType( data_type ) );
+  void* ptr = &data[ 0 ];
+  switch ( data_type )
+  {
+    case DataType::CHAR_E: FillImage( static_cast< signed char* >( ptr ), num_elements ); break;
+    case DataType::UCHAR_E: FillImage( static_cast< unsigned char* >( ptr ), num_elements ); break;
+    case DataType::SHORT_E: FillImage( static_cast< short* >( ptr ), num_elements ); break;
+    case DataType::USHORT_E: FillImage( static_cast< unsigned short* >( ptr ), num_elements ); break;
+    case DataType::INT_E: FillImage( static_cast< int* >( ptr ), num_elements ); break;
+    case DataType::UINT_E: FillImage( static_cast< unsigned int* >( ptr ), num_elements ); break;
+    case DataType::LONGLONG_E: FillImage( static_cast< long long* >( ptr ), num_elements ); break;
+    case DataType::ULONGLONG_E: 
+      FillImage( static_cast< unsigned long long* >( ptr ), num_elements ); break;
+    case DataType::FLOAT_E: FillImage( static_cast< float* >( ptr ), num_elements ); break;
+    case DataType::DOUBLE_E: FillImage( static_cast< double* >( ptr ), num_elements ); break;
+    default: break;
+  }
+  return data;
+}
+
+std::vector< char > CreateNoise( size_t size )
+{
+  std::vector< char > data( size );
+  boost::uint32_t state = 12345;
+  for ( size_t j = 0; j < size; j++ )
+  {
+    state = state * 1664525u + 1013904223u;
+    data[ j ] = static_cast< char >( state >> 24 );
+  }
+  return data;
+}
+
+// Compress and decompress the data, returns false if either step fails
+::testing::AssertionResult RoundTrip( BrickCodecType codec, BrickFilterType filter, 
+  DataType data_type, const std::vector< char >& data )
+{
+  std::vector< char > buffer;
+  if ( !BrickCodec::Compress( codec, filter, data_type, &data[ 0 ], data.size(), buffer ) )
+  {
+    return ::testing::AssertionFailure() << "compress failed";
+  }
+
+  std::vector< char > result( data.size(), 0 );
+  if ( !BrickCodec::Decompress( codec, filter, data_type, &buffer[ 0 ], buffer.size(), 
+    &result[ 0 ], result.size() ) )
+  {
+    return ::testing::AssertionFailure() << "decompress failed";
+  }
+
+  if ( std::memcmp( &data[ 0 ], &result[ 0 ], data.size() ) != 0 )
+  {
+    return ::testing::AssertionFailure() << "data differs";
+  }
+  return ::testing::AssertionSuccess();
+}
+
+} // end anonymous namespace
+
+TEST( BrickCodecTest, RoundTripsEveryCombination )
+{
+  for ( size_t c = 0; c < sizeof( CODECS ) / sizeof( CODECS[ 0 ] ); c++ )
+  {
+    for ( size_t f = 0; f < sizeof( FILTERS ) / sizeof( FILTERS[ 0 ] ); f++ )
+    {
+      for ( size_t t = 0; t < sizeof( DATA_TYPES ) / sizeof( DATA_TYPES[ 0 ] ); t++ )
+      {
+        std::vector< char > data = CreateImage( DATA_TYPES[ t ], NUM_ELEMENTS );
+        EXPECT_TRUE( RoundTrip( CODECS[ c ], FILTERS[ f ], DATA_TYPES[ t ], data ) ) 
+          << ExportToString( CODECS[ c ] ) << " " << ExportToString( FILTERS[ f ] ) << " "
+          << ExportToString( DATA_TYPES[ t ] );
+      }
+    }
+  }
+}
+
+TEST( BrickCodecTest, RoundTripsPartialElements )
+{
+  // Bytes at the end that do not form a whole element are not shuffled
+  std::vector< char > data = CreateImage( DataType::INT_E, NUM_ELEMENTS );
+  data.resize( data.size() - 3 );
+  for ( size_t c = 0; c < sizeof( CODECS ) / sizeof( CODECS[ 0 ] ); c++ )
+  {
+    for ( size_t f = 0; f < sizeof( FILTERS ) / sizeof( FILTERS[ 0 ] ); f++ )
+    {
+      EXPECT_TRUE( RoundTrip( CODECS[ c ], FILTERS[ f ], DataType::INT_E, data ) )
+        << ExportToString( CODECS[ c ] ) << " " << ExportToString( FILTERS[ f ] );
+    }
+  }
+}
+
+TEST( BrickCodecTest, RoundTripsLongRunsAndLiterals )
+{
+  // Runs of one value are copied with overlapping matches, and literal and match lengths
+  // above 15 and 270 need extra length bytes
+  std::vector< char > data( 70000, 0 );
+  std::vector< char > noise = CreateNoise( 1000 );
+  std::memcpy( &data[ 20000 ], &noise[ 0 ], noise.size() );
+  for ( size_t j = 40000; j < 50000; j++ ) data[ j ] = static_cast< char >( "abc"[ j % 3 ] );
+  for ( size_t j = 0; j < 20; j++ ) data[ 60000 + j * 17 ] = static_cast< char >( j + 1 );
+
+  EXPECT_TRUE( RoundTrip( BrickCodecType::LZ4_E, BrickFilterType::NONE_E, 
+    DataType::UCHAR_E, data ) );
+  EXPECT_TRUE( RoundTrip( BrickCodecType::ZLIB_E, BrickFilterType::NONE_E, 
+    DataType::UCHAR_E, data ) );
+}
+
+TEST( BrickCodecTest, RejectsIncompressibleData )
+{
+  // Bricks that do not get smaller are stored as is
+  std::vector< char > data = CreateNoise( 100000 );
+  std::vector< char > buffer;
+  for ( size_t c = 0; c < sizeof( CODECS ) / sizeof( CODECS[ 0 ] ); c++ )
+  {
+    EXPECT_FALSE( BrickCodec::Compress( CODECS[ c ], BrickFilterType::NONE_E, 
+      DataType::UCHAR_E, &data[ 0 ], data.size(), buffer ) ) << ExportToString( CODECS[ c ] );
+  }
+
+  std::vector< char > image = CreateImage( DataType::SHORT_E, NUM_ELEMENTS );
+  EXPECT_FALSE( BrickCodec::Compress( BrickCodecType::NONE_E, BrickFilterType::NONE_E,
+    DataType::SHORT_E, &image[ 0 ], image.size(), buffer ) );
+}
+
+TEST( BrickCodecTest, RejectsTruncatedInput )
+{
+  std::vector< char > data = CreateImage( DataType::USHORT_E, NUM_ELEMENTS );
+  for ( size_t c = 0; c < sizeof( CODECS ) / sizeof( CODECS[ 0 ] ); c++ )
+  {
+    std::vector< char > buffer;
+    ASSERT_TRUE( BrickCodec::Compress( CODECS[ c ], BrickFilterType::SHUFFLE_E, 
+      DataType::USHORT_E, &data[ 0 ], data.size(), buffer ) );
+
+    std::vector< char > result( data.size() );
+    const size_t lengths[] = { buffer.size() - 1, buffer.size() / 2, 1 };
+    for ( size_t j = 0; j < sizeof( lengths ) / sizeof( lengths[ 0 ] ); j++ )
+    {
+      EXPECT_FALSE( BrickCodec::Decompress( CODECS[ c ], BrickFilterType::SHUFFLE_E, 
+        DataType::USHORT_E, &buffer[ 0 ], lengths[ j ], &result[ 0 ], result.size() ) )
+        << ExportToString( CODECS[ c ] ) << " truncated to " << lengths[ j ];
+    }
+
+    // The data needs to decompress to exactly the size of the brick
+    EXPECT_FALSE( BrickCodec::Decompress( CODECS[ c ], BrickFilterType::SHUFFLE_E, 
+      DataType::USHORT_E, &buffer[ 0 ], buffer.size(), &result[ 0 ], result.size() - 2 ) )
+      << ExportToString( CODECS[ c ] );
+    result.resize( data.size() + 2 );
+    EXPECT_FALSE( BrickCodec::Decompress( CODECS[ c ], BrickFilterType::SHUFFLE_E, 
+      DataType::USHORT_E, &buffer[ 0 ], buffer.size(), &result[ 0 ], result.size() ) )
+      << ExportToString( CODECS[ c ] );
+  }
+}
+
+TEST( BrickCodecTest, RejectsCorruptLz4Offsets )
+{
+  // A single match that refers to data before the start of the output
+  const unsigned char corrupt[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+  std::vector< char > result( 6 );
+  EXPECT_FALSE( BrickCodec::Decompress( BrickCodecType::LZ4_E, BrickFilterType::NONE_E, 
+    DataType::UCHAR_E, reinterpret_cast< const char* >( corrupt ), sizeof( corrupt ), 
+    &result[ 0 ], result.size() ) );
+}
+
+TEST( BrickCodecTest, ImportsAndExportsNames )
+{
+  const BrickCodecType codecs[] = 
+    { BrickCodecType::NONE_E, BrickCodecType::ZLIB_E, BrickCodecType::LZ4_E };
+  for ( size_t j = 0; j < sizeof( codecs ) / sizeof( codecs[ 0 ] ); j++ )
+  {
+    BrickCodecType codec = BrickCodecType::NONE_E;
+    EXPECT_TRUE( ImportFromString( ExportToString( codecs[ j ] ), codec ) );
+    EXPECT_EQ( codecs[ j ], codec );
+  }
+
+  for ( size_t j = 0; j < sizeof( FILTERS ) / sizeof( FILTERS[ 0 ] ); j++ )
+  {
+    BrickFilterType filter = BrickFilterType::NONE_E;
+    EXPECT_TRUE( ImportFromString( ExportToString( FILTERS[ j ] ), filter ) );
+    EXPECT_EQ( FILTERS[ j ], filter );
+  }
+
+  BrickCodecType codec = BrickCodecType::NONE_E;
+  EXPECT_FALSE( ImportFromString( "zstd", codec ) );
+  BrickFilterType filter = BrickFilterType::NONE_E;
+  EXPECT_FALSE( ImportFromString( "bitshuffle", filter ) );
+}
@@ -0,0 +1,432 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIterator.h>
+
+#include <Core/LargeVolume/LargeVolumeConverter.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+using namespace Core;
+
+namespace
+{
+
+// The stack is bricked into several layers of bricks at every level, so conversions
+// can be restarted and slices can be appended in the middle of a layer
+const size_t NX = 37;
+const size_t NY = 29;
+const size_t NZ = 21;
+const IndexVector BRICK_SIZE( 16, 16, 8 );
+const size_t OVERLAP = 1;
+
+typedef itk::Image< unsigned char, 2 > ImageType;
+
+boost::filesystem::path GetSliceFileName( const boost::filesystem::path& dir, size_t z )
+{
+  std::string number = boost::lexical_cast< std::string >( z );
+  return dir / ( "slice_" + std::string( 3 - number.size(), '0' ) + number + ".png" );
+}
+
+void WriteSlice( const boost::filesystem::path& dir, size_t z )
+{
+  ImageType::RegionType region;
+  region.SetSize( 0, NX );
+  region.SetSize( 1, NY );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+
+  itk::ImageRegionIterator< ImageType > it( image, region );
+  for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    ImageType::IndexType index = it.GetIndex();
+    it.Set( static_cast< unsigned char >( ( 3 * index[ 0 ] + 5 * index[ 1 ] + 7 * z ) % 251 ) );
+  }
+
+  typedef itk::ImageFileWriter< ImageType > WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetFileName( GetSliceFileName( dir, z ).string() );
+  writer->SetInput( image );
+  writer->Update();
+}
+
+// Write slices [ start, end ) of the image stack
+void WriteSlices( const boost::filesystem::path& dir, size_t start, size_t end )
+{
+  boost::filesystem::create_directories( dir );
+  for ( size_t z = start; z < end; z++ )
+  {
+    WriteSlice( dir, z );
+  }
+}
+
+LargeVolumeSchemaHandle LoadVolume( const boost::filesystem::path& dir )
+{
+  LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+  schema->set_dir( dir );
+  std::string error;
+  if ( !schema->load( error ) ) schema.reset();
+  return schema;
+}
+
+// Check that two volumes are laid out the same and contain the same bricks
+::testing::AssertionResult VolumesMatch( const boost::filesystem::path& expected_dir,
+  const boost::filesystem::path& dir )
+{
+  LargeVolumeSchemaHandle expected = LoadVolume( expected_dir );
+  LargeVolumeSchemaHandle schema = LoadVolume( dir );
+  if ( !expected || !schema )
+  {
+    return ::testing::AssertionFailure() << "volume could not be loaded";
+  }
+
+  if ( expected->get_size() != schema->get_size() ||
+    expected->get_num_levels() != schema->get_num_levels() ||
+    expected->get_min() != schema->get_min() || expected->get_max() != schema->get_max() )
+  {
+    return ::testing::AssertionFailure() << "volume files differ";
+  }
+
+  for ( size_t level = 0; level < expected->get_num_levels(); level++ )
+  {
+    for ( size_t index = 0; index < expected->compute_level_num_bricks( level ); index++ )
+    {
+      BrickInfo bi( index, level );
+      DataBlockHandle expected_brick, brick;
+      std::string error;
+      if ( !expected->read_brick( expected_brick, bi, error ) || 
+        !schema->read_brick( brick, bi, error ) )
+      {
+        return ::testing::AssertionFailure() << "brick " << level << ":" << index << 
+          " could not be read: " << error;
+      }
+
+      if ( expected_brick->get_byte_size() != brick->get_byte_size() ||
+        std::memcmp( expected_brick->get_data(), brick->get_data(), 
+        brick->get_byte_size() ) != 0 )
+      {
+        return ::testing::AssertionFailure() << "brick " << level << ":" << index << 
+          " differs";
+      }
+    }
+  }
+
+  return ::testing::AssertionSuccess();
+}
+
+// Check that no intermediate files of a conversion are left behind
+::testing::AssertionResult IsComplete( const boost::filesystem::path& dir )
+{
+  boost::filesystem::directory_iterator dir_end;
+  for ( boost::filesystem::directory_iterator it( dir ); it != dir_end; ++it )
+  {
+    std::string extension = boost::filesystem::extension( it->path() );
+    if ( extension == ".append" || extension == ".tmp" || 
+      it->path().filename() == "conversion.txt" )
+    {
+      return ::testing::AssertionFailure() << it->path().string() << " was left behind";
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+} // end anonymous namespace
+
+class LargeVolumeConverterTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    this->dir_ = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path( "large-volume-converter-%%%%-%%%%" );
+    boost::filesystem::create_directories( this->dir_ );
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove_all( this->dir_ );
+  }
+
+  LargeVolumeConverterHandle create_converter( const boost::filesystem::path& stack_dir,
+    const boost::filesystem::path& output_dir )
+  {
+    LargeVolumeConverterHandle converter( new LargeVolumeConverter );
+    converter->set_output_dir( output_dir );
+    converter->set_first_file( GetSliceFileName( stack_dir, 0 ) );
+    converter->set_schema_parameters( Vector( 1.0, 1.0, 1.0 ), Point( 0.0, 0.0, 0.0 ),
+      BRICK_SIZE, OVERLAP );
+    converter->set_mem_limit( 64 * 1024 * 1024 );
+    converter->set_num_threads( 2 );
+    return converter;
+  }
+
+  // Convert the image stack in one go
+  void convert( const boost::filesystem::path& stack_dir, 
+    const boost::filesystem::path& output_dir, bool packed = false )
+  {
+    LargeVolumeConverterHandle converter = this->create_converter( stack_dir, output_dir );
+    converter->set_packed( packed );
+    std::string error;
+    ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+    ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+    ASSERT_TRUE( converter->run_phase3( error ) ) << error;
+  }
+
+  // Continue an interrupted conversion
+  void resume( const boost::filesystem::path& stack_dir, 
+    const boost::filesystem::path& output_dir )
+  {
+    LargeVolumeConverterHandle converter = this->create_converter( stack_dir, output_dir );
+    converter->set_resume( true );
+    std::string error;
+    ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+    ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+    ASSERT_TRUE( converter->run_phase3( error ) ) << error;
+  }
+
+  boost::filesystem::path dir_;
+};
+
+TEST_F( LargeVolumeConverterTest, ResumesAfterPhase1 )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, NZ );
+  this->convert( stack_dir, this->dir_ / "expected" );
+
+  // Nothing is written before phase 2, so there is nothing to resume
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  std::string error;
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+
+  converter = this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_resume( true );
+  EXPECT_FALSE( converter->run_phase1( error ) );
+
+  this->convert( stack_dir, this->dir_ / "output" );
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+  EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, ResumesDuringPhase2 )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, NZ );
+  this->convert( stack_dir, this->dir_ / "expected" );
+
+  // Interrupt the conversion with a slice that cannot be read
+  size_t bad_slice = NZ - 3;
+  {
+    std::ofstream output( GetSliceFileName( stack_dir, bad_slice ).string().c_str(),
+      std::ios_base::trunc | std::ios_base::binary );
+    output << "not an image";
+  }
+
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  std::string error;
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+  EXPECT_FALSE( converter->run_phase2( error ) );
+  ASSERT_TRUE( boost::filesystem::exists( this->dir_ / "output" / "conversion.txt" ) );
+
+  // A new conversion cannot start on top of the interrupted one
+  converter = this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_append( true );
+  EXPECT_FALSE( converter->run_phase1( error ) );
+
+  WriteSlice( stack_dir, bad_slice );
+
+  // The conversion continues from its last checkpoint instead of the first slice
+  converter = this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_resume( true );
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+  EXPECT_GT( converter->get_start_slice(), 0u );
+  EXPECT_LE( converter->get_start_slice(), bad_slice );
+  ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+  ASSERT_TRUE( converter->run_phase3( error ) ) << error;
+
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+  EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, ResumesAfterPhase2 )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, NZ );
+  this->convert( stack_dir, this->dir_ / "expected" );
+
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  std::string error;
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+  ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+  converter.reset();
+
+  this->resume( stack_dir, this->dir_ / "output" );
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+  EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, ResumesDuringPhase3 )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, NZ );
+  this->convert( stack_dir, this->dir_ / "expected" );
+
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  std::string error;
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+  ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+  converter.reset();
+
+  // Compress every other brick, as phase 3 would have before being interrupted
+  LargeVolumeSchemaHandle schema = LoadVolume( this->dir_ / "output" );
+  ASSERT_TRUE( schema );
+  schema->set_compression( true );
+  for ( size_t level = 0; level < schema->get_num_levels(); level++ )
+  {
+    for ( size_t index = 0; index < schema->compute_level_num_bricks( level ); index += 2 )
+    {
+      ASSERT_TRUE( schema->reprocess_brick( BrickInfo( index, level ), error ) ) << error;
+    }
+  }
+
+  this->resume( stack_dir, this->dir_ / "output" );
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+  EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, AppendsSlices )
+{
+  WriteSlices( this->dir_ / "full", 0, NZ );
+  this->convert( this->dir_ / "full", this->dir_ / "expected" );
+
+  // Append twice, each time starting in the middle of a layer of bricks, so some bricks
+  // are reduced to the slices that are kept and others are rebuilt completely
+  const size_t stack_sizes[] = { 5, 13, NZ };
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, stack_sizes[ 0 ] );
+  this->convert( stack_dir, this->dir_ / "output" );
+
+  for ( size_t j = 1; j < 3; j++ )
+  {
+    WriteSlices( stack_dir, stack_sizes[ j - 1 ], stack_sizes[ j ] );
+
+    LargeVolumeConverterHandle converter = 
+      this->create_converter( stack_dir, this->dir_ / "output" );
+    converter->set_append( true );
+    std::string error;
+    ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+    EXPECT_LE( converter->get_start_slice(), stack_sizes[ j - 1 ] );
+    ASSERT_TRUE( converter->run_phase2( error ) ) << error;
+    ASSERT_TRUE( converter->run_phase3( error ) ) << error;
+    EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+  }
+
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, ResumesAppendingSlices )
+{
+  WriteSlices( this->dir_ / "full", 0, NZ );
+  this->convert( this->dir_ / "full", this->dir_ / "expected" );
+
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, 11 );
+  this->convert( stack_dir, this->dir_ / "output" );
+  WriteSlices( stack_dir, 11, NZ );
+
+  // Interrupt appending after the bricks were prepared, but before they were bricked
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_append( true );
+  std::string error;
+  ASSERT_TRUE( converter->run_phase1( error ) ) << error;
+  {
+    std::ofstream output( GetSliceFileName( stack_dir, 11 ).string().c_str(),
+      std::ios_base::trunc | std::ios_base::binary );
+    output << "not an image";
+  }
+  EXPECT_FALSE( converter->run_phase2( error ) );
+  converter.reset();
+
+  WriteSlice( stack_dir, 11 );
+  this->resume( stack_dir, this->dir_ / "output" );
+  EXPECT_TRUE( VolumesMatch( this->dir_ / "expected", this->dir_ / "output" ) );
+  EXPECT_TRUE( IsComplete( this->dir_ / "output" ) );
+}
+
+TEST_F( LargeVolumeConverterTest, RejectsAppendingToPackedVolume )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, 8 );
+  this->convert( stack_dir, this->dir_ / "output", true );
+
+  LargeVolumeSchemaHandle schema = LoadVolume( this->dir_ / "output" );
+  ASSERT_TRUE( schema );
+  EXPECT_TRUE( schema->is_packed() );
+
+  WriteSlices( stack_dir, 8, NZ );
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_append( true );
+  std::string error;
+  EXPECT_FALSE( converter->run_phase1( error ) );
+  EXPECT_NE( std::string::npos, error.find( "one file per brick" ) );
+
+  // The existing volume is left untouched
+  schema = LoadVolume( this->dir_ / "output" );
+  ASSERT_TRUE( schema );
+  EXPECT_EQ( 8u, schema->get_nz() );
+}
+
+TEST_F( LargeVolumeConverterTest, RejectsAppendingWithoutNewSlices )
+{
+  boost::filesystem::path stack_dir = this->dir_ / "stack";
+  WriteSlices( stack_dir, 0, 8 );
+  this->convert( stack_dir, this->dir_ / "output" );
+
+  LargeVolumeConverterHandle converter = 
+    this->create_converter( stack_dir, this->dir_ / "output" );
+  converter->set_append( true );
+  std::string error;
+  EXPECT_FALSE( converter->run_phase1( error ) );
+  EXPECT_FALSE( error.empty() );
+}
@@ -0,0 +1,513 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/LargeVolumeFilter.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+using namespace Core;
+
+namespace
+{
+
+typedef IndexVector::index_type index_type;
+
+// Several bricks along each axis and several levels, with partial bricks at the far edges
+const IndexVector VOLUME_SIZE( 41, 35, 27 );
+const IndexVector BRICK_SIZE( 16, 16, 16 );
+const size_t OVERLAP = 2;
+
+// A level of a volume held in memory, samples are stored as the values of their data type
+struct Volume
+{
+  IndexVector size_;
+  std::vector< double > data_;
+
+  double at( index_type x, index_type y, index_type z ) const
+  {
+    // Samples outside the volume are copies of the nearest sample inside the volume
+    x = std::min( std::max( x, index_type( 0 ) ), this->size_.x() - 1 );
+    y = std::min( std::max( y, index_type( 0 ) ), this->size_.y() - 1 );
+    z = std::min( std::max( z, index_type( 0 ) ), this->size_.z() - 1 );
+    return this->data_[ x + this->size_.x() * ( y + this->size_.y() * z ) ];
+  }
+
+  double& operator()( index_type x, index_type y, index_type z )
+  {
+    return this->data_[ x + this->size_.x() * ( y + this->size_.y() * z ) ];
+  }
+};
+
+Volume CreateVolume( const IndexVector& size )
+{
+  Volume volume;
+  volume.size_ = size;
+  volume.data_.resize( size.x() * size.y() * size.z() );
+  return volume;
+}
+
+// Round and clamp a value to an integer type, or convert it to a floating point type
+double RoundValue( double value, DataType data_type )
+{
+  switch ( data_type )
+  {
+    case DataType::UCHAR_E:
+      return std::min( std::max( value < 0.0 ? std::ceil( value - 0.5 ) : 
+        std::floor( value + 0.5 ), 0.0 ), 255.0 );
+    case DataType::SHORT_E:
+      return std::min( std::max( value < 0.0 ? std::ceil( value - 0.5 ) : 
+        std::floor( value + 0.5 ), -32768.0 ), 32767.0 );
+    default:
+      return static_cast< float >( value );
+  }
+}
+
+// Truncate a value to the data type, as a cast does
+double TruncateValue( double value, DataType data_type )
+{
+  switch ( data_type )
+  {
+    case DataType::UCHAR_E:
+      return static_cast< unsigned char >( value );
+    case DataType::SHORT_E:
+      return static_cast< short >( value );
+    default:
+      return static_cast< float >( value );
+  }
+}
+
+Volume CreateSource()
+{
+  Volume volume = CreateVolume( VOLUME_SIZE );
+  for ( index_type z = 0; z < VOLUME_SIZE.z(); z++ )
+  {
+    for ( index_type y = 0; y < VOLUME_SIZE.y(); y++ )
+    {
+      for ( index_type x = 0; x < VOLUME_SIZE.x(); x++ )
+      {
+        volume( x, y, z ) = static_cast< double >( ( x * 7 + y * 13 + z * 29 + 
+          ( x * y * z ) % 11 ) % 97 ) - 20.0;
+      }
+    }
+  }
+  return volume;
+}
+
+// Filter the whole level in memory
+Volume FilterVolume( const Volume& source, LargeVolumeFilterType filter, double parameter,
+  DataType data_type )
+{
+  Volume result = CreateVolume( source.size_ );
+  IndexVector size = source.size_;
+
+  if ( filter == LargeVolumeFilterType::GAUSSIAN_E )
+  {
+    // Separable kernel normalized over the samples within three standard deviations, the
+    // passes are rounded to float
+    int r = static_cast< int >( std::ceil( 3.0 * parameter ) );
+    std::vector< double > kernel;
+    double sum = 0.0;
+    for ( int k = -r; k <= r; k++ )
+    {
+      kernel.push_back( std::exp( -( k * k ) / ( 2.0 * parameter * parameter ) ) );
+      sum += kernel.back();
+    }
+    for ( size_t k = 0; k < kernel.size(); k++ ) kernel[ k ] /= sum;
+
+    Volume current = source;
+    for ( int d = 0; d < 3; d++ )
+    {
+      Volume next = CreateVolume( size );
+      for ( index_type z = 0; z < size.z(); z++ )
+      {
+        for ( index_type y = 0; y < size.y(); y++ )
+        {
+          for ( index_type x = 0; x < size.x(); x++ )
+          {
+            double value = 0.0;
+            for ( int k = -r; k <= r; k++ )
+            {
+              value += kernel[ k + r ] * current.at( x + ( d == 0 ? k : 0 ), 
+                y + ( d == 1 ? k : 0 ), z + ( d == 2 ? k : 0 ) );
+            }
+            next( x, y, z ) = static_cast< float >( value );
+          }
+        }
+      }
+      current = next;
+    }
+
+    for ( size_t j = 0; j < result.data_.size(); j++ )
+    {
+      result.data_[ j ] = RoundValue( current.data_[ j ], data_type );
+    }
+    return result;
+  }
+
+  int r = static_cast< int >( parameter );
+  for ( index_type z = 0; z < size.z(); z++ )
+  {
+    for ( index_type y = 0; y < size.y(); y++ )
+    {
+      for ( index_type x = 0; x < size.x(); x++ )
+      {
+        double value = source.at( x, y, z );
+        switch ( filter )
+        {
+          case LargeVolumeFilterType::THRESHOLD_E:
+            result( x, y, z ) = ( value >= 0.0 && value <= parameter ) ? 1.0 : 0.0;
+            break;
+          case LargeVolumeFilterType::ARITHMETIC_E:
+            result( x, y, z ) = RoundValue( value * parameter - 3.0, data_type );
+            break;
+          default:
+          {
+            std::vector< double > window;
+            for ( int wz = -r; wz <= r; wz++ )
+            {
+              for ( int wy = -r; wy <= r; wy++ )
+              {
+                for ( int wx = -r; wx <= r; wx++ )
+                {
+                  window.push_back( source.at( x + wx, y + wy, z + wz ) );
+                }
+              }
+            }
+            std::nth_element( window.begin(), window.begin() + window.size() / 2, window.end() );
+            result( x, y, z ) = window[ window.size() / 2 ];
+            break;
+          }
+        }
+      }
+    }
+  }
+  return result;
+}
+
+// Average the samples of the previous level that are inside the volume
+Volume DownsampleVolume( const Volume& source, const IndexVector& size, const IndexVector& ratio,
+  DataType data_type )
+{
+  Volume result = CreateVolume( size );
+  for ( index_type z = 0; z < size.z(); z++ )
+  {
+    for ( index_type y = 0; y < size.y(); y++ )
+    {
+      for ( index_type x = 0; x < size.x(); x++ )
+      {
+        double sum = 0.0;
+        int count = 0;
+        for ( index_type dz = 0; dz < ratio.z(); dz++ )
+        {
+          if ( z * ratio.z() + dz >= source.size_.z() ) continue;
+          for ( index_type dy = 0; dy < ratio.y(); dy++ )
+          {
+            if ( y * ratio.y() + dy >= source.size_.y() ) continue;
+            for ( index_type dx = 0; dx < ratio.x(); dx++ )
+            {
+              if ( x * ratio.x() + dx >= source.size_.x() ) continue;
+              sum += source.at( x * ratio.x() + dx, y * ratio.y() + dy, z * ratio.z() + dz );
+              count++;
+            }
+          }
+        }
+        result( x, y, z ) = TruncateValue( sum / count, data_type );
+      }
+    }
+  }
+  return result;
+}
+
+IndexVector GetBrickOrigin( LargeVolumeSchemaHandle schema, const BrickInfo& bi )
+{
+  IndexVector layout = schema->get_level_layout( bi.level_ );
+  IndexVector effective_brick_size = schema->get_effective_brick_size();
+  index_type overlap = static_cast< index_type >( schema->get_overlap() );
+  index_type bx = bi.index_ % layout.x();
+  index_type by = ( bi.index_ / layout.x() ) % layout.y();
+  index_type bz = bi.index_ / ( layout.x() * layout.y() );
+  return IndexVector( bx * effective_brick_size.x() - overlap, 
+    by * effective_brick_size.y() - overlap, bz * effective_brick_size.z() - overlap );
+}
+
+// Cut a brick including its overlap out of a level, the overlap outside the volume is zero
+DataBlockHandle ExtractBrick( LargeVolumeSchemaHandle schema, const BrickInfo& bi, 
+  const Volume& level )
+{
+  IndexVector size = schema->get_brick_size( bi );
+  IndexVector origin = GetBrickOrigin( schema, bi );
+  DataBlockHandle brick = StdDataBlock::New( size.x(), size.y(), size.z(), 
+    schema->get_data_type() );
+  brick->clear();
+  for ( index_type z = 0; z < size.z(); z++ )
+  {
+    for ( index_type y = 0; y < size.y(); y++ )
+    {
+      for ( index_type x = 0; x < size.x(); x++ )
+      {
+        IndexVector p( origin.x() + x, origin.y() + y, origin.z() + z );
+        if ( p.x() < 0 || p.y() < 0 || p.z() < 0 || p.x() >= level.size_.x() || 
+          p.y() >= level.size_.y() || p.z() >= level.size_.z() ) continue;
+        brick->set_data_at( x, y, z, level.at( p.x(), p.y(), p.z() ) );
+      }
+    }
+  }
+  return brick;
+}
+
+// Check every brick of a level of a volume against the level filtered in memory
+::testing::AssertionResult LevelMatches( LargeVolumeSchemaHandle schema, size_t level, 
+  const Volume& expected, double tolerance )
+{
+  for ( size_t index = 0; index < schema->compute_level_num_bricks( level ); index++ )
+  {
+    BrickInfo bi( index, level );
+    DataBlockHandle brick;
+    std::string error;
+    if ( !schema->read_brick( brick, bi, error ) )
+    {
+      return ::testing::AssertionFailure() << "brick " << level << ":" << index << 
+        " could not be read: " << error;
+    }
+
+    DataBlockHandle expected_brick = ExtractBrick( schema, bi, expected );
+    for ( size_t j = 0; j < brick->get_size(); j++ )
+    {
+      if ( std::abs( brick->get_data_at( j ) - expected_brick->get_data_at( j ) ) > tolerance )
+      {
+        return ::testing::AssertionFailure() << "brick " << level << ":" << index << 
+          " differs at sample " << j << ": " << brick->get_data_at( j ) << " instead of " << 
+          expected_brick->get_data_at( j );
+      }
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+void RecordProgress( double progress, double* last_progress )
+{
+  *last_progress = progress;
+}
+
+} // end anonymous namespace
+
+class LargeVolumeFilterTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    this->dir_ = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path( "large-volume-filter-%%%%-%%%%" );
+    boost::filesystem::create_directories( this->dir_ );
+    this->source_volume_ = CreateSource();
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove_all( this->dir_ );
+  }
+
+  // Write the source volume the way the converter does: bricks are written uncompressed
+  // first and then reprocessed through a temporary file that replaces the brick
+  LargeVolumeSchemaHandle create_source( bool packed )
+  {
+    LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+    schema->set_dir( this->dir_ / "source" );
+    schema->set_parameters( VOLUME_SIZE, Vector( 1.0, 1.0, 1.0 ), Point( 0.0, 0.0, 0.0 ), 
+      BRICK_SIZE, OVERLAP, DataType::SHORT_E );
+    schema->compute_levels();
+    schema->set_codec( BrickCodecType::LZ4_E, BrickFilterType::DELTA_SHUFFLE_E );
+    schema->set_min_max( -20.0, 76.0 );
+    std::string error;
+    EXPECT_TRUE( schema->save( error ) ) << error;
+
+    // Only the full resolution level of the source is read by the filter, the coarser
+    // levels are built from the filtered data
+    Volume level = this->source_volume_;
+    for ( size_t j = 0; j < schema->get_num_levels(); j++ )
+    {
+      if ( j > 0 ) level = CreateVolume( schema->get_level_size( j ) );
+      for ( size_t index = 0; index < schema->compute_level_num_bricks( j ); index++ )
+      {
+        BrickInfo bi( index, j );
+        EXPECT_TRUE( schema->write_brick( ExtractBrick( schema, bi, level ), bi, error ) ) << 
+          error;
+      }
+    }
+
+    schema->set_compression( true );
+    for ( size_t j = 0; j < schema->get_num_levels(); j++ )
+    {
+      for ( size_t index = 0; index < schema->compute_level_num_bricks( j ); index++ )
+      {
+        EXPECT_TRUE( schema->reprocess_brick( BrickInfo( index, j ), error ) ) << error;
+        EXPECT_FALSE( boost::filesystem::exists( 
+          schema->get_brick_file_name( BrickInfo( index, j ) ).string() + ".tmp" ) );
+      }
+    }
+
+    if ( packed )
+    {
+      EXPECT_TRUE( schema->begin_packed_file( error ) ) << error;
+      for ( size_t j = 0; j < schema->get_num_levels(); j++ )
+      {
+        for ( size_t index = 0; index < schema->compute_level_num_bricks( j ); index++ )
+        {
+          BrickInfo bi( index, j );
+          DataBlockHandle brick;
+          EXPECT_TRUE( schema->read_brick( brick, bi, error ) &&
+            schema->write_packed_brick( brick, bi, error ) ) << error;
+        }
+      }
+      EXPECT_TRUE( schema->end_packed_file( error ) ) << error;
+    }
+    EXPECT_TRUE( schema->save( error ) ) << error;
+
+    LargeVolumeSchemaHandle loaded( new LargeVolumeSchema );
+    loaded->set_dir( this->dir_ / "source" );
+    EXPECT_TRUE( loaded->load( error ) ) << error;
+    return loaded;
+  }
+
+  // Check all levels of the filtered volume against the source filtered in memory
+  void check_filtered( const boost::filesystem::path& dir, LargeVolumeFilterType filter, 
+    double parameter, DataType data_type, double tolerance )
+  {
+    LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+    schema->set_dir( dir );
+    std::string error;
+    ASSERT_TRUE( schema->load( error ) ) << error;
+    ASSERT_EQ( data_type, schema->get_data_type() );
+    ASSERT_GT( schema->get_num_levels(), 2u );
+
+    Volume level = FilterVolume( this->source_volume_, filter, parameter, data_type );
+    EXPECT_NEAR( *std::min_element( level.data_.begin(), level.data_.end() ), 
+      schema->get_min(), tolerance );
+    EXPECT_NEAR( *std::max_element( level.data_.begin(), level.data_.end() ), 
+      schema->get_max(), tolerance );
+
+    for ( size_t j = 0; j < schema->get_num_levels(); j++ )
+    {
+      if ( j > 0 )
+      {
+        IndexVector ratio;
+        for ( size_t d = 0; d < 3; d++ )
+        {
+          ratio[ d ] = schema->get_level_downsample_ratio( j )[ d ] / 
+            schema->get_level_downsample_ratio( j - 1 )[ d ];
+        }
+        level = DownsampleVolume( level, schema->get_level_size( j ), ratio, data_type );
+      }
+      EXPECT_TRUE( LevelMatches( schema, j, level, tolerance ) ) << "level " << j;
+    }
+  }
+
+  boost::filesystem::path dir_;
+  Volume source_volume_;
+};
+
+TEST_F( LargeVolumeFilterTest, ThresholdMatchesInMemoryFilter )
+{
+  LargeVolumeFilter filter( this->create_source( false ) );
+  filter.set_output_dir( this->dir_ / "output" );
+  filter.set_threshold( 0.0, 40.0 );
+  double progress = 0.0;
+  filter.set_progress_function( boost::bind( &RecordProgress, _1, &progress ) );
+
+  std::string error;
+  ASSERT_TRUE( filter.run( error ) ) << error;
+  EXPECT_EQ( 1.0, progress );
+  this->check_filtered( this->dir_ / "output", LargeVolumeFilterType::THRESHOLD_E, 40.0,
+    DataType::UCHAR_E, 0.0 );
+}
+
+TEST_F( LargeVolumeFilterTest, ArithmeticMatchesInMemoryFilter )
+{
+  LargeVolumeFilter filter( this->create_source( false ) );
+  filter.set_output_dir( this->dir_ / "output" );
+  filter.set_arithmetic( 2.5, -3.0 );
+  filter.set_preserve_data_format( true );
+
+  std::string error;
+  ASSERT_TRUE( filter.run( error ) ) << error;
+  this->check_filtered( this->dir_ / "output", LargeVolumeFilterType::ARITHMETIC_E, 2.5,
+    DataType::SHORT_E, 0.0 );
+}
+
+TEST_F( LargeVolumeFilterTest, GaussianMatchesInMemoryFilter )
+{
+  LargeVolumeFilter filter( this->create_source( false ) );
+  filter.set_output_dir( this->dir_ / "output" );
+  filter.set_gaussian( 0.6 );
+  EXPECT_EQ( 2, filter.get_stencil_radius() );
+
+  std::string error;
+  ASSERT_TRUE( filter.run( error ) ) << error;
+  this->check_filtered( this->dir_ / "output", LargeVolumeFilterType::GAUSSIAN_E, 0.6,
+    DataType::FLOAT_E, 1e-3 );
+}
+
+TEST_F( LargeVolumeFilterTest, MedianOfPackedVolumeMatchesInMemoryFilter )
+{
+  LargeVolumeFilter filter( this->create_source( true ) );
+  filter.set_output_dir( this->dir_ / "output" );
+  filter.set_median( 1 );
+  filter.set_mem_limit( 64 * 1024 );
+
+  std::string error;
+  ASSERT_TRUE( filter.run( error ) ) << error;
+  EXPECT_TRUE( filter.get_schema()->is_packed() );
+  this->check_filtered( this->dir_ / "output", LargeVolumeFilterType::MEDIAN_E, 1.0,
+    DataType::SHORT_E, 0.0 );
+}
+
+TEST_F( LargeVolumeFilterTest, RejectsStencilBeyondOverlap )
+{
+  LargeVolumeSchemaHandle source = this->create_source( false );
+
+  LargeVolumeFilter filter( source );
+  filter.set_output_dir( this->dir_ / "output" );
+  filter.set_median( 3 );
+  std::string error;
+  EXPECT_FALSE( filter.run( error ) );
+  EXPECT_FALSE( error.empty() );
+
+  filter.set_median( 1 );
+  filter.set_output_dir( source->get_dir() );
+  EXPECT_FALSE( filter.run( error ) );
+  EXPECT_FALSE( error.empty() );
+}
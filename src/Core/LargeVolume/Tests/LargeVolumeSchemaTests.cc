@@ -0,0 +1,466 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <zlib.h>
+
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/LargeVolume/LargeVolumeSchema.h>
+
+using namespace Core;
+
+namespace
+{
+
+// Several bricks per level with remainder bricks at the edges, and several levels
+const IndexVector VOLUME_SIZE( 70, 45, 23 );
+const IndexVector BRICK_SIZE( 32, 32, 16 );
+const size_t OVERLAP = 2;
+
+// Content of a brick that differs between the bricks and compresses reasonably
+DataBlockHandle CreateBrick( LargeVolumeSchemaHandle schema, const BrickInfo& bi )
+{
+  IndexVector size = schema->get_brick_size( bi );
+  DataBlockHandle brick = StdDataBlock::New( size.x(), size.y(), size.z(), 
+    schema->get_data_type() );
+  for ( size_t j = 0; j < brick->get_size(); j++ )
+  {
+    brick->set_data_at( j, static_cast< double >( 
+      ( j % size.x() ) + 3 * bi.index_ + 11 * bi.level_ + ( j * 7919 ) % 3 ) );
+  }
+  return brick;
+}
+
+std::vector< BrickInfo > GetAllBricks( LargeVolumeSchemaHandle schema )
+{
+  std::vector< BrickInfo > bricks;
+  for ( size_t level = 0; level < schema->get_num_levels(); level++ )
+  {
+    for ( size_t index = 0; index < schema->compute_level_num_bricks( level ); index++ )
+    {
+      bricks.push_back( BrickInfo( index, level ) );
+    }
+  }
+  return bricks;
+}
+
+::testing::AssertionResult HasBrickContent( LargeVolumeSchemaHandle schema, 
+  const BrickInfo& bi )
+{
+  DataBlockHandle brick;
+  std::string error;
+  if ( !schema->read_brick( brick, bi, error ) )
+  {
+    return ::testing::AssertionFailure() << "brick " << bi.level_ << ":" << bi.index_ <<
+      " could not be read: " << error;
+  }
+
+  DataBlockHandle expected = CreateBrick( schema, bi );
+  if ( brick->get_byte_size() != expected->get_byte_size() ||
+    std::memcmp( brick->get_data(), expected->get_data(), expected->get_byte_size() ) != 0 )
+  {
+    return ::testing::AssertionFailure() << "brick " << bi.level_ << ":" << bi.index_ <<
+      " differs";
+  }
+  return ::testing::AssertionSuccess();
+}
+
+// Write every brick of a subset of the bricks to the pack file
+void WritePackedBricks( LargeVolumeSchemaHandle schema, size_t start, size_t step, 
+  bool* success )
+{
+  std::vector< BrickInfo > bricks = GetAllBricks( schema );
+  for ( size_t j = start; j < bricks.size(); j += step )
+  {
+    std::string error;
+    if ( !schema->write_packed_brick( CreateBrick( schema, bricks[ j ] ), bricks[ j ], error ) )
+    {
+      *success = false;
+    }
+  }
+}
+
+// Count the bricks of a subset of the bricks that do not read back correctly
+void CountBadBricks( LargeVolumeSchemaHandle schema, size_t start, size_t step, 
+  int* failures )
+{
+  std::vector< BrickInfo > bricks = GetAllBricks( schema );
+  for ( size_t j = start; j < bricks.size(); j += step )
+  {
+    if ( !HasBrickContent( schema, bricks[ j ] ) ) ( *failures )++;
+  }
+}
+
+// Overwrite a little endian 64 bit number in a file
+void PatchNumber( const boost::filesystem::path& file, size_t offset, boost::uint64_t value )
+{
+  std::fstream stream( file.string().c_str(), 
+    std::ios_base::in | std::ios_base::out | std::ios_base::binary );
+  stream.seekp( static_cast< std::streamoff >( offset ), std::ios_base::beg );
+  for ( size_t j = 0; j < 8; j++ )
+  {
+    stream.put( static_cast< char >( ( value >> ( 8 * j ) ) & 0xff ) );
+  }
+}
+
+} // end anonymous namespace
+
+class LargeVolumeSchemaTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    this->dir_ = boost::filesystem::temp_directory_path() / 
+      boost::filesystem::unique_path( "large-volume-schema-%%%%-%%%%" );
+    boost::filesystem::create_directories( this->dir_ );
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove_all( this->dir_ );
+  }
+
+  LargeVolumeSchemaHandle create_schema( DataType data_type )
+  {
+    LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+    schema->set_dir( this->dir_ );
+    schema->set_parameters( VOLUME_SIZE, Vector( 1.0, 1.0, 2.0 ), Point( 0.0, 0.0, 0.0 ), 
+      BRICK_SIZE, OVERLAP, data_type );
+    schema->compute_levels();
+    return schema;
+  }
+
+  LargeVolumeSchemaHandle load_schema( std::string& error )
+  {
+    LargeVolumeSchemaHandle schema( new LargeVolumeSchema );
+    schema->set_dir( this->dir_ );
+    if ( !schema->load( error ) ) schema.reset();
+    return schema;
+  }
+
+  // Write every brick to its own file
+  void write_bricks( LargeVolumeSchemaHandle schema )
+  {
+    std::vector< BrickInfo > bricks = GetAllBricks( schema );
+    for ( size_t j = 0; j < bricks.size(); j++ )
+    {
+      std::string error;
+      ASSERT_TRUE( schema->write_brick( CreateBrick( schema, bricks[ j ] ), bricks[ j ], 
+        error ) ) << error;
+    }
+  }
+
+  // Write all bricks into the pack file using several threads
+  void write_pack( LargeVolumeSchemaHandle schema )
+  {
+    std::string error;
+    ASSERT_TRUE( schema->begin_packed_file( error ) ) << error;
+
+    const size_t num_threads = 4;
+    bool success[ num_threads ];
+    boost::thread_group threads;
+    for ( size_t j = 0; j < num_threads; j++ )
+    {
+      success[ j ] = true;
+      threads.create_thread( boost::bind( &WritePackedBricks, schema, j, num_threads, 
+        &success[ j ] ) );
+    }
+    threads.join_all();
+    for ( size_t j = 0; j < num_threads; j++ )
+    {
+      ASSERT_TRUE( success[ j ] );
+    }
+
+    ASSERT_TRUE( schema->end_packed_file( error ) ) << error;
+    ASSERT_TRUE( schema->save( error ) ) << error;
+  }
+
+  // Write a packed volume and return the number of bricks in it
+  size_t create_packed_volume()
+  {
+    LargeVolumeSchemaHandle schema = this->create_schema( DataType::SHORT_E );
+    schema->set_compression( true );
+    schema->set_codec( BrickCodecType::LZ4_E, BrickFilterType::SHUFFLE_E );
+    this->write_pack( schema );
+    return GetAllBricks( schema ).size();
+  }
+
+  boost::filesystem::path pack_file() const
+  {
+    return this->dir_ / "bricks.pack";
+  }
+
+  boost::filesystem::path dir_;
+};
+
+TEST_F( LargeVolumeSchemaTest, RoundTripsCodecsAndFilters )
+{
+  const BrickCodecType codecs[] = 
+    { BrickCodecType::NONE_E, BrickCodecType::ZLIB_E, BrickCodecType::LZ4_E };
+  const BrickFilterType filters[] = { BrickFilterType::NONE_E, BrickFilterType::SHUFFLE_E, 
+    BrickFilterType::DELTA_SHUFFLE_E };
+  const DataType data_types[] = { DataType::UCHAR_E, DataType::SHORT_E, DataType::FLOAT_E };
+
+  for ( size_t c = 0; c < 3; c++ )
+  {
+    for ( size_t f = 0; f < 3; f++ )
+    {
+      for ( size_t t = 0; t < 3; t++ )
+      {
+        SCOPED_TRACE( ExportToString( codecs[ c ] ) + " " + ExportToString( filters[ f ] ) + 
+          " " + ExportToString( data_types[ t ] ) );
+
+        LargeVolumeSchemaHandle schema = this->create_schema( data_types[ t ] );
+        schema->set_compression( codecs[ c ] != BrickCodecType::NONE_E );
+        schema->set_codec( codecs[ c ], filters[ f ] );
+        this->write_bricks( schema );
+        std::string error;
+        ASSERT_TRUE( schema->save( error ) ) << error;
+
+        LargeVolumeSchemaHandle loaded = this->load_schema( error );
+        ASSERT_TRUE( loaded ) << error;
+        EXPECT_EQ( codecs[ c ], loaded->get_codec() );
+        EXPECT_EQ( filters[ f ], loaded->get_filter() );
+        EXPECT_FALSE( loaded->is_packed() );
+        ASSERT_GT( loaded->get_num_levels(), 1u );
+
+        std::vector< BrickInfo > bricks = GetAllBricks( loaded );
+        for ( size_t j = 0; j < bricks.size(); j++ )
+        {
+          EXPECT_TRUE( HasBrickContent( loaded, bricks[ j ] ) );
+        }
+      }
+    }
+  }
+}
+
+TEST_F( LargeVolumeSchemaTest, LoadsVolumeWithoutCodecFields )
+{
+  // Write a volume the way it was written before codecs and pack files existed: zlib
+  // compressed brick files and a volume file without codec, filter and layout fields
+  LargeVolumeSchemaHandle schema = this->create_schema( DataType::USHORT_E );
+  std::vector< BrickInfo > bricks = GetAllBricks( schema );
+  for ( size_t j = 0; j < bricks.size(); j++ )
+  {
+    DataBlockHandle brick = CreateBrick( schema, bricks[ j ] );
+    uLongf compressed_size = compressBound( static_cast< uLong >( brick->get_byte_size() ) );
+    std::vector< Bytef > buffer( compressed_size );
+    ASSERT_EQ( Z_OK, compress2( &buffer[ 0 ], &compressed_size, 
+      reinterpret_cast< const Bytef* >( brick->get_data() ), brick->get_byte_size(), 
+      Z_DEFAULT_COMPRESSION ) );
+
+    std::ofstream output( schema->get_brick_file_name( bricks[ j ] ).string().c_str(), 
+      std::ios_base::binary );
+    output.write( reinterpret_cast< const char* >( &buffer[ 0 ] ), compressed_size );
+  }
+
+  {
+    std::ofstream text_file( ( this->dir_ / "volume.txt" ).string().c_str() );
+    text_file << "size: " << ExportToString( VOLUME_SIZE ) << std::endl;
+    text_file << "origin: " << ExportToString( Point( 0.0, 0.0, 0.0 ) ) << std::endl;
+    text_file << "spacing: " << ExportToString( Vector( 1.0, 1.0, 2.0 ) ) << std::endl;
+    text_file << "overlap: " << OVERLAP << std::endl;
+    text_file << "bricksize: " << ExportToString( BRICK_SIZE ) << std::endl;
+    text_file << "datatype: " << ExportToString( schema->get_data_type() ) << std::endl;
+    text_file << "endian: " << ( DataBlock::IsLittleEndian() ? "little" : "big" ) << std::endl;
+    text_file << "min: 0" << std::endl;
+    text_file << "max: 255" << std::endl;
+    for ( size_t j = 0; j < schema->get_num_levels(); j++ )
+    {
+      text_file << "level" << j << ": " << 
+        ExportToString( schema->get_level_downsample_ratio( j ) ) << std::endl;
+    }
+  }
+
+  std::string error;
+  LargeVolumeSchemaHandle loaded = this->load_schema( error );
+  ASSERT_TRUE( loaded ) << error;
+  EXPECT_EQ( BrickCodecType::ZLIB_E, loaded->get_codec() );
+  EXPECT_EQ( BrickFilterType::NONE_E, loaded->get_filter() );
+  EXPECT_FALSE( loaded->is_packed() );
+  ASSERT_EQ( schema->get_num_levels(), loaded->get_num_levels() );
+  for ( size_t j = 0; j < bricks.size(); j++ )
+  {
+    EXPECT_TRUE( HasBrickContent( loaded, bricks[ j ] ) );
+  }
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsUnknownCodec )
+{
+  LargeVolumeSchemaHandle schema = this->create_schema( DataType::UCHAR_E );
+  std::string error;
+  ASSERT_TRUE( schema->save( error ) ) << error;
+
+  {
+    std::ofstream text_file( ( this->dir_ / "volume.txt" ).string().c_str(), 
+      std::ios_base::app );
+    text_file << "codec: zstd" << std::endl;
+  }
+
+  EXPECT_FALSE( this->load_schema( error ) );
+  EXPECT_NE( std::string::npos, error.find( "zstd" ) );
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsCorruptBricks )
+{
+  LargeVolumeSchemaHandle schema = this->create_schema( DataType::SHORT_E );
+  schema->set_compression( true );
+  schema->set_codec( BrickCodecType::LZ4_E, BrickFilterType::DELTA_SHUFFLE_E );
+  this->write_bricks( schema );
+
+  // Cut a compressed brick short
+  BrickInfo bi( 0, 0 );
+  boost::filesystem::path brick_file = schema->get_brick_file_name( bi );
+  boost::filesystem::resize_file( brick_file, boost::filesystem::file_size( brick_file ) / 2 );
+
+  DataBlockHandle brick;
+  std::string error;
+  EXPECT_FALSE( schema->read_brick( brick, bi, error ) );
+  EXPECT_FALSE( error.empty() );
+  EXPECT_TRUE( HasBrickContent( schema, BrickInfo( 1, 0 ) ) );
+}
+
+TEST_F( LargeVolumeSchemaTest, ReadsPackedBricks )
+{
+  const bool memory_mappings[] = { true, false };
+  for ( size_t m = 0; m < 2; m++ )
+  {
+    SCOPED_TRACE( memory_mappings[ m ] ? "memory mapped" : "stream" );
+    this->create_packed_volume();
+    
+    // Bricks written to the pack file do not need their own files
+    EXPECT_FALSE( boost::filesystem::exists( this->dir_ / "A0.raw" ) );
+
+    LargeVolumeSchemaHandle loaded( new LargeVolumeSchema );
+    loaded->set_dir( this->dir_ );
+    loaded->set_memory_mapping( memory_mappings[ m ] );
+    std::string error;
+    ASSERT_TRUE( loaded->load( error ) ) << error;
+    EXPECT_TRUE( loaded->is_packed() );
+    EXPECT_EQ( BrickCodecType::LZ4_E, loaded->get_codec() );
+    EXPECT_EQ( BrickFilterType::SHUFFLE_E, loaded->get_filter() );
+
+    std::vector< BrickInfo > bricks = GetAllBricks( loaded );
+    for ( size_t j = 0; j < bricks.size(); j++ )
+    {
+      EXPECT_TRUE( HasBrickContent( loaded, bricks[ j ] ) );
+    }
+  }
+}
+
+TEST_F( LargeVolumeSchemaTest, ReadsPackedBricksFromThreads )
+{
+  this->create_packed_volume();
+
+  std::string error;
+  LargeVolumeSchemaHandle loaded = this->load_schema( error );
+  ASSERT_TRUE( loaded ) << error;
+
+  const size_t num_threads = 4;
+  std::vector< int > failures( num_threads, 0 );
+  boost::thread_group threads;
+  for ( size_t t = 0; t < num_threads; t++ )
+  {
+    threads.create_thread( boost::bind( &CountBadBricks, loaded, t, num_threads, 
+      &failures[ t ] ) );
+  }
+  threads.join_all();
+
+  for ( size_t t = 0; t < num_threads; t++ )
+  {
+    EXPECT_EQ( 0, failures[ t ] );
+  }
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsIncompletePack )
+{
+  LargeVolumeSchemaHandle schema = this->create_schema( DataType::UCHAR_E );
+  std::string error;
+  ASSERT_TRUE( schema->begin_packed_file( error ) ) << error;
+  ASSERT_TRUE( schema->write_packed_brick( CreateBrick( schema, BrickInfo( 0, 0 ) ), 
+    BrickInfo( 0, 0 ), error ) ) << error;
+  EXPECT_FALSE( schema->end_packed_file( error ) );
+  EXPECT_FALSE( schema->is_packed() );
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsCorruptPackMagic )
+{
+  this->create_packed_volume();
+  {
+    std::fstream stream( this->pack_file().string().c_str(), 
+      std::ios_base::in | std::ios_base::out | std::ios_base::binary );
+    stream.write( "S3DPACK0", 8 );
+  }
+
+  std::string error;
+  EXPECT_FALSE( this->load_schema( error ) );
+  EXPECT_FALSE( error.empty() );
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsPackWithWrongBrickCount )
+{
+  size_t num_bricks = this->create_packed_volume();
+  PatchNumber( this->pack_file(), 8, num_bricks + 1 );
+
+  std::string error;
+  EXPECT_FALSE( this->load_schema( error ) );
+  EXPECT_FALSE( error.empty() );
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsShortPackIndex )
+{
+  size_t num_bricks = this->create_packed_volume();
+
+  // Cut the file in the middle of the index
+  boost::filesystem::resize_file( this->pack_file(), 16 + 16 * num_bricks - 8 );
+
+  std::string error;
+  EXPECT_FALSE( this->load_schema( error ) );
+  EXPECT_FALSE( error.empty() );
+}
+
+TEST_F( LargeVolumeSchemaTest, RejectsPackEntryBeyondEnd )
+{
+  this->create_packed_volume();
+  boost::uint64_t file_size = boost::filesystem::file_size( this->pack_file() );
+
+  // Let the first brick of the index extend beyond the end of the file
+  PatchNumber( this->pack_file(), 16 + 8, file_size );
+
+  std::string error;
+  EXPECT_FALSE( this->load_schema( error ) );
+  EXPECT_NE( std::string::npos, error.find( "truncated" ) );
+}
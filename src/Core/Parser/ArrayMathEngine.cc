@@ -80,11 +80,15 @@ public:
   // away, but the type is only know when the parser has validated and optimized
   // the expression tree
   std::vector< OutputDataBlock > data_block_data_;
+
+  // Whether the sequential part of the program is fused into one loop
+  bool fused_;
 };
 
 ArrayMathEngine::ArrayMathEngine() :
   private_( new ArrayMathEnginePrivate )
 {
+  this->private_->fused_ = true;
   this->clear();
 }
 
@@ -328,6 +332,12 @@ bool ArrayMathEngine::run( std::string& error )
   {
     return false;
   }
+  // Fuse the sequential part of the code
+  if ( this->private_->fused_ && 
+    !( this->fuse( this->private_->pprogram_, this->private_->mprogram_, error ) ) )
+  {
+    return false;
+  }
   // Set the final array size
   if ( !( this->set_array_size( this->private_->mprogram_, this->private_->array_size_ ) ) )
   {
@@ -346,6 +356,16 @@ bool ArrayMathEngine::run( std::string& error )
   return true;
 }
 
+void ArrayMathEngine::set_fused_execution( bool fused )
+{
+  this->private_->fused_ = fused;
+}
+
+bool ArrayMathEngine::get_fused_execution() const
+{
+  return this->private_->fused_;
+}
+
 bool ArrayMathEngine::get_data_block( std::string name, DataBlockHandle& data_block )
 {
   for ( size_t j = 0; j < this->private_->data_block_data_.size(); j++ )
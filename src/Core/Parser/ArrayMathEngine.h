@@ -70,6 +70,11 @@ public:
   /// Run the expressions in parallel
   bool run( std::string& error );
 
+  /// Whether expressions are run as one fused loop when possible, which is the default.
+  /// Switching it off runs every function separately in single precision.
+  void set_fused_execution( bool fused );
+  bool get_fused_execution() const;
+
   /// Extract handles to the results
   bool get_data_block( std::string name, DataBlockHandle& data_block );
 
@@ -28,6 +28,7 @@
 
 // Core includes
 #include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/DataBlockKernels.h>
 #include <Core/DataBlock/MaskDataBlock.h>
 #include <Core/Parser/ArrayMathFunctionCatalog.h>
 
@@ -44,22 +45,13 @@ bool get_scalar_data( Core::ArrayMathProgramCode& pc )
 
   // Source
   Core::DataBlock& data1( *( pc.get_data_block( 1 ) ) );
-  // One virtual call to get the data
 
-  float* data0_end = data0 + pc.get_size();
+  // Convert the whole range in one pass instead of reading one value at a time
   Core::index_type idx = pc.get_index();
-
-  float val;
-  while( data0 != data0_end ) 
-  {
-    val = static_cast< float >( data1.get_data_at( idx ) );
-    idx++;
-
-    *data0 = val; 
-    data0++;
-  }
-
-  return true;
+  const char* src = static_cast< const char* >( data1.get_data() ) + 
+    idx * data1.get_elem_size();
+  return Core::DataBlockKernels::Convert( src, data1.get_data_type(), data0, 
+    Core::DataType::FLOAT_E, pc.get_size() );
 }
 
 bool get_scalar_mask( Core::ArrayMathProgramCode& pc )
@@ -69,19 +61,16 @@ bool get_scalar_mask( Core::ArrayMathProgramCode& pc )
 
   // Source
   Core::MaskDataBlock& data1( *( pc.get_mask_data_block( 1 ) ) );
-  // One virtual call to get the data
 
+  // Test the bit directly instead of going through get_mask_at for every value
   float* data0_end = data0 + pc.get_size();
-  Core::index_type idx = pc.get_index();
+  const unsigned char* src = data1.get_mask_data() + pc.get_index();
+  unsigned char mask_value = data1.get_mask_value();
 
-  // Get value (on/off) from mask
-  float val;
   while( data0 != data0_end ) 
   {
-    val = data1.get_mask_at( idx ) ? 1.0f : 0.0f;
-    idx++;
-
-    *data0 = val; 
+    *data0 = ( *src & mask_value ) ? 1.0f : 0.0f;
+    src++;
     data0++;
   }
 
@@ -97,32 +86,27 @@ bool to_data_block_s( Core::ArrayMathProgramCode& pc )
   Core::DataBlock& data0( *( pc.get_data_block( 0 ) ) );
   float* data1 = pc.get_variable( 1 );
 
-  float* data1_end = data1 + ( pc.get_size() );
   Core::index_type idx = pc.get_index();
 
   if ( data0.get_data_type() == Core::DataType::CHAR_E )
   {
+    float* data1_end = data1 + ( pc.get_size() );
+    signed char* dst = static_cast< signed char* >( data0.get_data() ) + idx;
     while ( data1 != data1_end ) 
     {
       float fdata = *data1;
       if ( fdata > 127.0f ) fdata = 127.0f;
       if ( fdata < -128.0f ) fdata = -128.0f;
-      data0.set_data_at( idx, *data1 ); 
-      idx++; 
+      *dst = static_cast< signed char >( fdata );
+      dst++; 
       data1++;
     } 
+    return true;
   }
-  else
-  {
-    while ( data1 != data1_end ) 
-    {
-      data0.set_data_at( idx, *data1 ); 
-      idx++; 
-      data1++;
-    }
-  }
-  
-  return true;
+
+  char* dst = static_cast< char* >( data0.get_data() ) + idx * data0.get_elem_size();
+  return Core::DataBlockKernels::Convert( data1, Core::DataType::FLOAT_E, dst, 
+    data0.get_data_type(), pc.get_size() );
 }
 
 } //end namespace
@@ -0,0 +1,675 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <cmath>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Core includes
+#include <Core/DataBlock/DataBlock.h>
+#include <Core/DataBlock/MaskDataBlock.h>
+#include <Core/Parser/ArrayMathFusedProgram.h>
+#include <Core/Parser/ArrayMathProgram.h>
+#include <Core/Parser/ArrayMathProgramVariable.h>
+#include <Core/Parser/ParserEnums.h>
+#include <Core/Parser/ParserFunction.h>
+#include <Core/Parser/ParserProgram.h>
+#include <Core/Parser/ParserScriptFunction.h>
+#include <Core/Parser/ParserScriptVariable.h>
+
+namespace Core
+{
+
+namespace
+{
+
+// The operations a fused program is made of
+enum FusedOperation
+{
+  LOAD_DATA_E = 0,
+  LOAD_MASK_E,
+  STORE_DATA_E,
+  CONSTANT_E,
+  SEQ_E,
+  ADD_E,
+  SUB_E,
+  NEG_E,
+  MULT_E,
+  DIV_E,
+  ABS_E,
+  SIGN_E,
+  NOT_E,
+  BOOLEAN_E,
+  AND_E,
+  OR_E,
+  EQ_E,
+  NEQ_E,
+  LE_E,
+  GE_E,
+  LS_E,
+  GT_E,
+  MIN_E,
+  MAX_E,
+  SELECT_E,
+  SQRT_E,
+  EXP_E,
+  LOG_E,
+  POW_E,
+  FLOOR_E,
+  CEIL_E,
+  ROUND_E
+};
+
+typedef std::map< std::string, FusedOperation > FusedOperationMap;
+
+// The ArrayMath functions that can be fused
+const FusedOperationMap& GetFusedOperations()
+{
+  static FusedOperationMap operations;
+  if ( operations.empty() )
+  {
+    operations[ "get_scalar$DATA" ] = LOAD_DATA_E;
+    operations[ "get_scalar$MASK" ] = LOAD_MASK_E;
+    operations[ "to_data_block$S" ] = STORE_DATA_E;
+    operations[ "seq$S" ] = SEQ_E;
+    operations[ "add$S:S" ] = ADD_E;
+    operations[ "sub$S:S" ] = SUB_E;
+    operations[ "neg$S" ] = NEG_E;
+    operations[ "mult$S:S" ] = MULT_E;
+    operations[ "div$S:S" ] = DIV_E;
+    operations[ "abs$S" ] = ABS_E;
+    operations[ "sign$S" ] = SIGN_E;
+    operations[ "not$S" ] = NOT_E;
+    operations[ "boolean$S" ] = BOOLEAN_E;
+    operations[ "and$S:S" ] = AND_E;
+    operations[ "or$S:S" ] = OR_E;
+    operations[ "eq$S:S" ] = EQ_E;
+    operations[ "neq$S:S" ] = NEQ_E;
+    operations[ "le$S:S" ] = LE_E;
+    operations[ "ge$S:S" ] = GE_E;
+    operations[ "ls$S:S" ] = LS_E;
+    operations[ "gt$S:S" ] = GT_E;
+    operations[ "min$S:S" ] = MIN_E;
+    operations[ "max$S:S" ] = MAX_E;
+    operations[ "select$S:S:S" ] = SELECT_E;
+    operations[ "sqrt$S" ] = SQRT_E;
+    operations[ "exp$S" ] = EXP_E;
+    operations[ "log$S" ] = LOG_E;
+    operations[ "ln$S" ] = LOG_E;
+    operations[ "pow$S:S" ] = POW_E;
+    operations[ "floor$S" ] = FLOOR_E;
+    operations[ "ceil$S" ] = CEIL_E;
+    operations[ "round$S" ] = ROUND_E;
+  }
+  return operations;
+}
+
+// Whether data of a type needs to be computed in double precision, all values of the other
+// types can be represented exactly as a float
+bool NeedsDoublePrecision( DataType data_type )
+{
+  return data_type == DataType::INT_E || data_type == DataType::UINT_E || 
+    data_type == DataType::LONGLONG_E || data_type == DataType::ULONGLONG_E || 
+    data_type == DataType::DOUBLE_E;
+}
+
+template< class T, class VALUE >
+void LoadBuffer( const T* src, VALUE* dst, size_type size )
+{
+  for ( size_type j = 0; j < size; j++ ) dst[ j ] = static_cast< VALUE >( src[ j ] );
+}
+
+// Integer types are clamped to their range instead of wrapping around
+template< class T, class VALUE >
+void StoreBuffer( const VALUE* src, T* dst, size_type size )
+{
+  if ( !std::numeric_limits< T >::is_integer )
+  {
+    for ( size_type j = 0; j < size; j++ ) dst[ j ] = static_cast< T >( src[ j ] );
+    return;
+  }
+
+  const VALUE min = static_cast< VALUE >( std::numeric_limits< T >::min() );
+  const VALUE max = static_cast< VALUE >( std::numeric_limits< T >::max() );
+  for ( size_type j = 0; j < size; j++ )
+  {
+    VALUE value = src[ j ];
+    if ( value <= min ) dst[ j ] = std::numeric_limits< T >::min();
+    else if ( value >= max ) dst[ j ] = std::numeric_limits< T >::max();
+    else if ( value == value ) dst[ j ] = static_cast< T >( value );
+    else dst[ j ] = 0;
+  }
+}
+
+template< class VALUE >
+bool LoadDataBlock( DataBlock* data_block, index_type index, size_type size, VALUE* dst )
+{
+  void* data = data_block->get_data();
+  switch ( data_block->get_data_type() )
+  {
+  case DataType::CHAR_E:
+    LoadBuffer( static_cast< signed char* >( data ) + index, dst, size ); return true;
+  case DataType::UCHAR_E:
+    LoadBuffer( static_cast< unsigned char* >( data ) + index, dst, size ); return true;
+  case DataType::SHORT_E:
+    LoadBuffer( static_cast< short* >( data ) + index, dst, size ); return true;
+  case DataType::USHORT_E:
+    LoadBuffer( static_cast< unsigned short* >( data ) + index, dst, size ); return true;
+  case DataType::INT_E:
+    LoadBuffer( static_cast< int* >( data ) + index, dst, size ); return true;
+  case DataType::UINT_E:
+    LoadBuffer( static_cast< unsigned int* >( data ) + index, dst, size ); return true;
+  case DataType::LONGLONG_E:
+    LoadBuffer( static_cast< long long* >( data ) + index, dst, size ); return true;
+  case DataType::ULONGLONG_E:
+    LoadBuffer( static_cast< unsigned long long* >( data ) + index, dst, size ); return true;
+  case DataType::FLOAT_E:
+    LoadBuffer( static_cast< float* >( data ) + index, dst, size ); return true;
+  case DataType::DOUBLE_E:
+    LoadBuffer( static_cast< double* >( data ) + index, dst, size ); return true;
+  default:
+    return false;
+  }
+}
+
+template< class VALUE >
+bool StoreDataBlock( const VALUE* src, DataBlock* data_block, index_type index, size_type size )
+{
+  void* data = data_block->get_data();
+  switch ( data_block->get_data_type() )
+  {
+  case DataType::CHAR_E:
+    StoreBuffer( src, static_cast< signed char* >( data ) + index, size ); return true;
+  case DataType::UCHAR_E:
+    StoreBuffer( src, static_cast< unsigned char* >( data ) + index, size ); return true;
+  case DataType::SHORT_E:
+    StoreBuffer( src, static_cast< short* >( data ) + index, size ); return true;
+  case DataType::USHORT_E:
+    StoreBuffer( src, static_cast< unsigned short* >( data ) + index, size ); return true;
+  case DataType::INT_E:
+    StoreBuffer( src, static_cast< int* >( data ) + index, size ); return true;
+  case DataType::UINT_E:
+    StoreBuffer( src, static_cast< unsigned int* >( data ) + index, size ); return true;
+  case DataType::LONGLONG_E:
+    StoreBuffer( src, static_cast< long long* >( data ) + index, size ); return true;
+  case DataType::ULONGLONG_E:
+    StoreBuffer( src, static_cast< unsigned long long* >( data ) + index, size ); return true;
+  case DataType::FLOAT_E:
+    StoreBuffer( src, static_cast< float* >( data ) + index, size ); return true;
+  case DataType::DOUBLE_E:
+    StoreBuffer( src, static_cast< double* >( data ) + index, size ); return true;
+  default:
+    return false;
+  }
+}
+
+} // end anonymous namespace
+
+class ArrayMathFusedInstruction
+{
+public:
+  ArrayMathFusedInstruction() :
+    operation_( CONSTANT_E ),
+    function_( 0 ),
+    dst_( 0 ),
+    data_block_( 0 ),
+    mask_data_block_( 0 ),
+    constant_( 0 ),
+    constant_size_( 0 )
+  {
+    this->src_[ 0 ] = this->src_[ 1 ] = this->src_[ 2 ] = 0;
+  }
+
+  FusedOperation operation_;
+  // The sequential function this instruction was compiled from
+  size_t function_;
+
+  // Registers for the result and the arguments
+  size_t dst_;
+  size_t src_[ 3 ];
+
+  // Source of LOAD_DATA_E and sink of STORE_DATA_E
+  DataBlock* data_block_;
+  // Source of LOAD_MASK_E
+  MaskDataBlock* mask_data_block_;
+
+  // Values that CONSTANT_E copies into a register, a single value fills the whole register
+  const float* constant_;
+  size_t constant_size_;
+};
+
+class ArrayMathFusedProgramPrivate
+{
+public:
+  // NEW_REGISTER:
+  // Get a register for the result of an instruction. Every result gets its own register, so
+  // the result of an instruction never overwrites its arguments.
+  size_t new_register( int var_number );
+
+  // GET_REGISTER:
+  // Get the register that holds the current value of a sequential variable
+  bool get_register( int var_number, size_t& reg );
+
+  // GET_CONSTANT_REGISTER:
+  // Get the register that holds a constant that was computed before the sequential part
+  size_t get_constant_register( const float* constant, size_t constant_size );
+
+  // BEGIN_INSTRUCTIONS:
+  // Allocate the registers of a thread and fill out the constants
+  template< class VALUE >
+  void begin_instructions( std::vector< VALUE >& registers );
+
+  // RUN_INSTRUCTIONS:
+  // Run the instructions for one buffer
+  template< class VALUE >
+  bool run_instructions( std::vector< VALUE >& registers, index_type index, size_type size, 
+    size_t& error_line );
+
+  // Number of elements in each register
+  size_type buffer_size_;
+  size_t num_registers_;
+
+  // Instructions that run when a thread starts and instructions that run for each buffer
+  std::vector< ArrayMathFusedInstruction > begin_instructions_;
+  std::vector< ArrayMathFusedInstruction > instructions_;
+
+  std::map< int, size_t > variable_registers_;
+  std::map< const float*, size_t > constant_registers_;
+
+  // Whether the registers are doubles instead of floats, which is needed when a source or the
+  // sink has values that a float cannot represent
+  bool double_precision_;
+
+  // The registers of each thread
+  std::vector< std::vector< float > > float_registers_;
+  std::vector< std::vector< double > > double_registers_;
+};
+
+size_t ArrayMathFusedProgramPrivate::new_register( int var_number )
+{
+  size_t reg = this->num_registers_++;
+  this->variable_registers_[ var_number ] = reg;
+  return reg;
+}
+
+bool ArrayMathFusedProgramPrivate::get_register( int var_number, size_t& reg )
+{
+  std::map< int, size_t >::iterator it = this->variable_registers_.find( var_number );
+  if ( it == this->variable_registers_.end() ) return false;
+
+  reg = it->second;
+  return true;
+}
+
+size_t ArrayMathFusedProgramPrivate::get_constant_register( const float* constant, 
+  size_t constant_size )
+{
+  std::map< const float*, size_t >::iterator it = this->constant_registers_.find( constant );
+  if ( it != this->constant_registers_.end() ) return it->second;
+
+  ArrayMathFusedInstruction instruction;
+  instruction.operation_ = CONSTANT_E;
+  instruction.dst_ = this->num_registers_++;
+  instruction.constant_ = constant;
+  instruction.constant_size_ = constant_size;
+  this->begin_instructions_.push_back( instruction );
+
+  this->constant_registers_[ constant ] = instruction.dst_;
+  return instruction.dst_;
+}
+
+template< class VALUE >
+void ArrayMathFusedProgramPrivate::begin_instructions( std::vector< VALUE >& registers )
+{
+  size_type buffer_size = this->buffer_size_;
+  registers.resize( this->num_registers_ * buffer_size );
+
+  for ( size_t j = 0; j < this->begin_instructions_.size(); j++ )
+  {
+    const ArrayMathFusedInstruction& instruction = this->begin_instructions_[ j ];
+    VALUE* dst = &registers[ instruction.dst_ * buffer_size ];
+    for ( size_type k = 0; k < buffer_size; k++ )
+    {
+      dst[ k ] = instruction.constant_size_ == 1 ? instruction.constant_[ 0 ] : 
+        instruction.constant_[ k ];
+    }
+  }
+}
+
+template< class VALUE >
+bool ArrayMathFusedProgramPrivate::run_instructions( std::vector< VALUE >& registers, 
+  index_type index, size_type size, size_t& error_line )
+{
+  const VALUE zero = 0;
+  const VALUE one = 1;
+  const VALUE half = static_cast< VALUE >( 0.5 );
+
+  size_type buffer_size = this->buffer_size_;
+  VALUE* base = &registers[ 0 ];
+
+  size_t num_instructions = this->instructions_.size();
+  for ( size_t j = 0; j < num_instructions; j++ )
+  {
+    const ArrayMathFusedInstruction& instruction = this->instructions_[ j ];
+    VALUE* dst = base + instruction.dst_ * buffer_size;
+    const VALUE* a = base + instruction.src_[ 0 ] * buffer_size;
+    const VALUE* b = base + instruction.src_[ 1 ] * buffer_size;
+    const VALUE* c = base + instruction.src_[ 2 ] * buffer_size;
+
+    switch ( instruction.operation_ )
+    {
+    case LOAD_DATA_E:
+      if ( !LoadDataBlock( instruction.data_block_, index, size, dst ) )
+      {
+        error_line = instruction.function_;
+        return false;
+      }
+      break;
+    case LOAD_MASK_E:
+      {
+        const unsigned char* mask = instruction.mask_data_block_->get_mask_data() + index;
+        unsigned char mask_value = instruction.mask_data_block_->get_mask_value();
+        for ( size_type k = 0; k < size; k++ ) dst[ k ] = ( mask[ k ] & mask_value ) ? one : zero;
+      }
+      break;
+    case STORE_DATA_E:
+      if ( !StoreDataBlock( a, instruction.data_block_, index, size ) )
+      {
+        error_line = instruction.function_;
+        return false;
+      }
+      break;
+    case SEQ_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ 0 ];
+      break;
+    case ADD_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] + b[ k ];
+      break;
+    case SUB_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] - b[ k ];
+      break;
+    case NEG_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = -a[ k ];
+      break;
+    case MULT_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] * b[ k ];
+      break;
+    case DIV_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] / b[ k ];
+      break;
+    case ABS_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] < zero ? -a[ k ] : a[ k ];
+      break;
+    case SIGN_E:
+      for ( size_type k = 0; k < size; k++ ) 
+      {
+        dst[ k ] = a[ k ] > zero ? one : ( a[ k ] < zero ? -one : zero );
+      }
+      break;
+    case NOT_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] ? zero : one;
+      break;
+    case BOOLEAN_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] ? one : zero;
+      break;
+    case AND_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = ( a[ k ] && b[ k ] ) ? one : zero;
+      break;
+    case OR_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = ( a[ k ] || b[ k ] ) ? one : zero;
+      break;
+    case EQ_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] == b[ k ] ? one : zero;
+      break;
+    case NEQ_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] != b[ k ] ? one : zero;
+      break;
+    case LE_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] <= b[ k ] ? one : zero;
+      break;
+    case GE_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] >= b[ k ] ? one : zero;
+      break;
+    case LS_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] < b[ k ] ? one : zero;
+      break;
+    case GT_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] > b[ k ] ? one : zero;
+      break;
+    case MIN_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] < b[ k ] ? a[ k ] : b[ k ];
+      break;
+    case MAX_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] > b[ k ] ? a[ k ] : b[ k ];
+      break;
+    case SELECT_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = a[ k ] ? b[ k ] : c[ k ];
+      break;
+    case SQRT_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::sqrt( a[ k ] );
+      break;
+    case EXP_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::exp( a[ k ] );
+      break;
+    case LOG_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::log( a[ k ] );
+      break;
+    case POW_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::pow( a[ k ], b[ k ] );
+      break;
+    case FLOOR_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::floor( a[ k ] );
+      break;
+    case CEIL_E:
+      for ( size_type k = 0; k < size; k++ ) dst[ k ] = std::ceil( a[ k ] );
+      break;
+    case ROUND_E:
+      // Same as the cast to int of round_s
+      for ( size_type k = 0; k < size; k++ ) 
+      {
+        VALUE value = a[ k ] + half;
+        dst[ k ] = value < zero ? std::ceil( value ) : std::floor( value );
+      }
+      break;
+    default:
+      error_line = instruction.function_;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+ArrayMathFusedProgram::ArrayMathFusedProgram() :
+  private_( new ArrayMathFusedProgramPrivate )
+{
+  this->private_->buffer_size_ = 0;
+  this->private_->num_registers_ = 0;
+  this->private_->double_precision_ = false;
+}
+
+size_t ArrayMathFusedProgram::get_num_registers() const
+{
+  return this->private_->num_registers_;
+}
+
+bool ArrayMathFusedProgram::get_double_precision() const
+{
+  return this->private_->double_precision_;
+}
+
+void ArrayMathFusedProgram::begin( int thread )
+{
+  // The registers are allocated by the thread that uses them, so they end up in memory close
+  // to the processor that runs it
+  if ( this->private_->double_precision_ )
+  {
+    this->private_->begin_instructions( this->private_->double_registers_[ thread ] );
+  }
+  else
+  {
+    this->private_->begin_instructions( this->private_->float_registers_[ thread ] );
+  }
+}
+
+bool ArrayMathFusedProgram::run( int thread, index_type index, size_type size, 
+  size_t& error_line )
+{
+  if ( this->private_->double_precision_ )
+  {
+    return this->private_->run_instructions( this->private_->double_registers_[ thread ],
+      index, size, error_line );
+  }
+  return this->private_->run_instructions( this->private_->float_registers_[ thread ],
+    index, size, error_line );
+}
+
+bool ArrayMathFusedProgram::Create( ParserProgramHandle& pprogram, 
+  ArrayMathProgramHandle& mprogram, ArrayMathFusedProgramHandle& fprogram )
+{
+  fprogram.reset();
+
+  ArrayMathFusedProgramHandle program( new ArrayMathFusedProgram );
+  ArrayMathFusedProgramPrivateHandle& program_private = program->private_;
+  program_private->buffer_size_ = mprogram->get_buffer_size();
+  program_private->float_registers_.resize( mprogram->get_num_threads() );
+  program_private->double_registers_.resize( mprogram->get_num_threads() );
+
+  const FusedOperationMap& operations = GetFusedOperations();
+
+  ParserScriptFunctionHandle fhandle;
+  ArrayMathProgramSource ps;
+  size_t num_sequential_functions = pprogram->num_sequential_functions();
+
+  for ( size_t j = 0; j < num_sequential_functions; j++ )
+  {
+    pprogram->get_sequential_function( j, fhandle );
+
+    FusedOperationMap::const_iterator it = operations.find( 
+      fhandle->get_function()->get_function_id() );
+    if ( it == operations.end() ) return false;
+
+    ArrayMathFusedInstruction instruction;
+    instruction.operation_ = it->second;
+    instruction.function_ = j;
+
+    size_t num_input_vars = fhandle->num_input_vars();
+    if ( num_input_vars > 3 ) return false;
+
+    for ( size_t i = 0; i < num_input_vars; i++ )
+    {
+      ParserScriptVariableHandle ihandle = fhandle->get_input_var( i );
+      std::string name = ihandle->get_name();
+      int inum = ihandle->get_var_number();
+      int flags = ihandle->get_flags();
+      std::string type = ihandle->get_type();
+
+      if ( type == "S" )
+      {
+        // Variables that are computed by the const and single part of the program are
+        // copied into a register when a thread starts
+        if ( ( flags & SCRIPT_SEQUENTIAL_VAR_E ) && !( flags & SCRIPT_CONST_VAR_E ) )
+        {
+          if ( !program_private->get_register( inum, instruction.src_[ i ] ) ) return false;
+        }
+        else if ( flags & SCRIPT_SEQUENTIAL_VAR_E )
+        {
+          instruction.src_[ i ] = program_private->get_constant_register( 
+            mprogram->get_sequential_variable( inum, 0 )->get_data(), 
+            program_private->buffer_size_ );
+        }
+        else if ( flags & SCRIPT_SINGLE_VAR_E )
+        {
+          instruction.src_[ i ] = program_private->get_constant_register( 
+            mprogram->get_single_variable( inum )->get_data(), 1 );
+        }
+        else if ( flags & SCRIPT_CONST_VAR_E )
+        {
+          instruction.src_[ i ] = program_private->get_constant_register( 
+            mprogram->get_const_variable( inum )->get_data(), 1 );
+        }
+        else
+        {
+          return false;
+        }
+      }
+      else if ( type == "DATA" )
+      {
+        if ( instruction.operation_ != LOAD_DATA_E || !mprogram->find_source( name, ps ) ||
+          !ps.is_data_block() ) return false;
+        instruction.data_block_ = ps.get_data_block();
+        if ( NeedsDoublePrecision( instruction.data_block_->get_data_type() ) )
+        {
+          program_private->double_precision_ = true;
+        }
+      }
+      else if ( type == "MASK" )
+      {
+        if ( instruction.operation_ != LOAD_MASK_E || !mprogram->find_source( name, ps ) ||
+          !ps.is_mask_data_block() ) return false;
+        instruction.mask_data_block_ = ps.get_mask_data_block();
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    // Output of the function, which is either a register or the sink
+    ParserScriptVariableHandle ohandle = fhandle->get_output_var();
+    std::string name = ohandle->get_name();
+    if ( ohandle->get_type() == "S" )
+    {
+      if ( instruction.operation_ == STORE_DATA_E ) return false;
+      instruction.dst_ = program_private->new_register( ohandle->get_var_number() );
+    }
+    else if ( ohandle->get_type() == "DATA" )
+    {
+      if ( instruction.operation_ != STORE_DATA_E || !mprogram->find_sink( name, ps ) ||
+        !ps.is_data_block() ) return false;
+      instruction.data_block_ = ps.get_data_block();
+      if ( NeedsDoublePrecision( instruction.data_block_->get_data_type() ) )
+      {
+        program_private->double_precision_ = true;
+      }
+    }
+    else
+    {
+      return false;
+    }
+
+    program_private->instructions_.push_back( instruction );
+  }
+
+  fprogram = program;
+  return true;
+}
+
+} // end namespace
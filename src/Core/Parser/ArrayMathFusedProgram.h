@@ -0,0 +1,87 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_PARSER_ARRAYMATHFUSEDPROGRAM_H 
+#define CORE_PARSER_ARRAYMATHFUSEDPROGRAM_H 
+
+// Core includes
+#include <Core/Parser/ParserFWD.h>
+
+namespace Core
+{
+
+// Hide header includes, private interface and implementation
+class ArrayMathFusedProgramPrivate;
+typedef boost::shared_ptr< ArrayMathFusedProgramPrivate > ArrayMathFusedProgramPrivateHandle;
+
+// CLASS ArrayMathFusedProgram:
+/// The sequential part of an ArrayMathProgram compiled into one function that computes a
+/// whole buffer at once. Sources are read directly in their own data type, intermediate
+/// values are kept in registers that stay in the cache, and the result is written directly
+/// into the typed sink. Only programs that use nothing but the arithmetic,
+/// comparison and logic functions can be fused, any other program runs function by function.
+
+class ArrayMathFusedProgram
+{
+  // -- Constructor --
+private:
+  ArrayMathFusedProgram();
+
+public:
+  // BEGIN:
+  /// Prepare the registers of a thread, called before the thread computes its first buffer
+  void begin( int thread );
+
+  // RUN:
+  /// Compute size elements starting at index, using the registers of a thread. On failure
+  /// error_line is the number of the sequential function that failed.
+  bool run( int thread, index_type index, size_type size, size_t& error_line );
+
+  // GET_NUM_REGISTERS:
+  /// The number of buffers of intermediate values each thread uses
+  size_t get_num_registers() const;
+
+  // GET_DOUBLE_PRECISION:
+  /// Whether intermediate values are doubles, which is the case when a source or the sink 
+  /// holds integers of more than 16 bits or doubles. Otherwise floats hold every value exactly.
+  bool get_double_precision() const;
+
+private:
+  ArrayMathFusedProgramPrivateHandle private_;
+
+public:
+  // CREATE:
+  /// Compile the sequential functions of a translated program. Returns false if the program
+  /// uses a function that cannot be fused.
+  static bool Create( ParserProgramHandle& pprogram, ArrayMathProgramHandle& mprogram, 
+    ArrayMathFusedProgramHandle& fprogram );
+};
+
+}
+
+#endif
@@ -34,6 +34,7 @@
 
 // Core includes
 #include <Core/Parser/ArrayMathFunction.h>
+#include <Core/Parser/ArrayMathFusedProgram.h>
 #include <Core/Parser/ArrayMathInterpreter.h>
 #include <Core/Parser/ArrayMathProgram.h>
 #include <Core/Parser/ArrayMathProgramVariable.h>
@@ -613,6 +614,21 @@ bool ArrayMathInterpreter::translate( ParserProgramHandle& pprogram,
   return true;
 }
 
+bool ArrayMathInterpreter::fuse( ParserProgramHandle& pprogram,
+    ArrayMathProgramHandle& mprogram, std::string& error )
+{
+  if ( mprogram.get() == 0 )
+  {
+    error = "INTERNAL ERROR - Program needs to be translated before it can be fused.";
+    return false;
+  }
+
+  ArrayMathFusedProgramHandle fprogram;
+  ArrayMathFusedProgram::Create( pprogram, mprogram, fprogram );
+  mprogram->set_fused_program( fprogram );
+  return true;
+}
+
 bool ArrayMathInterpreter::run( ArrayMathProgramHandle& mprogram, std::string& error )
 {
   // This does not optimally make use of the parser, in principal the
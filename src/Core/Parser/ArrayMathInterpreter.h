@@ -66,6 +66,11 @@ public:
   bool translate( ParserProgramHandle& pprogram, ArrayMathProgramHandle& mprogram,
     std::string& error );
 
+  /// Compile the sequential part of the translated program into one fused
+  /// function. Programs that cannot be fused are left to run function by function.
+  bool fuse( ParserProgramHandle& pprogram, ArrayMathProgramHandle& mprogram,
+    std::string& error );
+
   //------------------------------------------------------------------------
   /// Step 3: Set the array size
 
@@ -30,6 +30,7 @@
 #include <boost/thread.hpp>
 
 // Core includes
+#include <Core/Parser/ArrayMathFusedProgram.h>
 #include <Core/Parser/ArrayMathProgram.h> 
 #include <Core/Utils/Parallel.h>
 
@@ -70,6 +71,9 @@ public:
 
   ParserProgramHandle pprogram_;
 
+  // Sequential part of the program compiled into one function, if possible
+  ArrayMathFusedProgramHandle fused_program_;
+
   // Error reporting parallel code
   std::vector< size_type > error_line_;
   std::vector< bool > success_;
@@ -99,6 +103,12 @@ void ArrayMathProgramPrivate::parallel_run( int thread, int num_threads, boost::
 
   double one_percent_count = 0.01 * per_thread;
   double progress_count = 0;
+
+  if ( this->fused_program_ ) 
+  {
+    this->fused_program_->begin( thread );
+  }
+
   while ( offset < end )
   {
     if( thread == 0 && progress_count > one_percent_count )
@@ -115,18 +125,30 @@ void ArrayMathProgramPrivate::parallel_run( int thread, int num_threads, boost::
       sz = end - offset;
     }
 
-    size_t size = this->sequential_functions_[ thread ].size();
-    for ( size_t j = 0; j < size; j++ )
+    if ( this->fused_program_ )
     {
-      this->sequential_functions_[ thread ][ j ].set_index( offset );
-      this->sequential_functions_[ thread ][ j ].set_size( sz );
+      size_t error_line;
+      if ( !( this->fused_program_->run( thread, offset, sz, error_line ) ) )
+      {
+        this->error_line_[ thread ] = error_line;
+        this->success_[ thread ] = false;
+      }
     }
-    for ( size_t j = 0; j < size; j++ )
+    else
     {
-      if ( !( this->sequential_functions_[ thread ][ j ].run() ) )
+      size_t size = this->sequential_functions_[ thread ].size();
+      for ( size_t j = 0; j < size; j++ )
       {
-        this->error_line_[ thread ] = j;
-        this->success_[ thread ] = false;
+        this->sequential_functions_[ thread ][ j ].set_index( offset );
+        this->sequential_functions_[ thread ][ j ].set_size( sz );
+      }
+      for ( size_t j = 0; j < size; j++ )
+      {
+        if ( !( this->sequential_functions_[ thread ][ j ].run() ) )
+        {
+          this->error_line_[ thread ] = j;
+          this->success_[ thread ] = false;
+        }
       }
     }
     offset += sz;
@@ -146,8 +168,9 @@ ArrayMathProgram::ArrayMathProgram() :
   private_( new ArrayMathProgramPrivate )
 {
   // Buffer size describes how many values of a sequential variable are
-  // grouped together for vectorized execution
-  this->private_->buffer_size_ = 128;
+  // grouped together for vectorized execution. The buffers of a fused program
+  // are doubles, at this size a handful of them still fit in the cache.
+  this->private_->buffer_size_ = 1024;
   // Number of processors to use
   this->private_->num_threads_ = boost::thread::hardware_concurrency();
 
@@ -395,6 +418,16 @@ ParserProgramHandle ArrayMathProgram::get_parser_program()
   return this->private_->pprogram_;
 }
 
+void ArrayMathProgram::set_fused_program( ArrayMathFusedProgramHandle handle )
+{
+  this->private_->fused_program_ = handle;
+}
+
+ArrayMathFusedProgramHandle ArrayMathProgram::get_fused_program()
+{
+  return this->private_->fused_program_;
+}
+
 void ArrayMathProgram::update_progress( double amount )
 {
   this->update_progress_signal_( amount );
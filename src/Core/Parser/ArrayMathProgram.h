@@ -108,6 +108,11 @@ public:
   void set_parser_program( ParserProgramHandle handle );
   ParserProgramHandle get_parser_program();
 
+  /// Run the sequential part as a fused program instead of function by function, an empty
+  /// handle switches back to the functions
+  void set_fused_program( ArrayMathFusedProgramHandle handle );
+  ArrayMathFusedProgramHandle get_fused_program();
+
   typedef boost::signals2::signal< void (double) > update_progress_signal_type;
 
   // UPDATE_PROGRESS:
@@ -59,6 +59,9 @@ namespace Core
   class ArrayMathFunctionCatalog;
   typedef boost::shared_ptr< ArrayMathFunctionCatalog > ArrayMathFunctionCatalogHandle;
 
+  class ArrayMathFusedProgram;
+  typedef boost::shared_ptr< ArrayMathFusedProgram > ArrayMathFusedProgramHandle;
+
   class ArrayMathProgram;
   typedef boost::shared_ptr< ArrayMathProgram > ArrayMathProgramHandle;
 
@@ -0,0 +1,157 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/DataBlock/StdDataBlock.h>
+#include <Core/Parser/ArrayMathEngine.h>
+
+using namespace Core;
+
+namespace
+{
+
+const size_t NX = 67;
+const size_t NY = 31;
+const size_t NZ = 13;
+
+DataBlockHandle Evaluate( std::string expressions, DataBlockHandle data, DataType output_type,
+  bool fused )
+{
+  ArrayMathEngine engine;
+  engine.set_fused_execution( fused );
+
+  std::string error;
+  EXPECT_TRUE( engine.add_input_data_block( "data", data, error ) ) << error;
+  EXPECT_TRUE( engine.add_output_data_block( "RESULT", NX, NY, NZ, output_type, error ) ) 
+    << error;
+  engine.add_expressions( expressions );
+  EXPECT_TRUE( engine.parse_and_validate( error ) ) << error;
+  EXPECT_TRUE( engine.run( error ) ) << error;
+
+  DataBlockHandle result;
+  EXPECT_TRUE( engine.get_data_block( "RESULT", result ) );
+  return result;
+}
+
+DataBlockHandle CreateData( DataType data_type, double offset )
+{
+  DataBlockHandle data = StdDataBlock::New( NX, NY, NZ, data_type );
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    data->set_data_at( j, offset + static_cast< double >( ( j * 7919 ) % 101 ) );
+  }
+  return data;
+}
+
+} // end anonymous namespace
+
+TEST( ArrayMathEngineTest, FusedMatchesFunctions )
+{
+  DataBlockHandle data = CreateData( DataType::SHORT_E, -50.0 );
+  std::string expressions = 
+    "RESULT = select( data > 10, sqrt( data ) * 2 - 1, max( -data, abs( data / 3 ) ) );";
+
+  DataBlockHandle fused = Evaluate( expressions, data, DataType::FLOAT_E, true );
+  DataBlockHandle functions = Evaluate( expressions, data, DataType::FLOAT_E, false );
+  ASSERT_TRUE( fused && functions );
+
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    ASSERT_NEAR( functions->get_data_at( j ), fused->get_data_at( j ), 1e-4 ) << "at " << j;
+  }
+}
+
+TEST( ArrayMathEngineTest, FallsBackToFunctions )
+{
+  // sin cannot be fused
+  DataBlockHandle data = CreateData( DataType::FLOAT_E, 0.0 );
+  DataBlockHandle result = Evaluate( "RESULT = sin( data ) + 1;", data, DataType::FLOAT_E,
+    true );
+  ASSERT_TRUE( result );
+
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    ASSERT_NEAR( std::sin( data->get_data_at( j ) ) + 1.0, result->get_data_at( j ), 1e-5 );
+  }
+}
+
+TEST( ArrayMathEngineTest, KeepsIntegerPrecision )
+{
+  // These values cannot be represented exactly as floats
+  DataBlockHandle data = CreateData( DataType::INT_E, 123456789.0 );
+  DataBlockHandle result = Evaluate( "RESULT = data - 1000 + 2 * data;", data, 
+    DataType::INT_E, true );
+  ASSERT_TRUE( result );
+
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    ASSERT_EQ( 3.0 * data->get_data_at( j ) - 1000.0, result->get_data_at( j ) );
+  }
+}
+
+TEST( ArrayMathEngineTest, ClampsIntegerResults )
+{
+  DataBlockHandle data = CreateData( DataType::FLOAT_E, -50.0 );
+  DataBlockHandle result = Evaluate( "RESULT = data * 10;", data, DataType::UCHAR_E, true );
+  ASSERT_TRUE( result );
+
+  for ( size_t j = 0; j < data->get_size(); j++ )
+  {
+    double expected = std::min( 255.0, std::max( 0.0, 10.0 * data->get_data_at( j ) ) );
+    ASSERT_EQ( expected, result->get_data_at( j ) );
+  }
+}
+
+TEST( ArrayMathEngineTest, ReadsMasks )
+{
+  GridTransform grid_transform( NX, NY, NZ );
+  MaskDataBlockHandle mask;
+  ASSERT_TRUE( MaskDataBlockManager::Create( grid_transform, mask ) );
+  for ( size_t j = 0; j < mask->get_size(); j += 3 ) mask->set_mask_at( j );
+
+  ArrayMathEngine engine;
+  std::string error;
+  std::string expressions = "RESULT = !mask;";
+  ASSERT_TRUE( engine.add_input_mask_data_block( "mask", mask, error ) ) << error;
+  ASSERT_TRUE( engine.add_output_data_block( "RESULT", NX, NY, NZ, DataType::CHAR_E, error ) );
+  engine.add_expressions( expressions );
+  ASSERT_TRUE( engine.parse_and_validate( error ) ) << error;
+  ASSERT_TRUE( engine.run( error ) ) << error;
+
+  DataBlockHandle result;
+  ASSERT_TRUE( engine.get_data_block( "RESULT", result ) );
+  for ( size_t j = 0; j < mask->get_size(); j++ )
+  {
+    ASSERT_EQ( mask->get_mask_at( j ) ? 0.0 : 1.0, result->get_data_at( j ) );
+  }
+}
@@ -73,9 +73,14 @@ public:
   int active_scene_texture_;
   int active_overlay_texture_;
 
+  // NOTE: The addresses of redraw_needed_ and redraw_overlay_needed_ are also used as the keys
+  // for coalescing redraw events that are posted to the renderer thread
   bool redraw_needed_;
   bool redraw_overlay_needed_;
   bool active_;
+
+  // Key for coalescing redraw_all events, only its address is used
+  char redraw_all_key_;
 };
 
 
@@ -84,8 +89,10 @@ void RendererBasePrivate::redraw_scene( PickPointHandle pick_point )
   // Migrate to the right thread
   if ( !this->renderer_->is_renderer_thread() )
   {
+    // NOTE: Redraws for picking need to happen each time, other redraws that are still
+    // waiting are redundant
     this->renderer_->post_renderer_event( boost::bind( &RendererBasePrivate::redraw_scene,
-      this, pick_point ) );
+      this, pick_point ), pick_point ? 0 : &this->redraw_needed_ );
     return;
   }
 
@@ -109,7 +116,7 @@ void RendererBasePrivate::redraw_overlay()
   if ( !this->renderer_->is_renderer_thread() )
   {
     this->renderer_->post_renderer_event( boost::bind( &RendererBasePrivate::redraw_overlay,
-      this) );
+      this ), &this->redraw_overlay_needed_ );
     return;
   }
 
@@ -130,7 +137,7 @@ void RendererBasePrivate::redraw_all()
   if ( !this->renderer_->is_renderer_thread() )
   {
     this->renderer_->post_renderer_event( boost::bind( &RendererBasePrivate::redraw_all,
-      this) );
+      this ), &this->redraw_all_key_ );
     return;
   }
 
@@ -542,10 +549,11 @@ bool RendererBase::is_renderer_thread()
 #endif
 }
 
-void RendererBase::post_renderer_event( boost::function< void () > event )
+void RendererBase::post_renderer_event( boost::function< void () > event, 
+  EventQueue::coalesce_key_type key )
 {
 #if MULTITHREADED_RENDERING
-  this->post_event( event );
+  this->post_coalesced_event( key, event );
 #else
   Interface::PostEvent( event );
 #endif
@@ -149,8 +149,10 @@ protected:
   bool is_renderer_thread();
 
   // POST_RENDERER_EVENT:
-  /// Post an event to the renderer thread.
-  void post_renderer_event( boost::function< void () > event );
+  /// Post an event to the renderer thread. If key is not 0, the event replaces an event with
+  /// the same key that is still waiting.
+  void post_renderer_event( boost::function< void () > event, 
+    EventQueue::coalesce_key_type key = 0 );
 
 protected:
 
@@ -0,0 +1,70 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <Core/Action/ActionFactory.h>
+#include <Core/Application/Application.h>
+#include <Core/Utils/StringUtil.h>
+#include <Core/State/Actions/ActionGetEventStatistics.h>
+
+CORE_REGISTER_ACTION( Core, GetEventStatistics )
+
+namespace Core
+{
+
+bool ActionGetEventStatistics::validate( ActionContextHandle& context )
+{
+  return true;
+}
+
+bool ActionGetEventStatistics::run( ActionContextHandle& context, ActionResultHandle& result )
+{
+  EventQueueStatistics statistics;
+  if ( !Application::Instance()->get_event_statistics( statistics ) )
+  {
+    context->report_error( "The application event handler does not keep statistics." );
+    return false;
+  }
+
+  if ( this->reset_ ) Application::Instance()->reset_event_statistics();
+
+  std::string text = 
+    "posted: " + ExportToString( statistics.posted_ ) + "\n" +
+    "handled: " + ExportToString( statistics.handled_ ) + "\n" +
+    "coalesced: " + ExportToString( statistics.coalesced_ ) + "\n" +
+    "overflowed: " + ExportToString( statistics.overflowed_ ) + "\n" +
+    "depth: " + ExportToString( statistics.depth_ ) + "\n" +
+    "max_depth: " + ExportToString( statistics.max_depth_ ) + "\n" +
+    "average_latency_ms: " + ExportToString( statistics.average_latency_ * 1000.0 ) + "\n" +
+    "max_latency_ms: " + ExportToString( statistics.max_latency_ * 1000.0 ) + "\n" +
+    "events_per_second: " + ExportToString( statistics.events_per_second_ ) + "\n";
+
+  result = ActionResultHandle( new ActionResult( text ) );
+  return true;
+}
+
+} // end namespace Core
@@ -0,0 +1,66 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_STATE_ACTIONS_ACTIONGETEVENTSTATISTICS_H
+#define CORE_STATE_ACTIONS_ACTIONGETEVENTSTATISTICS_H
+
+#include <Core/Action/Action.h>
+
+namespace Core
+{
+
+class ActionGetEventStatistics : public Action
+{
+
+CORE_ACTION( 
+CORE_ACTION_TYPE( "GetEventStatistics", "Get the counters of the application event queue: "
+  "the number of events posted, handled and coalesced, the queue depth, the latency between "
+  "posting and handling an event, and the number of events handled per second." )
+CORE_ACTION_OPTIONAL_ARGUMENT( "reset", "false", "Reset the counters after reading them." )
+);
+
+  // -- Constructor/Destructor --
+public:
+  ActionGetEventStatistics()
+  {
+    this->add_parameter( this->reset_ );
+  }
+
+  // -- Functions that describe action --
+  virtual bool validate( ActionContextHandle& context ) override;
+  virtual bool run( ActionContextHandle& context, ActionResultHandle& result ) override;
+
+  // -- Action parameters --
+private:
+  // Whether the counters need to be reset
+  bool reset_;
+};
+
+} // end namespace Core
+
+#endif
@@ -26,14 +26,12 @@
  DEALINGS IN THE SOFTWARE.
  */
 
-// STL includes
-#include <vector>
-
 // Boost includes
 #include <boost/thread.hpp>
 
 // Core includes
 #include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
 
 namespace Core
 {
@@ -67,21 +65,8 @@ Parallel::Parallel( boost::function< void ( int, int, boost::barrier& ) > functi
 
 void Parallel::run()
 {
-  boost::barrier barrier( this->private_->num_threads_ );
-
-  std::vector< boost::thread* > threads( this->private_->num_threads_ );
-
-  for ( int i = 0; i < this->private_->num_threads_; i++ )
-  {
-    threads[ i ] = new boost::thread( boost::bind( this->private_->function_, i, 
-      this->private_->num_threads_, boost::ref( barrier ) ) );
-  }
-
-  for ( int i = 0; i < this->private_->num_threads_; i++ )
-  {
-    threads[ i ]->join();
-    delete threads[ i ];
-  }
+  // The threads are taken from the thread pool, so no threads are created for every call
+  ThreadPool::Instance()->run_concurrent( this->private_->function_, this->private_->num_threads_ );
 }
 
 } // end namespace Core
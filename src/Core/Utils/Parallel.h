@@ -45,6 +45,10 @@ namespace Core
 class ParallelPrivate;
 typedef boost::shared_ptr< ParallelPrivate > ParallelPrivateHandle;
 
+// CLASS PARALLEL:
+/// Run function( thread, num_threads, barrier ) on num_threads threads at the same time.
+/// Work that does not need the barrier is better split with ThreadPool::parallel_for,
+/// which balances uneven work over the threads.
 class Parallel : public boost::noncopyable
 {
 
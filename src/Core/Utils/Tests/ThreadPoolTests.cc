@@ -0,0 +1,145 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <Core/Utils/AtomicCounter.h>
+#include <Core/Utils/Parallel.h>
+#include <Core/Utils/ThreadPool.h>
+
+static void MarkRange( std::vector<int>* marks, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ ) ( *marks )[ j ]++;
+}
+
+static void CountRange( Core::AtomicCounter* counter, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ ) ++( *counter );
+}
+
+static void CountNested( Core::AtomicCounter* counter, size_t begin, size_t end )
+{
+  for ( size_t j = begin; j < end; j++ )
+  {
+    Core::ThreadPool::Instance()->parallel_for( 0, 100, 7, 
+      boost::bind( &CountRange, counter, _1, _2 ) );
+  }
+}
+
+static void CountCall( Core::AtomicCounter* counter )
+{
+  ++( *counter );
+}
+
+static void CancelAndCount( Core::TaskGroup* group, Core::AtomicCounter* counter )
+{
+  ++( *counter );
+  group->cancel();
+}
+
+static void ThrowError()
+{
+  throw std::runtime_error( "task failed" );
+}
+
+static void WaitAtBarrier( Core::AtomicCounter* counter, int thread, int num_threads, 
+  boost::barrier& barrier )
+{
+  ++( *counter );
+  barrier.wait();
+  // Every thread has to pass the first barrier before any thread reaches this point
+  EXPECT_EQ( num_threads, static_cast<long>( *counter ) );
+  barrier.wait();
+}
+
+TEST(ThreadPoolTests, ParallelForCoversRange)
+{
+  std::vector<int> marks( 10007, 0 );
+  Core::ThreadPool::Instance()->parallel_for( 0, marks.size(), 13, 
+    boost::bind( &MarkRange, &marks, _1, _2 ) );
+  for ( size_t j = 0; j < marks.size(); j++ )
+  {
+    ASSERT_EQ( 1, marks[ j ] );
+  }
+
+  // Empty ranges do not call the function
+  Core::ThreadPool::Instance()->parallel_for( 5, 5, 0, boost::bind( &MarkRange, &marks, _1, _2 ) );
+  ASSERT_EQ( 1, marks[ 5 ] );
+}
+
+TEST(ThreadPoolTests, NestedParallelFor)
+{
+  Core::AtomicCounter counter;
+  Core::ThreadPool::Instance()->parallel_for( 0, 64, 1, boost::bind( &CountNested, &counter, _1, _2 ) );
+  ASSERT_EQ( 64 * 100, static_cast<long>( counter ) );
+}
+
+TEST(ThreadPoolTests, TaskGroupCancel)
+{
+  Core::AtomicCounter counter;
+  Core::TaskGroup group;
+  group.cancel();
+  group.run( boost::bind( &CountCall, &counter ) );
+  group.wait();
+  ASSERT_TRUE( group.is_canceled() );
+  ASSERT_EQ( 0, static_cast<long>( counter ) );
+
+  // Canceling from within a range stops the remaining ranges from being split and run
+  Core::TaskGroup range_group;
+  range_group.parallel_for( 0, 1 << 20, 1, 
+    boost::bind( &CancelAndCount, &range_group, &counter ) );
+  range_group.wait();
+  ASSERT_LT( static_cast<long>( counter ), 1 << 20 );
+}
+
+TEST(ThreadPoolTests, TaskGroupException)
+{
+  Core::AtomicCounter counter;
+  Core::TaskGroup group;
+  group.run( &ThrowError );
+  ASSERT_THROW( group.wait(), std::runtime_error );
+  ASSERT_TRUE( group.is_canceled() );
+}
+
+TEST(ThreadPoolTests, ParallelRunsConcurrently)
+{
+  // More threads than cores, all of them need to reach the barrier
+  for ( int j = 0; j < 10; j++ )
+  {
+    Core::AtomicCounter counter;
+    Core::Parallel parallel( boost::bind( &WaitAtBarrier, &counter, _1, _2, _3 ), 13 );
+    parallel.run();
+    ASSERT_EQ( 13, static_cast<long>( counter ) );
+  }
+}
@@ -0,0 +1,548 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+// STL includes
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <vector>
+
+// Boost includes
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+// Core includes
+#include <Core/Utils/ThreadPool.h>
+
+namespace Core
+{
+
+// Task in one of the queues of the pool, it keeps its group alive until it has run
+class ThreadPoolTask
+{
+public:
+  boost::function< void () > function_;
+  TaskGroupPrivateHandle group_;
+};
+
+class TaskGroupPrivate
+{
+public:
+  TaskGroupPrivate() :
+    pending_( 0 ),
+    waiters_( 0 ),
+    canceled_( false )
+  {
+  }
+
+  // Number of tasks that were scheduled and did not finish yet
+  std::atomic< long > pending_;
+
+  // Number of threads that sleep in wait()
+  std::atomic< int > waiters_;
+
+  // Tasks that did not start yet are skipped once this is set
+  std::atomic< bool > canceled_;
+
+  // The first exception that was thrown by one of the tasks
+  std::exception_ptr exception_;
+  boost::mutex mutex_;
+};
+
+// Queue of a worker thread. The worker takes the newest task from the back, while
+// other threads steal the oldest tasks from the front.
+class WorkerQueue
+{
+public:
+  boost::mutex mutex_;
+  std::deque< ThreadPoolTask > tasks_;
+};
+
+typedef boost::shared_ptr< WorkerQueue > WorkerQueueHandle;
+
+// State of one call to run_concurrent
+class ConcurrentRun
+{
+public:
+  boost::mutex mutex_;
+  boost::condition_variable finished_;
+  int remaining_;
+};
+
+// Thread that runs one function of run_concurrent at a time and is reused afterwards
+class ConcurrentThread
+{
+public:
+  ConcurrentThread() :
+    run_( 0 ),
+    exit_( false )
+  {
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable job_ready_;
+  boost::function< void () > job_;
+  ConcurrentRun* run_;
+
+  // Set when the pool is destroyed, the thread exits instead of waiting for a function
+  bool exit_;
+};
+
+typedef boost::shared_ptr< ConcurrentThread > ConcurrentThreadHandle;
+
+class ThreadPoolPrivate
+{
+public:
+  // SCHEDULE:
+  /// Add a task to the queue of the calling worker or to the shared queue
+  void schedule( const ThreadPoolTask& task );
+
+  // FIND_TASK:
+  /// Take a task from the own queue or steal one from the other queues
+  bool find_task( int worker, ThreadPoolTask& task );
+
+  // EXECUTE:
+  /// Run a task and update its group
+  void execute( ThreadPoolTask& task );
+
+  // GET_WORKER_INDEX:
+  /// Index of the worker on the calling thread, or -1 for threads outside the pool
+  int get_worker_index();
+
+  // RUN_WORKER:
+  /// Main loop of a worker thread
+  void run_worker( int worker );
+
+  // RUN_CONCURRENT_THREAD:
+  /// Main loop of a thread that is used by run_concurrent
+  void run_concurrent_thread( ConcurrentThreadHandle thread );
+
+  // Number of worker threads
+  int num_workers_;
+
+  // One queue per worker, followed by the queue for tasks from threads outside the pool
+  std::vector< WorkerQueueHandle > queues_;
+
+  // Number of tasks in all queues together
+  std::atomic< long > num_queued_;
+
+  // Number of threads that wait for new tasks
+  std::atomic< int > num_sleeping_;
+
+  boost::mutex sleep_mutex_;
+  boost::condition_variable wake_up_;
+
+  // Set when the pool is destroyed, it is read by the workers and the threads of
+  // run_concurrent, which hold different mutexes
+  std::atomic< bool > done_;
+
+  boost::thread_group workers_;
+  boost::thread_specific_ptr< int > worker_index_;
+
+  // Threads of run_concurrent that are waiting for their next function
+  boost::mutex concurrent_mutex_;
+  std::vector< ConcurrentThreadHandle > idle_threads_;
+  size_t max_idle_threads_;
+};
+
+void ThreadPoolPrivate::schedule( const ThreadPoolTask& task )
+{
+  int worker = this->get_worker_index();
+  WorkerQueueHandle queue = this->queues_[ worker >= 0 ? worker : this->num_workers_ ];
+  {
+    boost::mutex::scoped_lock lock( queue->mutex_ );
+    queue->tasks_.push_back( task );
+  }
+  this->num_queued_++;
+
+  // A worker that is about to sleep checks num_queued_ after announcing itself, so either
+  // it sees the new task or it is counted here
+  if ( this->num_sleeping_ > 0 )
+  {
+    boost::mutex::scoped_lock lock( this->sleep_mutex_ );
+    this->wake_up_.notify_one();
+  }
+}
+
+bool ThreadPoolPrivate::find_task( int worker, ThreadPoolTask& task )
+{
+  if ( this->num_queued_ == 0 ) return false;
+
+  // The newest task of the own queue is most likely still in the cache
+  if ( worker >= 0 )
+  {
+    WorkerQueueHandle queue = this->queues_[ worker ];
+    boost::mutex::scoped_lock lock( queue->mutex_ );
+    if ( !queue->tasks_.empty() )
+    {
+      task = queue->tasks_.back();
+      queue->tasks_.pop_back();
+      this->num_queued_--;
+      return true;
+    }
+  }
+
+  // The oldest tasks of the other queues are usually the largest pieces of work
+  size_t num_queues = this->queues_.size();
+  size_t start = worker >= 0 ? static_cast< size_t >( worker + 1 ) : 
+    static_cast< size_t >( this->num_workers_ );
+  for ( size_t j = 0; j < num_queues; j++ )
+  {
+    size_t index = ( start + j ) % num_queues;
+    if ( static_cast< int >( index ) == worker ) continue;
+
+    WorkerQueueHandle queue = this->queues_[ index ];
+    boost::mutex::scoped_lock lock( queue->mutex_ );
+    if ( !queue->tasks_.empty() )
+    {
+      task = queue->tasks_.front();
+      queue->tasks_.pop_front();
+      this->num_queued_--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPoolPrivate::execute( ThreadPoolTask& task )
+{
+  TaskGroupPrivateHandle group = task.group_;
+  if ( !group->canceled_ )
+  {
+    try
+    {
+      task.function_();
+    }
+    catch ( ... )
+    {
+      boost::mutex::scoped_lock lock( group->mutex_ );
+      if ( !group->exception_ ) group->exception_ = std::current_exception();
+      group->canceled_ = true;
+    }
+  }
+
+  // Release the function before the group is finished, as it may refer to the caller
+  task.function_.clear();
+
+  // Threads waiting for the group sleep together with the idle workers
+  if ( --group->pending_ == 0 && group->waiters_ > 0 )
+  {
+    boost::mutex::scoped_lock lock( this->sleep_mutex_ );
+    this->wake_up_.notify_all();
+  }
+}
+
+int ThreadPoolPrivate::get_worker_index()
+{
+  int* index = this->worker_index_.get();
+  return index ? *index : -1;
+}
+
+void ThreadPoolPrivate::run_worker( int worker )
+{
+  this->worker_index_.reset( new int( worker ) );
+
+  while ( true )
+  {
+    ThreadPoolTask task;
+    if ( this->find_task( worker, task ) )
+    {
+      this->execute( task );
+      continue;
+    }
+
+    boost::mutex::scoped_lock lock( this->sleep_mutex_ );
+    this->num_sleeping_++;
+    while ( !this->done_ && this->num_queued_ == 0 )
+    {
+      this->wake_up_.wait( lock );
+    }
+    this->num_sleeping_--;
+    if ( this->done_ ) return;
+  }
+}
+
+void ThreadPoolPrivate::run_concurrent_thread( ConcurrentThreadHandle thread )
+{
+  while ( true )
+  {
+    boost::function< void () > job;
+    ConcurrentRun* run;
+    {
+      boost::mutex::scoped_lock lock( thread->mutex_ );
+      while ( !thread->run_ && !thread->exit_ ) thread->job_ready_.wait( lock );
+
+      // NOTE: The pool may already be gone, so the thread exits without touching it
+      if ( !thread->run_ ) return;
+      job.swap( thread->job_ );
+      run = thread->run_;
+      thread->run_ = 0;
+    }
+
+    job();
+    job.clear();
+
+    // Offer the thread for reuse before reporting that it is done, so the next call
+    // to run_concurrent finds it
+    bool keep_thread;
+    {
+      boost::mutex::scoped_lock lock( this->concurrent_mutex_ );
+      keep_thread = !this->done_ && this->idle_threads_.size() < this->max_idle_threads_;
+      if ( keep_thread ) this->idle_threads_.push_back( thread );
+    }
+
+    {
+      boost::mutex::scoped_lock lock( run->mutex_ );
+      if ( --run->remaining_ == 0 ) run->finished_.notify_one();
+    }
+
+    if ( !keep_thread ) return;
+  }
+}
+
+CORE_SINGLETON_IMPLEMENTATION( ThreadPool );
+
+ThreadPool::ThreadPool() :
+  private_( new ThreadPoolPrivate )
+{
+  // The thread that waits for a task group executes tasks as well
+  int num_threads = static_cast< int >( boost::thread::hardware_concurrency() );
+  this->private_->num_workers_ = num_threads > 2 ? num_threads - 1 : 1;
+  this->private_->num_queued_ = 0;
+  this->private_->num_sleeping_ = 0;
+  this->private_->done_ = false;
+  this->private_->max_idle_threads_ = static_cast< size_t >( 2 * ( num_threads > 2 ? num_threads : 2 ) );
+
+  for ( int j = 0; j <= this->private_->num_workers_; j++ )
+  {
+    this->private_->queues_.push_back( WorkerQueueHandle( new WorkerQueue ) );
+  }
+
+  for ( int j = 0; j < this->private_->num_workers_; j++ )
+  {
+    this->private_->workers_.create_thread( boost::bind( 
+      &ThreadPoolPrivate::run_worker, this->private_.get(), j ) );
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    boost::mutex::scoped_lock lock( this->private_->sleep_mutex_ );
+    this->private_->done_ = true;
+    this->private_->wake_up_.notify_all();
+  }
+  this->private_->workers_.join_all();
+
+  // Wake up the idle threads of run_concurrent without a function, so they exit. Threads that
+  // are still running a function see done_ and exit when it returns.
+  std::vector< ConcurrentThreadHandle > idle_threads;
+  {
+    boost::mutex::scoped_lock lock( this->private_->concurrent_mutex_ );
+    idle_threads.swap( this->private_->idle_threads_ );
+  }
+
+  for ( size_t j = 0; j < idle_threads.size(); j++ )
+  {
+    boost::mutex::scoped_lock lock( idle_threads[ j ]->mutex_ );
+    idle_threads[ j ]->exit_ = true;
+    idle_threads[ j ]->job_ready_.notify_one();
+  }
+}
+
+int ThreadPool::get_num_threads() const
+{
+  return this->private_->num_workers_ + 1;
+}
+
+bool ThreadPool::is_worker_thread() const
+{
+  return this->private_->get_worker_index() >= 0;
+}
+
+void ThreadPool::parallel_for( size_t begin, size_t end, size_t grain_size, 
+  range_function_type function )
+{
+  TaskGroup group;
+  group.parallel_for( begin, end, grain_size, function );
+  group.wait();
+}
+
+static void RunConcurrentJob( boost::function< void ( int, int, boost::barrier& ) > function,
+  int thread, int num_threads, boost::barrier* barrier )
+{
+  function( thread, num_threads, *barrier );
+}
+
+void ThreadPool::run_concurrent( boost::function< void ( int, int, boost::barrier& ) > function, 
+  int num_threads )
+{
+  if ( num_threads < 1 ) num_threads = 1;
+
+  boost::barrier barrier( static_cast< unsigned int >( num_threads ) );
+  ConcurrentRun run;
+  run.remaining_ = num_threads - 1;
+
+  for ( int j = 1; j < num_threads; j++ )
+  {
+    ConcurrentThreadHandle thread;
+    {
+      boost::mutex::scoped_lock lock( this->private_->concurrent_mutex_ );
+      if ( !this->private_->idle_threads_.empty() )
+      {
+        thread = this->private_->idle_threads_.back();
+        this->private_->idle_threads_.pop_back();
+      }
+    }
+
+    // All functions need to run at the same time, hence a new thread is started when
+    // no idle thread is available
+    if ( !thread )
+    {
+      thread = ConcurrentThreadHandle( new ConcurrentThread );
+      boost::thread( boost::bind( &ThreadPoolPrivate::run_concurrent_thread, 
+        this->private_.get(), thread ) );
+    }
+
+    boost::mutex::scoped_lock lock( thread->mutex_ );
+    thread->job_ = boost::bind( &RunConcurrentJob, function, j, num_threads, &barrier );
+    thread->run_ = &run;
+    thread->job_ready_.notify_one();
+  }
+
+  function( 0, num_threads, barrier );
+
+  boost::mutex::scoped_lock lock( run.mutex_ );
+  while ( run.remaining_ > 0 ) run.finished_.wait( lock );
+}
+
+static void RunRange( TaskGroup* group, size_t begin, size_t end, size_t grain_size, 
+  const ThreadPool::range_function_type& function )
+{
+  // Leave the upper halves to other threads and continue with the lower half
+  while ( end - begin > grain_size && !group->is_canceled() )
+  {
+    size_t middle = begin + ( end - begin ) / 2;
+    group->run( boost::bind( &RunRange, group, middle, end, grain_size, function ) );
+    end = middle;
+  }
+
+  if ( !group->is_canceled() ) function( begin, end );
+}
+
+TaskGroup::TaskGroup() :
+  private_( new TaskGroupPrivate )
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  try
+  {
+    this->wait();
+  }
+  catch ( ... )
+  {
+  }
+}
+
+void TaskGroup::run( boost::function< void () > task )
+{
+  if ( this->private_->canceled_ ) return;
+
+  ThreadPoolTask pool_task;
+  pool_task.function_ = task;
+  pool_task.group_ = this->private_;
+
+  this->private_->pending_++;
+  ThreadPool::Instance()->private_->schedule( pool_task );
+}
+
+void TaskGroup::parallel_for( size_t begin, size_t end, size_t grain_size, 
+  ThreadPool::range_function_type function )
+{
+  if ( end <= begin ) return;
+
+  if ( grain_size == 0 )
+  {
+    // A few ranges per thread leave enough room for balancing uneven work
+    size_t num_ranges = 4 * static_cast< size_t >( ThreadPool::Instance()->get_num_threads() );
+    grain_size = ( end - begin + num_ranges - 1 ) / num_ranges;
+  }
+
+  this->run( boost::bind( &RunRange, this, begin, end, grain_size, function ) );
+}
+
+void TaskGroup::wait()
+{
+  ThreadPoolPrivate* pool = ThreadPool::Instance()->private_.get();
+  int worker = pool->get_worker_index();
+
+  // Help with queued tasks while the group is not finished
+  while ( this->private_->pending_ > 0 )
+  {
+    ThreadPoolTask task;
+    if ( pool->find_task( worker, task ) )
+    {
+      pool->execute( task );
+      continue;
+    }
+
+    // Sleep until the group is finished or new tasks are scheduled
+    boost::mutex::scoped_lock lock( pool->sleep_mutex_ );
+    this->private_->waiters_++;
+    pool->num_sleeping_++;
+    while ( this->private_->pending_ > 0 && pool->num_queued_ == 0 )
+    {
+      pool->wake_up_.wait( lock );
+    }
+    pool->num_sleeping_--;
+    this->private_->waiters_--;
+  }
+
+  std::exception_ptr exception;
+  {
+    boost::mutex::scoped_lock lock( this->private_->mutex_ );
+    exception = this->private_->exception_;
+    this->private_->exception_ = std::exception_ptr();
+  }
+  if ( exception ) std::rethrow_exception( exception );
+}
+
+void TaskGroup::cancel()
+{
+  this->private_->canceled_ = true;
+}
+
+bool TaskGroup::is_canceled() const
+{
+  return this->private_->canceled_;
+}
+
+} // end namespace Core
@@ -0,0 +1,141 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CORE_UTILS_THREADPOOL_H
+#define CORE_UTILS_THREADPOOL_H
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+# pragma once
+#endif 
+
+// Boost includes
+#include <boost/noncopyable.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/barrier.hpp>
+
+// Core includes
+#include <Core/Utils/Singleton.h>
+
+namespace Core
+{
+
+class ThreadPool;
+class ThreadPoolPrivate;
+typedef boost::shared_ptr< ThreadPoolPrivate > ThreadPoolPrivateHandle;
+
+class TaskGroup;
+class TaskGroupPrivate;
+typedef boost::shared_ptr< TaskGroupPrivate > TaskGroupPrivateHandle;
+
+// CLASS THREADPOOL:
+/// Process wide pool of worker threads. Every worker keeps its own queue of tasks and
+/// idle workers steal tasks from the other queues, so uneven work is balanced over the
+/// threads without creating new threads for every operation.
+class ThreadPool : public boost::noncopyable
+{
+  CORE_SINGLETON( ThreadPool );
+
+  // -- constructor/destructor --
+private:
+  ThreadPool();
+  virtual ~ThreadPool();
+
+public:
+  typedef boost::function< void ( size_t, size_t ) > range_function_type;
+
+  // GET_NUM_THREADS:
+  /// Number of threads that execute tasks, this includes the thread that waits for them
+  int get_num_threads() const;
+
+  // IS_WORKER_THREAD:
+  /// Whether the calling thread is one of the workers of the pool
+  bool is_worker_thread() const;
+
+  // PARALLEL_FOR:
+  /// Call function( range_begin, range_end ) for consecutive ranges that cover [ begin, end ).
+  /// Ranges are split until they are not larger than grain_size, a grain_size of 0 picks a
+  /// size based on the number of threads. Returns when all ranges have been processed.
+  void parallel_for( size_t begin, size_t end, size_t grain_size, range_function_type function );
+
+  // RUN_CONCURRENT:
+  /// Run function( thread, num_threads, barrier ) on num_threads threads that are guaranteed
+  /// to run at the same time, as required when they synchronize with the barrier. The calling
+  /// thread runs the first one, the others run on threads the pool keeps around for reuse.
+  void run_concurrent( boost::function< void ( int, int, boost::barrier& ) > function, 
+    int num_threads );
+
+private:
+  friend class TaskGroup;
+  ThreadPoolPrivateHandle private_;
+};
+
+// CLASS TASKGROUP:
+/// A set of tasks that run on the thread pool and that are waited on or canceled together.
+/// While waiting, the calling thread executes queued tasks itself, so task groups can be
+/// nested inside tasks without running out of threads.
+class TaskGroup : public boost::noncopyable
+{
+public:
+  TaskGroup();
+
+  /// The destructor waits for all tasks that are still running
+  ~TaskGroup();
+
+  // RUN:
+  /// Schedule a task on the thread pool
+  void run( boost::function< void () > task );
+
+  // PARALLEL_FOR:
+  /// Schedule function( range_begin, range_end ) for ranges covering [ begin, end ), see
+  /// ThreadPool::parallel_for. It does not wait for the ranges to be processed.
+  void parallel_for( size_t begin, size_t end, size_t grain_size, 
+    ThreadPool::range_function_type function );
+
+  // WAIT:
+  /// Wait until all tasks have finished. If a task threw an exception, the first one is
+  /// thrown again from here.
+  void wait();
+
+  // CANCEL:
+  /// Tasks that have not started yet are skipped. Running tasks finish unless they check
+  /// is_canceled() and return early.
+  void cancel();
+
+  // IS_CANCELED:
+  /// Whether the group was canceled, either by cancel() or by a task that threw an exception
+  bool is_canceled() const;
+
+private:
+  friend class ThreadPoolPrivate;
+  TaskGroupPrivateHandle private_;
+};
+
+} // end namespace Core
+
+#endif
@@ -437,12 +437,13 @@ void DataVolume::unregister_data()
 }
 
 bool DataVolume::LoadDataVolume( const boost::filesystem::path& filename, 
-                DataVolumeHandle& volume, std::string& error )
+                DataVolumeHandle& volume, std::string& error, 
+                boost::function< void ( double ) > progress )
 {
   volume.reset();
   
   NrrdDataHandle nrrd;
-  if ( ! ( NrrdData::LoadNrrd( filename.string(), nrrd, error ) ) ) return false;
+  if ( ! ( NrrdData::LoadNrrd( filename.string(), nrrd, error, progress ) ) ) return false;
   
   Core::DataBlockHandle datablock( Core::NrrdDataBlock::New( nrrd ) );
   
@@ -30,6 +30,7 @@
 #define CORE_VOLUME_DATAVOLUME_H
 
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 
 #include <Core/DataBlock/DataBlock.h>
 #include <Core/DataBlock/NrrdData.h>
@@ -130,9 +131,11 @@ private:
 public:
 
   // LOADDATAVOLUME:
-  /// Load a DataVolume from a nrrd file
+  /// Load a DataVolume from a nrrd file, the progress function is called with the fraction of
+  /// the file that has been read
   static bool LoadDataVolume( const boost::filesystem::path& filename, DataVolumeHandle& volume,
-    std::string& error );
+    std::string& error, 
+    boost::function< void ( double ) > progress = boost::function< void ( double ) >() );
 
   // SAVEDATAVOLUME:
   /// Save a DataVolume to a nrrd file
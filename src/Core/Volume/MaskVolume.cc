@@ -29,6 +29,9 @@
 #include <Core/Volume/MaskVolume.h>
 #include <Core/DataBlock/MaskDataBlockManager.h>
 #include <Core/DataBlock/DataBlockManager.h>
+#include <Core/DataBlock/NrrdData.h>
+#include <Core/DataBlock/NrrdDataBlock.h>
+#include <Core/Utils/StringUtil.h>
 
 namespace Core
 {
@@ -109,7 +112,14 @@ DataBlock::generation_type MaskVolume::register_data( DataBlock::generation_type
     }
     else
     {
-      Core::DataBlockManager::Instance()->register_datablock( this->mask_data_block_->get_data_block() );
+      DataBlockHandle data_block;
+      if ( generation != -1 && 
+        Core::DataBlockManager::Instance()->find_datablock( generation, data_block ) )
+      {
+        generation = -1;
+      }
+      Core::DataBlockManager::Instance()->register_datablock( 
+        this->mask_data_block_->get_data_block(), generation );
     }
 
     return this->mask_data_block_->get_generation();
@@ -169,6 +179,67 @@ bool MaskVolume::DuplicateMask( const MaskVolumeHandle& src_mask, MaskVolumeHand
   return true;
 }
 
+// Meta data key that records the number of voxels in x of a mask with packed bits
+static const char* const PACKED_MASK_NX_C = "seg3d-packed-mask-nx";
+
+bool MaskVolume::LoadMaskVolume( const boost::filesystem::path& filename, 
+  MaskVolumeHandle& volume, std::string& error, boost::function< void ( double ) > progress )
+{
+  volume.reset();
+
+  NrrdDataHandle nrrd;
+  if ( !( NrrdData::LoadNrrd( filename.string(), nrrd, error, progress ) ) ) return false;
+
+  std::string nx_string;
+  size_t nx = 0;
+  if ( !nrrd->get_meta_data( PACKED_MASK_NX_C, nx_string ) || 
+    !ImportFromString( nx_string, nx ) )
+  {
+    error = "File '" + filename.string() + "' does not contain a mask.";
+    return false;
+  }
+  
+  GridTransform grid_transform = nrrd->get_grid_transform();
+  grid_transform.set_nx( nx );
+
+  DataBlockHandle packed_data( NrrdDataBlock::New( nrrd ) );
+  MaskDataBlockHandle mask_data_block;
+  if ( !( MaskDataBlockManager::UnpackBitPlane( packed_data, grid_transform, 
+    mask_data_block ) ) )
+  {
+    error = "Mask in file '" + filename.string() + "' has the wrong dimensions.";
+    return false;
+  }
+
+  volume = MaskVolumeHandle( new MaskVolume( grid_transform, mask_data_block ) );
+  return true;
+}
+
+bool MaskVolume::SaveMaskVolume( const boost::filesystem::path& filepath, 
+  const MaskVolumeHandle& volume, std::string& error, bool compress, int level )
+{
+  DataBlockHandle packed_data;
+  if ( !volume->get_mask_data_block() || !( MaskDataBlockManager::PackBitPlane( 
+    volume->get_mask_data_block(), packed_data ) ) )
+  {
+    error = "Could not pack the mask data.";
+    return false;
+  }
+  
+  // NOTE: The transform is kept as it is, only the number of samples in x is reduced
+  GridTransform packed_transform = volume->get_grid_transform();
+  packed_transform.set_nx( packed_data->get_nx() );
+  NrrdDataHandle nrrd( new NrrdData( packed_data, packed_transform ) );
+  nrrd->set_meta_data( PACKED_MASK_NX_C, ExportToString( volume->get_grid_transform().get_nx() ) );
+
+  if ( !( NrrdData::SaveNrrd( filepath.string(), nrrd, error, compress, level ) ) ) 
+  {
+    return false;
+  }
+  
+  return true;
+}
+
 bool MaskVolume::insert_slice( const MaskDataSliceHandle slice )
 {
   if ( this->mask_data_block_ )
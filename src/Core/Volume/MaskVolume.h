@@ -81,7 +81,8 @@ public:
   virtual DataBlock::generation_type get_generation() const;
 
   // REGISTER_DATA:
-  /// Register the underlying data with the DataBlockManager.
+  /// Register the underlying data with the DataBlockManager. A generation that is given, such
+  /// as the one a mask was saved with, is used if no other datablock has it.
   virtual DataBlock::generation_type register_data( DataBlock::generation_type generation = -1 );
 
   // UNREGISTER_DATA:
@@ -117,6 +118,18 @@ public:
   /// Duplicate the mask volume
   static bool DuplicateMask( const MaskVolumeHandle& src_mask, MaskVolumeHandle& dst_mask );
 
+  // LOADMASKVOLUME:
+  /// Load a MaskVolume from a nrrd file that was written by SaveMaskVolume, the progress
+  /// function is called with the fraction of the file that has been read
+  static bool LoadMaskVolume( const boost::filesystem::path& filename, MaskVolumeHandle& volume,
+    std::string& error, 
+    boost::function< void ( double ) > progress = boost::function< void ( double ) >() );
+
+  // SAVEMASKVOLUME:
+  /// Save the bitplane of a MaskVolume to a nrrd file with one bit per voxel
+  static bool SaveMaskVolume( const boost::filesystem::path& filepath, 
+    const MaskVolumeHandle& volume, std::string& error, bool compress, int level );
+
 private:
   /// Handle to where the mask volume is really stored
   MaskDataBlockHandle mask_data_block_;
@@ -0,0 +1,145 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+
+ The MIT License
+
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+
+
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <Core/DataBlock/DataBlockManager.h>
+#include <Core/DataBlock/MaskDataBlockManager.h>
+#include <Core/Volume/DataVolume.h>
+#include <Core/Volume/MaskVolume.h>
+
+#include <Testing/Utils/FilesystemPaths.h>
+
+using namespace Core;
+using namespace Testing::Utils;
+
+namespace
+{
+
+class VolumeGenerationTest : public ::testing::Test 
+{
+protected:
+  virtual void SetUp()
+  {
+    MaskDataBlockManager::Instance()->clear();
+    DataBlockManager::Instance()->clear();
+    data_dir_ = testOutputDir() / "volume_generation";
+    boost::filesystem::create_directories( data_dir_ );
+  }
+
+  virtual void TearDown()
+  {
+    MaskDataBlockManager::Instance()->clear();
+    DataBlockManager::Instance()->clear();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all( data_dir_, ec );
+  }
+
+  boost::filesystem::path data_dir_;
+};
+
+} // end anonymous namespace
+
+// Saves a data layer and a mask layer the way a session does and restores them in the order
+// layers are loaded, after the managers have been cleared by resetting the application
+TEST_F( VolumeGenerationTest, SessionRoundTripKeepsGenerations )
+{
+  GridTransform grid_transform( 7, 5, 3 );
+  DataBlock::generation_type data_generation;
+  DataBlock::generation_type mask_generation;
+  std::string error;
+
+  {
+    DataVolumeHandle data_volume;
+    ASSERT_TRUE( DataVolume::CreateEmptyData( grid_transform, DataType::FLOAT_E, data_volume ) );
+    data_generation = data_volume->register_data();
+    data_volume->get_data_block()->set_data_at( 3, 2, 1, 42.0 );
+
+    MaskDataBlockHandle mask_data_block;
+    ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid_transform, mask_data_block ) );
+    MaskVolumeHandle mask_volume( new MaskVolume( grid_transform, mask_data_block ) );
+    mask_generation = mask_volume->register_data();
+    mask_data_block->set_mask_at( 1, 1, 1 );
+    ASSERT_NE( data_generation, mask_generation );
+
+    ASSERT_TRUE( DataVolume::SaveDataVolume( data_dir_ / "data.nrrd", data_volume, error,
+      false, 0 ) ) << error;
+    ASSERT_TRUE( MaskVolume::SaveMaskVolume( data_dir_ / "mask.nrrd", mask_volume, error, 
+      false, 0 ) ) << error;
+  }
+
+  MaskDataBlockManager::Instance()->clear();
+  DataBlockManager::Instance()->clear();
+
+  // Layers are restored in the order of the session, which may put the mask first
+  MaskVolumeHandle mask_volume;
+  ASSERT_TRUE( MaskVolume::LoadMaskVolume( data_dir_ / "mask.nrrd", mask_volume, error ) ) << error;
+  EXPECT_EQ( mask_generation, mask_volume->register_data( mask_generation ) );
+
+  DataVolumeHandle data_volume;
+  ASSERT_TRUE( DataVolume::LoadDataVolume( data_dir_ / "data.nrrd", data_volume, error ) ) << error;
+  EXPECT_EQ( data_generation, data_volume->register_data( data_generation ) );
+
+  DataBlockHandle data_block;
+  ASSERT_TRUE( DataBlockManager::Instance()->find_datablock( data_generation, data_block ) );
+  EXPECT_EQ( data_volume->get_data_block(), data_block );
+  EXPECT_EQ( 42.0, data_block->get_data_at( 3, 2, 1 ) );
+
+  ASSERT_TRUE( DataBlockManager::Instance()->find_datablock( mask_generation, data_block ) );
+  EXPECT_EQ( mask_volume->get_mask_data_block()->get_data_block(), data_block );
+  EXPECT_TRUE( mask_volume->get_mask_data_block()->get_mask_at( 1, 1, 1 ) );
+
+  // New data does not get any of the restored generations
+  DataVolumeHandle new_volume;
+  ASSERT_TRUE( DataVolume::CreateEmptyData( grid_transform, DataType::FLOAT_E, new_volume ) );
+  DataBlock::generation_type new_generation = new_volume->register_data();
+  EXPECT_NE( data_generation, new_generation );
+  EXPECT_NE( mask_generation, new_generation );
+}
+
+// A mask whose saved generation has been taken by another datablock gets a new generation
+TEST_F( VolumeGenerationTest, MaskGenerationInUseIsNotReused )
+{
+  GridTransform grid_transform( 7, 5, 3 );
+
+  DataVolumeHandle data_volume;
+  ASSERT_TRUE( DataVolume::CreateEmptyData( grid_transform, DataType::UCHAR_E, data_volume ) );
+  DataBlock::generation_type data_generation = data_volume->register_data( 5 );
+
+  MaskDataBlockHandle mask_data_block;
+  ASSERT_TRUE( MaskDataBlockManager::Instance()->create( grid_transform, mask_data_block ) );
+  MaskVolumeHandle mask_volume( new MaskVolume( grid_transform, mask_data_block ) );
+  DataBlock::generation_type mask_generation = mask_volume->register_data( data_generation );
+  EXPECT_NE( data_generation, mask_generation );
+
+  DataBlockHandle data_block;
+  ASSERT_TRUE( DataBlockManager::Instance()->find_datablock( data_generation, data_block ) );
+  EXPECT_EQ( data_volume->get_data_block(), data_block );
+}
@@ -492,14 +492,19 @@ void LayerIOFunctions::ExportIsosurface( QWidget* widget, LayerHandle layerHandl
   std::string extension;
   std::tie( extension, std::ignore ) = Core::GetFullExtension( boost::filesystem::path( filename.toStdString() ) );
 
-  // Binary STL needs to be handled as a special case because some Linux file dialogs (i.e. OpenSuSE)
-  // always default to first filter for the same file extensions
+  // Binary STL and VTK need to be handled as a special case because some Linux file dialogs 
+  // (i.e. OpenSuSE) always default to first filter for the same file extensions
   bool binary = false;
   if ( selectedFilter.startsWith("Binary STL") )
   {
     binary = true;
     if ( extension.empty() ) filename.append( ".stl" );
   }
+  else if ( selectedFilter.startsWith("Binary VTK") )
+  {
+    binary = true;
+    if ( extension.empty() ) filename.append( ".vtk" );
+  }
   else
   {
     if ( extension.empty() )
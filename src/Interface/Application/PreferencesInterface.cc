@@ -188,6 +188,8 @@ void PreferencesInterface::setup_general_prefs()
     PreferencesManager::Instance()->enable_undo_state_ ); 
   QtUtils::QtBridge::Connect( this->private_->ui_.percent_of_memory_,
     PreferencesManager::Instance()->percent_of_memory_state_ );
+  QtUtils::QtBridge::Connect( this->private_->ui_.undo_disk_space_,
+    PreferencesManager::Instance()->undo_disk_space_state_ );
 
   QtUtils::QtBridge::Enable( this->private_->ui_.x_lineedit_, 
     PreferencesManager::Instance()->axis_labels_option_state_,
@@ -218,6 +220,7 @@ void PreferencesInterface::setup_general_prefs()
   this->private_->ui_.compression_adjuster_->set_description( "Compression" );
   this->private_->ui_.auto_save_timer_adjuster_->set_description( "Frequency (minutes)" );
   this->private_->ui_.percent_of_memory_->set_description( "Undo/Redo buffer size" );
+  this->private_->ui_.undo_disk_space_->set_description( "Undo disk space (GB, 0 = off)" );
   this->private_->ui_.opacity_adjuster_->set_description( "Default layer opacity" );
 
 }
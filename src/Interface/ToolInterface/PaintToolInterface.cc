@@ -117,6 +117,8 @@ bool PaintToolInterface::build_widget( QFrame* frame )
     tool->show_data_cstr_bound_state_ );
   QtUtils::QtBridge::Enable( this->private_->ui_.target_mask_,
     tool->use_active_layer_state_, true );
+  QtUtils::QtBridge::Connect( this->private_->ui_.floodfill_3d_checkbox_, 
+    tool->flood_fill_3d_state_ );
   QtUtils::QtBridge::Connect( this->private_->ui_.floodfill_button_, boost::bind(
     &PaintTool::flood_fill, tool, Core::Interface::GetWidgetActionContext(), false ) );
   QtUtils::QtBridge::Connect( this->private_->ui_.flooderase_button_, boost::bind(
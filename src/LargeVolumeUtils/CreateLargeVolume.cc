@@ -38,6 +38,8 @@
 #include <boost/filesystem.hpp>
 #include <boost/preprocessor.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
 
 // Core includes
 #include <Core/Geometry/Point.h>
@@ -69,8 +71,16 @@ void printUsage()
             << "                                 Size of bricks can be set with single number (--bricksize=512 for 512,512,512 brick)." << std::endl;
   std::cout << "  --overlap=SCALAR             - Overlap betweeen the bricks, default is 1." << std::endl;
   std::cout << "  --nodownsample=CHAR          - Do not downsample in given direction (x,y, or z)." << std::endl << std::endl;
+  std::cout << "Compression parameters (optional):" << std::endl;
+  std::cout << "  --codec=STRING               - Brick compression: zlib, lz4 or none, default is zlib." << std::endl;
+  std::cout << "  --filter=STRING              - Filter applied before compression: none, shuffle or delta, default is none." << std::endl
+            << "                                 Delta also shuffles and only applies to integer data." << std::endl;
+  std::cout << "  --packed                     - Store all bricks in a single indexed pack file instead of one file per brick." << std::endl << std::endl;
   std::cout << "Tool parameters (optional):" << std::endl;
   std::cout << "  --maxgb=SCALAR               - Maximum number of GB to use for conversion, default is based on available memory." << std::endl;
+  std::cout << "  --resume                     - Continue a conversion into output_volume that was interrupted." << std::endl;
+  std::cout << "  --append                     - Add the slices beyond the end of output_volume, only affected bricks are rebuilt." << std::endl;
+  std::cout << "  --threads=SCALAR             - Number of threads used for conversion, default is the number of cores." << std::endl;
   std::cout << "  --silent                     - Do not wait for user input to continue." << std::endl;
 }
 
@@ -141,10 +151,30 @@ int main( int argc, char **argv )
     output_dir = boost::filesystem::path( output_dir.string() + ".s3dvol" );
   }
   
-  if (boost::filesystem::exists(output_dir))
+  bool resume = Core::Application::Instance()->is_command_line_parameter( "resume" );
+  bool append = Core::Application::Instance()->is_command_line_parameter( "append" );
+
+  if ( resume && append )
   {
     printUsage();
-    CORE_PRINT_AND_LOG_ERROR("Output directory '" + output_dir.string() + "' already exists, please delete directory before starting conversion.");
+    CORE_PRINT_AND_LOG_ERROR("Options --resume and --append cannot be combined.");
+    return -1;
+  }
+
+  if ( resume || append )
+  {
+    if (! boost::filesystem::exists(output_dir) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Output directory '" + output_dir.string() + "' does not exist.");
+      return -1;
+    }
+  }
+  else if (boost::filesystem::exists(output_dir))
+  {
+    printUsage();
+    CORE_PRINT_AND_LOG_ERROR("Output directory '" + output_dir.string() + "' already exists, please delete directory before starting conversion"
+      " or use --resume or --append.");
     return -1;
   }
   
@@ -249,6 +279,31 @@ int main( int argc, char **argv )
     if ( nodownsample == "z" ) down_sample_z = false;
   }
   
+  // -- compression --
+  Core::BrickCodecType codec = Core::BrickCodecType::ZLIB_E;
+  std::string codec_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "codec" , codec_string ) )
+  {
+    if (! Core::ImportFromString( codec_string, codec ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Codec needs to be zlib, lz4 or none.");
+      return -1;
+    }
+  }
+
+  Core::BrickFilterType filter = Core::BrickFilterType::NONE_E;
+  std::string filter_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "filter" , filter_string ) )
+  {
+    if (! Core::ImportFromString( filter_string, filter ) )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Filter needs to be none, shuffle or delta.");
+      return -1;
+    }
+  }
+
   long long mem_limit = 0;
   if ( sizeof(void *) == 4 )
   {
@@ -297,6 +352,18 @@ int main( int argc, char **argv )
     }
   }
   
+  int num_threads = Core::Max( 1, static_cast<int>( boost::thread::hardware_concurrency() ) );
+  std::string threads_string;
+  if ( Core::Application::Instance()->check_command_line_parameter( "threads" , threads_string ) )
+  {
+    if (! Core::ImportFromString( threads_string, num_threads ) || num_threads < 1 )
+    {
+      printUsage();
+      CORE_PRINT_AND_LOG_ERROR("Number of threads needs to be a positive number.");
+      return -1;
+    }
+  }
+
   Core::LargeVolumeConverterHandle converter( new Core::LargeVolumeConverter());
   
   converter->set_output_dir( output_dir );
@@ -304,6 +371,11 @@ int main( int argc, char **argv )
   converter->set_schema_parameters( spacing, origin, brick_size, overlap );
   converter->get_schema()->enable_downsample( down_sample_x, down_sample_y, down_sample_z );
   converter->set_mem_limit( mem_limit );
+  converter->set_num_threads( num_threads );
+  converter->set_resume( resume );
+  converter->set_append( append );
+  converter->set_codec( codec, filter );
+  converter->set_packed( Core::Application::Instance()->is_command_line_parameter( "packed" ) );
   
   // Scan files and compute schema
   std::string error;
@@ -326,7 +398,17 @@ int main( int argc, char **argv )
   std::cout << "Brick Size:         " << Core::ExportToString( schema->get_brick_size() ) << std::endl;
   std::cout << "Overlap:            " << Core::ExportToString( schema->get_overlap() ) << std::endl;
   std::cout << "Resolution Levels:  " << Core::ExportToString( schema->get_num_levels() ) << std::endl;
+  std::cout << "Compression:        " << Core::ExportToString( schema->get_codec() ) 
+            << " (filter: " << Core::ExportToString( schema->get_filter() ) << ")" << std::endl;
+  std::cout << "Brick Layout:       " << ( Core::Application::Instance()->is_command_line_parameter( "packed" ) ? 
+    "single pack file" : "one file per brick" ) << std::endl;
+  std::cout << "Threads:            " << Core::ExportToString( num_threads ) << std::endl;
   std::cout << "Memory Usage Limit: " << Core::ExportToString( mem_limit >> 30 ) << " GB" << std::endl;
+  if ( resume || append )
+  {
+    std::cout << ( resume ? "Resume at slice:    " : "Append from slice:  " ) 
+              << Core::ExportToString( converter->get_start_slice() ) << std::endl;
+  }
   if (nodownsample.size())
   {
     std::cout << "No downsample:      " << nodownsample << std::endl;
@@ -346,21 +428,41 @@ int main( int argc, char **argv )
   }
   
   std::cout << "== Downsampling and bricking of files == " << std::endl;
+  boost::posix_time::ptime phase2_start = boost::posix_time::microsec_clock::local_time();
   if (! converter->run_phase2( error ) )
   {
     printUsage();
     CORE_PRINT_AND_LOG_ERROR( error );
     return -1;
   }
+  boost::posix_time::ptime phase2_end = boost::posix_time::microsec_clock::local_time();
   
+  // Report throughput of reading and bricking the image stack
+  double phase2_seconds = Core::Max( 1e-3, ( phase2_end - phase2_start ).total_microseconds() * 1e-6 );
+  size_t num_slices = schema->get_nz() - converter->get_start_slice();
+  double input_mb = static_cast<double>( schema->get_nx() ) * schema->get_ny() * num_slices *
+    Core::GetSizeDataType( schema->get_data_type() ) / ( 1024.0 * 1024.0 );
+  std::cout << "Bricked " << num_slices << " slices in " << Core::ExportToString( phase2_seconds, 2 ) 
+            << " s: " << Core::ExportToString( num_slices / phase2_seconds, 2 ) << " slices/s, "
+            << Core::ExportToString( input_mb / phase2_seconds, 2 ) << " MB/s" << std::endl;
+
   std::cout << "== Compressing bricks and optimizing brick files ==" << std::endl;
   
+  boost::posix_time::ptime phase3_start = boost::posix_time::microsec_clock::local_time();
   if (! converter->run_phase3( error ) )
   {
     printUsage();
     CORE_PRINT_AND_LOG_ERROR( error );
     return -1;
   }
+  boost::posix_time::ptime phase3_end = boost::posix_time::microsec_clock::local_time();
+
+  double phase3_seconds = Core::Max( 1e-3, ( phase3_end - phase3_start ).total_microseconds() * 1e-6 );
+  double total_seconds = phase2_seconds + phase3_seconds;
+  std::cout << "Compressed bricks in " << Core::ExportToString( phase3_seconds, 2 ) << " s" << std::endl;
+  std::cout << "Total conversion: " << Core::ExportToString( total_seconds, 2 ) << " s, "
+            << Core::ExportToString( num_slices / total_seconds, 2 ) << " slices/s, "
+            << Core::ExportToString( input_mb / total_seconds, 2 ) << " MB/s" << std::endl;
   
   std::cout << "== done ==" << std::endl;
   
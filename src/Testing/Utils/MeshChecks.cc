@@ -0,0 +1,106 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#include <map>
+#include <utility>
+
+#include <Testing/Utils/MeshChecks.h>
+
+namespace Testing {
+
+namespace Utils {
+
+::testing::AssertionResult CheckClosedManifold( const std::vector< Core::PointF >& points, 
+  const std::vector< unsigned int >& faces, int& euler_characteristic )
+{
+  if ( faces.size() % 3 != 0 ) return ::testing::AssertionFailure() << "incomplete face";
+  size_t num_faces = faces.size() / 3;
+
+  typedef std::pair< unsigned int, unsigned int > edge_type;
+  std::map< edge_type, size_t > edges;
+  std::vector< std::vector< edge_type > > fans( points.size() );
+  for ( size_t j = 0; j < num_faces; j++ )
+  {
+    const unsigned int* face = &faces[ 3 * j ];
+    for ( int k = 0; k < 3; k++ )
+    {
+      unsigned int a = face[ k ], b = face[ ( k + 1 ) % 3 ], c = face[ ( k + 2 ) % 3 ];
+      if ( a >= points.size() ) 
+      {
+        return ::testing::AssertionFailure() << "face " << j << " refers to point " << a;
+      }
+      if ( a == b ) return ::testing::AssertionFailure() << "face " << j << " is degenerate";
+      if ( ++edges[ edge_type( a, b ) ] > 1 )
+      {
+        return ::testing::AssertionFailure() << "edge " << a << "-" << b << " is used twice";
+      }
+      fans[ a ].push_back( edge_type( b, c ) );
+    }
+  }
+
+  for ( std::map< edge_type, size_t >::const_iterator it = edges.begin(); 
+    it != edges.end(); ++it )
+  {
+    if ( edges.find( edge_type( it->first.second, it->first.first ) ) == edges.end() )
+    {
+      return ::testing::AssertionFailure() << "edge " << it->first.first << "-" << 
+        it->first.second << " is on a border";
+    }
+  }
+
+  for ( size_t j = 0; j < points.size(); j++ )
+  {
+    const std::vector< edge_type >& fan = fans[ j ];
+    if ( fan.empty() ) return ::testing::AssertionFailure() << "point " << j << " is unused";
+
+    // Walk around the vertex, a single fan visits every face once before it closes
+    std::map< unsigned int, unsigned int > next;
+    for ( size_t k = 0; k < fan.size(); k++ ) next[ fan[ k ].first ] = fan[ k ].second;
+    unsigned int start = fan[ 0 ].first, current = start;
+    size_t steps = 0;
+    do
+    {
+      std::map< unsigned int, unsigned int >::const_iterator it = next.find( current );
+      if ( it == next.end() ) break;
+      current = it->second;
+      steps++;
+    } 
+    while ( current != start && steps <= fan.size() );
+    if ( current != start || steps != fan.size() )
+    {
+      return ::testing::AssertionFailure() << "the faces around point " << j << 
+        " do not form a single fan";
+    }
+  }
+
+  euler_characteristic = static_cast< int >( points.size() ) - 
+    static_cast< int >( edges.size() / 2 ) + static_cast< int >( num_faces );
+  return ::testing::AssertionSuccess();
+}
+
+}}
@@ -0,0 +1,51 @@
+/*
+ For more information, please see: http://software.sci.utah.edu
+ 
+ The MIT License
+ 
+ Copyright (c) 2016 Scientific Computing and Imaging Institute,
+ University of Utah.
+ 
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a
+ copy of this software and associated documentation files (the "Software"),
+ to deal in the Software without restriction, including without limitation
+ the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ and/or sell copies of the Software, and to permit persons to whom the
+ Software is furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TESTING_UTILS_MESHCHECKS_H
+#define TESTING_UTILS_MESHCHECKS_H
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Core/Geometry/Point.h>
+
+namespace Testing {
+
+namespace Utils {
+
+// Checks that the mesh only refers to existing points, uses all of them, has no degenerate
+// faces, and is a closed oriented manifold: every directed edge is used by exactly one face and
+// its opposite by another, and the faces around each vertex form a single fan. Returns the
+// Euler characteristic of the mesh.
+::testing::AssertionResult CheckClosedManifold( const std::vector< Core::PointF >& points, 
+  const std::vector< unsigned int >& faces, int& euler_characteristic );
+
+}}
+
+#endif